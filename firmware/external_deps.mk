@@ -11,4 +11,8 @@ $(platform_build_dir)/firmware/fw_dynamic.o: $(FW_FDT_PATH)
 $(platform_build_dir)/firmware/fw_jump.o: $(FW_FDT_PATH)
 $(platform_build_dir)/firmware/fw_payload.o: $(FW_FDT_PATH)
 
+$(platform_build_dir)/firmware/fw_dynamic.o: $(FW_FDT_OVERLAY_PATH)
+$(platform_build_dir)/firmware/fw_jump.o: $(FW_FDT_OVERLAY_PATH)
+$(platform_build_dir)/firmware/fw_payload.o: $(FW_FDT_OVERLAY_PATH)
+
 $(platform_build_dir)/firmware/fw_payload.o: $(FW_PAYLOAD_PATH_FINAL)
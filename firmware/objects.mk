@@ -22,6 +22,10 @@ firmware-genflags-y +=	-DFW_PIC
 firmware-asflags-y  +=	-fpic
 firmware-cflags-y   +=	-fPIE -pie
 firmware-ldflags-y  +=  -Wl,--no-dynamic-linker
+ifeq ($(FW_PIC_APPLY_RELOCS),y)
+firmware-genflags-y +=	-DFW_PIC_APPLY_RELOCS
+firmware-ldflags-y  +=	-Wl,--apply-dynamic-relocs
+endif
 endif
 
 ifdef FW_TEXT_START
@@ -35,6 +39,10 @@ firmware-genflags-y += -DFW_FDT_PADDING=$(FW_FDT_PADDING)
 endif
 endif
 
+ifdef FW_FDT_OVERLAY_PATH
+firmware-genflags-y += -DFW_FDT_OVERLAY_PATH=\"$(FW_FDT_OVERLAY_PATH)\"
+endif
+
 firmware-bins-$(FW_DYNAMIC) += fw_dynamic.bin
 
 firmware-bins-$(FW_JUMP) += fw_jump.bin
@@ -44,6 +52,9 @@ endif
 ifdef FW_JUMP_FDT_ADDR
 firmware-genflags-$(FW_JUMP) += -DFW_JUMP_FDT_ADDR=$(FW_JUMP_FDT_ADDR)
 endif
+ifdef FW_JUMP_SIZE
+firmware-genflags-$(FW_JUMP) += -DFW_JUMP_SIZE=$(FW_JUMP_SIZE)
+endif
 
 firmware-bins-$(FW_PAYLOAD) += fw_payload.bin
 ifdef FW_PAYLOAD_PATH
@@ -58,6 +69,12 @@ endif
 ifdef FW_PAYLOAD_ALIGN
 firmware-genflags-$(FW_PAYLOAD) += -DFW_PAYLOAD_ALIGN=$(FW_PAYLOAD_ALIGN)
 endif
+ifeq ($(FW_PAYLOAD_LZ4),y)
+firmware-genflags-$(FW_PAYLOAD) += -DFW_PAYLOAD_LZ4
+ifdef FW_PAYLOAD_LZ4_MAX_SIZE
+firmware-genflags-$(FW_PAYLOAD) += -DFW_PAYLOAD_LZ4_MAX_SIZE=$(FW_PAYLOAD_LZ4_MAX_SIZE)
+endif
+endif
 
 ifdef FW_PAYLOAD_FDT_ADDR
 firmware-genflags-$(FW_PAYLOAD) += -DFW_PAYLOAD_FDT_ADDR=$(FW_PAYLOAD_FDT_ADDR)
@@ -66,3 +83,7 @@ endif
 ifdef FW_OPTIONS
 firmware-genflags-y += -DFW_OPTIONS=$(FW_OPTIONS)
 endif
+
+ifdef FW_FDT_IN_PLACE_SPACE
+firmware-genflags-y += -DFW_FDT_IN_PLACE_SPACE=$(FW_FDT_IN_PLACE_SPACE)
+endif
@@ -0,0 +1,669 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_encoding.h>
+#include <sbi/sbi_console.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_fifo.h>
+#include <sbi/sbi_hartmask.h>
+#include <sbi/sbi_string.h>
+
+/* Must match bench_head.S */
+#define BENCH_HART_MAX		32
+
+#define BENCH_ITERS		1024
+#define BENCH_HSM_ITERS		16
+#define BENCH_PAGE_SIZE		4096
+#define BENCH_FIFO_ENTRIES	64
+
+/* Operations done by each sender in one storm */
+#ifndef BENCH_STORM_ITERS
+#define BENCH_STORM_ITERS	256
+#endif
+
+/*
+ * Opaque parameter of started HARTs: either BENCH_SECONDARY_STOP or the
+ * index of the HART in the list of parked HARTs
+ */
+#define BENCH_SECONDARY_STOP	-1UL
+
+/* Entry of HARTs started through HSM (see bench_head.S) */
+extern char _start_secondary[];
+
+struct sbiret {
+	long error;
+	long value;
+};
+
+static struct sbiret sbi_ecall(unsigned long ext, unsigned long fid,
+			       unsigned long arg0, unsigned long arg1,
+			       unsigned long arg2, unsigned long arg3)
+{
+	struct sbiret ret;
+	register unsigned long a0 asm("a0") = arg0;
+	register unsigned long a1 asm("a1") = arg1;
+	register unsigned long a2 asm("a2") = arg2;
+	register unsigned long a3 asm("a3") = arg3;
+	register unsigned long a6 asm("a6") = fid;
+	register unsigned long a7 asm("a7") = ext;
+
+	asm volatile("ecall"
+		     : "+r"(a0), "+r"(a1)
+		     : "r"(a2), "r"(a3), "r"(a6), "r"(a7)
+		     : "memory");
+	ret.error = a0;
+	ret.value = a1;
+
+	return ret;
+}
+
+#define rdcycle()							\
+	({								\
+		unsigned long __v;					\
+		asm volatile("rdcycle %0" : "=r"(__v) : : "memory");	\
+		__v;							\
+	})
+
+#define rdtime()							\
+	({								\
+		unsigned long __v;					\
+		asm volatile("rdtime %0" : "=r"(__v) : : "memory");	\
+		__v;							\
+	})
+
+static void bench_putc(char ch)
+{
+	sbi_ecall(SBI_EXT_0_1_CONSOLE_PUTCHAR, 0, ch, 0, 0, 0);
+}
+
+static void bench_puts(const char *str)
+{
+	while (str && *str)
+		bench_putc(*str++);
+}
+
+static void bench_putu(unsigned long val)
+{
+	char buf[24];
+	int i = 0;
+
+	do {
+		buf[i++] = '0' + (val % 10);
+		val /= 10;
+	} while (val);
+
+	while (i)
+		bench_putc(buf[--i]);
+}
+
+/* Statistics of one benchmark */
+struct bench_stat {
+	unsigned long count;
+	unsigned long cycles;
+	unsigned long time;
+	unsigned long min_cycles;
+	unsigned long max_cycles;
+};
+
+static void bench_stat_init(struct bench_stat *st)
+{
+	st->count = 0;
+	st->cycles = 0;
+	st->time = 0;
+	st->min_cycles = -1UL;
+	st->max_cycles = 0;
+}
+
+static void bench_stat_add(struct bench_stat *st, unsigned long cycles,
+			   unsigned long time)
+{
+	st->count++;
+	st->cycles += cycles;
+	st->time += time;
+	if (cycles < st->min_cycles)
+		st->min_cycles = cycles;
+	if (st->max_cycles < cycles)
+		st->max_cycles = cycles;
+}
+
+/*
+ * Results are printed one per line as
+ * "bench: <name> <param0> <param1> count=<n> cycles=<avg> min=<min> max=<max>
+ * time=<avg>" with cycles from rdcycle and time from rdtime.
+ */
+static void bench_report(const char *name, unsigned long param0,
+			 unsigned long param1, const struct bench_stat *st)
+{
+	bench_puts("bench: ");
+	bench_puts(name);
+	bench_putc(' ');
+	bench_putu(param0);
+	bench_putc(' ');
+	bench_putu(param1);
+	if (!st->count) {
+		bench_puts(" skipped\n");
+		return;
+	}
+	bench_puts(" count=");
+	bench_putu(st->count);
+	bench_puts(" cycles=");
+	bench_putu(st->cycles / st->count);
+	bench_puts(" min=");
+	bench_putu(st->min_cycles);
+	bench_puts(" max=");
+	bench_putu(st->max_cycles);
+	bench_puts(" time=");
+	bench_putu(st->time / st->count);
+	bench_putc('\n');
+}
+
+/* Measure a statement __iters times, it can use the iteration number __i */
+#define BENCH_RUN(__st, __iters, __stmt)				\
+	do {								\
+		unsigned long __i, __c, __t;				\
+		bench_stat_init(__st);					\
+		for (__i = 0; __i < (__iters); __i++) {			\
+			__t = rdtime();					\
+			__c = rdcycle();				\
+			__stmt;						\
+			__c = rdcycle() - __c;				\
+			__t = rdtime() - __t;				\
+			bench_stat_add(__st, __c, __t);			\
+		}							\
+	} while (0)
+
+static unsigned long bench_hartid;
+static unsigned long bench_harts[BENCH_HART_MAX];
+static unsigned long bench_hart_count;
+static volatile unsigned long bench_parked;
+
+/* HARTs taking part in storms, index 0 is current HART */
+static unsigned long bench_active[BENCH_HART_MAX];
+static unsigned long bench_active_count;
+
+static long bench_hart_status(unsigned long hartid)
+{
+	struct sbiret ret = sbi_ecall(SBI_EXT_HSM, SBI_EXT_HSM_HART_GET_STATUS,
+				      hartid, 0, 0, 0);
+
+	return (ret.error) ? ret.error : ret.value;
+}
+
+static void bench_find_harts(void)
+{
+	unsigned long i;
+
+	bench_hart_count = 0;
+	for (i = 0; i < BENCH_HART_MAX; i++) {
+		if (bench_hart_status(i) >= 0)
+			bench_harts[bench_hart_count++] = i;
+	}
+}
+
+static void bench_base(void)
+{
+	struct bench_stat st;
+
+	BENCH_RUN(&st, BENCH_ITERS,
+		  sbi_ecall(SBI_EXT_BASE, SBI_EXT_BASE_PROBE_EXT,
+			    SBI_EXT_TIME, 0, 0, 0));
+	bench_report("base_probe", 0, 0, &st);
+}
+
+static void bench_time(void)
+{
+	struct bench_stat st;
+
+	BENCH_RUN(&st, BENCH_ITERS,
+		  sbi_ecall(SBI_EXT_TIME, SBI_EXT_TIME_SET_TIMER,
+			    -1UL, -1UL, 0, 0));
+	bench_report("set_timer", 0, 0, &st);
+}
+
+static void bench_ipi(void)
+{
+	struct bench_stat st;
+
+	/* The S-mode IPI to ourselves stays pending since SIE is clear */
+	BENCH_RUN(&st, BENCH_ITERS,
+		  sbi_ecall(SBI_EXT_IPI, SBI_EXT_IPI_SEND_IPI,
+			    1, bench_hartid, 0, 0));
+	csr_clear(CSR_SIP, MIP_SSIP);
+	bench_report("ipi_send_self", 0, 0, &st);
+}
+
+static void bench_rfence(unsigned long nharts)
+{
+	struct bench_stat st;
+	unsigned long i, p, hmask = 0;
+	static const unsigned long pages[] = { 1, 16, 256, 0 };
+
+	/* Current HART plus nharts - 1 parked HARTs */
+	hmask |= 1UL << bench_hartid;
+	for (i = 0; i < bench_hart_count && 1 < nharts; i++) {
+		if (bench_harts[i] == bench_hartid ||
+		    __riscv_xlen <= bench_harts[i])
+			continue;
+		hmask |= 1UL << bench_harts[i];
+		nharts--;
+	}
+
+	for (p = 0; p < sizeof(pages) / sizeof(pages[0]); p++) {
+		/* Zero pages stands for a full flush */
+		BENCH_RUN(&st, BENCH_ITERS,
+			  sbi_ecall(SBI_EXT_RFENCE,
+				    SBI_EXT_RFENCE_REMOTE_SFENCE_VMA,
+				    hmask, 0, 0,
+				    (pages[p]) ? pages[p] * BENCH_PAGE_SIZE :
+						 -1UL));
+		bench_report("rfence_sfence_vma", __builtin_popcountl(hmask),
+			     pages[p], &st);
+	}
+}
+
+static void bench_hsm_start_stop(void)
+{
+	struct bench_stat st;
+	unsigned long i, c, t, target = -1UL;
+	struct sbiret ret;
+
+	for (i = 0; i < bench_hart_count; i++) {
+		if (bench_harts[i] != bench_hartid &&
+		    bench_hart_status(bench_harts[i]) == SBI_HSM_STATE_STOPPED) {
+			target = bench_harts[i];
+			break;
+		}
+	}
+
+	/* Time from start request until the HART stopped itself again */
+	bench_stat_init(&st);
+	for (i = 0; target != -1UL && i < BENCH_HSM_ITERS; i++) {
+		t = rdtime();
+		c = rdcycle();
+		ret = sbi_ecall(SBI_EXT_HSM, SBI_EXT_HSM_HART_START, target,
+				(unsigned long)_start_secondary,
+				BENCH_SECONDARY_STOP, 0);
+		if (ret.error)
+			break;
+		while (bench_hart_status(target) != SBI_HSM_STATE_STOPPED)
+			;
+		c = rdcycle() - c;
+		t = rdtime() - t;
+		bench_stat_add(&st, c, t);
+	}
+	bench_report("hsm_start_stop", 0, 0, &st);
+}
+
+static void bench_hsm_suspend(void)
+{
+	struct bench_stat st;
+	unsigned long i, c, t;
+	struct sbiret ret;
+
+	/* A supervisor timer interrupt wakes us up without trapping */
+	csr_set(CSR_SIE, MIP_STIP);
+	bench_stat_init(&st);
+	for (i = 0; i < BENCH_HSM_ITERS; i++) {
+		t = rdtime();
+		c = rdcycle();
+		sbi_ecall(SBI_EXT_TIME, SBI_EXT_TIME_SET_TIMER, t, 0, 0, 0);
+		ret = sbi_ecall(SBI_EXT_HSM, SBI_EXT_HSM_HART_SUSPEND,
+				SBI_HSM_SUSPEND_RET_DEFAULT, 0, 0, 0);
+		c = rdcycle() - c;
+		t = rdtime() - t;
+		if (ret.error)
+			break;
+		bench_stat_add(&st, c, t);
+	}
+	sbi_ecall(SBI_EXT_TIME, SBI_EXT_TIME_SET_TIMER, -1UL, -1UL, 0, 0);
+	csr_clear(CSR_SIE, MIP_STIP);
+	bench_report("hsm_suspend_retentive", 0, 0, &st);
+}
+
+static void bench_traps(void)
+{
+	struct bench_stat st;
+	unsigned long val;
+	static unsigned long buf[2];
+	unsigned long addr = (unsigned long)buf + 1;
+
+	/* Emulated by firmware when there is no TIME CSR */
+	BENCH_RUN(&st, BENCH_ITERS, val = rdtime());
+	bench_report("rdtime", 0, 0, &st);
+
+	/* Emulated by firmware when the HART traps misaligned accesses */
+	BENCH_RUN(&st, BENCH_ITERS,
+		  asm volatile("lw %0, 0(%1)" : "=r"(val) : "r"(addr)));
+	bench_report("misaligned_load", 0, 0, &st);
+	BENCH_RUN(&st, BENCH_ITERS,
+		  asm volatile("sw %0, 0(%1)" : : "r"(val), "r"(addr)
+			       : "memory"));
+	bench_report("misaligned_store", 0, 0, &st);
+}
+
+/* Storm operations */
+#define BENCH_STORM_IPI			0
+#define BENCH_STORM_SFENCE_VMA		1
+#define BENCH_STORM_FENCE_I		2
+
+/* Storm topologies */
+#define BENCH_TOPO_ONE			0	/* index 0 only */
+#define BENCH_TOPO_ALL			1	/* all parked HARTs */
+#define BENCH_TOPO_NEXT			2	/* next HART of the sender */
+
+struct bench_storm {
+	const char *name;
+	unsigned long op;
+	unsigned long senders;
+	unsigned long receivers;
+};
+
+/* Storms to run, add entries here for other sender/receiver topologies */
+static const struct bench_storm bench_storms[] = {
+	{ "storm_ipi_one_to_all", BENCH_STORM_IPI,
+	  BENCH_TOPO_ONE, BENCH_TOPO_ALL },
+	{ "storm_ipi_all_to_one", BENCH_STORM_IPI,
+	  BENCH_TOPO_ALL, BENCH_TOPO_ONE },
+	{ "storm_ipi_all_to_next", BENCH_STORM_IPI,
+	  BENCH_TOPO_ALL, BENCH_TOPO_NEXT },
+	{ "storm_ipi_all_to_all", BENCH_STORM_IPI,
+	  BENCH_TOPO_ALL, BENCH_TOPO_ALL },
+	{ "storm_sfence_vma_one_to_all", BENCH_STORM_SFENCE_VMA,
+	  BENCH_TOPO_ONE, BENCH_TOPO_ALL },
+	{ "storm_sfence_vma_all_to_one", BENCH_STORM_SFENCE_VMA,
+	  BENCH_TOPO_ALL, BENCH_TOPO_ONE },
+	{ "storm_sfence_vma_all_to_next", BENCH_STORM_SFENCE_VMA,
+	  BENCH_TOPO_ALL, BENCH_TOPO_NEXT },
+	{ "storm_sfence_vma_all_to_all", BENCH_STORM_SFENCE_VMA,
+	  BENCH_TOPO_ALL, BENCH_TOPO_ALL },
+	{ "storm_fence_i_all_to_all", BENCH_STORM_FENCE_I,
+	  BENCH_TOPO_ALL, BENCH_TOPO_ALL },
+};
+
+#define BENCH_STORM_COUNT	(sizeof(bench_storms) / sizeof(bench_storms[0]))
+
+/*
+ * Storm rounds are started by bumping bench_storm_seq. The barrier
+ * counters are never reset so HARTs leaving a round late cannot be
+ * confused by the next one.
+ */
+static volatile unsigned long bench_storm_seq;
+static volatile unsigned long bench_storm_cur;
+static volatile unsigned long bench_storm_ready;
+static volatile unsigned long bench_storm_done;
+static unsigned long bench_samples[BENCH_HART_MAX][BENCH_STORM_ITERS];
+static unsigned long bench_sorted[BENCH_HART_MAX * BENCH_STORM_ITERS];
+
+static int bench_storm_topo(unsigned long topo, unsigned long idx,
+			     unsigned long from)
+{
+	switch (topo) {
+	case BENCH_TOPO_ONE:
+		return idx == 0;
+	case BENCH_TOPO_NEXT:
+		return idx == (from + 1) % bench_active_count;
+	default:
+		return 1;
+	}
+}
+
+static unsigned long bench_storm_hmask(const struct bench_storm *bs,
+				       unsigned long from)
+{
+	unsigned long i, hmask = 0;
+
+	for (i = 0; i < bench_active_count; i++) {
+		if (bench_active[i] < __riscv_xlen &&
+		    bench_storm_topo(bs->receivers, i, from))
+			hmask |= 1UL << bench_active[i];
+	}
+
+	return hmask;
+}
+
+static void bench_storm_op(unsigned long op, unsigned long hmask)
+{
+	switch (op) {
+	case BENCH_STORM_IPI:
+		sbi_ecall(SBI_EXT_IPI, SBI_EXT_IPI_SEND_IPI, hmask, 0, 0, 0);
+		break;
+	case BENCH_STORM_SFENCE_VMA:
+		sbi_ecall(SBI_EXT_RFENCE, SBI_EXT_RFENCE_REMOTE_SFENCE_VMA,
+			  hmask, 0, 0, -1UL);
+		break;
+	case BENCH_STORM_FENCE_I:
+		sbi_ecall(SBI_EXT_RFENCE, SBI_EXT_RFENCE_REMOTE_FENCE_I,
+			  hmask, 0, 0, 0);
+		break;
+	}
+}
+
+/* Run one storm round on a HART, receivers keep acknowledging IPIs */
+static void bench_storm_run(unsigned long idx, unsigned long round)
+{
+	const struct bench_storm *bs = &bench_storms[bench_storm_cur];
+	unsigned long i, c, hmask = bench_storm_hmask(bs, idx);
+	unsigned long target = round * bench_active_count;
+	int sender = bench_storm_topo(bs->senders, idx, idx);
+
+	__atomic_add_fetch(&bench_storm_ready, 1, __ATOMIC_SEQ_CST);
+	while (bench_storm_ready < target)
+		;
+
+	for (i = 0; sender && i < BENCH_STORM_ITERS; i++) {
+		c = rdcycle();
+		bench_storm_op(bs->op, hmask);
+		bench_samples[idx][i] = rdcycle() - c;
+		csr_clear(CSR_SIP, MIP_SSIP);
+	}
+
+	__atomic_add_fetch(&bench_storm_done, 1, __ATOMIC_SEQ_CST);
+	while (bench_storm_done < target)
+		csr_clear(CSR_SIP, MIP_SSIP);
+}
+
+static void bench_sort(unsigned long *data, unsigned long count)
+{
+	unsigned long gap, i, j, val;
+
+	for (gap = count / 2; gap; gap /= 2) {
+		for (i = gap; i < count; i++) {
+			val = data[i];
+			for (j = i; gap <= j && val < data[j - gap]; j -= gap)
+				data[j] = data[j - gap];
+			data[j] = val;
+		}
+	}
+}
+
+/*
+ * Storm results are printed as "bench: <name> <senders> <receivers>
+ * ops=<n> p50=<cycles> p99=<cycles> max=<cycles> time=<ticks>
+ * tput=<ops per 10000 ticks>" with latencies taken per operation.
+ */
+static void bench_storm(unsigned long s)
+{
+	const struct bench_storm *bs = &bench_storms[s];
+	unsigned long i, j, t, n = 0, senders = 0, kick = 0;
+	unsigned long round = bench_storm_seq + 1;
+
+	for (i = 1; i < bench_active_count; i++) {
+		if (bench_active[i] < __riscv_xlen)
+			kick |= 1UL << bench_active[i];
+	}
+
+	bench_storm_cur = s;
+	__atomic_store_n(&bench_storm_seq, round, __ATOMIC_SEQ_CST);
+	sbi_ecall(SBI_EXT_IPI, SBI_EXT_IPI_SEND_IPI, kick, 0, 0, 0);
+
+	t = rdtime();
+	bench_storm_run(0, round);
+	t = rdtime() - t;
+
+	for (i = 0; i < bench_active_count; i++) {
+		if (!bench_storm_topo(bs->senders, i, i))
+			continue;
+		for (j = 0; j < BENCH_STORM_ITERS; j++)
+			bench_sorted[n++] = bench_samples[i][j];
+		senders++;
+	}
+	bench_sort(bench_sorted, n);
+
+	bench_puts("bench: ");
+	bench_puts(bs->name);
+	bench_putc(' ');
+	bench_putu(senders);
+	bench_putc(' ');
+	bench_putu(__builtin_popcountl(bench_storm_hmask(bs, 0)));
+	bench_puts(" ops=");
+	bench_putu(n);
+	bench_puts(" p50=");
+	bench_putu(bench_sorted[n / 2]);
+	bench_puts(" p99=");
+	bench_putu(bench_sorted[(n * 99) / 100]);
+	bench_puts(" max=");
+	bench_putu(bench_sorted[n - 1]);
+	bench_puts(" time=");
+	bench_putu(t);
+	bench_puts(" tput=");
+	bench_putu((t) ? (n * 10000) / t : 0);
+	bench_putc('\n');
+}
+
+static int bench_fifo_update(void *in, void *data)
+{
+	return SBI_FIFO_UNCHANGED;
+}
+
+/*
+ * Library code linked from libplatsbi.a and run from S-mode. The FIFO
+ * lock falls back to its nodeless path because the per-HART lock nodes
+ * are only set up by the firmware copy of the library.
+ */
+static void bench_lib(void)
+{
+	struct bench_stat st;
+	struct sbi_fifo fifo;
+	struct sbi_hartmask m1, m2;
+	static unsigned long fifo_mem[BENCH_FIFO_ENTRIES];
+	static char src[BENCH_PAGE_SIZE], dst[BENCH_PAGE_SIZE];
+	static const unsigned long sizes[] = { 16, 256, BENCH_PAGE_SIZE };
+	unsigned long i, h, val = 0;
+	char buf[64];
+
+	sbi_fifo_init(&fifo, fifo_mem, BENCH_FIFO_ENTRIES, sizeof(val));
+	BENCH_RUN(&st, BENCH_FIFO_ENTRIES, sbi_fifo_enqueue(&fifo, &val));
+	bench_report("fifo_enqueue", BENCH_FIFO_ENTRIES, 0, &st);
+	/* Worst case scan of a full FIFO without a matching entry */
+	BENCH_RUN(&st, BENCH_ITERS,
+		  sbi_fifo_inplace_update(&fifo, &val, bench_fifo_update));
+	bench_report("fifo_inplace_update", BENCH_FIFO_ENTRIES, 0, &st);
+	BENCH_RUN(&st, BENCH_FIFO_ENTRIES, sbi_fifo_dequeue(&fifo, &val));
+	bench_report("fifo_dequeue", BENCH_FIFO_ENTRIES, 0, &st);
+
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		BENCH_RUN(&st, BENCH_ITERS, sbi_memcpy(dst, src, sizes[i]));
+		bench_report("memcpy", sizes[i], 0, &st);
+		BENCH_RUN(&st, BENCH_ITERS, sbi_memset(dst, 0, sizes[i]));
+		bench_report("memset", sizes[i], 0, &st);
+	}
+
+	SBI_HARTMASK_INIT(&m1);
+	SBI_HARTMASK_INIT(&m2);
+	BENCH_RUN(&st, BENCH_ITERS,
+		  sbi_hartmask_set_hart(__i % SBI_HARTMASK_MAX_BITS, &m1));
+	bench_report("hartmask_set_hart", 0, 0, &st);
+	BENCH_RUN(&st, BENCH_ITERS, sbi_hartmask_or(&m2, &m1, &m2));
+	bench_report("hartmask_or", 0, 0, &st);
+	BENCH_RUN(&st, BENCH_ITERS,
+		  sbi_hartmask_for_each_hart(h, &m2) val += h);
+	bench_report("hartmask_for_each_hart", 0, 0, &st);
+
+	BENCH_RUN(&st, BENCH_ITERS,
+		  sbi_snprintf(buf, sizeof(buf), "%s %d 0x%lx\n",
+			       "bench", (int)__i, val));
+	bench_report("snprintf", 0, 0, &st);
+}
+
+void bench_secondary(unsigned long hartid, unsigned long mode)
+{
+	unsigned long seen = 0;
+
+	if (mode == BENCH_SECONDARY_STOP)
+		sbi_ecall(SBI_EXT_HSM, SBI_EXT_HSM_HART_STOP, 0, 0, 0, 0);
+
+	/*
+	 * Parked HARTs handle firmware work such as remote fences and
+	 * are kicked with an S-mode IPI for storm rounds.
+	 */
+	csr_set(CSR_SIE, MIP_SSIP);
+	__atomic_add_fetch(&bench_parked, 1, __ATOMIC_SEQ_CST);
+	while (1) {
+		csr_clear(CSR_SIP, MIP_SSIP);
+		while (seen != bench_storm_seq)
+			bench_storm_run(mode, ++seen);
+		wfi();
+	}
+}
+
+static void bench_park_harts(void)
+{
+	unsigned long i;
+	struct sbiret ret;
+
+	bench_active[0] = bench_hartid;
+	bench_active_count = 1;
+	for (i = 0; i < bench_hart_count; i++) {
+		if (bench_harts[i] == bench_hartid)
+			continue;
+		while (bench_hart_status(bench_harts[i]) ==
+		       SBI_HSM_STATE_STOP_PENDING)
+			;
+		bench_active[bench_active_count] = bench_harts[i];
+		ret = sbi_ecall(SBI_EXT_HSM, SBI_EXT_HSM_HART_START,
+				bench_harts[i],
+				(unsigned long)_start_secondary,
+				bench_active_count, 0);
+		if (!ret.error)
+			bench_active_count++;
+	}
+
+	while (bench_parked < bench_active_count - 1)
+		;
+}
+
+void bench_main(unsigned long a0, unsigned long a1)
+{
+	unsigned long n;
+
+	bench_hartid = a0;
+	bench_puts("\nBenchmark payload running\n");
+
+	bench_find_harts();
+
+	bench_lib();
+	bench_base();
+	bench_time();
+	bench_ipi();
+	bench_traps();
+	bench_hsm_suspend();
+	bench_hsm_start_stop();
+
+	bench_park_harts();
+	for (n = 1; n <= bench_hart_count; n *= 2)
+		bench_rfence(n);
+	if (bench_hart_count & (bench_hart_count - 1))
+		bench_rfence(bench_hart_count);
+
+	for (n = 0; n < BENCH_STORM_COUNT; n++)
+		bench_storm(n);
+
+	bench_puts("bench: done\n");
+
+	while (1)
+		wfi();
+}
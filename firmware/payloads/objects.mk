@@ -17,3 +17,14 @@ test-y += test_main.o
 
 %/test.dep: $(foreach dep,$(test-y:.o=.dep),%/$(dep))
 	$(call merge_deps,$@,$^)
+
+firmware-bins-$(FW_PAYLOAD) += payloads/bench.bin
+
+bench-y += bench_head.o
+bench-y += bench_main.o
+
+%/bench.o: $(foreach obj,$(bench-y),%/$(obj))
+	$(call merge_objs,$@,$^)
+
+%/bench.dep: $(foreach dep,$(bench-y:.o=.dep),%/$(dep))
+	$(call merge_deps,$@,$^)
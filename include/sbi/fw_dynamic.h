@@ -26,18 +26,30 @@
 #define FW_DYNAMIC_INFO_OPTIONS_OFFSET		(4 * __SIZEOF_POINTER__)
 /** Offset of boot_hart member in fw_dynamic_info  (version >= 2) */
 #define FW_DYNAMIC_INFO_BOOT_HART_OFFSET	(5 * __SIZEOF_POINTER__)
+/** Offset of fdt_overlay member in fw_dynamic_info  (version >= 3) */
+#define FW_DYNAMIC_INFO_FDT_OVERLAY_OFFSET	(6 * __SIZEOF_POINTER__)
+/** Offset of next_size member in fw_dynamic_info  (version >= 4) */
+#define FW_DYNAMIC_INFO_NEXT_SIZE_OFFSET	(7 * __SIZEOF_POINTER__)
+/** Offset of boot_hints member in fw_dynamic_info  (version >= 5) */
+#define FW_DYNAMIC_INFO_BOOT_HINTS_OFFSET	(8 * __SIZEOF_POINTER__)
 
 /** Expected value of info magic ('OSBI' ascii string in hex) */
 #define FW_DYNAMIC_INFO_MAGIC_VALUE		0x4942534f
 
 /** Maximum supported info version */
-#define FW_DYNAMIC_INFO_VERSION_MAX		0x2
+#define FW_DYNAMIC_INFO_VERSION_MAX		0x5
 
 /** Possible next mode values */
 #define FW_DYNAMIC_INFO_NEXT_MODE_U		0x0
 #define FW_DYNAMIC_INFO_NEXT_MODE_S		0x1
 #define FW_DYNAMIC_INFO_NEXT_MODE_M		0x3
 
+/** Possible flags of fw_dynamic_boot_hints */
+#define FW_DYNAMIC_BOOT_HINT_FDT_VALID		(1UL << 0)
+#define FW_DYNAMIC_BOOT_HINT_FDT_PLIC_FIXED	(1UL << 1)
+#define FW_DYNAMIC_BOOT_HINT_PMP_COUNT		(1UL << 2)
+#define FW_DYNAMIC_BOOT_HINT_MHPM_COUNT		(1UL << 3)
+
 /* clang-format on */
 
 #ifndef __ASSEMBLER__
@@ -72,6 +84,43 @@ struct fw_dynamic_info {
 	 * to use the relocation lottery mechanism.
 	 */
 	unsigned long boot_hart;
+	/**
+	 * Address of DT overlays (DTBO) to apply on the FDT passed in 'a1'
+	 *
+	 * Several overlays can be placed one after another, each starting
+	 * at an 8-byte aligned address. The list ends at the first address
+	 * without a FDT header, so the memory after the last overlay must
+	 * not start with the FDT magic. Zero means no overlays.
+	 */
+	unsigned long fdt_overlay;
+	/** Size (in bytes) of the next booting stage image, zero if unknown */
+	unsigned long next_size;
+	/** Address of struct fw_dynamic_boot_hints, zero if none */
+	unsigned long boot_hints;
+} __packed;
+
+/**
+ * Facts already established by the previous booting stage
+ *
+ * Each hint lets the firmware skip the corresponding probing. Hints are
+ * trusted as given so they must describe the hardware exactly.
+ */
+struct fw_dynamic_boot_hints {
+	/** Bitmask of FW_DYNAMIC_BOOT_HINT_xyz */
+	unsigned long flags;
+	/**
+	 * Timebase frequency in Hz, for example calibrated by the previous
+	 * booting stage, used instead of the DT value (zero if not given)
+	 */
+	unsigned long timebase_freq;
+	/** Number of HART ids at hart_ids (zero if not given) */
+	unsigned long hart_count;
+	/** Address of the u32 HART ids used instead of the DT CPU nodes */
+	unsigned long hart_ids;
+	/** Number of PMP regions of every HART (with HINT_PMP_COUNT) */
+	unsigned long pmp_count;
+	/** Number of MHPM counters of every HART (with HINT_MHPM_COUNT) */
+	unsigned long mhpm_count;
 } __packed;
 
 #endif
@@ -162,6 +162,12 @@ void csr_write_num(int csr_num, unsigned long val);
 		__asm__ __volatile__("ebreak" ::: "memory"); \
 	} while (0)
 
+/* Zihintpause PAUSE is a FENCE hint so it is a no-op on other HARTs */
+#define pause()                                                  \
+	do {                                                     \
+		__asm__ __volatile__(".word 0x0100000f" ::: "memory"); \
+	} while (0)
+
 /* Get current HART id */
 #define current_hartid()	((unsigned int)csr_read(CSR_MHARTID))
 
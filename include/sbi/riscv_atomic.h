@@ -10,6 +10,14 @@
 #ifndef __RISCV_ATOMIC_H__
 #define __RISCV_ATOMIC_H__
 
+#include <sbi/sbi_types.h>
+
+/*
+ * Functions without suffix are fully ordered. The _relaxed variants
+ * only guarantee atomicity, the _acquire variants order the accesses
+ * after them and the _release variants order the accesses before them.
+ */
+
 typedef struct {
 	volatile long counter;
 } atomic_t;
@@ -27,10 +35,28 @@ void atomic_write(atomic_t *atom, long value);
 
 long atomic_add_return(atomic_t *atom, long value);
 
+long atomic_add_return_relaxed(atomic_t *atom, long value);
+
+long atomic_add_return_acquire(atomic_t *atom, long value);
+
+long atomic_add_return_release(atomic_t *atom, long value);
+
 long atomic_sub_return(atomic_t *atom, long value);
 
+long atomic_sub_return_relaxed(atomic_t *atom, long value);
+
+long atomic_sub_return_acquire(atomic_t *atom, long value);
+
+long atomic_sub_return_release(atomic_t *atom, long value);
+
 long atomic_cmpxchg(atomic_t *atom, long oldval, long newval);
 
+long atomic_cmpxchg_relaxed(atomic_t *atom, long oldval, long newval);
+
+long atomic_cmpxchg_acquire(atomic_t *atom, long oldval, long newval);
+
+long atomic_cmpxchg_release(atomic_t *atom, long oldval, long newval);
+
 long atomic_xchg(atomic_t *atom, long newval);
 
 unsigned int atomic_raw_xchg_uint(volatile unsigned int *ptr,
@@ -38,15 +64,57 @@ unsigned int atomic_raw_xchg_uint(volatile unsigned int *ptr,
 
 unsigned long atomic_raw_xchg_ulong(volatile unsigned long *ptr,
 				    unsigned long newval);
+
+unsigned long atomic_raw_xchg_ulong_relaxed(volatile unsigned long *ptr,
+					    unsigned long newval);
+
+unsigned long atomic_raw_xchg_ulong_acquire(volatile unsigned long *ptr,
+					    unsigned long newval);
+
+unsigned long atomic_raw_xchg_ulong_release(volatile unsigned long *ptr,
+					    unsigned long newval);
+
+unsigned long atomic_raw_cmpxchg_ulong(volatile unsigned long *ptr,
+				       unsigned long oldval,
+				       unsigned long newval);
+
+unsigned long atomic_raw_cmpxchg_ulong_relaxed(volatile unsigned long *ptr,
+					       unsigned long oldval,
+					       unsigned long newval);
+
+unsigned long atomic_raw_cmpxchg_ulong_acquire(volatile unsigned long *ptr,
+					       unsigned long oldval,
+					       unsigned long newval);
+
+unsigned long atomic_raw_cmpxchg_ulong_release(volatile unsigned long *ptr,
+					       unsigned long oldval,
+					       unsigned long newval);
+
 /**
- * Set a bit in an atomic variable and return the new value.
+ * Compare and swap two adjacent unsigned longs as a whole (fully ordered)
+ *
+ * HARTs with Zacas use AMOCAS.Q (AMOCAS.D on RV32) and other HARTs take
+ * a global lock, so such words must only be updated by this function
+ * and all HARTs sharing them must agree on having Zacas.
+ *
+ * @param ptr address aligned to twice the size of unsigned long
+ * @param oldval expected value, updated with the value found at ptr
+ * @param newval value to store when ptr matched oldval
+ *
+ * @return TRUE if newval was stored and FALSE otherwise
+ */
+bool atomic_raw_cmpxchg_dword(volatile unsigned long *ptr,
+			      unsigned long *oldval,
+			      const unsigned long *newval);
+/**
+ * Set a bit in an atomic variable and return the old value of the bit.
  * @nr : Bit to set.
  * @atom: atomic variable to modify
  */
 int atomic_set_bit(int nr, atomic_t *atom);
 
 /**
- * Clear a bit in an atomic variable and return the new value.
+ * Clear a bit in an atomic variable and return the old value of the bit.
  * @nr : Bit to set.
  * @atom: atomic variable to modify
  */
@@ -54,17 +122,38 @@ int atomic_set_bit(int nr, atomic_t *atom);
 int atomic_clear_bit(int nr, atomic_t *atom);
 
 /**
- * Set a bit in any address and return the new value .
+ * Set a bit in any address and return the old value of the bit.
  * @nr : Bit to set.
  * @addr: Address to modify
  */
 int atomic_raw_set_bit(int nr, volatile unsigned long *addr);
 
 /**
- * Clear a bit in any address and return the new value .
+ * Clear a bit in any address and return the old value of the bit.
  * @nr : Bit to set.
  * @addr: Address to modify
  */
 int atomic_raw_clear_bit(int nr, volatile unsigned long *addr);
 
+int atomic_raw_set_bit_relaxed(int nr, volatile unsigned long *addr);
+
+int atomic_raw_set_bit_acquire(int nr, volatile unsigned long *addr);
+
+int atomic_raw_set_bit_release(int nr, volatile unsigned long *addr);
+
+int atomic_raw_clear_bit_relaxed(int nr, volatile unsigned long *addr);
+
+int atomic_raw_clear_bit_acquire(int nr, volatile unsigned long *addr);
+
+int atomic_raw_clear_bit_release(int nr, volatile unsigned long *addr);
+
+/**
+ * Set the bits of mask in any address and return the old value of the
+ * whole word.
+ * @ptr: Address to modify
+ * @mask: Bits to set
+ */
+unsigned long atomic_raw_fetch_or_ulong(volatile unsigned long *ptr,
+					unsigned long mask);
+
 #endif
@@ -86,6 +86,17 @@
 #define IRQ_VS_EXT			10
 #define IRQ_M_EXT			11
 #define IRQ_S_GEXT			12
+#define IRQ_PMU_OVF			13
+
+#if __riscv_xlen == 64
+#define MCAUSE_IRQ_MASK			(_UL(1) << 63)
+#else
+#define MCAUSE_IRQ_MASK			(_UL(1) << 31)
+#endif
+
+#define MTVEC_MODE_DIRECT		_UL(0x0)
+#define MTVEC_MODE_VECTORED		_UL(0x1)
+#define MTVEC_MODE_MASK			_UL(0x3)
 
 #define MIP_SSIP			(_UL(1) << IRQ_S_SOFT)
 #define MIP_VSSIP			(_UL(1) << IRQ_VS_SOFT)
@@ -97,10 +108,31 @@
 #define MIP_VSEIP			(_UL(1) << IRQ_VS_EXT)
 #define MIP_MEIP			(_UL(1) << IRQ_M_EXT)
 #define MIP_SGEIP			(_UL(1) << IRQ_S_GEXT)
+#define MIP_LCOFIP			(_UL(1) << IRQ_PMU_OVF)
 
 #define SIP_SSIP			MIP_SSIP
 #define SIP_STIP			MIP_STIP
 
+#define ENVCFG_STCE			(_ULL(1) << 63)
+#define ENVCFG_PBMTE			(_ULL(1) << 62)
+#define ENVCFG_CBZE			(_UL(1) << 7)
+#define ENVCFG_CBCFE			(_UL(1) << 6)
+#define ENVCFG_CBIE_SHIFT		4
+#define ENVCFG_CBIE			(_UL(0x3) << ENVCFG_CBIE_SHIFT)
+#define ENVCFG_CBIE_ILL			_UL(0x0)
+#define ENVCFG_CBIE_FLUSH		_UL(0x1)
+#define ENVCFG_CBIE_INV			_UL(0x3)
+
+#define COUNTEREN_TM			(_UL(1) << 1)
+
+#define MHPMEVENT_OF			(_ULL(1) << 63)
+#define MHPMEVENT_MINH			(_ULL(1) << 62)
+#define MHPMEVENT_SINH			(_ULL(1) << 61)
+#define MHPMEVENT_UINH			(_ULL(1) << 60)
+#define MHPMEVENT_VSINH			(_ULL(1) << 59)
+#define MHPMEVENT_VUINH			(_ULL(1) << 58)
+#define MHPMEVENT_SSCOF_MASK		_ULL(0xFFFF000000000000)
+
 #define PRV_U				_UL(0)
 #define PRV_S				_UL(1)
 #define PRV_M				_UL(3)
@@ -190,6 +222,15 @@
 #define CSR_FRM				0x002
 #define CSR_FCSR			0x003
 
+/* User Vector CSRs */
+#define CSR_VSTART			0x008
+#define CSR_VXSAT			0x009
+#define CSR_VXRM			0x00a
+#define CSR_VCSR			0x00f
+#define CSR_VL				0xc20
+#define CSR_VTYPE			0xc21
+#define CSR_VLENB			0xc22
+
 /* User Counters/Timers */
 #define CSR_CYCLE			0xc00
 #define CSR_TIME			0xc01
@@ -273,9 +314,21 @@
 #define CSR_STVAL			0x143
 #define CSR_SIP				0x144
 
+/* Sstc extension */
+#define CSR_STIMECMP			0x14d
+#define CSR_STIMECMPH			0x15d
+
 /* Supervisor Protection and Translation */
 #define CSR_SATP			0x180
 
+/* Supervisor-Level Window to Indirectly Accessed Registers (AIA) */
+#define CSR_SISELECT			0x150
+#define CSR_SIREG			0x151
+
+/* Supervisor-Level Interrupts (AIA) */
+#define CSR_STOPEI			0x15c
+#define CSR_STOPI			0xdb0
+
 /* ===== Hypervisor-level CSRs ===== */
 
 /* Hypervisor Trap Setup (H-extension) */
@@ -285,6 +338,8 @@
 #define CSR_HIE				0x604
 #define CSR_HCOUNTEREN			0x606
 #define CSR_HGEIE			0x607
+#define CSR_HENVCFG			0x60a
+#define CSR_HENVCFGH			0x61a
 
 /* Hypervisor Trap Handling (H-extension) */
 #define CSR_HTVAL			0x643
@@ -305,6 +360,8 @@
 #define CSR_VSIE			0x204
 #define CSR_VSTVEC			0x205
 #define CSR_VSSCRATCH			0x240
+#define CSR_VSTIMECMP			0x24d
+#define CSR_VSTIMECMPH			0x25d
 #define CSR_VSEPC			0x241
 #define CSR_VSCAUSE			0x242
 #define CSR_VSTVAL			0x243
@@ -329,6 +386,10 @@
 #define CSR_MCOUNTEREN			0x306
 #define CSR_MSTATUSH			0x310
 
+/* Machine Configuration */
+#define CSR_MENVCFG			0x30a
+#define CSR_MENVCFGH			0x31a
+
 /* Machine Trap Handling */
 #define CSR_MSCRATCH			0x340
 #define CSR_MEPC			0x341
@@ -338,6 +399,18 @@
 #define CSR_MTINST			0x34a
 #define CSR_MTVAL2			0x34b
 
+/* Machine-Level Window to Indirectly Accessed Registers (AIA) */
+#define CSR_MISELECT			0x350
+#define CSR_MIREG			0x351
+
+/* Machine-Level Interrupts (AIA) */
+#define CSR_MTOPEI			0x35c
+#define CSR_MTOPI			0xfb0
+
+/* Virtual Interrupts for Supervisor Level (AIA) */
+#define CSR_MVIEN			0x308
+#define CSR_MVIP			0x309
+
 /* Machine Memory Protection */
 #define CSR_PMPCFG0			0x3a0
 #define CSR_PMPCFG1			0x3a1
@@ -34,6 +34,95 @@ typedef struct {
 #define DEFINE_SPIN_LOCK(x)	\
 	spinlock_t SPIN_LOCK_INIT(x)
 
+/*
+ * Queued (MCS) spinlock where each waiter spins on a node of its own
+ * HART instead of the lock word. Meant for locks contended by many
+ * HARTs, it is larger and has higher uncontended cost than spinlock_t.
+ */
+typedef struct {
+	/* Node of the last queued HART */
+	volatile unsigned long tail;
+	/* Node of the lock holder */
+	unsigned long holder;
+	/* First waiter queued behind a holder without node */
+	volatile unsigned long nodeless_next;
+} qspinlock_t;
+
+#define __QSPIN_LOCK_UNLOCKED	\
+	(qspinlock_t) { 0, 0, 0 }
+
+#define QSPIN_LOCK_INIT(x)	\
+	x = __QSPIN_LOCK_UNLOCKED
+
+#define QSPIN_LOCK_INITIALIZER	\
+	__QSPIN_LOCK_UNLOCKED
+
+/*
+ * Sequence lock for read-mostly data. Readers never write the lock and
+ * retry when a writer was active, writers are serialized by a ticket
+ * lock. Readers must cope with reading inconsistent data before their
+ * retry check (no pointer chasing into freed memory).
+ */
+typedef struct {
+	/* Odd while a writer is updating the data */
+	volatile unsigned long seq;
+	spinlock_t lock;
+} seqlock_t;
+
+#define __SEQLOCK_UNLOCKED	\
+	(seqlock_t) { 0, { 0, 0 } }
+
+#define SEQLOCK_INIT(x)	\
+	x = __SEQLOCK_UNLOCKED
+
+#define SEQLOCK_INITIALIZER	\
+	__SEQLOCK_UNLOCKED
+
+#define DEFINE_SEQLOCK(x)	\
+	seqlock_t SEQLOCK_INIT(x)
+
+/*
+ * Reader-writer lock allowing many readers or one writer. Readers
+ * update the lock word so prefer seqlock_t for data read on hot paths.
+ * A stream of readers can starve writers.
+ */
+typedef struct {
+	/* Number of readers and RWLOCK_WRITER when write locked */
+	volatile unsigned long cnt;
+} rwlock_t;
+
+#define RWLOCK_WRITER		(1UL << (__riscv_xlen - 1))
+
+#define __RW_LOCK_UNLOCKED	\
+	(rwlock_t) { 0 }
+
+#define RW_LOCK_INIT(x)	\
+	x = __RW_LOCK_UNLOCKED
+
+#define RW_LOCK_INITIALIZER	\
+	__RW_LOCK_UNLOCKED
+
+#define DEFINE_RW_LOCK(x)	\
+	rwlock_t RW_LOCK_INIT(x)
+
+/**
+ * Wait until the value at given address may have changed
+ *
+ * A HART with Zawrs sleeps in WRS.NTO until the address is written or
+ * an interrupt enabled in MIE is pending. Other HARTs back off for a
+ * delay which doubles on every call up to a fixed bound. The wait can
+ * end before the value changed so callers re-check their condition.
+ *
+ * @param ptr address to watch
+ * @param val value last seen at the address
+ * @param backoff backoff state of the wait loop (zero before the loop)
+ */
+void spin_wait_u32(volatile u32 *ptr, u32 val, unsigned long *backoff);
+
+/** Same as spin_wait_u32() for an unsigned long */
+void spin_wait_ulong(volatile unsigned long *ptr, unsigned long val,
+		     unsigned long *backoff);
+
 int spin_lock_check(spinlock_t *lock);
 
 int spin_trylock(spinlock_t *lock);
@@ -42,4 +131,42 @@ void spin_lock(spinlock_t *lock);
 
 void spin_unlock(spinlock_t *lock);
 
+int qspin_lock_check(qspinlock_t *lock);
+
+int qspin_trylock(qspinlock_t *lock);
+
+void qspin_lock(qspinlock_t *lock);
+
+void qspin_unlock(qspinlock_t *lock);
+
+/**
+ * Allocate per-HART queue nodes of queued spinlocks
+ *
+ * Until this is done (or if it fails) queued spinlocks are taken by
+ * spinning on the lock word.
+ */
+int qspin_lock_init(void);
+
+/** Start a read side section and return the sequence to pass to retry */
+unsigned long read_seqbegin(seqlock_t *lock);
+
+/** Check whether the read side section started at seq has to be retried */
+bool read_seqretry(seqlock_t *lock, unsigned long seq);
+
+void write_seqlock(seqlock_t *lock);
+
+void write_sequnlock(seqlock_t *lock);
+
+int read_trylock(rwlock_t *lock);
+
+void read_lock(rwlock_t *lock);
+
+void read_unlock(rwlock_t *lock);
+
+int write_trylock(rwlock_t *lock);
+
+void write_lock(rwlock_t *lock);
+
+void write_unlock(rwlock_t *lock);
+
 #endif
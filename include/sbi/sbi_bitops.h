@@ -36,6 +36,40 @@
 #define GENMASK(h, l) \
 	(((~0UL) - (1UL << (l)) + 1) & (~0UL >> (BITS_PER_LONG - 1 - (h))))
 
+#ifdef __riscv_zbb
+
+/*
+ * With Zbb (enabled through PLATFORM_RISCV_ISA) the compiler builtins
+ * below become single ctz, clz and cpop instructions.
+ */
+
+static inline int ffs(int x)
+{
+	return __builtin_ffs(x);
+}
+
+static inline int __ffs(unsigned long word)
+{
+	return __builtin_ctzl(word);
+}
+
+static inline int fls(int x)
+{
+	return (x) ? 32 - __builtin_clz(x) : 0;
+}
+
+static inline unsigned long __fls(unsigned long word)
+{
+	return BITS_PER_LONG - 1 - __builtin_clzl(word);
+}
+
+static inline unsigned long hweight_long(unsigned long word)
+{
+	return __builtin_popcountl(word);
+}
+
+#else
+
 /**
  * ffs - Find first bit set
  * @x: the word to search
@@ -108,14 +142,6 @@ static inline int __ffs(unsigned long word)
 	return num;
 }
 
-/*
- * ffz - find first zero in word.
- * @word: The word to search
- *
- * Undefined if no zero exists, so code should check against ~0UL first.
- */
-#define ffz(x) __ffs(~(x))
-
 /**
  * fls - find last (most-significant) bit set
  * @x: the word to search
@@ -188,6 +214,29 @@ static inline unsigned long __fls(unsigned long word)
 	return num;
 }
 
+/**
+ * hweight_long - count the set bits of a long word
+ * @word: the word to count
+ */
+static inline unsigned long hweight_long(unsigned long word)
+{
+	unsigned long count = 0;
+
+	for (; word; word &= word - 1)
+		count++;
+	return count;
+}
+
+#endif
+
+/*
+ * ffz - find first zero in word.
+ * @word: The word to search
+ *
+ * Undefined if no zero exists, so code should check against ~0UL first.
+ */
+#define ffz(x) __ffs(~(x))
+
 #define for_each_set_bit(bit, addr, size) \
 	for ((bit) = find_first_bit((addr), (size));		\
 	     (bit) < (size);					\
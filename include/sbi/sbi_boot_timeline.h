@@ -0,0 +1,60 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifndef __SBI_BOOT_TIMELINE_H__
+#define __SBI_BOOT_TIMELINE_H__
+
+#include <sbi/sbi_types.h>
+
+/* clang-format off */
+
+/*
+ * Boot phases recorded at their end. Phases marked (cold) are only
+ * recorded on the coldboot HART and HSM_START is only recorded on other
+ * HARTs. EARLY_INIT is the scratch and domain initialization on the
+ * coldboot HART and the wait for the coldboot HART on other HARTs.
+ * DOMAIN_FINALIZE is the wait for cold boot to be done on other HARTs.
+ */
+#define SBI_BOOT_PHASE_EARLY_INIT		0
+#define SBI_BOOT_PHASE_HART_INIT		1
+#define SBI_BOOT_PHASE_CONSOLE_INIT		2	/* (cold) */
+#define SBI_BOOT_PHASE_IRQCHIP_INIT		3
+#define SBI_BOOT_PHASE_IPI_INIT			4
+#define SBI_BOOT_PHASE_TIMER_INIT		5
+#define SBI_BOOT_PHASE_PMU_INIT			6
+#define SBI_BOOT_PHASE_ECALL_INIT		7	/* (cold) */
+#define SBI_BOOT_PHASE_DOMAIN_FINALIZE		8
+#define SBI_BOOT_PHASE_PMP_CONFIGURE		9
+#define SBI_BOOT_PHASE_FINAL_INIT		10
+#define SBI_BOOT_PHASE_HSM_START		11
+#define SBI_BOOT_PHASE_NEXT_STAGE		12
+#define SBI_BOOT_PHASE_MAX			13
+
+/* clang-format on */
+
+struct sbi_scratch;
+
+/** Record the end of a boot phase on current HART */
+void sbi_boot_timeline_record(struct sbi_scratch *scratch, u32 phase);
+
+/**
+ * Get the timestamps of a boot phase
+ *
+ * @param hartid HART to query
+ * @param phase one of SBI_BOOT_PHASE_xyz
+ * @param out_cycle mcycle of the HART at the end of the phase
+ * @param out_time platform time at the end of the phase (zero before
+ * the timer is initialized)
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int sbi_boot_timeline_get(u32 hartid, u32 phase, u64 *out_cycle,
+			  u64 *out_time);
+
+/** Initialize (and clear) the boot timeline of current HART */
+int sbi_boot_timeline_init(struct sbi_scratch *scratch, bool cold_boot);
+
+#endif
@@ -0,0 +1,85 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifndef __SBI_CACHE_H__
+#define __SBI_CACHE_H__
+
+#include <sbi/sbi_types.h>
+
+/* clang-format off */
+
+/* Cache operations (same values as the CACHE firmware extension) */
+#define SBI_CACHE_OP_CLEAN			0
+#define SBI_CACHE_OP_INVAL			1
+#define SBI_CACHE_OP_FLUSH			2
+#define SBI_CACHE_OP_MAX			3
+
+/* Maximum number of ranges in one batched request */
+#define SBI_CACHE_RANGE_MAX			16
+
+/* clang-format on */
+
+/** One range of a batched cache request */
+struct sbi_cache_range {
+	/** One of SBI_CACHE_OP_xyz */
+	unsigned long op;
+	/** Physical start address */
+	unsigned long addr;
+	/** Size in bytes */
+	unsigned long size;
+};
+
+/** Cache maintenance device */
+struct sbi_cache_device {
+	/** Name of the cache device */
+	char name[32];
+
+	/** Size of a cache block in bytes (power of two) */
+	unsigned long block_size;
+
+	/**
+	 * TRUE if operations only reach the caches of current HART so
+	 * that they have to be broadcast to all other HARTs
+	 */
+	bool local;
+
+	/** Do a cache operation on the block containing the address */
+	void (*cache_block_op)(u32 op, unsigned long addr);
+
+	/**
+	 * Do a cache operation on the whole cache (optional)
+	 * Note: This is used instead of block operations for ranges of
+	 * at least all_threshold bytes. A whole cache invalidate would
+	 * discard unrelated data so it is turned into a flush.
+	 */
+	void (*cache_all_op)(u32 op);
+
+	/** Range size from which cache_all_op() is used */
+	unsigned long all_threshold;
+};
+
+struct sbi_scratch;
+
+/**
+ * Do cache operations on a list of physical address ranges
+ *
+ * The ranges are processed on current HART and, for devices with local
+ * operations, on all other HARTs of the domain before returning.
+ *
+ * @param ranges array of ranges
+ * @param count number of ranges (at most SBI_CACHE_RANGE_MAX)
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int sbi_cache_range_op(const struct sbi_cache_range *ranges, u32 count);
+
+const struct sbi_cache_device *sbi_cache_get_device(void);
+
+void sbi_cache_set_device(const struct sbi_cache_device *dev);
+
+int sbi_cache_init(struct sbi_scratch *scratch, bool cold_boot);
+
+#endif
@@ -19,6 +19,19 @@ struct sbi_console_device {
 	/** Write a character to the console output */
 	void (*console_putc)(char ch);
 
+	/**
+	 * Write characters (without newlines) to the console output
+	 * (optional). Returns the number of characters written which
+	 * must be at least one and may be less than len.
+	 */
+	unsigned long (*console_puts)(const char *str, unsigned long len);
+
+	/**
+	 * Check whether console_putc() would not wait (optional, used
+	 * to write out buffered output without stalling)
+	 */
+	bool (*console_putc_ready)(void);
+
 	/** Read a character from the console input */
 	int (*console_getc)(void);
 };
@@ -33,8 +46,12 @@ void sbi_putc(char ch);
 
 void sbi_puts(const char *str);
 
+unsigned long sbi_nputs(const char *str, unsigned long len);
+
 void sbi_gets(char *s, int maxwidth, char endchar);
 
+unsigned long sbi_ngets(char *str, unsigned long len);
+
 int __printf(2, 3) sbi_sprintf(char *out, const char *format, ...);
 
 int __printf(3, 4) sbi_snprintf(char *out, u32 out_sz, const char *format, ...);
@@ -47,6 +64,12 @@ const struct sbi_console_device *sbi_console_get_device(void);
 
 void sbi_console_set_device(const struct sbi_console_device *dev);
 
+/** Write out buffered console output if the console is not busy */
+void sbi_console_poll(void);
+
+/** Synchronously write out all buffered console output */
+void sbi_console_flush(void);
+
 struct sbi_scratch;
 
 int sbi_console_init(struct sbi_scratch *scratch);
@@ -0,0 +1,37 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifndef __SBI_CPPC_H__
+#define __SBI_CPPC_H__
+
+#include <sbi/sbi_types.h>
+
+/** CPPC hardware device, registers are those of the calling HART */
+struct sbi_cppc_device {
+	/** Name of the CPPC device */
+	char name[32];
+
+	/** Get the width (in bits) of a register, zero if not implemented */
+	int (*cppc_probe)(unsigned long reg);
+
+	/** Read a register */
+	int (*cppc_read)(unsigned long reg, u64 *val);
+
+	/** Write a register */
+	int (*cppc_write)(unsigned long reg, u64 val);
+};
+
+int sbi_cppc_probe(unsigned long reg);
+
+int sbi_cppc_read(unsigned long reg, u64 *val);
+
+int sbi_cppc_write(unsigned long reg, u64 val);
+
+const struct sbi_cppc_device *sbi_cppc_get_device(void);
+
+void sbi_cppc_set_device(const struct sbi_cppc_device *dev);
+
+#endif
@@ -10,10 +10,11 @@
 #ifndef __SBI_DOMAIN_H__
 #define __SBI_DOMAIN_H__
 
+#include <sbi/riscv_locks.h>
 #include <sbi/sbi_types.h>
+#include <sbi/sbi_ecall.h>
 #include <sbi/sbi_hartmask.h>
-
-struct sbi_scratch;
+#include <sbi/sbi_scratch.h>
 
 /** Domain access types */
 enum sbi_domain_access {
@@ -78,6 +79,38 @@ struct sbi_domain {
 	unsigned long next_mode;
 	/** Is domain allowed to reset the system */
 	bool system_reset_allowed;
+	/** Is domain allowed to suspend the system */
+	bool system_suspend_allowed;
+	/**
+	 * Can possible HARTs of this domain enter it from their assigned
+	 * domain using a domain context switch
+	 */
+	bool context_entry_allowed;
+	/**
+	 * Are memory regions not fitting in the PMP entries swapped in
+	 * on access faults (see sbi_pmp_swap.h)
+	 */
+	bool pmp_swap;
+	/**
+	 * Timer ticks in which one IPI or remote fence request of the
+	 * domain is allowed on average, zero for no rate limit
+	 */
+	u64 ipi_rate_interval;
+	/** Number of requests allowed back-to-back, at least one */
+	u32 ipi_rate_burst;
+	/** Protects ipi_rate_tat and ipi_throttled */
+	spinlock_t ipi_rate_lock;
+	/** Time at which the rate limiter is back to a full burst */
+	u64 ipi_rate_tat;
+	/** Number of requests delayed by the rate limiter */
+	unsigned long ipi_throttled;
+	/**
+	 * Ecall extensions which the domain may use sorted by extid_start
+	 * or all registered extensions when ecall_exts_count is zero
+	 */
+	struct sbi_ecall_extension *ecall_exts[SBI_ECALL_EXTS_MAX];
+	/** Number of entries in ecall_exts */
+	u32 ecall_exts_count;
 };
 
 /** The root domain instance */
@@ -90,9 +123,26 @@ extern struct sbi_domain *hartid_to_domain_table[];
 #define sbi_hartid_to_domain(__hartid) \
 	hartid_to_domain_table[__hartid]
 
-/** Get pointer to sbi_domain for current HART */
+/**
+ * Get pointer to sbi_domain for current HART
+ *
+ * This uses the copy of the hartid to domain table entry cached in the
+ * scratch space of the HART so it needs neither mhartid nor the table.
+ */
 #define sbi_domain_thishart_ptr() \
-	sbi_hartid_to_domain(current_hartid())
+	((struct sbi_domain *)(sbi_scratch_thishart_ptr()->domain_addr))
+
+/**
+ * Change the domain of a HART
+ *
+ * This updates both the hartid to domain table and the domain cached in
+ * the scratch space of the HART. It does not change the assigned HARTs
+ * of any domain.
+ *
+ * @param hartid the HART whose domain is changed
+ * @param dom pointer to the new domain of the HART
+ */
+void sbi_update_hartid_to_domain(u32 hartid, struct sbi_domain *dom);
 
 /** Index to domain table */
 extern struct sbi_domain *domidx_to_domain_table[];
@@ -141,6 +191,18 @@ void sbi_domain_memregion_init(unsigned long addr,
 				unsigned long flags,
 				struct sbi_domain_memregion *reg);
 
+/**
+ * Find the memory region of a domain which decides the access to an
+ * address in given mode
+ * @param dom pointer to domain
+ * @param addr the address to be looked up
+ * @param mode the privilege mode of access
+ * @return pointer to the memory region or NULL if there is none
+ */
+const struct sbi_domain_memregion *sbi_domain_find_memregion(
+					const struct sbi_domain *dom,
+					unsigned long addr, unsigned long mode);
+
 /**
  * Check whether we can access specified address for given mode and
  * memory region flags under a domain
@@ -154,10 +216,25 @@ bool sbi_domain_check_addr(const struct sbi_domain *dom,
 			   unsigned long addr, unsigned long mode,
 			   unsigned long access_flags);
 
-/** Dump domain details on the console */
+/**
+ * Check whether we can access specified address range for given mode
+ * and memory region flags under a domain
+ * @param dom pointer to domain
+ * @param addr the start of the address range to be checked
+ * @param size the size of the address range to be checked
+ * @param mode the privilege mode of access
+ * @param access_flags bitmask of domain access types (enum sbi_domain_access)
+ * @return TRUE if access allowed otherwise FALSE
+ */
+bool sbi_domain_check_addr_range(const struct sbi_domain *dom,
+				 unsigned long addr, unsigned long size,
+				 unsigned long mode,
+				 unsigned long access_flags);
+
+/** Dump domain details on the console (only during cold boot) */
 void sbi_domain_dump(const struct sbi_domain *dom, const char *suffix);
 
-/** Dump all domain details on the console */
+/** Dump all domain details on the console (only during cold boot) */
 void sbi_domain_dump_all(const char *suffix);
 
 /**
@@ -178,6 +255,24 @@ int sbi_domain_register(struct sbi_domain *dom,
  */
 int sbi_domain_root_add_memregion(const struct sbi_domain_memregion *reg);
 
+/**
+ * Get the block of cold boot only firmware memory given to the root domain
+ * @param scratch pointer to the cold boot HART scratch space
+ * @param reg pointer to the memory region to be filled
+ *
+ * @return 0 on success and SBI_ENOENT if no memory is reclaimed
+ */
+int sbi_domain_fw_init_region(struct sbi_scratch *scratch,
+			      struct sbi_domain_memregion *reg);
+
+/**
+ * Give the cold boot only firmware memory to the root domain
+ *
+ * This is called by the cold boot HART right before it switches to the
+ * next booting stage, after all other cold boot only code has run.
+ */
+void sbi_domain_fw_init_reclaim(struct sbi_scratch *scratch);
+
 /** Finalize domain tables and startup non-root domains */
 int sbi_domain_finalize(struct sbi_scratch *scratch, u32 cold_hartid);
 
@@ -0,0 +1,46 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifndef __SBI_DOMAIN_CONTEXT_H__
+#define __SBI_DOMAIN_CONTEXT_H__
+
+#include <sbi/sbi_types.h>
+
+struct sbi_domain;
+struct sbi_scratch;
+struct sbi_trap_regs;
+
+/**
+ * Enter a domain from the assigned domain of current HART
+ *
+ * The context of the current domain is saved and the context of the
+ * entered domain is restored (or set up for its next booting stage on
+ * first entry) into the trap registers.
+ *
+ * @param dom domain to enter (must allow context entry)
+ * @param arg argument passed to the entered domain
+ * @param regs trap registers of current HART
+ *
+ * @return SBI_ECONTEXT on success and negative error code on failure
+ */
+int sbi_domain_context_enter(struct sbi_domain *dom, unsigned long arg,
+			     struct sbi_trap_regs *regs);
+
+/**
+ * Exit from an entered domain back to the assigned domain
+ *
+ * @param result value returned to the assigned domain
+ * @param regs trap registers of current HART
+ *
+ * @return SBI_ECONTEXT on success and negative error code on failure
+ */
+int sbi_domain_context_exit(unsigned long result,
+			    struct sbi_trap_regs *regs);
+
+/** Initialize (and reset) domain contexts of current HART */
+int sbi_domain_context_init(struct sbi_scratch *scratch, bool cold_boot);
+
+#endif
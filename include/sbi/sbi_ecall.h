@@ -17,6 +17,9 @@
 #define SBI_ECALL_VERSION_MINOR		3
 #define SBI_OPENSBI_IMPID		1
 
+#define SBI_ECALL_EXTS_MAX		32
+
+struct sbi_domain;
 struct sbi_trap_regs;
 struct sbi_trap_info;
 
@@ -32,13 +35,61 @@ struct sbi_ecall_extension {
 };
 
 extern struct sbi_ecall_extension ecall_base;
+#ifndef SBI_ECALL_LEGACY_DISABLED
 extern struct sbi_ecall_extension ecall_legacy;
+#endif
+#ifndef SBI_ECALL_TIME_DISABLED
 extern struct sbi_ecall_extension ecall_time;
+#endif
+#ifndef SBI_ECALL_RFENCE_DISABLED
 extern struct sbi_ecall_extension ecall_rfence;
+extern struct sbi_ecall_extension ecall_rfence_stride;
+extern struct sbi_ecall_extension ecall_rfence_batch;
+extern struct sbi_ecall_extension ecall_rfence_async;
+#endif
+#ifndef SBI_ECALL_IPI_DISABLED
 extern struct sbi_ecall_extension ecall_ipi;
+#endif
+#ifndef SBI_ECALL_VENDOR_DISABLED
 extern struct sbi_ecall_extension ecall_vendor;
+#endif
+#ifndef SBI_ECALL_HSM_DISABLED
 extern struct sbi_ecall_extension ecall_hsm;
+#endif
+#ifndef SBI_ECALL_SRST_DISABLED
 extern struct sbi_ecall_extension ecall_srst;
+extern struct sbi_ecall_extension ecall_warm_restart;
+#endif
+#ifndef SBI_ECALL_PMU_DISABLED
+extern struct sbi_ecall_extension ecall_pmu;
+#endif
+#ifndef SBI_ECALL_DBCN_DISABLED
+extern struct sbi_ecall_extension ecall_dbcn;
+#endif
+#ifndef SBI_ECALL_SUSP_DISABLED
+extern struct sbi_ecall_extension ecall_susp;
+#endif
+#ifndef SBI_ECALL_CPPC_DISABLED
+extern struct sbi_ecall_extension ecall_cppc;
+#endif
+extern struct sbi_ecall_extension ecall_boot_timeline;
+extern struct sbi_ecall_extension ecall_time_sync;
+extern struct sbi_ecall_extension ecall_cache;
+extern struct sbi_ecall_extension ecall_domain_context;
+extern struct sbi_ecall_extension ecall_fw_feature;
+extern struct sbi_ecall_extension ecall_multicall;
+#ifdef SBI_STEAL_TIME
+extern struct sbi_ecall_extension ecall_sta;
+#endif
+#ifdef SBI_TRAP_STATS
+extern struct sbi_ecall_extension ecall_trap_stats;
+#endif
+#ifdef SBI_TRACE
+extern struct sbi_ecall_extension ecall_trace;
+#endif
+#ifdef SBI_LOCK_STATS
+extern struct sbi_ecall_extension ecall_lock_stats;
+#endif
 
 u16 sbi_ecall_version_major(void);
 
@@ -54,6 +105,11 @@ int sbi_ecall_register_extension(struct sbi_ecall_extension *ext);
 
 void sbi_ecall_unregister_extension(struct sbi_ecall_extension *ext);
 
+int sbi_ecall_domain_allow(struct sbi_domain *dom, unsigned long extid);
+
+bool sbi_ecall_domain_allowed(const struct sbi_domain *dom,
+			      unsigned long extid);
+
 int sbi_ecall_handler(struct sbi_trap_regs *regs);
 
 int sbi_ecall_init(void);
@@ -28,6 +28,24 @@
 #define SBI_EXT_RFENCE				0x52464E43
 #define SBI_EXT_HSM				0x48534D
 #define SBI_EXT_SRST				0x53525354
+#define SBI_EXT_PMU				0x504D55
+#define SBI_EXT_DBCN				0x4442434E
+#define SBI_EXT_SUSP				0x53555350
+#define SBI_EXT_CPPC				0x43505043
+#define SBI_EXT_STA				0x535441
+#define SBI_EXT_RFENCE_STRIDE			0x08524643
+#define SBI_EXT_TRAP_STATS			0x0A545253
+#define SBI_EXT_BOOT_TIMELINE			0x0A42544C
+#define SBI_EXT_DOMAIN_CONTEXT			0x0A444358
+#define SBI_EXT_TIME_SYNC			0x0A545359
+#define SBI_EXT_CACHE				0x0A434D4F
+#define SBI_EXT_TRACE				0x0A545243
+#define SBI_EXT_LOCK_STATS			0x0A4C4B53
+#define SBI_EXT_FW_FEATURE			0x0A465746
+#define SBI_EXT_RFENCE_BATCH			0x0A524642
+#define SBI_EXT_MULTICALL			0x0A4D434C
+#define SBI_EXT_WARM_RESTART			0x0A57524D
+#define SBI_EXT_RFENCE_ASYNC			0x0A524641
 
 /* SBI function IDs for BASE extension*/
 #define SBI_EXT_BASE_GET_SPEC_VERSION		0x0
@@ -53,6 +71,128 @@
 #define SBI_EXT_RFENCE_REMOTE_HFENCE_VVMA_ASID	0x5
 #define SBI_EXT_RFENCE_REMOTE_HFENCE_VVMA	0x6
 
+/*
+ * SBI RFENCE_STRIDE experimental extension uses RFENCE function IDs
+ * and takes log2 of the flush stride as last argument (a5)
+ */
+#define SBI_RFENCE_STRIDE_ORDER_MAX		(__riscv_xlen - 1)
+
+/* SBI function IDs for DBCN extension */
+#define SBI_EXT_DBCN_CONSOLE_WRITE		0x0
+#define SBI_EXT_DBCN_CONSOLE_READ		0x1
+#define SBI_EXT_DBCN_CONSOLE_WRITE_BYTE		0x2
+
+/* SBI function IDs for SUSP extension */
+#define SBI_EXT_SUSP_SUSPEND			0x0
+
+#define SBI_SUSP_SLEEP_TYPE_SUSPEND		0x0
+#define SBI_SUSP_SLEEP_TYPE_LAST		SBI_SUSP_SLEEP_TYPE_SUSPEND
+#define SBI_SUSP_PLATFORM_SLEEP_START		0x80000000
+
+/* SBI function IDs for CPPC extension */
+#define SBI_EXT_CPPC_PROBE			0x0
+#define SBI_EXT_CPPC_READ			0x1
+#define SBI_EXT_CPPC_READ_HI			0x2
+#define SBI_EXT_CPPC_WRITE			0x3
+
+/* CPPC register IDs */
+#define SBI_CPPC_HIGHEST_PERF			0x00000000
+#define SBI_CPPC_NOMINAL_PERF			0x00000001
+#define SBI_CPPC_LOW_NON_LINEAR_PERF		0x00000002
+#define SBI_CPPC_LOWEST_PERF			0x00000003
+#define SBI_CPPC_GUARANTEED_PERF		0x00000004
+#define SBI_CPPC_DESIRED_PERF			0x00000005
+#define SBI_CPPC_MIN_PERF			0x00000006
+#define SBI_CPPC_MAX_PERF			0x00000007
+#define SBI_CPPC_PERF_REDUC_TOLERANCE		0x00000008
+#define SBI_CPPC_TIME_WINDOW			0x00000009
+#define SBI_CPPC_CTR_WRAP_TIME			0x0000000A
+#define SBI_CPPC_REFERENCE_CTR			0x0000000B
+#define SBI_CPPC_DELIVERED_CTR			0x0000000C
+#define SBI_CPPC_PERF_LIMITED			0x0000000D
+#define SBI_CPPC_ENABLE				0x0000000E
+#define SBI_CPPC_AUTO_SEL_ENABLE		0x0000000F
+#define SBI_CPPC_AUTO_ACT_WINDOW		0x00000010
+#define SBI_CPPC_ENERGY_PERF_PREFERENCE		0x00000011
+#define SBI_CPPC_REFERENCE_PERF			0x00000012
+#define SBI_CPPC_LOWEST_FREQ			0x00000013
+#define SBI_CPPC_NOMINAL_FREQ			0x00000014
+#define SBI_CPPC_ACPI_LAST			SBI_CPPC_NOMINAL_FREQ
+#define SBI_CPPC_TRANSITION_LATENCY		0x80000000
+#define SBI_CPPC_NON_ACPI_LAST			SBI_CPPC_TRANSITION_LATENCY
+
+/* SBI function IDs for STA extension */
+#define SBI_EXT_STA_STEAL_TIME_SET_SHMEM	0x0
+
+/* SBI function IDs for OpenSBI TRAP_STATS firmware extension */
+#define SBI_EXT_TRAP_STATS_DUMP			0x0
+#define SBI_EXT_TRAP_STATS_RESET		0x1
+#define SBI_EXT_TRAP_STATS_GET_COUNT		0x2
+#define SBI_EXT_TRAP_STATS_GET_CYCLES		0x3
+#define SBI_EXT_TRAP_STATS_GET_HIST		0x4
+
+/* SBI function IDs for OpenSBI BOOT_TIMELINE firmware extension */
+#define SBI_EXT_BOOT_TIMELINE_NUM_PHASES	0x0
+#define SBI_EXT_BOOT_TIMELINE_GET_CYCLE		0x1
+#define SBI_EXT_BOOT_TIMELINE_GET_TIME		0x2
+
+/* SBI function IDs for OpenSBI DOMAIN_CONTEXT firmware extension */
+#define SBI_EXT_DOMAIN_CONTEXT_ENTER		0x0
+#define SBI_EXT_DOMAIN_CONTEXT_EXIT		0x1
+
+/* SBI function IDs for OpenSBI TIME_SYNC firmware extension */
+#define SBI_EXT_TIME_SYNC_GET_SKEW		0x0
+#define SBI_EXT_TIME_SYNC_GET_ERROR		0x1
+
+/* SBI function IDs for OpenSBI CACHE firmware extension */
+#define SBI_EXT_CACHE_CLEAN_RANGE		0x0
+#define SBI_EXT_CACHE_INVAL_RANGE		0x1
+#define SBI_EXT_CACHE_FLUSH_RANGE		0x2
+#define SBI_EXT_CACHE_RANGE_LIST		0x3
+
+/* SBI function IDs for OpenSBI TRACE firmware extension */
+#define SBI_EXT_TRACE_GET_BUFFER		0x0
+#define SBI_EXT_TRACE_SET_MASK			0x1
+
+/* SBI function IDs for OpenSBI LOCK_STATS firmware extension */
+#define SBI_EXT_LOCK_STATS_DUMP			0x0
+#define SBI_EXT_LOCK_STATS_RESET		0x1
+
+/* SBI function IDs for OpenSBI FW_FEATURE firmware extension */
+#define SBI_EXT_FW_FEATURE_SET			0x0
+#define SBI_EXT_FW_FEATURE_GET			0x1
+
+/* Feature IDs of OpenSBI FW_FEATURE firmware extension */
+#define SBI_FW_FEATURE_MISALIGNED_DELEG		0x0
+#define SBI_FW_FEATURE_IPI_POLL			0x1
+#define SBI_FW_FEATURE_MISALIGNED_STORM_LIMIT	0x2
+#define SBI_FW_FEATURE_MISALIGNED_STORM_WINDOW	0x3
+#define SBI_FW_FEATURE_MISALIGNED_STORM_DELEG	0x4
+#define SBI_FW_FEATURE_TIMER_SLACK		0x5
+
+/* SBI function IDs for OpenSBI RFENCE_BATCH firmware extension */
+#define SBI_EXT_RFENCE_BATCH_SET_SHMEM		0x0
+#define SBI_EXT_RFENCE_BATCH_SUBMIT		0x1
+
+/* Shared memory address which disables the RFENCE_BATCH shared memory */
+#define SBI_RFENCE_BATCH_SHMEM_DISABLE		(-1UL)
+
+/* SBI function IDs for OpenSBI RFENCE_ASYNC firmware extension */
+#define SBI_EXT_RFENCE_ASYNC_SET_SHMEM		0x0
+#define SBI_EXT_RFENCE_ASYNC_REMOTE_FENCE	0x1
+
+/* Shared memory address which disables the RFENCE_ASYNC completion word */
+#define SBI_RFENCE_ASYNC_SHMEM_DISABLE		(-1UL)
+
+/* RFENCE_ASYNC completion raises an S-mode IPI on the calling HART */
+#define SBI_RFENCE_ASYNC_FLAG_SSIP		(1UL << 0)
+
+/* SBI function IDs for OpenSBI MULTICALL firmware extension */
+#define SBI_EXT_MULTICALL_EXECUTE		0x0
+
+/* SBI function IDs for OpenSBI WARM_RESTART firmware extension */
+#define SBI_EXT_WARM_RESTART_RESTART		0x0
+
 /* SBI function IDs for HSM extension */
 #define SBI_EXT_HSM_HART_START			0x0
 #define SBI_EXT_HSM_HART_STOP			0x1
@@ -91,9 +231,102 @@
 #define SBI_SRST_RESET_REASON_NONE	0x0
 #define SBI_SRST_RESET_REASON_SYSFAIL	0x1
 
+/* SBI function IDs for PMU extension */
+#define SBI_EXT_PMU_NUM_COUNTERS		0x0
+#define SBI_EXT_PMU_COUNTER_GET_INFO		0x1
+#define SBI_EXT_PMU_COUNTER_CFG_MATCH		0x2
+#define SBI_EXT_PMU_COUNTER_START		0x3
+#define SBI_EXT_PMU_COUNTER_STOP		0x4
+#define SBI_EXT_PMU_COUNTER_FW_READ		0x5
+
+/* SBI PMU event types (event_idx[19:16]) */
+#define SBI_PMU_EVENT_TYPE_HW			0x0
+#define SBI_PMU_EVENT_TYPE_HW_CACHE		0x1
+#define SBI_PMU_EVENT_TYPE_HW_RAW		0x2
+#define SBI_PMU_EVENT_TYPE_FW			0xf
+
+#define SBI_PMU_EVENT_IDX_TYPE_OFFSET		16
+#define SBI_PMU_EVENT_IDX_TYPE_MASK		(0xf << 16)
+#define SBI_PMU_EVENT_IDX_CODE_MASK		0xffff
+#define SBI_PMU_EVENT_IDX_MASK			0xfffff
+
+/* SBI PMU hardware general event codes */
+#define SBI_PMU_HW_NO_EVENT			0x0
+#define SBI_PMU_HW_CPU_CYCLES			0x1
+#define SBI_PMU_HW_INSTRUCTIONS			0x2
+#define SBI_PMU_HW_CACHE_REFERENCES		0x3
+#define SBI_PMU_HW_CACHE_MISSES			0x4
+#define SBI_PMU_HW_BRANCH_INSTRUCTIONS		0x5
+#define SBI_PMU_HW_BRANCH_MISSES		0x6
+#define SBI_PMU_HW_BUS_CYCLES			0x7
+#define SBI_PMU_HW_STALLED_CYCLES_FRONTEND	0x8
+#define SBI_PMU_HW_STALLED_CYCLES_BACKEND	0x9
+#define SBI_PMU_HW_REF_CPU_CYCLES		0xa
+
+/* SBI PMU firmware event codes */
+#define SBI_PMU_FW_MISALIGNED_LOAD		0x0
+#define SBI_PMU_FW_MISALIGNED_STORE		0x1
+#define SBI_PMU_FW_ACCESS_LOAD			0x2
+#define SBI_PMU_FW_ACCESS_STORE			0x3
+#define SBI_PMU_FW_ILLEGAL_INSN			0x4
+#define SBI_PMU_FW_SET_TIMER			0x5
+#define SBI_PMU_FW_IPI_SENT			0x6
+#define SBI_PMU_FW_IPI_RECVD			0x7
+#define SBI_PMU_FW_FENCE_I_SENT			0x8
+#define SBI_PMU_FW_FENCE_I_RECVD		0x9
+#define SBI_PMU_FW_SFENCE_VMA_SENT		0xa
+#define SBI_PMU_FW_SFENCE_VMA_RECVD		0xb
+#define SBI_PMU_FW_SFENCE_VMA_ASID_SENT		0xc
+#define SBI_PMU_FW_SFENCE_VMA_ASID_RECVD	0xd
+#define SBI_PMU_FW_HFENCE_GVMA_SENT		0xe
+#define SBI_PMU_FW_HFENCE_GVMA_RECVD		0xf
+#define SBI_PMU_FW_HFENCE_GVMA_VMID_SENT	0x10
+#define SBI_PMU_FW_HFENCE_GVMA_VMID_RECVD	0x11
+#define SBI_PMU_FW_HFENCE_VVMA_SENT		0x12
+#define SBI_PMU_FW_HFENCE_VVMA_RECVD		0x13
+#define SBI_PMU_FW_HFENCE_VVMA_ASID_SENT	0x14
+#define SBI_PMU_FW_HFENCE_VVMA_ASID_RECVD	0x15
+#define SBI_PMU_FW_MAX				0x16
+
+/* OpenSBI specific firmware event codes */
+#define SBI_PMU_FW_OPENSBI_START		0x100
+#define SBI_PMU_FW_EMULATED_CSR			0x100
+#define SBI_PMU_FW_IPI_PROCESS			0x101
+#define SBI_PMU_FW_TLB_PROCESS			0x102
+#define SBI_PMU_FW_EMULATED_INSN		0x103
+#define SBI_PMU_FW_PC_SAMPLE			0x104
+#define SBI_PMU_FW_PMP_SWAP			0x105
+#define SBI_PMU_FW_MISALIGNED_STORM		0x106
+#define SBI_PMU_FW_IPI_THROTTLED		0x107
+#define SBI_PMU_FW_OPENSBI_END			0x107
+
+/* SBI PMU counter info (counter_info[XLEN-1] = type, [17:12] = width - 1) */
+#define SBI_PMU_CTR_INFO_CSR_MASK		0xfff
+#define SBI_PMU_CTR_INFO_WIDTH_OFFSET		12
+#define SBI_PMU_CTR_INFO_WIDTH_MASK		0x3f
+#define SBI_PMU_CTR_INFO_TYPE_FW		(1UL << (__riscv_xlen - 1))
+
+/* Flags defined for config matching function */
+#define SBI_PMU_CFG_FLAG_SKIP_MATCH		(1 << 0)
+#define SBI_PMU_CFG_FLAG_CLEAR_VALUE		(1 << 1)
+#define SBI_PMU_CFG_FLAG_AUTO_START		(1 << 2)
+#define SBI_PMU_CFG_FLAG_SET_VUINH		(1 << 3)
+#define SBI_PMU_CFG_FLAG_SET_VSINH		(1 << 4)
+#define SBI_PMU_CFG_FLAG_SET_UINH		(1 << 5)
+#define SBI_PMU_CFG_FLAG_SET_SINH		(1 << 6)
+#define SBI_PMU_CFG_FLAG_SET_MINH		(1 << 7)
+
+/* Flags defined for counter start function */
+#define SBI_PMU_START_FLAG_SET_INIT_VALUE	(1 << 0)
+
+/* Flags defined for counter stop function */
+#define SBI_PMU_STOP_FLAG_RESET			(1 << 0)
+
 #define SBI_SPEC_VERSION_MAJOR_OFFSET		24
 #define SBI_SPEC_VERSION_MAJOR_MASK		0x7f
 #define SBI_SPEC_VERSION_MINOR_MASK		0xffffff
+#define SBI_EXT_EXPERIMENTAL_START		0x08000000
+#define SBI_EXT_EXPERIMENTAL_END		0x08FFFFFF
 #define SBI_EXT_VENDOR_START			0x09000000
 #define SBI_EXT_VENDOR_END			0x09FFFFFF
 #define SBI_EXT_FIRMWARE_START			0x0A000000
@@ -107,8 +340,10 @@
 #define SBI_ERR_DENIED				-4
 #define SBI_ERR_INVALID_ADDRESS			-5
 #define SBI_ERR_ALREADY_AVAILABLE		-6
+#define SBI_ERR_ALREADY_STARTED			-7
+#define SBI_ERR_ALREADY_STOPPED			-8
 
-#define SBI_LAST_ERR				SBI_ERR_ALREADY_AVAILABLE
+#define SBI_LAST_ERR				SBI_ERR_ALREADY_STOPPED
 
 /* clang-format on */
 
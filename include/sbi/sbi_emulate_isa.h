@@ -0,0 +1,25 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifndef __SBI_EMULATE_ISA_H__
+#define __SBI_EMULATE_ISA_H__
+
+#include <sbi/sbi_types.h>
+
+struct sbi_trap_regs;
+
+/**
+ * Emulate a Zba/Zbb/Zbs or Zicbom instruction not implemented by the HART
+ *
+ * @param insn the illegal instruction
+ * @param regs pointer to the trap registers
+ *
+ * @return SBI_ENOTSUPP if the instruction is not emulated and otherwise
+ * the result of completing (or redirecting) it
+ */
+int sbi_emulate_isa_insn(ulong insn, struct sbi_trap_regs *regs);
+
+#endif
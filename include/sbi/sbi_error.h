@@ -21,6 +21,8 @@
 #define SBI_EDENIED		SBI_ERR_DENIED
 #define SBI_EINVALID_ADDR	SBI_ERR_INVALID_ADDRESS
 #define SBI_EALREADY		SBI_ERR_ALREADY_AVAILABLE
+#define SBI_EALREADY_STARTED	SBI_ERR_ALREADY_STARTED
+#define SBI_EALREADY_STOPPED	SBI_ERR_ALREADY_STOPPED
 
 #define SBI_ENODEV		-1000
 #define SBI_ENOSYS		-1001
@@ -32,6 +34,7 @@
 #define SBI_ETRAP		-1007
 #define SBI_EUNKNOWN		-1008
 #define SBI_ENOENT		-1009
+#define SBI_ECONTEXT		-1010
 
 /* clang-format on */
 
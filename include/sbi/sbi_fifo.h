@@ -16,7 +16,7 @@
 
 struct sbi_fifo {
 	void *queue;
-	spinlock_t qlock;
+	qspinlock_t qlock;
 	u16 entry_size;
 	u16 num_entries;
 	u16 avail;
@@ -30,6 +30,7 @@ enum sbi_fifo_inplace_update_types {
 };
 
 int sbi_fifo_dequeue(struct sbi_fifo *fifo, void *data);
+int sbi_fifo_dequeue_many(struct sbi_fifo *fifo, void *data, u16 count);
 int sbi_fifo_enqueue(struct sbi_fifo *fifo, void *data);
 void sbi_fifo_init(struct sbi_fifo *fifo, void *queue_mem, u16 entries,
 		   u16 entry_size);
@@ -20,16 +20,88 @@ enum sbi_hart_features {
 	SBI_HART_HAS_MCOUNTEREN = (1 << 1),
 	/** HART has timer csr implementation in hardware */
 	SBI_HART_HAS_TIME = (1 << 2),
+	/** HART has Svinval extension */
+	SBI_HART_HAS_SVINVAL = (1 << 3),
+	/** HART has M-mode counter inhibit CSR */
+	SBI_HART_HAS_MCOUNTINHIBIT = (1 << 4),
+	/** HART has Sscofpmf extension (counter overflow interrupt) */
+	SBI_HART_HAS_SSCOFPMF = (1 << 5),
+	/** HART has Zawrs extension (wait on reservation set) */
+	SBI_HART_HAS_ZAWRS = (1 << 6),
+	/** HART has Zacas extension (atomic compare and swap) */
+	SBI_HART_HAS_ZACAS = (1 << 7),
+	/** HART has H extension (cached result of misa_extension('H')) */
+	SBI_HART_HAS_H = (1 << 8),
+	/** HART has Sstc extension (supervisor timer compare CSR) */
+	SBI_HART_HAS_SSTC = (1 << 9),
+	/** HART has htimedelta CSR implementation in hardware */
+	SBI_HART_HAS_HTIMEDELTA = (1 << 10),
+	/** HART has Zicboz extension (cache block zero) */
+	SBI_HART_HAS_ZICBOZ = (1 << 11),
+	/** HART has Zicbom extension (cache block management) */
+	SBI_HART_HAS_ZICBOM = (1 << 12),
+	/** HART has Svpbmt extension (page based memory types) */
+	SBI_HART_HAS_SVPBMT = (1 << 13),
 
 	/** Last index of Hart features*/
-	SBI_HART_HAS_LAST_FEATURE = SBI_HART_HAS_TIME,
+	SBI_HART_HAS_LAST_FEATURE = SBI_HART_HAS_SVPBMT,
 };
 
+/** Speed of misaligned loads and stores as seen by S-mode */
+enum sbi_hart_misaligned_perf {
+	/** Not probed or not measurable */
+	SBI_HART_MISALIGNED_UNKNOWN = 0,
+	/** Trapping and emulated by the firmware */
+	SBI_HART_MISALIGNED_EMULATED,
+	/** Handled in hardware but slower than aligned accesses */
+	SBI_HART_MISALIGNED_SLOW,
+	/** Handled in hardware about as fast as aligned accesses */
+	SBI_HART_MISALIGNED_FAST,
+};
+
+/** Fields of struct sbi_hart_desc provided by the platform */
+enum sbi_hart_desc_valid {
+	/** pmp_count is valid */
+	SBI_HART_DESC_PMP_COUNT = (1 << 0),
+	/** mhpm_count is valid */
+	SBI_HART_DESC_MHPM_COUNT = (1 << 1),
+};
+
+/**
+ * HART properties known to the platform (e.g. from the device tree)
+ * which replace trap based probing when the HART is first started.
+ * Features not set in features_known are still probed.
+ */
+struct sbi_hart_desc {
+	/** Bitmask of SBI_HART_DESC_xyz */
+	unsigned long valid;
+	/** Number of implemented PMP regions */
+	u32 pmp_count;
+	/** Number of implemented MHPM counters */
+	u32 mhpm_count;
+	/** SBI_HART_HAS_xyz features which are implemented */
+	unsigned long features;
+	/** SBI_HART_HAS_xyz features for which features is authoritative */
+	unsigned long features_known;
+};
+
+struct sbi_domain;
+struct sbi_domain_memregion;
 struct sbi_scratch;
 
 int sbi_hart_reinit(struct sbi_scratch *scratch);
 int sbi_hart_init(struct sbi_scratch *scratch, bool cold_boot);
 
+/** Save the M-mode CSRs of current HART before a non-retentive suspend */
+void sbi_hart_csr_save(struct sbi_scratch *scratch);
+
+/**
+ * Restore the M-mode CSRs saved by sbi_hart_csr_save() on resume
+ *
+ * @return 0 on success and SBI_ENOENT if nothing was saved
+ */
+int sbi_hart_csr_restore(struct sbi_scratch *scratch);
+
 extern void (*sbi_hart_expected_trap)(void);
 static inline ulong sbi_hart_expected_trap_addr(void)
 {
@@ -37,11 +109,22 @@ static inline ulong sbi_hart_expected_trap_addr(void)
 }
 
 unsigned int sbi_hart_mhpm_count(struct sbi_scratch *scratch);
+bool sbi_hart_features_detected(struct sbi_scratch *scratch);
+unsigned long sbi_hart_vlenb(struct sbi_scratch *scratch);
+unsigned long sbi_hart_cboz_block_size(struct sbi_scratch *scratch);
 void sbi_hart_delegation_dump(struct sbi_scratch *scratch,
 			      const char *prefix, const char *suffix);
+int sbi_hart_misaligned_perf(struct sbi_scratch *scratch);
+const char *sbi_hart_misaligned_perf2string(int perf);
+int sbi_hart_misaligned_deleg_set(struct sbi_scratch *scratch, bool enable);
+bool sbi_hart_misaligned_deleg_get(struct sbi_scratch *scratch);
 unsigned int sbi_hart_pmp_count(struct sbi_scratch *scratch);
 unsigned long sbi_hart_pmp_granularity(struct sbi_scratch *scratch);
 unsigned int sbi_hart_pmp_addrbits(struct sbi_scratch *scratch);
+int sbi_hart_pmp_set_region(struct sbi_scratch *scratch, unsigned int n,
+			    const struct sbi_domain_memregion *reg);
+int sbi_hart_pmp_image_build(struct sbi_scratch *scratch,
+			     const struct sbi_domain *dom);
 int sbi_hart_pmp_configure(struct sbi_scratch *scratch);
 bool sbi_hart_has_feature(struct sbi_scratch *scratch, unsigned long feature);
 void sbi_hart_get_features_str(struct sbi_scratch *scratch,
@@ -17,9 +17,17 @@
  *
  * The hartmask is indexed using physical HART id so this define
  * also represents the maximum number of HART ids generic OpenSBI
- * can handle.
+ * can handle. Platforms can lower (or raise) it with
+ * PLATFORM_HARTMASK_MAX_BITS in their config.mk.
  */
-#define SBI_HARTMASK_MAX_BITS		128
+#ifndef SBI_HARTMASK_MAX_BITS
+#define SBI_HARTMASK_MAX_BITS		1024
+#endif
+
+/* A sparse hartmask has one summary bit per word of a hartmask */
+#if BITS_TO_LONGS(SBI_HARTMASK_MAX_BITS) > BITS_PER_LONG
+#error "SBI_HARTMASK_MAX_BITS is too large"
+#endif
 
 /** Representation of hartmask */
 struct sbi_hartmask {
@@ -138,4 +146,48 @@ static inline void sbi_hartmask_xor(struct sbi_hartmask *dstp,
 #define sbi_hartmask_for_each_hart(__h, __m)	\
 	for_each_set_bit(__h, (__m)->bits, SBI_HARTMASK_MAX_BITS)
 
+/**
+ * Sparse hartmask
+ *
+ * Bit i of summary is set when word i of bits is in use. Words without
+ * a summary bit are never read, so only the summary has to be cleared
+ * and iterating only visits words which have HARTs set. This is meant
+ * for short lived sets of a few HARTs (such as IPI targets) when the
+ * maximum number of HARTs is large.
+ */
+struct sbi_hartmask_sparse {
+	unsigned long summary;
+	unsigned long bits[BITS_TO_LONGS(SBI_HARTMASK_MAX_BITS)];
+};
+
+/** Initialize sparse hartmask to zero */
+#define SBI_HARTMASK_SPARSE_INIT(__m)	((__m)->summary = 0)
+
+/**
+ * Set a HART in sparse hartmask
+ * @param h HART id to set
+ * @param m the sparse hartmask pointer
+ */
+static inline void sbi_hartmask_sparse_set_hart(u32 h,
+						struct sbi_hartmask_sparse *m)
+{
+	u32 w = BIT_WORD(h);
+
+	if (SBI_HARTMASK_MAX_BITS <= h)
+		return;
+	if (!(m->summary & BIT(w))) {
+		m->summary |= BIT(w);
+		m->bits[w] = 0;
+	}
+	m->bits[w] |= BIT_MASK(h);
+}
+
+/**
+ * Iterate over each used word of a sparse hartmask
+ * @param __w word index (the word holds HART ids from __w * BITS_PER_LONG)
+ * @param __m the sparse hartmask pointer
+ */
+#define sbi_hartmask_sparse_for_each_word(__w, __m)	\
+	for_each_set_bit(__w, &(__m)->summary, BITS_PER_LONG)
+
 #endif
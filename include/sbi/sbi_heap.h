@@ -0,0 +1,51 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifndef __SBI_HEAP_H__
+#define __SBI_HEAP_H__
+
+#include <sbi/sbi_types.h>
+
+/* clang-format off */
+
+/** Alignment of all heap allocations */
+#define SBI_HEAP_ALIGN			64
+
+/* clang-format on */
+
+struct sbi_scratch;
+
+/** Allocate from the firmware heap, NULL if out of memory or no heap */
+void *sbi_malloc(size_t size);
+
+/** Allocate zeroed memory from the firmware heap */
+void *sbi_zalloc(size_t size);
+
+/** Allocate zeroed memory for an array from the firmware heap */
+static inline void *sbi_calloc(size_t nitems, size_t size)
+{
+	if (size && nitems > (~(size_t)0) / size)
+		return NULL;
+
+	return sbi_zalloc(nitems * size);
+}
+
+/** Free memory allocated from the firmware heap (NULL is ignored) */
+void sbi_free(void *ptr);
+
+/** Amount (in bytes) of the firmware heap not allocated */
+unsigned long sbi_heap_free_space(void);
+
+/** Amount (in bytes) of the firmware heap allocated */
+unsigned long sbi_heap_used_space(void);
+
+/** Amount (in bytes) of the firmware heap used for its own bookkeeping */
+unsigned long sbi_heap_reserved_space(void);
+
+/** Initialize the firmware heap at the end of the firmware region */
+int sbi_heap_init(struct sbi_scratch *scratch);
+
+#endif
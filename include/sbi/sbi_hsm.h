@@ -39,6 +39,23 @@ struct sbi_hsm_device {
 	int (*hart_suspend)(u32 suspend_type, ulong raddr);
 };
 
+/** Maximum number of platform suspend states */
+#define SBI_HSM_SUSPEND_STATE_MAX			16
+
+/** Platform suspend (or idle) state */
+struct sbi_hsm_suspend_state {
+	/** Name of the suspend state */
+	char name[32];
+	/** HSM suspend type implementing the state */
+	u32 suspend_type;
+	/** Worst case latency of entering the state (in microseconds) */
+	u32 entry_latency_us;
+	/** Worst case latency of exiting the state (in microseconds) */
+	u32 exit_latency_us;
+	/** Minimum residency for the state to be worth it (in microseconds) */
+	u32 min_residency_us;
+};
+
 struct sbi_domain;
 struct sbi_scratch;
 
@@ -46,7 +63,37 @@ const struct sbi_hsm_device *sbi_hsm_get_device(void);
 
 void sbi_hsm_set_device(const struct sbi_hsm_device *dev);
 
+/**
+ * Register a platform suspend state
+ *
+ * Once a platform-specific suspend state is registered, only registered
+ * platform-specific suspend types are accepted by sbi_hsm_hart_suspend()
+ * and they are all dispatched to the hart state managment device.
+ *
+ * @param state the suspend state to register (copied)
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int sbi_hsm_add_suspend_state(const struct sbi_hsm_suspend_state *state);
+
+/** Get the number of registered suspend states */
+u32 sbi_hsm_suspend_state_count(void);
+
+/** Get a registered suspend state by index */
+const struct sbi_hsm_suspend_state *sbi_hsm_suspend_state_get(u32 index);
+
+/** Find the registered suspend state of given suspend type */
+const struct sbi_hsm_suspend_state *sbi_hsm_find_suspend_state(
+							u32 suspend_type);
+
 int sbi_hsm_init(struct sbi_scratch *scratch, u32 hartid, bool cold_boot);
+
+/**
+ * Wait for current HART to be started using sbi_hsm_hart_start()
+ *
+ * The IPI of current HART must be initialized before calling this.
+ */
+void sbi_hsm_hart_wait(struct sbi_scratch *scratch, u32 hartid);
 void __noreturn sbi_hsm_exit(struct sbi_scratch *scratch);
 
 int sbi_hsm_hart_start(struct sbi_scratch *scratch,
@@ -57,6 +104,17 @@ void sbi_hsm_hart_resume_start(struct sbi_scratch *scratch);
 void sbi_hsm_hart_resume_finish(struct sbi_scratch *scratch);
 int sbi_hsm_hart_suspend(struct sbi_scratch *scratch, u32 suspend_type,
 			 ulong raddr, ulong rmode, ulong priv);
+
+/**
+ * Move the current HART to SUSPENDED state before a system suspend
+ *
+ * The HART then resumes through the warm boot path at raddr like after
+ * a non-retentive suspend. Unless the system suspend really happens,
+ * sbi_hsm_hart_system_suspend_abort() moves it back to STARTED state.
+ */
+int sbi_hsm_hart_system_suspend(struct sbi_scratch *scratch, ulong raddr,
+				ulong rmode, ulong priv);
+void sbi_hsm_hart_system_suspend_abort(struct sbi_scratch *scratch);
 int sbi_hsm_hart_get_state(const struct sbi_domain *dom, u32 hartid);
 int sbi_hsm_hart_interruptible_mask(const struct sbi_domain *dom,
 				    ulong hbase, ulong *out_hmask);
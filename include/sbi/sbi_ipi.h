@@ -14,7 +14,18 @@
 
 /* clang-format off */
 
-#define SBI_IPI_EVENT_MAX			__riscv_xlen
+#define SBI_IPI_EVENT_MAX			(2 * __riscv_xlen)
+
+#define SBI_IPI_EVENT_PRIO_LOW			0
+#define SBI_IPI_EVENT_PRIO_NORMAL		64
+#define SBI_IPI_EVENT_PRIO_HIGH			128
+
+/** Maximum number of registered IPI devices */
+#define SBI_IPI_DEVICE_MAX			4
+
+/** Rounds of the IPI self-test and timeout of each round in microseconds */
+#define SBI_IPI_SELFTEST_ROUNDS			8
+#define SBI_IPI_SELFTEST_TIMEOUT_US		1000
 
 /* clang-format on */
 
@@ -26,6 +37,15 @@ struct sbi_ipi_device {
 	/** Send IPI to a target HART */
 	void (*ipi_send)(u32 target_hart);
 
+	/**
+	 * Send IPI to multiple target HARTs (optional)
+	 *
+	 * The hart mask is relative to hart base. Devices which can
+	 * trigger multiple IPIs with one MMIO write should implement
+	 * this otherwise ipi_send() is called for each target HART.
+	 */
+	void (*ipi_send_mask)(ulong hmask, ulong hbase);
+
 	/** Clear IPI for a target HART */
 	void (*ipi_clear)(u32 target_hart);
 };
@@ -37,19 +57,48 @@ struct sbi_ipi_event_ops {
 	/** Name of the IPI event operations */
 	char name[32];
 
+	/**
+	 * Priority of the IPI event
+	 * Note: Pending events are processed in decreasing order of
+	 * priority so latency critical events should use a higher value.
+	 */
+	u8 priority;
+
+	/**
+	 * Deferred IPI event
+	 * Note: Deferred events are processed only after all pending
+	 * non-deferred events. Events which arrive while a deferred event
+	 * is processed are picked up before the next deferred event. This
+	 * should be set for events doing long-running work.
+	 */
+	bool deferred;
+
+	/**
+	 * Size of one payload entry in bytes
+	 * Note: This is optional and when non-zero along with payload_count
+	 * a per-HART payload ring is allocated for the event which can be
+	 * used with sbi_ipi_payload_reserve() and related functions.
+	 */
+	u32 payload_size;
+
+	/** Number of payload entries in the per-HART payload ring */
+	u32 payload_count;
+
 	/**
 	 * Update callback to save/enqueue data for remote HART
-	 * Note: This is an optional callback and it is called just before
-	 * triggering IPI to remote HART.
+	 * Note: This is an optional callback and it is called for each
+	 * remote HART before triggering IPIs to any of the remote HARTs.
+	 * A negative return value skips the remote HART, which events can
+	 * use to defer their work on a suspended HART until it resumes.
 	 */
 	int (* update)(struct sbi_scratch *scratch,
 			struct sbi_scratch *remote_scratch,
 			u32 remote_hartid, void *data);
 
 	/**
-	 * Sync callback to wait for remote HART
-	 * Note: This is an optional callback and it is called just after
-	 * triggering IPI to remote HART.
+	 * Sync callback to wait for remote HARTs
+	 * Note: This is an optional callback and it is called only once
+	 * after triggering IPI to all remote HARTs.
 	 */
 	void (* sync)(struct sbi_scratch *scratch);
 
@@ -63,10 +112,20 @@ struct sbi_ipi_event_ops {
 
 int sbi_ipi_send_many(ulong hmask, ulong hbase, u32 event, void *data);
 
+int sbi_ipi_raise(u32 hartid, u32 event);
+
 int sbi_ipi_event_create(const struct sbi_ipi_event_ops *ops);
 
 void sbi_ipi_event_destroy(u32 event);
 
+void *sbi_ipi_payload_reserve(struct sbi_scratch *remote_scratch, u32 event);
+
+void sbi_ipi_payload_commit(void *payload);
+
+void *sbi_ipi_payload_peek(struct sbi_scratch *scratch, u32 event);
+
+void sbi_ipi_payload_release(struct sbi_scratch *scratch, u32 event);
+
 int sbi_ipi_send_smode(ulong hmask, ulong hbase);
 
 void sbi_ipi_clear_smode(void);
@@ -75,12 +134,45 @@ int sbi_ipi_send_halt(ulong hmask, ulong hbase);
 
 void sbi_ipi_process(void);
 
+bool sbi_ipi_poll(struct sbi_scratch *scratch);
+
+bool sbi_ipi_poll_get(struct sbi_scratch *scratch);
+
+int sbi_ipi_poll_set(struct sbi_scratch *scratch, bool enable);
+
 void sbi_ipi_raw_send(u32 target_hart);
 
+void sbi_ipi_raw_clear(u32 target_hart);
+
 const struct sbi_ipi_device *sbi_ipi_get_device(void);
 
 void sbi_ipi_set_device(const struct sbi_ipi_device *dev);
 
+/**
+ * Select the IPI device with the lowest latency
+ *
+ * Each registered device which raises MSIP goes through
+ * SBI_IPI_SELFTEST_ROUNDS round trips from the calling HART to the peer
+ * HART and back, and the best round is kept. Devices which don't deliver
+ * the IPIs before the timeout are not selected. Must be called on the boot
+ * HART after the timer is initialized while the peer HART waits for cold
+ * boot, so before other HARTs use IPIs.
+ */
+void sbi_ipi_selftest(struct sbi_scratch *scratch, u32 peer_hartid);
+
+/** Answer a self-test IPI of the boot HART, called while waiting */
+void sbi_ipi_selftest_reply(struct sbi_scratch *scratch);
+
+/** Describe the self-test results of all IPI devices in a string */
+void sbi_ipi_get_selftest_str(char *str, int nstr);
+
+const struct sbi_ipi_device *sbi_ipi_get_smode_device(void);
+
+void sbi_ipi_set_smode_device(const struct sbi_ipi_device *dev);
+
+/** Print the number of throttled requests of rate limited domains */
+void sbi_ipi_rate_dump(void);
+
 int sbi_ipi_init(struct sbi_scratch *scratch, bool cold_boot);
 
 void sbi_ipi_exit(struct sbi_scratch *scratch);
@@ -0,0 +1,60 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifndef __SBI_LOCK_STATS_H__
+#define __SBI_LOCK_STATS_H__
+
+#include <sbi/sbi_types.h>
+
+/* clang-format off */
+
+/** Number of tracked locks and sites per HART */
+#define SBI_LOCK_STATS_MAX			32
+
+/* clang-format on */
+
+struct sbi_scratch;
+
+#ifdef SBI_LOCK_STATS
+
+/** Get start timestamp of a wait (zero before initialization) */
+unsigned long sbi_lock_stats_start(void);
+
+/**
+ * Account an acquisition of a lock or a pass through a wait site
+ *
+ * @param key address of the lock or of the site name
+ * @param name site name or NULL for locks (printed by address)
+ * @param contended TRUE if the HART had to wait
+ * @param start timestamp from sbi_lock_stats_start() taken before the
+ * wait (only used when contended)
+ */
+void sbi_lock_stats_account(const void *key, const char *name,
+			    bool contended, unsigned long start);
+
+/** Reset lock statistics of all HARTs */
+void sbi_lock_stats_reset(void);
+
+/** Print lock statistics of all HARTs */
+void sbi_lock_stats_dump(void);
+
+/** Initialize lock statistics */
+int sbi_lock_stats_init(struct sbi_scratch *scratch, bool cold_boot);
+
+#else
+
+static inline unsigned long sbi_lock_stats_start(void) { return 0; }
+
+static inline void sbi_lock_stats_account(const void *key, const char *name,
+					  bool contended,
+					  unsigned long start) { }
+
+static inline int sbi_lock_stats_init(struct sbi_scratch *scratch,
+				      bool cold_boot) { return 0; }
+
+#endif
+
+#endif
@@ -0,0 +1,44 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifndef __SBI_LZ4_H__
+#define __SBI_LZ4_H__
+
+#include <sbi/sbi_types.h>
+
+/**
+ * Get the memory needed to decompress an LZ4 frame in place
+ *
+ * @param buf start of the frame
+ * @param comp_size size of the frame in bytes
+ * @param out_size bytes needed from buf, the content size plus the margin
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int sbi_lz4_inplace_size(const void *buf, unsigned long comp_size,
+			 unsigned long *out_size);
+
+/**
+ * Decompress an LZ4 frame in place
+ *
+ * The frame starts at buf and is comp_size bytes long. It must record
+ * the content size in its header, which must not exceed max_size. The
+ * buffer must have room for the content size plus a small margin beyond
+ * it because the frame is first moved to the end of the buffer and then
+ * decompressed forward to buf. Block and content checksums are skipped.
+ *
+ * @param buf start of the frame and of the decompressed data
+ * @param comp_size size of the frame in bytes
+ * @param max_size maximum size of the decompressed data
+ * @param out_size size of the decompressed data (may be NULL)
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int sbi_lz4_decompress_inplace(void *buf, unsigned long comp_size,
+			       unsigned long max_size,
+			       unsigned long *out_size);
+
+#endif
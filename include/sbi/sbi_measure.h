@@ -0,0 +1,87 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifndef __SBI_MEASURE_H__
+#define __SBI_MEASURE_H__
+
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_types.h>
+
+/* clang-format off */
+
+/** Measured objects */
+#define SBI_MEASURE_EVENT_NEXT_STAGE		0
+#define SBI_MEASURE_EVENT_FDT			1
+#define SBI_MEASURE_EVENT_MAX			2
+
+/** Digest algorithms */
+#define SBI_MEASURE_ALGO_SHA256			1
+
+#define SBI_MEASURE_DIGEST_SIZE			32
+
+/** Total size of the event log (power of two) */
+#define SBI_MEASURE_LOG_SIZE			0x1000
+
+#define SBI_MEASURE_MAGIC			0x534d534f	/* "OSMS" */
+#define SBI_MEASURE_VERSION			1
+
+/* clang-format on */
+
+/**
+ * Layout of the event log shared with S-mode
+ *
+ * The header is followed by entry_count entries of entry_size bytes.
+ * The log is complete before the next booting stage is entered and is
+ * never changed afterwards.
+ */
+struct sbi_measure_header {
+	u32 magic;
+	u32 version;
+	u32 entry_count;
+	u32 entry_size;
+	u32 reserved[4];
+};
+
+struct sbi_measure_entry {
+	/** One of SBI_MEASURE_EVENT_xyz */
+	u32 event;
+	/** One of SBI_MEASURE_ALGO_xyz */
+	u32 algo;
+	/** Physical address and size of the measured object */
+	u64 addr;
+	u64 size;
+	u8 digest[SBI_MEASURE_DIGEST_SIZE];
+};
+
+struct sbi_scratch;
+
+#ifdef SBI_MEASURE
+
+/** Get physical address and size of the event log */
+int sbi_measure_get_log(unsigned long *addr, unsigned long *size);
+
+/** Measure the next booting stage and its FDT */
+void sbi_measure_boot(struct sbi_scratch *scratch);
+
+/** Initialize the event log */
+int sbi_measure_init(struct sbi_scratch *scratch, bool cold_boot);
+
+#else
+
+static inline int sbi_measure_get_log(unsigned long *addr,
+				      unsigned long *size)
+{
+	return SBI_ENOTSUPP;
+}
+
+static inline void sbi_measure_boot(struct sbi_scratch *scratch) { }
+
+static inline int sbi_measure_init(struct sbi_scratch *scratch,
+				   bool cold_boot) { return 0; }
+
+#endif
+
+#endif
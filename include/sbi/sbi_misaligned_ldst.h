@@ -12,6 +12,27 @@
 
 #include <sbi/sbi_types.h>
 
+/* clang-format off */
+
+/** Default number of traps of one instruction which make a storm */
+#define SBI_MISALIGNED_STORM_LIMIT_DEFAULT	4096
+
+/** Default length of the storm detection window in timer ticks */
+#define SBI_MISALIGNED_STORM_WINDOW_DEFAULT	0x100000
+
+/* clang-format on */
+
+/** Storm detection settings of sbi_misaligned_storm_get/set() */
+enum sbi_misaligned_storm_param {
+	/** Traps of one instruction within a window, 0 disables detection */
+	SBI_MISALIGNED_STORM_LIMIT = 0,
+	/** Length of a window in timer ticks */
+	SBI_MISALIGNED_STORM_WINDOW,
+	/** Delegate misaligned traps of the HART to S-mode on a storm */
+	SBI_MISALIGNED_STORM_DELEG,
+};
+
+struct sbi_scratch;
 struct sbi_trap_regs;
 
 int sbi_misaligned_load_handler(ulong addr, ulong tval2, ulong tinst,
@@ -20,4 +41,32 @@ int sbi_misaligned_load_handler(ulong addr, ulong tval2, ulong tinst,
 int sbi_misaligned_store_handler(ulong addr, ulong tval2, ulong tinst,
 				 struct sbi_trap_regs *regs);
 
+/**
+ * Emulate a misaligned vector load/store
+ *
+ * @param insn the trapped instruction
+ * @param regs pointer to the trap registers
+ *
+ * @return SBI_ENOTSUPP if the instruction is not emulated and otherwise
+ * the result of completing (or redirecting) it
+ */
+int sbi_misaligned_v_ldst_handler(ulong insn, struct sbi_trap_regs *regs);
+
+/** Drop all decoded instructions cached for current HART */
+void sbi_misaligned_insn_cache_flush(void);
+
+/**
+ * Get or set a storm detection setting of a HART
+ *
+ * An instruction (mepc in the address space of satp, vsatp and hgatp)
+ * trapping limit times within a window is a misaligned trap storm. It is
+ * counted by the SBI_PMU_FW_MISALIGNED_STORM firmware event and may
+ * switch the HART to delegating misaligned traps to S-mode.
+ */
+ulong sbi_misaligned_storm_get(struct sbi_scratch *scratch, int param);
+int sbi_misaligned_storm_set(struct sbi_scratch *scratch, int param,
+			     ulong value);
+
+int sbi_misaligned_ldst_init(struct sbi_scratch *scratch, bool cold_boot);
+
 #endif
@@ -35,8 +35,18 @@
 #define SBI_PLATFORM_FIRMWARE_CONTEXT_OFFSET (0x58 + __SIZEOF_POINTER__)
 /** Offset of hart_index2id in struct sbi_platform */
 #define SBI_PLATFORM_HART_INDEX2ID_OFFSET (0x58 + (__SIZEOF_POINTER__ * 2))
+/** Offset of hart_stack_end in struct sbi_platform */
+#define SBI_PLATFORM_HART_STACK_END_OFFSET (0x58 + (__SIZEOF_POINTER__ * 3))
+/** Offset of heap_size in struct sbi_platform */
+#define SBI_PLATFORM_HEAP_SIZE_OFFSET (0x58 + (__SIZEOF_POINTER__ * 4))
 
 #define SBI_PLATFORM_TLB_RANGE_FLUSH_LIMIT_DEFAULT		(1UL << 12)
+/** Flush limit value requesting a per-HART calibration at boot */
+#define SBI_PLATFORM_TLB_RANGE_FLUSH_LIMIT_CALIBRATE		(-1ULL)
+
+#define SBI_PLATFORM_TLB_RANGE_MERGE_GAP_DEFAULT		0
+
+#define SBI_PLATFORM_TLB_FIFO_NUM_ENTRIES_DEFAULT		8
 
 #ifndef __ASSEMBLER__
 
@@ -46,6 +56,7 @@
 #include <sbi/sbi_version.h>
 
 struct sbi_domain_memregion;
+struct sbi_hart_desc;
 struct sbi_trap_info;
 struct sbi_trap_regs;
 
@@ -64,6 +75,14 @@ enum sbi_platform_features {
 
 /** Platform functions */
 struct sbi_platform_operations {
+	/**
+	 * Platform nascent initialization
+	 * Note: This is called on every HART before it waits for the
+	 * cold boot HART or for an IPI, so it must only touch state local
+	 * to the HART.
+	 */
+	int (*nascent_init)(void);
+
 	/** Platform early initialization */
 	int (*early_init)(bool cold_boot);
 	/** Platform final initialization */
@@ -74,6 +93,12 @@ struct sbi_platform_operations {
 	/** Platform final exit */
 	void (*final_exit)(void);
 
+	/**
+	 * Prepare the next booting stage (and its FDT in next_arg1 of
+	 * the current HART) for a warm restart
+	 */
+	int (*warm_restart)(void);
+
 	/**
 	 * For platforms that do not implement misa, non-standard
 	 * methods are needed to determine cpu extension.
@@ -86,6 +111,9 @@ struct sbi_platform_operations {
 	 */
 	int (*misa_get_xlen)(void);
 
+	/** Describe HART features which then need not be probed */
+	int (*hart_desc)(u32 hartid, struct sbi_hart_desc *desc);
+
 	/** Initialize (or populate) domains for the platform */
 	int (*domains_init)(void);
 
@@ -104,12 +132,22 @@ struct sbi_platform_operations {
 
 	/** Get tlb flush limit value **/
 	u64 (*get_tlbr_flush_limit)(void);
+	/** Get tlb range merge gap value **/
+	u64 (*get_tlbr_merge_gap)(void);
+	/** Get number of entries in per-HART tlb fifo **/
+	u32 (*get_tlb_fifo_num_entries)(void);
+	/** Get cluster id of a HART for remote tlb flushes **/
+	u32 (*get_tlb_cluster)(u32 hartid);
 
 	/** Initialize platform timer for current HART */
 	int (*timer_init)(bool cold_boot);
 	/** Exit platform timer for current HART */
 	void (*timer_exit)(void);
 
+	/** Map SBI PMU hardware event to mhpmevent selector value */
+	int (*pmu_event_map)(unsigned long event_idx, u64 event_data,
+			     u64 *mhpmevent_val);
+
 	/** platform specific SBI extension implementation probe function */
 	int (*vendor_ext_check)(long extid);
 	/** platform specific SBI extension implementation provider */
@@ -119,8 +157,19 @@ struct sbi_platform_operations {
 				   struct sbi_trap_info *out_trap);
 };
 
-/** Platform default per-HART stack size for exception/interrupt handling */
+/**
+ * Platform default per-HART stack size for exception/interrupt handling
+ * (including the scratch space), can be overridden at build time
+ */
+#ifndef SBI_PLATFORM_DEFAULT_HART_STACK_SIZE
 #define SBI_PLATFORM_DEFAULT_HART_STACK_SIZE	8192
+#endif
+
+/**
+ * Platform default firmware heap size for given number of HARTs, nothing
+ * is reserved until OpenSBI itself allocates from the heap
+ */
+#define SBI_PLATFORM_DEFAULT_HEAP_SIZE(__num_hart)	0
 
 /** Representation of a platform */
 struct sbi_platform {
@@ -164,8 +213,46 @@ struct sbi_platform {
 	 * 2. HART id < SBI_HARTMASK_MAX_BITS
 	 */
 	const u32 *hart_index2id;
+	/**
+	 * HART index to HART stack end table
+	 *
+	 * For HART index <abc> with a non-zero hart_stack_end[<abc>] the
+	 * firmware places the scratch space and stack of the HART in the
+	 * hart_stack_size bytes below hart_stack_end[<abc>] (for example
+	 * in memory local to the HART) instead of the firmware region. The
+	 * memory must be naturally aligned to hart_stack_size and is
+	 * protected as M-mode only memory like the firmware region.
+	 *
+	 * If hart_stack_end == NULL (or for zero entries) the HART stack
+	 * is in the firmware region.
+	 */
+	const unsigned long *hart_stack_end;
+	/**
+	 * Size of the firmware heap placed after the HART stacks at the end
+	 * of the firmware region (zero means no heap)
+	 */
+	u32 heap_size;
 };
 
+#ifdef SBI_PLATFORM_STATIC
+
+/*
+ * Static platforms have a constant platform and platform operations, so
+ * they are bound at build time and the compiler (with LTO across the
+ * libraries) can turn the hooks into direct or inlined calls.
+ */
+extern const struct sbi_platform platform;
+extern const struct sbi_platform_operations platform_ops;
+
+/** Get pointer to sbi_platform for sbi_scratch pointer */
+#define sbi_platform_ptr(__s)		((void)(__s), &platform)
+/** Get pointer to sbi_platform for current HART */
+#define sbi_platform_thishart_ptr()	(&platform)
+/** Get pointer to platform_ops_addr from platform pointer **/
+#define sbi_platform_ops(__p)		((void)(__p), &platform_ops)
+
+#else
+
 /** Get pointer to sbi_platform for sbi_scratch pointer */
 #define sbi_platform_ptr(__s) \
 	((const struct sbi_platform *)((__s)->platform_addr))
@@ -176,6 +263,8 @@ struct sbi_platform {
 #define sbi_platform_ops(__p) \
 	((const struct sbi_platform_operations *)(__p)->platform_ops_addr)
 
+#endif
+
 /** Check whether the platform supports fault delegation */
 #define sbi_platform_has_mfaults_delegation(__p) \
 	((__p)->features & SBI_PLATFORM_HAS_MFAULTS_DELEGATION)
@@ -190,6 +279,16 @@ struct sbi_platform {
  */
 u32 sbi_platform_hart_index(const struct sbi_platform *plat, u32 hartid);
 
+/**
+ * Build the HART id to HART index map used by sbi_platform_hart_index()
+ *
+ * Called once by the cold boot HART. Until then HART indices are found
+ * by searching hart_index2id[].
+ *
+ * @param plat pointer to struct sbi_platform
+ */
+void sbi_platform_hart_index_init(const struct sbi_platform *plat);
+
 /**
  * Get the platform features in string format
  *
@@ -238,7 +337,8 @@ static inline unsigned long sbi_platform_get_features(
  * @param plat pointer to struct sbi_platform
  *
  * @return tlb range flush limit value. Returns a default (page size) if not
- * defined by platform.
+ * defined by platform. SBI_PLATFORM_TLB_RANGE_FLUSH_LIMIT_CALIBRATE lets each
+ * HART measure its own limit at boot.
  */
 static inline u64 sbi_platform_tlbr_flush_limit(const struct sbi_platform *plat)
 {
@@ -247,6 +347,58 @@ static inline u64 sbi_platform_tlbr_flush_limit(const struct sbi_platform *plat)
 	return SBI_PLATFORM_TLB_RANGE_FLUSH_LIMIT_DEFAULT;
 }
 
+/**
+ * Get platform specific tlb range merge gap. Two queued range flush requests
+ * separated by a gap of at most this size are merged into one request.
+ *
+ * @param plat pointer to struct sbi_platform
+ *
+ * @return tlb range merge gap value. Returns a default (zero) if not
+ * defined by platform.
+ */
+static inline u64 sbi_platform_tlbr_merge_gap(const struct sbi_platform *plat)
+{
+	if (plat && sbi_platform_ops(plat)->get_tlbr_merge_gap)
+		return sbi_platform_ops(plat)->get_tlbr_merge_gap();
+	return SBI_PLATFORM_TLB_RANGE_MERGE_GAP_DEFAULT;
+}
+
+/**
+ * Get platform specific cluster id of a HART. HARTs of a cluster share
+ * a last level cache so remote tlb flushes for several HARTs of another
+ * cluster are forwarded by one of them.
+ *
+ * @param plat pointer to struct sbi_platform
+ * @param hartid HART id
+ *
+ * @return cluster id (any value unique to the cluster) or -1U if the
+ * topology is unknown
+ */
+static inline u32 sbi_platform_tlb_cluster(const struct sbi_platform *plat,
+					   u32 hartid)
+{
+	if (plat && sbi_platform_ops(plat)->get_tlb_cluster)
+		return sbi_platform_ops(plat)->get_tlb_cluster(hartid);
+	return -1U;
+}
+
+/**
+ * Get platform specific number of entries in the per-HART tlb fifo used
+ * for queuing remote tlb flush requests.
+ *
+ * @param plat pointer to struct sbi_platform
+ *
+ * @return number of tlb fifo entries. Returns a default (8) if not
+ * defined by platform.
+ */
+static inline u32 sbi_platform_tlb_fifo_num_entries(
+					const struct sbi_platform *plat)
+{
+	if (plat && sbi_platform_ops(plat)->get_tlb_fifo_num_entries)
+		return sbi_platform_ops(plat)->get_tlb_fifo_num_entries();
+	return SBI_PLATFORM_TLB_FIFO_NUM_ENTRIES_DEFAULT;
+}
+
 /**
  * Get total number of HARTs supported by the platform
  *
@@ -275,6 +427,59 @@ static inline u32 sbi_platform_hart_stack_size(const struct sbi_platform *plat)
 	return 0;
 }
 
+/**
+ * Get size of the firmware heap
+ *
+ * @param plat pointer to struct sbi_platform
+ *
+ * @return heap size in bytes
+ */
+static inline u32 sbi_platform_heap_size(const struct sbi_platform *plat)
+{
+	if (plat)
+		return plat->heap_size;
+	return 0;
+}
+
+/**
+ * Get end of the stack provided by the platform for given HART index
+ *
+ * @param plat pointer to struct sbi_platform
+ * @param hartindex HART index
+ *
+ * @return end address of the stack or zero if the HART stack is in the
+ * firmware region
+ */
+static inline unsigned long sbi_platform_hart_stack_end(
+					const struct sbi_platform *plat,
+					u32 hartindex)
+{
+	if (plat && plat->hart_stack_end && hartindex < plat->hart_count)
+		return plat->hart_stack_end[hartindex];
+	return 0;
+}
+
+/**
+ * Get HART id for the given HART index
+ *
+ * Walking the HART indices with this is the cheap way to visit all valid
+ * HARTs, much cheaper than checking every possible HART id.
+ *
+ * @param plat pointer to struct sbi_platform
+ * @param hartindex HART index
+ *
+ * @return HART id for valid HART index otherwise -1U
+ */
+static inline u32 sbi_platform_hart_index2id(const struct sbi_platform *plat,
+					     u32 hartindex)
+{
+	if (!plat || plat->hart_count <= hartindex)
+		return -1U;
+	if (plat->hart_index2id)
+		return plat->hart_index2id[hartindex];
+	return hartindex;
+}
+
 /**
  * Check whether given HART is invalid
  *
@@ -293,6 +498,20 @@ static inline bool sbi_platform_hart_invalid(const struct sbi_platform *plat,
 	return FALSE;
 }
 
+/**
+ * Nascent (very early) initialization for current HART
+ *
+ * @param plat pointer to struct sbi_platform
+ *
+ * @return 0 on success and negative error code on failure
+ */
+static inline int sbi_platform_nascent_init(const struct sbi_platform *plat)
+{
+	if (plat && sbi_platform_ops(plat)->nascent_init)
+		return sbi_platform_ops(plat)->nascent_init();
+	return 0;
+}
+
 /**
  * Early initialization for current HART
  *
@@ -347,6 +566,20 @@ static inline void sbi_platform_final_exit(const struct sbi_platform *plat)
 		sbi_platform_ops(plat)->final_exit();
 }
 
+/**
+ * Prepare for a warm restart of the next booting stage
+ *
+ * @param plat pointer to struct sbi_platform
+ *
+ * @return 0 on success and negative error code on failure
+ */
+static inline int sbi_platform_warm_restart(const struct sbi_platform *plat)
+{
+	if (plat && sbi_platform_ops(plat)->warm_restart)
+		return sbi_platform_ops(plat)->warm_restart();
+	return 0;
+}
+
 /**
  * Check CPU extension in MISA
  *
@@ -377,6 +610,24 @@ static inline int sbi_platform_misa_xlen(const struct sbi_platform *plat)
 	return -1;
 }
 
+/**
+ * Get platform provided description of HART features
+ *
+ * @param plat pointer to struct sbi_platform
+ * @param hartid HART ID of the HART to describe
+ * @param desc pointer to a zeroed struct sbi_hart_desc to fill
+ *
+ * @return 0 on success and negative error code on failure
+ */
+static inline int sbi_platform_hart_desc(const struct sbi_platform *plat,
+					 u32 hartid,
+					 struct sbi_hart_desc *desc)
+{
+	if (plat && sbi_platform_ops(plat)->hart_desc)
+		return sbi_platform_ops(plat)->hart_desc(hartid, desc);
+	return SBI_ENOTSUPP;
+}
+
 /**
  * Initialize (or populate) domains for the platform
  *
@@ -486,6 +737,29 @@ static inline void sbi_platform_timer_exit(const struct sbi_platform *plat)
 		sbi_platform_ops(plat)->timer_exit();
 }
 
+/**
+ * Map a SBI PMU hardware event to platform specific mhpmevent value
+ *
+ * @param plat pointer to struct sbi_platform
+ * @param event_idx SBI PMU event index (hardware or cache event)
+ * @param event_data additional event data passed by supervisor
+ * @param mhpmevent_val pointer where the mhpmevent selector is returned
+ *
+ * @return 0 on success and negative error code on failure. Returns
+ * SBI_ENOTSUPP if not defined by platform.
+ */
+static inline int sbi_platform_pmu_event_map(const struct sbi_platform *plat,
+					     unsigned long event_idx,
+					     u64 event_data,
+					     u64 *mhpmevent_val)
+{
+	if (plat && sbi_platform_ops(plat)->pmu_event_map)
+		return sbi_platform_ops(plat)->pmu_event_map(event_idx,
+							     event_data,
+							     mhpmevent_val);
+	return SBI_ENOTSUPP;
+}
+
 /**
  * Check if a vendor extension is implemented or not.
  *
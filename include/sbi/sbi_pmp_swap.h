@@ -0,0 +1,106 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifndef __SBI_PMP_SWAP_H__
+#define __SBI_PMP_SWAP_H__
+
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_types.h>
+
+/* clang-format off */
+
+/** Maximum number of PMP entries used for swapped in regions */
+#define SBI_PMP_SWAP_SLOTS_MAX			16
+
+/** Number of regions of each domain with a swap-in counter */
+#define SBI_PMP_SWAP_REGIONS_MAX		32
+
+/* clang-format on */
+
+struct sbi_domain;
+struct sbi_domain_memregion;
+struct sbi_scratch;
+struct sbi_trap_regs;
+struct sbi_trap_info;
+
+#ifdef SBI_PMP_SWAP
+
+/** Check whether regions of a domain are swapped in on access faults */
+bool sbi_pmp_swap_enabled(const struct sbi_domain *dom);
+
+/**
+ * Check whether a memory region of a domain is swapped in on access
+ * faults instead of being programmed with the other regions
+ *
+ * Only S-mode regions which overlap no other region of the domain are
+ * swapped because the PMP entries of overlapping regions have to stay
+ * in priority order.
+ */
+bool sbi_pmp_swap_region(const struct sbi_domain *dom,
+			 const struct sbi_domain_memregion *reg);
+
+/**
+ * Use PMP entries starting at first for swapped in regions
+ *
+ * This is called by sbi_hart_pmp_configure() each time the PMP entries
+ * of the current HART are programmed. A domain without swapped regions
+ * passes a NULL domain.
+ *
+ * @return number of PMP entries used for swapped in regions
+ */
+unsigned int sbi_pmp_swap_configure(struct sbi_scratch *scratch,
+				    const struct sbi_domain *dom,
+				    unsigned int first);
+
+/**
+ * Swap in the region needed by an access fault of S-mode or U-mode
+ *
+ * @return 0 if the faulting access can be retried and negative error
+ * code if the access fault has to be redirected
+ */
+int sbi_pmp_swap_handler(struct sbi_trap_regs *regs,
+			 const struct sbi_trap_info *trap);
+
+/** Print the swap-in counters of all domains on the console */
+void sbi_pmp_swap_dump(void);
+
+/** Initialize the swapping of PMP entries */
+int sbi_pmp_swap_init(struct sbi_scratch *scratch, bool cold_boot);
+
+#else
+
+static inline bool sbi_pmp_swap_enabled(const struct sbi_domain *dom)
+{
+	return FALSE;
+}
+
+static inline bool sbi_pmp_swap_region(const struct sbi_domain *dom,
+				       const struct sbi_domain_memregion *reg)
+{
+	return FALSE;
+}
+
+static inline unsigned int sbi_pmp_swap_configure(struct sbi_scratch *scratch,
+						  const struct sbi_domain *dom,
+						  unsigned int first)
+{
+	return 0;
+}
+
+static inline int sbi_pmp_swap_handler(struct sbi_trap_regs *regs,
+				       const struct sbi_trap_info *trap)
+{
+	return SBI_ENOTSUPP;
+}
+
+static inline void sbi_pmp_swap_dump(void) { }
+
+static inline int sbi_pmp_swap_init(struct sbi_scratch *scratch,
+				    bool cold_boot) { return 0; }
+
+#endif
+
+#endif
@@ -0,0 +1,106 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifndef __SBI_PMU_H__
+#define __SBI_PMU_H__
+
+#include <sbi/sbi_types.h>
+
+/* clang-format off */
+
+/** Maximum number of hardware counters (cycle, time, instret, mhpmcounterX) */
+#define SBI_PMU_HW_CTR_MAX			32
+/** Maximum number of firmware counters */
+#define SBI_PMU_FW_CTR_MAX			16
+/** Maximum number of counters */
+#define SBI_PMU_CTR_MAX				(SBI_PMU_HW_CTR_MAX + \
+						 SBI_PMU_FW_CTR_MAX)
+
+/** Event index of a counter which is not configured */
+#define SBI_PMU_EVENT_IDX_INVALID		0xFFFFFFFF
+
+/* clang-format on */
+
+struct sbi_scratch;
+
+/** Initialize PMU for current HART */
+int sbi_pmu_init(struct sbi_scratch *scratch, bool cold_boot);
+
+/** Stop all counters of current HART */
+void sbi_pmu_exit(struct sbi_scratch *scratch);
+
+/** Get number of counters (hardware and firmware) */
+unsigned long sbi_pmu_num_ctr(void);
+
+/**
+ * Get information about a counter
+ *
+ * @param cidx counter index
+ * @param ctr_info pointer where the SBI counter info is returned
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int sbi_pmu_ctr_get_info(u32 cidx, unsigned long *ctr_info);
+
+/**
+ * Find and configure a counter for the given event
+ *
+ * @param cidx_base first counter index of the candidate counters
+ * @param cidx_mask bitmask of candidate counters relative to cidx_base
+ * @param flags SBI_PMU_CFG_FLAG_xyz flags
+ * @param event_idx SBI PMU event index
+ * @param event_data additional event data (e.g. raw event selector)
+ *
+ * @return counter index on success and negative error code on failure
+ */
+int sbi_pmu_ctr_cfg_match(unsigned long cidx_base, unsigned long cidx_mask,
+			  unsigned long flags, unsigned long event_idx,
+			  u64 event_data);
+
+/**
+ * Start the given counters
+ *
+ * @param cidx_base first counter index
+ * @param cidx_mask bitmask of counters relative to cidx_base
+ * @param flags SBI_PMU_START_FLAG_xyz flags
+ * @param ival initial value used with SBI_PMU_START_FLAG_SET_INIT_VALUE
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int sbi_pmu_ctr_start(unsigned long cidx_base, unsigned long cidx_mask,
+		      unsigned long flags, u64 ival);
+
+/**
+ * Stop the given counters
+ *
+ * @param cidx_base first counter index
+ * @param cidx_mask bitmask of counters relative to cidx_base
+ * @param flags SBI_PMU_STOP_FLAG_xyz flags
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int sbi_pmu_ctr_stop(unsigned long cidx_base, unsigned long cidx_mask,
+		     unsigned long flags);
+
+/**
+ * Read the value of a firmware counter
+ *
+ * @param cidx counter index
+ * @param cval pointer where the counter value is returned
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int sbi_pmu_ctr_fw_read(u32 cidx, u64 *cval);
+
+/**
+ * Count one occurrence of a firmware event on current HART
+ *
+ * @param fw_id standard (SBI_PMU_FW_xyz) or OpenSBI specific firmware
+ * event code
+ */
+void sbi_pmu_ctr_incr_fw(u32 fw_id);
+
+#endif
@@ -0,0 +1,106 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifndef __SBI_PMU_SAMPLE_H__
+#define __SBI_PMU_SAMPLE_H__
+
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_types.h>
+
+/* clang-format off */
+
+/** Total size of the sample buffer (power of two) */
+#ifndef SBI_PMU_SAMPLE_SIZE
+#define SBI_PMU_SAMPLE_SIZE			0x10000
+#endif
+
+/** Sampling period (in platform timer ticks) used for a zero period */
+#define SBI_PMU_SAMPLE_PERIOD_DEFAULT		10000
+
+#define SBI_PMU_SAMPLE_MAGIC			0x5350534f	/* "OSPS" */
+#define SBI_PMU_SAMPLE_VERSION			1
+
+/** Privilege mode of a sample with the virtualization mode in bit 2 */
+#define SBI_PMU_SAMPLE_MODE_U			0
+#define SBI_PMU_SAMPLE_MODE_S			1
+#define SBI_PMU_SAMPLE_MODE_VIRT		(1U << 2)
+
+/* clang-format on */
+
+/**
+ * Layout of the sample buffer shared with S-mode
+ *
+ * Same as the trace buffer (see sbi_trace.h): the header is followed by
+ * one ring per HART (in HART index order) at ring_offset + index *
+ * ring_size and each ring starts with a struct sbi_pmu_sample_ring
+ * followed by record_count records. The head counter counts all samples
+ * ever taken and is updated after the record.
+ */
+struct sbi_pmu_sample_header {
+	u32 magic;
+	u32 version;
+	u32 hart_count;
+	u32 record_count;
+	u32 record_size;
+	u32 ring_offset;
+	u32 ring_size;
+	u32 reserved;
+};
+
+struct sbi_pmu_sample_ring {
+	u64 head;
+	/** Sampling period in platform timer ticks, zero when stopped */
+	u64 period;
+	u32 hartid;
+	u32 reserved[11];
+};
+
+struct sbi_pmu_sample_record {
+	/** Value of the cycle counter when sampled */
+	u64 cycle;
+	/** Program counter of the interrupted context */
+	u64 pc;
+	/** satp (vsatp for a virtualized context) of the interrupted context */
+	u64 satp;
+	/** One of SBI_PMU_SAMPLE_MODE_xyz */
+	u32 mode;
+	u32 reserved;
+};
+
+struct sbi_scratch;
+
+#ifdef SBI_PMU_SAMPLE
+
+/** Get physical address and size of the sample buffer */
+int sbi_pmu_sample_get_buffer(unsigned long *addr, unsigned long *size);
+
+/** Start (or restart with a new period) sampling on current HART */
+int sbi_pmu_sample_start(u64 period);
+
+/** Stop sampling on current HART */
+void sbi_pmu_sample_stop(void);
+
+/** Initialize the sample buffer */
+int sbi_pmu_sample_init(struct sbi_scratch *scratch, bool cold_boot);
+
+#else
+
+static inline int sbi_pmu_sample_get_buffer(unsigned long *addr,
+					    unsigned long *size)
+{
+	return SBI_ENOTSUPP;
+}
+
+static inline int sbi_pmu_sample_start(u64 period) { return SBI_ENOTSUPP; }
+
+static inline void sbi_pmu_sample_stop(void) { }
+
+static inline int sbi_pmu_sample_init(struct sbi_scratch *scratch,
+				      bool cold_boot) { return 0; }
+
+#endif
+
+#endif
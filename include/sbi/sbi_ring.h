@@ -0,0 +1,140 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifndef __SBI_RING_H__
+#define __SBI_RING_H__
+
+#include <sbi/riscv_locks.h>
+#include <sbi/sbi_types.h>
+
+/*
+ * Ring of fixed size entries with a power-of-two number of entries.
+ *
+ * The head and the tail are free running so the number of queued entries
+ * is their difference and an entry is found by masking its index. They
+ * are only written with the lock held but may be read without it to
+ * check whether the ring is empty or full.
+ */
+struct sbi_ring {
+	void *mem;
+	qspinlock_t lock;
+	u32 entry_size;
+	u32 mask;
+	volatile u32 head;
+	volatile u32 tail;
+};
+
+enum sbi_ring_update_types {
+	SBI_RING_SKIP,
+	SBI_RING_UPDATED,
+	SBI_RING_UNCHANGED,
+};
+
+/** Pointer to the entry at a free running index */
+static inline void *sbi_ring_entry(const struct sbi_ring *ring, u32 idx)
+{
+	return ring->mem + (idx & ring->mask) * ring->entry_size;
+}
+
+/** Typed pointer to the entry at a free running index */
+#define sbi_ring_entry_of(__ring, __idx, __type)	\
+	((__type *)sbi_ring_entry(__ring, __idx))
+
+/** Number of entries of a ring */
+static inline u32 sbi_ring_size(const struct sbi_ring *ring)
+{
+	return ring->mask + 1;
+}
+
+/**
+ * Number of queued entries without taking the lock
+ *
+ * The result may be stale by the time it is used, only the lock holder
+ * gets an exact count.
+ */
+static inline u32 sbi_ring_count(const struct sbi_ring *ring)
+{
+	u32 tail = ring->tail;
+	u32 count = ring->head - tail;
+
+	/* The head moved on after the tail was read */
+	return (count <= ring->mask) ? count : ring->mask + 1;
+}
+
+/** Check whether a ring is empty without taking the lock */
+static inline bool sbi_ring_is_empty(const struct sbi_ring *ring)
+{
+	return (ring->head == ring->tail) ? TRUE : FALSE;
+}
+
+/** Check whether a ring is full without taking the lock */
+static inline bool sbi_ring_is_full(const struct sbi_ring *ring)
+{
+	return (sbi_ring_count(ring) == sbi_ring_size(ring)) ? TRUE : FALSE;
+}
+
+/**
+ * Initialize a ring over the memory of entries * entry_size bytes
+ *
+ * @return 0 on success and SBI_EINVAL if entries is not a power of two
+ */
+int sbi_ring_init(struct sbi_ring *ring, void *mem, u32 entries,
+		  u32 entry_size);
+
+/** Drop all queued entries */
+void sbi_ring_reset(struct sbi_ring *ring);
+
+/**
+ * Reserve the next free entry for construction in place
+ *
+ * On success the lock is held until sbi_ring_commit() or
+ * sbi_ring_cancel() is called so the entry should be filled quickly.
+ *
+ * @return pointer to the entry or NULL (without the lock) if full
+ */
+void *sbi_ring_reserve(struct sbi_ring *ring);
+
+/** Queue the entry returned by sbi_ring_reserve() and drop the lock */
+void sbi_ring_commit(struct sbi_ring *ring);
+
+/** Drop the entry returned by sbi_ring_reserve() and the lock */
+void sbi_ring_cancel(struct sbi_ring *ring);
+
+/** Copy one entry to the ring, returns SBI_ENOSPC if full */
+int sbi_ring_enqueue(struct sbi_ring *ring, const void *data);
+
+/** Copy one entry from the ring, returns SBI_ENOENT if empty */
+int sbi_ring_dequeue(struct sbi_ring *ring, void *data);
+
+/**
+ * Copy up to count entries to the ring with the lock taken once
+ *
+ * @return number of entries queued
+ */
+u32 sbi_ring_enqueue_many(struct sbi_ring *ring, const void *data, u32 count);
+
+/**
+ * Copy up to count entries from the ring with the lock taken once
+ *
+ * An empty ring is detected without taking the lock.
+ *
+ * @return number of entries copied to data
+ */
+u32 sbi_ring_dequeue_many(struct sbi_ring *ring, void *data, u32 count);
+
+/**
+ * Call fptr on the queued entries from the oldest one with the lock held
+ * until it returns SBI_RING_SKIP or SBI_RING_UPDATED.
+ *
+ * **Do not** invoke any other ring function from the callback. Otherwise,
+ * it will lead to deadlock.
+ *
+ * @return last value returned by fptr or SBI_RING_UNCHANGED if empty
+ */
+int sbi_ring_update(struct sbi_ring *ring, void *in,
+		    int (*fptr)(void *in, void *data));
+
+#endif
@@ -36,10 +36,33 @@
 #define SBI_SCRATCH_TMP0_OFFSET			(9 * __SIZEOF_POINTER__)
 /** Offset of options member in sbi_scratch */
 #define SBI_SCRATCH_OPTIONS_OFFSET		(10 * __SIZEOF_POINTER__)
+/** Offset of domain_addr member in sbi_scratch */
+#define SBI_SCRATCH_DOMAIN_ADDR_OFFSET		(11 * __SIZEOF_POINTER__)
+/** Offset of hartid member in sbi_scratch */
+#define SBI_SCRATCH_HARTID_OFFSET		(12 * __SIZEOF_POINTER__)
+/** Offset of hartindex member in sbi_scratch */
+#define SBI_SCRATCH_HARTINDEX_OFFSET		(13 * __SIZEOF_POINTER__)
+/** Offset of fdt_overlay member in sbi_scratch */
+#define SBI_SCRATCH_FDT_OVERLAY_OFFSET		(14 * __SIZEOF_POINTER__)
+/** Offset of fw_init_offset member in sbi_scratch */
+#define SBI_SCRATCH_FW_INIT_OFFSET_OFFSET	(15 * __SIZEOF_POINTER__)
+/** Offset of fw_init_size member in sbi_scratch */
+#define SBI_SCRATCH_FW_INIT_SIZE_OFFSET		(16 * __SIZEOF_POINTER__)
+/** Offset of next_size member in sbi_scratch */
+#define SBI_SCRATCH_NEXT_SIZE_OFFSET		(17 * __SIZEOF_POINTER__)
 /** Offset of extra space in sbi_scratch */
-#define SBI_SCRATCH_EXTRA_SPACE_OFFSET		(11 * __SIZEOF_POINTER__)
-/** Maximum size of sbi_scratch (4KB) */
+#define SBI_SCRATCH_EXTRA_SPACE_OFFSET		(18 * __SIZEOF_POINTER__)
+/** Value of SBI_SCRATCH_FDT_IN_PLACE option (also used by firmwares) */
+#define SBI_SCRATCH_FDT_IN_PLACE_BIT		(1 << 4)
+/**
+ * Maximum size of sbi_scratch (4KB by default, platforms can ask for more
+ * using PLATFORM_SCRATCH_SIZE in their config.mk)
+ */
+#ifndef SBI_SCRATCH_SIZE
 #define SBI_SCRATCH_SIZE			(0x1000)
+#endif
+/** Alignment to keep data written by different HARTs apart */
+#define SBI_SCRATCH_CACHELINE_SIZE		(64)
 
 /* clang-format on */
 
@@ -71,6 +94,20 @@ struct sbi_scratch {
 	unsigned long tmp0;
 	/** Options for OpenSBI library */
 	unsigned long options;
+	/** Address of sbi_domain of this HART (cached hartid to domain) */
+	unsigned long domain_addr;
+	/** HART id of this HART (set by sbi_scratch_init()) */
+	unsigned long hartid;
+	/** Platform HART index of this HART (set by sbi_scratch_init()) */
+	unsigned long hartindex;
+	/** Address of DT overlays to apply on the Arg1 FDT (zero if none) */
+	unsigned long fdt_overlay;
+	/** Offset (in bytes) of the cold boot only part of the firmware */
+	unsigned long fw_init_offset;
+	/** Size (in bytes) of the cold boot only part of the firmware */
+	unsigned long fw_init_size;
+	/** Size (in bytes) of the next booting stage image (0 if unknown) */
+	unsigned long next_size;
 };
 
 /** Possible options for OpenSBI library */
@@ -79,12 +116,36 @@ enum sbi_scratch_options {
 	SBI_SCRATCH_NO_BOOT_PRINTS = (1 << 0),
 	/** Enable runtime debug prints */
 	SBI_SCRATCH_DEBUG_PRINTS = (1 << 1),
+	/** Use lock-free mailboxes for remote TLB flush requests */
+	SBI_SCRATCH_TLB_MAILBOX = (1 << 2),
+	/** Buffer console output in per-HART rings */
+	SBI_SCRATCH_CONSOLE_BUFFERED = (1 << 3),
+	/**
+	 * Use the FDT passed by previous booting stage in place instead of
+	 * copying it to the FDT address of the firmware when it has enough
+	 * free space for the fix-ups
+	 */
+	SBI_SCRATCH_FDT_IN_PLACE = SBI_SCRATCH_FDT_IN_PLACE_BIT,
+	/** Select the IPI device with the lowest measured latency at boot */
+	SBI_SCRATCH_IPI_SELFTEST = (1 << 5),
 };
 
 /** Get pointer to sbi_scratch for current HART */
 #define sbi_scratch_thishart_ptr() \
 	((struct sbi_scratch *)csr_read(CSR_MSCRATCH))
 
+/**
+ * Get HART id of current HART without reading mhartid
+ *
+ * Only valid after sbi_scratch_init(), use current_hartid() before that.
+ */
+#define sbi_current_hartid() \
+	((u32)(sbi_scratch_thishart_ptr()->hartid))
+
+/** Get platform HART index of current HART (after sbi_scratch_init()) */
+#define sbi_current_hartindex() \
+	((u32)(sbi_scratch_thishart_ptr()->hartindex))
+
 /** Get Arg1 of next booting stage for current HART */
 #define sbi_scratch_thishart_arg1_ptr() \
 	((void *)(sbi_scratch_thishart_ptr()->next_arg1))
@@ -100,7 +161,35 @@ int sbi_scratch_init(struct sbi_scratch *scratch);
  */
 unsigned long sbi_scratch_alloc_offset(unsigned long size, const char *owner);
 
-/** Free-up extra space in sbi_scratch */
+/**
+ * Allocate from extra space in sbi_scratch with given alignment
+ *
+ * The size is rounded up to the alignment so with SBI_SCRATCH_CACHELINE_SIZE
+ * data written by remote HARTs does not share a cacheline with other data
+ * (provided the scratch space itself is cacheline aligned).
+ *
+ * @param size number of bytes to allocate
+ * @param align alignment of the offset (power of two)
+ * @param owner name of the allocation owner
+ *
+ * @return zero on failure and non-zero (>= SBI_SCRATCH_EXTRA_SPACE_OFFSET)
+ * on success
+ */
+unsigned long sbi_scratch_alloc_aligned_offset(unsigned long size,
+					       unsigned long align,
+					       const char *owner);
+
+/**
+ * Allocate from extra space in sbi_scratch for data written by remote
+ * HARTs (such as locks, pending bits and counters updated by other HARTs)
+ * so that it never shares a cacheline with data written locally.
+ */
+#define sbi_scratch_alloc_remote_offset(__size, __owner)		\
+	sbi_scratch_alloc_aligned_offset(__size,			\
+					 SBI_SCRATCH_CACHELINE_SIZE,	\
+					 __owner)
+
+/** Free-up extra space in sbi_scratch so that it can be allocated again */
 void sbi_scratch_free_offset(unsigned long offset);
 
 /** Get pointer from offset in sbi_scratch */
@@ -0,0 +1,63 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifndef __SBI_STA_H__
+#define __SBI_STA_H__
+
+#include <sbi/sbi_types.h>
+
+/* clang-format off */
+
+/** Size and alignment of the steal-time record */
+#define SBI_STA_SHMEM_SIZE			64
+
+/* clang-format on */
+
+/**
+ * Steal-time record of a HART in supervisor memory
+ *
+ * The layout is the one of the SBI STA extension. M-mode adds the
+ * nanoseconds which the HART spent in M-mode to steal and makes the
+ * sequence odd while doing so, so supervisor reads the record again
+ * when the sequence is odd or changed meanwhile.
+ */
+struct sbi_sta_record {
+	u32 sequence;
+	u32 flags;
+	u64 steal;
+	u8 preempted;
+	u8 pad[47];
+};
+
+struct sbi_scratch;
+
+#ifdef SBI_STEAL_TIME
+
+/**
+ * Get start timestamp of a trap for steal-time accounting
+ *
+ * @return zero if the current HART has no steal-time record
+ */
+u64 sbi_sta_start(void);
+
+/** Account the trap started at given timestamp as steal time */
+void sbi_sta_account(u64 start);
+
+/** Initialize steal-time accounting */
+int sbi_sta_init(struct sbi_scratch *scratch, bool cold_boot);
+
+#else
+
+static inline u64 sbi_sta_start(void) { return 0; }
+
+static inline void sbi_sta_account(u64 start) { }
+
+static inline int sbi_sta_init(struct sbi_scratch *scratch,
+			       bool cold_boot) { return 0; }
+
+#endif
+
+#endif
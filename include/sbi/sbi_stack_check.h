@@ -0,0 +1,58 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifndef __SBI_STACK_CHECK_H__
+#define __SBI_STACK_CHECK_H__
+
+#include <sbi/sbi_types.h>
+
+/* clang-format off */
+
+/** Pattern of unused stack memory */
+#define SBI_STACK_CHECK_PATTERN		((unsigned long)0x5bad5bad5bad5badULL)
+/** Bytes at the bottom of the HART stack which must never be used */
+#define SBI_STACK_CHECK_GUARD_SIZE	64
+
+/* clang-format on */
+
+struct sbi_scratch;
+
+#ifdef SBI_STACK_CHECK
+
+/** Hang current HART if it has overflowed its stack */
+void sbi_stack_check(void);
+
+/**
+ * Get the stack high-water mark of a HART
+ *
+ * @param hartid HART to query
+ * @param out_used maximum number of stack bytes ever used by the HART
+ * @param out_size usable size of the HART stack (without scratch space)
+ *
+ * @return 0 on success, SBI_ENOENT if the HART stack was never checked
+ * and other negative error code on failure
+ */
+int sbi_stack_check_get(u32 hartid, unsigned long *out_used,
+			unsigned long *out_size);
+
+/** Print stack high-water marks of all HARTs */
+void sbi_stack_check_dump(void);
+
+/** Fill unused stack of current HART with the check pattern */
+int sbi_stack_check_init(struct sbi_scratch *scratch, bool cold_boot);
+
+#else
+
+static inline void sbi_stack_check(void) { }
+
+static inline void sbi_stack_check_dump(void) { }
+
+static inline int sbi_stack_check_init(struct sbi_scratch *scratch,
+				       bool cold_boot) { return 0; }
+
+#endif
+
+#endif
@@ -32,4 +32,52 @@ bool sbi_system_reset_supported(u32 reset_type, u32 reset_reason);
 
 void __noreturn sbi_system_reset(u32 reset_type, u32 reset_reason);
 
+/**
+ * Restart the next booting stage of the current domain without a reset
+ *
+ * The other harts of the domain are stopped and the firmware state is
+ * kept. Only returns (with an error code) if the arguments are invalid.
+ *
+ * @param next_addr address of the new next booting stage
+ * @param next_arg1 argument (usually the FDT address) passed in a1
+ */
+int sbi_system_warm_restart(unsigned long next_addr, unsigned long next_arg1);
+
+struct sbi_scratch;
+
+/** System suspend device */
+struct sbi_system_suspend_device {
+	/** Name of the system suspend device */
+	char name[32];
+
+	/* Check whether sleep type is supported by the device */
+	int (*system_suspend_check)(u32 sleep_type);
+
+	/**
+	 * Suspend the system
+	 *
+	 * The system resumes at mmode_resume_addr (the warm boot entry)
+	 * with only the interrupt controller, IPI and timer devices
+	 * needing to be initialized again. Returns zero if the suspend
+	 * has ended without losing the HART state (for example after a
+	 * WFI) and an error code if the system was not suspended.
+	 */
+	int (*system_suspend)(u32 sleep_type, unsigned long mmode_resume_addr);
+};
+
+const struct sbi_system_suspend_device *sbi_system_suspend_get_device(void);
+
+void sbi_system_suspend_set_device(const struct sbi_system_suspend_device *dev);
+
+bool sbi_system_suspend_supported(u32 sleep_type);
+
+int sbi_system_suspend(u32 sleep_type, unsigned long resume_addr,
+		       unsigned long opaque);
+
+/** Is the current resume from warm boot the end of a system suspend */
+bool sbi_system_is_suspended(void);
+
+/** Initialize the devices which lost their state in a system suspend */
+int sbi_system_resume(struct sbi_scratch *scratch);
+
 #endif
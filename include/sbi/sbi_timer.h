@@ -10,8 +10,90 @@
 #ifndef __SBI_TIMER_H__
 #define __SBI_TIMER_H__
 
+/* clang-format off */
+
+/** Offset of s_event member in sbi_timer_events */
+#define SBI_TIMER_EVENTS_S_EVENT_OFFSET		(0)
+/** Offset of m_event member in sbi_timer_events */
+#define SBI_TIMER_EVENTS_M_EVENT_OFFSET		(8)
+/** Offset of fast_timecmp member in sbi_timer_events */
+#define SBI_TIMER_EVENTS_FAST_TIMECMP_OFFSET	(16 + 0 * __SIZEOF_POINTER__)
+/** Offset of fast_delta member in sbi_timer_events */
+#define SBI_TIMER_EVENTS_FAST_DELTA_OFFSET	(16 + 1 * __SIZEOF_POINTER__)
+/** Offset of fast_time member in sbi_timer_events */
+#define SBI_TIMER_EVENTS_FAST_TIME_OFFSET	(16 + 2 * __SIZEOF_POINTER__)
+/** Offset of fast_tmp0 member in sbi_timer_events */
+#define SBI_TIMER_EVENTS_FAST_TMP0_OFFSET	(16 + 3 * __SIZEOF_POINTER__)
+/** Offset of fast_tmp1 member in sbi_timer_events */
+#define SBI_TIMER_EVENTS_FAST_TMP1_OFFSET	(16 + 4 * __SIZEOF_POINTER__)
+/** Offset of fast_tmp2 member in sbi_timer_events */
+#define SBI_TIMER_EVENTS_FAST_TMP2_OFFSET	(16 + 5 * __SIZEOF_POINTER__)
+/** Offset of r_event member in sbi_timer_events */
+#define SBI_TIMER_EVENTS_R_EVENT_OFFSET		(16 + 6 * __SIZEOF_POINTER__)
+
+/** Maximum number of pending firmware timer events per HART */
+#define SBI_TIMER_MEVENT_MAX			4
+
+/* clang-format on */
+
+#ifndef __ASSEMBLER__
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_encoding.h>
+#include <sbi/riscv_locks.h>
 #include <sbi/sbi_types.h>
 
+struct sbi_scratch;
+
+/** Pending firmware timer event */
+struct sbi_timer_mevent {
+	/** Absolute time of the event */
+	u64 time;
+	/** Callback of the event (also identifies the event) */
+	void (*fn)(struct sbi_scratch *scratch);
+};
+
+/**
+ * Per-HART timer events
+ *
+ * The single M-mode timer of a HART is shared between the timer event
+ * requested by supervisor and the pending firmware timer events. The
+ * fast_xyz members are used by the trap vector to handle the set_timer
+ * call and TIME CSR reads without entering C code, so the layout must
+ * match the offsets defined above.
+ */
+struct sbi_timer_events {
+	/** Next timer event requested by supervisor */
+	u64 s_event;
+	/** Earliest pending firmware timer event */
+	u64 m_event;
+	/** Address of 64-bit time compare register (0 disables fast path) */
+	unsigned long fast_timecmp;
+	/** Address of time delta subtracted before programming timecmp */
+	unsigned long fast_delta;
+	/** Address of 64-bit time register (0 disables fast path) */
+	unsigned long fast_time;
+	/** Temporary storage for the fast path */
+	unsigned long fast_tmp0;
+	unsigned long fast_tmp1;
+	unsigned long fast_tmp2;
+	/** Earliest timer event requested by other HARTs */
+	u64 r_event;
+	/** Lock serializing time compare writes with other HARTs */
+	spinlock_t r_lock;
+	/** Number of pending firmware timer events */
+	u32 mevent_count;
+	/** Pending firmware timer events sorted by time */
+	struct sbi_timer_mevent mevents[SBI_TIMER_MEVENT_MAX];
+	/** Set_timer fast path disabled by sbi_timer_event_fast_path() */
+	bool fast_event_off;
+	/** Ticks by which supervisor timer events may be delayed */
+	unsigned long slack;
+};
+
+/** Offset of sbi_timer_events in sbi_scratch */
+extern unsigned long sbi_timer_events_off;
+
 /** Timer hardware device */
 struct sbi_timer_device {
 	/** Name of the timer operations */
@@ -25,12 +107,85 @@ struct sbi_timer_device {
 
 	/** Stop timer event for current HART */
 	void (*timer_event_stop)(void);
+
+	/**
+	 * Get registers for the set_timer fast path of current HART
+	 * (optional)
+	 *
+	 * Provides the address of the 64-bit MMIO time compare register
+	 * and the address of the u64 delta so that the trap vector can
+	 * program "*timecmp = next_event - *delta" directly. Returns
+	 * non-zero if the fast path can't be used for current HART.
+	 */
+	int (*timer_event_fast_regs)(unsigned long *timecmp_addr,
+				     unsigned long *delta_addr);
+
+	/**
+	 * Get registers for the TIME CSR emulation fast path of current
+	 * HART (optional)
+	 *
+	 * Provides the address of the 64-bit MMIO time register and the
+	 * address of the u64 delta so that the trap vector can emulate
+	 * "csrr rd, time" as "rd = *time + *delta". Returns non-zero if
+	 * the fast path can't be used for current HART.
+	 */
+	int (*timer_value_fast_regs)(unsigned long *time_addr,
+				     unsigned long *delta_addr);
+
+	/**
+	 * Get time compare of any HART (optional)
+	 *
+	 * Together with timer_event_set() this allows programming timer
+	 * events of other HARTs. Returns -1ULL when no event is armed.
+	 */
+	u64 (*timer_event_get)(u32 hartid);
+
+	/** Program time compare of any HART (optional) */
+	void (*timer_event_set)(u32 hartid, u64 next_event);
+
+	/**
+	 * Get time synchronization status of any HART (optional)
+	 *
+	 * Provides the skew of the HART time from the reference time
+	 * measured by the last synchronization and the error bound of
+	 * that measurement. Both are zero for the reference time itself.
+	 */
+	int (*timer_sync_get)(u32 hartid, s64 *out_skew, u64 *out_error);
 };
 
 struct sbi_scratch;
 
+/**
+ * TRUE when the timer is read through the TIME CSR
+ * Note: This is set once by the coldboot HART so that reading the timer
+ * is a well predicted branch around an inlined rdtime.
+ */
+extern bool sbi_timer_time_csr;
+
+/** Get timer value for current HART through the timer device */
+u64 __sbi_timer_value(void);
+
 /** Get timer value for current HART */
-u64 sbi_timer_value(void);
+static inline u64 sbi_timer_value(void)
+{
+#if __riscv_xlen == 32
+	u32 lo, hi, tmp;
+
+	if (likely(sbi_timer_time_csr)) {
+		do {
+			hi  = csr_read(CSR_TIMEH);
+			lo  = csr_read(CSR_TIME);
+			tmp = csr_read(CSR_TIMEH);
+		} while (hi != tmp);
+		return ((u64)hi << 32) | lo;
+	}
+#else
+	if (likely(sbi_timer_time_csr))
+		return csr_read(CSR_TIME);
+#endif
+
+	return __sbi_timer_value();
+}
 
 /** Get virtualized timer value for current HART */
 u64 sbi_timer_virt_value(void);
@@ -47,12 +202,101 @@ void sbi_timer_set_delta_upper(ulong delta_upper);
 /** Start timer event for current HART */
 void sbi_timer_event_start(u64 next_event);
 
+/**
+ * Enable or disable the set_timer fast path of current HART
+ *
+ * Calls handled by the trap vector fast path don't reach
+ * sbi_timer_event_start() so it must be disabled while someone needs
+ * to observe every set_timer call (e.g. a PMU firmware counter).
+ */
+void sbi_timer_event_fast_path(bool enable);
+
+/**
+ * Re-evaluate the set_timer fast path of current HART
+ *
+ * The fast path is only used when the domain of the HART may use the
+ * TIME extension so this must be called when the domain changes.
+ */
+void sbi_timer_event_fast_path_update(void);
+
+/**
+ * Enable or disable the TIME CSR emulation fast path of current HART
+ *
+ * Same as sbi_timer_event_fast_path() for TIME CSR reads which would
+ * otherwise bypass sbi_emulate_csr_read().
+ */
+void sbi_timer_value_fast_path(bool enable);
+
+/**
+ * Set the timer slack of a HART
+ *
+ * Supervisor timer events of the HART may then fire up to slack ticks
+ * late so that they coincide with other wakeups, zero keeps them exact.
+ * The slack is kept across HSM stop/start and suspend.
+ */
+void sbi_timer_slack_set(struct sbi_scratch *scratch, unsigned long slack);
+
+/** Get the timer slack of a HART */
+unsigned long sbi_timer_slack_get(struct sbi_scratch *scratch);
+
 /** Process timer event for current HART */
+/**
+ * Start firmware timer event for current HART
+ *
+ * Firmware timer events share the M-mode timer with the supervisor
+ * timer event. Up to SBI_TIMER_MEVENT_MAX events with different
+ * callbacks can be pending per HART. Starting the event of a callback
+ * which is already pending moves it to the new time.
+ *
+ * @param next_event absolute time of the event
+ * @param fn callback invoked from timer interrupt when event expires
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int sbi_timer_mevent_start(u64 next_event,
+			   void (*fn)(struct sbi_scratch *scratch));
+
+/** Stop pending firmware timer event of a callback on current HART */
+void sbi_timer_mevent_stop(void (*fn)(struct sbi_scratch *scratch));
+
+/**
+ * Start timer event of another HART
+ *
+ * The time compare of the target HART is programmed directly so that
+ * it is woken up (from WFI or any lower privilege mode) at the given
+ * time without an IPI. The event has no callback, it only serves as a
+ * wake up, and is dropped when the target HART re-initializes its
+ * timer so the target HART must be started.
+ *
+ * @param hartid target HART (may be current HART)
+ * @param next_event absolute time of the event
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int sbi_timer_remote_event_start(u32 hartid, u64 next_event);
+
+/**
+ * Get time synchronization status of a HART
+ *
+ * @param hartid HART to query
+ * @param out_skew measured skew of the HART time from the reference
+ * @param out_error error bound of the measured skew
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int sbi_timer_sync_get(u32 hartid, s64 *out_skew, u64 *out_error);
+
 void sbi_timer_process(void);
 
 /** Get current timer device */
 const struct sbi_timer_device *sbi_timer_get_device(void);
 
+/** Set timer frequency in Hz (zero if unknown) */
+void sbi_timer_set_freq(unsigned long freq);
+
+/** Get timer frequency in Hz (zero if unknown) */
+unsigned long sbi_timer_get_freq(void);
+
 /** Register timer device */
 void sbi_timer_set_device(const struct sbi_timer_device *dev);
 
@@ -63,3 +307,5 @@ int sbi_timer_init(struct sbi_scratch *scratch, bool cold_boot);
 void sbi_timer_exit(struct sbi_scratch *scratch);
 
 #endif
+
+#endif
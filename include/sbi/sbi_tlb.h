@@ -11,16 +11,18 @@
 #ifndef __SBI_TLB_H__
 #define __SBI_TLB_H__
 
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_atomic.h>
 #include <sbi/sbi_types.h>
-#include <sbi/sbi_hartmask.h>
 
 /* clang-format off */
 
 #define SBI_TLB_FLUSH_ALL			((unsigned long)-1)
 
-/* clang-format on */
+/** Request to be forwarded to the other target HARTs of the cluster */
+#define SBI_TLB_INFO_FORWARD			(1U << 0)
 
-#define SBI_TLB_FIFO_NUM_ENTRIES		8
+/* clang-format on */
 
 struct sbi_scratch;
 
@@ -30,7 +32,16 @@ struct sbi_tlb_info {
 	unsigned long asid;
 	unsigned long vmid;
 	void (*local_fn)(struct sbi_tlb_info *tinfo);
-	struct sbi_hartmask smask;
+	/** Distance between two flushed addresses (power of 2 >= PAGE_SIZE) */
+	unsigned long stride;
+	/** HART id of the source HART */
+	u32 src_hartid;
+	/** Request generation of the source HART */
+	u32 src_gen;
+	/** SBI_TLB_INFO_xyz flags */
+	u32 flags;
+	/** Completion counter of the forwarding HART (NULL for source) */
+	atomic_t *done;
 };
 
 void sbi_tlb_local_hfence_vvma(struct sbi_tlb_info *tinfo);
@@ -48,13 +59,116 @@ do { \
 	(__p)->asid = (__asid); \
 	(__p)->vmid = (__vmid); \
 	(__p)->local_fn = (__lfn); \
-	SBI_HARTMASK_INIT_EXCEPT(&(__p)->smask, (__src)); \
+	(__p)->stride = PAGE_SIZE; \
+	(__p)->src_hartid = (__src); \
+	(__p)->src_gen = 0; \
+	(__p)->flags = 0; \
+	(__p)->done = NULL; \
 } while (0)
 
 #define SBI_TLB_INFO_SIZE		sizeof(struct sbi_tlb_info)
 
+/**
+ * Fence descriptor in the RFENCE_BATCH shared memory of a HART
+ *
+ * The id is the ASID for the ASID variants and the VMID for
+ * HFENCE_GVMA_VMID, it is ignored otherwise.
+ */
+struct sbi_rfence_desc {
+	/** One of SBI_EXT_RFENCE_REMOTE_xyz */
+	unsigned long funcid;
+	unsigned long start;
+	unsigned long size;
+	unsigned long id;
+};
+
+#define SBI_TLB_FLUSH_OPS_MAX		4
+
+/**
+ * Local TLB range flush backend
+ *
+ * The flush all cases are always handled by the generic code. Only the
+ * range flushes are delegated to the backend. The stride is the distance
+ * between two flushed addresses which is larger than PAGE_SIZE for ranges
+ * mapped by huge pages. A NULL callback falls back to flushing one stride
+ * at a time.
+ */
+struct sbi_tlb_flush_ops {
+	/** Name of the flush backend */
+	char name[32];
+
+	/** Check whether backend can be used by the current HART */
+	bool (*probe)(struct sbi_scratch *scratch);
+
+	/** Flush range of virtual addresses for all ASIDs */
+	void (*sfence_vma)(unsigned long start, unsigned long size,
+			   unsigned long stride);
+
+	/** Flush range of virtual addresses for given ASID */
+	void (*sfence_vma_asid)(unsigned long start, unsigned long size,
+				unsigned long stride, unsigned long asid);
+
+	/** Flush range of guest physical addresses for all VMIDs */
+	void (*hfence_gvma)(unsigned long start, unsigned long size,
+			    unsigned long stride);
+
+	/** Flush range of guest physical addresses for given VMID */
+	void (*hfence_gvma_vmid)(unsigned long start, unsigned long size,
+				 unsigned long stride, unsigned long vmid);
+
+	/** Flush range of guest virtual addresses for current VMID */
+	void (*hfence_vvma)(unsigned long start, unsigned long size,
+			    unsigned long stride);
+
+	/** Flush range of guest virtual addresses for given ASID */
+	void (*hfence_vvma_asid)(unsigned long start, unsigned long size,
+				 unsigned long stride, unsigned long asid);
+};
+
+int sbi_tlb_register_flush_ops(const struct sbi_tlb_flush_ops *ops);
+
+const struct sbi_tlb_flush_ops *sbi_tlb_get_flush_ops(
+					struct sbi_scratch *scratch);
+
 int sbi_tlb_request(ulong hmask, ulong hbase, struct sbi_tlb_info *tinfo);
 
+/**
+ * Request several remote fences for the same target HARTs
+ *
+ * Requests for the same address space are merged into one request
+ * (modifying the tinfo array) before the remaining ones are sent.
+ */
+int sbi_tlb_request_many(ulong hmask, ulong hbase,
+			 struct sbi_tlb_info *tinfo, u32 count);
+
+/**
+ * Request remote fences without waiting for the target HARTs
+ *
+ * The generation of the request is returned in seq. When all target
+ * HARTs are done, it is written to the completion word registered with
+ * sbi_tlb_async_set() and an S-mode IPI is raised on the current HART
+ * if that was asked for. The next request of the current HART waits for
+ * the completion of an outstanding asynchronous request.
+ */
+int sbi_tlb_request_async(ulong hmask, ulong hbase,
+			  struct sbi_tlb_info *tinfo, unsigned long *seq);
+
+/**
+ * Set how completion of asynchronous requests of the current HART is
+ * signalled (zero addr and FALSE ssip disable asynchronous requests)
+ */
+int sbi_tlb_async_set(unsigned long addr, bool ssip);
+
+/** Set RFENCE_BATCH shared memory of the current HART (count 0 disables) */
+int sbi_tlb_shmem_set(unsigned long addr, unsigned long count);
+
+/** Get RFENCE_BATCH shared memory of the current HART */
+struct sbi_rfence_desc *sbi_tlb_shmem_get(unsigned long *count);
+
+void sbi_tlb_lazy_enter(struct sbi_scratch *scratch);
+
+void sbi_tlb_lazy_exit(struct sbi_scratch *scratch);
+
 int sbi_tlb_init(struct sbi_scratch *scratch, bool cold_boot);
 
 #endif
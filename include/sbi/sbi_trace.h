@@ -0,0 +1,111 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifndef __SBI_TRACE_H__
+#define __SBI_TRACE_H__
+
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_types.h>
+
+/* clang-format off */
+
+/** Trace events with their arguments */
+#define SBI_TRACE_TRAP_ENTRY			0	/* mcause, mepc */
+#define SBI_TRACE_TRAP_EXIT			1	/* mcause, mepc */
+#define SBI_TRACE_ECALL				2	/* extid, funcid */
+#define SBI_TRACE_IPI_SEND			3	/* event, target */
+#define SBI_TRACE_IPI_RECV			4	/* event, 0 */
+#define SBI_TRACE_FIFO_FULL			5	/* target, 0 */
+#define SBI_TRACE_HSM_STATE			6	/* hartid, new state */
+#define SBI_TRACE_EVENT_MAX			7
+
+/** Total size of the trace buffer (power of two) */
+#ifndef SBI_TRACE_SIZE
+#define SBI_TRACE_SIZE				0x10000
+#endif
+
+#define SBI_TRACE_MAGIC				0x5254534f	/* "OSTR" */
+#define SBI_TRACE_VERSION			1
+
+/* clang-format on */
+
+/**
+ * Layout of the trace buffer shared with S-mode
+ *
+ * The header is followed by one ring per HART (in HART index order) at
+ * ring_offset + index * ring_size. Each ring starts with a struct
+ * sbi_trace_ring followed by record_count records. Records are written
+ * by their HART only, the head counter counts all records ever written
+ * and is updated after the record so a reader can detect records which
+ * were overwritten while reading by checking head again.
+ */
+struct sbi_trace_header {
+	u32 magic;
+	u32 version;
+	u32 hart_count;
+	u32 record_count;
+	u32 record_size;
+	u32 ring_offset;
+	u32 ring_size;
+	u32 reserved;
+};
+
+struct sbi_trace_ring {
+	u64 head;
+	u32 hartid;
+	u32 reserved[13];
+};
+
+struct sbi_trace_record {
+	/** Platform time of the event */
+	u64 time;
+	/** One of SBI_TRACE_xyz */
+	u32 event;
+	u32 reserved;
+	u64 arg0;
+	u64 arg1;
+};
+
+struct sbi_scratch;
+
+#ifdef SBI_TRACE
+
+/** Bitmask of enabled trace events */
+extern unsigned long sbi_trace_mask;
+
+void __sbi_trace(u32 event, unsigned long arg0, unsigned long arg1);
+
+/** Record a trace event if it is enabled */
+static inline void sbi_trace(u32 event, unsigned long arg0,
+			     unsigned long arg1)
+{
+	if (sbi_trace_mask & (1UL << event))
+		__sbi_trace(event, arg0, arg1);
+}
+
+/** Get physical address and size of the trace buffer */
+int sbi_trace_get_buffer(unsigned long *addr, unsigned long *size);
+
+/** Initialize the trace buffer */
+int sbi_trace_init(struct sbi_scratch *scratch, bool cold_boot);
+
+#else
+
+static inline void sbi_trace(u32 event, unsigned long arg0,
+			     unsigned long arg1) { }
+
+static inline int sbi_trace_get_buffer(unsigned long *addr,
+				       unsigned long *size)
+{
+	return SBI_ENOTSUPP;
+}
+
+static inline int sbi_trace_init(struct sbi_scratch *scratch,
+				 bool cold_boot) { return 0; }
+
+#endif
+
+#endif
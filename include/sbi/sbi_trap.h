@@ -205,8 +205,47 @@ struct sbi_trap_info {
 int sbi_trap_redirect(struct sbi_trap_regs *regs,
 		      struct sbi_trap_info *trap);
 
+/** Number of interrupt and of exception causes which can have a handler */
+#define SBI_TRAP_MAX_CAUSE	__riscv_xlen
+
+/**
+ * Handler of one interrupt or exception cause
+ *
+ * The trap details have 'mcause' in cause with the interrupt bit set
+ * for interrupts. For interrupts and ecalls the tval, tval2 and tinst
+ * are zero and only the caller saved registers of the register state
+ * are valid.
+ *
+ * @return 0 on success and negative error code on failure (which is
+ * fatal for the HART)
+ */
+typedef int (*sbi_trap_handler_t)(struct sbi_trap_regs *regs,
+				  struct sbi_trap_info *trap);
+
+/**
+ * Set the handler of an interrupt or exception cause
+ *
+ * Meant to be called by platforms and drivers from their init hooks.
+ * Interrupts without a handler are fatal and exceptions without a
+ * handler are redirected to the previous mode. The interrupt itself
+ * still has to be enabled in the MIE CSR by the caller.
+ *
+ * @param mcause the 'mcause' value (with the interrupt bit for interrupts)
+ * @param handler new handler or NULL to remove the handler
+ *
+ * @return 0 on success and SBI_EINVAL if the cause is out of range
+ */
+int sbi_trap_set_handler(ulong mcause, sbi_trap_handler_t handler);
+
+/** Bitmap of exception causes redirected to S-mode by the trap vector */
+extern unsigned long sbi_trap_fast_redirect;
+
 struct sbi_trap_regs *sbi_trap_handler(struct sbi_trap_regs *regs);
 
+struct sbi_trap_regs *sbi_trap_msoft_handler(struct sbi_trap_regs *regs);
+
+struct sbi_trap_regs *sbi_trap_mtimer_handler(struct sbi_trap_regs *regs);
+
 void __noreturn sbi_trap_exit(const struct sbi_trap_regs *regs);
 
 #endif
@@ -0,0 +1,147 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifndef __SBI_TRAP_STATS_H__
+#define __SBI_TRAP_STATS_H__
+
+#include <sbi/sbi_types.h>
+
+/* clang-format off */
+
+/** Classes of trap statistics */
+#define SBI_TRAP_STATS_CLASS_EXCEPTION		0
+#define SBI_TRAP_STATS_CLASS_INTERRUPT		1
+#define SBI_TRAP_STATS_CLASS_ECALL		2
+#define SBI_TRAP_STATS_CLASS_CSR		3
+#define SBI_TRAP_STATS_CLASS_LATENCY		4
+
+/** Delivery latencies of the latency class (in timer ticks) */
+#define SBI_TRAP_STATS_LATENCY_TIMER		0
+#define SBI_TRAP_STATS_LATENCY_IPI		1
+#define SBI_TRAP_STATS_LATENCY_MAX		2
+
+/** Number of tracked exception and interrupt causes */
+#define SBI_TRAP_STATS_EXCEPTION_MAX		24
+#define SBI_TRAP_STATS_INTERRUPT_MAX		16
+/** Number of tracked ecall extid/funcid pairs and emulated CSRs */
+#define SBI_TRAP_STATS_ECALL_MAX		12
+#define SBI_TRAP_STATS_CSR_MAX			6
+
+/**
+ * Latency histograms of interrupts and ecalls. Bucket 0 counts events
+ * shorter than 2^SBI_TRAP_STATS_HIST_SHIFT cycles, bucket N > 0 counts
+ * events of [2^(SHIFT + N - 1), 2^(SHIFT + N)) cycles and the last
+ * bucket also counts all longer events.
+ */
+#define SBI_TRAP_STATS_HIST_SHIFT		7
+#define SBI_TRAP_STATS_HIST_BUCKETS		12
+
+/**
+ * Delivery latencies are measured in timer ticks, which are much longer
+ * than cycles, so their histograms use buckets of [2^(N - 1), 2^N) ticks
+ */
+#define SBI_TRAP_STATS_LATENCY_HIST_SHIFT	0
+
+/* clang-format on */
+
+struct sbi_scratch;
+
+#ifdef SBI_TRAP_STATS
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_encoding.h>
+
+/** Get start timestamp for trap statistics */
+static inline unsigned long sbi_trap_stats_start(void)
+{
+	return csr_read(CSR_MCYCLE);
+}
+
+/** Account a trap with given mcause started at given timestamp */
+void sbi_trap_stats_cause(unsigned long mcause, unsigned long start);
+
+/** Account an ecall started at given timestamp */
+void sbi_trap_stats_ecall(unsigned long extid, unsigned long funcid,
+			  unsigned long start);
+
+/** Account an emulated CSR access started at given timestamp */
+void sbi_trap_stats_csr(unsigned long csr_num, unsigned long start);
+
+/**
+ * Account the delivery latency of a timer interrupt or IPI
+ *
+ * @param id one of SBI_TRAP_STATS_LATENCY_xyz
+ * @param expected time (timer value) at which the event was due or sent
+ * @param now time at which the handler was entered (ignored if earlier)
+ */
+void sbi_trap_stats_latency(unsigned long id, u64 expected, u64 now);
+
+/**
+ * Get trap statistics of a HART
+ *
+ * @param hartid HART to query
+ * @param class one of SBI_TRAP_STATS_CLASS_xyz
+ * @param id cause, extension ID or CSR number depending on class
+ * @param subid function ID for ecall class and ignored otherwise
+ * @param out_count number of accounted events
+ * @param out_cycles cumulative mcycle delta of accounted events (timer
+ * ticks for latency class)
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int sbi_trap_stats_get(u32 hartid, unsigned long class, unsigned long id,
+		       unsigned long subid, unsigned long *out_count,
+		       u64 *out_cycles);
+
+/**
+ * Get one latency histogram bucket of a HART
+ *
+ * Only the interrupt, ecall and latency classes have histograms.
+ * Parameters are the same as sbi_trap_stats_get().
+ *
+ * @param bucket histogram bucket (less than SBI_TRAP_STATS_HIST_BUCKETS)
+ * @param out_count number of events accounted in the bucket
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int sbi_trap_stats_get_hist(u32 hartid, unsigned long class,
+			    unsigned long id, unsigned long subid,
+			    unsigned long bucket, unsigned long *out_count);
+
+/** Reset trap statistics of all HARTs */
+void sbi_trap_stats_reset(void);
+
+/** Print trap statistics of all HARTs */
+void sbi_trap_stats_dump(void);
+
+/** Initialize trap statistics */
+int sbi_trap_stats_init(struct sbi_scratch *scratch, bool cold_boot);
+
+#else
+
+static inline unsigned long sbi_trap_stats_start(void) { return 0; }
+
+static inline void sbi_trap_stats_cause(unsigned long mcause,
+					unsigned long start) { }
+
+static inline void sbi_trap_stats_ecall(unsigned long extid,
+					unsigned long funcid,
+					unsigned long start) { }
+
+static inline void sbi_trap_stats_csr(unsigned long csr_num,
+				      unsigned long start) { }
+
+static inline void sbi_trap_stats_latency(unsigned long id, u64 expected,
+					  u64 now) { }
+
+static inline void sbi_trap_stats_dump(void) { }
+
+static inline int sbi_trap_stats_init(struct sbi_scratch *scratch,
+				      bool cold_boot) { return 0; }
+
+#endif
+
+#endif
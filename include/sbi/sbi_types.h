@@ -65,6 +65,14 @@ typedef unsigned long		physical_size_t;
 #define __noreturn		__attribute__((noreturn))
 #define __aligned(x)		__attribute__((aligned(x)))
 
+/*
+ * Code run on every trap is grouped right after the trap vectors and
+ * code only run once by the cold boot HART is grouped at the end of the
+ * firmware text.
+ */
+#define __hot			__attribute__((section(".text.hot")))
+#define __init			__attribute__((section(".text.init")))
+
 #define likely(x) __builtin_expect((x), 1)
 #define unlikely(x) __builtin_expect((x), 0)
 
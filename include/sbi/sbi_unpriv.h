@@ -36,6 +36,41 @@ DECLARE_UNPRIVILEGED_LOAD_FUNCTION(u64)
 DECLARE_UNPRIVILEGED_STORE_FUNCTION(u64)
 DECLARE_UNPRIVILEGED_LOAD_FUNCTION(ulong)
 
+/**
+ * Load up to 8 bytes from a misaligned address with aligned accesses
+ *
+ * MPRV stays set for the whole sequence of at most two loads (three on
+ * RV32 for 8 bytes). Returns the bytes in little-endian order.
+ */
+u64 sbi_load_misaligned(ulong addr, ulong len, struct sbi_trap_info *trap);
+
+/**
+ * Store up to 8 bytes to a misaligned address with aligned accesses
+ *
+ * MPRV stays set for the whole sequence of at most four stores.
+ */
+void sbi_store_misaligned(ulong addr, ulong len, u64 val,
+			  struct sbi_trap_info *trap);
+
+/**
+ * Copy len bytes from lower privilege address src to M-mode buffer dst
+ *
+ * The expected trap handler stays installed for the whole copy and
+ * word accesses are used when both addresses are equally aligned. On a
+ * fault trap->cause is set, trap->tval holds the faulting address and
+ * the bytes before it have been copied.
+ */
+void sbi_copy_from_lower(void *dst, const void *src, ulong len,
+			 struct sbi_trap_info *trap);
+
+/**
+ * Copy len bytes from M-mode buffer src to lower privilege address dst
+ *
+ * Faults are reported the same way as for sbi_copy_from_lower().
+ */
+void sbi_copy_to_lower(void *dst, const void *src, ulong len,
+		       struct sbi_trap_info *trap);
+
 ulong sbi_get_insn(ulong mepc, struct sbi_trap_info *trap);
 
 #endif
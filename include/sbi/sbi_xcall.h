@@ -0,0 +1,65 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifndef __SBI_XCALL_H__
+#define __SBI_XCALL_H__
+
+#include <sbi/riscv_atomic.h>
+#include <sbi/sbi_types.h>
+
+/* clang-format off */
+
+/** Number of cross-calls which can be queued for one HART */
+#define SBI_XCALL_QUEUE_SIZE			16
+
+/* clang-format on */
+
+struct sbi_scratch;
+
+/** Function run on each target HART of a cross-call */
+typedef void (*sbi_xcall_fn_t)(struct sbi_scratch *scratch, void *arg);
+
+/** Completion of an asynchronous cross-call */
+struct sbi_xcall_done {
+	/** Number of target HARTs which have not run the function yet */
+	atomic_t pending;
+};
+
+/**
+ * Run a function on HARTs of the current domain and wait for all of them
+ *
+ * The function runs in IPI context of each target HART. The current
+ * HART runs it too when it is in the hartmask, and does so directly
+ * unless other events are pending for it. HARTs which are stopped are
+ * skipped like for any other IPI.
+ *
+ * @param hmask hartmask of the target HARTs relative to hbase
+ * @param hbase first HART id of hmask or -1UL for all HARTs
+ * @param fn function to run
+ * @param arg argument passed to fn
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int sbi_xcall_run(ulong hmask, ulong hbase, sbi_xcall_fn_t fn, void *arg);
+
+/**
+ * Same as sbi_xcall_run() without waiting for the target HARTs
+ *
+ * The done object and everything fn uses through arg must stay valid
+ * until sbi_xcall_is_done() returns TRUE.
+ */
+int sbi_xcall_run_async(ulong hmask, ulong hbase, sbi_xcall_fn_t fn,
+			void *arg, struct sbi_xcall_done *done);
+
+/** Check whether all target HARTs of an asynchronous cross-call ran it */
+bool sbi_xcall_is_done(struct sbi_xcall_done *done);
+
+/** Wait until all target HARTs of an asynchronous cross-call ran it */
+void sbi_xcall_wait(struct sbi_xcall_done *done);
+
+int sbi_xcall_init(struct sbi_scratch *scratch, bool cold_boot);
+
+#endif
@@ -0,0 +1,12 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifndef __CACHE_FDT_SIFIVE_CCACHE_H__
+#define __CACHE_FDT_SIFIVE_CCACHE_H__
+
+int fdt_sifive_ccache_init(void *fdt);
+
+#endif
@@ -0,0 +1,36 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifndef __CACHE_SIFIVE_CCACHE_H__
+#define __CACHE_SIFIVE_CCACHE_H__
+
+#include <sbi/sbi_types.h>
+
+struct sifive_ccache_data {
+	/** Base address of the cache controller */
+	unsigned long addr;
+	/** Ways usable as cache (0 for all ways) */
+	u32 way_mask;
+	/** Index of the way mask of the D-cache master of HART0 */
+	u32 hart_master_base;
+};
+
+/** ECC events since reset */
+struct sifive_ccache_ecc {
+	u32 dir_fix_count;
+	u32 dir_fail_count;
+	u32 data_fix_count;
+	u32 data_fail_count;
+};
+
+/** Restrict the ways into which a HART may allocate */
+int sifive_ccache_set_hart_way_mask(u32 hartid, u32 way_mask);
+
+int sifive_ccache_get_ecc(struct sifive_ccache_ecc *ecc);
+
+int sifive_ccache_init(struct sifive_ccache_data *ccache);
+
+#endif
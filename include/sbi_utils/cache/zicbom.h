@@ -0,0 +1,14 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifndef __CACHE_ZICBOM_H__
+#define __CACHE_ZICBOM_H__
+
+#include <sbi/sbi_types.h>
+
+int zicbom_cache_init(unsigned long block_size);
+
+#endif
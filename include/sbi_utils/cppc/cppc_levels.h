@@ -0,0 +1,37 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifndef __CPPC_LEVELS_H__
+#define __CPPC_LEVELS_H__
+
+#include <sbi/sbi_types.h>
+
+/**
+ * CPPC on top of a fixed set of performance levels (such as PLL or
+ * clock divider settings) which the platform can switch between.
+ *
+ * The delivered performance counter is mcycle and the reference counter
+ * is time, so the performance unit has to be chosen such that the time
+ * CSR runs at reference_perf.
+ */
+struct cppc_levels {
+	/** Performance of each level in increasing order */
+	const u32 *perf;
+	/** Number of levels */
+	u32 count;
+	/** Index of the highest level which can be sustained */
+	u32 nominal;
+	/** Performance corresponding to the rate of the time CSR */
+	u32 reference_perf;
+	/** Worst case latency (in nanoseconds) of a level change */
+	u32 transition_latency;
+	/** Switch the clock domain of a HART to a level */
+	int (*set_level)(u32 hartid, u32 level);
+};
+
+int cppc_levels_init(const struct cppc_levels *levels);
+
+#endif
@@ -9,6 +9,51 @@
 #ifndef __FDT_FIXUP_H__
 #define __FDT_FIXUP_H__
 
+/**
+ * Make sure the device tree has free space for fix-ups
+ *
+ * The blob is only rewritten with fdt_open_into() (which moves the whole
+ * blob) if it does not already have enough free space. Node offsets stay
+ * valid in either case.
+ *
+ * @param fdt: device tree blob
+ * @param space: number of free bytes needed
+ * @return zero on success and -ve on failure
+ */
+int fdt_fixup_reserve(void *fdt, int space);
+
+/**
+ * Apply device tree overlays on the device tree
+ *
+ * The overlays are placed one after another, each starting at an 8-byte
+ * aligned address, and the list ends at the first address without a FDT
+ * magic. The blob is expanded as needed and the overlays are damaged by
+ * libfdt while being applied, so this can only be done once.
+ *
+ * It is recommended that platform codes call this helper in their
+ * early_init() before probing drivers and before the other fix-ups.
+ *
+ * @param fdt: device tree blob
+ * @param overlays: address of the first overlay
+ * @return zero on success and -ve on failure
+ */
+int fdt_overlays_apply(void *fdt, void *overlays);
+
+/**
+ * Reserve space for all generic device tree fix-ups at once
+ *
+ * This routine expands the device tree once for fdt_cpu_fixup(),
+ * fdt_fixups() and fdt_domain_fixup() so that they don't expand the
+ * blob again one after another.
+ *
+ * It is recommended that platform codes call this helper in their
+ * final_init() before the other fix-ups.
+ *
+ * @param fdt: device tree blob
+ * @return zero on success and -ve on failure
+ */
+int fdt_fixups_expand(void *fdt);
+
 /**
  * Fix up the CPU node in the device tree
  *
@@ -12,11 +12,31 @@
 
 #include <sbi/sbi_types.h>
 
+struct sbi_hart_desc;
+
 struct fdt_match {
 	const char *compatible;
 	void *data;
 };
 
+/* Details of a CPU DT node parsed once by fdt_parse_cpus() */
+struct fdt_cpu {
+	u32 hartid;
+	/* Phandles of the CPU node and its interrupt controller (or 0) */
+	u32 phandle;
+	u32 intc_phandle;
+	/* NUMA node id or -1U */
+	u32 numa_node;
+	/* Cluster id (see fdt_parse_cpu_cluster()) or -1U */
+	u32 cluster;
+	bool mmu;
+	/* Number of PMP regions (riscv,pmp-regions) or -1U */
+	u32 pmp_count;
+	/* SBI_HART_HAS_xyz extensions listed in the ISA properties */
+	unsigned long isa_features;
+	bool isa_valid;
+};
+
 struct platform_uart_data {
 	unsigned long addr;
 	unsigned long freq;
@@ -35,10 +55,34 @@ int fdt_find_match(void *fdt, int startoff,
 int fdt_get_node_addr_size(void *fdt, int node, unsigned long *addr,
 			   unsigned long *size);
 
+int fdt_get_node_addr_size_by_index(void *fdt, int node, int index,
+				    unsigned long *addr, unsigned long *size);
+
 int fdt_parse_hart_id(void *fdt, int cpu_offset, u32 *hartid);
 
 int fdt_parse_max_hart_id(void *fdt, u32 *max_hartid);
 
+int fdt_parse_timebase_frequency(void *fdt, unsigned long *freq);
+
+int fdt_parse_cbom_block_size(void *fdt, unsigned long *size);
+
+int fdt_parse_cpus(void *fdt, const struct fdt_cpu **out_cpus, u32 *out_count);
+
+int fdt_parse_hart_desc(void *fdt, u32 hartid, struct sbi_hart_desc *desc);
+
+int fdt_parse_hart_id_by_phandle(void *fdt, u32 phandle, u32 *hartid);
+
+int fdt_parse_hart_id_by_intc(void *fdt, u32 intc_phandle, u32 *hartid);
+
+int fdt_parse_numa_node_id(void *fdt, int nodeoff, u32 *node_id);
+
+int fdt_parse_cpu_cluster(void *fdt, int cpu_offset, u32 *cluster);
+
+int fdt_check_free_memory(void *fdt, unsigned long addr, unsigned long size);
+
+int fdt_parse_numa_memory(void *fdt, u32 node_id, unsigned long *addr,
+			  unsigned long *size);
+
 int fdt_parse_shakti_uart_node(void *fdt, int nodeoffset,
 			       struct platform_uart_data *uart);
 
@@ -57,12 +101,45 @@ int fdt_parse_plic_node(void *fdt, int nodeoffset, struct plic_data *plic);
 
 int fdt_parse_plic(void *fdt, struct plic_data *plic, const char *compat);
 
+struct imsic_data;
+
+int fdt_parse_imsic_node(void *fdt, int nodeoff, struct imsic_data *imsic);
+
+/** Check whether the FDT has an IMSIC with M-level interrupt files */
+bool fdt_check_imsic_mlevel(void *fdt);
+
+struct aplic_data;
+
+int fdt_parse_aplic_node(void *fdt, int nodeoff, struct aplic_data *aplic);
+
 struct clint_data;
 
 int fdt_parse_clint_node(void *fdt, int nodeoffset, bool for_timer,
 			 struct clint_data *clint);
 
+int fdt_parse_aclint_node(void *fdt, int nodeoffset, bool for_timer,
+			  unsigned long *out_addr1, unsigned long *out_size1,
+			  unsigned long *out_addr2, unsigned long *out_size2,
+			  u32 *out_first_hartid, u32 *out_hart_count);
+
 int fdt_parse_compat_addr(void *fdt, unsigned long *addr,
 			  const char *compatible);
 
+/**
+ * Check the DTB in full once and let libfdt skip its structure checks
+ *
+ * Only the checked DTB may be accessed through libfdt until fdt_untrust()
+ * is called. Returns a negative FDT_ERR_xyz code, and stays untrusted,
+ * for a DTB which fails the check or is not in libfdt read-write layout.
+ * With checked set the full check is skipped for a DTB which the previous
+ * booting stage has already checked, only its layout is checked.
+ */
+int fdt_trust(void *fdt, bool checked);
+
+/** Let libfdt check every DTB access again */
+void fdt_untrust(void);
+
+/** Whether libfdt currently skips its checks */
+bool fdt_trusted(void);
+
 #endif /* __FDT_HELPER_H__ */
@@ -0,0 +1,28 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifndef __FDT_IDLE_STATES_H__
+#define __FDT_IDLE_STATES_H__
+
+/**
+ * Register the HSM suspend states described in the device tree
+ *
+ * Every DT node compatible to "riscv,idle-state" under the
+ * /cpus/idle-states DT node is registered as a HSM suspend state using
+ * its "riscv,sbi-suspend-param", "entry-latency-us", "exit-latency-us"
+ * and "min-residency-us" DT properties. Nodes without a valid suspend
+ * parameter are skipped.
+ *
+ * It is recommended that platform support call this function in
+ * their early_init() platform operation on the coldboot HART.
+ *
+ * @param fdt device tree blob
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int fdt_idle_states_populate(void *fdt);
+
+#endif /* __FDT_IDLE_STATES_H__ */
@@ -0,0 +1,46 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifndef __FDT_INDEX_H__
+#define __FDT_INDEX_H__
+
+#include <sbi/sbi_types.h>
+
+/**
+ * Build the compatible string and phandle index of a device tree
+ *
+ * The index only has node offsets so it becomes stale when the blob is
+ * modified. Lookups detect blobs which changed size but code modifying
+ * the blob in place must call fdt_index_invalidate() first.
+ *
+ * It is recommended that platform support call this function once on
+ * the coldboot HART before probing drivers.
+ *
+ * @param fdt device tree blob
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int fdt_index_init(void *fdt);
+
+/** Drop the index so that lookups scan the device tree again */
+void fdt_index_invalidate(void);
+
+/**
+ * Same as fdt_node_offset_by_compatible() using the index when possible
+ *
+ * @return node offset or -FDT_ERR_NOTFOUND (or other libfdt error)
+ */
+int fdt_index_offset_by_compatible(void *fdt, int startoff,
+				   const char *compatible);
+
+/**
+ * Same as fdt_node_offset_by_phandle() using the index when possible
+ *
+ * @return node offset or -FDT_ERR_NOTFOUND (or other libfdt error)
+ */
+int fdt_index_offset_by_phandle(void *fdt, u32 phandle);
+
+#endif /* __FDT_INDEX_H__ */
@@ -0,0 +1,48 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifndef __IRQCHIP_ECLIC_H__
+#define __IRQCHIP_ECLIC_H__
+
+#include <sbi/sbi_types.h>
+
+/* clang-format off */
+
+/** Interrupt levels used for the M-mode interrupts of OpenSBI */
+#define ECLIC_LEVEL_MSOFT		2
+#define ECLIC_LEVEL_MTIMER		1
+
+/* clang-format on */
+
+struct eclic_data {
+	unsigned long addr;
+	/* Number of interrupt level bits (cliccfg.nlbits) */
+	u32 nlbits;
+	/* Private details (initialized and used by ECLIC library) */
+	u32 num_irq;
+};
+
+/**
+ * Set level, vectoring and enable of an ECLIC interrupt
+ *
+ * A vectored interrupt enters through its entry of the vector table
+ * without decoding mcause. Pending interrupts are taken by level first.
+ */
+int eclic_set_irq(struct eclic_data *ecl, u32 irq, u32 level,
+		  bool vectored, bool enable);
+
+/**
+ * Switch the current HART to ECLIC mode
+ *
+ * The M-mode software and timer interrupts are vectored to the entries
+ * of the (CLINT mode) vector table set up by the firmware. Returns
+ * SBI_ENODEV if the HART keeps using CLINT mode.
+ */
+int eclic_warm_irqchip_init(struct eclic_data *ecl);
+
+int eclic_cold_irqchip_init(struct eclic_data *ecl);
+
+#endif
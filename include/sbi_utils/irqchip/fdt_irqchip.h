@@ -17,10 +17,24 @@ struct fdt_irqchip {
 	int (*cold_init)(void *fdt, int nodeoff, const struct fdt_match *match);
 	int (*warm_init)(void);
 	void (*exit)(void);
+	/** Handle an IRQ of the irqchip node in M-mode (optional) */
+	int (*mmode_irq_set)(void *fdt, int nodeoff, u32 hwirq,
+			     void (*fn)(void));
 };
 
 void fdt_irqchip_exit(void);
 
+/**
+ * Handle the first IRQ of a device node in M-mode on the current HART
+ *
+ * The IRQ is routed to the M-mode context of the current HART and fn
+ * is called from the M-mode external interrupt handler each time the
+ * IRQ is claimed. The device itself still has to raise the IRQ.
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int fdt_irqchip_mmode_irq_set(void *fdt, int nodeoff, void (*fn)(void));
+
 int fdt_irqchip_init(bool cold_boot);
 
 #endif
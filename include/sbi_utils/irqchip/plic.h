@@ -17,6 +17,17 @@ struct plic_data {
 	unsigned long num_src;
 };
 
+/**
+ * Disable all IRQs and thresholds of several contexts in one go
+ *
+ * Contexts with a negative id are skipped. This allows the cold boot
+ * HART to put the contexts of all HARTs in reset state at once, so that
+ * calling plic_warm_irqchip_init() can be skipped on their first warm
+ * boot.
+ */
+int plic_reset_contexts(struct plic_data *plic, const int *cntx_ids,
+			u32 count);
+
 int plic_warm_irqchip_init(struct plic_data *plic,
 			   int m_cntx_id, int s_cntx_id);
 
@@ -26,4 +37,14 @@ void plic_set_thresh(struct plic_data *plic, u32 cntxid, u32 val);
 
 void plic_set_ie(struct plic_data *plic, u32 cntxid, u32 word_index, u32 val);
 
+void plic_set_priority(struct plic_data *plic, u32 irq, u32 val);
+
+void plic_enable_irq(struct plic_data *plic, u32 cntxid, u32 irq,
+		     bool enable);
+
+/** Claim the highest priority pending IRQ of a context (zero if none) */
+u32 plic_claim(struct plic_data *plic, u32 cntxid);
+
+void plic_complete(struct plic_data *plic, u32 cntxid, u32 irq);
+
 #endif
@@ -15,8 +15,19 @@
 struct fdt_serial {
 	const struct fdt_match *match_table;
 	int (*init)(void *fdt, int nodeoff, const struct fdt_match *match);
+	/** Switch to interrupt driven receive (optional) */
+	int (*irq_init)(void *fdt, int nodeoff);
 };
 
 int fdt_serial_init(void);
 
+/**
+ * Let the console receive through its interrupt on the current HART
+ *
+ * This is only done with the opensbi,console-rx-irq DT property in the
+ * /chosen DT node. It has to be called after the irqchip init and before
+ * the FDT is changed. Consoles without an interrupt keep polling.
+ */
+int fdt_serial_irq_init(void);
+
 #endif
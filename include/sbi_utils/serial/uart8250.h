@@ -15,4 +15,13 @@
 int uart8250_init(unsigned long base, u32 in_freq, u32 baudrate, u32 reg_shift,
 		  u32 reg_width);
 
+/** Handle the receive interrupt of the UART */
+void uart8250_rx_irq(void);
+
+/**
+ * Receive into a ring from the receive interrupt which the caller has
+ * to route to uart8250_rx_irq()
+ */
+void uart8250_rx_irq_enable(void);
+
 #endif
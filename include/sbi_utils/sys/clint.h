@@ -18,11 +18,16 @@ struct clint_data {
 	u32 first_hartid;
 	u32 hart_count;
 	bool has_64bit_mmio;
+	/* Ticks between time re-synchronizations (0 to sync only once) */
+	u64 time_sync_period;
 	/* Private details (initialized and used by CLINT library)*/
 	u32 *ipi;
 	struct clint_data *time_delta_reference;
 	unsigned long time_delta_computed;
+	u32 time_sync_hartid;
 	u64 time_delta;
+	s64 time_skew;
+	u64 time_sync_error;
 	u64 *time_val;
 	u64 *time_cmp;
 	u64 (*time_rd)(volatile u64 *addr);
@@ -14,30 +14,55 @@ libsbi-objs-y += riscv_locks.o
 
 libsbi-objs-y += sbi_bitmap.o
 libsbi-objs-y += sbi_bitops.o
+libsbi-objs-y += sbi_boot_timeline.o
+libsbi-objs-y += sbi_cache.o
 libsbi-objs-y += sbi_console.o
+libsbi-objs-y += sbi_cppc.o
 libsbi-objs-y += sbi_domain.o
+libsbi-objs-y += sbi_domain_context.o
 libsbi-objs-y += sbi_ecall.o
 libsbi-objs-y += sbi_ecall_base.o
-libsbi-objs-y += sbi_ecall_hsm.o
-libsbi-objs-y += sbi_ecall_legacy.o
+libsbi-objs-$(SBI_ECALL_CPPC) += sbi_ecall_cppc.o
+libsbi-objs-$(SBI_ECALL_DBCN) += sbi_ecall_dbcn.o
+libsbi-objs-y += sbi_ecall_fw_feature.o
+libsbi-objs-$(SBI_ECALL_HSM) += sbi_ecall_hsm.o
+libsbi-objs-$(SBI_ECALL_LEGACY) += sbi_ecall_legacy.o
+libsbi-objs-y += sbi_ecall_multicall.o
+libsbi-objs-$(SBI_ECALL_PMU) += sbi_ecall_pmu.o
 libsbi-objs-y += sbi_ecall_replace.o
-libsbi-objs-y += sbi_ecall_vendor.o
-libsbi-objs-y += sbi_emulate_csr.o
+libsbi-objs-$(SBI_ECALL_SUSP) += sbi_ecall_susp.o
+libsbi-objs-$(SBI_ECALL_VENDOR) += sbi_ecall_vendor.o
+libsbi-objs-$(SBI_EMULATE_CSR) += sbi_emulate_csr.o
+libsbi-objs-y += sbi_emulate_isa.o
 libsbi-objs-y += sbi_fifo.o
 libsbi-objs-y += sbi_hart.o
+libsbi-objs-y += sbi_heap.o
 libsbi-objs-y += sbi_math.o
+libsbi-objs-y += sbi_measure.o
 libsbi-objs-y += sbi_hfence.o
 libsbi-objs-y += sbi_hsm.o
+libsbi-objs-y += sbi_lock_stats.o
 libsbi-objs-y += sbi_illegal_insn.o
 libsbi-objs-y += sbi_init.o
 libsbi-objs-y += sbi_ipi.o
-libsbi-objs-y += sbi_misaligned_ldst.o
+libsbi-objs-y += sbi_lz4.o
+libsbi-objs-$(SBI_EMULATE_MISALIGNED) += sbi_misaligned_ldst.o
+libsbi-objs-$(SBI_EMULATE_MISALIGNED) += sbi_misaligned_vector.o
 libsbi-objs-y += sbi_platform.o
+libsbi-objs-y += sbi_pmp_swap.o
+libsbi-objs-y += sbi_pmu.o
+libsbi-objs-y += sbi_pmu_sample.o
+libsbi-objs-y += sbi_ring.o
 libsbi-objs-y += sbi_scratch.o
+libsbi-objs-y += sbi_stack_check.o
+libsbi-objs-y += sbi_sta.o
 libsbi-objs-y += sbi_string.o
 libsbi-objs-y += sbi_system.o
 libsbi-objs-y += sbi_timer.o
 libsbi-objs-y += sbi_tlb.o
 libsbi-objs-y += sbi_trap.o
+libsbi-objs-y += sbi_trace.o
+libsbi-objs-y += sbi_trap_stats.o
 libsbi-objs-y += sbi_unpriv.o
+libsbi-objs-y += sbi_xcall.o
 libsbi-objs-y += sbi_expected_trap.o
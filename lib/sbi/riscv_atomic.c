@@ -11,6 +11,9 @@
 #include <sbi/riscv_asm.h>
 #include <sbi/riscv_atomic.h>
 #include <sbi/riscv_barrier.h>
+#include <sbi/riscv_locks.h>
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_scratch.h>
 
 long atomic_read(atomic_t *atom)
 {
@@ -25,21 +28,40 @@ void atomic_write(atomic_t *atom, long value)
 	wmb();
 }
 
-long atomic_add_return(atomic_t *atom, long value)
-{
-	long ret;
 #if __SIZEOF_LONG__ == 4
-	__asm__ __volatile__("	amoadd.w.aqrl  %1, %2, %0"
-			     : "+A"(atom->counter), "=r"(ret)
-			     : "r"(value)
-			     : "memory");
+#define __amoadd_ord(ord) "	amoadd.w" #ord "  %1, %2, %0"
 #elif __SIZEOF_LONG__ == 8
-	__asm__ __volatile__("	amoadd.d.aqrl  %1, %2, %0"
-			     : "+A"(atom->counter), "=r"(ret)
-			     : "r"(value)
-			     : "memory");
+#define __amoadd_ord(ord) "	amoadd.d" #ord "  %1, %2, %0"
 #endif
-	return ret + value;
+
+#define __atomic_add_return_ord(atom, value, ord)			\
+	({								\
+		long __ret;						\
+		__asm__ __volatile__(__amoadd_ord(ord)			\
+				     : "+A"((atom)->counter), "=r"(__ret) \
+				     : "r"(value)			\
+				     : "memory");			\
+		__ret + (value);					\
+	})
+
+long atomic_add_return(atomic_t *atom, long value)
+{
+	return __atomic_add_return_ord(atom, value, .aqrl);
+}
+
+long atomic_add_return_relaxed(atomic_t *atom, long value)
+{
+	return __atomic_add_return_ord(atom, value, );
+}
+
+long atomic_add_return_acquire(atomic_t *atom, long value)
+{
+	return __atomic_add_return_ord(atom, value, .aq);
+}
+
+long atomic_add_return_release(atomic_t *atom, long value)
+{
+	return __atomic_add_return_ord(atom, value, .rl);
 }
 
 long atomic_sub_return(atomic_t *atom, long value)
@@ -47,6 +69,21 @@ long atomic_sub_return(atomic_t *atom, long value)
 	return atomic_add_return(atom, -value);
 }
 
+long atomic_sub_return_relaxed(atomic_t *atom, long value)
+{
+	return atomic_add_return_relaxed(atom, -value);
+}
+
+long atomic_sub_return_acquire(atomic_t *atom, long value)
+{
+	return atomic_add_return_acquire(atom, -value);
+}
+
+long atomic_sub_return_release(atomic_t *atom, long value)
+{
+	return atomic_add_return_release(atom, -value);
+}
+
 #define __axchg(ptr, new, size)							\
 	({									\
 		__typeof__(ptr) __ptr = (ptr);					\
@@ -165,6 +202,58 @@ long atomic_sub_return(atomic_t *atom, long value)
 			__cmpxchg((ptr), _o_, _n_, sizeof(*(ptr))); \
 	})
 
+/*
+ * Ordered variants use the annotation of the AMO or LR/SC instruction
+ * instead of the trailing full fence of __cmpxchg() and __xchg().
+ */
+#if __SIZEOF_LONG__ == 4
+#define __LRSC_SUFFIX	".w"
+#elif __SIZEOF_LONG__ == 8
+#define __LRSC_SUFFIX	".d"
+#endif
+
+#define __cmpxchg_ord(ptr, old, new, lr_ord, sc_ord)			\
+	({								\
+		unsigned long __ret;					\
+		register unsigned int __rc;				\
+		__asm__ __volatile__(					\
+			"0:	lr" __LRSC_SUFFIX #lr_ord " %0, %2\n"	\
+			"	bne  %0, %z3, 1f\n"			\
+			"	sc" __LRSC_SUFFIX #sc_ord " %1, %z4, %2\n"	\
+			"	bnez %1, 0b\n"				\
+			"1:\n"						\
+			: "=&r"(__ret), "=&r"(__rc), "+A"(*(ptr))	\
+			: "rJ"(old), "rJ"(new)				\
+			: "memory");					\
+		__ret;							\
+	})
+
+#define __xchg_ord(ptr, new, ord)					\
+	({								\
+		unsigned long __ret;					\
+		__asm__ __volatile__(					\
+			"	amoswap" __LRSC_SUFFIX #ord " %0, %2, %1\n" \
+			: "=r"(__ret), "+A"(*(ptr))			\
+			: "r"(new)					\
+			: "memory");					\
+		__ret;							\
+	})
+
+long atomic_cmpxchg_relaxed(atomic_t *atom, long oldval, long newval)
+{
+	return __cmpxchg_ord(&atom->counter, oldval, newval, , );
+}
+
+long atomic_cmpxchg_acquire(atomic_t *atom, long oldval, long newval)
+{
+	return __cmpxchg_ord(&atom->counter, oldval, newval, .aq, );
+}
+
+long atomic_cmpxchg_release(atomic_t *atom, long oldval, long newval)
+{
+	return __cmpxchg_ord(&atom->counter, oldval, newval, , .rl);
+}
+
 long atomic_cmpxchg(atomic_t *atom, long oldval, long newval)
 {
 #ifdef __riscv_atomic
@@ -206,6 +295,102 @@ unsigned long atomic_raw_xchg_ulong(volatile unsigned long *ptr,
 #endif
 }
 
+unsigned long atomic_raw_xchg_ulong_relaxed(volatile unsigned long *ptr,
+					    unsigned long newval)
+{
+	return __xchg_ord(ptr, newval, );
+}
+
+unsigned long atomic_raw_xchg_ulong_acquire(volatile unsigned long *ptr,
+					    unsigned long newval)
+{
+	return __xchg_ord(ptr, newval, .aq);
+}
+
+unsigned long atomic_raw_xchg_ulong_release(volatile unsigned long *ptr,
+					    unsigned long newval)
+{
+	return __xchg_ord(ptr, newval, .rl);
+}
+
+unsigned long atomic_raw_cmpxchg_ulong(volatile unsigned long *ptr,
+				       unsigned long oldval,
+				       unsigned long newval)
+{
+	/* Atomically replace oldval with newval and return old value. */
+#ifdef __riscv_atomic
+	return __sync_val_compare_and_swap(ptr, oldval, newval);
+#else
+	return cmpxchg(ptr, oldval, newval);
+#endif
+}
+
+unsigned long atomic_raw_cmpxchg_ulong_relaxed(volatile unsigned long *ptr,
+					       unsigned long oldval,
+					       unsigned long newval)
+{
+	return __cmpxchg_ord(ptr, oldval, newval, , );
+}
+
+unsigned long atomic_raw_cmpxchg_ulong_acquire(volatile unsigned long *ptr,
+					       unsigned long oldval,
+					       unsigned long newval)
+{
+	return __cmpxchg_ord(ptr, oldval, newval, .aq, );
+}
+
+unsigned long atomic_raw_cmpxchg_ulong_release(volatile unsigned long *ptr,
+					       unsigned long oldval,
+					       unsigned long newval)
+{
+	return __cmpxchg_ord(ptr, oldval, newval, , .rl);
+}
+
+/* Serializes double word compare and swap on HARTs without Zacas */
+static spinlock_t cmpxchg_dword_lock = SPIN_LOCK_INITIALIZER;
+
+bool atomic_raw_cmpxchg_dword(volatile unsigned long *ptr,
+			      unsigned long *oldval,
+			      const unsigned long *newval)
+{
+	register unsigned long r0 asm("a0") = oldval[0];
+	register unsigned long r1 asm("a1") = oldval[1];
+	register unsigned long n0 asm("a6") = newval[0];
+	register unsigned long n1 asm("a7") = newval[1];
+	register unsigned long addr asm("a5") = (unsigned long)ptr;
+	bool ret;
+
+	if (sbi_hart_has_feature(sbi_scratch_thishart_ptr(),
+				 SBI_HART_HAS_ZACAS)) {
+		__asm__ __volatile__(
+#if __riscv_xlen == 64
+			/* AMOCAS.Q.AQRL a0, a6, (a5) */
+			".word 0x2f07c52f\n"
+#else
+			/* AMOCAS.D.AQRL a0, a6, (a5) */
+			".word 0x2f07b52f\n"
+#endif
+			: "+r"(r0), "+r"(r1)
+			: "r"(n0), "r"(n1), "r"(addr)
+			: "memory");
+	} else {
+		spin_lock(&cmpxchg_dword_lock);
+		r0 = ptr[0];
+		r1 = ptr[1];
+		if (r0 == oldval[0] && r1 == oldval[1]) {
+			ptr[0] = n0;
+			ptr[1] = n1;
+		}
+		spin_unlock(&cmpxchg_dword_lock);
+	}
+
+	ret = (r0 == oldval[0] && r1 == oldval[1]) ? TRUE : FALSE;
+	oldval[0] = r0;
+	oldval[1] = r1;
+
+	return ret;
+}
+
 #if (__SIZEOF_POINTER__ == 8)
 #define __AMO(op) "amo" #op ".d"
 #elif (__SIZEOF_POINTER__ == 4)
@@ -222,7 +407,7 @@ unsigned long atomic_raw_xchg_ulong(volatile unsigned long *ptr,
 				     : "=r"(__res), "+A"(addr[BIT_WORD(nr)]) \
 				     : "r"(mod(__mask))                      \
 				     : "memory");                            \
-		__res;                                                       \
+		(__res & __mask) ? 1 : 0;                                    \
 	})
 
 #define __atomic_op_bit(op, mod, nr, addr) \
@@ -242,6 +427,49 @@ inline int atomic_raw_clear_bit(int nr, volatile unsigned long *addr)
 	return __atomic_op_bit(and, __NOT, nr, addr);
 }
 
+int atomic_raw_set_bit_relaxed(int nr, volatile unsigned long *addr)
+{
+	return __atomic_op_bit_ord(or, __NOP, nr, addr, );
+}
+
+int atomic_raw_set_bit_acquire(int nr, volatile unsigned long *addr)
+{
+	return __atomic_op_bit_ord(or, __NOP, nr, addr, .aq);
+}
+
+int atomic_raw_set_bit_release(int nr, volatile unsigned long *addr)
+{
+	return __atomic_op_bit_ord(or, __NOP, nr, addr, .rl);
+}
+
+int atomic_raw_clear_bit_relaxed(int nr, volatile unsigned long *addr)
+{
+	return __atomic_op_bit_ord(and, __NOT, nr, addr, );
+}
+
+int atomic_raw_clear_bit_acquire(int nr, volatile unsigned long *addr)
+{
+	return __atomic_op_bit_ord(and, __NOT, nr, addr, .aq);
+}
+
+int atomic_raw_clear_bit_release(int nr, volatile unsigned long *addr)
+{
+	return __atomic_op_bit_ord(and, __NOT, nr, addr, .rl);
+}
+
+unsigned long atomic_raw_fetch_or_ulong(volatile unsigned long *ptr,
+					unsigned long mask)
+{
+	unsigned long res;
+
+	__asm__ __volatile__(__AMO(or) ".aqrl %0, %2, %1"
+			     : "=r"(res), "+A"(*ptr)
+			     : "r"(mask)
+			     : "memory");
+
+	return res;
+}
+
 inline int atomic_set_bit(int nr, atomic_t *atom)
 {
 	return atomic_raw_set_bit(nr, (unsigned long *)&atom->counter);
@@ -5,8 +5,86 @@
  * Copyright (c) 2021 Christoph Müllner <cmuellner@linux.com>
  */
 
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_atomic.h>
 #include <sbi/riscv_barrier.h>
 #include <sbi/riscv_locks.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_lock_stats.h>
+#include <sbi/sbi_scratch.h>
+
+/* Bounds of the spin wait backoff (in PAUSE instructions) */
+#define SPIN_WAIT_BACKOFF_MIN	4
+#define SPIN_WAIT_BACKOFF_MAX	1024
+
+/* Queued spinlocks a HART can hold or wait for at the same time */
+#define QSPIN_NODES_MAX		4
+/* Node value of a lock holder which has no node */
+#define QSPIN_NODELESS		1UL
+
+static inline bool spin_wait_use_zawrs(void)
+{
+	return sbi_hart_has_feature(sbi_scratch_thishart_ptr(),
+				    SBI_HART_HAS_ZAWRS);
+}
+
+static void spin_wait_backoff(unsigned long *backoff)
+{
+	unsigned long i;
+
+	if (*backoff < SPIN_WAIT_BACKOFF_MIN)
+		*backoff = SPIN_WAIT_BACKOFF_MIN;
+	else if (*backoff < SPIN_WAIT_BACKOFF_MAX)
+		*backoff <<= 1;
+
+	for (i = 0; i < *backoff; i++)
+		pause();
+}
+
+void spin_wait_u32(volatile u32 *ptr, u32 val, unsigned long *backoff)
+{
+	u32 tmp;
+
+	if (!spin_wait_use_zawrs()) {
+		spin_wait_backoff(backoff);
+		return;
+	}
+
+	/* The load reservation is the address watched by WRS.NTO */
+	__asm__ __volatile__(
+		"	lr.w	%0, %1\n"
+		"	bne	%0, %2, 1f\n"
+		"	.word	0x00d00073\n"
+		"1:"
+		: "=&r"(tmp), "+A"(*ptr)
+		: "r"(val)
+		: "memory");
+}
+
+void spin_wait_ulong(volatile unsigned long *ptr, unsigned long val,
+		     unsigned long *backoff)
+{
+	unsigned long tmp;
+
+	if (!spin_wait_use_zawrs()) {
+		spin_wait_backoff(backoff);
+		return;
+	}
+
+	__asm__ __volatile__(
+#if __riscv_xlen == 64
+		"	lr.d	%0, %1\n"
+#else
+		"	lr.w	%0, %1\n"
+#endif
+		"	bne	%0, %2, 1f\n"
+		"	.word	0x00d00073\n"
+		"1:"
+		: "=&r"(tmp), "+A"(*ptr)
+		: "r"(val)
+		: "memory");
+}
 
 static inline int spin_lock_unlocked(spinlock_t lock)
 {
@@ -48,30 +126,278 @@ int spin_trylock(spinlock_t *lock)
 void spin_lock(spinlock_t *lock)
 {
 	unsigned long inc = 1u << TICKET_SHIFT;
-	unsigned long mask = 0xffffu;
-	u32 l0, tmp1, tmp2;
+	unsigned long backoff = 0, stats_start = 0;
+	volatile u32 *word = (volatile u32 *)lock;
+	u32 l0, ticket;
+	bool contended;
 
+	/* Atomically increment the next ticket. */
 	__asm__ __volatile__(
-		/* Atomically increment the next ticket. */
-		"	amoadd.w.aqrl	%0, %4, %3\n"
-
-		/* Did we get the lock? */
-		"	srli	%1, %0, %6\n"
-		"	and	%1, %1, %5\n"
-		"1:	and	%2, %0, %5\n"
-		"	beq	%1, %2, 2f\n"
-
-		/* If not, then spin on the lock. */
-		"	lw	%0, %3\n"
-		RISCV_ACQUIRE_BARRIER
-		"	j	1b\n"
-		"2:"
-		: "=&r"(l0), "=&r"(tmp1), "=&r"(tmp2), "+A"(*lock)
-		: "r"(inc), "r"(mask), "I"(TICKET_SHIFT)
+		"	amoadd.w.aqrl	%0, %2, %1\n"
+		: "=&r"(l0), "+A"(*lock)
+		: "r"(inc)
 		: "memory");
+
+	/* If we did not get the lock then wait for our turn. */
+	ticket = (l0 >> TICKET_SHIFT) & 0xffffu;
+	contended = ((l0 & 0xffffu) != ticket) ? TRUE : FALSE;
+	if (contended)
+		stats_start = sbi_lock_stats_start();
+	while ((l0 & 0xffffu) != ticket) {
+		spin_wait_u32(word, l0, &backoff);
+		l0 = *word;
+		RISCV_FENCE(r, rw);
+	}
+	sbi_lock_stats_account(lock, NULL, contended, stats_start);
 }
 
 void spin_unlock(spinlock_t *lock)
 {
 	__smp_store_release(&lock->owner, lock->owner + 1);
 }
+
+struct qspin_node {
+	/* Node of the HART queued next */
+	volatile unsigned long next;
+	/* Cleared by the previous holder when handing over the lock */
+	volatile unsigned long wait;
+};
+
+struct qspin_hart {
+	struct qspin_node node[QSPIN_NODES_MAX];
+	/* Bitmap of nodes in use (only changed by the owner HART) */
+	unsigned long used;
+};
+
+static unsigned long qspin_hart_off;
+
+static struct qspin_node *qspin_node_get(void)
+{
+	u32 i;
+	struct qspin_hart *qh;
+
+	if (!qspin_hart_off)
+		return NULL;
+
+	qh = sbi_scratch_thishart_offset_ptr(qspin_hart_off);
+	for (i = 0; i < QSPIN_NODES_MAX; i++) {
+		if (!(qh->used & (1UL << i))) {
+			qh->used |= 1UL << i;
+			return &qh->node[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void qspin_node_put(struct qspin_node *node)
+{
+	struct qspin_hart *qh = sbi_scratch_thishart_offset_ptr(qspin_hart_off);
+
+	qh->used &= ~(1UL << (node - qh->node));
+}
+
+/* Without a node the lock can only be taken when nobody is queued */
+static int qspin_trylock_nodeless(qspinlock_t *lock)
+{
+	if (lock->tail ||
+	    atomic_raw_cmpxchg_ulong(&lock->tail, 0, QSPIN_NODELESS))
+		return 0;
+
+	lock->holder = QSPIN_NODELESS;
+	return 1;
+}
+
+int qspin_lock_check(qspinlock_t *lock)
+{
+	RISCV_FENCE(r, rw);
+	return (lock->tail) ? 1 : 0;
+}
+
+int qspin_trylock(qspinlock_t *lock)
+{
+	struct qspin_node *node;
+
+	if (lock->tail)
+		return 0;
+
+	node = qspin_node_get();
+	if (!node)
+		return qspin_trylock_nodeless(lock);
+
+	node->next = 0;
+	node->wait = 0;
+	if (atomic_raw_cmpxchg_ulong(&lock->tail, 0, (unsigned long)node)) {
+		qspin_node_put(node);
+		return 0;
+	}
+
+	lock->holder = (unsigned long)node;
+	return 1;
+}
+
+void qspin_lock(qspinlock_t *lock)
+{
+	unsigned long prev, backoff = 0, stats_start = 0;
+	struct qspin_node *node = qspin_node_get();
+
+	if (!node) {
+		if (qspin_trylock_nodeless(lock)) {
+			sbi_lock_stats_account(lock, NULL, FALSE, 0);
+			return;
+		}
+		stats_start = sbi_lock_stats_start();
+		while (!qspin_trylock_nodeless(lock)) {
+			prev = lock->tail;
+			if (prev)
+				spin_wait_ulong(&lock->tail, prev, &backoff);
+		}
+		sbi_lock_stats_account(lock, NULL, TRUE, stats_start);
+		return;
+	}
+
+	node->next = 0;
+	node->wait = 1;
+	prev = atomic_raw_xchg_ulong(&lock->tail, (unsigned long)node);
+	if (prev) {
+		stats_start = sbi_lock_stats_start();
+		/* Link behind the previous tail and spin on our own node */
+		if (prev == QSPIN_NODELESS)
+			lock->nodeless_next = (unsigned long)node;
+		else
+			((struct qspin_node *)prev)->next = (unsigned long)node;
+		while (node->wait)
+			spin_wait_ulong(&node->wait, 1, &backoff);
+		RISCV_FENCE(r, rw);
+	}
+
+	lock->holder = (unsigned long)node;
+	sbi_lock_stats_account(lock, NULL, (prev) ? TRUE : FALSE, stats_start);
+}
+
+void qspin_unlock(qspinlock_t *lock)
+{
+	unsigned long backoff = 0, holder = lock->holder;
+	struct qspin_node *next, *node = (struct qspin_node *)holder;
+
+	if (holder == QSPIN_NODELESS) {
+		if (atomic_raw_cmpxchg_ulong(&lock->tail, QSPIN_NODELESS, 0) ==
+		    QSPIN_NODELESS)
+			return;
+		/* A waiter swapped the tail but may not have linked yet */
+		while (!lock->nodeless_next)
+			spin_wait_ulong(&lock->nodeless_next, 0, &backoff);
+		next = (struct qspin_node *)lock->nodeless_next;
+		lock->nodeless_next = 0;
+	} else {
+		if (!node->next &&
+		    atomic_raw_cmpxchg_ulong(&lock->tail, holder, 0) == holder) {
+			qspin_node_put(node);
+			return;
+		}
+		while (!node->next)
+			spin_wait_ulong(&node->next, 0, &backoff);
+		next = (struct qspin_node *)node->next;
+		qspin_node_put(node);
+	}
+
+	__smp_store_release(&next->wait, 0);
+}
+
+int qspin_lock_init(void)
+{
+	/* Nodes are written by the HARTs queued behind their owner */
+	if (!qspin_hart_off)
+		qspin_hart_off = sbi_scratch_alloc_remote_offset(
+					sizeof(struct qspin_hart),
+					"QSPIN_NODES");
+
+	return (qspin_hart_off) ? 0 : SBI_ENOMEM;
+}
+
+unsigned long read_seqbegin(seqlock_t *lock)
+{
+	unsigned long seq, backoff = 0;
+
+	while ((seq = lock->seq) & 1UL)
+		spin_wait_ulong(&lock->seq, seq, &backoff);
+	RISCV_FENCE(r, r);
+
+	return seq;
+}
+
+bool read_seqretry(seqlock_t *lock, unsigned long seq)
+{
+	RISCV_FENCE(r, r);
+	return (lock->seq != seq) ? TRUE : FALSE;
+}
+
+void write_seqlock(seqlock_t *lock)
+{
+	spin_lock(&lock->lock);
+	lock->seq++;
+	RISCV_FENCE(w, w);
+}
+
+void write_sequnlock(seqlock_t *lock)
+{
+	RISCV_FENCE(w, w);
+	lock->seq++;
+	spin_unlock(&lock->lock);
+}
+
+int read_trylock(rwlock_t *lock)
+{
+	unsigned long cnt = lock->cnt;
+
+	if (cnt & RWLOCK_WRITER)
+		return 0;
+
+	return (atomic_raw_cmpxchg_ulong(&lock->cnt, cnt, cnt + 1) == cnt) ?
+		1 : 0;
+}
+
+void read_lock(rwlock_t *lock)
+{
+	unsigned long cnt, backoff = 0;
+
+	while (!read_trylock(lock)) {
+		cnt = lock->cnt;
+		if (cnt & RWLOCK_WRITER)
+			spin_wait_ulong(&lock->cnt, cnt, &backoff);
+	}
+}
+
+void read_unlock(rwlock_t *lock)
+{
+	unsigned long cnt;
+
+	do {
+		cnt = lock->cnt;
+	} while (atomic_raw_cmpxchg_ulong(&lock->cnt, cnt, cnt - 1) != cnt);
+}
+
+int write_trylock(rwlock_t *lock)
+{
+	if (lock->cnt)
+		return 0;
+
+	return (!atomic_raw_cmpxchg_ulong(&lock->cnt, 0, RWLOCK_WRITER)) ?
+		1 : 0;
+}
+
+void write_lock(rwlock_t *lock)
+{
+	unsigned long cnt, backoff = 0;
+
+	while (!write_trylock(lock)) {
+		cnt = lock->cnt;
+		if (cnt)
+			spin_wait_ulong(&lock->cnt, cnt, &backoff);
+	}
+}
+
+void write_unlock(rwlock_t *lock)
+{
+	__smp_store_release(&lock->cnt, 0);
+}
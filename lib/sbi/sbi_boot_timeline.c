@@ -0,0 +1,134 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_encoding.h>
+#include <sbi/sbi_boot_timeline.h>
+#include <sbi/sbi_ecall.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hartmask.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
+#include <sbi/sbi_timer.h>
+#include <sbi/sbi_trap.h>
+
+struct sbi_boot_timeline {
+	u64 cycle[SBI_BOOT_PHASE_MAX];
+	u64 time[SBI_BOOT_PHASE_MAX];
+};
+
+static unsigned long boot_timeline_off;
+
+static u64 boot_timeline_cycle(void)
+{
+#if __riscv_xlen == 32
+	u32 lo, hi, tmp;
+
+	do {
+		hi  = csr_read(CSR_MCYCLEH);
+		lo  = csr_read(CSR_MCYCLE);
+		tmp = csr_read(CSR_MCYCLEH);
+	} while (hi != tmp);
+
+	return ((u64)hi << 32) | lo;
+#else
+	return csr_read(CSR_MCYCLE);
+#endif
+}
+
+void sbi_boot_timeline_record(struct sbi_scratch *scratch, u32 phase)
+{
+	struct sbi_boot_timeline *bt;
+
+	if (!boot_timeline_off || SBI_BOOT_PHASE_MAX <= phase)
+		return;
+
+	bt = sbi_scratch_offset_ptr(scratch, boot_timeline_off);
+	bt->cycle[phase] = boot_timeline_cycle();
+	bt->time[phase]  = sbi_timer_value();
+}
+
+int sbi_boot_timeline_get(u32 hartid, u32 phase, u64 *out_cycle,
+			  u64 *out_time)
+{
+	struct sbi_scratch *scratch;
+	const struct sbi_boot_timeline *bt;
+
+	if (!boot_timeline_off || SBI_HARTMASK_MAX_BITS <= hartid ||
+	    SBI_BOOT_PHASE_MAX <= phase)
+		return SBI_EINVAL;
+	scratch = sbi_hartid_to_scratch(hartid);
+	if (!scratch)
+		return SBI_EINVAL;
+
+	bt = sbi_scratch_offset_ptr(scratch, boot_timeline_off);
+	if (out_cycle)
+		*out_cycle = bt->cycle[phase];
+	if (out_time)
+		*out_time = bt->time[phase];
+
+	return 0;
+}
+
+static int sbi_ecall_boot_timeline_handler(unsigned long extid,
+					   unsigned long funcid,
+					   const struct sbi_trap_regs *regs,
+					   unsigned long *out_val,
+					   struct sbi_trap_info *out_trap)
+{
+	int ret;
+	u64 cycle, time;
+
+	switch (funcid) {
+	case SBI_EXT_BOOT_TIMELINE_NUM_PHASES:
+		*out_val = SBI_BOOT_PHASE_MAX;
+		return 0;
+	case SBI_EXT_BOOT_TIMELINE_GET_CYCLE:
+	case SBI_EXT_BOOT_TIMELINE_GET_TIME:
+		break;
+	default:
+		return SBI_ENOTSUPP;
+	};
+
+	/* a2 selects the upper 32 bits on RV32 */
+	if (regs->a2 > ((__riscv_xlen == 32) ? 1 : 0))
+		return SBI_EINVAL;
+
+	ret = sbi_boot_timeline_get(regs->a0, regs->a1, &cycle, &time);
+	if (ret)
+		return ret;
+
+	if (funcid == SBI_EXT_BOOT_TIMELINE_GET_TIME)
+		cycle = time;
+	*out_val = (unsigned long)(cycle >> (regs->a2 * 32));
+
+	return 0;
+}
+
+struct sbi_ecall_extension ecall_boot_timeline = {
+	.extid_start = SBI_EXT_BOOT_TIMELINE,
+	.extid_end = SBI_EXT_BOOT_TIMELINE,
+	.handle = sbi_ecall_boot_timeline_handler,
+};
+
+int sbi_boot_timeline_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	if (cold_boot) {
+		boot_timeline_off = sbi_scratch_alloc_offset(
+					sizeof(struct sbi_boot_timeline),
+					"BOOT_TIMELINE");
+		if (!boot_timeline_off)
+			return SBI_ENOMEM;
+	} else if (!boot_timeline_off) {
+		return SBI_ENOMEM;
+	}
+
+	sbi_memset(sbi_scratch_offset_ptr(scratch, boot_timeline_off), 0,
+		   sizeof(struct sbi_boot_timeline));
+
+	return 0;
+}
@@ -0,0 +1,225 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_atomic.h>
+#include <sbi/riscv_barrier.h>
+#include <sbi/riscv_encoding.h>
+#include <sbi/riscv_locks.h>
+#include <sbi/sbi_cache.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_ecall.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_ipi.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
+#include <sbi/sbi_trap.h>
+
+static const struct sbi_cache_device *cache_dev = NULL;
+static u32 cache_event = SBI_IPI_EVENT_MAX;
+
+/* Request broadcast to other HARTs (only written under cache_lock) */
+static spinlock_t cache_lock = SPIN_LOCK_INITIALIZER;
+static struct sbi_cache_range cache_ranges[SBI_CACHE_RANGE_MAX];
+static u32 cache_range_count;
+static atomic_t cache_pending = ATOMIC_INITIALIZER(0);
+
+static void cache_do_range(const struct sbi_cache_range *range)
+{
+	unsigned long addr, end, bs = cache_dev->block_size;
+
+	if (cache_dev->cache_all_op && cache_dev->all_threshold &&
+	    cache_dev->all_threshold <= range->size) {
+		cache_dev->cache_all_op((range->op == SBI_CACHE_OP_INVAL) ?
+					SBI_CACHE_OP_FLUSH : range->op);
+		return;
+	}
+
+	end = range->addr + range->size;
+	for (addr = range->addr & ~(bs - 1); addr < end; addr += bs)
+		cache_dev->cache_block_op(range->op, addr);
+}
+
+static void cache_do_ranges(const struct sbi_cache_range *ranges, u32 count)
+{
+	u32 i;
+
+	/* Order against memory accesses before and after the request */
+	mb();
+	for (i = 0; i < count; i++)
+		cache_do_range(&ranges[i]);
+	mb();
+}
+
+static int cache_update(struct sbi_scratch *scratch,
+			struct sbi_scratch *remote_scratch,
+			u32 remote_hartid, void *data)
+{
+	/* Current HART has already done the request */
+	if (remote_hartid == current_hartid())
+		return SBI_EALREADY;
+
+	atomic_add_return(&cache_pending, 1);
+
+	return 0;
+}
+
+static void cache_sync(struct sbi_scratch *scratch)
+{
+	long pending;
+	unsigned long backoff = 0;
+
+	while ((pending = atomic_read(&cache_pending)) > 0) {
+		/*
+		 * Remote HARTs may be waiting for us in their own request
+		 * so handle our IPIs meanwhile to avoid deadlock.
+		 */
+		sbi_ipi_process();
+		spin_wait_ulong(
+			(volatile unsigned long *)&cache_pending.counter,
+			pending, &backoff);
+	}
+}
+
+static void cache_process(struct sbi_scratch *scratch)
+{
+	cache_do_ranges(cache_ranges, cache_range_count);
+	atomic_sub_return(&cache_pending, 1);
+}
+
+static struct sbi_ipi_event_ops cache_ops = {
+	.name = "IPI_CACHE",
+	.priority = SBI_IPI_EVENT_PRIO_NORMAL,
+	.update = cache_update,
+	.sync = cache_sync,
+	.process = cache_process,
+};
+
+int sbi_cache_range_op(const struct sbi_cache_range *ranges, u32 count)
+{
+	int rc;
+	u32 i;
+
+	if (!cache_dev)
+		return SBI_ENOTSUPP;
+	if (!count || SBI_CACHE_RANGE_MAX < count)
+		return SBI_EINVAL;
+	for (i = 0; i < count; i++) {
+		if (SBI_CACHE_OP_MAX <= ranges[i].op ||
+		    ranges[i].addr + ranges[i].size < ranges[i].addr)
+			return SBI_EINVAL;
+	}
+
+	if (!cache_dev->local) {
+		cache_do_ranges(ranges, count);
+		return 0;
+	}
+
+	/* Handle requests of other HARTs while waiting for the lock */
+	while (!spin_trylock(&cache_lock))
+		sbi_ipi_process();
+
+	sbi_memcpy(cache_ranges, ranges, count * sizeof(*ranges));
+	cache_range_count = count;
+	cache_do_ranges(cache_ranges, cache_range_count);
+	rc = sbi_ipi_send_many(0, -1UL, cache_event, NULL);
+
+	spin_unlock(&cache_lock);
+
+	return rc;
+}
+
+static int sbi_ecall_cache_probe(unsigned long extid, unsigned long *out_val)
+{
+	*out_val = (cache_dev) ? 1 : 0;
+	return 0;
+}
+
+static int sbi_ecall_cache_handler(unsigned long extid, unsigned long funcid,
+				   const struct sbi_trap_regs *regs,
+				   unsigned long *out_val,
+				   struct sbi_trap_info *out_trap)
+{
+	u32 i, count;
+	unsigned long access;
+	struct sbi_cache_range ranges[SBI_CACHE_RANGE_MAX];
+	const struct sbi_domain *dom = sbi_domain_thishart_ptr();
+
+	switch (funcid) {
+	case SBI_EXT_CACHE_CLEAN_RANGE:
+	case SBI_EXT_CACHE_INVAL_RANGE:
+	case SBI_EXT_CACHE_FLUSH_RANGE:
+		ranges[0].op = funcid;
+		ranges[0].addr = regs->a0;
+		ranges[0].size = regs->a1;
+		count = 1;
+		break;
+	case SBI_EXT_CACHE_RANGE_LIST:
+		count = regs->a1;
+		if (!count || SBI_CACHE_RANGE_MAX < count)
+			return SBI_EINVAL;
+		if (!sbi_domain_check_addr_range(dom, regs->a0,
+						 count * sizeof(*ranges),
+						 PRV_S, SBI_DOMAIN_READ))
+			return SBI_EINVALID_ADDR;
+		sbi_memcpy(ranges, (void *)regs->a0, count * sizeof(*ranges));
+		break;
+	default:
+		return SBI_ENOTSUPP;
+	};
+
+	/* Invalidate discards data so it needs write access as well */
+	for (i = 0; i < count; i++) {
+		if (ranges[i].addr + ranges[i].size < ranges[i].addr)
+			return SBI_EINVAL;
+		access = SBI_DOMAIN_READ;
+		if (ranges[i].op == SBI_CACHE_OP_INVAL)
+			access |= SBI_DOMAIN_WRITE;
+		if (!sbi_domain_check_addr_range(dom, ranges[i].addr,
+						 ranges[i].size, PRV_S, access))
+			return SBI_EINVALID_ADDR;
+	}
+
+	return sbi_cache_range_op(ranges, count);
+}
+
+struct sbi_ecall_extension ecall_cache = {
+	.extid_start = SBI_EXT_CACHE,
+	.extid_end = SBI_EXT_CACHE,
+	.probe = sbi_ecall_cache_probe,
+	.handle = sbi_ecall_cache_handler,
+};
+
+const struct sbi_cache_device *sbi_cache_get_device(void)
+{
+	return cache_dev;
+}
+
+void sbi_cache_set_device(const struct sbi_cache_device *dev)
+{
+	if (!dev || cache_dev || !dev->cache_block_op ||
+	    !dev->block_size || (dev->block_size & (dev->block_size - 1)))
+		return;
+
+	cache_dev = dev;
+}
+
+int sbi_cache_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	int ret;
+
+	if (cold_boot) {
+		ret = sbi_ipi_event_create(&cache_ops);
+		if (ret < 0)
+			return ret;
+		cache_event = ret;
+	} else if (SBI_IPI_EVENT_MAX <= cache_event) {
+		return SBI_ENOSPC;
+	}
+
+	return 0;
+}
@@ -7,13 +7,47 @@
  *   Anup Patel <anup.patel@wdc.com>
  */
 
+#include <sbi/riscv_atomic.h>
+#include <sbi/riscv_barrier.h>
 #include <sbi/riscv_locks.h>
+#include <sbi/sbi_bitops.h>
 #include <sbi/sbi_console.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hartmask.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_scratch.h>
 
+/* Size of the per-HART output ring (power of two) */
+#define CONSOLE_RING_SIZE	256
+/* Size of the output batched for console_puts() without rings */
+#define CONSOLE_TBUF_MAX	64
+/* Size of the on-stack buffer a message is formatted in before output */
+#define CONSOLE_MSG_MAX		128
+
 static const struct sbi_console_device *console_dev = NULL;
-static spinlock_t console_out_lock	       = SPIN_LOCK_INITIALIZER;
+static qspinlock_t console_out_lock	       = QSPIN_LOCK_INITIALIZER;
+
+/*
+ * With the SBI_SCRATCH_CONSOLE_BUFFERED option each HART formats its
+ * output into its own ring and only the HART holding console_out_lock
+ * writes rings to the console device. The owner HART is the only one
+ * advancing wpos and head (a message becomes visible when head is set
+ * to wpos) while tail is only advanced under console_out_lock.
+ */
+struct console_ring {
+	unsigned long head;
+	unsigned long wpos;
+	unsigned long tail;
+	char buf[CONSOLE_RING_SIZE];
+};
+
+static bool console_buffered;
+static unsigned long console_ring_off;
+/* Output batched under console_out_lock when not buffered */
+static char console_tbuf[CONSOLE_TBUF_MAX];
+static u32 console_tbuf_len;
+/* HARTs whose ring has output not written yet */
+static struct sbi_hartmask console_pending;
 
 bool sbi_isprintable(char c)
 {
@@ -31,7 +65,7 @@ int sbi_getc(void)
 	return -1;
 }
 
-void sbi_putc(char ch)
+static void console_dev_putc(char ch)
 {
 	if (console_dev && console_dev->console_putc) {
 		if (ch == '\n')
@@ -40,14 +74,202 @@ void sbi_putc(char ch)
 	}
 }
 
+/*
+ * Write out some characters of a string to the console device
+ *
+ * Returns the number of characters of the string written out, which
+ * is at least one. Newlines are written as CR LF.
+ */
+static unsigned long console_dev_puts_some(const char *str,
+					   unsigned long len)
+{
+	unsigned long n = 0;
+
+	if (str[0] == '\n' || !console_dev->console_puts) {
+		console_dev_putc(str[0]);
+		return 1;
+	}
+
+	while (n < len && str[n] != '\n')
+		n++;
+
+	return console_dev->console_puts(str, n);
+}
+
+static void console_dev_puts(const char *str, unsigned long len)
+{
+	unsigned long n;
+
+	if (!console_dev || !console_dev->console_putc)
+		return;
+
+	while (len) {
+		n = console_dev_puts_some(str, len);
+		str += n;
+		len -= n;
+	}
+}
+
+/* Write out a ring, giving up when the device is busy unless wait */
+static bool console_ring_drain(struct console_ring *ring, bool wait)
+{
+	bool ret = TRUE;
+	unsigned long off, len, tail = ring->tail;
+	unsigned long head = *(volatile unsigned long *)&ring->head;
+
+	/* Read the message only after seeing its head */
+	smp_rmb();
+
+	while (tail != head) {
+		if (!wait && console_dev->console_putc_ready &&
+		    !console_dev->console_putc_ready()) {
+			ret = FALSE;
+			break;
+		}
+		off = tail & (CONSOLE_RING_SIZE - 1);
+		len = head - tail;
+		if (CONSOLE_RING_SIZE - off < len)
+			len = CONSOLE_RING_SIZE - off;
+		tail += console_dev_puts_some(&ring->buf[off], len);
+	}
+
+	/* Release the ring space only after reading it */
+	smp_mb();
+	ring->tail = tail;
+
+	return ret;
+}
+
+static void console_drain(bool wait)
+{
+	u32 w, hartid;
+	struct sbi_scratch *rscratch;
+	volatile unsigned long *bits = sbi_hartmask_bits(&console_pending);
+
+	if (!console_dev || !console_dev->console_putc)
+		return;
+
+	if (wait)
+		qspin_lock(&console_out_lock);
+	else if (!qspin_trylock(&console_out_lock))
+		return;
+
+	for (w = 0; w < BITS_TO_LONGS(SBI_HARTMASK_MAX_BITS); w++) {
+		while (bits[w]) {
+			hartid = w * BITS_PER_LONG + __ffs(bits[w]);
+			atomic_raw_clear_bit(hartid, (unsigned long *)bits);
+			rscratch = sbi_hartid_to_scratch(hartid);
+			if (!rscratch)
+				continue;
+			if (!console_ring_drain(sbi_scratch_offset_ptr(rscratch,
+							console_ring_off),
+						wait)) {
+				atomic_raw_set_bit(hartid,
+						   (unsigned long *)bits);
+				goto done;
+			}
+		}
+	}
+
+done:
+	qspin_unlock(&console_out_lock);
+}
+
+static void console_ring_commit(struct console_ring *ring, u32 hartid)
+{
+	if (ring->head == ring->wpos)
+		return;
+
+	/* Make the message visible before its head */
+	smp_wmb();
+	ring->head = ring->wpos;
+	atomic_raw_set_bit(hartid, sbi_hartmask_bits(&console_pending));
+}
+
+static void console_out(char ch)
+{
+	struct sbi_scratch *scratch;
+	struct console_ring *ring;
+
+	if (!console_buffered) {
+		if (CONSOLE_TBUF_MAX <= console_tbuf_len) {
+			console_dev_puts(console_tbuf, console_tbuf_len);
+			console_tbuf_len = 0;
+		}
+		console_tbuf[console_tbuf_len++] = ch;
+		return;
+	}
+
+	scratch = sbi_scratch_thishart_ptr();
+	ring = sbi_scratch_offset_ptr(scratch, console_ring_off);
+	if (CONSOLE_RING_SIZE <=
+	    ring->wpos - *(volatile unsigned long *)&ring->tail) {
+		/* Ring is full so write it out synchronously */
+		console_ring_commit(ring, scratch->hartid);
+		console_drain(TRUE);
+	}
+	ring->buf[ring->wpos & (CONSOLE_RING_SIZE - 1)] = ch;
+	ring->wpos++;
+}
+
+static void console_out_begin(void)
+{
+	if (!console_buffered)
+		qspin_lock(&console_out_lock);
+}
+
+static void console_out_end(void)
+{
+	struct sbi_scratch *scratch;
+
+	if (!console_buffered) {
+		console_dev_puts(console_tbuf, console_tbuf_len);
+		console_tbuf_len = 0;
+		qspin_unlock(&console_out_lock);
+		return;
+	}
+
+	scratch = sbi_scratch_thishart_ptr();
+	console_ring_commit(sbi_scratch_offset_ptr(scratch, console_ring_off),
+			    scratch->hartid);
+	sbi_console_poll();
+}
+
+void sbi_putc(char ch)
+{
+	console_out_begin();
+	console_out(ch);
+	console_out_end();
+}
+
 void sbi_puts(const char *str)
 {
-	spin_lock(&console_out_lock);
+	console_out_begin();
 	while (*str) {
-		sbi_putc(*str);
+		console_out(*str);
 		str++;
 	}
-	spin_unlock(&console_out_lock);
+	console_out_end();
+}
+
+unsigned long sbi_nputs(const char *str, unsigned long len)
+{
+	unsigned long i;
+
+	if (!console_buffered) {
+		/* Nothing to batch, write the string as it is */
+		qspin_lock(&console_out_lock);
+		console_dev_puts(str, len);
+		qspin_unlock(&console_out_lock);
+		return len;
+	}
+
+	console_out_begin();
+	for (i = 0; i < len; i++)
+		console_out(str[i]);
+	console_out_end();
+
+	return len;
 }
 
 void sbi_gets(char *s, int maxwidth, char endchar)
@@ -63,6 +285,21 @@ void sbi_gets(char *s, int maxwidth, char endchar)
 	*retval = '\0';
 }
 
+unsigned long sbi_ngets(char *str, unsigned long len)
+{
+	int ch;
+	unsigned long i;
+
+	for (i = 0; i < len; i++) {
+		ch = sbi_getc();
+		if (ch < 0)
+			break;
+		str[i] = ch;
+	}
+
+	return i;
+}
+
 #define PAD_RIGHT 1
 #define PAD_ZERO 2
 #define PAD_ALTERNATE 4
@@ -70,6 +307,7 @@ void sbi_gets(char *s, int maxwidth, char endchar)
 
 #define va_start(v, l) __builtin_va_start((v), l)
 #define va_end __builtin_va_end
+#define va_copy __builtin_va_copy
 #define va_arg __builtin_va_arg
 typedef __builtin_va_list va_list;
 
@@ -81,27 +319,23 @@ static void printc(char **out, u32 *out_len, char ch)
 				**out = ch;
 				++(*out);
 				(*out_len)--;
-			} else {
+			} else if (!out_len) {
 				**out = ch;
 				++(*out);
 			}
 		}
 	} else {
-		sbi_putc(ch);
+		console_out(ch);
 	}
 }
 
-static int prints(char **out, u32 *out_len, const char *string, int width,
-		  int flags)
+static int printsn(char **out, u32 *out_len, const char *string, int len,
+		   int width, int flags)
 {
 	int pc	     = 0;
 	char padchar = ' ';
 
 	if (width > 0) {
-		int len = 0;
-		const char *ptr;
-		for (ptr = string; *ptr; ++ptr)
-			++len;
 		if (len >= width)
 			width = 0;
 		else
@@ -115,7 +349,7 @@ static int prints(char **out, u32 *out_len, const char *string, int width,
 			++pc;
 		}
 	}
-	for (; *string; ++string) {
+	for (; len > 0; --len, ++string) {
 		printc(out, out_len, *string);
 		++pc;
 	}
@@ -127,33 +361,79 @@ static int prints(char **out, u32 *out_len, const char *string, int width,
 	return pc;
 }
 
+static int prints(char **out, u32 *out_len, const char *string, int width,
+		  int flags)
+{
+	int len = 0;
+	const char *ptr;
+
+	for (ptr = string; *ptr; ++ptr)
+		++len;
+
+	return printsn(out, out_len, string, len, width, flags);
+}
+
+static const char print_digits_lower[] = "0123456789abcdef";
+static const char print_digits_upper[] = "0123456789ABCDEF";
+
+/*
+ * Divide by 10 with shifts and adds only, which avoids a libgcc
+ * division call for each digit of 64-bit values on RV32.
+ */
+static u32 print_divu10(u64 *u)
+{
+	u64 q, n = *u;
+	u32 r;
+
+	q = (n >> 1) + (n >> 2);
+	q += q >> 4;
+	q += q >> 8;
+	q += q >> 16;
+	q += q >> 32;
+	q >>= 3;
+	r = n - ((q << 3) + (q << 1));
+	if (r > 9) {
+		q++;
+		r -= 10;
+	}
+
+	*u = q;
+	return r;
+}
+
 static int printi(char **out, u32 *out_len, long long i, int b, int sg,
 		  int width, int flags, int letbase)
 {
 	char print_buf[PRINT_BUF_LEN];
-	char *s;
+	char *s, *end;
 	int neg = 0, pc = 0;
-	u64 t;
-	unsigned long long u = i;
+	unsigned long w;
+	u64 u = i;
+	const char *digits = (letbase == 'A') ? print_digits_upper :
+						print_digits_lower;
 
 	if (sg && b == 10 && i < 0) {
 		neg = 1;
 		u   = -i;
 	}
 
-	s  = print_buf + PRINT_BUF_LEN - 1;
-	*s = '\0';
+	end = s = print_buf + PRINT_BUF_LEN;
 
-	if (!u) {
-		*--s = '0';
+	if (b == 16) {
+		do {
+			*--s = digits[u & 0xf];
+			u >>= 4;
+		} while (u);
 	} else {
-		while (u) {
-			t = u % b;
-			u = u / b;
-			if (t >= 10)
-				t += letbase - '0' - 10;
-			*--s = t + '0';
-		}
+		/* Only the digits above ULONG_MAX need 64-bit division */
+		while (u > -1UL)
+			*--s = '0' + print_divu10(&u);
+		/* Division by a constant becomes a multiplication */
+		w = u;
+		do {
+			*--s = '0' + (w % 10);
+			w /= 10;
+		} while (w);
 	}
 
 	if (flags & PAD_ALTERNATE) {
@@ -175,7 +455,7 @@ static int printi(char **out, u32 *out_len, long long i, int b, int sg,
 		}
 	}
 
-	return pc + prints(out, out_len, s, width, flags);
+	return pc + printsn(out, out_len, s, end - s, width, flags);
 }
 
 static int print(char **out, u32 *out_len, const char *format, va_list args)
@@ -290,6 +570,9 @@ static int print(char **out, u32 *out_len, const char *format, va_list args)
 						     width, flags, 'A');
 				} else {
 					format += 1;
+					if (*(format + 1) == 'd' ||
+					    *(format + 1) == 'i')
+						format += 1;
 					pc += printi(out, out_len, tmp, 10, 1,
 						     width, flags, '0');
 				}
@@ -301,6 +584,7 @@ static int print(char **out, u32 *out_len, const char *format, va_list args)
 						out, out_len,
 						va_arg(args, unsigned long), 10,
 						0, width, flags, 'a');
+					acnt += sizeof(unsigned long);
 				} else if (*(format + 1) == 'x') {
 					format += 1;
 					pc += printi(
@@ -316,6 +600,9 @@ static int print(char **out, u32 *out_len, const char *format, va_list args)
 						0, width, flags, 'A');
 					acnt += sizeof(unsigned long);
 				} else {
+					if (*(format + 1) == 'd' ||
+					    *(format + 1) == 'i')
+						format += 1;
 					pc += printi(out, out_len,
 						     va_arg(args, long), 10, 1,
 						     width, flags, '0');
@@ -366,16 +653,43 @@ int sbi_snprintf(char *out, u32 out_sz, const char *format, ...)
 	return retval;
 }
 
+/*
+ * Format the message before touching the console so that it is
+ * submitted in one short critical section (or without any lock when
+ * buffered) instead of holding console_out_lock while formatting.
+ */
+static int console_vprintf(const char *format, va_list args)
+{
+	va_list fargs;
+	int retval;
+	char msg[CONSOLE_MSG_MAX], *out = msg;
+	u32 out_sz = CONSOLE_MSG_MAX - 1;
+
+	va_copy(fargs, args);
+	retval = print(&out, &out_sz, format, fargs);
+	va_end(fargs);
+
+	if (retval < CONSOLE_MSG_MAX) {
+		sbi_nputs(msg, retval);
+		return retval;
+	}
+
+	/* Too long for the buffer so format it again to the console */
+	console_out_begin();
+	retval = print(NULL, NULL, format, args);
+	console_out_end();
+
+	return retval;
+}
+
 int sbi_printf(const char *format, ...)
 {
 	va_list args;
 	int retval;
 
-	spin_lock(&console_out_lock);
 	va_start(args, format);
-	retval = print(NULL, NULL, format, args);
+	retval = console_vprintf(format, args);
 	va_end(args);
-	spin_unlock(&console_out_lock);
 
 	return retval;
 }
@@ -388,7 +702,7 @@ int sbi_dprintf(const char *format, ...)
 
 	va_start(args, format);
 	if (scratch->options & SBI_SCRATCH_DEBUG_PRINTS)
-		retval = print(NULL, NULL, format, args);
+		retval = console_vprintf(format, args);
 	va_end(args);
 
 	return retval;
@@ -407,7 +721,44 @@ void sbi_console_set_device(const struct sbi_console_device *dev)
 	console_dev = dev;
 }
 
+void sbi_console_poll(void)
+{
+	u32 w;
+	unsigned long pending = 0;
+
+	if (!console_buffered)
+		return;
+
+	for (w = 0; w < BITS_TO_LONGS(SBI_HARTMASK_MAX_BITS); w++)
+		pending |= ((volatile unsigned long *)
+			    sbi_hartmask_bits(&console_pending))[w];
+	if (pending)
+		console_drain(FALSE);
+}
+
+void sbi_console_flush(void)
+{
+	if (console_buffered)
+		console_drain(TRUE);
+}
+
 int sbi_console_init(struct sbi_scratch *scratch)
 {
-	return sbi_platform_console_init(sbi_platform_ptr(scratch));
+	int rc;
+
+	rc = sbi_platform_console_init(sbi_platform_ptr(scratch));
+	if (rc)
+		return rc;
+
+	if (scratch->options & SBI_SCRATCH_CONSOLE_BUFFERED) {
+		/* The ring tail is advanced by whichever HART drains it */
+		console_ring_off = sbi_scratch_alloc_remote_offset(
+					sizeof(struct console_ring),
+					"CONSOLE_RING");
+		if (!console_ring_off)
+			return SBI_ENOMEM;
+		console_buffered = TRUE;
+	}
+
+	return 0;
 }
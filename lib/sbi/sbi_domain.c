@@ -10,6 +10,7 @@
 #include <sbi/riscv_asm.h>
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_domain.h>
+#include <sbi/sbi_hart.h>
 #include <sbi/sbi_hartmask.h>
 #include <sbi/sbi_hsm.h>
 #include <sbi/sbi_math.h>
@@ -29,11 +30,33 @@ static u32 root_memregs_count = 0;
 static struct sbi_domain_memregion root_fw_region;
 static struct sbi_domain_memregion root_memregs[ROOT_REGION_MAX + 1] = { 0 };
 
+/*
+ * Memory region lookup index built by sbi_domain_finalize()
+ *
+ * The address space of each domain is split at the boundaries of its
+ * memory regions into sorted intervals which record the first matching
+ * region for S/U-mode and for M-mode accesses, so that a lookup is a
+ * binary search instead of a walk over all regions.
+ */
+#define DOMAIN_LOOKUP_MAX	256
+struct domain_lookup_entry {
+	unsigned long start;
+	/* Index of matching region for S/U-mode and M-mode (or -1) */
+	s16 reg[2];
+};
+static struct domain_lookup_entry domain_lookup_entries[DOMAIN_LOOKUP_MAX];
+static u32 domain_lookup_used = 0;
+static struct {
+	u32 first;
+	u32 count;
+} domain_lookup[SBI_DOMAIN_MAX_INDEX] = { 0 };
+
 struct sbi_domain root = {
 	.name = "root",
 	.possible_harts = &root_hmask,
 	.regions = root_memregs,
 	.system_reset_allowed = TRUE,
+	.system_suspend_allowed = TRUE,
 };
 
 bool sbi_domain_is_assigned_hart(const struct sbi_domain *dom, u32 hartid)
@@ -64,6 +87,19 @@ ulong sbi_domain_get_assigned_hartmask(const struct sbi_domain *dom,
 	return ret;
 }
 
+void sbi_update_hartid_to_domain(u32 hartid, struct sbi_domain *dom)
+{
+	struct sbi_scratch *scratch;
+
+	if (SBI_HARTMASK_MAX_BITS <= hartid)
+		return;
+
+	hartid_to_domain_table[hartid] = dom;
+	scratch = sbi_hartid_to_scratch(hartid);
+	if (scratch)
+		scratch->domain_addr = (unsigned long)dom;
+}
+
 static void domain_memregion_initfw(struct sbi_domain_memregion *reg)
 {
 	if (!reg)
@@ -101,13 +137,54 @@ void sbi_domain_memregion_init(unsigned long addr,
 	}
 }
 
+const struct sbi_domain_memregion *sbi_domain_find_memregion(
+					const struct sbi_domain *dom,
+					unsigned long addr, unsigned long mode)
+{
+	int r;
+	u32 lo, hi, mid;
+	struct sbi_domain_memregion *reg;
+	unsigned long rstart, rend;
+
+	if (dom->index < SBI_DOMAIN_MAX_INDEX &&
+	    domain_lookup[dom->index].count &&
+	    sbi_index_to_domain(dom->index) == dom) {
+		/* Find the last interval starting at or below addr */
+		lo = domain_lookup[dom->index].first;
+		hi = lo + domain_lookup[dom->index].count - 1;
+		while (lo < hi) {
+			mid = hi - (hi - lo) / 2;
+			if (domain_lookup_entries[mid].start <= addr)
+				lo = mid;
+			else
+				hi = mid - 1;
+		}
+		r = domain_lookup_entries[lo].reg[(mode == PRV_M) ? 1 : 0];
+
+		return (r < 0) ? NULL : &dom->regions[r];
+	}
+
+	sbi_domain_for_each_memregion(dom, reg) {
+		if (mode == PRV_M && !(reg->flags & SBI_DOMAIN_MEMREGION_MMODE))
+			continue;
+
+		rstart = reg->base;
+		rend = (reg->order < __riscv_xlen) ?
+			rstart + ((1UL << reg->order) - 1) : -1UL;
+		if (rstart <= addr && addr <= rend)
+			return reg;
+	}
+
+	return NULL;
+}
+
 bool sbi_domain_check_addr(const struct sbi_domain *dom,
 			   unsigned long addr, unsigned long mode,
 			   unsigned long access_flags)
 {
 	bool mmio = FALSE;
-	struct sbi_domain_memregion *reg;
-	unsigned long rstart, rend, rflags, rwx = 0;
+	const struct sbi_domain_memregion *reg;
+	unsigned long rflags, rwx = 0;
 
 	if (!dom)
 		return FALSE;
@@ -121,23 +198,58 @@ bool sbi_domain_check_addr(const struct sbi_domain *dom,
 	if (access_flags & SBI_DOMAIN_MMIO)
 		mmio = TRUE;
 
+	reg = sbi_domain_find_memregion(dom, addr, mode);
+	if (!reg)
+		return (mode == PRV_M) ? TRUE : FALSE;
+
+	rflags = reg->flags;
+	if ((mmio && !(rflags & SBI_DOMAIN_MEMREGION_MMIO)) ||
+	    (!mmio && (rflags & SBI_DOMAIN_MEMREGION_MMIO)))
+		return FALSE;
+
+	return ((rflags & rwx) == rwx) ? TRUE : FALSE;
+}
+
+/* Lowest region start or end above addr, zero if there is none */
+static unsigned long domain_next_boundary(const struct sbi_domain *dom,
+					  unsigned long addr)
+{
+	unsigned long b, next = 0;
+	struct sbi_domain_memregion *reg;
+
 	sbi_domain_for_each_memregion(dom, reg) {
-		rflags = reg->flags;
-		if (mode == PRV_M && !(rflags & SBI_DOMAIN_MEMREGION_MMODE))
+		b = reg->base;
+		if (addr < b && (!next || b < next))
+			next = b;
+		if (__riscv_xlen <= reg->order)
 			continue;
-
-		rstart = reg->base;
-		rend = (reg->order < __riscv_xlen) ?
-			rstart + ((1UL << reg->order) - 1) : -1UL;
-		if (rstart <= addr && addr <= rend) {
-			if ((mmio && !(rflags & SBI_DOMAIN_MEMREGION_MMIO)) ||
-			    (!mmio && (rflags & SBI_DOMAIN_MEMREGION_MMIO)))
-				return FALSE;
-			return ((rflags & rwx) == rwx) ? TRUE : FALSE;
-		}
+		b = reg->base + BIT(reg->order);
+		if (addr < b && (!next || b < next))
+			next = b;
 	}
 
-	return (mode == PRV_M) ? TRUE : FALSE;
+	return next;
+}
+
+bool sbi_domain_check_addr_range(const struct sbi_domain *dom,
+				 unsigned long addr, unsigned long size,
+				 unsigned long mode,
+				 unsigned long access_flags)
+{
+	unsigned long next, last = addr + size - 1;
+
+	if (!dom || last < addr)
+		return (dom && !size) ? TRUE : FALSE;
+
+	/* Access rights only change at region boundaries */
+	while (1) {
+		if (!sbi_domain_check_addr(dom, addr, mode, access_flags))
+			return FALSE;
+		next = domain_next_boundary(dom, addr);
+		if (!next || last < next)
+			return TRUE;
+		addr = next;
+	}
 }
 
 /* Check if region complies with constraints */
@@ -303,7 +415,7 @@ static int sanitize_domain(const struct sbi_platform *plat,
 	return 0;
 }
 
-void sbi_domain_dump(const struct sbi_domain *dom, const char *suffix)
+void __init sbi_domain_dump(const struct sbi_domain *dom, const char *suffix)
 {
 	u32 i, k;
 	unsigned long rstart, rend;
@@ -383,9 +495,25 @@ void sbi_domain_dump(const struct sbi_domain *dom, const char *suffix)
 
 	sbi_printf("Domain%d SysReset    %s: %s\n",
 		   dom->index, suffix, (dom->system_reset_allowed) ? "yes" : "no");
+
+	sbi_printf("Domain%d SysSuspend  %s: %s\n",
+		   dom->index, suffix, (dom->system_suspend_allowed) ? "yes" : "no");
+
+	sbi_printf("Domain%d CtxEntry    %s: %s\n",
+		   dom->index, suffix, (dom->context_entry_allowed) ? "yes" : "no");
+
+	sbi_printf("Domain%d PmpSwap     %s: %s\n",
+		   dom->index, suffix, (dom->pmp_swap) ? "yes" : "no");
+
+	sbi_printf("Domain%d IpiRate     %s: ", dom->index, suffix);
+	if (dom->ipi_rate_interval)
+		sbi_printf("1 per %lu ticks (burst %u)\n",
+			   (ulong)dom->ipi_rate_interval, dom->ipi_rate_burst);
+	else
+		sbi_printf("unlimited\n");
 }
 
-void sbi_domain_dump_all(const char *suffix)
+void __init sbi_domain_dump_all(const char *suffix)
 {
 	u32 i;
 	const struct sbi_domain *dom;
@@ -450,7 +578,7 @@ int sbi_domain_register(struct sbi_domain *dom,
 		if (tdom)
 			sbi_hartmask_clear_hart(i,
 					&tdom->assigned_harts);
-		hartid_to_domain_table[i] = dom;
+		sbi_update_hartid_to_domain(i, dom);
 		sbi_hartmask_set_hart(i, &dom->assigned_harts);
 
 		/*
@@ -468,7 +596,7 @@ int sbi_domain_register(struct sbi_domain *dom,
 	return 0;
 }
 
-int sbi_domain_root_add_memregion(const struct sbi_domain_memregion *reg)
+static int root_add_memregion(const struct sbi_domain_memregion *reg)
 {
 	int rc;
 	bool reg_merged;
@@ -476,8 +604,7 @@ int sbi_domain_root_add_memregion(const struct sbi_domain_memregion *reg)
 	const struct sbi_platform *plat = sbi_platform_thishart_ptr();
 
 	/* Sanity checks */
-	if (!reg || domain_finalized ||
-	    (root.regions != root_memregs) ||
+	if (!reg || (root.regions != root_memregs) ||
 	    (ROOT_REGION_MAX <= root_memregs_count))
 		return SBI_EINVAL;
 
@@ -529,6 +656,142 @@ int sbi_domain_root_add_memregion(const struct sbi_domain_memregion *reg)
 	return 0;
 }
 
+int sbi_domain_root_add_memregion(const struct sbi_domain_memregion *reg)
+{
+	if (domain_finalized)
+		return SBI_EINVAL;
+
+	return root_add_memregion(reg);
+}
+
+static void domain_lookup_add(u32 first, u32 *count, unsigned long start)
+{
+	u32 i;
+	struct domain_lookup_entry *ent = &domain_lookup_entries[first];
+
+	/* Insert start into the sorted interval starts unless present */
+	for (i = *count; i && start < ent[i - 1].start; i--)
+		ent[i] = ent[i - 1];
+	if (i && ent[i - 1].start == start) {
+		for (; i < *count; i++)
+			ent[i] = ent[i + 1];
+		return;
+	}
+	ent[i].start = start;
+	(*count)++;
+}
+
+static void domain_lookup_build(struct sbi_domain *dom)
+{
+	u32 i, j, nreg = 0, count = 0, first = domain_lookup_used;
+	struct domain_lookup_entry *ent;
+	struct sbi_domain_memregion *reg;
+	unsigned long end;
+
+	sbi_domain_for_each_memregion(dom, reg)
+		nreg++;
+
+	/* Fall back to walking the regions if the index does not fit */
+	if (SBI_DOMAIN_MAX_INDEX <= dom->index || 0x7fff < nreg ||
+	    DOMAIN_LOOKUP_MAX - first < 2 * nreg + 1)
+		return;
+
+	domain_lookup_add(first, &count, 0);
+	sbi_domain_for_each_memregion(dom, reg) {
+		domain_lookup_add(first, &count, reg->base);
+		if (reg->order < __riscv_xlen) {
+			end = reg->base + (1UL << reg->order);
+			if (end)
+				domain_lookup_add(first, &count, end);
+		}
+	}
+
+	/* Regions are nested or disjoint so an interval is all inside */
+	for (i = 0; i < count; i++) {
+		ent = &domain_lookup_entries[first + i];
+		ent->reg[0] = ent->reg[1] = -1;
+		for (j = nreg; j > 0; j--) {
+			reg = &dom->regions[j - 1];
+			end = (reg->order < __riscv_xlen) ?
+				reg->base + ((1UL << reg->order) - 1) : -1UL;
+			if (ent->start < reg->base || end < ent->start)
+				continue;
+			ent->reg[0] = j - 1;
+			if (reg->flags & SBI_DOMAIN_MEMREGION_MMODE)
+				ent->reg[1] = j - 1;
+		}
+	}
+
+	domain_lookup[dom->index].first = first;
+	domain_lookup[dom->index].count = count;
+	domain_lookup_used += count;
+}
+
+/*
+ * The largest naturally aligned block of the cold boot only part of the
+ * firmware goes to the root domain. The rest of it stays part of the
+ * firmware region so that a single PMP entry is enough. S-mode of the root
+ * domain must not run before the cold boot HART is done with the __init
+ * code so nothing is reclaimed when the root domain boots on another HART.
+ */
+int sbi_domain_fw_init_region(struct sbi_scratch *scratch,
+			      struct sbi_domain_memregion *reg)
+{
+	unsigned long order, base, start, end;
+
+	if (!scratch->fw_init_size || root.boot_hartid != scratch->hartid ||
+	    sbi_hartid_to_domain(scratch->hartid) != &root)
+		return SBI_ENOENT;
+
+	start = scratch->fw_start + scratch->fw_init_offset;
+	end = start + scratch->fw_init_size;
+	for (order = log2roundup(scratch->fw_init_size);
+	     PAGE_SHIFT <= order; order--) {
+		base = (start + BIT(order) - 1) & ~(BIT(order) - 1);
+		if (base + BIT(order) <= end)
+			break;
+	}
+	if (order < PAGE_SHIFT)
+		return SBI_ENOENT;
+
+	sbi_domain_memregion_init(base, BIT(order),
+				  (SBI_DOMAIN_MEMREGION_READABLE |
+				   SBI_DOMAIN_MEMREGION_WRITEABLE |
+				   SBI_DOMAIN_MEMREGION_EXECUTABLE), reg);
+
+	return 0;
+}
+
+void sbi_domain_fw_init_reclaim(struct sbi_scratch *scratch)
+{
+	int rc;
+	struct sbi_domain_memregion reg;
+
+	if (sbi_domain_fw_init_region(scratch, &reg))
+		return;
+
+	/* Failing to reclaim cold boot only memory is not fatal */
+	rc = root_add_memregion(&reg);
+	if (rc) {
+		sbi_printf("%s: failed to reclaim init memory (error %d)\n",
+			   __func__, rc);
+		return;
+	}
+
+	/*
+	 * Only this HART runs in the root domain at this point. The old
+	 * lookup entries stay unused and the regions are walked if the
+	 * new ones do not fit.
+	 */
+	domain_lookup[root.index].count = 0;
+	domain_lookup_build(&root);
+	sbi_hart_pmp_image_build(scratch, &root);
+	rc = sbi_hart_pmp_configure(scratch);
+	if (rc)
+		sbi_printf("%s: PMP configure failed (error %d)\n",
+			   __func__, rc);
+}
+
 int sbi_domain_finalize(struct sbi_scratch *scratch, u32 cold_hartid)
 {
 	int rc;
@@ -544,6 +807,16 @@ int sbi_domain_finalize(struct sbi_scratch *scratch, u32 cold_hartid)
 		return rc;
 	}
 
+	/*
+	 * Index the memory regions of domains which can't change anymore
+	 * and precompute their PMP images. A domain without PMP image is
+	 * programmed directly by sbi_hart_pmp_configure().
+	 */
+	sbi_domain_for_each(i, dom) {
+		domain_lookup_build(dom);
+		sbi_hart_pmp_image_build(scratch, dom);
+	}
+
 	/* Startup boot HART of domains */
 	sbi_domain_for_each(i, dom) {
 		/* Domain boot HART */
@@ -593,6 +866,9 @@ int sbi_domain_finalize(struct sbi_scratch *scratch, u32 cold_hartid)
 int sbi_domain_init(struct sbi_scratch *scratch, u32 cold_hartid)
 {
 	u32 i;
+	int rc;
+	unsigned long stack_end;
+	struct sbi_domain_memregion reg;
 	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
 
 	/* Root domain firmware memory region */
@@ -619,10 +895,24 @@ int sbi_domain_init(struct sbi_scratch *scratch, u32 cold_hartid)
 	root.next_mode = scratch->next_mode;
 
 	/* Root domain possible and assigned HARTs */
-	for (i = 0; i < SBI_HARTMASK_MAX_BITS; i++) {
-		if (sbi_platform_hart_invalid(plat, i))
+	for (i = 0; i < sbi_platform_hart_count(plat); i++)
+		sbi_hartmask_set_hart(sbi_platform_hart_index2id(plat, i),
+				      &root_hmask);
+
+	/*
+	 * HART stacks placed outside the firmware region by the platform
+	 * are protected like the firmware region. Adjacent stacks merge
+	 * into one region so a block of stacks costs one PMP entry.
+	 */
+	for (i = 0; i < sbi_platform_hart_count(plat); i++) {
+		stack_end = sbi_platform_hart_stack_end(plat, i);
+		if (!stack_end)
 			continue;
-		sbi_hartmask_set_hart(i, &root_hmask);
+		sbi_domain_memregion_init(stack_end - plat->hart_stack_size,
+					  plat->hart_stack_size, 0, &reg);
+		rc = sbi_domain_root_add_memregion(&reg);
+		if (rc)
+			return rc;
 	}
 
 	return sbi_domain_register(&root, &root_hmask);
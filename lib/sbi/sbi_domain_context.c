@@ -0,0 +1,254 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_encoding.h>
+#include <sbi/sbi_console.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_domain_context.h>
+#include <sbi/sbi_ecall.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
+#include <sbi/sbi_timer.h>
+#include <sbi/sbi_trap.h>
+
+/*
+ * Saved state of a domain on a HART. The S-mode bits of MSTATUS are
+ * part of the trap registers. Floating point and vector registers are
+ * not switched so the entered domain must preserve them.
+ */
+struct sbi_domain_context {
+	struct sbi_domain *dom;
+	struct sbi_trap_regs regs;
+	unsigned long sie;
+	unsigned long stvec;
+	unsigned long sscratch;
+	unsigned long sepc;
+	unsigned long scause;
+	unsigned long stval;
+	unsigned long sip;
+	unsigned long satp;
+	unsigned long scounteren;
+};
+
+/* Contexts of the assigned domain and of the entered domain */
+struct sbi_domain_context_hart {
+	struct sbi_domain_context assigned;
+	struct sbi_domain_context entered;
+};
+
+static unsigned long domain_context_off;
+
+static void domain_context_save(struct sbi_domain_context *ctx,
+				struct sbi_domain *dom,
+				const struct sbi_trap_regs *regs)
+{
+	ctx->dom = dom;
+	sbi_memcpy(&ctx->regs, regs, sizeof(*regs));
+	ctx->sie	= csr_read(CSR_SIE);
+	ctx->stvec	= csr_read(CSR_STVEC);
+	ctx->sscratch	= csr_read(CSR_SSCRATCH);
+	ctx->sepc	= csr_read(CSR_SEPC);
+	ctx->scause	= csr_read(CSR_SCAUSE);
+	ctx->stval	= csr_read(CSR_STVAL);
+	ctx->sip	= csr_read(CSR_SIP) & MIP_SSIP;
+	ctx->satp	= csr_read(CSR_SATP);
+	if (sbi_hart_has_feature(sbi_scratch_thishart_ptr(),
+				 SBI_HART_HAS_SCOUNTEREN))
+		ctx->scounteren = csr_read(CSR_SCOUNTEREN);
+}
+
+static void domain_context_restore(const struct sbi_domain_context *ctx,
+				   struct sbi_trap_regs *regs)
+{
+	sbi_memcpy(regs, &ctx->regs, sizeof(*regs));
+	csr_write(CSR_SIE, ctx->sie);
+	csr_write(CSR_STVEC, ctx->stvec);
+	csr_write(CSR_SSCRATCH, ctx->sscratch);
+	csr_write(CSR_SEPC, ctx->sepc);
+	csr_write(CSR_SCAUSE, ctx->scause);
+	csr_write(CSR_STVAL, ctx->stval);
+	csr_clear(CSR_SIP, MIP_SSIP);
+	csr_set(CSR_SIP, ctx->sip);
+	csr_write(CSR_SATP, ctx->satp);
+	if (sbi_hart_has_feature(sbi_scratch_thishart_ptr(),
+				 SBI_HART_HAS_SCOUNTEREN))
+		csr_write(CSR_SCOUNTEREN, ctx->scounteren);
+}
+
+/* Set up a context to start the next booting stage of a domain */
+static void domain_context_setup(struct sbi_domain_context *ctx,
+				 struct sbi_domain *dom,
+				 const struct sbi_trap_regs *regs)
+{
+	sbi_memset(ctx, 0, sizeof(*ctx));
+	ctx->dom = dom;
+	ctx->regs.a0 = current_hartid();
+	ctx->regs.a1 = dom->next_arg1;
+	ctx->regs.mepc = dom->next_addr;
+	ctx->regs.mstatus = regs->mstatus & ~(MSTATUS_MPP | MSTATUS_SPP |
+					      MSTATUS_SIE | MSTATUS_SPIE);
+	ctx->regs.mstatus |= dom->next_mode << MSTATUS_MPP_SHIFT;
+#if __riscv_xlen == 32
+	ctx->regs.mstatusH = regs->mstatusH;
+#endif
+}
+
+static int domain_context_switch(struct sbi_domain *dom)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+
+	sbi_update_hartid_to_domain(current_hartid(), dom);
+	sbi_timer_event_fast_path_update();
+
+	/* Address spaces of different domains must not mix in the TLB */
+	__asm__ __volatile("sfence.vma");
+
+	return sbi_hart_pmp_configure(scratch);
+}
+
+int sbi_domain_context_enter(struct sbi_domain *dom, unsigned long arg,
+			     struct sbi_trap_regs *regs)
+{
+	int rc;
+	u32 hartid = current_hartid();
+	struct sbi_domain *cdom = sbi_domain_thishart_ptr();
+	struct sbi_domain_context_hart *dch;
+
+	if (!domain_context_off)
+		return SBI_ENOTSUPP;
+	if (!dom || dom == cdom || !dom->context_entry_allowed ||
+	    !sbi_hartmask_test_hart(hartid, dom->possible_harts))
+		return SBI_EINVAL;
+
+	/* Nested entry is not supported */
+	dch = sbi_scratch_thishart_offset_ptr(domain_context_off);
+	if (dch->assigned.dom)
+		return SBI_EALREADY;
+
+	domain_context_save(&dch->assigned, cdom, regs);
+	rc = domain_context_switch(dom);
+	if (rc) {
+		domain_context_switch(cdom);
+		dch->assigned.dom = NULL;
+		return rc;
+	}
+
+	if (dch->entered.dom == dom) {
+		/* Return from the exit call of the entered domain */
+		domain_context_restore(&dch->entered, regs);
+		regs->mepc += 4;
+		regs->a0 = 0;
+		regs->a1 = arg;
+	} else {
+		domain_context_setup(&dch->entered, dom, regs);
+		domain_context_restore(&dch->entered, regs);
+		regs->a2 = arg;
+	}
+
+	return SBI_ECONTEXT;
+}
+
+int sbi_domain_context_exit(unsigned long result,
+			    struct sbi_trap_regs *regs)
+{
+	int rc;
+	struct sbi_domain_context_hart *dch;
+
+	if (!domain_context_off)
+		return SBI_ENOTSUPP;
+	dch = sbi_scratch_thishart_offset_ptr(domain_context_off);
+	if (!dch->assigned.dom)
+		return SBI_EDENIED;
+
+	domain_context_save(&dch->entered, sbi_domain_thishart_ptr(), regs);
+	rc = domain_context_switch(dch->assigned.dom);
+	if (rc)
+		return rc;
+
+	/* Return from the enter call of the assigned domain */
+	domain_context_restore(&dch->assigned, regs);
+	dch->assigned.dom = NULL;
+	regs->mepc += 4;
+	regs->a0 = 0;
+	regs->a1 = result;
+
+	return SBI_ECONTEXT;
+}
+
+static int sbi_ecall_domain_context_handler(unsigned long extid,
+					    unsigned long funcid,
+					    const struct sbi_trap_regs *regs,
+					    unsigned long *out_val,
+					    struct sbi_trap_info *out_trap)
+{
+	/* The handler switches the trap registers to another context */
+	struct sbi_trap_regs *tregs = (struct sbi_trap_regs *)regs;
+
+	switch (funcid) {
+	case SBI_EXT_DOMAIN_CONTEXT_ENTER:
+		if (SBI_DOMAIN_MAX_INDEX <= regs->a0)
+			return SBI_EINVAL;
+		return sbi_domain_context_enter(sbi_index_to_domain(regs->a0),
+						regs->a1, tregs);
+	case SBI_EXT_DOMAIN_CONTEXT_EXIT:
+		return sbi_domain_context_exit(regs->a0, tregs);
+	default:
+		return SBI_ENOTSUPP;
+	};
+}
+
+struct sbi_ecall_extension ecall_domain_context = {
+	.extid_start = SBI_EXT_DOMAIN_CONTEXT,
+	.extid_end = SBI_EXT_DOMAIN_CONTEXT,
+	.handle = sbi_ecall_domain_context_handler,
+};
+
+int sbi_domain_context_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	u32 i;
+	struct sbi_domain *dom;
+	struct sbi_domain_context_hart *dch;
+
+	if (cold_boot) {
+		sbi_domain_for_each(i, dom) {
+			if (dom->context_entry_allowed)
+				break;
+		}
+		if (!dom)
+			return 0;
+
+		/*
+		 * Hypervisor state of the assigned domain is not switched
+		 * so don't allow context entry on such HARTs.
+		 */
+		if (misa_extension('H')) {
+			sbi_printf("%s: not supported with H-extension\n",
+				   __func__);
+			return 0;
+		}
+
+		domain_context_off = sbi_scratch_alloc_offset(sizeof(*dch),
+							"DOMAIN_CONTEXT");
+		if (!domain_context_off)
+			return SBI_ENOMEM;
+	}
+
+	if (!domain_context_off)
+		return 0;
+
+	/* A HART started again begins in its assigned domain */
+	dch = sbi_scratch_offset_ptr(scratch, domain_context_off);
+	if (dch->assigned.dom)
+		sbi_update_hartid_to_domain(current_hartid(),
+					    dch->assigned.dom);
+	sbi_memset(dch, 0, sizeof(*dch));
+
+	return 0;
+}
@@ -7,11 +7,17 @@
  *   Anup Patel <anup.patel@wdc.com>
  */
 
+#include <sbi/riscv_locks.h>
 #include <sbi/sbi_console.h>
+#include <sbi/sbi_domain.h>
 #include <sbi/sbi_ecall.h>
 #include <sbi/sbi_ecall_interface.h>
 #include <sbi/sbi_error.h>
+#include <sbi/sbi_ipi.h>
+#include <sbi/sbi_scratch.h>
 #include <sbi/sbi_trap.h>
+#include <sbi/sbi_trace.h>
+#include <sbi/sbi_trap_stats.h>
 
 u16 sbi_ecall_version_major(void)
 {
@@ -37,20 +43,104 @@ void sbi_ecall_set_impid(unsigned long impid)
 
 static SBI_LIST_HEAD(ecall_exts_list);
 
-struct sbi_ecall_extension *sbi_ecall_find_extension(unsigned long extid)
+/*
+ * Registered extensions sorted by extid_start so that lookup is a
+ * binary search independent of the registration order. The table is
+ * read on every ecall so lookups only retry when it was changed under
+ * them instead of taking a lock.
+ */
+static struct sbi_ecall_extension *ecall_exts_sorted[SBI_ECALL_EXTS_MAX];
+static u32 ecall_exts_count;
+static DEFINE_SEQLOCK(ecall_exts_lock);
+
+static struct sbi_ecall_extension *__hot ecall_exts_search(
+				struct sbi_ecall_extension *const *exts,
+				u32 count, unsigned long extid)
 {
-	struct sbi_ecall_extension *t, *ret = NULL;
+	u32 lo = 0, hi = count, mid;
+	struct sbi_ecall_extension *t;
 
-	sbi_list_for_each_entry(t, &ecall_exts_list, head) {
-		if (t->extid_start <= extid && extid <= t->extid_end) {
-			ret = t;
+	if (SBI_ECALL_EXTS_MAX < hi)
+		return NULL;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		t = exts[mid];
+		/* Only seen while racing with a writer */
+		if (!t)
 			break;
-		}
+		if (extid < t->extid_start)
+			hi = mid;
+		else if (t->extid_end < extid)
+			lo = mid + 1;
+		else
+			return t;
 	}
 
+	return NULL;
+}
+
+static void ecall_exts_insert(struct sbi_ecall_extension **exts,
+			      u32 *count, struct sbi_ecall_extension *ext)
+{
+	u32 i;
+	struct sbi_ecall_extension *t;
+
+	for (i = *count; i > 0; i--) {
+		t = exts[i - 1];
+		if (t->extid_start < ext->extid_start)
+			break;
+		exts[i] = t;
+	}
+	exts[i] = ext;
+	(*count)++;
+}
+
+static void ecall_exts_remove(struct sbi_ecall_extension **exts,
+			      u32 *count, struct sbi_ecall_extension *ext)
+{
+	u32 i;
+
+	for (i = 0; i < *count; i++) {
+		if (exts[i] == ext)
+			break;
+	}
+	if (i == *count)
+		return;
+	for (; i + 1 < *count; i++)
+		exts[i] = exts[i + 1];
+	(*count)--;
+}
+
+/*
+ * A domain with its own table only sees the extensions it is allowed
+ * to use, both for dispatch and for probing.
+ */
+static struct sbi_ecall_extension *ecall_domain_find(
+					const struct sbi_domain *dom,
+					unsigned long extid)
+{
+	unsigned long seq;
+	struct sbi_ecall_extension *ret;
+
+	do {
+		seq = read_seqbegin(&ecall_exts_lock);
+		if (dom->ecall_exts_count)
+			ret = ecall_exts_search(dom->ecall_exts,
+						dom->ecall_exts_count, extid);
+		else
+			ret = ecall_exts_search(ecall_exts_sorted,
+						ecall_exts_count, extid);
+	} while (read_seqretry(&ecall_exts_lock, seq));
+
 	return ret;
 }
 
+struct sbi_ecall_extension *__hot sbi_ecall_find_extension(unsigned long extid)
+{
+	return ecall_domain_find(sbi_domain_thishart_ptr(), extid);
+}
+
 int sbi_ecall_register_extension(struct sbi_ecall_extension *ext)
 {
 	struct sbi_ecall_extension *t;
@@ -58,29 +148,45 @@ int sbi_ecall_register_extension(struct sbi_ecall_extension *ext)
 	if (!ext || (ext->extid_end < ext->extid_start) || !ext->handle)
 		return SBI_EINVAL;
 
+	write_seqlock(&ecall_exts_lock);
+
 	sbi_list_for_each_entry(t, &ecall_exts_list, head) {
 		unsigned long start = t->extid_start;
 		unsigned long end = t->extid_end;
 		if (end < ext->extid_start || ext->extid_end < start)
 			/* no overlap */;
-		else
+		else {
+			write_sequnlock(&ecall_exts_lock);
 			return SBI_EINVAL;
+		}
+	}
+
+	if (SBI_ECALL_EXTS_MAX <= ecall_exts_count) {
+		write_sequnlock(&ecall_exts_lock);
+		return SBI_ENOSPC;
 	}
 
 	SBI_INIT_LIST_HEAD(&ext->head);
 	sbi_list_add_tail(&ext->head, &ecall_exts_list);
+	ecall_exts_insert(ecall_exts_sorted, &ecall_exts_count, ext);
+
+	write_sequnlock(&ecall_exts_lock);
 
 	return 0;
 }
 
 void sbi_ecall_unregister_extension(struct sbi_ecall_extension *ext)
 {
+	u32 i;
 	bool found = FALSE;
+	struct sbi_domain *dom;
 	struct sbi_ecall_extension *t;
 
 	if (!ext)
 		return;
 
+	write_seqlock(&ecall_exts_lock);
+
 	sbi_list_for_each_entry(t, &ecall_exts_list, head) {
 		if (t == ext) {
 			found = TRUE;
@@ -88,11 +194,71 @@ void sbi_ecall_unregister_extension(struct sbi_ecall_extension *ext)
 		}
 	}
 
-	if (found)
-		sbi_list_del_init(&ext->head);
+	if (!found) {
+		write_sequnlock(&ecall_exts_lock);
+		return;
+	}
+
+	sbi_list_del_init(&ext->head);
+	ecall_exts_remove(ecall_exts_sorted, &ecall_exts_count, ext);
+	sbi_domain_for_each(i, dom)
+		ecall_exts_remove(dom->ecall_exts, &dom->ecall_exts_count, ext);
+
+	write_sequnlock(&ecall_exts_lock);
 }
 
-int sbi_ecall_handler(struct sbi_trap_regs *regs)
+/**
+ * Allow a domain to use the registered extension implementing extid
+ *
+ * A domain which was allowed any extension can only use the extensions
+ * in its own table. It should be allowed the base extension for probing.
+ */
+int sbi_ecall_domain_allow(struct sbi_domain *dom, unsigned long extid)
+{
+	u32 i;
+	int rc = 0;
+	struct sbi_ecall_extension *ext;
+
+	if (!dom)
+		return SBI_EINVAL;
+
+	write_seqlock(&ecall_exts_lock);
+
+	ext = ecall_exts_search(ecall_exts_sorted, ecall_exts_count, extid);
+	if (!ext) {
+		rc = SBI_ENOENT;
+		goto done;
+	}
+
+	for (i = 0; i < dom->ecall_exts_count; i++) {
+		if (dom->ecall_exts[i] == ext)
+			goto done;
+	}
+
+	if (SBI_ECALL_EXTS_MAX <= dom->ecall_exts_count) {
+		rc = SBI_ENOSPC;
+		goto done;
+	}
+
+	ecall_exts_insert(dom->ecall_exts, &dom->ecall_exts_count, ext);
+
+done:
+	write_sequnlock(&ecall_exts_lock);
+
+	return rc;
+}
+
+/** Check whether a domain may use the extension implementing extid */
+bool sbi_ecall_domain_allowed(const struct sbi_domain *dom,
+			      unsigned long extid)
+{
+	if (!dom)
+		return FALSE;
+
+	return (ecall_domain_find(dom, extid)) ? TRUE : FALSE;
+}
+
+int __hot sbi_ecall_handler(struct sbi_trap_regs *regs)
 {
 	int ret = 0;
 	struct sbi_ecall_extension *ext;
@@ -101,6 +267,12 @@ int sbi_ecall_handler(struct sbi_trap_regs *regs)
 	struct sbi_trap_info trap = {0};
 	unsigned long out_val = 0;
 	bool is_0_1_spec = 0;
+	unsigned long stats_start = sbi_trap_stats_start();
+
+	sbi_trace(SBI_TRACE_ECALL, extension_id, func_id);
+
+	/* Events queued for a HART in IPI polling mode */
+	sbi_ipi_poll(sbi_scratch_thishart_ptr());
 
 	ext = sbi_ecall_find_extension(extension_id);
 	if (ext && ext->handle) {
@@ -116,6 +288,8 @@ int sbi_ecall_handler(struct sbi_trap_regs *regs)
 	if (ret == SBI_ETRAP) {
 		trap.epc = regs->mepc;
 		sbi_trap_redirect(regs, &trap);
+	} else if (ret == SBI_ECONTEXT) {
+		/* Trap registers were switched to another context */
 	} else {
 		if (ret < SBI_LAST_ERR) {
 			sbi_printf("%s: Invalid error %d for ext=0x%lx "
@@ -138,6 +312,8 @@ int sbi_ecall_handler(struct sbi_trap_regs *regs)
 			regs->a1 = out_val;
 	}
 
+	sbi_trap_stats_ecall(extension_id, func_id, stats_start);
+
 	return 0;
 }
 
@@ -145,31 +321,116 @@ int sbi_ecall_init(void)
 {
 	int ret;
 
-	/* The order of below registrations is performance optimized */
+#ifndef SBI_ECALL_TIME_DISABLED
 	ret = sbi_ecall_register_extension(&ecall_time);
 	if (ret)
 		return ret;
+#endif
+#ifndef SBI_ECALL_RFENCE_DISABLED
 	ret = sbi_ecall_register_extension(&ecall_rfence);
 	if (ret)
 		return ret;
+#endif
+#ifndef SBI_ECALL_IPI_DISABLED
 	ret = sbi_ecall_register_extension(&ecall_ipi);
 	if (ret)
 		return ret;
+#endif
 	ret = sbi_ecall_register_extension(&ecall_base);
 	if (ret)
 		return ret;
+#ifndef SBI_ECALL_HSM_DISABLED
 	ret = sbi_ecall_register_extension(&ecall_hsm);
 	if (ret)
 		return ret;
+#endif
+#ifndef SBI_ECALL_SRST_DISABLED
 	ret = sbi_ecall_register_extension(&ecall_srst);
 	if (ret)
 		return ret;
+	ret = sbi_ecall_register_extension(&ecall_warm_restart);
+	if (ret)
+		return ret;
+#endif
+#ifndef SBI_ECALL_PMU_DISABLED
+	ret = sbi_ecall_register_extension(&ecall_pmu);
+	if (ret)
+		return ret;
+#endif
+#ifndef SBI_ECALL_DBCN_DISABLED
+	ret = sbi_ecall_register_extension(&ecall_dbcn);
+	if (ret)
+		return ret;
+#endif
+#ifndef SBI_ECALL_SUSP_DISABLED
+	ret = sbi_ecall_register_extension(&ecall_susp);
+	if (ret)
+		return ret;
+#endif
+#ifndef SBI_ECALL_CPPC_DISABLED
+	ret = sbi_ecall_register_extension(&ecall_cppc);
+	if (ret)
+		return ret;
+#endif
+#ifndef SBI_ECALL_RFENCE_DISABLED
+	ret = sbi_ecall_register_extension(&ecall_rfence_stride);
+	if (ret)
+		return ret;
+	ret = sbi_ecall_register_extension(&ecall_rfence_batch);
+	if (ret)
+		return ret;
+	ret = sbi_ecall_register_extension(&ecall_rfence_async);
+	if (ret)
+		return ret;
+#endif
+#ifndef SBI_ECALL_LEGACY_DISABLED
 	ret = sbi_ecall_register_extension(&ecall_legacy);
 	if (ret)
 		return ret;
+#endif
+#ifndef SBI_ECALL_VENDOR_DISABLED
 	ret = sbi_ecall_register_extension(&ecall_vendor);
 	if (ret)
 		return ret;
+#endif
+	ret = sbi_ecall_register_extension(&ecall_boot_timeline);
+	if (ret)
+		return ret;
+	ret = sbi_ecall_register_extension(&ecall_time_sync);
+	if (ret)
+		return ret;
+	ret = sbi_ecall_register_extension(&ecall_cache);
+	if (ret)
+		return ret;
+	ret = sbi_ecall_register_extension(&ecall_domain_context);
+	if (ret)
+		return ret;
+	ret = sbi_ecall_register_extension(&ecall_fw_feature);
+	if (ret)
+		return ret;
+	ret = sbi_ecall_register_extension(&ecall_multicall);
+	if (ret)
+		return ret;
+#ifdef SBI_STEAL_TIME
+	ret = sbi_ecall_register_extension(&ecall_sta);
+	if (ret)
+		return ret;
+#endif
+#ifdef SBI_TRAP_STATS
+	ret = sbi_ecall_register_extension(&ecall_trap_stats);
+	if (ret)
+		return ret;
+#endif
+#ifdef SBI_TRACE
+	ret = sbi_ecall_register_extension(&ecall_trace);
+	if (ret)
+		return ret;
+#endif
+#ifdef SBI_LOCK_STATS
+	ret = sbi_ecall_register_extension(&ecall_lock_stats);
+	if (ret)
+		return ret;
+#endif
 
 	return 0;
 }
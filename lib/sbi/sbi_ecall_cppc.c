@@ -0,0 +1,64 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <sbi/sbi_cppc.h>
+#include <sbi/sbi_ecall.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_trap.h>
+
+static int sbi_ecall_cppc_handler(unsigned long extid, unsigned long funcid,
+				  const struct sbi_trap_regs *regs,
+				  unsigned long *out_val,
+				  struct sbi_trap_info *out_trap)
+{
+	int rc;
+	u64 val;
+
+	/* Register IDs are 32-bit */
+	if ((u64)regs->a0 >= ((u64)1 << 32))
+		return SBI_EINVAL;
+
+	switch (funcid) {
+	case SBI_EXT_CPPC_PROBE:
+		rc = sbi_cppc_probe(regs->a0);
+		if (rc < 0)
+			return rc;
+		*out_val = rc;
+		return 0;
+	case SBI_EXT_CPPC_READ:
+		rc = sbi_cppc_read(regs->a0, &val);
+		if (!rc)
+			*out_val = val;
+		return rc;
+	case SBI_EXT_CPPC_READ_HI:
+#if __riscv_xlen == 32
+		rc = sbi_cppc_read(regs->a0, &val);
+		if (!rc)
+			*out_val = val >> 32;
+		return rc;
+#else
+		return SBI_ENOTSUPP;
+#endif
+	case SBI_EXT_CPPC_WRITE:
+		return sbi_cppc_write(regs->a0, regs->a1);
+	default:
+		return SBI_ENOTSUPP;
+	};
+}
+
+static int sbi_ecall_cppc_probe(unsigned long extid, unsigned long *out_val)
+{
+	*out_val = (sbi_cppc_get_device()) ? 1 : 0;
+	return 0;
+}
+
+struct sbi_ecall_extension ecall_cppc = {
+	.extid_start = SBI_EXT_CPPC,
+	.extid_end = SBI_EXT_CPPC,
+	.probe = sbi_ecall_cppc_probe,
+	.handle = sbi_ecall_cppc_handler,
+};
@@ -0,0 +1,91 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <sbi/sbi_ecall.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_ipi.h>
+#include <sbi/sbi_misaligned_ldst.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_timer.h>
+#include <sbi/sbi_trap.h>
+
+/*
+ * Firmware features are set per HART by S-mode. They apply to the
+ * calling HART only and are kept across HSM stop/start and suspend.
+ */
+static int sbi_ecall_fw_feature_handler(unsigned long extid,
+					unsigned long funcid,
+					const struct sbi_trap_regs *regs,
+					unsigned long *out_val,
+					struct sbi_trap_info *out_trap)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+
+	switch (funcid) {
+	case SBI_EXT_FW_FEATURE_SET:
+		switch (regs->a0) {
+		case SBI_FW_FEATURE_MISALIGNED_DELEG:
+			if (1 < regs->a1)
+				return SBI_EINVAL;
+			return sbi_hart_misaligned_deleg_set(scratch,
+							     regs->a1);
+		case SBI_FW_FEATURE_IPI_POLL:
+			if (1 < regs->a1)
+				return SBI_EINVAL;
+			return sbi_ipi_poll_set(scratch, regs->a1);
+		case SBI_FW_FEATURE_MISALIGNED_STORM_LIMIT:
+			return sbi_misaligned_storm_set(scratch,
+					SBI_MISALIGNED_STORM_LIMIT, regs->a1);
+		case SBI_FW_FEATURE_MISALIGNED_STORM_WINDOW:
+			return sbi_misaligned_storm_set(scratch,
+					SBI_MISALIGNED_STORM_WINDOW, regs->a1);
+		case SBI_FW_FEATURE_MISALIGNED_STORM_DELEG:
+			return sbi_misaligned_storm_set(scratch,
+					SBI_MISALIGNED_STORM_DELEG, regs->a1);
+		case SBI_FW_FEATURE_TIMER_SLACK:
+			sbi_timer_slack_set(scratch, regs->a1);
+			return 0;
+		default:
+			return SBI_ENOTSUPP;
+		}
+	case SBI_EXT_FW_FEATURE_GET:
+		switch (regs->a0) {
+		case SBI_FW_FEATURE_MISALIGNED_DELEG:
+			*out_val = sbi_hart_misaligned_deleg_get(scratch);
+			return 0;
+		case SBI_FW_FEATURE_IPI_POLL:
+			*out_val = sbi_ipi_poll_get(scratch);
+			return 0;
+		case SBI_FW_FEATURE_MISALIGNED_STORM_LIMIT:
+			*out_val = sbi_misaligned_storm_get(scratch,
+					SBI_MISALIGNED_STORM_LIMIT);
+			return 0;
+		case SBI_FW_FEATURE_MISALIGNED_STORM_WINDOW:
+			*out_val = sbi_misaligned_storm_get(scratch,
+					SBI_MISALIGNED_STORM_WINDOW);
+			return 0;
+		case SBI_FW_FEATURE_MISALIGNED_STORM_DELEG:
+			*out_val = sbi_misaligned_storm_get(scratch,
+					SBI_MISALIGNED_STORM_DELEG);
+			return 0;
+		case SBI_FW_FEATURE_TIMER_SLACK:
+			*out_val = sbi_timer_slack_get(scratch);
+			return 0;
+		default:
+			return SBI_ENOTSUPP;
+		}
+	default:
+		return SBI_ENOTSUPP;
+	}
+}
+
+struct sbi_ecall_extension ecall_fw_feature = {
+	.extid_start = SBI_EXT_FW_FEATURE,
+	.extid_end = SBI_EXT_FW_FEATURE,
+	.handle = sbi_ecall_fw_feature_handler,
+};
@@ -17,6 +17,7 @@
 #include <sbi/sbi_hsm.h>
 #include <sbi/sbi_ipi.h>
 #include <sbi/sbi_platform.h>
+#include <sbi/sbi_scratch.h>
 #include <sbi/sbi_system.h>
 #include <sbi/sbi_timer.h>
 #include <sbi/sbi_tlb.h>
@@ -49,7 +50,7 @@ static int sbi_ecall_legacy_handler(unsigned long extid, unsigned long funcid,
 {
 	int ret = 0;
 	struct sbi_tlb_info tlb_info;
-	u32 source_hart = current_hartid();
+	u32 source_hart = sbi_current_hartid();
 	ulong hmask = 0;
 
 	switch (extid) {
@@ -0,0 +1,151 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <sbi/sbi_ecall.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_string.h>
+#include <sbi/sbi_trace.h>
+#include <sbi/sbi_trap.h>
+#include <sbi/sbi_unpriv.h>
+
+/* Number of records copied from and to S-mode at once */
+#define MULTICALL_CHUNK			4
+
+/* Maximum number of records executed by one multicall */
+#define MULTICALL_MAX_RECORDS		64
+
+/* Layout of one record in the S-mode array, all fields are XLEN words */
+struct sbi_multicall_rec {
+	unsigned long extid;
+	unsigned long funcid;
+	unsigned long args[6];
+	unsigned long error;
+	unsigned long value;
+};
+
+static bool sbi_multicall_allowed(unsigned long extid)
+{
+	/* Legacy calls return in a0 only and may trap on S-mode memory */
+	if (extid <= SBI_EXT_0_1_SHUTDOWN)
+		return FALSE;
+
+	/* These switch or rely on the trap registers of the real call */
+	if (extid == SBI_EXT_MULTICALL || extid == SBI_EXT_DOMAIN_CONTEXT)
+		return FALSE;
+
+	/*
+	 * These may not return to the caller, which would lose the results
+	 * of the earlier records
+	 */
+	if (extid == SBI_EXT_HSM || extid == SBI_EXT_SRST ||
+	    extid == SBI_EXT_SUSP || extid == SBI_EXT_WARM_RESTART)
+		return FALSE;
+
+	return TRUE;
+}
+
+static void sbi_multicall_one(struct sbi_trap_regs *regs,
+			      struct sbi_multicall_rec *rec)
+{
+	int ret;
+	unsigned long out_val = 0;
+	struct sbi_trap_info trap = {0};
+	struct sbi_ecall_extension *ext;
+
+	sbi_trace(SBI_TRACE_ECALL, rec->extid, rec->funcid);
+
+	ext = (sbi_multicall_allowed(rec->extid)) ?
+	      sbi_ecall_find_extension(rec->extid) : NULL;
+	if (ext && ext->handle) {
+		regs->a0 = rec->args[0];
+		regs->a1 = rec->args[1];
+		regs->a2 = rec->args[2];
+		regs->a3 = rec->args[3];
+		regs->a4 = rec->args[4];
+		regs->a5 = rec->args[5];
+		regs->a6 = rec->funcid;
+		regs->a7 = rec->extid;
+		ret = ext->handle(rec->extid, rec->funcid,
+				  regs, &out_val, &trap);
+	} else {
+		ret = SBI_ENOTSUPP;
+	}
+
+	/* A trap can not be redirected from the middle of the array */
+	if (ret == SBI_ETRAP)
+		ret = SBI_EINVALID_ADDR;
+	else if (ret < SBI_LAST_ERR)
+		ret = SBI_ERR_FAILED;
+
+	rec->error = ret;
+	rec->value = out_val;
+}
+
+/*
+ * Execute count records at the S-mode address addr in order. Each call
+ * goes through the same dispatch as a direct SBI call but the trap entry
+ * and exit is paid once. Records are copied in and their error and value
+ * written back in chunks with the bulk unprivileged copy helpers.
+ */
+static int sbi_multicall_execute(const struct sbi_trap_regs *regs,
+				 unsigned long *out_val,
+				 struct sbi_trap_info *out_trap)
+{
+	u32 i, n;
+	struct sbi_trap_regs call_regs;
+	struct sbi_multicall_rec recs[MULTICALL_CHUNK];
+	struct sbi_multicall_rec *addr = (void *)regs->a0;
+	unsigned long count = regs->a1, done = 0;
+
+	if ((regs->a0 & (sizeof(unsigned long) - 1)) ||
+	    count > MULTICALL_MAX_RECORDS)
+		return SBI_EINVAL;
+
+	sbi_memcpy(&call_regs, regs, sizeof(call_regs));
+	while (done < count) {
+		n = (count - done < MULTICALL_CHUNK) ?
+		    count - done : MULTICALL_CHUNK;
+
+		sbi_copy_from_lower(recs, &addr[done], n * sizeof(*recs),
+				    out_trap);
+		if (out_trap->cause)
+			return SBI_ETRAP;
+
+		for (i = 0; i < n; i++)
+			sbi_multicall_one(&call_regs, &recs[i]);
+
+		sbi_copy_to_lower(&addr[done], recs, n * sizeof(*recs),
+				  out_trap);
+		if (out_trap->cause)
+			return SBI_ETRAP;
+
+		done += n;
+	}
+
+	*out_val = done;
+	return 0;
+}
+
+static int sbi_ecall_multicall_handler(unsigned long extid,
+				       unsigned long funcid,
+				       const struct sbi_trap_regs *regs,
+				       unsigned long *out_val,
+				       struct sbi_trap_info *out_trap)
+{
+	switch (funcid) {
+	case SBI_EXT_MULTICALL_EXECUTE:
+		return sbi_multicall_execute(regs, out_val, out_trap);
+	default:
+		return SBI_ENOTSUPP;
+	}
+}
+
+struct sbi_ecall_extension ecall_multicall = {
+	.extid_start = SBI_EXT_MULTICALL,
+	.extid_end = SBI_EXT_MULTICALL,
+	.handle = sbi_ecall_multicall_handler,
+};
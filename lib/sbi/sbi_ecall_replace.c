@@ -9,20 +9,25 @@
  */
 
 #include <sbi/riscv_asm.h>
+#include <sbi/sbi_domain.h>
 #include <sbi/sbi_ecall.h>
 #include <sbi/sbi_ecall_interface.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_ipi.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
 #include <sbi/sbi_system.h>
 #include <sbi/sbi_timer.h>
 #include <sbi/sbi_tlb.h>
 #include <sbi/sbi_trap.h>
 
-static int sbi_ecall_time_handler(unsigned long extid, unsigned long funcid,
-				  const struct sbi_trap_regs *regs,
-				  unsigned long *out_val,
-				  struct sbi_trap_info *out_trap)
+#ifndef SBI_ECALL_TIME_DISABLED
+static int __hot sbi_ecall_time_handler(unsigned long extid,
+					unsigned long funcid,
+					const struct sbi_trap_regs *regs,
+					unsigned long *out_val,
+					struct sbi_trap_info *out_trap)
 {
 	int ret = 0;
 
@@ -43,16 +48,45 @@ struct sbi_ecall_extension ecall_time = {
 	.extid_end = SBI_EXT_TIME,
 	.handle = sbi_ecall_time_handler,
 };
+#endif
 
-static int sbi_ecall_rfence_handler(unsigned long extid, unsigned long funcid,
-				    const struct sbi_trap_regs *regs,
-				    unsigned long *out_val,
-				    struct sbi_trap_info *out_trap)
+#ifndef SBI_ECALL_RFENCE_DISABLED
+static void sbi_ecall_rfence_set_stride(struct sbi_tlb_info *tinfo,
+					unsigned long stride)
+{
+	unsigned long end;
+
+	if (stride <= PAGE_SIZE)
+		return;
+	if ((!tinfo->start && !tinfo->size) || tinfo->size == SBI_TLB_FLUSH_ALL)
+		return;
+
+	/*
+	 * Flushing any address of a huge page flushes the whole huge page
+	 * so align the range to the stride and flush one address per stride.
+	 */
+	end = tinfo->start + tinfo->size;
+	if (end < tinfo->start || end > ((unsigned long)-1) - (stride - 1)) {
+		tinfo->start = 0;
+		tinfo->size = SBI_TLB_FLUSH_ALL;
+		return;
+	}
+	end = (end + stride - 1) & ~(stride - 1);
+	tinfo->start &= ~(stride - 1);
+	tinfo->size = end - tinfo->start;
+	tinfo->stride = stride;
+}
+
+/* Describe an RFENCE function call, id is the ASID or VMID argument */
+static int __hot sbi_ecall_rfence_tinfo(struct sbi_tlb_info *tlb_info,
+					unsigned long funcid,
+					unsigned long start,
+					unsigned long size,
+					unsigned long id,
+					unsigned long stride)
 {
-	int ret = 0;
 	unsigned long vmid;
-	struct sbi_tlb_info tlb_info;
-	u32 source_hart = current_hartid();
+	u32 source_hart = sbi_current_hartid();
 
 	if (funcid >= SBI_EXT_RFENCE_REMOTE_HFENCE_GVMA &&
 	    funcid <= SBI_EXT_RFENCE_REMOTE_HFENCE_VVMA_ASID)
@@ -61,51 +95,71 @@ static int sbi_ecall_rfence_handler(unsigned long extid, unsigned long funcid,
 
 	switch (funcid) {
 	case SBI_EXT_RFENCE_REMOTE_FENCE_I:
-		SBI_TLB_INFO_INIT(&tlb_info, 0, 0, 0, 0,
+		SBI_TLB_INFO_INIT(tlb_info, 0, 0, 0, 0,
 				  sbi_tlb_local_fence_i, source_hart);
-		ret = sbi_tlb_request(regs->a0, regs->a1, &tlb_info);
 		break;
 	case SBI_EXT_RFENCE_REMOTE_HFENCE_GVMA:
-		SBI_TLB_INFO_INIT(&tlb_info, regs->a2, regs->a3, 0, 0,
+		SBI_TLB_INFO_INIT(tlb_info, start, size, 0, 0,
 				  sbi_tlb_local_hfence_gvma, source_hart);
-		ret = sbi_tlb_request(regs->a0, regs->a1, &tlb_info);
 		break;
 	case SBI_EXT_RFENCE_REMOTE_HFENCE_GVMA_VMID:
-		SBI_TLB_INFO_INIT(&tlb_info, regs->a2, regs->a3, 0, regs->a4,
+		SBI_TLB_INFO_INIT(tlb_info, start, size, 0, id,
 				  sbi_tlb_local_hfence_gvma_vmid,
 				  source_hart);
-		ret = sbi_tlb_request(regs->a0, regs->a1, &tlb_info);
 		break;
 	case SBI_EXT_RFENCE_REMOTE_HFENCE_VVMA:
 		vmid = (csr_read(CSR_HGATP) & HGATP_VMID_MASK);
 		vmid = vmid >> HGATP_VMID_SHIFT;
-		SBI_TLB_INFO_INIT(&tlb_info, regs->a2, regs->a3, 0, vmid,
+		SBI_TLB_INFO_INIT(tlb_info, start, size, 0, vmid,
 				  sbi_tlb_local_hfence_vvma, source_hart);
-		ret = sbi_tlb_request(regs->a0, regs->a1, &tlb_info);
 		break;
 	case SBI_EXT_RFENCE_REMOTE_HFENCE_VVMA_ASID:
 		vmid = (csr_read(CSR_HGATP) & HGATP_VMID_MASK);
 		vmid = vmid >> HGATP_VMID_SHIFT;
-		SBI_TLB_INFO_INIT(&tlb_info, regs->a2, regs->a3, regs->a4,
+		SBI_TLB_INFO_INIT(tlb_info, start, size, id,
 				  vmid, sbi_tlb_local_hfence_vvma_asid,
 				  source_hart);
-		ret = sbi_tlb_request(regs->a0, regs->a1, &tlb_info);
 		break;
 	case SBI_EXT_RFENCE_REMOTE_SFENCE_VMA:
-		SBI_TLB_INFO_INIT(&tlb_info, regs->a2, regs->a3, 0, 0,
+		SBI_TLB_INFO_INIT(tlb_info, start, size, 0, 0,
 				  sbi_tlb_local_sfence_vma, source_hart);
-		ret = sbi_tlb_request(regs->a0, regs->a1, &tlb_info);
 		break;
 	case SBI_EXT_RFENCE_REMOTE_SFENCE_VMA_ASID:
-		SBI_TLB_INFO_INIT(&tlb_info, regs->a2, regs->a3, regs->a4, 0,
+		SBI_TLB_INFO_INIT(tlb_info, start, size, id, 0,
 				  sbi_tlb_local_sfence_vma_asid, source_hart);
-		ret = sbi_tlb_request(regs->a0, regs->a1, &tlb_info);
 		break;
 	default:
-		ret = SBI_ENOTSUPP;
+		return SBI_ENOTSUPP;
 	};
 
-	return ret;
+	if (funcid != SBI_EXT_RFENCE_REMOTE_FENCE_I)
+		sbi_ecall_rfence_set_stride(tlb_info, stride);
+
+	return 0;
+}
+
+static int __hot sbi_ecall_rfence_common(unsigned long funcid,
+					 const struct sbi_trap_regs *regs,
+					 unsigned long stride)
+{
+	int ret;
+	struct sbi_tlb_info tlb_info;
+
+	ret = sbi_ecall_rfence_tinfo(&tlb_info, funcid, regs->a2, regs->a3,
+				     regs->a4, stride);
+	if (ret)
+		return ret;
+
+	return sbi_tlb_request(regs->a0, regs->a1, &tlb_info);
+}
+
+static int __hot sbi_ecall_rfence_handler(unsigned long extid,
+					  unsigned long funcid,
+					  const struct sbi_trap_regs *regs,
+					  unsigned long *out_val,
+					  struct sbi_trap_info *out_trap)
+{
+	return sbi_ecall_rfence_common(funcid, regs, PAGE_SIZE);
 }
 
 struct sbi_ecall_extension ecall_rfence = {
@@ -114,10 +168,155 @@ struct sbi_ecall_extension ecall_rfence = {
 	.handle = sbi_ecall_rfence_handler,
 };
 
-static int sbi_ecall_ipi_handler(unsigned long extid, unsigned long funcid,
-				 const struct sbi_trap_regs *regs,
-				 unsigned long *out_val,
-				 struct sbi_trap_info *out_trap)
+static int sbi_ecall_rfence_stride_handler(unsigned long extid,
+					   unsigned long funcid,
+					   const struct sbi_trap_regs *regs,
+					   unsigned long *out_val,
+					   struct sbi_trap_info *out_trap)
+{
+	unsigned long order = regs->a5;
+
+	/* Zero order means the default stride of PAGE_SIZE */
+	if (!order)
+		order = PAGE_SHIFT;
+	if (order < PAGE_SHIFT || SBI_RFENCE_STRIDE_ORDER_MAX < order)
+		return SBI_EINVAL;
+
+	return sbi_ecall_rfence_common(funcid, regs, 1UL << order);
+}
+
+struct sbi_ecall_extension ecall_rfence_stride = {
+	.extid_start = SBI_EXT_RFENCE_STRIDE,
+	.extid_end = SBI_EXT_RFENCE_STRIDE,
+	.handle = sbi_ecall_rfence_stride_handler,
+};
+
+/* Descriptors of a submission are coalesced in chunks of this size */
+#define RFENCE_BATCH_CHUNK		8
+
+static int sbi_ecall_rfence_batch_submit(unsigned long hmask,
+					 unsigned long hbase,
+					 unsigned long count)
+{
+	int ret;
+	u32 i, n;
+	unsigned long shmem_count;
+	struct sbi_tlb_info tlb_info[RFENCE_BATCH_CHUNK];
+	struct sbi_rfence_desc desc, *shmem = sbi_tlb_shmem_get(&shmem_count);
+
+	if (!shmem)
+		return SBI_EDENIED;
+	if (!count || shmem_count < count)
+		return SBI_EINVAL;
+
+	while (count) {
+		n = (count < RFENCE_BATCH_CHUNK) ? count : RFENCE_BATCH_CHUNK;
+		for (i = 0; i < n; i++) {
+			/* S-mode may change the descriptor meanwhile */
+			sbi_memcpy(&desc, &shmem[i], sizeof(desc));
+			ret = sbi_ecall_rfence_tinfo(&tlb_info[i], desc.funcid,
+						     desc.start, desc.size,
+						     desc.id, PAGE_SIZE);
+			if (ret)
+				return ret;
+		}
+
+		ret = sbi_tlb_request_many(hmask, hbase, tlb_info, n);
+		if (ret)
+			return ret;
+
+		shmem += n;
+		count -= n;
+	}
+
+	return 0;
+}
+
+static int sbi_ecall_rfence_batch_handler(unsigned long extid,
+					  unsigned long funcid,
+					  const struct sbi_trap_regs *regs,
+					  unsigned long *out_val,
+					  struct sbi_trap_info *out_trap)
+{
+	switch (funcid) {
+	case SBI_EXT_RFENCE_BATCH_SET_SHMEM:
+		if (regs->a0 == SBI_RFENCE_BATCH_SHMEM_DISABLE)
+			return sbi_tlb_shmem_set(0, 0);
+		if (!regs->a1 ||
+		    regs->a1 > (-1UL / sizeof(struct sbi_rfence_desc)) ||
+		    (regs->a0 & (sizeof(unsigned long) - 1)))
+			return SBI_EINVAL;
+		/* Validated once here instead of on every submission */
+		if (!sbi_domain_check_addr_range(sbi_domain_thishart_ptr(),
+				regs->a0,
+				regs->a1 * sizeof(struct sbi_rfence_desc),
+				PRV_S, SBI_DOMAIN_READ))
+			return SBI_EINVALID_ADDR;
+		return sbi_tlb_shmem_set(regs->a0, regs->a1);
+	case SBI_EXT_RFENCE_BATCH_SUBMIT:
+		return sbi_ecall_rfence_batch_submit(regs->a0, regs->a1,
+						     regs->a2);
+	default:
+		return SBI_ENOTSUPP;
+	}
+}
+
+struct sbi_ecall_extension ecall_rfence_batch = {
+	.extid_start = SBI_EXT_RFENCE_BATCH,
+	.extid_end = SBI_EXT_RFENCE_BATCH,
+	.handle = sbi_ecall_rfence_batch_handler,
+};
+
+static int sbi_ecall_rfence_async_handler(unsigned long extid,
+					  unsigned long funcid,
+					  const struct sbi_trap_regs *regs,
+					  unsigned long *out_val,
+					  struct sbi_trap_info *out_trap)
+{
+	int ret;
+	bool ssip;
+	struct sbi_tlb_info tlb_info;
+
+	switch (funcid) {
+	case SBI_EXT_RFENCE_ASYNC_SET_SHMEM:
+		if (regs->a1 & ~SBI_RFENCE_ASYNC_FLAG_SSIP)
+			return SBI_EINVAL;
+		ssip = (regs->a1 & SBI_RFENCE_ASYNC_FLAG_SSIP) ? TRUE : FALSE;
+		if (regs->a0 == SBI_RFENCE_ASYNC_SHMEM_DISABLE)
+			return sbi_tlb_async_set(0, ssip);
+		if (regs->a0 & (sizeof(unsigned long) - 1))
+			return SBI_EINVAL;
+		/* Written by M-mode of the target HARTs on completion */
+		if (!sbi_domain_check_addr_range(sbi_domain_thishart_ptr(),
+				regs->a0, sizeof(unsigned long), PRV_S,
+				SBI_DOMAIN_READ | SBI_DOMAIN_WRITE))
+			return SBI_EINVALID_ADDR;
+		return sbi_tlb_async_set(regs->a0, ssip);
+	case SBI_EXT_RFENCE_ASYNC_REMOTE_FENCE:
+		ret = sbi_ecall_rfence_tinfo(&tlb_info, regs->a2, regs->a3,
+					     regs->a4, regs->a5, PAGE_SIZE);
+		if (ret)
+			return ret;
+		return sbi_tlb_request_async(regs->a0, regs->a1, &tlb_info,
+					     out_val);
+	default:
+		return SBI_ENOTSUPP;
+	}
+}
+
+struct sbi_ecall_extension ecall_rfence_async = {
+	.extid_start = SBI_EXT_RFENCE_ASYNC,
+	.extid_end = SBI_EXT_RFENCE_ASYNC,
+	.handle = sbi_ecall_rfence_async_handler,
+};
+#endif
+
+#ifndef SBI_ECALL_IPI_DISABLED
+static int __hot sbi_ecall_ipi_handler(unsigned long extid,
+				       unsigned long funcid,
+				       const struct sbi_trap_regs *regs,
+				       unsigned long *out_val,
+				       struct sbi_trap_info *out_trap)
 {
 	int ret = 0;
 
@@ -134,7 +333,9 @@ struct sbi_ecall_extension ecall_ipi = {
 	.extid_end = SBI_EXT_IPI,
 	.handle = sbi_ecall_ipi_handler,
 };
+#endif
 
+#ifndef SBI_ECALL_SRST_DISABLED
 static int sbi_ecall_srst_handler(unsigned long extid, unsigned long funcid,
 				  const struct sbi_trap_regs *regs,
 				  unsigned long *out_val,
@@ -194,3 +395,30 @@ struct sbi_ecall_extension ecall_srst = {
 	.handle = sbi_ecall_srst_handler,
 	.probe = sbi_ecall_srst_probe,
 };
+
+static int sbi_ecall_warm_restart_handler(unsigned long extid,
+					  unsigned long funcid,
+					  const struct sbi_trap_regs *regs,
+					  unsigned long *out_val,
+					  struct sbi_trap_info *out_trap)
+{
+	if (funcid == SBI_EXT_WARM_RESTART_RESTART)
+		return sbi_system_warm_restart(regs->a0, regs->a1);
+
+	return SBI_ENOTSUPP;
+}
+
+static int sbi_ecall_warm_restart_probe(unsigned long extid,
+					unsigned long *out_val)
+{
+	*out_val = (sbi_domain_thishart_ptr()->system_reset_allowed) ? 1 : 0;
+	return 0;
+}
+
+struct sbi_ecall_extension ecall_warm_restart = {
+	.extid_start = SBI_EXT_WARM_RESTART,
+	.extid_end = SBI_EXT_WARM_RESTART,
+	.handle = sbi_ecall_warm_restart_handler,
+	.probe = sbi_ecall_warm_restart_probe,
+};
+#endif
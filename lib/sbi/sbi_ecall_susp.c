@@ -0,0 +1,49 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <sbi/sbi_ecall.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_system.h>
+#include <sbi/sbi_trap.h>
+
+static int sbi_ecall_susp_handler(unsigned long extid, unsigned long funcid,
+				  const struct sbi_trap_regs *regs,
+				  unsigned long *out_val,
+				  struct sbi_trap_info *out_trap)
+{
+	if (funcid != SBI_EXT_SUSP_SUSPEND)
+		return SBI_ENOTSUPP;
+
+	if ((u64)regs->a0 >= ((u64)1 << 32))
+		return SBI_EINVAL;
+	if (SBI_SUSP_SLEEP_TYPE_LAST < regs->a0 &&
+	    regs->a0 < SBI_SUSP_PLATFORM_SLEEP_START)
+		return SBI_EINVAL;
+
+	return sbi_system_suspend(regs->a0, regs->a1, regs->a2);
+}
+
+static int sbi_ecall_susp_probe(unsigned long extid, unsigned long *out_val)
+{
+	u32 type, count = 0;
+
+	/* At least the standard sleep type should be usable */
+	for (type = 0; type <= SBI_SUSP_SLEEP_TYPE_LAST; type++) {
+		if (sbi_system_suspend_supported(type))
+			count++;
+	}
+
+	*out_val = (count) ? 1 : 0;
+	return 0;
+}
+
+struct sbi_ecall_extension ecall_susp = {
+	.extid_start = SBI_EXT_SUSP,
+	.extid_end = SBI_EXT_SUSP,
+	.probe = sbi_ecall_susp_probe,
+	.handle = sbi_ecall_susp_handler,
+};
@@ -14,6 +14,7 @@
 #include <sbi/sbi_emulate_csr.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_hart.h>
+#include <sbi/sbi_pmu.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_timer.h>
 #include <sbi/sbi_trap.h>
@@ -54,7 +55,13 @@ int sbi_emulate_csr_read(int csr_num, struct sbi_trap_regs *regs,
 	bool virt = (regs->mstatus & MSTATUS_MPV) ? TRUE : FALSE;
 #endif
 
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_EMULATED_CSR);
+
 	switch (csr_num) {
+	/*
+	 * Only reached when htimedelta is not implemented in hardware,
+	 * see SBI_HART_HAS_HTIMEDELTA.
+	 */
 	case CSR_HTIMEDELTA:
 		if (prev_mode == PRV_S && !virt)
 			*csr_val = sbi_timer_get_delta();
@@ -169,6 +176,8 @@ int sbi_emulate_csr_write(int csr_num, struct sbi_trap_regs *regs,
 	bool virt = (regs->mstatus & MSTATUS_MPV) ? TRUE : FALSE;
 #endif
 
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_EMULATED_CSR);
+
 	switch (csr_num) {
 	case CSR_HTIMEDELTA:
 		if (prev_mode == PRV_S && !virt)
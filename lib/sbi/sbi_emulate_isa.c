@@ -0,0 +1,417 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifdef SBI_ISA_EMULATION
+
+#include <sbi/riscv_barrier.h>
+#include <sbi/riscv_encoding.h>
+#include <sbi/sbi_bitops.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_emulate_isa.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_pmu.h>
+#include <sbi/sbi_trap.h>
+#include <sbi/sbi_unpriv.h>
+
+/* clang-format off */
+
+#define OPCODE_MISC_MEM			0x0f
+#define OPCODE_OP_IMM			0x13
+#define OPCODE_OP_IMM_32		0x1b
+#define OPCODE_OP			0x33
+#define OPCODE_OP_32			0x3b
+
+#define INSN_FUNCT3(insn)		(((insn) >> 12) & 0x7)
+#define INSN_FUNCT6(insn)		(((insn) >> 26) & 0x3f)
+#define INSN_FUNCT7(insn)		(((insn) >> 25) & 0x7f)
+#define INSN_RS2(insn)			(((insn) >> 20) & 0x1f)
+#define INSN_IMM12(insn)		(((insn) >> 20) & 0xfff)
+#define INSN_SHAMT(insn)		(((insn) >> 20) & (__riscv_xlen - 1))
+
+/* funct7 and funct3 of register-register instructions */
+#define OP(__funct7, __funct3)		(((__funct7) << 3) | (__funct3))
+
+#if __riscv_xlen == 64
+#define IMM12_REV8			0x6b8
+#else
+#define IMM12_REV8			0x698
+#endif
+#define IMM12_ORC_B			0x287
+#define IMM12_CLZ			0x600
+#define IMM12_CTZ			0x601
+#define IMM12_CPOP			0x602
+#define IMM12_SEXT_B			0x604
+#define IMM12_SEXT_H			0x605
+
+#define CBO_INVAL			0x0
+#define CBO_CLEAN			0x1
+#define CBO_FLUSH			0x2
+
+/* clang-format on */
+
+static ulong emulate_clz(ulong x, ulong bits)
+{
+	return (x) ? bits - 1 - __fls(x) : bits;
+}
+
+static ulong emulate_ctz(ulong x, ulong bits)
+{
+	return (x) ? __ffs(x) : bits;
+}
+
+static ulong emulate_cpop(ulong x)
+{
+	ulong ret = 0;
+
+	while (x) {
+		x &= x - 1;
+		ret++;
+	}
+
+	return ret;
+}
+
+static ulong emulate_rol(ulong x, ulong sh)
+{
+	sh &= __riscv_xlen - 1;
+
+	return (x << sh) | (x >> ((__riscv_xlen - sh) & (__riscv_xlen - 1)));
+}
+
+static ulong emulate_ror(ulong x, ulong sh)
+{
+	return emulate_rol(x, __riscv_xlen - (sh & (__riscv_xlen - 1)));
+}
+
+static ulong emulate_rev8(ulong x)
+{
+	ulong i, ret = 0;
+
+	for (i = 0; i < sizeof(ulong); i++, x >>= 8)
+		ret = (ret << 8) | (x & 0xff);
+
+	return ret;
+}
+
+static ulong emulate_orc_b(ulong x)
+{
+	ulong i, ret = 0;
+
+	for (i = 0; i < sizeof(ulong); i++)
+		if (x & (0xffUL << (i * 8)))
+			ret |= 0xffUL << (i * 8);
+
+	return ret;
+}
+
+static int emulate_op(ulong insn, ulong rs1, ulong rs2, ulong *rd)
+{
+	ulong sh = rs2 & (__riscv_xlen - 1);
+
+	switch (OP(INSN_FUNCT7(insn), INSN_FUNCT3(insn))) {
+	/* Zba */
+	case OP(0x10, 2):
+		*rd = (rs1 << 1) + rs2;
+		break;
+	case OP(0x10, 4):
+		*rd = (rs1 << 2) + rs2;
+		break;
+	case OP(0x10, 6):
+		*rd = (rs1 << 3) + rs2;
+		break;
+	/* Zbb */
+	case OP(0x20, 7):
+		*rd = rs1 & ~rs2;
+		break;
+	case OP(0x20, 6):
+		*rd = rs1 | ~rs2;
+		break;
+	case OP(0x20, 4):
+		*rd = ~(rs1 ^ rs2);
+		break;
+	case OP(0x05, 4):
+		*rd = ((long)rs1 < (long)rs2) ? rs1 : rs2;
+		break;
+	case OP(0x05, 5):
+		*rd = (rs1 < rs2) ? rs1 : rs2;
+		break;
+	case OP(0x05, 6):
+		*rd = ((long)rs1 > (long)rs2) ? rs1 : rs2;
+		break;
+	case OP(0x05, 7):
+		*rd = (rs1 > rs2) ? rs1 : rs2;
+		break;
+	case OP(0x30, 1):
+		*rd = emulate_rol(rs1, rs2);
+		break;
+	case OP(0x30, 5):
+		*rd = emulate_ror(rs1, rs2);
+		break;
+#if __riscv_xlen == 32
+	case OP(0x04, 4):
+		if (INSN_RS2(insn))
+			return SBI_ENOTSUPP;
+		*rd = rs1 & 0xffff;
+		break;
+#endif
+	/* Zbs */
+	case OP(0x24, 1):
+		*rd = rs1 & ~BIT(sh);
+		break;
+	case OP(0x24, 5):
+		*rd = (rs1 >> sh) & 0x1;
+		break;
+	case OP(0x34, 1):
+		*rd = rs1 ^ BIT(sh);
+		break;
+	case OP(0x14, 1):
+		*rd = rs1 | BIT(sh);
+		break;
+	default:
+		return SBI_ENOTSUPP;
+	};
+
+	return 0;
+}
+
+static int emulate_op_imm(ulong insn, ulong rs1, ulong *rd)
+{
+	ulong sh = INSN_SHAMT(insn);
+
+#if __riscv_xlen == 32
+	/* shamt[5] is reserved on RV32 */
+	if (INSN_IMM12(insn) & 0x20)
+		return SBI_ENOTSUPP;
+#endif
+
+	switch (INSN_FUNCT3(insn)) {
+	case 1:
+		switch (INSN_IMM12(insn)) {
+		case IMM12_CLZ:
+			*rd = emulate_clz(rs1, __riscv_xlen);
+			return 0;
+		case IMM12_CTZ:
+			*rd = emulate_ctz(rs1, __riscv_xlen);
+			return 0;
+		case IMM12_CPOP:
+			*rd = emulate_cpop(rs1);
+			return 0;
+		case IMM12_SEXT_B:
+			*rd = (long)(s8)rs1;
+			return 0;
+		case IMM12_SEXT_H:
+			*rd = (long)(s16)rs1;
+			return 0;
+		default:
+			break;
+		};
+
+		switch (INSN_FUNCT6(insn)) {
+		case 0x12:
+			*rd = rs1 & ~BIT(sh);
+			return 0;
+		case 0x1a:
+			*rd = rs1 ^ BIT(sh);
+			return 0;
+		case 0x0a:
+			*rd = rs1 | BIT(sh);
+			return 0;
+		default:
+			break;
+		};
+		break;
+	case 5:
+		switch (INSN_IMM12(insn)) {
+		case IMM12_ORC_B:
+			*rd = emulate_orc_b(rs1);
+			return 0;
+		case IMM12_REV8:
+			*rd = emulate_rev8(rs1);
+			return 0;
+		default:
+			break;
+		};
+
+		switch (INSN_FUNCT6(insn)) {
+		case 0x18:
+			*rd = emulate_ror(rs1, sh);
+			return 0;
+		case 0x12:
+			*rd = (rs1 >> sh) & 0x1;
+			return 0;
+		default:
+			break;
+		};
+		break;
+	default:
+		break;
+	};
+
+	return SBI_ENOTSUPP;
+}
+
+#if __riscv_xlen == 64
+static ulong emulate_rorw(u32 x, ulong sh)
+{
+	sh &= 0x1f;
+
+	return (long)(s32)((x >> sh) | (x << ((32 - sh) & 0x1f)));
+}
+
+static int emulate_op_32(ulong insn, ulong rs1, ulong rs2, ulong *rd)
+{
+	u32 w1 = rs1, sh = rs2 & 0x1f;
+
+	switch (OP(INSN_FUNCT7(insn), INSN_FUNCT3(insn))) {
+	case OP(0x04, 0):
+		*rd = rs2 + (ulong)w1;
+		break;
+	case OP(0x04, 4):
+		if (INSN_RS2(insn))
+			return SBI_ENOTSUPP;
+		*rd = rs1 & 0xffff;
+		break;
+	case OP(0x10, 2):
+		*rd = rs2 + ((ulong)w1 << 1);
+		break;
+	case OP(0x10, 4):
+		*rd = rs2 + ((ulong)w1 << 2);
+		break;
+	case OP(0x10, 6):
+		*rd = rs2 + ((ulong)w1 << 3);
+		break;
+	case OP(0x30, 1):
+		*rd = emulate_rorw(w1, 32 - sh);
+		break;
+	case OP(0x30, 5):
+		*rd = emulate_rorw(w1, sh);
+		break;
+	default:
+		return SBI_ENOTSUPP;
+	};
+
+	return 0;
+}
+
+static int emulate_op_imm_32(ulong insn, ulong rs1, ulong *rd)
+{
+	u32 w1 = rs1, sh = INSN_RS2(insn);
+
+	switch (INSN_FUNCT3(insn)) {
+	case 1:
+		switch (INSN_IMM12(insn)) {
+		case IMM12_CLZ:
+			*rd = emulate_clz(w1, 32);
+			return 0;
+		case IMM12_CTZ:
+			*rd = emulate_ctz(w1, 32);
+			return 0;
+		case IMM12_CPOP:
+			*rd = emulate_cpop(w1);
+			return 0;
+		default:
+			break;
+		};
+
+		if (INSN_FUNCT6(insn) == 0x02) {
+			*rd = (ulong)w1 << INSN_SHAMT(insn);
+			return 0;
+		}
+		break;
+	case 5:
+		if (INSN_FUNCT7(insn) == 0x30) {
+			*rd = emulate_rorw(w1, sh);
+			return 0;
+		}
+		break;
+	default:
+		break;
+	};
+
+	return SBI_ENOTSUPP;
+}
+#endif
+
+/*
+ * Without Zicbom the caches are assumed to be coherent with all other
+ * bus masters, so the cache block operations only have to be ordered
+ * against other memory accesses and fault like a store would.
+ */
+static int emulate_cbo(ulong insn, ulong rs1, struct sbi_trap_info *uptrap)
+{
+	if (INSN_FUNCT3(insn) != 2 || ((insn >> SH_RD) & 0x1f))
+		return SBI_ENOTSUPP;
+
+	switch (INSN_IMM12(insn)) {
+	case CBO_INVAL:
+	case CBO_CLEAN:
+	case CBO_FLUSH:
+		break;
+	default:
+		return SBI_ENOTSUPP;
+	};
+
+	sbi_load_u8((const u8 *)rs1, uptrap);
+	if (uptrap->cause == CAUSE_LOAD_ACCESS)
+		uptrap->cause = CAUSE_STORE_ACCESS;
+	else if (uptrap->cause == CAUSE_LOAD_PAGE_FAULT)
+		uptrap->cause = CAUSE_STORE_PAGE_FAULT;
+	else if (uptrap->cause == CAUSE_LOAD_GUEST_PAGE_FAULT)
+		uptrap->cause = CAUSE_STORE_GUEST_PAGE_FAULT;
+
+	mb();
+
+	return 0;
+}
+
+int sbi_emulate_isa_insn(ulong insn, struct sbi_trap_regs *regs)
+{
+	int rc;
+	ulong rd = 0;
+	struct sbi_trap_info uptrap;
+
+	uptrap.cause = 0;
+	switch (insn & 0x7f) {
+	case OPCODE_OP:
+		rc = emulate_op(insn, GET_RS1(insn, regs), GET_RS2(insn, regs),
+				&rd);
+		break;
+	case OPCODE_OP_IMM:
+		rc = emulate_op_imm(insn, GET_RS1(insn, regs), &rd);
+		break;
+#if __riscv_xlen == 64
+	case OPCODE_OP_32:
+		rc = emulate_op_32(insn, GET_RS1(insn, regs),
+				   GET_RS2(insn, regs), &rd);
+		break;
+	case OPCODE_OP_IMM_32:
+		rc = emulate_op_imm_32(insn, GET_RS1(insn, regs), &rd);
+		break;
+#endif
+	case OPCODE_MISC_MEM:
+		rc = emulate_cbo(insn, GET_RS1(insn, regs), &uptrap);
+		break;
+	default:
+		return SBI_ENOTSUPP;
+	};
+
+	if (rc)
+		return rc;
+
+	if (uptrap.cause) {
+		uptrap.epc = regs->mepc;
+		return sbi_trap_redirect(regs, &uptrap);
+	}
+
+	SET_RD(insn, regs, rd);
+	regs->mepc += 4;
+
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_EMULATED_INSN);
+
+	return 0;
+}
+
+#endif
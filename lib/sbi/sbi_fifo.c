@@ -18,7 +18,7 @@ void sbi_fifo_init(struct sbi_fifo *fifo, void *queue_mem, u16 entries,
 	fifo->queue	  = queue_mem;
 	fifo->num_entries = entries;
 	fifo->entry_size  = entry_size;
-	SPIN_LOCK_INIT(fifo->qlock);
+	QSPIN_LOCK_INIT(fifo->qlock);
 	fifo->avail = fifo->tail = 0;
 	sbi_memset(fifo->queue, 0, (size_t)entries * entry_size);
 }
@@ -36,9 +36,9 @@ u16 sbi_fifo_avail(struct sbi_fifo *fifo)
 	if (!fifo)
 		return 0;
 
-	spin_lock(&fifo->qlock);
+	qspin_lock(&fifo->qlock);
 	ret = fifo->avail;
-	spin_unlock(&fifo->qlock);
+	qspin_unlock(&fifo->qlock);
 
 	return ret;
 }
@@ -47,9 +47,9 @@ bool sbi_fifo_is_full(struct sbi_fifo *fifo)
 {
 	bool ret;
 
-	spin_lock(&fifo->qlock);
+	qspin_lock(&fifo->qlock);
 	ret = __sbi_fifo_is_full(fifo);
-	spin_unlock(&fifo->qlock);
+	qspin_unlock(&fifo->qlock);
 
 	return ret;
 }
@@ -79,9 +79,9 @@ bool sbi_fifo_is_empty(struct sbi_fifo *fifo)
 {
 	bool ret;
 
-	spin_lock(&fifo->qlock);
+	qspin_lock(&fifo->qlock);
 	ret = __sbi_fifo_is_empty(fifo);
-	spin_unlock(&fifo->qlock);
+	qspin_unlock(&fifo->qlock);
 
 	return ret;
 }
@@ -101,9 +101,9 @@ bool sbi_fifo_reset(struct sbi_fifo *fifo)
 	if (!fifo)
 		return FALSE;
 
-	spin_lock(&fifo->qlock);
+	qspin_lock(&fifo->qlock);
 	__sbi_fifo_reset(fifo);
-	spin_unlock(&fifo->qlock);
+	qspin_unlock(&fifo->qlock);
 
 	return TRUE;
 }
@@ -125,10 +125,10 @@ int sbi_fifo_inplace_update(struct sbi_fifo *fifo, void *in,
 	if (!fifo || !in)
 		return ret;
 
-	spin_lock(&fifo->qlock);
+	qspin_lock(&fifo->qlock);
 
 	if (__sbi_fifo_is_empty(fifo)) {
-		spin_unlock(&fifo->qlock);
+		qspin_unlock(&fifo->qlock);
 		return ret;
 	}
 
@@ -143,7 +143,7 @@ int sbi_fifo_inplace_update(struct sbi_fifo *fifo, void *in,
 			break;
 		}
 	}
-	spin_unlock(&fifo->qlock);
+	qspin_unlock(&fifo->qlock);
 
 	return ret;
 }
@@ -153,15 +153,15 @@ int sbi_fifo_enqueue(struct sbi_fifo *fifo, void *data)
 	if (!fifo || !data)
 		return SBI_EINVAL;
 
-	spin_lock(&fifo->qlock);
+	qspin_lock(&fifo->qlock);
 
 	if (__sbi_fifo_is_full(fifo)) {
-		spin_unlock(&fifo->qlock);
+		qspin_unlock(&fifo->qlock);
 		return SBI_ENOSPC;
 	}
 	__sbi_fifo_enqueue(fifo, data);
 
-	spin_unlock(&fifo->qlock);
+	qspin_unlock(&fifo->qlock);
 
 	return 0;
 }
@@ -171,10 +171,10 @@ int sbi_fifo_dequeue(struct sbi_fifo *fifo, void *data)
 	if (!fifo || !data)
 		return SBI_EINVAL;
 
-	spin_lock(&fifo->qlock);
+	qspin_lock(&fifo->qlock);
 
 	if (__sbi_fifo_is_empty(fifo)) {
-		spin_unlock(&fifo->qlock);
+		qspin_unlock(&fifo->qlock);
 		return SBI_ENOENT;
 	}
 
@@ -186,7 +186,44 @@ int sbi_fifo_dequeue(struct sbi_fifo *fifo, void *data)
 	if (fifo->tail >= fifo->num_entries)
 		fifo->tail = 0;
 
-	spin_unlock(&fifo->qlock);
+	qspin_unlock(&fifo->qlock);
 
 	return 0;
 }
+
+/**
+ * Dequeue up to count entries with the lock taken only once.
+ * Returns the number of entries copied to data (zero if empty) or
+ * SBI_EINVAL.
+ */
+int sbi_fifo_dequeue_many(struct sbi_fifo *fifo, void *data, u16 count)
+{
+	u16 first;
+
+	if (!fifo || !data)
+		return SBI_EINVAL;
+
+	qspin_lock(&fifo->qlock);
+
+	if (fifo->avail < count)
+		count = fifo->avail;
+
+	/* Copy up to the end of the queue memory then wrap around */
+	first = fifo->num_entries - fifo->tail;
+	if (count < first)
+		first = count;
+	sbi_memcpy(data, fifo->queue + (u32)fifo->tail * fifo->entry_size,
+		   (u32)first * fifo->entry_size);
+	if (first < count)
+		sbi_memcpy(data + (u32)first * fifo->entry_size, fifo->queue,
+			   (u32)(count - first) * fifo->entry_size);
+
+	fifo->avail -= count;
+	fifo->tail += count;
+	if (fifo->tail >= fifo->num_entries)
+		fifo->tail -= fifo->num_entries;
+
+	qspin_unlock(&fifo->qlock);
+
+	return count;
+}
@@ -11,6 +11,7 @@
 #include <sbi/riscv_barrier.h>
 #include <sbi/riscv_encoding.h>
 #include <sbi/riscv_fp.h>
+#include <sbi/riscv_locks.h>
 #include <sbi/sbi_bitops.h>
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_domain.h>
@@ -19,6 +20,7 @@
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_math.h>
 #include <sbi/sbi_platform.h>
+#include <sbi/sbi_pmp_swap.h>
 #include <sbi/sbi_string.h>
 #include <sbi/sbi_trap.h>
 
@@ -27,15 +29,140 @@ extern void __sbi_expected_trap_hext(void);
 
 void (*sbi_hart_expected_trap)(void) = &__sbi_expected_trap;
 
+/* Max PMP entries in a PMP image */
+#define HART_PMP_IMAGE_MAX	16
+/* PMP entries in each pmpcfg CSR */
+#define HART_PMPCFG_ENTRIES	(__riscv_xlen / 8)
+#define HART_PMPCFG_REGS	(HART_PMP_IMAGE_MAX / HART_PMPCFG_ENTRIES)
+#define HART_PMPCFG_CSR(__i)	(CSR_PMPCFG0 + (__i) * (__riscv_xlen / 32))
+
+/*
+ * PMP CSR values of a domain for given PMP features. These are computed
+ * once per domain by sbi_domain_finalize() using the PMP features of the
+ * coldboot HART, and on the fly for HARTs with different PMP features.
+ */
+struct hart_pmp_image {
+	bool valid;
+	unsigned int pmp_count;
+	unsigned int pmp_addr_bits;
+	unsigned long pmp_gran;
+	unsigned int count;
+	unsigned long addr[HART_PMP_IMAGE_MAX];
+	unsigned long cfg[HART_PMPCFG_REGS];
+};
+static struct hart_pmp_image domain_pmp_image[SBI_DOMAIN_MAX_INDEX];
+
+/*
+ * The hart features are kept across HSM stop/start (and are zeroed
+ * when allocated) so that a HART started again does not have to go
+ * through the trapping CSR probes. The PMP shadow holds the PMP CSR
+ * values last written so that only the changed ones are rewritten.
+ */
 struct hart_features {
+	bool detected;
 	unsigned long features;
 	unsigned int pmp_count;
 	unsigned int pmp_addr_bits;
 	unsigned long pmp_gran;
 	unsigned int mhpm_count;
+	unsigned long vlenb;
+	unsigned long cboz_block_size;
+	int misaligned_perf;
+	bool pmp_shadow_valid;
+	unsigned int pmp_shadow_count;
+	unsigned long pmp_shadow_addr[HART_PMP_IMAGE_MAX];
+	unsigned long pmp_shadow_cfg[HART_PMPCFG_REGS];
+	/* Exceptions delegated to S-mode on request of S-mode */
+	unsigned long medeleg_opt;
 };
 static unsigned long hart_features_offset;
 
+/*
+ * M-mode CSRs programmed by the warm init of a HART, saved before a
+ * non-retentive suspend and replayed on resume instead of redoing the
+ * warm init.
+ */
+struct hart_csr_image {
+	bool valid;
+	unsigned long mstatus;
+	unsigned long mtvec;
+	unsigned long medeleg;
+	unsigned long mideleg;
+	unsigned long mcounteren;
+	unsigned long scounteren;
+	unsigned long mcountinhibit;
+};
+static unsigned long hart_csr_image_offset;
+
+static u64 hart_menvcfg_read(void)
+{
+#if __riscv_xlen == 32
+	return ((u64)csr_read(CSR_MENVCFGH) << 32) | csr_read(CSR_MENVCFG);
+#else
+	return csr_read(CSR_MENVCFG);
+#endif
+}
+
+static void hart_menvcfg_write(u64 val)
+{
+#if __riscv_xlen == 32
+	csr_write(CSR_MENVCFG, (ulong)val);
+	csr_write(CSR_MENVCFGH, (ulong)(val >> 32));
+#else
+	csr_write(CSR_MENVCFG, val);
+#endif
+}
+
+static void menvcfg_init(struct sbi_scratch *scratch)
+{
+	u64 val = 0;
+
+	/* Let supervisor program its timer through the stimecmp CSR */
+	if (sbi_hart_has_feature(scratch, SBI_HART_HAS_SSTC))
+		val |= ENVCFG_STCE;
+
+	/* Let supervisor zero, clean, flush and invalidate cache blocks */
+	if (sbi_hart_has_feature(scratch, SBI_HART_HAS_ZICBOZ))
+		val |= ENVCFG_CBZE;
+	if (sbi_hart_has_feature(scratch, SBI_HART_HAS_ZICBOM))
+		val |= ENVCFG_CBCFE | (ENVCFG_CBIE_INV << ENVCFG_CBIE_SHIFT);
+
+	/* Let supervisor pick memory types in its page tables */
+	if (sbi_hart_has_feature(scratch, SBI_HART_HAS_SVPBMT))
+		val |= ENVCFG_PBMTE;
+
+	if (val)
+		hart_menvcfg_write(hart_menvcfg_read() | val);
+}
+
+static void hcsr_init(struct sbi_scratch *scratch)
+{
+	if (!sbi_hart_has_feature(scratch, SBI_HART_HAS_H))
+		return;
+
+	/*
+	 * Let guests read the time CSR without a trap into HS-mode. The
+	 * hypervisor is free to take it back but gets a working default.
+	 */
+	if (sbi_hart_has_feature(scratch, SBI_HART_HAS_HTIMEDELTA))
+		csr_set(CSR_HCOUNTEREN, COUNTEREN_TM);
+
+	/*
+	 * Let guests program their timer through vstimecmp. It is parked
+	 * at its maximum first so no VS timer interrupt is pending until
+	 * the hypervisor programs a real deadline.
+	 */
+	if (sbi_hart_has_feature(scratch, SBI_HART_HAS_SSTC)) {
+		csr_write(CSR_VSTIMECMP, -1UL);
+#if __riscv_xlen == 32
+		csr_write(CSR_VSTIMECMPH, -1UL);
+		csr_set(CSR_HENVCFGH, ENVCFG_STCE >> 32);
+#else
+		csr_set(CSR_HENVCFG, ENVCFG_STCE);
+#endif
+	}
+}
+
 static void mstatus_init(struct sbi_scratch *scratch)
 {
 	unsigned long mstatus_val = 0;
@@ -57,6 +184,9 @@ static void mstatus_init(struct sbi_scratch *scratch)
 	if (sbi_hart_has_feature(scratch, SBI_HART_HAS_MCOUNTEREN))
 		csr_write(CSR_MCOUNTEREN, -1);
 
+	menvcfg_init(scratch);
+	hcsr_init(scratch);
+
 	/* Disable all interrupts */
 	csr_write(CSR_MIE, 0);
 
@@ -86,9 +216,79 @@ static int fp_init(struct sbi_scratch *scratch)
 	return 0;
 }
 
+/*
+ * Vector instructions are emitted as raw words so that the firmware
+ * does not need a toolchain with the V extension.
+ */
+/* VSETVLI a0, zero, e8, m8, ta, ma */
+#define VSETVLI_A0_X0_E8M8	".word 0x0c307557"
+/* VMV.V.I vd, 0 */
+#define VMV_V_I_0(vreg)		".word " STR(0x5e003057 | ((vreg) << 7))
+/* VSETVL zero, a0, a1 */
+#define VSETVL_X0_A0_A1		".word " STR(0x80007057 | (11 << 20) | (10 << 15))
+
+static int vector_init(struct sbi_scratch *scratch)
+{
+	struct hart_features *hfeatures =
+			sbi_scratch_offset_ptr(scratch, hart_features_offset);
+	register ulong a0 asm("a0");
+	register ulong a1 asm("a1");
+
+	if (!misa_extension('V'))
+		return 0;
+
+	if (!(csr_read(CSR_MSTATUS) & MSTATUS_VS))
+		return SBI_EINVAL;
+
+	hfeatures->vlenb = csr_read(CSR_VLENB);
+
+	/* Clear all 32 registers as four groups of eight */
+	asm volatile(VSETVLI_A0_X0_E8M8 "\n"
+		     VMV_V_I_0(0) "\n"
+		     VMV_V_I_0(8) "\n"
+		     VMV_V_I_0(16) "\n"
+		     VMV_V_I_0(24)
+		     : "=r"(a0) : : "memory");
+
+	/* Leave a valid vtype with vl = 0 instead of vill set */
+	a0 = 0;
+	a1 = 0xc3;
+	asm volatile(VSETVL_X0_A0_A1 : : "r"(a0), "r"(a1));
+	csr_write(CSR_VSTART, 0);
+	csr_write(CSR_VCSR, 0);
+
+	return 0;
+}
+
+bool sbi_hart_features_detected(struct sbi_scratch *scratch)
+{
+	struct hart_features *hfeatures =
+			sbi_scratch_offset_ptr(scratch, hart_features_offset);
+
+	return hfeatures->detected;
+}
+
+unsigned long sbi_hart_vlenb(struct sbi_scratch *scratch)
+{
+	struct hart_features *hfeatures =
+			sbi_scratch_offset_ptr(scratch, hart_features_offset);
+
+	return hfeatures->vlenb;
+}
+
+unsigned long sbi_hart_cboz_block_size(struct sbi_scratch *scratch)
+{
+	struct hart_features *hfeatures =
+			sbi_scratch_offset_ptr(scratch, hart_features_offset);
+
+	return hfeatures->cboz_block_size;
+}
+
 static int delegate_traps(struct sbi_scratch *scratch)
 {
 	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
+	struct hart_features *hfeatures =
+			sbi_scratch_offset_ptr(scratch, hart_features_offset);
 	unsigned long interrupts, exceptions;
 
 	if (!misa_extension('S'))
@@ -119,12 +319,53 @@ static int delegate_traps(struct sbi_scratch *scratch)
 		exceptions |= (1U << CAUSE_STORE_GUEST_PAGE_FAULT);
 	}
 
+	/* Send counter overflow interrupts to S-mode for perf sampling */
+	if (sbi_hart_has_feature(scratch, SBI_HART_HAS_SSCOFPMF))
+		interrupts |= MIP_LCOFIP;
+
+	/* Kept across HSM stop/start and suspend of the HART */
+	exceptions |= hfeatures->medeleg_opt;
+
 	csr_write(CSR_MIDELEG, interrupts);
 	csr_write(CSR_MEDELEG, exceptions);
 
 	return 0;
 }
 
+#define HART_MISALIGNED_DELEG \
+	((1UL << CAUSE_MISALIGNED_LOAD) | (1UL << CAUSE_MISALIGNED_STORE))
+
+/**
+ * Let S-mode handle misaligned load/store traps of current HART instead
+ * of emulating the access in M-mode.
+ */
+int sbi_hart_misaligned_deleg_set(struct sbi_scratch *scratch, bool enable)
+{
+	struct hart_features *hfeatures =
+			sbi_scratch_offset_ptr(scratch, hart_features_offset);
+
+	if (!misa_extension('S'))
+		return SBI_ENOTSUPP;
+
+	if (enable) {
+		hfeatures->medeleg_opt |= HART_MISALIGNED_DELEG;
+		csr_set(CSR_MEDELEG, HART_MISALIGNED_DELEG);
+	} else {
+		hfeatures->medeleg_opt &= ~HART_MISALIGNED_DELEG;
+		csr_clear(CSR_MEDELEG, HART_MISALIGNED_DELEG);
+	}
+
+	return 0;
+}
+
+bool sbi_hart_misaligned_deleg_get(struct sbi_scratch *scratch)
+{
+	struct hart_features *hfeatures =
+			sbi_scratch_offset_ptr(scratch, hart_features_offset);
+
+	return (hfeatures->medeleg_opt & HART_MISALIGNED_DELEG) ? TRUE : FALSE;
+}
+
 void sbi_hart_delegation_dump(struct sbi_scratch *scratch,
 			      const char *prefix, const char *suffix)
 {
@@ -153,6 +394,29 @@ unsigned int sbi_hart_mhpm_count(struct sbi_scratch *scratch)
 	return hfeatures->mhpm_count;
 }
 
+int sbi_hart_misaligned_perf(struct sbi_scratch *scratch)
+{
+	struct hart_features *hfeatures =
+			sbi_scratch_offset_ptr(scratch, hart_features_offset);
+
+	return hfeatures->misaligned_perf;
+}
+
+/** Names used by the riscv,misaligned-access-performance DT property */
+const char *sbi_hart_misaligned_perf2string(int perf)
+{
+	switch (perf) {
+	case SBI_HART_MISALIGNED_EMULATED:
+		return "emulated";
+	case SBI_HART_MISALIGNED_SLOW:
+		return "slow";
+	case SBI_HART_MISALIGNED_FAST:
+		return "fast";
+	default:
+		return NULL;
+	}
+}
+
 unsigned int sbi_hart_pmp_count(struct sbi_scratch *scratch)
 {
 	struct hart_features *hfeatures =
@@ -177,44 +441,380 @@ unsigned int sbi_hart_pmp_addrbits(struct sbi_scratch *scratch)
 	return hfeatures->pmp_addr_bits;
 }
 
-int sbi_hart_pmp_configure(struct sbi_scratch *scratch)
+static unsigned long hart_pmp_napot_addr(unsigned long base,
+					 unsigned long order)
 {
-	struct sbi_domain_memregion *reg;
-	struct sbi_domain *dom = sbi_domain_thishart_ptr();
-	unsigned int pmp_idx = 0, pmp_flags, pmp_bits, pmp_gran_log2;
-	unsigned int pmp_count = sbi_hart_pmp_count(scratch);
-	unsigned long pmp_addr = 0, pmp_addr_max = 0;
+	unsigned long addrmask;
+
+	if (order == PMP_SHIFT)
+		return base >> PMP_SHIFT;
+	if (order == __riscv_xlen)
+		return -1UL;
+
+	addrmask = (1UL << (order - PMP_SHIFT)) - 1;
+	return ((base >> PMP_SHIFT) & ~addrmask) | (addrmask >> 1);
+}
 
-	if (!pmp_count)
+static unsigned long hart_pmp_prot(unsigned long flags)
+{
+	unsigned long prot = 0;
+
+	if (flags & SBI_DOMAIN_MEMREGION_READABLE)
+		prot |= PMP_R;
+	if (flags & SBI_DOMAIN_MEMREGION_WRITEABLE)
+		prot |= PMP_W;
+	if (flags & SBI_DOMAIN_MEMREGION_EXECUTABLE)
+		prot |= PMP_X;
+	if (flags & SBI_DOMAIN_MEMREGION_MMODE)
+		prot |= PMP_L;
+
+	return prot;
+}
+
+/* End of a memory region or zero if it extends to the end of memory */
+static unsigned long hart_pmp_region_end(const struct sbi_domain_memregion *reg)
+{
+	if (reg->order >= __riscv_xlen)
 		return 0;
 
+	return reg->base + (1UL << reg->order);
+}
+
+typedef void (*hart_pmp_set_fn)(void *priv, unsigned int n,
+				unsigned long prot, unsigned long addr);
+
+/*
+ * Allocate PMP entries for the memory regions of a domain (in priority
+ * order) and program them using the set() callback.
+ *
+ * Runs of regions which are next to each other in the sorted region
+ * list, contiguous in memory and have the same permissions are merged.
+ * A run is covered by a single NAPOT entry when its union is naturally
+ * aligned and otherwise by a TOR range when that takes fewer entries
+ * than one NAPOT entry per region. A TOR range takes one entry when it
+ * starts at zero or where the previous TOR range ended and two entries
+ * otherwise (the first one, disabled, only holds the base address).
+ *
+ * Locked (M-mode) regions are never merged because a locked TOR entry
+ * also locks the address register of the entry before it, which would
+ * keep the next domain from reprogramming that entry.
+ *
+ * Regions after the first one which does not fit are not programmed
+ * (an S-mode region mapped without the smaller regions before it could
+ * grant access to them) and are reported when report is TRUE.
+ * Regions which the HART can't protect at all are always reported.
+ *
+ * Regions swapped in on access faults are skipped when swap is TRUE.
+ */
+static int hart_pmp_allocate(struct sbi_scratch *scratch,
+			     const struct sbi_domain *dom, unsigned int max,
+			     bool report, bool swap, hart_pmp_set_fn set,
+			     void *priv, unsigned int *out_count)
+{
+	struct sbi_domain_memregion *reg, *next;
+	unsigned int i, idx = 0, cnt, tor_cost, pmp_bits, pmp_gran_log2;
+	unsigned long prot, start, end, rend, size, pmp_addr_max;
+	unsigned long tor_top = 0;
+	bool tor_last = FALSE;
+	int rc = 0;
+
 	pmp_gran_log2 = log2roundup(sbi_hart_pmp_granularity(scratch));
 	pmp_bits = sbi_hart_pmp_addrbits(scratch) - 1;
 	pmp_addr_max = (1UL << pmp_bits) | ((1UL << pmp_bits) - 1);
 
-	sbi_domain_for_each_memregion(dom, reg) {
-		if (pmp_count <= pmp_idx)
-			break;
-
-		pmp_flags = 0;
-		if (reg->flags & SBI_DOMAIN_MEMREGION_READABLE)
-			pmp_flags |= PMP_R;
-		if (reg->flags & SBI_DOMAIN_MEMREGION_WRITEABLE)
-			pmp_flags |= PMP_W;
-		if (reg->flags & SBI_DOMAIN_MEMREGION_EXECUTABLE)
-			pmp_flags |= PMP_X;
-		if (reg->flags & SBI_DOMAIN_MEMREGION_MMODE)
-			pmp_flags |= PMP_L;
-
-		pmp_addr =  reg->base >> PMP_SHIFT;
-		if (pmp_gran_log2 <= reg->order && pmp_addr < pmp_addr_max)
-			pmp_set(pmp_idx++, pmp_flags, reg->base, reg->order);
-		else {
+	reg = dom->regions;
+	while (reg && reg->order) {
+		if (swap && sbi_pmp_swap_region(dom, reg)) {
+			reg++;
+			continue;
+		}
+
+		if (reg->order < pmp_gran_log2 ||
+		    pmp_addr_max <= (reg->base >> PMP_SHIFT)) {
 			sbi_printf("Can not configure pmp for domain %s", dom->name);
 			sbi_printf("because memory region address %lx or size %lx is not in range\n",
 				    reg->base, reg->order);
+			reg++;
+			continue;
 		}
+
+		/* Collect the run of regions starting at this one */
+		start = reg->base;
+		end = hart_pmp_region_end(reg);
+		cnt = 1;
+		next = reg + 1;
+		while (end && next->order &&
+		       !(reg->flags & SBI_DOMAIN_MEMREGION_MMODE) &&
+		       (next->flags & SBI_DOMAIN_MEMREGION_ACCESS_MASK) ==
+		       (reg->flags & SBI_DOMAIN_MEMREGION_ACCESS_MASK) &&
+		       pmp_gran_log2 <= next->order &&
+		       (next->base >> PMP_SHIFT) < pmp_addr_max &&
+		       !(swap && sbi_pmp_swap_region(dom, next))) {
+			rend = hart_pmp_region_end(next);
+			if (!rend)
+				break;
+			if (next->base == end)
+				end = rend;
+			else if (rend == start)
+				start = next->base;
+			else
+				break;
+			cnt++;
+			next++;
+		}
+
+		prot = hart_pmp_prot(reg->flags);
+		size = end - start;
+		tor_cost = ((!idx && !start) ||
+			    (tor_last && tor_top == (start >> PMP_SHIFT))) ?
+			    1 : 2;
+
+		if (1 < cnt && !(size & (size - 1)) && !(start & (size - 1))) {
+			/* The whole run is naturally aligned */
+			if (max <= idx)
+				break;
+			set(priv, idx++, prot | PMP_A_NAPOT,
+			    hart_pmp_napot_addr(start, log2roundup(size)));
+			tor_last = FALSE;
+		} else if (tor_cost < cnt &&
+			   (end >> PMP_SHIFT) <= pmp_addr_max) {
+			if (max < idx + tor_cost)
+				break;
+			if (tor_cost == 2)
+				set(priv, idx++, 0, start >> PMP_SHIFT);
+			tor_top = end >> PMP_SHIFT;
+			set(priv, idx++, prot | PMP_A_TOR, tor_top);
+			tor_last = TRUE;
+		} else {
+			for (i = 0; i < cnt; i++) {
+				if (max <= idx)
+					break;
+				set(priv, idx++, prot |
+				    ((reg[i].order == PMP_SHIFT) ?
+				     PMP_A_NA4 : PMP_A_NAPOT),
+				    hart_pmp_napot_addr(reg[i].base,
+							reg[i].order));
+			}
+			tor_last = FALSE;
+			if (i < cnt) {
+				reg += i;
+				break;
+			}
+		}
+
+		reg = next;
+	}
+
+	if (reg && reg->order) {
+		rc = SBI_ENOSPC;
+		for (; report && reg->order; reg++)
+			sbi_printf("%s: domain %s region base=0x%lx "
+				   "order=%lu flags=0x%lx does not fit in "
+				   "%u PMP entries\n", __func__, dom->name,
+				   reg->base, reg->order, reg->flags, max);
+	}
+
+	if (out_count)
+		*out_count = idx;
+
+	return rc;
+}
+
+static void hart_pmp_set_image(void *priv, unsigned int n,
+			       unsigned long prot, unsigned long addr)
+{
+	struct hart_pmp_image *img = priv;
+
+	img->addr[n] = addr;
+	img->cfg[n / HART_PMPCFG_ENTRIES] |=
+		prot << ((n % HART_PMPCFG_ENTRIES) * 8);
+}
+
+static int hart_pmp_image_compute(struct sbi_scratch *scratch,
+				  const struct sbi_domain *dom,
+				  struct hart_pmp_image *img)
+{
+	int rc;
+	unsigned int max;
+	bool swap = sbi_pmp_swap_enabled(dom);
+
+	sbi_memset(img, 0, sizeof(*img));
+	img->pmp_count = sbi_hart_pmp_count(scratch);
+	img->pmp_addr_bits = sbi_hart_pmp_addrbits(scratch);
+	img->pmp_gran = sbi_hart_pmp_granularity(scratch);
+	if (!img->pmp_count)
+		return SBI_ENOTSUPP;
+
+	/*
+	 * Regions not fitting the image are left to the direct path which
+	 * also swaps regions in when the domain asks for it.
+	 */
+	max = (img->pmp_count < HART_PMP_IMAGE_MAX) ?
+	      img->pmp_count : HART_PMP_IMAGE_MAX;
+	rc = hart_pmp_allocate(scratch, dom, max,
+			       !swap && max == img->pmp_count, FALSE,
+			       hart_pmp_set_image, img, &img->count);
+	if (rc && (swap || max < img->pmp_count))
+		return rc;
+
+	img->valid = TRUE;
+
+	return 0;
+}
+
+static bool hart_pmp_image_usable(struct sbi_scratch *scratch,
+				  const struct hart_pmp_image *img)
+{
+	return (img->valid &&
+		img->pmp_count == sbi_hart_pmp_count(scratch) &&
+		img->pmp_addr_bits == sbi_hart_pmp_addrbits(scratch) &&
+		img->pmp_gran == sbi_hart_pmp_granularity(scratch)) ?
+		TRUE : FALSE;
+}
+
+static void hart_pmp_set_csr(void *priv, unsigned int n,
+			     unsigned long prot, unsigned long addr)
+{
+	unsigned int csr = HART_PMPCFG_CSR(n / HART_PMPCFG_ENTRIES);
+	unsigned int shift = (n % HART_PMPCFG_ENTRIES) * 8;
+
+	csr_write_num(CSR_PMPADDR0 + n, addr);
+	csr_write_num(csr, (csr_read_num(csr) & ~(0xffUL << shift)) |
+			   (prot << shift));
+}
+
+static void hart_pmp_disable(unsigned int n)
+{
+	unsigned int csr = HART_PMPCFG_CSR(n / HART_PMPCFG_ENTRIES);
+	unsigned int shift = (n % HART_PMPCFG_ENTRIES) * 8;
+
+	csr_write_num(csr, csr_read_num(csr) & ~(0xffUL << shift));
+}
+
+/* Write a PMP image skipping the CSRs which already hold their value */
+static void hart_pmp_image_write(struct hart_features *hfeatures,
+				 const struct hart_pmp_image *img)
+{
+	unsigned int i, count;
+	bool all = !hfeatures->pmp_shadow_valid;
+
+	for (i = 0; i < img->count; i++) {
+		if (!all && hfeatures->pmp_shadow_addr[i] == img->addr[i])
+			continue;
+		csr_write_num(CSR_PMPADDR0 + i, img->addr[i]);
+		hfeatures->pmp_shadow_addr[i] = img->addr[i];
+	}
+
+	/*
+	 * Entries of the previous image beyond this one are disabled. When
+	 * nothing is known about the PMP CSRs all entries are disabled.
+	 */
+	count = (all) ? img->pmp_count : img->count;
+	if (count < hfeatures->pmp_shadow_count)
+		count = hfeatures->pmp_shadow_count;
+	for (i = 0; i < HART_PMPCFG_REGS &&
+		    i * HART_PMPCFG_ENTRIES < count; i++) {
+		if (!all && hfeatures->pmp_shadow_cfg[i] == img->cfg[i])
+			continue;
+		csr_write_num(HART_PMPCFG_CSR(i), img->cfg[i]);
+		hfeatures->pmp_shadow_cfg[i] = img->cfg[i];
 	}
+	for (i = HART_PMP_IMAGE_MAX; all && i < count; i++)
+		hart_pmp_disable(i);
+
+	hfeatures->pmp_shadow_count = img->count;
+	hfeatures->pmp_shadow_valid = TRUE;
+}
+
+/* Program PMP entries of a domain not fitting in a PMP image */
+static int hart_pmp_configure_direct(struct sbi_scratch *scratch,
+				     struct hart_features *hfeatures,
+				     const struct sbi_domain *dom)
+{
+	unsigned int i, count = 0;
+	bool swap = sbi_pmp_swap_enabled(dom);
+
+	hart_pmp_allocate(scratch, dom, sbi_hart_pmp_count(scratch), TRUE,
+			  swap, hart_pmp_set_csr, NULL, &count);
+
+	/* Entries of the previous domain beyond ours are disabled */
+	for (i = count; i < hfeatures->pmp_shadow_count; i++)
+		hart_pmp_disable(i);
+
+	/* The remaining entries are used for regions swapped in later */
+	if (swap)
+		count += sbi_pmp_swap_configure(scratch, dom, count);
+
+	/*
+	 * Nothing is known about the PMP CSRs afterwards except for the
+	 * number of entries which have to be disabled by the next image.
+	 */
+	hfeatures->pmp_shadow_valid = FALSE;
+	hfeatures->pmp_shadow_count = count;
+
+	return 0;
+}
+
+int sbi_hart_pmp_set_region(struct sbi_scratch *scratch, unsigned int n,
+			    const struct sbi_domain_memregion *reg)
+{
+	unsigned long pmp_addr_max;
+	unsigned int pmp_bits;
+
+	if (sbi_hart_pmp_count(scratch) <= n)
+		return SBI_EINVAL;
+
+	if (!reg) {
+		hart_pmp_disable(n);
+		return 0;
+	}
+
+	pmp_bits = sbi_hart_pmp_addrbits(scratch) - 1;
+	pmp_addr_max = (1UL << pmp_bits) | ((1UL << pmp_bits) - 1);
+	if (reg->order < log2roundup(sbi_hart_pmp_granularity(scratch)) ||
+	    pmp_addr_max <= (reg->base >> PMP_SHIFT))
+		return SBI_EINVAL;
+
+	hart_pmp_set_csr(NULL, n, hart_pmp_prot(reg->flags) |
+			 ((reg->order == PMP_SHIFT) ? PMP_A_NA4 : PMP_A_NAPOT),
+			 hart_pmp_napot_addr(reg->base, reg->order));
+
+	return 0;
+}
+
+int sbi_hart_pmp_image_build(struct sbi_scratch *scratch,
+			     const struct sbi_domain *dom)
+{
+	if (!dom || SBI_DOMAIN_MAX_INDEX <= dom->index)
+		return SBI_EINVAL;
+
+	return hart_pmp_image_compute(scratch, dom,
+				      &domain_pmp_image[dom->index]);
+}
+
+int sbi_hart_pmp_configure(struct sbi_scratch *scratch)
+{
+	struct hart_features *hfeatures =
+			sbi_scratch_offset_ptr(scratch, hart_features_offset);
+	struct sbi_domain *dom = sbi_domain_thishart_ptr();
+	const struct hart_pmp_image *img = NULL;
+	struct hart_pmp_image timg;
+
+	if (!sbi_hart_pmp_count(scratch))
+		return 0;
+
+	if (dom->index < SBI_DOMAIN_MAX_INDEX &&
+	    sbi_index_to_domain(dom->index) == dom)
+		img = &domain_pmp_image[dom->index];
+	if (!img || !hart_pmp_image_usable(scratch, img)) {
+		if (hart_pmp_image_compute(scratch, dom, &timg))
+			return hart_pmp_configure_direct(scratch, hfeatures,
+							 dom);
+		img = &timg;
+	}
+
+	hart_pmp_image_write(hfeatures, img);
+	sbi_pmp_swap_configure(scratch, NULL, 0);
 
 	return 0;
 }
@@ -228,9 +828,13 @@ int sbi_hart_pmp_configure(struct sbi_scratch *scratch)
  */
 bool sbi_hart_has_feature(struct sbi_scratch *scratch, unsigned long feature)
 {
-	struct hart_features *hfeatures =
-			sbi_scratch_offset_ptr(scratch, hart_features_offset);
+	struct hart_features *hfeatures;
 
+	/* Nothing is detected before sbi_hart_init() on the coldboot HART */
+	if (!hart_features_offset)
+		return false;
+
+	hfeatures = sbi_scratch_offset_ptr(scratch, hart_features_offset);
 	if (hfeatures->features & feature)
 		return true;
 	else
@@ -262,6 +866,39 @@ static inline char *sbi_hart_feature_id2string(unsigned long feature)
 	case SBI_HART_HAS_TIME:
 		fstr = "time";
 		break;
+	case SBI_HART_HAS_SVINVAL:
+		fstr = "svinval";
+		break;
+	case SBI_HART_HAS_MCOUNTINHIBIT:
+		fstr = "mcountinhibit";
+		break;
+	case SBI_HART_HAS_SSCOFPMF:
+		fstr = "sscofpmf";
+		break;
+	case SBI_HART_HAS_ZAWRS:
+		fstr = "zawrs";
+		break;
+	case SBI_HART_HAS_ZACAS:
+		fstr = "zacas";
+		break;
+	case SBI_HART_HAS_H:
+		fstr = "h";
+		break;
+	case SBI_HART_HAS_SSTC:
+		fstr = "sstc";
+		break;
+	case SBI_HART_HAS_HTIMEDELTA:
+		fstr = "htimedelta";
+		break;
+	case SBI_HART_HAS_ZICBOZ:
+		fstr = "zicboz";
+		break;
+	case SBI_HART_HAS_ZICBOM:
+		fstr = "zicbom";
+		break;
+	case SBI_HART_HAS_SVPBMT:
+		fstr = "svpbmt";
+		break;
 	default:
 		break;
 	}
@@ -327,15 +964,254 @@ static unsigned long hart_pmp_get_allowed_addr(void)
 	return val;
 }
 
+static bool hart_svinval_allowed(struct sbi_trap_info *trap)
+{
+	register ulong tinfo asm("a3") = (ulong)trap;
+	register ulong ttmp asm("a4");
+	register ulong mtvec = sbi_hart_expected_trap_addr();
+
+	trap->cause = 0;
+	asm volatile(
+		"add %[ttmp], %[tinfo], zero\n"
+		"csrrw %[mtvec], " STR(CSR_MTVEC) ", %[mtvec]\n"
+		/* SFENCE.W.INVAL */
+		".word 0x18000073\n"
+		"csrw " STR(CSR_MTVEC) ", %[mtvec]"
+	    : [mtvec] "+&r"(mtvec), [tinfo] "+&r"(tinfo), [ttmp] "+&r"(ttmp)
+	    :
+	    : "memory");
+
+	return (trap->cause) ? FALSE : TRUE;
+}
+
+static bool hart_zawrs_allowed(struct sbi_trap_info *trap)
+{
+	register ulong tinfo asm("a3") = (ulong)trap;
+	register ulong ttmp asm("a4");
+	register ulong mtvec = sbi_hart_expected_trap_addr();
+
+	trap->cause = 0;
+	asm volatile(
+		"add %[ttmp], %[tinfo], zero\n"
+		"csrrw %[mtvec], " STR(CSR_MTVEC) ", %[mtvec]\n"
+		/* WRS.STO (returns at once without a reservation set) */
+		".word 0x01d00073\n"
+		"csrw " STR(CSR_MTVEC) ", %[mtvec]"
+	    : [mtvec] "+&r"(mtvec), [tinfo] "+&r"(tinfo), [ttmp] "+&r"(ttmp)
+	    :
+	    : "memory");
+
+	return (trap->cause) ? FALSE : TRUE;
+}
+
+static bool hart_zacas_allowed(struct sbi_trap_info *trap)
+{
+	unsigned long buf[2] __aligned(2 * sizeof(unsigned long)) = { 0, 0 };
+	register ulong tinfo asm("a3") = (ulong)trap;
+	register ulong ttmp asm("a4");
+	register ulong r0 asm("a0") = 0;
+	register ulong r1 asm("a1") = 0;
+	register ulong n0 asm("a6") = 0;
+	register ulong n1 asm("a7") = 0;
+	register ulong addr asm("a5") = (ulong)buf;
+	register ulong mtvec = sbi_hart_expected_trap_addr();
+
+	trap->cause = 0;
+	asm volatile(
+		"add %[ttmp], %[tinfo], zero\n"
+		"csrrw %[mtvec], " STR(CSR_MTVEC) ", %[mtvec]\n"
+#if __riscv_xlen == 64
+		/* AMOCAS.Q.AQRL a0, a6, (a5) */
+		".word 0x2f07c52f\n"
+#else
+		/* AMOCAS.D.AQRL a0, a6, (a5) */
+		".word 0x2f07b52f\n"
+#endif
+		"csrw " STR(CSR_MTVEC) ", %[mtvec]"
+	    : [mtvec] "+&r"(mtvec), [tinfo] "+&r"(tinfo), [ttmp] "+&r"(ttmp),
+	      "+r"(r0), "+r"(r1)
+	    : "r"(n0), "r"(n1), "r"(addr)
+	    : "memory");
+
+	return (trap->cause) ? FALSE : TRUE;
+}
+
+static bool hart_misaligned_load_allowed(struct sbi_trap_info *trap,
+					 const void *ptr)
+{
+	register ulong tinfo asm("a3") = (ulong)trap;
+	register ulong ttmp asm("a4");
+	register ulong val asm("a5");
+	register ulong mtvec = sbi_hart_expected_trap_addr();
+
+	trap->cause = 0;
+	asm volatile(
+		"add %[ttmp], %[tinfo], zero\n"
+		"csrrw %[mtvec], " STR(CSR_MTVEC) ", %[mtvec]\n"
+		"lw %[val], 0(%[ptr])\n"
+		"csrw " STR(CSR_MTVEC) ", %[mtvec]"
+	    : [mtvec] "+&r"(mtvec), [tinfo] "+&r"(tinfo), [ttmp] "+&r"(ttmp),
+	      [val] "=&r"(val)
+	    : [ptr] "r"(ptr)
+	    : "memory");
+
+	return (trap->cause) ? FALSE : TRUE;
+}
+
+#define HART_MISALIGNED_LOADS	64
+
+static unsigned long hart_load_cycles(const void *ptr)
+{
+	unsigned long i, val, start = csr_read(CSR_MCYCLE);
+
+	for (i = 0; i < HART_MISALIGNED_LOADS; i++)
+		asm volatile("lw %0, 0(%1)" : "=r"(val) : "r"(ptr) : "memory");
+
+	return csr_read(CSR_MCYCLE) - start;
+}
+
+/*
+ * Time misaligned word loads against aligned ones. Misaligned accesses
+ * which trap are emulated for S-mode at a cost of hundreds of cycles.
+ */
+static int hart_misaligned_perf_probe(struct sbi_scratch *scratch,
+				      struct sbi_trap_info *trap)
+{
+	u32 buf[4] __aligned(16) = { 0 };
+	unsigned long aligned, misaligned, inhibit = 0;
+	const void *ptr = (const u8 *)buf + 1;
+
+	if (!hart_misaligned_load_allowed(trap, ptr))
+		return SBI_HART_MISALIGNED_EMULATED;
+
+	/* The cycle counter may be inhibited until the PMU is set up */
+	if (hart_get_features(scratch) & SBI_HART_HAS_MCOUNTINHIBIT)
+		inhibit = csr_read_clear(CSR_MCOUNTINHIBIT, 0x1);
+
+	/* First round warms up the cache lines and branch predictors */
+	hart_load_cycles(buf);
+	hart_load_cycles(ptr);
+	aligned = hart_load_cycles(buf);
+	misaligned = hart_load_cycles(ptr);
+
+	if (hart_get_features(scratch) & SBI_HART_HAS_MCOUNTINHIBIT)
+		csr_write(CSR_MCOUNTINHIBIT, inhibit);
+
+	if (!aligned)
+		return SBI_HART_MISALIGNED_UNKNOWN;
+
+	/* A misaligned word touches at most two aligned words */
+	return (misaligned <= 2 * aligned) ? SBI_HART_MISALIGNED_FAST :
+					     SBI_HART_MISALIGNED_SLOW;
+}
+
+/*
+ * Buffer zeroed by a CBO.ZERO in its middle, block sizes up to a page
+ * (the most supervisor software copes with) stay within the buffer.
+ */
+static u8 hart_cboz_buf[PAGE_SIZE] __aligned(PAGE_SIZE);
+static spinlock_t hart_cboz_lock = SPIN_LOCK_INITIALIZER;
+
+static unsigned long hart_cboz_block_size_probe(struct sbi_trap_info *trap)
+{
+	register ulong tinfo asm("a3") = (ulong)trap;
+	register ulong ttmp asm("a4");
+	register ulong addr asm("a5") = (ulong)&hart_cboz_buf[PAGE_SIZE / 2];
+	register ulong mtvec = sbi_hart_expected_trap_addr();
+	unsigned long i, size = 0;
+
+	spin_lock(&hart_cboz_lock);
+
+	sbi_memset(hart_cboz_buf, 0xff, sizeof(hart_cboz_buf));
+	trap->cause = 0;
+	asm volatile(
+		"add %[ttmp], %[tinfo], zero\n"
+		"csrrw %[mtvec], " STR(CSR_MTVEC) ", %[mtvec]\n"
+		/* CBO.ZERO (a5) */
+		".word 0x0047a00f\n"
+		"csrw " STR(CSR_MTVEC) ", %[mtvec]"
+	    : [mtvec] "+&r"(mtvec), [tinfo] "+&r"(tinfo), [ttmp] "+&r"(ttmp)
+	    : "r"(addr)
+	    : "memory");
+
+	if (!trap->cause) {
+		for (i = 0; i < sizeof(hart_cboz_buf); i++)
+			if (!hart_cboz_buf[i])
+				size++;
+	}
+
+	spin_unlock(&hart_cboz_lock);
+
+	/* A whole zeroed buffer means the block may be even larger */
+	if (size & (size - 1) || size == sizeof(hart_cboz_buf))
+		return 0;
+
+	return size;
+}
+
+/*
+ * Detect extensions enabled for S-mode through menvcfg. The enable bits
+ * are WARL and read back as zero when the extension is not implemented.
+ */
+static unsigned long hart_menvcfg_features(struct sbi_trap_info *trap)
+{
+	unsigned long features = 0;
+	u64 val;
+
+	if (!misa_extension('S'))
+		return 0;
+
+	csr_read_allowed(CSR_MENVCFG, (unsigned long)trap);
+	if (trap->cause)
+		return 0;
+
+	val = hart_menvcfg_read();
+	hart_menvcfg_write(val | ENVCFG_CBZE | ENVCFG_CBCFE | ENVCFG_PBMTE);
+	if (hart_menvcfg_read() & ENVCFG_CBZE)
+		features |= SBI_HART_HAS_ZICBOZ;
+	if (hart_menvcfg_read() & ENVCFG_CBCFE)
+		features |= SBI_HART_HAS_ZICBOM;
+	if (hart_menvcfg_read() & ENVCFG_PBMTE)
+		features |= SBI_HART_HAS_SVPBMT;
+	hart_menvcfg_write(val);
+
+	return features;
+}
+
+#define HART_MENVCFG_FEATURES	(SBI_HART_HAS_ZICBOZ | SBI_HART_HAS_ZICBOM | \
+				 SBI_HART_HAS_SVPBMT)
+
+/* Features which a platform may describe instead of having them probed */
+#if __riscv_xlen == 64
+#define HART_DESC_FEATURES	(SBI_HART_HAS_SVINVAL | SBI_HART_HAS_ZAWRS | \
+				 SBI_HART_HAS_ZACAS | SBI_HART_HAS_SSTC | \
+				 SBI_HART_HAS_SSCOFPMF | HART_MENVCFG_FEATURES)
+#else
+#define HART_DESC_FEATURES	(SBI_HART_HAS_SVINVAL | SBI_HART_HAS_ZAWRS | \
+				 SBI_HART_HAS_ZACAS | SBI_HART_HAS_SSTC | \
+				 HART_MENVCFG_FEATURES)
+#endif
+
 static void hart_detect_features(struct sbi_scratch *scratch)
 {
 	struct sbi_trap_info trap = {0};
+	struct sbi_hart_desc desc = {0};
 	struct hart_features *hfeatures;
-	unsigned long val;
+	unsigned long val, known;
 
-	/* Reset hart features */
+	/* Features detected when the HART was first started still hold */
 	hfeatures = sbi_scratch_offset_ptr(scratch, hart_features_offset);
-	hfeatures->features = 0;
+	if (hfeatures->detected)
+		return;
+
+	/* Values described by the platform need not be probed */
+	if (sbi_platform_hart_desc(sbi_platform_ptr(scratch),
+				   scratch->hartid, &desc))
+		sbi_memset(&desc, 0, sizeof(desc));
+	known = desc.features_known & HART_DESC_FEATURES;
+
+	/* Reset hart features */
+	hfeatures->features = desc.features & known;
 	hfeatures->pmp_count = 0;
 	hfeatures->mhpm_count = 0;
 
@@ -385,12 +1261,22 @@ static void hart_detect_features(struct sbi_scratch *scratch)
 	if (val) {
 		hfeatures->pmp_gran =  1 << (__ffs(val) + 2);
 		hfeatures->pmp_addr_bits = __fls(val) + 1;
+		if (desc.valid & SBI_HART_DESC_PMP_COUNT) {
+			hfeatures->pmp_count = (desc.pmp_count < PMP_COUNT) ?
+					       desc.pmp_count : PMP_COUNT;
+			goto __pmp_skip;
+		}
 		/* Detect number of PMP regions. At least PMPADDR0 should be implemented*/
 		__check_csr_64(CSR_PMPADDR0, 0, val, pmp_count, __pmp_skip);
 	}
 __pmp_skip:
 
-	/* Detect number of MHPM counters */
+	/* Detect number of MHPM counters (mhpmcounter3 to mhpmcounter31) */
+	if (desc.valid & SBI_HART_DESC_MHPM_COUNT) {
+		hfeatures->mhpm_count = (desc.mhpm_count < 29) ?
+					desc.mhpm_count : 29;
+		goto __mhpm_skip;
+	}
 	__check_csr(CSR_MHPMCOUNTER3, 0, 1UL, mhpm_count, __mhpm_skip);
 	__check_csr_4(CSR_MHPMCOUNTER4, 0, 1UL, mhpm_count, __mhpm_skip);
 	__check_csr_8(CSR_MHPMCOUNTER8, 0, 1UL, mhpm_count, __mhpm_skip);
@@ -425,18 +1311,109 @@ __mhpm_skip:
 	csr_read_allowed(CSR_TIME, (unsigned long)&trap);
 	if (!trap.cause)
 		hfeatures->features |= SBI_HART_HAS_TIME;
+
+	/*
+	 * Detect if hart supports Sstc extension. The stimecmp CSR is
+	 * always accessible from M-mode when implemented.
+	 */
+	if (!(hfeatures->features & SBI_HART_HAS_TIME) ||
+	    !misa_extension('S')) {
+		hfeatures->features &= ~SBI_HART_HAS_SSTC;
+	} else if (!(known & SBI_HART_HAS_SSTC)) {
+		csr_read_allowed(CSR_STIMECMP, (unsigned long)&trap);
+		if (!trap.cause)
+			hfeatures->features |= SBI_HART_HAS_SSTC;
+	}
+
+	/* Detect if hart supports Svinval extension */
+	if (!(known & SBI_HART_HAS_SVINVAL) && hart_svinval_allowed(&trap))
+		hfeatures->features |= SBI_HART_HAS_SVINVAL;
+
+	/* Detect if hart supports Zawrs extension */
+	if (!(known & SBI_HART_HAS_ZAWRS) && hart_zawrs_allowed(&trap))
+		hfeatures->features |= SBI_HART_HAS_ZAWRS;
+
+	/* Cache H extension which may otherwise need a platform callback */
+	if (misa_extension('H'))
+		hfeatures->features |= SBI_HART_HAS_H;
+
+	/*
+	 * Detect if hart implements the ratified htimedelta CSR. Only then
+	 * do guests read the time CSR in hardware, otherwise htimedelta
+	 * accesses from HS-mode are emulated.
+	 */
+	if ((hfeatures->features & SBI_HART_HAS_H) &&
+	    (hfeatures->features & SBI_HART_HAS_TIME)) {
+		csr_read_allowed(CSR_HTIMEDELTA, (unsigned long)&trap);
+		if (!trap.cause)
+			hfeatures->features |= SBI_HART_HAS_HTIMEDELTA;
+	}
+
+	/* Detect if hart supports Zacas extension */
+	if (!(known & SBI_HART_HAS_ZACAS) && hart_zacas_allowed(&trap))
+		hfeatures->features |= SBI_HART_HAS_ZACAS;
+
+	/* Detect if hart supports MCOUNTINHIBIT feature */
+	val = csr_read_allowed(CSR_MCOUNTINHIBIT, (unsigned long)&trap);
+	if (!trap.cause) {
+		csr_write_allowed(CSR_MCOUNTINHIBIT, (unsigned long)&trap, val);
+		if (!trap.cause)
+			hfeatures->features |= SBI_HART_HAS_MCOUNTINHIBIT;
+	}
+
+#if __riscv_xlen == 64
+	/*
+	 * Detect if hart supports Sscofpmf extension. The OF bit of
+	 * mhpmevent3 is only writable when counter overflow is implemented.
+	 */
+	if (!hfeatures->mhpm_count) {
+		hfeatures->features &= ~SBI_HART_HAS_SSCOFPMF;
+	} else if (!(known & SBI_HART_HAS_SSCOFPMF)) {
+		val = csr_read(CSR_MHPMEVENT3);
+		csr_write(CSR_MHPMEVENT3, val | MHPMEVENT_OF);
+		if (csr_swap(CSR_MHPMEVENT3, val) & MHPMEVENT_OF)
+			hfeatures->features |= SBI_HART_HAS_SSCOFPMF;
+	}
+#endif
+
+	/* Detect if hart supports Zicboz, Zicbom and Svpbmt extensions */
+	hfeatures->features |= hart_menvcfg_features(&trap) &
+			       HART_MENVCFG_FEATURES & ~known;
+
+	/* Size of the block zeroed by CBO.ZERO */
+	hfeatures->cboz_block_size = 0;
+	if (hfeatures->features & SBI_HART_HAS_ZICBOZ)
+		hfeatures->cboz_block_size = hart_cboz_block_size_probe(&trap);
+
+	hfeatures->misaligned_perf = hart_misaligned_perf_probe(scratch, &trap);
+
+	hfeatures->detected = TRUE;
+}
+
+/* PMP CSRs may have been reset while the HART was stopped or suspended */
+static void hart_pmp_shadow_invalidate(struct sbi_scratch *scratch)
+{
+	struct hart_features *hfeatures =
+			sbi_scratch_offset_ptr(scratch, hart_features_offset);
+
+	hfeatures->pmp_shadow_valid = FALSE;
 }
 
 int sbi_hart_reinit(struct sbi_scratch *scratch)
 {
 	int rc;
 
+	hart_pmp_shadow_invalidate(scratch);
 	mstatus_init(scratch);
 
 	rc = fp_init(scratch);
 	if (rc)
 		return rc;
 
+	rc = vector_init(scratch);
+	if (rc)
+		return rc;
+
 	rc = delegate_traps(scratch);
 	if (rc)
 		return rc;
@@ -444,6 +1421,58 @@ int sbi_hart_reinit(struct sbi_scratch *scratch)
 	return 0;
 }
 
+void sbi_hart_csr_save(struct sbi_scratch *scratch)
+{
+	struct hart_csr_image *img =
+			sbi_scratch_offset_ptr(scratch, hart_csr_image_offset);
+
+	/* Only the state set by mstatus_init() is kept for MSTATUS */
+	img->mstatus = csr_read(CSR_MSTATUS) & (MSTATUS_FS | MSTATUS_VS);
+	img->mtvec = csr_read(CSR_MTVEC);
+	if (misa_extension('S')) {
+		img->medeleg = csr_read(CSR_MEDELEG);
+		img->mideleg = csr_read(CSR_MIDELEG);
+	}
+	if (sbi_hart_has_feature(scratch, SBI_HART_HAS_MCOUNTEREN))
+		img->mcounteren = csr_read(CSR_MCOUNTEREN);
+	if (misa_extension('S') &&
+	    sbi_hart_has_feature(scratch, SBI_HART_HAS_SCOUNTEREN))
+		img->scounteren = csr_read(CSR_SCOUNTEREN);
+	if (sbi_hart_has_feature(scratch, SBI_HART_HAS_MCOUNTINHIBIT))
+		img->mcountinhibit = csr_read(CSR_MCOUNTINHIBIT);
+	img->valid = TRUE;
+}
+
+int sbi_hart_csr_restore(struct sbi_scratch *scratch)
+{
+	struct hart_csr_image *img =
+			sbi_scratch_offset_ptr(scratch, hart_csr_image_offset);
+
+	if (!img->valid)
+		return SBI_ENOENT;
+	img->valid = FALSE;
+
+	hart_pmp_shadow_invalidate(scratch);
+	csr_write(CSR_MSTATUS, img->mstatus);
+	csr_write(CSR_MTVEC, img->mtvec);
+	if (misa_extension('S')) {
+		csr_write(CSR_MEDELEG, img->medeleg);
+		csr_write(CSR_MIDELEG, img->mideleg);
+		csr_write(CSR_SATP, 0);
+	}
+	if (sbi_hart_has_feature(scratch, SBI_HART_HAS_MCOUNTEREN))
+		csr_write(CSR_MCOUNTEREN, img->mcounteren);
+	if (misa_extension('S') &&
+	    sbi_hart_has_feature(scratch, SBI_HART_HAS_SCOUNTEREN))
+		csr_write(CSR_SCOUNTEREN, img->scounteren);
+	if (sbi_hart_has_feature(scratch, SBI_HART_HAS_MCOUNTINHIBIT))
+		csr_write(CSR_MCOUNTINHIBIT, img->mcountinhibit);
+	menvcfg_init(scratch);
+	csr_write(CSR_MIE, 0);
+
+	return 0;
+}
+
 int sbi_hart_init(struct sbi_scratch *scratch, bool cold_boot)
 {
 	if (cold_boot) {
@@ -455,15 +1484,28 @@ int sbi_hart_init(struct sbi_scratch *scratch, bool cold_boot)
 						"HART_FEATURES");
 		if (!hart_features_offset)
 			return SBI_ENOMEM;
+
+		hart_csr_image_offset = sbi_scratch_alloc_offset(
+						sizeof(struct hart_csr_image),
+						"HART_CSR_IMAGE");
+		if (!hart_csr_image_offset)
+			return SBI_ENOMEM;
 	}
 
 	hart_detect_features(scratch);
 
+	/* A HART started again may not use the image of an old suspend */
+	((struct hart_csr_image *)sbi_scratch_offset_ptr(scratch,
+				hart_csr_image_offset))->valid = FALSE;
+
 	return sbi_hart_reinit(scratch);
 }
 
 void __attribute__((noreturn)) sbi_hart_hang(void)
 {
+	/* Don't lose buffered output explaining why we hang */
+	sbi_console_flush();
+
 	while (1)
 		wfi();
 	__builtin_unreachable();
@@ -0,0 +1,246 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <sbi/riscv_locks.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_heap.h>
+#include <sbi/sbi_math.h>
+#include <sbi/sbi_platform.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
+
+/*
+ * The heap is made of SBI_HEAP_ALIGN sized granules. Allocations up to
+ * HEAP_CLASS_MAX bytes are rounded up to a power of two size class and
+ * freed blocks of a class are kept on its own free list, so they are
+ * allocated and freed in constant time. They are never handed back to
+ * other classes. Larger blocks have a header granule with their size
+ * and are freed to an address ordered list where neighbours are merged.
+ *
+ * A map with one byte per granule tells the class of an allocated block
+ * so that sbi_free() does not need a header for small blocks.
+ */
+#define HEAP_CLASS_SHIFT_MIN		6
+#define HEAP_CLASS_COUNT		7
+#define HEAP_CLASS_MAX			\
+	(1UL << (HEAP_CLASS_SHIFT_MIN + HEAP_CLASS_COUNT - 1))
+#define HEAP_MAP_LARGE			HEAP_CLASS_COUNT
+#define HEAP_MAP_FREE			0xff
+
+struct heap_free {
+	struct heap_free *next;
+	/* Size of a free large block (including its header) */
+	unsigned long size;
+};
+
+struct heap_control {
+	spinlock_t lock;
+	/* Granule map followed by the allocatable space up to end */
+	u8 *map;
+	unsigned long start;
+	unsigned long end;
+	/* Space above brk was never allocated */
+	unsigned long brk;
+	unsigned long used;
+	struct heap_free *class_free[HEAP_CLASS_COUNT];
+	struct heap_free *large_free;
+};
+
+static struct heap_control hpctrl = {
+	.lock = SPIN_LOCK_INITIALIZER,
+};
+
+static inline u8 *heap_map(unsigned long addr)
+{
+	return &hpctrl.map[(addr - hpctrl.start) / SBI_HEAP_ALIGN];
+}
+
+/* Get size bytes from the freed large blocks or from the unused space */
+static void *heap_carve(unsigned long size)
+{
+	void *ret;
+	struct heap_free **pp, *f, *rest;
+
+	for (pp = &hpctrl.large_free; (f = *pp); pp = &f->next) {
+		if (f->size < size)
+			continue;
+		if (f->size == size) {
+			*pp = f->next;
+		} else {
+			rest = (void *)f + size;
+			rest->size = f->size - size;
+			rest->next = f->next;
+			*pp = rest;
+		}
+		return f;
+	}
+
+	if (hpctrl.end - hpctrl.brk < size)
+		return NULL;
+	ret = (void *)hpctrl.brk;
+	hpctrl.brk += size;
+
+	return ret;
+}
+
+/* Free a large block, merging it with free neighbours */
+static void heap_release(struct heap_free *blk, unsigned long size)
+{
+	struct heap_free **pp, **prev_pp = NULL, *prev = NULL, *next;
+
+	for (pp = &hpctrl.large_free; (next = *pp) && next < blk;
+	     pp = &next->next) {
+		prev_pp = pp;
+		prev = next;
+	}
+
+	blk->size = size;
+	blk->next = next;
+	if (next && (void *)blk + blk->size == (void *)next) {
+		blk->size += next->size;
+		blk->next = next->next;
+	}
+	if (prev && (void *)prev + prev->size == (void *)blk) {
+		prev->size += blk->size;
+		prev->next = blk->next;
+		blk = prev;
+		pp = prev_pp;
+	} else {
+		*pp = blk;
+	}
+
+	/* The last free block goes back to the unused space */
+	if (!blk->next && (unsigned long)blk + blk->size == hpctrl.brk) {
+		hpctrl.brk = (unsigned long)blk;
+		*pp = NULL;
+	}
+}
+
+void *sbi_malloc(size_t size)
+{
+	u32 cls;
+	unsigned long *hdr;
+	void *ret = NULL;
+
+	if (!size || !hpctrl.map || hpctrl.end - hpctrl.start < size)
+		return NULL;
+	size = ROUNDUP(size, SBI_HEAP_ALIGN);
+
+	spin_lock(&hpctrl.lock);
+
+	if (size <= HEAP_CLASS_MAX) {
+		cls = log2roundup(size) - HEAP_CLASS_SHIFT_MIN;
+		size = 1UL << (cls + HEAP_CLASS_SHIFT_MIN);
+		ret = hpctrl.class_free[cls];
+		if (ret)
+			hpctrl.class_free[cls] = hpctrl.class_free[cls]->next;
+		else
+			ret = heap_carve(size);
+	} else {
+		cls = HEAP_MAP_LARGE;
+		size += SBI_HEAP_ALIGN;
+		hdr = heap_carve(size);
+		if (hdr) {
+			*hdr = size;
+			ret = (void *)hdr + SBI_HEAP_ALIGN;
+		}
+	}
+
+	if (ret) {
+		*heap_map((unsigned long)ret) = cls;
+		hpctrl.used += size;
+	}
+
+	spin_unlock(&hpctrl.lock);
+
+	return ret;
+}
+
+void *sbi_zalloc(size_t size)
+{
+	void *ret = sbi_malloc(size);
+
+	if (ret)
+		sbi_memset(ret, 0, size);
+
+	return ret;
+}
+
+void sbi_free(void *ptr)
+{
+	u8 *map;
+	unsigned long size, addr = (unsigned long)ptr;
+	struct heap_free *f = ptr;
+
+	if (!ptr || addr < hpctrl.start || hpctrl.end <= addr ||
+	    (addr & (SBI_HEAP_ALIGN - 1)))
+		return;
+
+	spin_lock(&hpctrl.lock);
+
+	map = heap_map(addr);
+	if (*map < HEAP_CLASS_COUNT) {
+		size = 1UL << (*map + HEAP_CLASS_SHIFT_MIN);
+		f->next = hpctrl.class_free[*map];
+		hpctrl.class_free[*map] = f;
+		hpctrl.used -= size;
+	} else if (*map == HEAP_MAP_LARGE) {
+		f = ptr - SBI_HEAP_ALIGN;
+		size = *(unsigned long *)f;
+		hpctrl.used -= size;
+		heap_release(f, size);
+	}
+	/* Pointers not returned by sbi_malloc() are ignored */
+	*map = HEAP_MAP_FREE;
+
+	spin_unlock(&hpctrl.lock);
+}
+
+unsigned long sbi_heap_free_space(void)
+{
+	return hpctrl.end - hpctrl.start - hpctrl.used;
+}
+
+unsigned long sbi_heap_used_space(void)
+{
+	return hpctrl.used;
+}
+
+unsigned long sbi_heap_reserved_space(void)
+{
+	return hpctrl.start - (unsigned long)hpctrl.map;
+}
+
+int sbi_heap_init(struct sbi_scratch *scratch)
+{
+	unsigned long base, end, map_size;
+	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
+	unsigned long size = sbi_platform_heap_size(plat);
+
+	/* Without a heap all allocations fail */
+	if (!size)
+		return 0;
+	if (scratch->fw_size < size)
+		return SBI_EINVAL;
+
+	/* The firmware places the heap at the end of its region */
+	end = scratch->fw_start + scratch->fw_size;
+	base = ROUNDUP(end - size, SBI_HEAP_ALIGN);
+	end = ROUNDDOWN(end, SBI_HEAP_ALIGN);
+	if (end <= base)
+		return SBI_EINVAL;
+	map_size = ROUNDUP((end - base) / SBI_HEAP_ALIGN, SBI_HEAP_ALIGN);
+	if (end - base <= map_size)
+		return SBI_EINVAL;
+
+	hpctrl.map = (u8 *)base;
+	hpctrl.start = base + map_size;
+	hpctrl.end = end;
+	hpctrl.brk = hpctrl.start;
+	sbi_memset(hpctrl.map, HEAP_MAP_FREE, map_size);
+
+	return 0;
+}
@@ -22,13 +22,30 @@
 #include <sbi/sbi_init.h>
 #include <sbi/sbi_ipi.h>
 #include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
 #include <sbi/sbi_system.h>
 #include <sbi/sbi_timer.h>
+#include <sbi/sbi_tlb.h>
+#include <sbi/sbi_trace.h>
 #include <sbi/sbi_console.h>
 
 static const struct sbi_hsm_device *hsm_dev = NULL;
 static unsigned long hart_data_offset;
 
+/*
+ * HARTs in STARTED or SUSPENDED state. A HART updates its own bit when
+ * it moves into or out of these states so that interruptible HART masks
+ * are computed from at most two words instead of the state of each HART.
+ * The mask starts on its own cacheline so that these updates do not
+ * evict the read-mostly HSM data used by every IPI sender.
+ */
+static struct sbi_hartmask hsm_interruptible_harts
+			__aligned(SBI_SCRATCH_CACHELINE_SIZE);
+
+static struct sbi_hsm_suspend_state susp_states[SBI_HSM_SUSPEND_STATE_MAX];
+static u32 susp_state_count;
+static bool susp_state_platform;
+
 /** Per hart specific data to manage state transition **/
 struct sbi_hsm_data {
 	atomic_t state;
@@ -50,6 +67,16 @@ static inline int __sbi_hsm_hart_get_state(u32 hartid)
 	return atomic_read(&hdata->state);
 }
 
+static inline void hsm_interruptible_update(u32 hartid, bool interruptible)
+{
+	ulong *bits = sbi_hartmask_bits(&hsm_interruptible_harts);
+
+	if (interruptible)
+		atomic_raw_set_bit(hartid, bits);
+	else
+		atomic_raw_clear_bit(hartid, bits);
+}
+
 int sbi_hsm_hart_get_state(const struct sbi_domain *dom, u32 hartid)
 {
 	if (!sbi_domain_is_assigned_hart(dom, hartid))
@@ -69,26 +96,22 @@ int sbi_hsm_hart_get_state(const struct sbi_domain *dom, u32 hartid)
 int sbi_hsm_hart_interruptible_mask(const struct sbi_domain *dom,
 				    ulong hbase, ulong *out_hmask)
 {
-	int hstate;
-	ulong i, hmask, dmask;
+	ulong bword, boff, imask;
+	volatile ulong *bits = sbi_hartmask_bits(&hsm_interruptible_harts);
 	ulong hend = sbi_scratch_last_hartid() + 1;
 
 	*out_hmask = 0;
 	if (hend <= hbase)
 		return SBI_EINVAL;
-	if (BITS_PER_LONG < (hend - hbase))
-		hend = hbase + BITS_PER_LONG;
-
-	dmask = sbi_domain_get_assigned_hartmask(dom, hbase);
-	for (i = hbase; i < hend; i++) {
-		hmask = 1UL << (i - hbase);
-		if (dmask & hmask) {
-			hstate = __sbi_hsm_hart_get_state(i);
-			if (hstate == SBI_HSM_STATE_STARTED ||
-			    hstate == SBI_HSM_STATE_SUSPENDED)
-				*out_hmask |= hmask;
-		}
-	}
+
+	bword = BIT_WORD(hbase);
+	boff = BIT_WORD_OFFSET(hbase);
+	imask = bits[bword++] >> boff;
+	if (boff && bword < BIT_WORD(SBI_HARTMASK_MAX_BITS))
+		imask |= (bits[bword] & (BIT(boff) - 1UL)) <<
+			 (BITS_PER_LONG - boff);
+
+	*out_hmask = sbi_domain_get_assigned_hartmask(dom, hbase) & imask;
 
 	return 0;
 }
@@ -103,9 +126,11 @@ void sbi_hsm_prepare_next_jump(struct sbi_scratch *scratch, u32 hartid)
 				  SBI_HSM_STATE_STARTED);
 	if (oldstate != SBI_HSM_STATE_START_PENDING)
 		sbi_hart_hang();
+	sbi_trace(SBI_TRACE_HSM_STATE, hartid, SBI_HSM_STATE_STARTED);
+	hsm_interruptible_update(hartid, TRUE);
 }
 
-static void sbi_hsm_hart_wait(struct sbi_scratch *scratch, u32 hartid)
+void sbi_hsm_hart_wait(struct sbi_scratch *scratch, u32 hartid)
 {
 	unsigned long saved_mie;
 	struct sbi_hsm_data *hdata = sbi_scratch_offset_ptr(scratch,
@@ -113,8 +138,8 @@ static void sbi_hsm_hart_wait(struct sbi_scratch *scratch, u32 hartid)
 	/* Save MIE CSR */
 	saved_mie = csr_read(CSR_MIE);
 
-	/* Set MSIE bit to receive IPI */
-	csr_set(CSR_MIE, MIP_MSIP);
+	/* Set MSIE and MEIE bits to receive IPI */
+	csr_set(CSR_MIE, MIP_MSIP | MIP_MEIP);
 
 	/* Wait for hart_add call*/
 	while (atomic_read(&hdata->state) != SBI_HSM_STATE_START_PENDING) {
@@ -125,9 +150,11 @@ static void sbi_hsm_hart_wait(struct sbi_scratch *scratch, u32 hartid)
 	csr_write(CSR_MIE, saved_mie);
 
 	/*
-	 * No need to clear IPI here because the sbi_ipi_init() will
-	 * clear it for current HART via sbi_platform_ipi_init().
+	 * The IPI of current HART is already initialized so clear the
+	 * IPI used to wake us up. Nothing else is sent to a HART which
+	 * is not started.
 	 */
+	sbi_ipi_raw_clear(hartid);
 }
 
 const struct sbi_hsm_device *sbi_hsm_get_device(void)
@@ -143,6 +170,66 @@ void sbi_hsm_set_device(const struct sbi_hsm_device *dev)
 	hsm_dev = dev;
 }
 
+static bool hsm_suspend_type_valid(u32 suspend_type)
+{
+	if (SBI_HSM_SUSPEND_RET_DEFAULT < suspend_type &&
+	    suspend_type < SBI_HSM_SUSPEND_RET_PLATFORM)
+		return FALSE;
+	if (SBI_HSM_SUSPEND_NON_RET_DEFAULT < suspend_type &&
+	    suspend_type < SBI_HSM_SUSPEND_NON_RET_PLATFORM)
+		return FALSE;
+
+	return TRUE;
+}
+
+static bool hsm_suspend_type_platform(u32 suspend_type)
+{
+	return (suspend_type & SBI_HSM_SUSP_BASE_MASK) >=
+		SBI_HSM_SUSP_PLAT_BASE;
+}
+
+int sbi_hsm_add_suspend_state(const struct sbi_hsm_suspend_state *state)
+{
+	if (!state || !hsm_suspend_type_valid(state->suspend_type))
+		return SBI_EINVAL;
+	if (sbi_hsm_find_suspend_state(state->suspend_type))
+		return SBI_EALREADY;
+	if (SBI_HSM_SUSPEND_STATE_MAX <= susp_state_count)
+		return SBI_ENOSPC;
+
+	sbi_memcpy(&susp_states[susp_state_count], state, sizeof(*state));
+	susp_states[susp_state_count].name[
+			sizeof(susp_states[0].name) - 1] = '\0';
+	susp_state_count++;
+	if (hsm_suspend_type_platform(state->suspend_type))
+		susp_state_platform = TRUE;
+
+	return 0;
+}
+
+u32 sbi_hsm_suspend_state_count(void)
+{
+	return susp_state_count;
+}
+
+const struct sbi_hsm_suspend_state *sbi_hsm_suspend_state_get(u32 index)
+{
+	return (index < susp_state_count) ? &susp_states[index] : NULL;
+}
+
+const struct sbi_hsm_suspend_state *sbi_hsm_find_suspend_state(
+							u32 suspend_type)
+{
+	u32 i;
+
+	for (i = 0; i < susp_state_count; i++) {
+		if (susp_states[i].suspend_type == suspend_type)
+			return &susp_states[i];
+	}
+
+	return NULL;
+}
+
 static bool hsm_device_has_hart_hotplug(void)
 {
 	if (hsm_dev && hsm_dev->hart_start && hsm_dev->hart_stop)
@@ -185,8 +272,10 @@ int sbi_hsm_init(struct sbi_scratch *scratch, u32 hartid, bool cold_boot)
 	struct sbi_hsm_data *hdata;
 
 	if (cold_boot) {
-		hart_data_offset = sbi_scratch_alloc_offset(sizeof(*hdata),
-							    "HART_DATA");
+		/* The state is changed by remote HARTs on HSM start */
+		hart_data_offset = sbi_scratch_alloc_remote_offset(
+							sizeof(*hdata),
+							"HART_DATA");
 		if (!hart_data_offset)
 			return SBI_ENOMEM;
 
@@ -203,8 +292,8 @@ int sbi_hsm_init(struct sbi_scratch *scratch, u32 hartid, bool cold_boot)
 				    SBI_HSM_STATE_START_PENDING :
 				    SBI_HSM_STATE_STOPPED);
 		}
-	} else {
-		sbi_hsm_hart_wait(scratch, hartid);
+	} else if (!hart_data_offset) {
+		return SBI_ENOMEM;
 	}
 
 	return 0;
@@ -221,6 +310,7 @@ void __noreturn sbi_hsm_exit(struct sbi_scratch *scratch)
 				SBI_HSM_STATE_STOPPED);
 	if (hstate != SBI_HSM_STATE_STOP_PENDING)
 		goto fail_exit;
+	sbi_trace(SBI_TRACE_HSM_STATE, scratch->hartid, SBI_HSM_STATE_STOPPED);
 
 	if (hsm_device_has_hart_hotplug()) {
 		hsm_device_hart_stop();
@@ -274,6 +364,7 @@ int sbi_hsm_hart_start(struct sbi_scratch *scratch,
 	 */
 	if (hstate != SBI_HSM_STATE_STOPPED)
 		return SBI_EINVAL;
+	sbi_trace(SBI_TRACE_HSM_STATE, hartid, SBI_HSM_STATE_START_PENDING);
 
 	init_count = sbi_init_count(hartid);
 	rscratch->next_arg1 = priv;
@@ -307,6 +398,9 @@ int sbi_hsm_hart_stop(struct sbi_scratch *scratch, bool exitnow)
 			   __func__, oldstate);
 		return SBI_EFAIL;
 	}
+	sbi_trace(SBI_TRACE_HSM_STATE, scratch->hartid,
+		  SBI_HSM_STATE_STOP_PENDING);
+	hsm_interruptible_update(current_hartid(), FALSE);
 
 	if (exitnow)
 		sbi_exit(scratch);
@@ -316,6 +410,16 @@ int sbi_hsm_hart_stop(struct sbi_scratch *scratch, bool exitnow)
 
 static int __sbi_hsm_suspend_ret_default(struct sbi_scratch *scratch)
 {
+	/*
+	 * Events of a HART in IPI polling mode don't raise an interrupt
+	 * so poll for them until an interrupt is pending, like WFI does.
+	 */
+	if (sbi_ipi_poll_get(scratch)) {
+		while (!(csr_read(CSR_MIP) & csr_read(CSR_MIE)))
+			sbi_ipi_poll(scratch);
+		return 0;
+	}
+
 	/* Wait for interrupt */
 	wfi();
 
@@ -343,6 +447,9 @@ static void __sbi_hsm_suspend_non_ret_save(struct sbi_scratch *scratch)
 
 	hdata->saved_mie = csr_read(CSR_MIE);
 	hdata->saved_mip = csr_read(CSR_MIP) & (MIP_SSIP | MIP_STIP);
+
+	/* Save the M-mode CSRs set up by warm init for a fast resume */
+	sbi_hart_csr_save(scratch);
 }
 
 static void __sbi_hsm_suspend_non_ret_restore(struct sbi_scratch *scratch)
@@ -359,12 +466,6 @@ static int __sbi_hsm_suspend_non_ret_default(struct sbi_scratch *scratch,
 {
 	void (*jump_warmboot)(void) = (void (*)(void))scratch->warmboot_addr;
 
-	/*
-	 * Save some of the M-mode CSRs which should be restored after
-	 * resuming from suspend state
-	 */
-	__sbi_hsm_suspend_non_ret_save(scratch);
-
 	/* Wait for interrupt */
 	wfi();
 
@@ -391,6 +492,9 @@ void sbi_hsm_hart_resume_start(struct sbi_scratch *scratch)
 			   __func__, oldstate);
 		sbi_hart_hang();
 	}
+	sbi_trace(SBI_TRACE_HSM_STATE, scratch->hartid,
+		  SBI_HSM_STATE_RESUME_PENDING);
+	hsm_interruptible_update(current_hartid(), FALSE);
 }
 
 void sbi_hsm_hart_resume_finish(struct sbi_scratch *scratch)
@@ -407,6 +511,11 @@ void sbi_hsm_hart_resume_finish(struct sbi_scratch *scratch)
 			   __func__, oldstate);
 		sbi_hart_hang();
 	}
+	sbi_trace(SBI_TRACE_HSM_STATE, scratch->hartid, SBI_HSM_STATE_STARTED);
+	hsm_interruptible_update(current_hartid(), TRUE);
+
+	/* Apply remote tlb flushes deferred while suspended */
+	sbi_tlb_lazy_exit(scratch);
 
 	/*
 	 * Restore some of the M-mode CSRs which we are re-configured by
@@ -430,11 +539,10 @@ int sbi_hsm_hart_suspend(struct sbi_scratch *scratch, u32 suspend_type,
 		return SBI_EINVAL;
 
 	/* Sanity check on suspend type */
-	if (SBI_HSM_SUSPEND_RET_DEFAULT < suspend_type &&
-	    suspend_type < SBI_HSM_SUSPEND_RET_PLATFORM)
+	if (!hsm_suspend_type_valid(suspend_type))
 		return SBI_EINVAL;
-	if (SBI_HSM_SUSPEND_NON_RET_DEFAULT < suspend_type &&
-	    suspend_type < SBI_HSM_SUSPEND_NON_RET_PLATFORM)
+	if (susp_state_platform && hsm_suspend_type_platform(suspend_type) &&
+	    !sbi_hsm_find_suspend_state(suspend_type))
 		return SBI_EINVAL;
 
 	/* Additional sanity check for non-retentive suspend */
@@ -460,10 +568,23 @@ int sbi_hsm_hart_suspend(struct sbi_scratch *scratch, u32 suspend_type,
 		ret = SBI_EDENIED;
 		goto fail_restore_state;
 	}
+	sbi_trace(SBI_TRACE_HSM_STATE, scratch->hartid,
+		  SBI_HSM_STATE_SUSPENDED);
 
 	/* Save the suspend type */
 	hdata->suspend_type = suspend_type;
 
+	/* Remote tlb flushes are applied on resume instead of waking us */
+	sbi_tlb_lazy_enter(scratch);
+
+	/*
+	 * Save some of the M-mode CSRs which should be restored after
+	 * resuming from a non-retentive suspend state, including the
+	 * platform specific ones which resume in warm-boot path as well.
+	 */
+	if (suspend_type & SBI_HSM_SUSP_NON_RET_BIT)
+		__sbi_hsm_suspend_non_ret_save(scratch);
+
 	/* Try platform specific suspend */
 	ret = hsm_device_hart_suspend(suspend_type, scratch->warmboot_addr);
 	if (ret == SBI_ENOTSUPP) {
@@ -476,6 +597,9 @@ int sbi_hsm_hart_suspend(struct sbi_scratch *scratch, u32 suspend_type,
 		}
 	}
 
+	/* Apply remote tlb flushes deferred while suspended */
+	sbi_tlb_lazy_exit(scratch);
+
 fail_restore_state:
 	/*
 	 * We might have successfully resumed from retentive suspend
@@ -488,6 +612,51 @@ fail_restore_state:
 			   __func__, oldstate);
 		sbi_hart_hang();
 	}
+	sbi_trace(SBI_TRACE_HSM_STATE, scratch->hartid, SBI_HSM_STATE_STARTED);
 
 	return ret;
 }
+
+int sbi_hsm_hart_system_suspend(struct sbi_scratch *scratch, ulong raddr,
+				ulong rmode, ulong priv)
+{
+	int oldstate;
+	struct sbi_hsm_data *hdata = sbi_scratch_offset_ptr(scratch,
+							    hart_data_offset);
+
+	oldstate = atomic_cmpxchg(&hdata->state, SBI_HSM_STATE_STARTED,
+				  SBI_HSM_STATE_SUSPENDED);
+	if (oldstate != SBI_HSM_STATE_STARTED)
+		return SBI_EDENIED;
+	sbi_trace(SBI_TRACE_HSM_STATE, scratch->hartid,
+		  SBI_HSM_STATE_SUSPENDED);
+
+	scratch->next_arg1 = priv;
+	scratch->next_addr = raddr;
+	scratch->next_mode = rmode;
+
+	/* The system resumes like from a non-retentive HART suspend */
+	hdata->suspend_type = SBI_HSM_SUSPEND_NON_RET_DEFAULT;
+	sbi_tlb_lazy_enter(scratch);
+	__sbi_hsm_suspend_non_ret_save(scratch);
+
+	return 0;
+}
+
+void sbi_hsm_hart_system_suspend_abort(struct sbi_scratch *scratch)
+{
+	int oldstate;
+	struct sbi_hsm_data *hdata = sbi_scratch_offset_ptr(scratch,
+							    hart_data_offset);
+
+	sbi_tlb_lazy_exit(scratch);
+
+	oldstate = atomic_cmpxchg(&hdata->state, SBI_HSM_STATE_SUSPENDED,
+				  SBI_HSM_STATE_STARTED);
+	if (oldstate != SBI_HSM_STATE_SUSPENDED) {
+		sbi_printf("%s: ERR: The hart is in invalid state [%u]\n",
+			   __func__, oldstate);
+		sbi_hart_hang();
+	}
+	sbi_trace(SBI_TRACE_HSM_STATE, scratch->hartid, SBI_HSM_STATE_STARTED);
+}
@@ -11,9 +11,11 @@
 #include <sbi/riscv_encoding.h>
 #include <sbi/sbi_bitops.h>
 #include <sbi/sbi_emulate_csr.h>
+#include <sbi/sbi_emulate_isa.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_illegal_insn.h>
 #include <sbi/sbi_trap.h>
+#include <sbi/sbi_trap_stats.h>
 #include <sbi/sbi_unpriv.h>
 
 typedef int (*illegal_insn_func)(ulong insn, struct sbi_trap_regs *regs);
@@ -31,12 +33,14 @@ static int truly_illegal_insn(ulong insn, struct sbi_trap_regs *regs)
 	return sbi_trap_redirect(regs, &trap);
 }
 
+#ifndef SBI_EMULATE_CSR_DISABLED
 static int system_opcode_insn(ulong insn, struct sbi_trap_regs *regs)
 {
 	int do_write, rs1_num = (insn >> 15) & 0x1f;
 	ulong rs1_val = GET_RS1(insn, regs);
 	int csr_num   = (u32)insn >> 20;
 	ulong csr_val, new_csr_val;
+	ulong stats_start = sbi_trap_stats_start();
 
 	/* TODO: Ensure that we got CSR read/write instruction */
 
@@ -76,25 +80,44 @@ static int system_opcode_insn(ulong insn, struct sbi_trap_regs *regs)
 
 	regs->mepc += 4;
 
+	sbi_trap_stats_csr(csr_num, stats_start);
+
 	return 0;
 }
+#else
+#define system_opcode_insn truly_illegal_insn
+#endif
+
+#ifdef SBI_ISA_EMULATION
+static int isa_emulation_insn(ulong insn, struct sbi_trap_regs *regs)
+{
+	int rc = sbi_emulate_isa_insn(insn, regs);
+
+	if (rc == SBI_ENOTSUPP)
+		return truly_illegal_insn(insn, regs);
+
+	return rc;
+}
+#else
+#define isa_emulation_insn truly_illegal_insn
+#endif
 
 static illegal_insn_func illegal_insn_table[32] = {
 	truly_illegal_insn, /* 0 */
 	truly_illegal_insn, /* 1 */
 	truly_illegal_insn, /* 2 */
-	truly_illegal_insn, /* 3 */
-	truly_illegal_insn, /* 4 */
+	isa_emulation_insn, /* 3 */
+	isa_emulation_insn, /* 4 */
 	truly_illegal_insn, /* 5 */
-	truly_illegal_insn, /* 6 */
+	isa_emulation_insn, /* 6 */
 	truly_illegal_insn, /* 7 */
 	truly_illegal_insn, /* 8 */
 	truly_illegal_insn, /* 9 */
 	truly_illegal_insn, /* 10 */
 	truly_illegal_insn, /* 11 */
-	truly_illegal_insn, /* 12 */
+	isa_emulation_insn, /* 12 */
 	truly_illegal_insn, /* 13 */
-	truly_illegal_insn, /* 14 */
+	isa_emulation_insn, /* 14 */
 	truly_illegal_insn, /* 15 */
 	truly_illegal_insn, /* 16 */
 	truly_illegal_insn, /* 17 */
@@ -114,7 +137,7 @@ static illegal_insn_func illegal_insn_table[32] = {
 	truly_illegal_insn  /* 31 */
 };
 
-int sbi_illegal_insn_handler(ulong insn, struct sbi_trap_regs *regs)
+int __hot sbi_illegal_insn_handler(ulong insn, struct sbi_trap_regs *regs)
 {
 	struct sbi_trap_info uptrap;
 
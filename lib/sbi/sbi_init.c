@@ -11,19 +11,34 @@
 #include <sbi/riscv_atomic.h>
 #include <sbi/riscv_barrier.h>
 #include <sbi/riscv_locks.h>
+#include <sbi/sbi_boot_timeline.h>
+#include <sbi/sbi_cache.h>
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_domain.h>
+#include <sbi/sbi_domain_context.h>
 #include <sbi/sbi_ecall.h>
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_hartmask.h>
+#include <sbi/sbi_heap.h>
 #include <sbi/sbi_hsm.h>
 #include <sbi/sbi_ipi.h>
+#include <sbi/sbi_lock_stats.h>
+#include <sbi/sbi_measure.h>
+#include <sbi/sbi_misaligned_ldst.h>
 #include <sbi/sbi_platform.h>
+#include <sbi/sbi_pmp_swap.h>
+#include <sbi/sbi_pmu.h>
+#include <sbi/sbi_pmu_sample.h>
+#include <sbi/sbi_stack_check.h>
+#include <sbi/sbi_sta.h>
 #include <sbi/sbi_system.h>
 #include <sbi/sbi_string.h>
 #include <sbi/sbi_timer.h>
 #include <sbi/sbi_tlb.h>
+#include <sbi/sbi_trace.h>
+#include <sbi/sbi_trap_stats.h>
 #include <sbi/sbi_version.h>
+#include <sbi/sbi_xcall.h>
 
 #define BANNER                                              \
 	"   ____                    _____ ____ _____\n"     \
@@ -35,7 +50,7 @@
 	"        | |\n"                                     \
 	"        |_|\n\n"
 
-static void sbi_boot_print_banner(struct sbi_scratch *scratch)
+static void __init sbi_boot_print_banner(struct sbi_scratch *scratch)
 {
 	if (scratch->options & SBI_SCRATCH_NO_BOOT_PRINTS)
 		return;
@@ -50,7 +65,7 @@ static void sbi_boot_print_banner(struct sbi_scratch *scratch)
 	sbi_printf(BANNER);
 }
 
-static void sbi_boot_print_general(struct sbi_scratch *scratch)
+static void __init sbi_boot_print_general(struct sbi_scratch *scratch)
 {
 	char str[128];
 	const struct sbi_hsm_device *hdev;
@@ -73,6 +88,10 @@ static void sbi_boot_print_general(struct sbi_scratch *scratch)
 	idev = sbi_ipi_get_device();
 	sbi_printf("Platform IPI Device       : %s\n",
 		   (idev) ? idev->name : "---");
+	if (scratch->options & SBI_SCRATCH_IPI_SELFTEST) {
+		sbi_ipi_get_selftest_str(str, sizeof(str));
+		sbi_printf("Platform IPI Self-test    : %s\n", str);
+	}
 	tdev = sbi_timer_get_device();
 	sbi_printf("Platform Timer Device     : %s\n",
 		   (tdev) ? tdev->name : "---");
@@ -82,6 +101,8 @@ static void sbi_boot_print_general(struct sbi_scratch *scratch)
 	hdev = sbi_hsm_get_device();
 	sbi_printf("Platform HSM Device       : %s\n",
 		   (hdev) ? hdev->name : "---");
+	sbi_printf("Platform Suspend States   : %u\n",
+		   sbi_hsm_suspend_state_count());
 	srdev = sbi_system_reset_get_device();
 	sbi_printf("Platform SysReset Device  : %s\n",
 		   (srdev) ? srdev->name : "---");
@@ -90,6 +111,12 @@ static void sbi_boot_print_general(struct sbi_scratch *scratch)
 	sbi_printf("Firmware Base             : 0x%lx\n", scratch->fw_start);
 	sbi_printf("Firmware Size             : %d KB\n",
 		   (u32)(scratch->fw_size / 1024));
+	sbi_printf("Firmware Heap Size        : %d KB (total), %d KB (reserved), "
+		   "%d KB (used), %d KB (free)\n",
+		   (u32)(sbi_platform_heap_size(plat) / 1024),
+		   (u32)(sbi_heap_reserved_space() / 1024),
+		   (u32)(sbi_heap_used_space() / 1024),
+		   (u32)(sbi_heap_free_space() / 1024));
 
 	/* SBI details */
 	sbi_printf("Runtime SBI Version       : %d.%d\n",
@@ -97,7 +124,7 @@ static void sbi_boot_print_general(struct sbi_scratch *scratch)
 	sbi_printf("\n");
 }
 
-static void sbi_boot_print_domains(struct sbi_scratch *scratch)
+static void __init sbi_boot_print_domains(struct sbi_scratch *scratch)
 {
 	if (scratch->options & SBI_SCRATCH_NO_BOOT_PRINTS)
 		return;
@@ -106,10 +133,11 @@ static void sbi_boot_print_domains(struct sbi_scratch *scratch)
 	sbi_domain_dump_all("      ");
 }
 
-static void sbi_boot_print_hart(struct sbi_scratch *scratch, u32 hartid)
+static void __init sbi_boot_print_hart(struct sbi_scratch *scratch, u32 hartid)
 {
 	int xlen;
 	char str[128];
+	const char *str_perf;
 	const struct sbi_domain *dom = sbi_domain_thishart_ptr();
 
 	if (scratch->options & SBI_SCRATCH_NO_BOOT_PRINTS)
@@ -139,85 +167,178 @@ static void sbi_boot_print_hart(struct sbi_scratch *scratch, u32 hartid)
 		   sbi_hart_mhpm_count(scratch));
 	sbi_printf("Boot HART MHPM Count      : %d\n",
 		   sbi_hart_mhpm_count(scratch));
+	if (misa_extension('V'))
+		sbi_printf("Boot HART Vector VLENB    : %lu\n",
+			   sbi_hart_vlenb(scratch));
+	str_perf = sbi_hart_misaligned_perf2string(
+				sbi_hart_misaligned_perf(scratch));
+	sbi_printf("Boot HART Misaligned Perf : %s\n",
+		   (str_perf) ? str_perf : "unknown");
 	sbi_hart_delegation_dump(scratch, "Boot HART ", "         ");
 }
 
-static spinlock_t coldboot_lock = SPIN_LOCK_INITIALIZER;
 static struct sbi_hartmask coldboot_wait_hmask = { 0 };
+static struct sbi_hartmask coldboot_ready_hmask = { 0 };
+
+/*
+ * Cold boot is done in two stages. Once global state is initialized,
+ * other HARTs are released to do their per-HART initialization while
+ * the coldboot HART finalizes domains and prints boot information.
+ * They are released again for the PMP configuration after cold boot
+ * is done.
+ *
+ * HARTs of non-root domains don't depend on the remaining cold boot
+ * work (boot prints, root domain FDT fixups, measurements) so they are
+ * released for the second stage as soon as domains are finalized. Such
+ * HARTs are marked in coldboot_ready_hmask.
+ */
+#define COLDBOOT_STAGE_GLOBAL		1
+#define COLDBOOT_STAGE_DONE		2
+
+static unsigned long coldboot_stage;
+static u32 coldboot_hartid;
+
+/*
+ * HARTs waiting for cold boot are woken up along a binary tree of HART
+ * IDs rooted at the coldboot HART so that every woken HART wakes up its
+ * own children. The children of a HART which is not waiting are woken
+ * up by its parent instead. A waker claims the waiting bit of a HART
+ * atomically so every waiting HART gets exactly one IPI.
+ */
+static u32 coldboot_node(u32 hartid)
+{
+	u32 nodes = sbi_scratch_last_hartid() + 1;
 
-static unsigned long coldboot_done;
+	return (hartid + nodes - coldboot_hartid) % nodes;
+}
+
+static void wake_coldboot_children(u32 node)
+{
+	u32 child, hartid, nodes = sbi_scratch_last_hartid() + 1;
+
+	for (child = 2 * node + 1;
+	     child <= 2 * node + 2 && child < nodes; child++) {
+		hartid = (coldboot_hartid + child) % nodes;
+		if (atomic_raw_clear_bit(hartid, coldboot_wait_hmask.bits))
+			sbi_ipi_raw_send(hartid);
+		else
+			wake_coldboot_children(child);
+	}
+}
 
-static void wait_for_coldboot(struct sbi_scratch *scratch, u32 hartid)
+static bool coldboot_reached(u32 hartid, unsigned long stage)
+{
+	if (stage <= __smp_load_acquire(&coldboot_stage))
+		return TRUE;
+
+	return stage == COLDBOOT_STAGE_DONE &&
+	       sbi_hartmask_test_hart(hartid, &coldboot_ready_hmask);
+}
+
+static void wait_for_coldboot(struct sbi_scratch *scratch, u32 hartid,
+			      unsigned long stage)
 {
 	unsigned long saved_mie, cmip;
 
 	/* Save MIE CSR */
 	saved_mie = csr_read(CSR_MIE);
 
-	/* Set MSIE bit to receive IPI */
-	csr_set(CSR_MIE, MIP_MSIP);
-
-	/* Acquire coldboot lock */
-	spin_lock(&coldboot_lock);
+	/* Set MSIE and MEIE bits to receive IPI */
+	csr_set(CSR_MIE, MIP_MSIP | MIP_MEIP);
 
-	/* Mark current HART as waiting */
-	sbi_hartmask_set_hart(hartid, &coldboot_wait_hmask);
-
-	/* Release coldboot lock */
-	spin_unlock(&coldboot_lock);
+	/*
+	 * Mark current HART as waiting. The AMO orders this before the
+	 * stage check below so either we see the stage or the waker
+	 * sees us waiting.
+	 */
+	atomic_raw_set_bit(hartid, coldboot_wait_hmask.bits);
 
-	/* Wait for coldboot to finish using WFI */
-	while (!__smp_load_acquire(&coldboot_done)) {
+	/* Wait for coldboot to reach the stage using WFI */
+	while (!coldboot_reached(hartid, stage)) {
 		do {
 			wfi();
 			cmip = csr_read(CSR_MIP);
-		 } while (!(cmip & MIP_MSIP));
+		 } while (!(cmip & (MIP_MSIP | MIP_MEIP)));
+		sbi_ipi_selftest_reply(scratch);
 	};
 
-	/* Acquire coldboot lock */
-	spin_lock(&coldboot_lock);
-
-	/* Unmark current HART as waiting */
-	sbi_hartmask_clear_hart(hartid, &coldboot_wait_hmask);
-
-	/* Release coldboot lock */
-	spin_unlock(&coldboot_lock);
+	/*
+	 * If our waiting bit was claimed by a waker then an IPI is on its
+	 * way (or already pending), so wait for it, clear it and wake our
+	 * children. Otherwise no IPI was sent to us for cold boot and none
+	 * is cleared so that an IPI is not lost in warm resume path.
+	 *
+	 * Starting a HART before cold boot is done does not depend on the
+	 * IPI because sbi_hsm_hart_wait() checks the HART state.
+	 *
+	 * A HART released early with its domain leaves its children to
+	 * its parent which finds it not waiting once the stage is reached.
+	 */
+	if (!atomic_raw_clear_bit(hartid, coldboot_wait_hmask.bits)) {
+		while (!(csr_read(CSR_MIP) & (MIP_MSIP | MIP_MEIP)))
+			wfi();
+		sbi_ipi_raw_clear(hartid);
+		if (stage <= __smp_load_acquire(&coldboot_stage))
+			wake_coldboot_children(coldboot_node(hartid));
+	}
 
 	/* Restore MIE CSR */
 	csr_write(CSR_MIE, saved_mie);
+}
 
-	/*
-	 * The wait for coldboot is common for both warm startup and
-	 * warm resume path so clearing IPI here would result in losing
-	 * an IPI in warm resume path.
-	 *
-	 * Also, the sbi_platform_ipi_init() called from sbi_ipi_init()
-	 * will automatically clear IPI for current HART.
-	 */
+/* Any HART other than the coldboot HART waiting for cold boot */
+static u32 coldboot_waiting_peer(u32 hartid)
+{
+	u32 i;
+
+	sbi_hartmask_for_each_hart(i, &coldboot_wait_hmask) {
+		if (i != hartid)
+			return i;
+	}
+
+	return -1U;
 }
 
-static void wake_coldboot_harts(struct sbi_scratch *scratch, u32 hartid)
+static void wake_coldboot_harts(struct sbi_scratch *scratch, u32 hartid,
+				unsigned long stage)
 {
-	/* Mark coldboot done */
-	__smp_store_release(&coldboot_done, 1);
+	coldboot_hartid = hartid;
 
-	/* Acquire coldboot lock */
-	spin_lock(&coldboot_lock);
+	/* Mark coldboot stage reached */
+	__smp_store_release(&coldboot_stage, stage);
 
-	/* Send an IPI to all HARTs waiting for coldboot */
-	for (int i = 0; i <= sbi_scratch_last_hartid(); i++) {
-		if ((i != hartid) &&
-		    sbi_hartmask_test_hart(i, &coldboot_wait_hmask))
-			sbi_ipi_raw_send(i);
-	}
+	/* Wake up the HARTs waiting for coldboot starting from the root */
+	wake_coldboot_children(0);
+}
 
-	/* Release coldboot lock */
-	spin_unlock(&coldboot_lock);
+static void wake_coldboot_domains(struct sbi_scratch *scratch, u32 hartid)
+{
+	u32 i, j;
+	struct sbi_domain *dom;
+
+	sbi_domain_for_each(i, dom) {
+		if (dom == &root)
+			continue;
+
+		/*
+		 * The AMOs order marking a HART ready before claiming its
+		 * waiting bit so either the HART sees itself ready or we
+		 * see it waiting.
+		 */
+		sbi_hartmask_for_each_hart(j, &dom->assigned_harts) {
+			if (j == hartid)
+				continue;
+			atomic_raw_set_bit(j, coldboot_ready_hmask.bits);
+			if (atomic_raw_clear_bit(j, coldboot_wait_hmask.bits))
+				sbi_ipi_raw_send(j);
+		}
+	}
 }
 
 static unsigned long init_count_offset;
 
-static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
+static void __noreturn __init init_coldboot(struct sbi_scratch *scratch,
+					    u32 hartid)
 {
 	int rc;
 	unsigned long *init_count;
@@ -228,6 +349,17 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 	if (rc)
 		sbi_hart_hang();
 
+	/* Queued spinlocks work without their nodes so ignore failures */
+	qspin_lock_init();
+
+	rc = sbi_heap_init(scratch);
+	if (rc)
+		sbi_hart_hang();
+
+	rc = sbi_stack_check_init(scratch, TRUE);
+	if (rc)
+		sbi_hart_hang();
+
 	/* Note: This has to be second thing in coldboot init sequence */
 	rc = sbi_domain_init(scratch, hartid);
 	if (rc)
@@ -238,6 +370,10 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 	if (!init_count_offset)
 		sbi_hart_hang();
 
+	/* The boot timeline is only informational so ignore failures */
+	sbi_boot_timeline_init(scratch, TRUE);
+	sbi_boot_timeline_record(scratch, SBI_BOOT_PHASE_EARLY_INIT);
+
 	rc = sbi_hsm_init(scratch, hartid, TRUE);
 	if (rc)
 		sbi_hart_hang();
@@ -250,12 +386,16 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 	if (rc)
 		sbi_hart_hang();
 
+	sbi_boot_timeline_record(scratch, SBI_BOOT_PHASE_HART_INIT);
+
 	rc = sbi_console_init(scratch);
 	if (rc)
 		sbi_hart_hang();
 
 	sbi_boot_print_banner(scratch);
 
+	sbi_boot_timeline_record(scratch, SBI_BOOT_PHASE_CONSOLE_INIT);
+
 	rc = sbi_platform_irqchip_init(plat, TRUE);
 	if (rc) {
 		sbi_printf("%s: platform irqchip init failed (error %d)\n",
@@ -263,6 +403,8 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 		sbi_hart_hang();
 	}
 
+	sbi_boot_timeline_record(scratch, SBI_BOOT_PHASE_IRQCHIP_INIT);
+
 	rc = sbi_ipi_init(scratch, TRUE);
 	if (rc) {
 		sbi_printf("%s: ipi init failed (error %d)\n", __func__, rc);
@@ -275,18 +417,94 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 		sbi_hart_hang();
 	}
 
+	rc = sbi_cache_init(scratch, TRUE);
+	if (rc) {
+		sbi_printf("%s: cache init failed (error %d)\n", __func__, rc);
+		sbi_hart_hang();
+	}
+
+	rc = sbi_xcall_init(scratch, TRUE);
+	if (rc) {
+		sbi_printf("%s: xcall init failed (error %d)\n", __func__, rc);
+		sbi_hart_hang();
+	}
+
+	sbi_boot_timeline_record(scratch, SBI_BOOT_PHASE_IPI_INIT);
+
 	rc = sbi_timer_init(scratch, TRUE);
 	if (rc) {
 		sbi_printf("%s: timer init failed (error %d)\n", __func__, rc);
 		sbi_hart_hang();
 	}
 
+	sbi_boot_timeline_record(scratch, SBI_BOOT_PHASE_TIMER_INIT);
+
+	/*
+	 * The self-test times out with the timer and other HARTs only use
+	 * IPIs once they are woken up below
+	 */
+	if (scratch->options & SBI_SCRATCH_IPI_SELFTEST)
+		sbi_ipi_selftest(scratch, coldboot_waiting_peer(hartid));
+
+	rc = sbi_pmu_init(scratch, TRUE);
+	if (rc) {
+		sbi_printf("%s: pmu init failed (error %d)\n", __func__, rc);
+		sbi_hart_hang();
+	}
+
+	rc = sbi_misaligned_ldst_init(scratch, TRUE);
+	if (rc)
+		sbi_printf("%s: misaligned insn cache init failed (error %d)\n",
+			   __func__, rc);
+
+	rc = sbi_trap_stats_init(scratch, TRUE);
+	if (rc)
+		sbi_printf("%s: trap stats init failed (error %d)\n",
+			   __func__, rc);
+
+	rc = sbi_trace_init(scratch, TRUE);
+	if (rc)
+		sbi_printf("%s: trace init failed (error %d)\n",
+			   __func__, rc);
+
+	rc = sbi_lock_stats_init(scratch, TRUE);
+	if (rc)
+		sbi_printf("%s: lock stats init failed (error %d)\n",
+			   __func__, rc);
+
+	rc = sbi_measure_init(scratch, TRUE);
+	if (rc)
+		sbi_printf("%s: measure init failed (error %d)\n",
+			   __func__, rc);
+
+	rc = sbi_pmu_sample_init(scratch, TRUE);
+	if (rc)
+		sbi_printf("%s: pmu sample init failed (error %d)\n",
+			   __func__, rc);
+
+	rc = sbi_pmp_swap_init(scratch, TRUE);
+	if (rc)
+		sbi_printf("%s: pmp swap init failed (error %d)\n",
+			   __func__, rc);
+
+	rc = sbi_sta_init(scratch, TRUE);
+	if (rc)
+		sbi_printf("%s: steal time init failed (error %d)\n",
+			   __func__, rc);
+
+	sbi_boot_timeline_record(scratch, SBI_BOOT_PHASE_PMU_INIT);
+
 	rc = sbi_ecall_init();
 	if (rc) {
 		sbi_printf("%s: ecall init failed (error %d)\n", __func__, rc);
 		sbi_hart_hang();
 	}
 
+	sbi_boot_timeline_record(scratch, SBI_BOOT_PHASE_ECALL_INIT);
+
+	/* Let other HARTs do their per-HART initialization in parallel */
+	wake_coldboot_harts(scratch, hartid, COLDBOOT_STAGE_GLOBAL);
+
 	sbi_boot_print_general(scratch);
 
 	/*
@@ -302,8 +520,23 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 		sbi_hart_hang();
 	}
 
+	rc = sbi_domain_context_init(scratch, TRUE);
+	if (rc) {
+		sbi_printf("%s: domain context init failed (error %d)\n",
+			   __func__, rc);
+		sbi_hart_hang();
+	}
+
+	/* The timer was initialized before the domain got its extensions */
+	sbi_timer_event_fast_path_update();
+
+	/* Let non-root domains boot without waiting for cold boot */
+	wake_coldboot_domains(scratch, hartid);
+
 	sbi_boot_print_domains(scratch);
 
+	sbi_boot_timeline_record(scratch, SBI_BOOT_PHASE_DOMAIN_FINALIZE);
+
 	rc = sbi_hart_pmp_configure(scratch);
 	if (rc) {
 		sbi_printf("%s: PMP configure failed (error %d)\n",
@@ -311,6 +544,8 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 		sbi_hart_hang();
 	}
 
+	sbi_boot_timeline_record(scratch, SBI_BOOT_PHASE_PMP_CONFIGURE);
+
 	/*
 	 * Note: Platform final initialization should be last so that
 	 * it sees correct domain assignment and PMP configuration.
@@ -322,14 +557,24 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 		sbi_hart_hang();
 	}
 
+	sbi_boot_timeline_record(scratch, SBI_BOOT_PHASE_FINAL_INIT);
+
 	sbi_boot_print_hart(scratch, hartid);
 
-	wake_coldboot_harts(scratch, hartid);
+	wake_coldboot_harts(scratch, hartid, COLDBOOT_STAGE_DONE);
+
+	/* Measure while the other HARTs finish their own initialization */
+	sbi_measure_boot(scratch);
 
 	init_count = sbi_scratch_offset_ptr(scratch, init_count_offset);
 	(*init_count)++;
 
 	sbi_hsm_prepare_next_jump(scratch, hartid);
+	sbi_boot_timeline_record(scratch, SBI_BOOT_PHASE_NEXT_STAGE);
+
+	/* No __init code runs after this */
+	sbi_domain_fw_init_reclaim(scratch);
+
 	sbi_hart_switch_mode(hartid, scratch->next_arg1, scratch->next_addr,
 			     scratch->next_mode, FALSE);
 }
@@ -343,6 +588,13 @@ static void init_warm_startup(struct sbi_scratch *scratch, u32 hartid)
 	if (!init_count_offset)
 		sbi_hart_hang();
 
+	rc = sbi_stack_check_init(scratch, FALSE);
+	if (rc)
+		sbi_hart_hang();
+
+	sbi_boot_timeline_init(scratch, FALSE);
+	sbi_boot_timeline_record(scratch, SBI_BOOT_PHASE_EARLY_INIT);
+
 	rc = sbi_hsm_init(scratch, hartid, FALSE);
 	if (rc)
 		sbi_hart_hang();
@@ -355,10 +607,14 @@ static void init_warm_startup(struct sbi_scratch *scratch, u32 hartid)
 	if (rc)
 		sbi_hart_hang();
 
+	sbi_boot_timeline_record(scratch, SBI_BOOT_PHASE_HART_INIT);
+
 	rc = sbi_platform_irqchip_init(plat, FALSE);
 	if (rc)
 		sbi_hart_hang();
 
+	sbi_boot_timeline_record(scratch, SBI_BOOT_PHASE_IRQCHIP_INIT);
+
 	rc = sbi_ipi_init(scratch, FALSE);
 	if (rc)
 		sbi_hart_hang();
@@ -367,22 +623,64 @@ static void init_warm_startup(struct sbi_scratch *scratch, u32 hartid)
 	if (rc)
 		sbi_hart_hang();
 
+	rc = sbi_cache_init(scratch, FALSE);
+	if (rc)
+		sbi_hart_hang();
+
+	rc = sbi_xcall_init(scratch, FALSE);
+	if (rc)
+		sbi_hart_hang();
+
+	sbi_boot_timeline_record(scratch, SBI_BOOT_PHASE_IPI_INIT);
+
 	rc = sbi_timer_init(scratch, FALSE);
 	if (rc)
 		sbi_hart_hang();
 
+	sbi_boot_timeline_record(scratch, SBI_BOOT_PHASE_TIMER_INIT);
+
+	rc = sbi_pmu_init(scratch, FALSE);
+	if (rc)
+		sbi_hart_hang();
+
+	sbi_misaligned_ldst_init(scratch, FALSE);
+	sbi_sta_init(scratch, FALSE);
+	sbi_boot_timeline_record(scratch, SBI_BOOT_PHASE_PMU_INIT);
+
+	/* PMP configuration needs the final domain assignment */
+	wait_for_coldboot(scratch, hartid, COLDBOOT_STAGE_DONE);
+
+	sbi_boot_timeline_record(scratch, SBI_BOOT_PHASE_DOMAIN_FINALIZE);
+
+	rc = sbi_domain_context_init(scratch, FALSE);
+	if (rc)
+		sbi_hart_hang();
+
 	rc = sbi_hart_pmp_configure(scratch);
 	if (rc)
 		sbi_hart_hang();
 
+	sbi_boot_timeline_record(scratch, SBI_BOOT_PHASE_PMP_CONFIGURE);
+
 	rc = sbi_platform_final_init(plat, FALSE);
 	if (rc)
 		sbi_hart_hang();
 
+	sbi_boot_timeline_record(scratch, SBI_BOOT_PHASE_FINAL_INIT);
+
+	/*
+	 * Wait to be started only after the per-HART initialization so
+	 * that it is not serialized by the HARTs being started one after
+	 * another.
+	 */
+	sbi_hsm_hart_wait(scratch, hartid);
+	sbi_boot_timeline_record(scratch, SBI_BOOT_PHASE_HSM_START);
+
 	init_count = sbi_scratch_offset_ptr(scratch, init_count_offset);
 	(*init_count)++;
 
 	sbi_hsm_prepare_next_jump(scratch, hartid);
+	sbi_boot_timeline_record(scratch, SBI_BOOT_PHASE_NEXT_STAGE);
 }
 
 static void init_warm_resume(struct sbi_scratch *scratch)
@@ -391,7 +689,15 @@ static void init_warm_resume(struct sbi_scratch *scratch)
 
 	sbi_hsm_hart_resume_start(scratch);
 
-	rc = sbi_hart_reinit(scratch);
+	/*
+	 * Replay the M-mode CSRs saved before suspend which avoids
+	 * probing and re-initializing the HART. Devices are not warm
+	 * initialized on resume so the platform HART suspend must retain
+	 * (or restore) their state.
+	 */
+	rc = sbi_hart_csr_restore(scratch);
+	if (rc)
+		rc = sbi_hart_reinit(scratch);
 	if (rc)
 		sbi_hart_hang();
 
@@ -399,18 +705,32 @@ static void init_warm_resume(struct sbi_scratch *scratch)
 	if (rc)
 		sbi_hart_hang();
 
+	/* Only a few devices lose their state in a system suspend */
+	if (sbi_system_is_suspended()) {
+		rc = sbi_system_resume(scratch);
+		if (rc)
+			sbi_hart_hang();
+	}
+
 	sbi_hsm_hart_resume_finish(scratch);
 }
 
 static void __noreturn init_warmboot(struct sbi_scratch *scratch, u32 hartid)
 {
-	int hstate;
+	int hstate = SBI_HSM_STATE_STOPPED;
 
-	wait_for_coldboot(scratch, hartid);
+	wait_for_coldboot(scratch, hartid, COLDBOOT_STAGE_GLOBAL);
 
-	hstate = sbi_hsm_hart_get_state(sbi_domain_thishart_ptr(), hartid);
-	if (hstate < 0)
-		sbi_hart_hang();
+	/*
+	 * HARTs released before cold boot is done are always starting
+	 * up and their domain may still change so don't look it up.
+	 */
+	if (__smp_load_acquire(&coldboot_stage) == COLDBOOT_STAGE_DONE) {
+		hstate = sbi_hsm_hart_get_state(sbi_domain_thishart_ptr(),
+						hartid);
+		if (hstate < 0)
+			sbi_hart_hang();
+	}
 
 	if (hstate == SBI_HSM_STATE_SUSPENDED)
 		init_warm_resume(scratch);
@@ -447,6 +767,13 @@ void __noreturn sbi_init(struct sbi_scratch *scratch)
 	    sbi_platform_hart_invalid(plat, hartid))
 		sbi_hart_hang();
 
+	/*
+	 * Platform nascent initialization comes before anything else so
+	 * that a HART can receive IPIs from any IPI device while waiting.
+	 */
+	if (sbi_platform_nascent_init(plat))
+		sbi_hart_hang();
+
 	switch (scratch->next_mode) {
 	case PRV_M:
 		next_mode_supported = TRUE;
@@ -518,6 +845,8 @@ void __noreturn sbi_exit(struct sbi_scratch *scratch)
 
 	sbi_platform_early_exit(plat);
 
+	sbi_pmu_exit(scratch);
+
 	sbi_timer_exit(scratch);
 
 	sbi_ipi_exit(scratch);
@@ -12,34 +12,189 @@
 #include <sbi/riscv_atomic.h>
 #include <sbi/riscv_barrier.h>
 #include <sbi/sbi_bitops.h>
+#include <sbi/sbi_console.h>
 #include <sbi/sbi_domain.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_hart.h>
+#include <sbi/sbi_hartmask.h>
 #include <sbi/sbi_hsm.h>
 #include <sbi/sbi_init.h>
 #include <sbi/sbi_ipi.h>
 #include <sbi/sbi_platform.h>
+#include <sbi/sbi_pmu.h>
+#include <sbi/sbi_string.h>
+#include <sbi/sbi_timer.h>
+#include <sbi/sbi_trace.h>
+#include <sbi/sbi_trap_stats.h>
 
 struct sbi_ipi_data {
-	unsigned long ipi_type;
+	unsigned long ipi_type[BITS_TO_LONGS(SBI_IPI_EVENT_MAX)];
+	/* Events are polled by the HART instead of interrupting it */
+	unsigned long poll;
+	/* Low bits of the time when the doorbell was rung, zero if not */
+	unsigned long sent;
+};
+
+#define SBI_IPI_PAYLOAD_ALIGN		8
+
+/* Return values of sbi_ipi_update() other than errors and zero */
+#define SBI_IPI_UPDATE_PENDING		1
+#define SBI_IPI_UPDATE_LOCAL		2
+
+struct sbi_ipi_payload_slot {
+	/* Sequence number for lock-free producer/consumer handshake */
+	unsigned long seq;
+	/* Ring position reserved by the producer */
+	unsigned long pos;
+	u8 data[] __aligned(SBI_IPI_PAYLOAD_ALIGN);
+};
+
+struct sbi_ipi_payload_ring {
+	/* Next position to reserve (producers) */
+	atomic_t head;
+	/* Next position to consume (owner HART) */
+	unsigned long tail;
+	u8 slots[] __aligned(SBI_IPI_PAYLOAD_ALIGN);
+};
+
+struct sbi_ipi_payload_info {
+	unsigned long off;
+	unsigned long stride;
+	unsigned long count;
 };
 
 static unsigned long ipi_data_off;
 static const struct sbi_ipi_device *ipi_dev = NULL;
+static const struct sbi_ipi_device *ipi_smode_dev = NULL;
+/* Registered IPI devices and their self-test latency (0 if not tested) */
+static const struct sbi_ipi_device *ipi_devs[SBI_IPI_DEVICE_MAX];
+static unsigned long ipi_dev_cycles[SBI_IPI_DEVICE_MAX];
+static u32 ipi_dev_count;
+/* HART which answers the outstanding self-test IPI, -1U if none */
+static u32 ipi_selftest_peer = -1U;
+static u32 ipi_selftest_hartid = -1U;
+static u32 ipi_selftest_tested = -1U;
+static u64 ipi_selftest_timeout;
 static const struct sbi_ipi_event_ops *ipi_ops_array[SBI_IPI_EVENT_MAX];
+static u32 ipi_event_order[SBI_IPI_EVENT_MAX];
+/* Position of each event in ipi_event_order, ipi_event_count if unused */
+static u32 ipi_event_rank[SBI_IPI_EVENT_MAX];
+static u32 ipi_event_count;
+static struct sbi_ipi_payload_info ipi_payload_info[SBI_IPI_EVENT_MAX];
+static u32 ipi_halt_event = SBI_IPI_EVENT_MAX;
+
+static bool sbi_ipi_event_before(u32 a, u32 b)
+{
+	const struct sbi_ipi_event_ops *aops = ipi_ops_array[a];
+	const struct sbi_ipi_event_ops *bops = ipi_ops_array[b];
+
+	if (aops->deferred != bops->deferred)
+		return bops->deferred;
+	if (aops->priority != bops->priority)
+		return aops->priority > bops->priority;
+
+	return a < b;
+}
+
+static void sbi_ipi_event_sort(void)
+{
+	u32 i, j, ev;
+
+	ipi_event_count = 0;
+	for (i = 0; i < SBI_IPI_EVENT_MAX; i++) {
+		if (!ipi_ops_array[i])
+			continue;
+		for (j = ipi_event_count; j > 0; j--) {
+			ev = ipi_event_order[j - 1];
+			if (sbi_ipi_event_before(ev, i))
+				break;
+			ipi_event_order[j] = ev;
+		}
+		ipi_event_order[j] = i;
+		ipi_event_count++;
+	}
 
-static int sbi_ipi_send(struct sbi_scratch *scratch, u32 remote_hartid,
-			u32 event, void *data)
+	for (i = 0; i < SBI_IPI_EVENT_MAX; i++)
+		ipi_event_rank[i] = ipi_event_count;
+	for (i = 0; i < ipi_event_count; i++)
+		ipi_event_rank[ipi_event_order[i]] = i;
+}
+
+/* Pick the pending event which comes first, SBI_IPI_EVENT_MAX if none */
+static u32 sbi_ipi_event_first(const unsigned long *ipi_type)
+{
+	u32 w, ev, best = SBI_IPI_EVENT_MAX, best_rank = ipi_event_count;
+	unsigned long m;
+
+	for (w = 0; w < BITS_TO_LONGS(SBI_IPI_EVENT_MAX); w++) {
+		/* Jump directly between the set bits */
+		for (m = ipi_type[w]; m; m &= m - 1) {
+			ev = w * BITS_PER_LONG + __ffs(m);
+			if (ipi_event_rank[ev] < best_rank) {
+				best = ev;
+				best_rank = ipi_event_rank[ev];
+			}
+		}
+	}
+
+	return best;
+}
+
+static bool sbi_ipi_data_pending(struct sbi_ipi_data *ipi_data)
+{
+	u32 i;
+
+	for (i = 0; i < array_size(ipi_data->ipi_type); i++) {
+		if (ipi_data->ipi_type[i])
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/*
+ * Set IPI type on remote hart's scratch area after the data written
+ * by the update callback. The operation is fully ordered so that
+ * the poll flag read below pairs with sbi_ipi_poll_set().
+ */
+static int sbi_ipi_set_pending(struct sbi_ipi_data *ipi_data,
+			       u32 remote_hartid, u32 event)
+{
+	unsigned long old;
+
+	old = atomic_raw_fetch_or_ulong(&ipi_data->ipi_type[BIT_WORD(event)],
+					BIT_MASK(event));
+	sbi_trace(SBI_TRACE_IPI_SEND, event, remote_hartid);
+
+	/* A polling HART picks the event up by itself, except for halt */
+	if (ipi_data->poll && event != ipi_halt_event)
+		return SBI_IPI_UPDATE_PENDING;
+
+	/*
+	 * The remote HART fetches each word of its IPI types with a single
+	 * exchange so any bit already set in the word belongs to an IPI it
+	 * has not fetched yet. Whoever set the first of them triggers the
+	 * interrupt which also picks up our event.
+	 */
+	if (old)
+		return SBI_IPI_UPDATE_PENDING;
+
+#ifdef SBI_TRAP_STATS
+	/* Bit 0 is set so that a stamp never reads as no stamp */
+	atomic_raw_cmpxchg_ulong_relaxed(&ipi_data->sent, 0,
+					 (unsigned long)sbi_timer_value() | 1);
+#endif
+
+	return 0;
+}
+
+static int sbi_ipi_update(struct sbi_scratch *scratch, u32 remote_hartid,
+			  u32 event, void *data)
 {
 	int ret;
 	struct sbi_scratch *remote_scratch = NULL;
 	struct sbi_ipi_data *ipi_data;
-	const struct sbi_ipi_event_ops *ipi_ops;
-
-	if ((SBI_IPI_EVENT_MAX <= event) ||
-	    !ipi_ops_array[event])
-		return SBI_EINVAL;
-	ipi_ops = ipi_ops_array[event];
+	const struct sbi_ipi_event_ops *ipi_ops = ipi_ops_array[event];
 
 	remote_scratch = sbi_hartid_to_scratch(remote_hartid);
 	if (!remote_scratch)
@@ -55,70 +210,347 @@ static int sbi_ipi_send(struct sbi_scratch *scratch, u32 remote_hartid,
 	}
 
 	/*
-	 * Set IPI type on remote hart's scratch area and
-	 * trigger the interrupt
+	 * An event for the current HART is processed by the caller once all
+	 * remote HARTs are interrupted instead of taking a second trap. This
+	 * is done only when nothing else is pending so that the order of the
+	 * events of the current HART is kept.
 	 */
-	atomic_raw_set_bit(event, &ipi_data->ipi_type);
-	smp_wmb();
+	if (remote_scratch == scratch && !sbi_ipi_data_pending(ipi_data)) {
+		sbi_trace(SBI_TRACE_IPI_SEND, event, remote_hartid);
+		return SBI_IPI_UPDATE_LOCAL;
+	}
 
-	if (ipi_dev && ipi_dev->ipi_send)
-		ipi_dev->ipi_send(remote_hartid);
+	return sbi_ipi_set_pending(ipi_data, remote_hartid, event);
+}
 
-	if (ipi_ops->sync)
-		ipi_ops->sync(scratch);
+static void sbi_ipi_update_many(struct sbi_scratch *scratch, ulong hbase,
+				ulong m, u32 event, void *data,
+				struct sbi_hartmask_sparse *targets,
+				bool *local)
+{
+	int ret;
+	ulong i;
 
-	return 0;
+	for (i = hbase; m; i++, m >>= 1) {
+		if (!(m & 1UL))
+			continue;
+		ret = sbi_ipi_update(scratch, i, event, data);
+		if (!ret)
+			sbi_hartmask_sparse_set_hart(i, targets);
+		else if (ret == SBI_IPI_UPDATE_LOCAL)
+			*local = TRUE;
+	}
+}
+
+/*
+ * Token bucket of the domain kept as the time at which it is full again
+ * (generic cell rate algorithm). A request past the burst is delayed
+ * until its token is earned instead of failing, S-mode has no way to
+ * retry a failed remote fence. The slot is taken under the lock and the
+ * wait done outside so that delayed requests keep their order.
+ */
+static void sbi_ipi_rate_limit(struct sbi_domain *dom)
+{
+	u64 now, tat, limit;
+
+	spin_lock(&dom->ipi_rate_lock);
+	now = sbi_timer_value();
+	tat = (dom->ipi_rate_tat < now) ? now : dom->ipi_rate_tat;
+	dom->ipi_rate_tat = tat + dom->ipi_rate_interval;
+	limit = now + (u64)dom->ipi_rate_interval * (dom->ipi_rate_burst - 1);
+	if (tat > limit)
+		dom->ipi_throttled++;
+	spin_unlock(&dom->ipi_rate_lock);
+
+	if (tat <= limit)
+		return;
+
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_IPI_THROTTLED);
+	while (sbi_timer_value() < now + (tat - limit))
+		;
+}
+
+void sbi_ipi_rate_dump(void)
+{
+	u32 i;
+	struct sbi_domain *dom;
+
+	sbi_domain_for_each(i, dom) {
+		if (dom->ipi_rate_interval)
+			sbi_printf("Domain%d IPI requests: %lu throttled\n",
+				   i, dom->ipi_throttled);
+	}
 }
 
 /**
  * As this this function only handlers scalar values of hart mask, it must be
  * set to all online harts if the intention is to send IPIs to all the harts.
  * If hmask is zero, no IPIs will be sent.
+ *
+ * The IPIs are sent in three phases: first the event is updated for all
+ * remote HARTs, then the interrupts are triggered back-to-back and finally
+ * we wait once for all remote HARTs using the sync callback. Remote HARTs
+ * which still have an event pending are not interrupted again.
+ *
+ * Suspended HARTs are interruptible so an IPI wakes them up, unless the
+ * update callback of the event defers the work to resume time. Remote
+ * fences are deferred this way (see sbi_tlb_lazy_enter()) whereas S-mode
+ * software interrupts and halt requests always wake the HART.
+ *
+ * The targets are collected in a sparse hartmask so that the cost of a
+ * request depends on the HARTs it reaches rather than on the maximum
+ * number of HARTs.
+ *
+ * An event for the current HART is processed directly after the remote
+ * HARTs are interrupted, without a doorbell write and a second trap.
+ *
+ * Requests interrupting remote HARTs are rate limited per domain (except
+ * halt requests) so that a domain flooding IPIs and remote fences does
+ * not slow down the interrupt controller and firmware locks shared with
+ * other domains.
  */
-int sbi_ipi_send_many(ulong hmask, ulong hbase, u32 event, void *data)
+int __hot sbi_ipi_send_many(ulong hmask, ulong hbase, u32 event, void *data)
 {
 	int rc;
-	ulong i, m;
+	u32 i, w;
+	ulong m;
+	bool local = FALSE;
+	struct sbi_hartmask_sparse targets;
+	const struct sbi_ipi_event_ops *ipi_ops;
 	struct sbi_domain *dom = sbi_domain_thishart_ptr();
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
 
+	if ((SBI_IPI_EVENT_MAX <= event) ||
+	    !ipi_ops_array[event])
+		return SBI_EINVAL;
+	ipi_ops = ipi_ops_array[event];
+
+	/* Update event for all remote HARTs */
+	SBI_HARTMASK_SPARSE_INIT(&targets);
 	if (hbase != -1UL) {
 		rc = sbi_hsm_hart_interruptible_mask(dom, hbase, &m);
 		if (rc)
 			return rc;
 		m &= hmask;
 
-		/* Send IPIs */
-		for (i = hbase; m; i++, m >>= 1) {
-			if (m & 1UL)
-				sbi_ipi_send(scratch, i, event, data);
-		}
+		sbi_ipi_update_many(scratch, hbase, m, event, data,
+				    &targets, &local);
 	} else {
 		hbase = 0;
 		while (!sbi_hsm_hart_interruptible_mask(dom, hbase, &m)) {
-			/* Send IPIs */
-			for (i = hbase; m; i++, m >>= 1) {
-				if (m & 1UL)
-					sbi_ipi_send(scratch, i, event, data);
-			}
+			sbi_ipi_update_many(scratch, hbase, m,
+					    event, data, &targets, &local);
 			hbase += BITS_PER_LONG;
 		}
 	}
 
+	if (dom->ipi_rate_interval && targets.summary &&
+	    event != ipi_halt_event)
+		sbi_ipi_rate_limit(dom);
+
+	/* Make event updates visible before triggering interrupts */
+	smp_wmb();
+
+	/* Trigger interrupts for all remote HARTs */
+	if (ipi_dev && ipi_dev->ipi_send_mask) {
+		sbi_hartmask_sparse_for_each_word(w, &targets)
+			ipi_dev->ipi_send_mask(targets.bits[w],
+					       w * BITS_PER_LONG);
+	} else if (ipi_dev && ipi_dev->ipi_send) {
+		sbi_hartmask_sparse_for_each_word(w, &targets) {
+			for_each_set_bit(i, &targets.bits[w], BITS_PER_LONG)
+				ipi_dev->ipi_send(w * BITS_PER_LONG + i);
+		}
+	}
+
+	if (local) {
+		sbi_trace(SBI_TRACE_IPI_RECV, event, 0);
+		ipi_ops->process(scratch);
+	}
+
+	/* Wait once for all remote HARTs */
+	if (ipi_ops->sync)
+		ipi_ops->sync(scratch);
+
+	return 0;
+}
+
+/**
+ * Raise an event on a remote HART without calling the update and sync
+ * callbacks of the event
+ *
+ * This is meant for the process callback of an event forwarding work
+ * which it has already queued for the remote HART, so it never waits
+ * and can be called from any context.
+ */
+int sbi_ipi_raise(u32 hartid, u32 event)
+{
+	struct sbi_scratch *remote_scratch;
+
+	if (SBI_IPI_EVENT_MAX <= event || !ipi_ops_array[event])
+		return SBI_EINVAL;
+
+	remote_scratch = sbi_hartid_to_scratch(hartid);
+	if (!remote_scratch)
+		return SBI_EINVAL;
+
+	if (!sbi_ipi_set_pending(sbi_scratch_offset_ptr(remote_scratch,
+							ipi_data_off),
+				 hartid, event))
+		sbi_ipi_raw_send(hartid);
+
+	return 0;
+}
+
+static struct sbi_ipi_payload_ring *sbi_ipi_payload_ring(
+				struct sbi_scratch *scratch, u32 event)
+{
+	if (SBI_IPI_EVENT_MAX <= event || !ipi_payload_info[event].off)
+		return NULL;
+
+	return sbi_scratch_offset_ptr(scratch, ipi_payload_info[event].off);
+}
+
+static struct sbi_ipi_payload_slot *sbi_ipi_payload_slot(
+				struct sbi_ipi_payload_ring *ring,
+				u32 event, unsigned long pos)
+{
+	const struct sbi_ipi_payload_info *info = &ipi_payload_info[event];
+
+	return (void *)&ring->slots[(pos % info->count) * info->stride];
+}
+
+static int sbi_ipi_payload_create(u32 event,
+				  const struct sbi_ipi_event_ops *ops)
+{
+	u32 i;
+	unsigned long pos;
+	struct sbi_scratch *rscratch;
+	struct sbi_ipi_payload_ring *ring;
+	struct sbi_ipi_payload_info *info = &ipi_payload_info[event];
+
+	if (!ops->payload_size || !ops->payload_count)
+		return 0;
+
+	info->stride = ROUNDUP(sizeof(struct sbi_ipi_payload_slot) +
+			       ops->payload_size, SBI_IPI_PAYLOAD_ALIGN);
+	info->count = ops->payload_count;
+	/* The ring head is reserved by remote HARTs */
+	info->off = sbi_scratch_alloc_remote_offset(sizeof(*ring) +
+					info->count * info->stride,
+					"IPI_PAYLOAD");
+	if (!info->off)
+		return SBI_ENOMEM;
+
+	/* Slot N of an empty ring expects producer position N */
+	for (i = 0; i <= sbi_scratch_last_hartid(); i++) {
+		rscratch = sbi_hartid_to_scratch(i);
+		if (!rscratch)
+			continue;
+		ring = sbi_ipi_payload_ring(rscratch, event);
+		ATOMIC_INIT(&ring->head, 0);
+		ring->tail = 0;
+		for (pos = 0; pos < info->count; pos++)
+			sbi_ipi_payload_slot(ring, event, pos)->seq = pos;
+	}
+
 	return 0;
 }
 
+/**
+ * Reserve a payload entry in the payload ring of a remote HART
+ *
+ * This can be called concurrently by any number of HARTs. The returned
+ * entry is owned by the caller until sbi_ipi_payload_commit() is called.
+ * Returns NULL if the event has no payload ring or the ring is full.
+ */
+void *sbi_ipi_payload_reserve(struct sbi_scratch *remote_scratch, u32 event)
+{
+	long pos, diff;
+	struct sbi_ipi_payload_slot *slot;
+	struct sbi_ipi_payload_ring *ring =
+			sbi_ipi_payload_ring(remote_scratch, event);
+
+	if (!ring)
+		return NULL;
+
+	pos = atomic_read(&ring->head);
+	while (1) {
+		slot = sbi_ipi_payload_slot(ring, event, pos);
+		diff = (long)__smp_load_acquire(&slot->seq) - pos;
+		if (diff < 0)
+			return NULL;
+		if (!diff && atomic_cmpxchg(&ring->head, pos, pos + 1) == pos)
+			break;
+		pos = atomic_read(&ring->head);
+	}
+
+	slot->pos = pos;
+
+	return slot->data;
+}
+
+/** Make a reserved payload entry visible to the owner HART */
+void sbi_ipi_payload_commit(void *payload)
+{
+	struct sbi_ipi_payload_slot *slot =
+		container_of(payload, struct sbi_ipi_payload_slot, data);
+
+	__smp_store_release(&slot->seq, slot->pos + 1);
+}
+
+/**
+ * Get the oldest committed payload entry of the current HART
+ *
+ * This must be called only by the HART owning the payload ring and
+ * the entry stays valid until sbi_ipi_payload_release() is called.
+ * Returns NULL if there is no committed entry.
+ */
+void *sbi_ipi_payload_peek(struct sbi_scratch *scratch, u32 event)
+{
+	struct sbi_ipi_payload_slot *slot;
+	struct sbi_ipi_payload_ring *ring = sbi_ipi_payload_ring(scratch, event);
+
+	if (!ring)
+		return NULL;
+
+	slot = sbi_ipi_payload_slot(ring, event, ring->tail);
+	if (__smp_load_acquire(&slot->seq) != ring->tail + 1)
+		return NULL;
+
+	return slot->data;
+}
+
+/** Release the payload entry returned by sbi_ipi_payload_peek() */
+void sbi_ipi_payload_release(struct sbi_scratch *scratch, u32 event)
+{
+	struct sbi_ipi_payload_slot *slot;
+	struct sbi_ipi_payload_ring *ring = sbi_ipi_payload_ring(scratch, event);
+
+	if (!ring)
+		return;
+
+	slot = sbi_ipi_payload_slot(ring, event, ring->tail);
+	__smp_store_release(&slot->seq,
+			    ring->tail + ipi_payload_info[event].count);
+	ring->tail++;
+}
+
 int sbi_ipi_event_create(const struct sbi_ipi_event_ops *ops)
 {
-	int i, ret = SBI_ENOSPC;
+	int i, rc, ret = SBI_ENOSPC;
 
 	if (!ops || !ops->process)
 		return SBI_EINVAL;
 
 	for (i = 0; i < SBI_IPI_EVENT_MAX; i++) {
 		if (!ipi_ops_array[i]) {
+			rc = sbi_ipi_payload_create(i, ops);
+			if (rc)
+				return rc;
 			ret = i;
 			ipi_ops_array[i] = ops;
+			sbi_ipi_event_sort();
 			break;
 		}
 	}
@@ -131,27 +563,88 @@ void sbi_ipi_event_destroy(u32 event)
 	if (SBI_IPI_EVENT_MAX <= event)
 		return;
 
+	if (ipi_payload_info[event].off) {
+		sbi_scratch_free_offset(ipi_payload_info[event].off);
+		ipi_payload_info[event].off = 0;
+	}
+
 	ipi_ops_array[event] = NULL;
+	sbi_ipi_event_sort();
 }
 
 static void sbi_ipi_process_smode(struct sbi_scratch *scratch)
 {
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_IPI_RECVD);
 	csr_set(CSR_MIP, MIP_SSIP);
 }
 
 static struct sbi_ipi_event_ops ipi_smode_ops = {
 	.name = "IPI_SMODE",
+	.priority = SBI_IPI_EVENT_PRIO_HIGH,
 	.process = sbi_ipi_process_smode,
 };
 
 static u32 ipi_smode_event = SBI_IPI_EVENT_MAX;
 
-int sbi_ipi_send_smode(ulong hmask, ulong hbase)
+static void sbi_ipi_smode_raise(ulong hmask, ulong hbase)
 {
-	return sbi_ipi_send_many(hmask, hbase, ipi_smode_event, NULL);
+	ulong i;
+	u32 hartid = current_hartid();
+
+	/* The current HART raises its own S-mode IPI without the device */
+	if (hbase <= hartid && hartid - hbase < BITS_PER_LONG &&
+	    (hmask & BIT(hartid - hbase))) {
+		hmask &= ~BIT(hartid - hbase);
+		csr_set(CSR_MIP, MIP_SSIP);
+	}
+
+	if (!hmask)
+		return;
+
+	if (ipi_smode_dev->ipi_send_mask) {
+		ipi_smode_dev->ipi_send_mask(hmask, hbase);
+		return;
+	}
+
+	for (i = hbase; hmask; i++, hmask >>= 1) {
+		if (hmask & 1UL)
+			ipi_smode_dev->ipi_send(i);
+	}
+}
+
+int __hot sbi_ipi_send_smode(ulong hmask, ulong hbase)
+{
+	int rc;
+	ulong m;
+	struct sbi_domain *dom;
+
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_IPI_SENT);
+
+	if (!ipi_smode_dev)
+		return sbi_ipi_send_many(hmask, hbase, ipi_smode_event, NULL);
+
+	/*
+	 * The supervisor software interrupt device raises the S-mode
+	 * IPI directly so the target HARTs never trap into M-mode.
+	 */
+	dom = sbi_domain_thishart_ptr();
+	if (hbase != -1UL) {
+		rc = sbi_hsm_hart_interruptible_mask(dom, hbase, &m);
+		if (rc)
+			return rc;
+		sbi_ipi_smode_raise(m & hmask, hbase);
+	} else {
+		hbase = 0;
+		while (!sbi_hsm_hart_interruptible_mask(dom, hbase, &m)) {
+			sbi_ipi_smode_raise(m, hbase);
+			hbase += BITS_PER_LONG;
+		}
+	}
+
+	return 0;
 }
 
-void sbi_ipi_clear_smode(void)
+void __hot sbi_ipi_clear_smode(void)
 {
 	csr_clear(CSR_MIP, MIP_SSIP);
 }
@@ -163,62 +656,334 @@ static void sbi_ipi_process_halt(struct sbi_scratch *scratch)
 
 static struct sbi_ipi_event_ops ipi_halt_ops = {
 	.name = "IPI_HALT",
+	.priority = SBI_IPI_EVENT_PRIO_NORMAL,
 	.process = sbi_ipi_process_halt,
 };
 
-static u32 ipi_halt_event = SBI_IPI_EVENT_MAX;
-
 int sbi_ipi_send_halt(ulong hmask, ulong hbase)
 {
 	return sbi_ipi_send_many(hmask, hbase, ipi_halt_event, NULL);
 }
 
-void sbi_ipi_process(void)
+static void sbi_ipi_fetch(struct sbi_ipi_data *ipi_data,
+			  unsigned long *ipi_type)
+{
+	u32 i;
+
+	for (i = 0; i < array_size(ipi_data->ipi_type); i++) {
+		if (ipi_data->ipi_type[i])
+			ipi_type[i] |= atomic_raw_xchg_ulong_acquire(
+						&ipi_data->ipi_type[i], 0);
+	}
+}
+
+void __hot sbi_ipi_process(void)
 {
-	unsigned long ipi_type;
-	unsigned int ipi_event;
+	u32 i, ipi_event;
+	unsigned long ipi_type[BITS_TO_LONGS(SBI_IPI_EVENT_MAX)] = { 0 };
 	const struct sbi_ipi_event_ops *ipi_ops;
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
 	struct sbi_ipi_data *ipi_data =
 			sbi_scratch_offset_ptr(scratch, ipi_data_off);
-	u32 hartid = current_hartid();
+	u32 hartid = scratch->hartid;
+#ifdef SBI_TRAP_STATS
+	u64 now;
+	unsigned long sent;
+#endif
+
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_IPI_PROCESS);
 
 	if (ipi_dev && ipi_dev->ipi_clear)
 		ipi_dev->ipi_clear(hartid);
 
-	ipi_type = atomic_raw_xchg_ulong(&ipi_data->ipi_type, 0);
-	ipi_event = 0;
-	while (ipi_type) {
-		if (!(ipi_type & 1UL))
-			goto skip;
+#ifdef SBI_TRAP_STATS
+	/* The stamp only holds XLEN bits of time so rebuild it from now */
+	sent = atomic_raw_xchg_ulong(&ipi_data->sent, 0);
+	if (sent) {
+		now = sbi_timer_value();
+		sent = (unsigned long)now - (sent & ~1UL);
+		sbi_trap_stats_latency(SBI_TRAP_STATS_LATENCY_IPI,
+				       now - sent, now);
+	}
+#endif
+
+	/*
+	 * Fast path for a lone S-mode IPI, the most frequent case. Events
+	 * raised after this check also re-trigger the M-mode IPI so they
+	 * will be handled by the next invocation.
+	 */
+	ipi_type[0] = atomic_raw_xchg_ulong(&ipi_data->ipi_type[0], 0);
+	if (ipi_smode_event < BITS_PER_LONG &&
+	    ipi_type[0] == BIT(ipi_smode_event)) {
+		for (i = 1; i < array_size(ipi_data->ipi_type); i++) {
+			if (ipi_data->ipi_type[i])
+				break;
+		}
+		if (i == array_size(ipi_data->ipi_type)) {
+			sbi_pmu_ctr_incr_fw(SBI_PMU_FW_IPI_RECVD);
+			sbi_trace(SBI_TRACE_IPI_RECV, ipi_smode_event, 0);
+			csr_set(CSR_MIP, MIP_SSIP);
+			return;
+		}
+	}
+
+	sbi_ipi_fetch(ipi_data, ipi_type);
+	while (1) {
+		ipi_event = sbi_ipi_event_first(ipi_type);
+		if (ipi_event == SBI_IPI_EVENT_MAX)
+			break;
+		ipi_type[BIT_WORD(ipi_event)] &= ~BIT_MASK(ipi_event);
 
+		sbi_trace(SBI_TRACE_IPI_RECV, ipi_event, 0);
 		ipi_ops = ipi_ops_array[ipi_event];
 		if (ipi_ops && ipi_ops->process)
 			ipi_ops->process(scratch);
 
-skip:
-		ipi_type = ipi_type >> 1;
-		ipi_event++;
+		/*
+		 * Pick up events raised while processing so that they
+		 * are ordered against the remaining pending events.
+		 */
+		sbi_ipi_fetch(ipi_data, ipi_type);
 	};
 }
 
-void sbi_ipi_raw_send(u32 target_hart)
+/**
+ * Process the IPI events of a HART in polling mode
+ *
+ * This is called on every SBI call and in the retentive suspend loop.
+ * It returns TRUE when events were processed.
+ */
+bool __hot sbi_ipi_poll(struct sbi_scratch *scratch)
+{
+	struct sbi_ipi_data *ipi_data =
+			sbi_scratch_offset_ptr(scratch, ipi_data_off);
+
+	if (!ipi_data->poll || !sbi_ipi_data_pending(ipi_data))
+		return FALSE;
+
+	sbi_ipi_process();
+	return TRUE;
+}
+
+bool sbi_ipi_poll_get(struct sbi_scratch *scratch)
+{
+	struct sbi_ipi_data *ipi_data =
+			sbi_scratch_offset_ptr(scratch, ipi_data_off);
+
+	return (ipi_data->poll) ? TRUE : FALSE;
+}
+
+/**
+ * Switch IPI polling mode of the current HART
+ *
+ * In polling mode events (except halt) are queued without an interrupt
+ * so a HART dedicated to real-time work is not disrupted at random
+ * times. Events are then handled on the next SBI call of the HART or
+ * while it is in retentive suspend, so the HART must call into the
+ * firmware regularly for remote fences of other HARTs to complete.
+ */
+int sbi_ipi_poll_set(struct sbi_scratch *scratch, bool enable)
+{
+	struct sbi_ipi_data *ipi_data =
+			sbi_scratch_offset_ptr(scratch, ipi_data_off);
+
+	ipi_data->poll = (enable) ? 1 : 0;
+	if (enable)
+		return 0;
+
+	/* Events queued before senders see the flag get no doorbell */
+	smp_mb();
+	if (sbi_ipi_data_pending(ipi_data))
+		sbi_ipi_process();
+
+	return 0;
+}
+
+void __hot sbi_ipi_raw_send(u32 target_hart)
 {
 	if (ipi_dev && ipi_dev->ipi_send)
 		ipi_dev->ipi_send(target_hart);
 }
 
+void __hot sbi_ipi_raw_clear(u32 target_hart)
+{
+	if (ipi_dev && ipi_dev->ipi_clear)
+		ipi_dev->ipi_clear(target_hart);
+}
+
 const struct sbi_ipi_device *sbi_ipi_get_device(void)
 {
 	return ipi_dev;
 }
 
+/**
+ * Register an IPI device
+ *
+ * The first registered device is used unless sbi_ipi_selftest() picks
+ * a faster one.
+ */
 void sbi_ipi_set_device(const struct sbi_ipi_device *dev)
 {
-	if (!dev || ipi_dev)
+	u32 i;
+
+	if (!dev)
+		return;
+
+	for (i = 0; i < ipi_dev_count; i++) {
+		if (ipi_devs[i] == dev)
+			return;
+	}
+	if (ipi_dev_count < SBI_IPI_DEVICE_MAX)
+		ipi_devs[ipi_dev_count++] = dev;
+
+	if (!ipi_dev)
+		ipi_dev = dev;
+}
+
+/* Wait for MSIP of the calling HART to be set or cleared, FALSE on timeout */
+static bool sbi_ipi_selftest_wait(bool pending)
+{
+	u64 start = sbi_timer_value();
+
+	while (((csr_read(CSR_MIP) & MIP_MSIP) ? TRUE : FALSE) != pending) {
+		if (sbi_timer_value() - start > ipi_selftest_timeout)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+void sbi_ipi_selftest_reply(struct sbi_scratch *scratch)
+{
+	u32 hartid = scratch->hartid;
+
+	if (__smp_load_acquire(&ipi_selftest_peer) != hartid ||
+	    !(csr_read(CSR_MIP) & MIP_MSIP))
+		return;
+
+	/* The next round must not see this IPI still pending */
+	ipi_dev->ipi_clear(hartid);
+	sbi_ipi_selftest_wait(FALSE);
+
+	__smp_store_release(&ipi_selftest_peer, -1U);
+	ipi_dev->ipi_send(ipi_selftest_hartid);
+}
+
+/* Best round trip of the current device in cycles, 0 if it failed */
+static unsigned long sbi_ipi_selftest_device(struct sbi_scratch *scratch,
+					     u32 peer)
+{
+	u32 i, hartid = scratch->hartid;
+	unsigned long start, cycles, best = 0;
+
+	if (!ipi_dev->ipi_send || !ipi_dev->ipi_clear)
+		return 0;
+
+	/*
+	 * HARTs waiting for cold boot are only sure to wake up for MSIP so
+	 * devices which signal an external interrupt are not used
+	 */
+	ipi_dev->ipi_send(hartid);
+	if (!sbi_ipi_selftest_wait(TRUE)) {
+		ipi_dev->ipi_clear(hartid);
+		return 0;
+	}
+	ipi_dev->ipi_clear(hartid);
+	if (!sbi_ipi_selftest_wait(FALSE))
+		return 0;
+
+	for (i = 0; i < SBI_IPI_SELFTEST_ROUNDS; i++) {
+		__smp_store_release(&ipi_selftest_peer, peer);
+
+		start = csr_read(CSR_MCYCLE);
+		ipi_dev->ipi_send(peer);
+		if (!sbi_ipi_selftest_wait(TRUE)) {
+			__smp_store_release(&ipi_selftest_peer, -1U);
+			ipi_dev->ipi_clear(hartid);
+			return 0;
+		}
+		cycles = csr_read(CSR_MCYCLE) - start;
+
+		ipi_dev->ipi_clear(hartid);
+		if (!sbi_ipi_selftest_wait(FALSE))
+			return 0;
+		if (!best || cycles < best)
+			best = cycles;
+	}
+
+	/* A counter which does not count still marks the device working */
+	return (best) ? best : 1;
+}
+
+void sbi_ipi_selftest(struct sbi_scratch *scratch, u32 peer_hartid)
+{
+	u32 i, best = ipi_dev_count;
+	unsigned long freq = sbi_timer_get_freq();
+	const struct sbi_ipi_device *first = ipi_dev;
+
+	/* Without a peer or a timer frequency nothing can be measured */
+	if (!freq || peer_hartid == scratch->hartid ||
+	    !sbi_hartid_to_scratch(peer_hartid))
+		return;
+
+	ipi_selftest_hartid = scratch->hartid;
+	ipi_selftest_timeout = (u64)freq * SBI_IPI_SELFTEST_TIMEOUT_US / 1000000;
+	ipi_selftest_tested = peer_hartid;
+
+	for (i = 0; i < ipi_dev_count; i++) {
+		ipi_dev = ipi_devs[i];
+		ipi_dev_cycles[i] = sbi_ipi_selftest_device(scratch,
+							    peer_hartid);
+		if (ipi_dev_cycles[i] && (best == ipi_dev_count ||
+		    ipi_dev_cycles[i] < ipi_dev_cycles[best]))
+			best = i;
+	}
+
+	ipi_dev = (best < ipi_dev_count) ? ipi_devs[best] : first;
+}
+
+void sbi_ipi_get_selftest_str(char *str, int nstr)
+{
+	u32 i;
+	int len = 0;
+
+	if (!str || nstr <= 0)
+		return;
+	str[0] = '\0';
+
+	if (ipi_selftest_tested == -1U) {
+		sbi_snprintf(str, nstr, "skipped");
+		return;
+	}
+
+	len = sbi_snprintf(str, nstr, "HART%u round trip (cycles):",
+			   ipi_selftest_tested);
+	for (i = 0; i < ipi_dev_count && len < nstr; i++) {
+		if (ipi_dev_cycles[i])
+			len += sbi_snprintf(str + len, nstr - len, " %s=%lu",
+					    ipi_devs[i]->name,
+					    ipi_dev_cycles[i]);
+		else
+			len += sbi_snprintf(str + len, nstr - len,
+					    " %s=failed", ipi_devs[i]->name);
+	}
+}
+
+const struct sbi_ipi_device *sbi_ipi_get_smode_device(void)
+{
+	return ipi_smode_dev;
+}
+
+/**
+ * Set a device which raises supervisor software interrupts directly,
+ * such as the ACLINT SSWI. The device must cover all HARTs.
+ */
+void sbi_ipi_set_smode_device(const struct sbi_ipi_device *dev)
+{
+	if (!dev || !dev->ipi_send || ipi_smode_dev)
 		return;
 
-	ipi_dev = dev;
+	ipi_smode_dev = dev;
 }
 
 int sbi_ipi_init(struct sbi_scratch *scratch, bool cold_boot)
@@ -227,8 +992,8 @@ int sbi_ipi_init(struct sbi_scratch *scratch, bool cold_boot)
 	struct sbi_ipi_data *ipi_data;
 
 	if (cold_boot) {
-		ipi_data_off = sbi_scratch_alloc_offset(sizeof(*ipi_data),
-							"IPI_DATA");
+		ipi_data_off = sbi_scratch_alloc_remote_offset(
+						sizeof(*ipi_data), "IPI_DATA");
 		if (!ipi_data_off)
 			return SBI_ENOMEM;
 		ret = sbi_ipi_event_create(&ipi_smode_ops);
@@ -248,7 +1013,7 @@ int sbi_ipi_init(struct sbi_scratch *scratch, bool cold_boot)
 	}
 
 	ipi_data = sbi_scratch_offset_ptr(scratch, ipi_data_off);
-	ipi_data->ipi_type = 0x00;
+	sbi_memset(ipi_data->ipi_type, 0, sizeof(ipi_data->ipi_type));
 
 	/*
 	 * Initialize platform IPI support. This will also clear any
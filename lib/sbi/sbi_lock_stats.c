@@ -0,0 +1,183 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifdef SBI_LOCK_STATS
+
+#include <sbi/riscv_asm.h>
+#include <sbi/sbi_console.h>
+#include <sbi/sbi_ecall.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hartmask.h>
+#include <sbi/sbi_lock_stats.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
+#include <sbi/sbi_trap.h>
+
+struct sbi_lock_stats_entry {
+	const void *key;
+	const char *name;
+	unsigned long count;
+	unsigned long contended;
+	unsigned long max_cycles;
+	u64 cycles;
+};
+
+/*
+ * Per-HART lock statistics in the scratch space of each HART so that
+ * accounting needs neither atomics nor locks of its own. Locks and
+ * sites which don't fit in the table go to the "other" entry.
+ */
+struct sbi_lock_stats {
+	struct sbi_lock_stats_entry entry[SBI_LOCK_STATS_MAX];
+	struct sbi_lock_stats_entry other;
+	unsigned long count;
+};
+
+static unsigned long lock_stats_off;
+
+static struct sbi_lock_stats *sbi_lock_stats_hart(u32 hartid)
+{
+	struct sbi_scratch *scratch;
+
+	if (!lock_stats_off || SBI_HARTMASK_MAX_BITS <= hartid)
+		return NULL;
+	scratch = sbi_hartid_to_scratch(hartid);
+	if (!scratch)
+		return NULL;
+
+	return sbi_scratch_offset_ptr(scratch, lock_stats_off);
+}
+
+unsigned long sbi_lock_stats_start(void)
+{
+	return (lock_stats_off) ? csr_read(CSR_MCYCLE) : 0;
+}
+
+void sbi_lock_stats_account(const void *key, const char *name,
+			    bool contended, unsigned long start)
+{
+	unsigned long i, cycles;
+	struct sbi_lock_stats *ls;
+	struct sbi_lock_stats_entry *e = NULL;
+
+	if (!lock_stats_off)
+		return;
+	ls = sbi_scratch_thishart_offset_ptr(lock_stats_off);
+
+	for (i = 0; i < ls->count; i++) {
+		if (ls->entry[i].key == key) {
+			e = &ls->entry[i];
+			break;
+		}
+	}
+	if (!e && ls->count < SBI_LOCK_STATS_MAX) {
+		e = &ls->entry[ls->count++];
+		e->key = key;
+		e->name = name;
+	}
+	if (!e)
+		e = &ls->other;
+
+	e->count++;
+	if (!contended)
+		return;
+
+	cycles = csr_read(CSR_MCYCLE) - start;
+	e->contended++;
+	e->cycles += cycles;
+	if (e->max_cycles < cycles)
+		e->max_cycles = cycles;
+}
+
+void sbi_lock_stats_reset(void)
+{
+	u32 i;
+	struct sbi_lock_stats *ls;
+
+	for (i = 0; i <= sbi_scratch_last_hartid(); i++) {
+		ls = sbi_lock_stats_hart(i);
+		if (ls)
+			sbi_memset(ls, 0, sizeof(*ls));
+	}
+}
+
+static void sbi_lock_stats_print(u32 hartid,
+				 const struct sbi_lock_stats_entry *e)
+{
+	if (!e->count)
+		return;
+
+	if (e->name)
+		sbi_printf("HART%u: %-18s", hartid, e->name);
+	else
+		sbi_printf("HART%u: lock 0x%012lx", hartid,
+			   (unsigned long)e->key);
+	sbi_printf(" count %lu contended %lu cycles %llu max %lu\n",
+		   e->count, e->contended, (unsigned long long)e->cycles,
+		   e->max_cycles);
+}
+
+void sbi_lock_stats_dump(void)
+{
+	u32 i, j, count;
+	struct sbi_lock_stats *ls;
+
+	for (i = 0; i <= sbi_scratch_last_hartid(); i++) {
+		ls = sbi_lock_stats_hart(i);
+		if (!ls)
+			continue;
+
+		/* Printing takes locks which may add entries meanwhile */
+		count = ls->count;
+		for (j = 0; j < count; j++)
+			sbi_lock_stats_print(i, &ls->entry[j]);
+		sbi_lock_stats_print(i, &ls->other);
+	}
+}
+
+static int sbi_ecall_lock_stats_handler(unsigned long extid,
+					unsigned long funcid,
+					const struct sbi_trap_regs *regs,
+					unsigned long *out_val,
+					struct sbi_trap_info *out_trap)
+{
+	int ret = 0;
+
+	switch (funcid) {
+	case SBI_EXT_LOCK_STATS_DUMP:
+		sbi_lock_stats_dump();
+		break;
+	case SBI_EXT_LOCK_STATS_RESET:
+		sbi_lock_stats_reset();
+		break;
+	default:
+		ret = SBI_ENOTSUPP;
+	};
+
+	return ret;
+}
+
+struct sbi_ecall_extension ecall_lock_stats = {
+	.extid_start = SBI_EXT_LOCK_STATS,
+	.extid_end = SBI_EXT_LOCK_STATS,
+	.handle = sbi_ecall_lock_stats_handler,
+};
+
+int sbi_lock_stats_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	if (!cold_boot)
+		return 0;
+
+	lock_stats_off = sbi_scratch_alloc_offset(sizeof(struct sbi_lock_stats),
+						  "LOCK_STATS");
+	if (!lock_stats_off)
+		return SBI_ENOMEM;
+
+	return 0;
+}
+
+#endif
@@ -0,0 +1,219 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_lz4.h>
+#include <sbi/sbi_string.h>
+
+/* clang-format off */
+
+#define LZ4_FRAME_MAGIC			0x184D2204
+#define LZ4_FLG_VERSION_MASK		0xc0
+#define LZ4_FLG_VERSION			0x40
+#define LZ4_FLG_BLOCK_CHECKSUM		(1 << 4)
+#define LZ4_FLG_CONTENT_SIZE		(1 << 3)
+#define LZ4_FLG_CONTENT_CHECKSUM	(1 << 2)
+#define LZ4_FLG_DICT_ID			(1 << 0)
+#define LZ4_BLOCK_UNCOMPRESSED		(1U << 31)
+#define LZ4_MIN_MATCH			4
+
+/* clang-format on */
+
+/*
+ * Space kept between the end of the decompressed data and the end of
+ * the moved frame. Decoding never overtakes the input by more than this.
+ */
+#define LZ4_INPLACE_MARGIN(__comp)	(((__comp) >> 8) + 64)
+
+static inline u32 lz4_get_le32(const u8 *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24);
+}
+
+/* Read an LZ4 length extension and add it to *len */
+static int __init lz4_get_len(const u8 **ip, const u8 *iend,
+			      unsigned long *len)
+{
+	u8 b;
+
+	do {
+		if (*ip >= iend)
+			return SBI_EINVAL;
+		b = *(*ip)++;
+		*len += b;
+	} while (b == 255);
+
+	return 0;
+}
+
+/* Decode one LZ4 block, matches may refer back to the start of out */
+static int __init lz4_decode_block(const u8 *ip, const u8 *iend, u8 *out,
+				   u8 **opp, u8 *oend)
+{
+	u8 *op = *opp, *match;
+	unsigned long len, offset;
+	u8 token;
+	int rc;
+
+	while (ip < iend) {
+		token = *ip++;
+
+		len = token >> 4;
+		if (len == 15) {
+			rc = lz4_get_len(&ip, iend, &len);
+			if (rc)
+				return rc;
+		}
+		if (iend - ip < len || oend - op < len)
+			return SBI_EINVAL;
+		sbi_memmove(op, ip, len);
+		op += len;
+		ip += len;
+
+		/* The last sequence has literals only */
+		if (ip == iend)
+			break;
+
+		if (iend - ip < 2)
+			return SBI_EINVAL;
+		offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (!offset || op - out < offset)
+			return SBI_EINVAL;
+
+		len = token & 0xf;
+		if (len == 15) {
+			rc = lz4_get_len(&ip, iend, &len);
+			if (rc)
+				return rc;
+		}
+		len += LZ4_MIN_MATCH;
+		if (oend - op < len)
+			return SBI_EINVAL;
+
+		match = op - offset;
+		if (len <= offset) {
+			sbi_memcpy(op, match, len);
+			op += len;
+		} else {
+			/* Overlapping match repeats the last offset bytes */
+			while (len--)
+				*op++ = *match++;
+		}
+	}
+
+	*opp = op;
+	return 0;
+}
+
+/* Magic, FLG, BD, content size and header checksum */
+#define LZ4_FRAME_HEADER_SIZE		(4 + 2 + 8 + 1)
+
+/* Check the frame header and get its flags and content size */
+static int __init lz4_frame_parse(const u8 *ip, unsigned long comp_size,
+				  u8 *out_flg, unsigned long *out_content)
+{
+	u8 flg;
+
+	if (comp_size < 7 || lz4_get_le32(ip) != LZ4_FRAME_MAGIC)
+		return SBI_EINVAL;
+
+	flg = ip[4];
+	if ((flg & LZ4_FLG_VERSION_MASK) != LZ4_FLG_VERSION ||
+	    (flg & LZ4_FLG_DICT_ID) || !(flg & LZ4_FLG_CONTENT_SIZE))
+		return SBI_ENOTSUPP;
+
+	if (comp_size < LZ4_FRAME_HEADER_SIZE)
+		return SBI_EINVAL;
+	if (lz4_get_le32(ip + 10))
+		return SBI_ENOSPC;
+
+	*out_flg = flg;
+	*out_content = lz4_get_le32(ip + 6);
+
+	return 0;
+}
+
+int __init sbi_lz4_inplace_size(const void *buf, unsigned long comp_size,
+				unsigned long *out_size)
+{
+	int rc;
+	u8 flg;
+	unsigned long content;
+
+	rc = lz4_frame_parse(buf, comp_size, &flg, &content);
+	if (rc)
+		return rc;
+
+	if (out_size)
+		*out_size = content + LZ4_INPLACE_MARGIN(comp_size);
+
+	return 0;
+}
+
+int __init sbi_lz4_decompress_inplace(void *buf, unsigned long comp_size,
+				      unsigned long max_size,
+				      unsigned long *out_size)
+{
+	u32 bsize;
+	u8 flg, *out = buf, *op, *oend;
+	const u8 *ip, *iend;
+	unsigned long content, shift;
+	int rc;
+
+	rc = lz4_frame_parse(buf, comp_size, &flg, &content);
+	if (rc)
+		return rc;
+	if (max_size < content ||
+	    max_size - content < LZ4_INPLACE_MARGIN(comp_size))
+		return SBI_ENOSPC;
+
+	/* Move the frame to the end of the buffer */
+	shift = content + LZ4_INPLACE_MARGIN(comp_size);
+	shift = (shift > comp_size) ? shift - comp_size : 0;
+	shift &= ~(sizeof(unsigned long) - 1);
+	ip = (const u8 *)buf + shift;
+	iend = ip + comp_size;
+	if (shift)
+		sbi_memmove((void *)ip, buf, comp_size);
+	ip += LZ4_FRAME_HEADER_SIZE;
+
+	op = out;
+	oend = out + content;
+	while (1) {
+		if (iend - ip < 4)
+			return SBI_EINVAL;
+		bsize = lz4_get_le32(ip);
+		ip += 4;
+		if (!bsize)
+			break;
+
+		if (iend - ip < (bsize & ~LZ4_BLOCK_UNCOMPRESSED))
+			return SBI_EINVAL;
+		if (bsize & LZ4_BLOCK_UNCOMPRESSED) {
+			bsize &= ~LZ4_BLOCK_UNCOMPRESSED;
+			if (oend - op < bsize)
+				return SBI_EINVAL;
+			sbi_memmove(op, ip, bsize);
+			op += bsize;
+		} else {
+			rc = lz4_decode_block(ip, ip + bsize, out, &op, oend);
+			if (rc)
+				return rc;
+		}
+		ip += bsize;
+
+		if (flg & LZ4_FLG_BLOCK_CHECKSUM)
+			ip += 4;
+	}
+
+	if (op != oend)
+		return SBI_EINVAL;
+	if (out_size)
+		*out_size = content;
+
+	return 0;
+}
@@ -9,15 +9,13 @@
  *   Atish Patra <atish.patra@wdc.com>
  */
 
+#include <sbi/sbi_bitops.h>
+#include <sbi/sbi_math.h>
+
 unsigned long log2roundup(unsigned long x)
 {
-	unsigned long ret = 0;
-
-	while (ret < __riscv_xlen) {
-		if (x <= (1UL << ret))
-			break;
-		ret++;
-	}
+	if (x <= 1)
+		return 0;
 
-	return ret;
+	return __fls(x - 1) + 1;
 }
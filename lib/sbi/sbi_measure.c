@@ -0,0 +1,234 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifdef SBI_MEASURE
+
+#include <sbi/sbi_console.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_measure.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
+
+#define FDT_MAGIC_BE		0xd00dfeed
+
+/*
+ * The log is naturally aligned so that a single domain memory region
+ * (and PMP entry) can make it readable for S-mode inside the firmware.
+ */
+static u8 measure_log[SBI_MEASURE_LOG_SIZE] __aligned(SBI_MEASURE_LOG_SIZE);
+static struct sbi_measure_header *measure_hdr;
+
+static const u32 sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#ifdef __riscv_zknh
+
+#define SHA256_OP(__name, __insn)					\
+static inline u32 __name(u32 x)						\
+{									\
+	unsigned long r;						\
+	__asm__ (__insn " %0, %1" : "=r"(r) : "r"((unsigned long)x));	\
+	return r;							\
+}
+
+SHA256_OP(sha256_sum0, "sha256sum0")
+SHA256_OP(sha256_sum1, "sha256sum1")
+SHA256_OP(sha256_sig0, "sha256sig0")
+SHA256_OP(sha256_sig1, "sha256sig1")
+
+#else
+
+static inline u32 ror32(u32 x, unsigned int n)
+{
+	return (x >> n) | (x << (32 - n));
+}
+
+static inline u32 sha256_sum0(u32 x)
+{
+	return ror32(x, 2) ^ ror32(x, 13) ^ ror32(x, 22);
+}
+
+static inline u32 sha256_sum1(u32 x)
+{
+	return ror32(x, 6) ^ ror32(x, 11) ^ ror32(x, 25);
+}
+
+static inline u32 sha256_sig0(u32 x)
+{
+	return ror32(x, 7) ^ ror32(x, 18) ^ (x >> 3);
+}
+
+static inline u32 sha256_sig1(u32 x)
+{
+	return ror32(x, 17) ^ ror32(x, 19) ^ (x >> 10);
+}
+
+#endif
+
+static inline u32 sha256_get_be32(const u8 *p)
+{
+	return ((u32)p[0] << 24) | ((u32)p[1] << 16) |
+	       ((u32)p[2] << 8) | p[3];
+}
+
+static inline void sha256_put_be32(u8 *p, u32 v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static void sha256_block(u32 *h, const u8 *p)
+{
+	int i;
+	u32 w[64], a, b, c, d, e, f, g, k, t1, t2;
+
+	for (i = 0; i < 16; i++)
+		w[i] = sha256_get_be32(p + 4 * i);
+	for (; i < 64; i++)
+		w[i] = sha256_sig1(w[i - 2]) + w[i - 7] +
+		       sha256_sig0(w[i - 15]) + w[i - 16];
+
+	a = h[0]; b = h[1]; c = h[2]; d = h[3];
+	e = h[4]; f = h[5]; g = h[6]; k = h[7];
+	for (i = 0; i < 64; i++) {
+		t1 = k + sha256_sum1(e) + ((e & f) ^ (~e & g)) +
+		     sha256_k[i] + w[i];
+		t2 = sha256_sum0(a) + ((a & b) ^ (a & c) ^ (b & c));
+		k = g; g = f; f = e; e = d + t1;
+		d = c; c = b; b = a; a = t1 + t2;
+	}
+	h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+	h[4] += e; h[5] += f; h[6] += g; h[7] += k;
+}
+
+static void sha256(const void *data, unsigned long len, u8 *digest)
+{
+	int i;
+	u8 last[128];
+	const u8 *p = data;
+	unsigned long rem, pad;
+	u32 h[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+		0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+	};
+
+	for (rem = len; rem >= 64; rem -= 64, p += 64)
+		sha256_block(h, p);
+
+	/* Trailing bytes, the 0x80 marker and the bit length */
+	pad = (rem < 56) ? 64 : 128;
+	sbi_memset(last, 0, pad);
+	sbi_memcpy(last, p, rem);
+	last[rem] = 0x80;
+	sha256_put_be32(&last[pad - 8], (u64)len >> 29);
+	sha256_put_be32(&last[pad - 4], len << 3);
+	sha256_block(h, last);
+	if (pad == 128)
+		sha256_block(h, last + 64);
+
+	for (i = 0; i < 8; i++)
+		sha256_put_be32(digest + 4 * i, h[i]);
+}
+
+static void sbi_measure_record(u32 event, unsigned long addr,
+			       unsigned long size)
+{
+	struct sbi_measure_entry *ent;
+
+	if ((SBI_MEASURE_LOG_SIZE - sizeof(*measure_hdr)) / sizeof(*ent) <=
+	    measure_hdr->entry_count)
+		return;
+
+	ent = (struct sbi_measure_entry *)(measure_hdr + 1) +
+	      measure_hdr->entry_count;
+	ent->event = event;
+	ent->algo = SBI_MEASURE_ALGO_SHA256;
+	ent->addr = addr;
+	ent->size = size;
+	sha256((const void *)addr, size, ent->digest);
+	measure_hdr->entry_count++;
+}
+
+int sbi_measure_get_log(unsigned long *addr, unsigned long *size)
+{
+	if (!measure_hdr)
+		return SBI_ENOTSUPP;
+
+	if (addr)
+		*addr = (unsigned long)measure_log;
+	if (size)
+		*size = SBI_MEASURE_LOG_SIZE;
+
+	return 0;
+}
+
+void sbi_measure_boot(struct sbi_scratch *scratch)
+{
+	const u8 *fdt = (const u8 *)scratch->next_arg1;
+
+	if (!measure_hdr)
+		return;
+
+	if (scratch->next_size)
+		sbi_measure_record(SBI_MEASURE_EVENT_NEXT_STAGE,
+				   scratch->next_addr, scratch->next_size);
+	else
+		sbi_printf("%s: next stage size unknown, not measured\n",
+			   __func__);
+
+	/* The FDT is measured after all fix-ups, as the next stage sees it */
+	if (fdt && sha256_get_be32(fdt) == FDT_MAGIC_BE)
+		sbi_measure_record(SBI_MEASURE_EVENT_FDT, (unsigned long)fdt,
+				   sha256_get_be32(fdt + 4));
+}
+
+int sbi_measure_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	int rc;
+	struct sbi_domain_memregion reg;
+	struct sbi_measure_header *hdr = (struct sbi_measure_header *)measure_log;
+
+	if (!cold_boot)
+		return 0;
+
+	hdr->magic = SBI_MEASURE_MAGIC;
+	hdr->version = SBI_MEASURE_VERSION;
+	hdr->entry_count = 0;
+	hdr->entry_size = sizeof(struct sbi_measure_entry);
+
+	/* S-mode may read the log but only M-mode writes it */
+	sbi_domain_memregion_init((unsigned long)measure_log,
+				  SBI_MEASURE_LOG_SIZE,
+				  SBI_DOMAIN_MEMREGION_READABLE, &reg);
+	rc = sbi_domain_root_add_memregion(&reg);
+	if (rc)
+		return rc;
+
+	measure_hdr = hdr;
+
+	return 0;
+}
+
+#endif
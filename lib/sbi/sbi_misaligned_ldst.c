@@ -11,7 +11,12 @@
 #include <sbi/riscv_encoding.h>
 #include <sbi/riscv_fp.h>
 #include <sbi/sbi_error.h>
+#include <sbi/sbi_hart.h>
 #include <sbi/sbi_misaligned_ldst.h>
+#include <sbi/sbi_pmu.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
+#include <sbi/sbi_timer.h>
 #include <sbi/sbi_trap.h>
 #include <sbi/sbi_unpriv.h>
 
@@ -21,94 +26,492 @@ union reg_data {
 	u64 data_u64;
 };
 
-int sbi_misaligned_load_handler(ulong addr, ulong tval2, ulong tinst,
-				struct sbi_trap_regs *regs)
+/** Number of entries in the per-HART decoded instruction cache */
+#define MISALIGNED_INSN_CACHE_ENTRIES	16
+
+/** Decoded misaligned load/store instruction */
+struct misaligned_insn {
+	/** Instruction with rd (loads) or rs2 (stores) at standard place */
+	ulong insn;
+	/** Length of the instruction */
+	u8 insn_len;
+	/** Length of the access (0 for an invalid entry) */
+	u8 len;
+	/** Shift used to sign-extend the loaded value */
+	u8 shift;
+	/** Floating-point access */
+	u8 fp;
+};
+
+struct misaligned_insn_cache_entry {
+	ulong mepc;
+	ulong satp;
+	ulong hgatp;
+	struct misaligned_insn mi;
+	/** Start of the current storm detection window */
+	u64 storm_start;
+	/** Traps of the instruction in the current window */
+	ulong storm_count;
+};
+
+struct misaligned_insn_cache {
+	struct misaligned_insn_cache_entry load[MISALIGNED_INSN_CACHE_ENTRIES];
+	struct misaligned_insn_cache_entry store[MISALIGNED_INSN_CACHE_ENTRIES];
+};
+
+static unsigned long misaligned_insn_cache_off;
+
+/** Storm detection settings of a HART, kept across HSM stop/start */
+struct misaligned_storm {
+	bool valid;
+	bool deleg;
+	ulong limit;
+	ulong window;
+};
+
+static unsigned long misaligned_storm_off;
+
+/*
+ * Hot loops trap at the same mepc over and over so the decoded
+ * instruction is cached per address space. Entries are dropped when
+ * the supervisor asks for a remote fence.i or sfence.vma, instructions
+ * changed without either are not seen by M-mode.
+ */
+static struct misaligned_insn_cache_entry *misaligned_insn_cache_entry(
+				struct sbi_trap_regs *regs, bool store)
+{
+	struct misaligned_insn_cache *cache;
+	ulong prev_mode = (regs->mstatus & MSTATUS_MPP) >> MSTATUS_MPP_SHIFT;
+	ulong idx = (regs->mepc >> 1) & (MISALIGNED_INSN_CACHE_ENTRIES - 1);
+
+	if (!misaligned_insn_cache_off || prev_mode == PRV_M)
+		return NULL;
+
+	cache = sbi_scratch_thishart_offset_ptr(misaligned_insn_cache_off);
+
+	return (store) ? &cache->store[idx] : &cache->load[idx];
+}
+
+static bool misaligned_prev_virt(struct sbi_trap_regs *regs)
+{
+#if __riscv_xlen == 32
+	return (regs->mstatusH & MSTATUSH_MPV) ? TRUE : FALSE;
+#else
+	return (regs->mstatus & MSTATUS_MPV) ? TRUE : FALSE;
+#endif
+}
+
+static void misaligned_insn_cache_key(struct sbi_trap_regs *regs,
+				      ulong *satp, ulong *hgatp)
+{
+	if (misaligned_prev_virt(regs)) {
+		*satp = csr_read(CSR_VSATP);
+		*hgatp = csr_read(CSR_HGATP);
+	} else {
+		*satp = csr_read(CSR_SATP);
+		*hgatp = 0;
+	}
+}
+
+static bool misaligned_insn_cache_lookup(struct sbi_trap_regs *regs,
+					 bool store,
+					 struct misaligned_insn *mi)
+{
+	ulong satp, hgatp;
+	struct misaligned_insn_cache_entry *e =
+				misaligned_insn_cache_entry(regs, store);
+
+	if (!e || !e->mi.len || e->mepc != regs->mepc)
+		return FALSE;
+
+	misaligned_insn_cache_key(regs, &satp, &hgatp);
+	if (e->satp != satp || e->hgatp != hgatp)
+		return FALSE;
+
+	*mi = e->mi;
+
+	return TRUE;
+}
+
+static void misaligned_insn_cache_update(struct sbi_trap_regs *regs,
+					 bool store,
+					 const struct misaligned_insn *mi)
+{
+	struct misaligned_insn_cache_entry *e =
+				misaligned_insn_cache_entry(regs, store);
+
+	if (!e)
+		return;
+
+	e->mepc = regs->mepc;
+	misaligned_insn_cache_key(regs, &e->satp, &e->hgatp);
+	e->mi = *mi;
+	e->storm_start = 0;
+	e->storm_count = 0;
+}
+
+/*
+ * Count the traps of the instruction in the current window. Returns
+ * TRUE when the limit is reached and misaligned traps of current HART
+ * were switched to S-mode, the trap is then redirected as well.
+ */
+static bool misaligned_storm(struct sbi_trap_regs *regs, bool store)
+{
+	u64 now;
+	struct misaligned_storm *ms;
+	struct misaligned_insn_cache_entry *e =
+				misaligned_insn_cache_entry(regs, store);
+
+	if (!e)
+		return FALSE;
+	ms = sbi_scratch_thishart_offset_ptr(misaligned_storm_off);
+	if (!ms->limit)
+		return FALSE;
+
+	now = sbi_timer_value();
+	if (now - e->storm_start >= ms->window) {
+		e->storm_start = now;
+		e->storm_count = 0;
+	}
+	if (++e->storm_count != ms->limit)
+		return FALSE;
+
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_MISALIGNED_STORM);
+	if (!ms->deleg)
+		return FALSE;
+
+	return sbi_hart_misaligned_deleg_set(sbi_scratch_thishart_ptr(),
+					     TRUE) ? FALSE : TRUE;
+}
+
+ulong sbi_misaligned_storm_get(struct sbi_scratch *scratch, int param)
+{
+	struct misaligned_storm *ms =
+			sbi_scratch_offset_ptr(scratch, misaligned_storm_off);
+
+	switch (param) {
+	case SBI_MISALIGNED_STORM_LIMIT:
+		return ms->limit;
+	case SBI_MISALIGNED_STORM_WINDOW:
+		return ms->window;
+	case SBI_MISALIGNED_STORM_DELEG:
+		return (ms->deleg) ? 1 : 0;
+	default:
+		return 0;
+	}
+}
+
+int sbi_misaligned_storm_set(struct sbi_scratch *scratch, int param,
+			     ulong value)
+{
+	struct misaligned_storm *ms =
+			sbi_scratch_offset_ptr(scratch, misaligned_storm_off);
+
+	switch (param) {
+	case SBI_MISALIGNED_STORM_LIMIT:
+		ms->limit = value;
+		break;
+	case SBI_MISALIGNED_STORM_WINDOW:
+		if (!value)
+			return SBI_EINVAL;
+		ms->window = value;
+		break;
+	case SBI_MISALIGNED_STORM_DELEG:
+		if (1 < value)
+			return SBI_EINVAL;
+		ms->deleg = (value) ? TRUE : FALSE;
+		break;
+	default:
+		return SBI_EINVAL;
+	}
+
+	/* Counts of the old settings would end the next window early */
+	sbi_misaligned_insn_cache_flush();
+
+	return 0;
+}
+
+void sbi_misaligned_insn_cache_flush(void)
+{
+	if (misaligned_insn_cache_off)
+		sbi_memset(sbi_scratch_thishart_offset_ptr(
+					misaligned_insn_cache_off), 0,
+			   sizeof(struct misaligned_insn_cache));
+}
+
+int sbi_misaligned_ldst_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	struct misaligned_storm *ms;
+
+	if (cold_boot) {
+		misaligned_insn_cache_off = sbi_scratch_alloc_offset(
+					sizeof(struct misaligned_insn_cache),
+					"MISALIGNED_INSN_CACHE");
+		if (!misaligned_insn_cache_off)
+			return SBI_ENOMEM;
+		misaligned_storm_off = sbi_scratch_alloc_offset(
+					sizeof(struct misaligned_storm),
+					"MISALIGNED_STORM");
+		if (!misaligned_storm_off)
+			return SBI_ENOMEM;
+	} else if (!misaligned_insn_cache_off || !misaligned_storm_off) {
+		return SBI_ENOMEM;
+	}
+
+	sbi_memset(sbi_scratch_offset_ptr(scratch, misaligned_insn_cache_off),
+		   0, sizeof(struct misaligned_insn_cache));
+
+	/* Settings of S-mode survive the HART being started again */
+	ms = sbi_scratch_offset_ptr(scratch, misaligned_storm_off);
+	if (!ms->valid) {
+		ms->limit = SBI_MISALIGNED_STORM_LIMIT_DEFAULT;
+		ms->window = SBI_MISALIGNED_STORM_WINDOW_DEFAULT;
+		ms->deleg = FALSE;
+		ms->valid = TRUE;
+	}
+
+	return 0;
+}
+
+#ifdef __riscv_flen
+/*
+ * FP registers are only touched for FP loads/stores, so integer accesses
+ * never change the FP state. Reading an FP register for a store keeps
+ * the FS state of the supervisor since mstatus is restored from the trap
+ * registers. Writing one for a load marks FS dirty in the trap registers
+ * (by SET_F32_RD/SET_F64_RD) and in vsstatus for a guest, so lazy FP
+ * context switching still saves it.
+ */
+static int misaligned_fp_off(struct sbi_trap_regs *regs)
 {
-	ulong insn, insn_len;
-	union reg_data val;
 	struct sbi_trap_info uptrap;
-	int i, fp = 0, shift = 0, len = 0;
 
+	/* FP accesses would trap in M-mode with FS off */
+	uptrap.epc = regs->mepc;
+	uptrap.cause = CAUSE_ILLEGAL_INSTRUCTION;
+	uptrap.tval = 0;
+	uptrap.tval2 = 0;
+	uptrap.tinst = 0;
+
+	return sbi_trap_redirect(regs, &uptrap);
+}
+
+static void misaligned_fp_set_dirty(struct sbi_trap_regs *regs)
+{
+	/* MSTATUS is restored from regs when returning from the trap */
+	regs->mstatus |= MSTATUS_FS;
+	if (misaligned_prev_virt(regs))
+		csr_set(CSR_VSSTATUS, SSTATUS_FS);
+}
+#endif
+
+static ulong misaligned_fetch_insn(ulong tinst, ulong mepc, ulong *insn_len,
+				   struct sbi_trap_info *uptrap)
+{
+	ulong insn;
+
+	uptrap->cause = 0;
 	if (tinst & 0x1) {
 		/*
 		 * Bit[0] == 1 implies trapped instruction value is
 		 * transformed instruction or custom instruction.
 		 */
 		insn = tinst | INSN_16BIT_MASK;
-		insn_len = (tinst & 0x2) ? INSN_LEN(insn) : 2;
+		*insn_len = (tinst & 0x2) ? INSN_LEN(insn) : 2;
 	} else {
 		/*
 		 * Bit[0] == 0 implies trapped instruction value is
 		 * zero or special value.
 		 */
-		insn = sbi_get_insn(regs->mepc, &uptrap);
-		if (uptrap.cause) {
-			uptrap.epc = regs->mepc;
-			return sbi_trap_redirect(regs, &uptrap);
-		}
-		insn_len = INSN_LEN(insn);
+		insn = sbi_get_insn(mepc, uptrap);
+		*insn_len = INSN_LEN(insn);
 	}
 
-	if ((insn & INSN_MASK_LW) == INSN_MATCH_LW) {
-		len   = 4;
-		shift = 8 * (sizeof(ulong) - len);
+	return insn;
+}
+
+/*
+ * Decode tables are indexed by funct3 for 32-bit instructions (LOAD and
+ * STORE first, LOAD-FP and STORE-FP next) and by quadrant and funct3
+ * for compressed instructions, so decoding takes the same time for all
+ * instructions. Entries with zero length are not emulated.
+ */
+#define MISALIGNED_DECODE_RVC		16
+#define MISALIGNED_DECODE_ENTRIES	(MISALIGNED_DECODE_RVC + 3 * 8)
+
+/* Where the rd (loads) or rs2 (stores) of the instruction is found */
+#define MISALIGNED_REG_STD		0
+#define MISALIGNED_REG_RVC_RS2S		1
+#define MISALIGNED_REG_RVC_RS2		2
+
+struct misaligned_decode {
+	/** Length of the access */
+	u8 len;
+	/** Loaded value is sign-extended */
+	u8 sign;
+	/** Floating-point access */
+	u8 fp;
+	/** MISALIGNED_REG_xyz */
+	u8 reg;
+	/** Encoding is reserved when rd field is zero */
+	u8 rd_nz;
+};
+
+#define MD_32(__op, __funct3)		((((__op) >> 2) & 0x1) << 3 | (__funct3))
+#define MD_16(__quad, __funct3)		\
+	(MISALIGNED_DECODE_RVC + ((__quad) << 3) + (__funct3))
+
+static ulong misaligned_decode_idx(ulong insn, ulong match)
+{
+	if (INSN_IS_16BIT(insn))
+		return MD_16(insn & 0x3, (insn >> 13) & 0x7);
+	if ((insn & 0x7b) != match)
+		return MISALIGNED_DECODE_ENTRIES;
+
+	return MD_32(insn, (insn >> 12) & 0x7);
+}
+
+static const struct misaligned_decode
+misaligned_load_table[MISALIGNED_DECODE_ENTRIES] = {
+	[MD_32(0x03, 1)] = { .len = 2, .sign = 1 },		/* lh */
+	[MD_32(0x03, 2)] = { .len = 4, .sign = 1 },		/* lw */
+	[MD_32(0x03, 5)] = { .len = 2 },			/* lhu */
 #if __riscv_xlen == 64
-	} else if ((insn & INSN_MASK_LD) == INSN_MATCH_LD) {
-		len   = 8;
-		shift = 8 * (sizeof(ulong) - len);
-	} else if ((insn & INSN_MASK_LWU) == INSN_MATCH_LWU) {
-		len = 4;
+	[MD_32(0x03, 3)] = { .len = 8, .sign = 1 },		/* ld */
+	[MD_32(0x03, 6)] = { .len = 4 },			/* lwu */
 #endif
 #ifdef __riscv_flen
-	} else if ((insn & INSN_MASK_FLD) == INSN_MATCH_FLD) {
-		fp  = 1;
-		len = 8;
-	} else if ((insn & INSN_MASK_FLW) == INSN_MATCH_FLW) {
-		fp  = 1;
-		len = 4;
-#endif
-	} else if ((insn & INSN_MASK_LH) == INSN_MATCH_LH) {
-		len   = 2;
-		shift = 8 * (sizeof(ulong) - len);
-	} else if ((insn & INSN_MASK_LHU) == INSN_MATCH_LHU) {
-		len = 2;
+	[MD_32(0x07, 2)] = { .len = 4, .fp = 1 },		/* flw */
+	[MD_32(0x07, 3)] = { .len = 8, .fp = 1 },		/* fld */
+#endif
+	[MD_16(0, 2)] = { .len = 4, .sign = 1,
+			  .reg = MISALIGNED_REG_RVC_RS2S },	/* c.lw */
+	[MD_16(2, 2)] = { .len = 4, .sign = 1, .rd_nz = 1 },	/* c.lwsp */
 #if __riscv_xlen >= 64
-	} else if ((insn & INSN_MASK_C_LD) == INSN_MATCH_C_LD) {
-		len   = 8;
-		shift = 8 * (sizeof(ulong) - len);
-		insn  = RVC_RS2S(insn) << SH_RD;
-	} else if ((insn & INSN_MASK_C_LDSP) == INSN_MATCH_C_LDSP &&
-		   ((insn >> SH_RD) & 0x1f)) {
-		len   = 8;
-		shift = 8 * (sizeof(ulong) - len);
-#endif
-	} else if ((insn & INSN_MASK_C_LW) == INSN_MATCH_C_LW) {
-		len   = 4;
-		shift = 8 * (sizeof(ulong) - len);
-		insn  = RVC_RS2S(insn) << SH_RD;
-	} else if ((insn & INSN_MASK_C_LWSP) == INSN_MATCH_C_LWSP &&
-		   ((insn >> SH_RD) & 0x1f)) {
-		len   = 4;
-		shift = 8 * (sizeof(ulong) - len);
+	[MD_16(0, 3)] = { .len = 8, .sign = 1,
+			  .reg = MISALIGNED_REG_RVC_RS2S },	/* c.ld */
+	[MD_16(2, 3)] = { .len = 8, .sign = 1, .rd_nz = 1 },	/* c.ldsp */
+#endif
 #ifdef __riscv_flen
-	} else if ((insn & INSN_MASK_C_FLD) == INSN_MATCH_C_FLD) {
-		fp   = 1;
-		len  = 8;
-		insn = RVC_RS2S(insn) << SH_RD;
-	} else if ((insn & INSN_MASK_C_FLDSP) == INSN_MATCH_C_FLDSP) {
-		fp  = 1;
-		len = 8;
+	[MD_16(0, 1)] = { .len = 8, .fp = 1,
+			  .reg = MISALIGNED_REG_RVC_RS2S },	/* c.fld */
+	[MD_16(2, 1)] = { .len = 8, .fp = 1 },			/* c.fldsp */
 #if __riscv_xlen == 32
-	} else if ((insn & INSN_MASK_C_FLW) == INSN_MATCH_C_FLW) {
-		fp   = 1;
-		len  = 4;
-		insn = RVC_RS2S(insn) << SH_RD;
-	} else if ((insn & INSN_MASK_C_FLWSP) == INSN_MATCH_C_FLWSP) {
-		fp  = 1;
-		len = 4;
+	[MD_16(0, 3)] = { .len = 4, .fp = 1,
+			  .reg = MISALIGNED_REG_RVC_RS2S },	/* c.flw */
+	[MD_16(2, 3)] = { .len = 4, .fp = 1 },			/* c.flwsp */
 #endif
 #endif
-	} else {
+};
+
+static const struct misaligned_decode
+misaligned_store_table[MISALIGNED_DECODE_ENTRIES] = {
+	[MD_32(0x23, 1)] = { .len = 2 },			/* sh */
+	[MD_32(0x23, 2)] = { .len = 4 },			/* sw */
+#if __riscv_xlen == 64
+	[MD_32(0x23, 3)] = { .len = 8 },			/* sd */
+#endif
+#ifdef __riscv_flen
+	[MD_32(0x27, 2)] = { .len = 4, .fp = 1 },		/* fsw */
+	[MD_32(0x27, 3)] = { .len = 8, .fp = 1 },		/* fsd */
+#endif
+	[MD_16(0, 6)] = { .len = 4,
+			  .reg = MISALIGNED_REG_RVC_RS2S },	/* c.sw */
+	[MD_16(2, 6)] = { .len = 4, .rd_nz = 1,
+			  .reg = MISALIGNED_REG_RVC_RS2 },	/* c.swsp */
+#if __riscv_xlen >= 64
+	[MD_16(0, 7)] = { .len = 8,
+			  .reg = MISALIGNED_REG_RVC_RS2S },	/* c.sd */
+	[MD_16(2, 7)] = { .len = 8, .rd_nz = 1,
+			  .reg = MISALIGNED_REG_RVC_RS2 },	/* c.sdsp */
+#endif
+#ifdef __riscv_flen
+	[MD_16(0, 5)] = { .len = 8, .fp = 1,
+			  .reg = MISALIGNED_REG_RVC_RS2S },	/* c.fsd */
+	[MD_16(2, 5)] = { .len = 8, .fp = 1,
+			  .reg = MISALIGNED_REG_RVC_RS2 },	/* c.fsdsp */
+#if __riscv_xlen == 32
+	[MD_16(0, 7)] = { .len = 4, .fp = 1,
+			  .reg = MISALIGNED_REG_RVC_RS2S },	/* c.fsw */
+	[MD_16(2, 7)] = { .len = 4, .fp = 1,
+			  .reg = MISALIGNED_REG_RVC_RS2 },	/* c.fswsp */
+#endif
+#endif
+};
+
+/*
+ * Returns zero if the instruction is not a supported load/store. The
+ * destination (loads) or source (stores) register of compressed
+ * instructions is moved to the standard rd or rs2 place.
+ */
+static int misaligned_decode(ulong insn, bool store,
+			     struct misaligned_insn *mi)
+{
+	const struct misaligned_decode *md;
+	ulong idx, sh = (store) ? SH_RS2 : SH_RD;
+
+	idx = misaligned_decode_idx(insn, (store) ? 0x23 : 0x03);
+	if (idx >= MISALIGNED_DECODE_ENTRIES)
+		return 0;
+
+	md = (store) ? &misaligned_store_table[idx] :
+		       &misaligned_load_table[idx];
+	if (!md->len || (md->rd_nz && !((insn >> SH_RD) & 0x1f)))
+		return 0;
+
+	switch (md->reg) {
+	case MISALIGNED_REG_RVC_RS2S:
+		insn = RVC_RS2S(insn) << sh;
+		break;
+	case MISALIGNED_REG_RVC_RS2:
+		insn = RVC_RS2(insn) << sh;
+		break;
+	default:
+		break;
+	};
+
+	mi->insn  = insn;
+	mi->len   = md->len;
+	mi->shift = (md->sign) ? 8 * (sizeof(ulong) - md->len) : 0;
+	mi->fp    = md->fp;
+
+	return mi->len;
+}
+
+int sbi_misaligned_load_handler(ulong addr, ulong tval2, ulong tinst,
+				struct sbi_trap_regs *regs)
+{
+	int rc;
+	ulong insn, insn_len;
+	union reg_data val;
+	struct sbi_trap_info uptrap;
+	struct misaligned_insn mi;
+
+	if (!misaligned_insn_cache_lookup(regs, FALSE, &mi)) {
+		insn = misaligned_fetch_insn(tinst, regs->mepc, &insn_len,
+					     &uptrap);
+		if (uptrap.cause) {
+			uptrap.epc = regs->mepc;
+			return sbi_trap_redirect(regs, &uptrap);
+		}
+
+		if (!misaligned_decode(insn, FALSE, &mi)) {
+			rc = sbi_misaligned_v_ldst_handler(insn, regs);
+			if (rc != SBI_ENOTSUPP)
+				return rc;
+
+			uptrap.epc = regs->mepc;
+			uptrap.cause = CAUSE_MISALIGNED_LOAD;
+			uptrap.tval = addr;
+			uptrap.tval2 = tval2;
+			uptrap.tinst = tinst;
+			return sbi_trap_redirect(regs, &uptrap);
+		}
+		mi.insn_len = insn_len;
+		misaligned_insn_cache_update(regs, FALSE, &mi);
+	}
+
+	if (misaligned_storm(regs, FALSE)) {
 		uptrap.epc = regs->mepc;
 		uptrap.cause = CAUSE_MISALIGNED_LOAD;
 		uptrap.tval = addr;
@@ -117,26 +520,31 @@ int sbi_misaligned_load_handler(ulong addr, ulong tval2, ulong tinst,
 		return sbi_trap_redirect(regs, &uptrap);
 	}
 
-	val.data_u64 = 0;
-	for (i = 0; i < len; i++) {
-		val.data_bytes[i] = sbi_load_u8((void *)(addr + i),
-						&uptrap);
-		if (uptrap.cause) {
-			uptrap.epc = regs->mepc;
-			return sbi_trap_redirect(regs, &uptrap);
-		}
+#ifdef __riscv_flen
+	if (mi.fp && !(regs->mstatus & MSTATUS_FS))
+		return misaligned_fp_off(regs);
+#endif
+
+	val.data_u64 = sbi_load_misaligned(addr, mi.len, &uptrap);
+	if (uptrap.cause) {
+		uptrap.epc = regs->mepc;
+		return sbi_trap_redirect(regs, &uptrap);
 	}
 
-	if (!fp)
-		SET_RD(insn, regs, ((long)(val.data_ulong << shift)) >> shift);
+	if (!mi.fp)
+		SET_RD(mi.insn, regs,
+		       ((long)(val.data_ulong << mi.shift)) >> mi.shift);
 #ifdef __riscv_flen
-	else if (len == 8)
-		SET_F64_RD(insn, regs, val.data_u64);
-	else
-		SET_F32_RD(insn, regs, val.data_ulong);
+	else {
+		if (mi.len == 8)
+			SET_F64_RD(mi.insn, regs, val.data_u64);
+		else
+			SET_F32_RD(mi.insn, regs, val.data_ulong);
+		misaligned_fp_set_dirty(regs);
+	}
 #endif
 
-	regs->mepc += insn_len;
+	regs->mepc += mi.insn_len;
 
 	return 0;
 }
@@ -144,82 +552,37 @@ int sbi_misaligned_load_handler(ulong addr, ulong tval2, ulong tinst,
 int sbi_misaligned_store_handler(ulong addr, ulong tval2, ulong tinst,
 				 struct sbi_trap_regs *regs)
 {
+	int rc;
 	ulong insn, insn_len;
 	union reg_data val;
 	struct sbi_trap_info uptrap;
-	int i, len = 0;
+	struct misaligned_insn mi;
 
-	if (tinst & 0x1) {
-		/*
-		 * Bit[0] == 1 implies trapped instruction value is
-		 * transformed instruction or custom instruction.
-		 */
-		insn = tinst | INSN_16BIT_MASK;
-		insn_len = (tinst & 0x2) ? INSN_LEN(insn) : 2;
-	} else {
-		/*
-		 * Bit[0] == 0 implies trapped instruction value is
-		 * zero or special value.
-		 */
-		insn = sbi_get_insn(regs->mepc, &uptrap);
+	if (!misaligned_insn_cache_lookup(regs, TRUE, &mi)) {
+		insn = misaligned_fetch_insn(tinst, regs->mepc, &insn_len,
+					     &uptrap);
 		if (uptrap.cause) {
 			uptrap.epc = regs->mepc;
 			return sbi_trap_redirect(regs, &uptrap);
 		}
-		insn_len = INSN_LEN(insn);
-	}
 
-	val.data_ulong = GET_RS2(insn, regs);
+		if (!misaligned_decode(insn, TRUE, &mi)) {
+			rc = sbi_misaligned_v_ldst_handler(insn, regs);
+			if (rc != SBI_ENOTSUPP)
+				return rc;
 
-	if ((insn & INSN_MASK_SW) == INSN_MATCH_SW) {
-		len = 4;
-#if __riscv_xlen == 64
-	} else if ((insn & INSN_MASK_SD) == INSN_MATCH_SD) {
-		len = 8;
-#endif
-#ifdef __riscv_flen
-	} else if ((insn & INSN_MASK_FSD) == INSN_MATCH_FSD) {
-		len	     = 8;
-		val.data_u64 = GET_F64_RS2(insn, regs);
-	} else if ((insn & INSN_MASK_FSW) == INSN_MATCH_FSW) {
-		len	       = 4;
-		val.data_ulong = GET_F32_RS2(insn, regs);
-#endif
-	} else if ((insn & INSN_MASK_SH) == INSN_MATCH_SH) {
-		len = 2;
-#if __riscv_xlen >= 64
-	} else if ((insn & INSN_MASK_C_SD) == INSN_MATCH_C_SD) {
-		len	       = 8;
-		val.data_ulong = GET_RS2S(insn, regs);
-	} else if ((insn & INSN_MASK_C_SDSP) == INSN_MATCH_C_SDSP &&
-		   ((insn >> SH_RD) & 0x1f)) {
-		len	       = 8;
-		val.data_ulong = GET_RS2C(insn, regs);
-#endif
-	} else if ((insn & INSN_MASK_C_SW) == INSN_MATCH_C_SW) {
-		len	       = 4;
-		val.data_ulong = GET_RS2S(insn, regs);
-	} else if ((insn & INSN_MASK_C_SWSP) == INSN_MATCH_C_SWSP &&
-		   ((insn >> SH_RD) & 0x1f)) {
-		len	       = 4;
-		val.data_ulong = GET_RS2C(insn, regs);
-#ifdef __riscv_flen
-	} else if ((insn & INSN_MASK_C_FSD) == INSN_MATCH_C_FSD) {
-		len	     = 8;
-		val.data_u64 = GET_F64_RS2S(insn, regs);
-	} else if ((insn & INSN_MASK_C_FSDSP) == INSN_MATCH_C_FSDSP) {
-		len	     = 8;
-		val.data_u64 = GET_F64_RS2C(insn, regs);
-#if __riscv_xlen == 32
-	} else if ((insn & INSN_MASK_C_FSW) == INSN_MATCH_C_FSW) {
-		len	       = 4;
-		val.data_ulong = GET_F32_RS2S(insn, regs);
-	} else if ((insn & INSN_MASK_C_FSWSP) == INSN_MATCH_C_FSWSP) {
-		len	       = 4;
-		val.data_ulong = GET_F32_RS2C(insn, regs);
-#endif
-#endif
-	} else {
+			uptrap.epc = regs->mepc;
+			uptrap.cause = CAUSE_MISALIGNED_STORE;
+			uptrap.tval = addr;
+			uptrap.tval2 = tval2;
+			uptrap.tinst = tinst;
+			return sbi_trap_redirect(regs, &uptrap);
+		}
+		mi.insn_len = insn_len;
+		misaligned_insn_cache_update(regs, TRUE, &mi);
+	}
+
+	if (misaligned_storm(regs, TRUE)) {
 		uptrap.epc = regs->mepc;
 		uptrap.cause = CAUSE_MISALIGNED_STORE;
 		uptrap.tval = addr;
@@ -228,16 +591,26 @@ int sbi_misaligned_store_handler(ulong addr, ulong tval2, ulong tinst,
 		return sbi_trap_redirect(regs, &uptrap);
 	}
 
-	for (i = 0; i < len; i++) {
-		sbi_store_u8((void *)(addr + i), val.data_bytes[i],
-			     &uptrap);
-		if (uptrap.cause) {
-			uptrap.epc = regs->mepc;
-			return sbi_trap_redirect(regs, &uptrap);
-		}
+#ifdef __riscv_flen
+	if (mi.fp && !(regs->mstatus & MSTATUS_FS))
+		return misaligned_fp_off(regs);
+#endif
+
+	val.data_ulong = GET_RS2(mi.insn, regs);
+#ifdef __riscv_flen
+	if (mi.fp && mi.len == 8)
+		val.data_u64 = GET_F64_RS2(mi.insn, regs);
+	else if (mi.fp)
+		val.data_ulong = GET_F32_RS2(mi.insn, regs);
+#endif
+
+	sbi_store_misaligned(addr, mi.len, val.data_u64, &uptrap);
+	if (uptrap.cause) {
+		uptrap.epc = regs->mepc;
+		return sbi_trap_redirect(regs, &uptrap);
 	}
 
-	regs->mepc += insn_len;
+	regs->mepc += mi.insn_len;
 
 	return 0;
 }
@@ -0,0 +1,320 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_encoding.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_misaligned_ldst.h>
+#include <sbi/sbi_string.h>
+#include <sbi/sbi_trap.h>
+#include <sbi/sbi_unpriv.h>
+
+/* clang-format off */
+
+/** Largest VLENB (in bytes) handled by the emulation */
+#define VLENB_MAX			256
+
+#define VINSN_OPCODE(insn)		((insn) & 0x7f)
+#define VINSN_VD(insn)			(((insn) >> 7) & 0x1f)
+#define VINSN_WIDTH(insn)		(((insn) >> 12) & 0x7)
+#define VINSN_UMOP(insn)		(((insn) >> 20) & 0x1f)
+#define VINSN_VM(insn)			(((insn) >> 25) & 0x1)
+#define VINSN_MOP(insn)			(((insn) >> 26) & 0x3)
+#define VINSN_MEW(insn)			(((insn) >> 28) & 0x1)
+#define VINSN_NF(insn)			(((insn) >> 29) & 0x7)
+
+#define VINSN_OPCODE_LOAD		0x07
+#define VINSN_OPCODE_STORE		0x27
+
+#define VINSN_MOP_UNIT			0x0
+#define VINSN_MOP_STRIDED		0x2
+
+#define VINSN_UMOP_NORMAL		0x00
+#define VINSN_UMOP_WHOLE_REG		0x08
+#define VINSN_UMOP_MASK			0x0b
+#define VINSN_UMOP_FAULT_FIRST		0x10
+
+/*
+ * Vector instructions are emitted as raw words so that the firmware
+ * does not need a toolchain with the V extension. All of them take
+ * their base address (or AVL) in a0 and vtype in a1.
+ */
+#define VS1R_V(vreg)	".word " STR(0x02800027 | (10 << 15) | ((vreg) << 7))
+#define VL1R_V(vreg)	".word " STR(0x02800007 | (10 << 15) | ((vreg) << 7))
+#define VSETVL_X0_A0_A1	".word " STR(0x80007057 | (11 << 20) | (10 << 15))
+
+/* clang-format on */
+
+#define vreg_case_save(__vreg)						\
+	case __vreg:							\
+		asm volatile(VS1R_V(__vreg) : : "r"(a0) : "memory");	\
+		break;
+
+#define vreg_case_restore(__vreg)					\
+	case __vreg:							\
+		asm volatile(VL1R_V(__vreg) : : "r"(a0) : "memory");	\
+		break;
+
+#define vreg_case_2(__op, __vreg)					\
+	vreg_case_##__op(__vreg + 0)					\
+	vreg_case_##__op(__vreg + 1)
+#define vreg_case_4(__op, __vreg)					\
+	vreg_case_2(__op, __vreg + 0)					\
+	vreg_case_2(__op, __vreg + 2)
+#define vreg_case_8(__op, __vreg)					\
+	vreg_case_4(__op, __vreg + 0)					\
+	vreg_case_4(__op, __vreg + 4)
+#define vreg_case_16(__op, __vreg)					\
+	vreg_case_8(__op, __vreg + 0)					\
+	vreg_case_8(__op, __vreg + 8)
+#define vreg_case_32(__op, __vreg)					\
+	vreg_case_16(__op, __vreg + 0)					\
+	vreg_case_16(__op, __vreg + 16)
+
+static void vreg_save(ulong vreg, u8 *buf)
+{
+	register ulong a0 asm("a0") = (ulong)buf;
+
+	switch (vreg) {
+	vreg_case_32(save, 0)
+	}
+}
+
+static void vreg_restore(ulong vreg, const u8 *buf)
+{
+	register ulong a0 asm("a0") = (ulong)buf;
+
+	switch (vreg) {
+	vreg_case_32(restore, 0)
+	}
+}
+
+static void vsetvl(ulong avl, ulong vtype)
+{
+	register ulong a0 asm("a0") = avl;
+	register ulong a1 asm("a1") = vtype;
+
+	asm volatile(VSETVL_X0_A0_A1 : : "r"(a0), "r"(a1));
+}
+
+/* Number of registers in each field group for given EEW (in bytes) */
+static ulong vreg_group_size(ulong vtype, ulong eew)
+{
+	ulong sew = 8 << ((vtype >> 3) & 0x7);
+	ulong lmul = vtype & 0x7, num = eew * 8, den = sew;
+
+	if (lmul & 0x4)
+		den <<= (8 - lmul);
+	else
+		num <<= lmul;
+
+	return (num > den) ? num / den : 1;
+}
+
+static bool misaligned_v_prev_virt(struct sbi_trap_regs *regs)
+{
+#if __riscv_xlen == 32
+	return (regs->mstatusH & MSTATUSH_MPV) ? TRUE : FALSE;
+#else
+	return (regs->mstatus & MSTATUS_MPV) ? TRUE : FALSE;
+#endif
+}
+
+/*
+ * The emulation writes vector registers (and vstart even for stores)
+ * on behalf of the interrupted mode, so its state must become dirty.
+ * MSTATUS is restored from regs when returning from the trap.
+ */
+static void misaligned_v_set_dirty(struct sbi_trap_regs *regs)
+{
+	regs->mstatus |= MSTATUS_VS;
+	if (misaligned_v_prev_virt(regs))
+		csr_set(CSR_VSSTATUS, SSTATUS_VS);
+}
+
+static int misaligned_v_ldst(ulong insn, bool store,
+			     struct sbi_trap_regs *regs)
+{
+	u8 vbuf[VLENB_MAX], mbuf[VLENB_MAX];
+	struct sbi_trap_info uptrap;
+	ulong vlenb, vl, vtype, vstart, eew, nf, vd, base, stride, group;
+	ulong i, f, n, reg, off, addr, cur = -1UL;
+	bool masked, contig, ff = FALSE;
+	union {
+		u8 bytes[8];
+		u64 val;
+	} data;
+
+	if (VINSN_MEW(insn))
+		return SBI_ENOTSUPP;
+
+	switch (VINSN_WIDTH(insn)) {
+	case 0:
+		eew = 1;
+		break;
+	case 5:
+		eew = 2;
+		break;
+	case 6:
+		eew = 4;
+		break;
+	case 7:
+		eew = 8;
+		break;
+	default:
+		return SBI_ENOTSUPP;
+	};
+
+	vlenb  = csr_read(CSR_VLENB);
+	if (vlenb > VLENB_MAX)
+		return SBI_ENOTSUPP;
+	vl     = csr_read(CSR_VL);
+	vtype  = csr_read(CSR_VTYPE);
+	vstart = csr_read(CSR_VSTART);
+	/* Whole register moves used below honour vstart */
+	csr_write(CSR_VSTART, 0);
+
+	nf     = VINSN_NF(insn) + 1;
+	vd     = VINSN_VD(insn);
+	base   = GET_RS1(insn, regs);
+	masked = (VINSN_VM(insn)) ? FALSE : TRUE;
+	stride = eew * nf;
+	group  = vreg_group_size(vtype, eew);
+
+	switch (VINSN_MOP(insn)) {
+	case VINSN_MOP_UNIT:
+		switch (VINSN_UMOP(insn)) {
+		case VINSN_UMOP_NORMAL:
+			break;
+		case VINSN_UMOP_FAULT_FIRST:
+			if (store)
+				return SBI_ENOTSUPP;
+			ff = TRUE;
+			break;
+		case VINSN_UMOP_WHOLE_REG:
+			if (masked || (nf & (nf - 1)))
+				return SBI_ENOTSUPP;
+			/* nf is the number of registers, not of fields */
+			vl     = nf * vlenb / eew;
+			stride = eew;
+			group  = nf;
+			nf     = 1;
+			break;
+		case VINSN_UMOP_MASK:
+			if (masked || eew != 1)
+				return SBI_ENOTSUPP;
+			vl    = (vl + 7) / 8;
+			group = nf = 1;
+			break;
+		default:
+			return SBI_ENOTSUPP;
+		};
+		break;
+	case VINSN_MOP_STRIDED:
+		stride = GET_RS2(insn, regs);
+		break;
+	default:
+		/* Indexed accesses are left to the supervisor */
+		return SBI_ENOTSUPP;
+	};
+
+	if ((vd + nf * group) > 32 || (masked && vd == 0 && !store))
+		return SBI_ENOTSUPP;
+
+	/*
+	 * Unmasked unit-stride accesses without fields are moved up to
+	 * 8 bytes at a time, everything else element by element.
+	 */
+	contig = (!masked && nf == 1 && stride == eew) ? TRUE : FALSE;
+	if (masked)
+		vreg_save(0, mbuf);
+
+	uptrap.cause = 0;
+	for (i = vstart; i < vl; i += n) {
+		n = 1;
+		if (masked && !((mbuf[i / 8] >> (i % 8)) & 1))
+			continue;
+
+		off = (i * eew) % vlenb;
+		if (contig) {
+			n = (8 - (off & 0x7)) / eew;
+			if (n > vl - i)
+				n = vl - i;
+			if (n > (vlenb - off) / eew)
+				n = (vlenb - off) / eew;
+		}
+
+		for (f = 0; f < nf; f++) {
+			reg = vd + f * group + (i * eew) / vlenb;
+			if (reg != cur) {
+				if (cur != -1UL && !store)
+					vreg_restore(cur, vbuf);
+				vreg_save(reg, vbuf);
+				cur = reg;
+			}
+
+			addr = base + i * stride + f * eew;
+			if (store) {
+				data.val = 0;
+				sbi_memcpy(data.bytes, &vbuf[off], n * eew);
+				sbi_store_misaligned(addr, n * eew, data.val,
+						     &uptrap);
+			} else {
+				data.val = sbi_load_misaligned(addr, n * eew,
+							       &uptrap);
+				if (!uptrap.cause)
+					sbi_memcpy(&vbuf[off], data.bytes,
+						   n * eew);
+			}
+			if (uptrap.cause)
+				break;
+		}
+		if (uptrap.cause)
+			break;
+	}
+
+	if (cur != -1UL && !store)
+		vreg_restore(cur, vbuf);
+	misaligned_v_set_dirty(regs);
+
+	if (uptrap.cause) {
+		if (!ff || i == 0) {
+			/* Resume from the faulting element */
+			csr_write(CSR_VSTART, i);
+			uptrap.epc = regs->mepc;
+			return sbi_trap_redirect(regs, &uptrap);
+		}
+		/* Fault-only-first loads trim vl instead of trapping */
+		vsetvl(i, vtype);
+	}
+
+	csr_write(CSR_VSTART, 0);
+	regs->mepc += 4;
+
+	return 0;
+}
+
+int sbi_misaligned_v_ldst_handler(ulong insn, struct sbi_trap_regs *regs)
+{
+	bool store;
+
+	/* Vector accesses would have trapped as illegal with VS off */
+	if (!misa_extension('V') || !(regs->mstatus & MSTATUS_VS))
+		return SBI_ENOTSUPP;
+
+	switch (VINSN_OPCODE(insn)) {
+	case VINSN_OPCODE_LOAD:
+		store = FALSE;
+		break;
+	case VINSN_OPCODE_STORE:
+		store = TRUE;
+		break;
+	default:
+		return SBI_ENOTSUPP;
+	};
+
+	return misaligned_v_ldst(insn, store, regs);
+}
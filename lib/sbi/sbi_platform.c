@@ -7,7 +7,9 @@
  *   Atish Patra <atish.patra@wdc.com>
  */
 
+#include <sbi/riscv_barrier.h>
 #include <sbi/sbi_console.h>
+#include <sbi/sbi_hartmask.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_string.h>
 
@@ -63,6 +65,37 @@ done:
 		sbi_strncpy(features_str, "none", nfstr);
 }
 
+/*
+ * Reverse map of hart_index2id[] built at cold boot. HART indices are
+ * below SBI_HARTMASK_MAX_BITS so they fit in u16 and HART ids beyond
+ * the HART mask are never valid.
+ */
+#define HART_INDEX_NONE		0xffff
+static u16 hartid_to_index_table[SBI_HARTMASK_MAX_BITS];
+static const struct sbi_platform *hartid_to_index_plat;
+
+void sbi_platform_hart_index_init(const struct sbi_platform *plat)
+{
+	u32 i, hartid;
+
+	if (!plat || !plat->hart_index2id ||
+	    SBI_HARTMASK_MAX_BITS < plat->hart_count)
+		return;
+
+	for (i = 0; i < SBI_HARTMASK_MAX_BITS; i++)
+		hartid_to_index_table[i] = HART_INDEX_NONE;
+	for (i = 0; i < plat->hart_count; i++) {
+		hartid = plat->hart_index2id[i];
+		if (hartid < SBI_HARTMASK_MAX_BITS &&
+		    hartid_to_index_table[hartid] == HART_INDEX_NONE)
+			hartid_to_index_table[hartid] = i;
+	}
+
+	/* Publish the table after it is complete */
+	smp_wmb();
+	hartid_to_index_plat = plat;
+}
+
 u32 sbi_platform_hart_index(const struct sbi_platform *plat, u32 hartid)
 {
 	u32 i;
@@ -70,6 +103,15 @@ u32 sbi_platform_hart_index(const struct sbi_platform *plat, u32 hartid)
 	if (!plat)
 		return -1U;
 	if (plat->hart_index2id) {
+		if (plat == hartid_to_index_plat) {
+			smp_rmb();
+			if (SBI_HARTMASK_MAX_BITS <= hartid ||
+			    hartid_to_index_table[hartid] == HART_INDEX_NONE)
+				return -1U;
+			return hartid_to_index_table[hartid];
+		}
+
+		/* Before cold boot built the reverse map */
 		for (i = 0; i < plat->hart_count; i++) {
 			if (plat->hart_index2id[i] == hartid)
 				return i;
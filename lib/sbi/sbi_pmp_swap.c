@@ -0,0 +1,327 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifdef SBI_PMP_SWAP
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_atomic.h>
+#include <sbi/riscv_encoding.h>
+#include <sbi/sbi_console.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_pmp_swap.h>
+#include <sbi/sbi_pmu.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_trap.h>
+
+#define PTE_V			(1UL << 0)
+#define PTE_R			(1UL << 1)
+#define PTE_W			(1UL << 2)
+#define PTE_X			(1UL << 3)
+#define PTE_PPN_SHIFT		10
+
+#if __riscv_xlen == 64
+#define PTE_PPN_MASK		((1UL << 44) - 1)
+#else
+#define PTE_PPN_MASK		((1UL << 22) - 1)
+#endif
+
+/*
+ * PMP entries of a HART used for swapped in regions. The stamp of an
+ * entry is the clock value when its region was swapped in. M-mode does
+ * not see accesses hitting a swapped in region so the entry swapped in
+ * longest ago is replaced.
+ */
+struct pmp_swap_hart {
+	unsigned int first;
+	unsigned int count;
+	unsigned long clock;
+	int region[SBI_PMP_SWAP_SLOTS_MAX];
+	unsigned long stamp[SBI_PMP_SWAP_SLOTS_MAX];
+};
+static unsigned long pmp_swap_offset;
+
+/* Number of swap-ins of each region of each domain */
+static atomic_t pmp_swap_count[SBI_DOMAIN_MAX_INDEX][SBI_PMP_SWAP_REGIONS_MAX];
+
+bool sbi_pmp_swap_enabled(const struct sbi_domain *dom)
+{
+	return (pmp_swap_offset && dom && dom->pmp_swap) ? TRUE : FALSE;
+}
+
+/* Regions are naturally aligned so they overlap when one holds the other */
+static bool pmp_swap_overlap(const struct sbi_domain_memregion *a,
+			     const struct sbi_domain_memregion *b)
+{
+	unsigned long order = (a->order < b->order) ? b->order : a->order;
+
+	if (__riscv_xlen <= order)
+		return TRUE;
+
+	return ((a->base ^ b->base) >> order) ? FALSE : TRUE;
+}
+
+bool sbi_pmp_swap_region(const struct sbi_domain *dom,
+			 const struct sbi_domain_memregion *reg)
+{
+	const struct sbi_domain_memregion *r;
+
+	if (!sbi_pmp_swap_enabled(dom) ||
+	    (reg->flags & SBI_DOMAIN_MEMREGION_MMODE))
+		return FALSE;
+
+	sbi_domain_for_each_memregion(dom, r) {
+		if (r != reg && pmp_swap_overlap(r, reg))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+unsigned int sbi_pmp_swap_configure(struct sbi_scratch *scratch,
+				    const struct sbi_domain *dom,
+				    unsigned int first)
+{
+	unsigned int i, count = 0;
+	struct pmp_swap_hart *ps;
+
+	if (!pmp_swap_offset)
+		return 0;
+
+	if (sbi_pmp_swap_enabled(dom) && first < sbi_hart_pmp_count(scratch)) {
+		count = sbi_hart_pmp_count(scratch) - first;
+		if (SBI_PMP_SWAP_SLOTS_MAX < count)
+			count = SBI_PMP_SWAP_SLOTS_MAX;
+	}
+
+	ps = sbi_scratch_offset_ptr(scratch, pmp_swap_offset);
+	ps->first = first;
+	ps->count = count;
+	ps->clock = 0;
+	for (i = 0; i < count; i++) {
+		ps->region[i] = -1;
+		ps->stamp[i] = 0;
+		sbi_hart_pmp_set_region(scratch, first + i, NULL);
+	}
+
+	return count;
+}
+
+static bool pmp_swap_resident(const struct pmp_swap_hart *ps, int idx)
+{
+	unsigned int i;
+
+	for (i = 0; i < ps->count; i++) {
+		if (ps->region[i] == idx)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/*
+ * Find the physical address which the HART failed to access for a
+ * virtual address of S-mode or U-mode and the region permission this
+ * access needs. The page tables are walked like the HART does so the
+ * walk stops at the first page table entry in a region which is not
+ * swapped in because that is where the walk of the HART faulted.
+ */
+static int pmp_swap_translate(const struct pmp_swap_hart *ps,
+			      const struct sbi_domain *dom,
+			      unsigned long va, unsigned long rwx,
+			      unsigned long *out_pa, unsigned long *out_rwx)
+{
+	int level;
+	unsigned long satp, ppn, pte, pte_addr, bits, shift;
+	const struct sbi_domain_memregion *reg;
+
+	satp = csr_read(CSR_SATP);
+#if __riscv_xlen == 32
+	if (!(satp & SATP32_MODE))
+		goto bare;
+	ppn = satp & SATP32_PPN;
+	level = 1;
+	bits = 10;
+#else
+	ppn = satp & SATP64_PPN;
+	bits = 9;
+	switch ((satp & SATP64_MODE) >> (__riscv_xlen - 4)) {
+	case SATP_MODE_OFF:
+		goto bare;
+	case SATP_MODE_SV39:
+		level = 2;
+		break;
+	case SATP_MODE_SV48:
+		level = 3;
+		break;
+	case SATP_MODE_SV57:
+		level = 4;
+		break;
+	default:
+		return SBI_ENOTSUPP;
+	}
+#endif
+
+	for (; 0 <= level; level--) {
+		/* Physical addresses beyond the XLEN are not supported */
+		if (ppn >> (__riscv_xlen - PAGE_SHIFT))
+			return SBI_ENOTSUPP;
+
+		shift = PAGE_SHIFT + level * bits;
+		pte_addr = (ppn << PAGE_SHIFT) +
+			   ((va >> shift) & ((1UL << bits) - 1)) * sizeof(pte);
+
+		/* Never read beyond what S-mode may read itself */
+		reg = sbi_domain_find_memregion(dom, pte_addr, PRV_S);
+		if (!reg || (reg->flags & SBI_DOMAIN_MEMREGION_MMIO) ||
+		    !(reg->flags & SBI_DOMAIN_MEMREGION_READABLE))
+			return SBI_EINVAL;
+		if (sbi_pmp_swap_region(dom, reg) &&
+		    !pmp_swap_resident(ps, reg - dom->regions)) {
+			*out_pa = pte_addr;
+			*out_rwx = SBI_DOMAIN_MEMREGION_READABLE;
+			return 0;
+		}
+
+		pte = *(volatile unsigned long *)pte_addr;
+		if (!(pte & PTE_V) || (!(pte & PTE_R) && (pte & PTE_W)))
+			return SBI_EINVAL;
+		ppn = (pte >> PTE_PPN_SHIFT) & PTE_PPN_MASK;
+		if (pte & (PTE_R | PTE_X)) {
+			if (ppn >> (__riscv_xlen - PAGE_SHIFT))
+				return SBI_ENOTSUPP;
+			/* Superpages take their low address bits from va */
+			*out_pa = ((ppn << PAGE_SHIFT) & ~((1UL << shift) - 1)) |
+				  (va & ((1UL << shift) - 1));
+			*out_rwx = rwx;
+			return 0;
+		}
+	}
+
+	return SBI_EINVAL;
+
+bare:
+	*out_pa = va;
+	*out_rwx = rwx;
+	return 0;
+}
+
+int sbi_pmp_swap_handler(struct sbi_trap_regs *regs,
+			 const struct sbi_trap_info *trap)
+{
+	int rc, idx;
+	unsigned int i, victim;
+	unsigned long pa, rwx, prev_mode;
+	const struct sbi_domain_memregion *reg;
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	const struct sbi_domain *dom = sbi_domain_thishart_ptr();
+	struct pmp_swap_hart *ps;
+
+	if (!sbi_pmp_swap_enabled(dom))
+		return SBI_ENOTSUPP;
+	ps = sbi_scratch_offset_ptr(scratch, pmp_swap_offset);
+	if (!ps->count)
+		return SBI_ENOTSUPP;
+
+	prev_mode = (regs->mstatus & MSTATUS_MPP) >> MSTATUS_MPP_SHIFT;
+	if (prev_mode != PRV_S && prev_mode != PRV_U)
+		return SBI_ENOTSUPP;
+
+	/* Guest physical addresses would need a G-stage walk as well */
+#if __riscv_xlen == 32
+	if (regs->mstatusH & MSTATUSH_MPV)
+#else
+	if (regs->mstatus & MSTATUS_MPV)
+#endif
+		return SBI_ENOTSUPP;
+
+	switch (trap->cause) {
+	case CAUSE_FETCH_ACCESS:
+		rwx = SBI_DOMAIN_MEMREGION_EXECUTABLE;
+		break;
+	case CAUSE_LOAD_ACCESS:
+		rwx = SBI_DOMAIN_MEMREGION_READABLE;
+		break;
+	case CAUSE_STORE_ACCESS:
+		rwx = SBI_DOMAIN_MEMREGION_WRITEABLE;
+		break;
+	default:
+		return SBI_ENOTSUPP;
+	}
+
+	rc = pmp_swap_translate(ps, dom, trap->tval, rwx, &pa, &rwx);
+	if (rc)
+		return rc;
+
+	/* A fault on a region already swapped in is a real access fault */
+	reg = sbi_domain_find_memregion(dom, pa, PRV_S);
+	if (!reg || !sbi_pmp_swap_region(dom, reg) ||
+	    (reg->flags & rwx) != rwx)
+		return SBI_ENOTSUPP;
+	idx = reg - dom->regions;
+	if (pmp_swap_resident(ps, idx))
+		return SBI_ENOTSUPP;
+
+	victim = 0;
+	for (i = 0; i < ps->count; i++) {
+		if (ps->region[i] < 0) {
+			victim = i;
+			break;
+		}
+		if (ps->stamp[i] < ps->stamp[victim])
+			victim = i;
+	}
+
+	rc = sbi_hart_pmp_set_region(scratch, ps->first + victim, reg);
+	if (rc)
+		return rc;
+	/* Translations cached before the change may carry stale checks */
+	__asm__ __volatile__("sfence.vma");
+
+	ps->region[victim] = idx;
+	ps->stamp[victim] = ++ps->clock;
+	if (dom->index < SBI_DOMAIN_MAX_INDEX && idx < SBI_PMP_SWAP_REGIONS_MAX)
+		atomic_add_return_relaxed(&pmp_swap_count[dom->index][idx], 1);
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_PMP_SWAP);
+
+	return 0;
+}
+
+void sbi_pmp_swap_dump(void)
+{
+	u32 i, j;
+	long count;
+	struct sbi_domain *dom;
+
+	sbi_domain_for_each(i, dom) {
+		if (!dom->pmp_swap)
+			continue;
+
+		for (j = 0; j < SBI_PMP_SWAP_REGIONS_MAX &&
+			    dom->regions[j].order; j++) {
+			count = atomic_read(&pmp_swap_count[i][j]);
+			if (count)
+				sbi_printf("Domain%d Region%02d: swapped in "
+					   "%ld times\n", i, j, count);
+		}
+	}
+}
+
+int sbi_pmp_swap_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	if (!cold_boot)
+		return 0;
+
+	pmp_swap_offset = sbi_scratch_alloc_offset(sizeof(struct pmp_swap_hart),
+						   "PMP_SWAP");
+	if (!pmp_swap_offset)
+		return SBI_ENOMEM;
+
+	return 0;
+}
+
+#endif
@@ -0,0 +1,553 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_encoding.h>
+#include <sbi/sbi_bitops.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_platform.h>
+#include <sbi/sbi_pmu.h>
+#include <sbi/sbi_pmu_sample.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
+#include <sbi/sbi_timer.h>
+
+/** Index of first mhpmcounterX in the hardware counters */
+#define PMU_MHPM_CTR_BASE		3
+/** Index of cycle counter */
+#define PMU_CYCLE_CTR			0
+/** Index of time counter (read only, never configured) */
+#define PMU_TIME_CTR			1
+/** Index of instret counter */
+#define PMU_INSTRET_CTR			2
+
+/** Number of firmware events including the OpenSBI specific ones */
+#define PMU_FW_EVENT_MAX		(SBI_PMU_FW_MAX + \
+					 SBI_PMU_FW_OPENSBI_END - \
+					 SBI_PMU_FW_OPENSBI_START + 1)
+
+/** Per-HART PMU state */
+struct sbi_pmu_hart_state {
+	/** Event index configured on each counter */
+	u32 active_events[SBI_PMU_CTR_MAX];
+	/** Event selector of each hardware counter */
+	unsigned long mhpmevent_val[SBI_PMU_HW_CTR_MAX];
+	/** Bitmap of started hardware counters */
+	unsigned long hw_started;
+	/** Bitmap of started firmware counters */
+	unsigned long fw_started;
+	/** Bitmap of started firmware counters for each firmware event */
+	u16 fw_event_ctrs[PMU_FW_EVENT_MAX];
+	/** Values of firmware counters */
+	u64 fw_counters[SBI_PMU_FW_CTR_MAX];
+	/** Event data of firmware counters (sampling period for samples) */
+	u64 fw_event_data[SBI_PMU_FW_CTR_MAX];
+};
+
+static unsigned long pmu_hart_state_off;
+
+/** Number of hardware counters including the time counter */
+static u32 num_hw_ctrs;
+
+/** Width minus one of mhpmcounterX */
+static u32 mhpm_ctr_width;
+
+static inline struct sbi_pmu_hart_state *pmu_thishart_state(void)
+{
+	return sbi_scratch_thishart_offset_ptr(pmu_hart_state_off);
+}
+
+static inline bool pmu_has_mcountinhibit(void)
+{
+	return sbi_hart_has_feature(sbi_scratch_thishart_ptr(),
+				    SBI_HART_HAS_MCOUNTINHIBIT);
+}
+
+static inline u32 pmu_event_type(unsigned long event_idx)
+{
+	return (event_idx & SBI_PMU_EVENT_IDX_TYPE_MASK) >>
+		SBI_PMU_EVENT_IDX_TYPE_OFFSET;
+}
+
+static inline u32 pmu_event_code(unsigned long event_idx)
+{
+	return event_idx & SBI_PMU_EVENT_IDX_CODE_MASK;
+}
+
+/* Map a firmware event code to its slot in fw_event_ctrs */
+static inline u32 pmu_fw_event_slot(u32 code)
+{
+	if (code < SBI_PMU_FW_MAX)
+		return code;
+	if (SBI_PMU_FW_OPENSBI_START <= code && code <= SBI_PMU_FW_OPENSBI_END)
+		return SBI_PMU_FW_MAX + code - SBI_PMU_FW_OPENSBI_START;
+
+	return PMU_FW_EVENT_MAX;
+}
+
+static void pmu_fw_event_fast_path(u32 code, bool enable)
+{
+	/* The trap vector handles these without counting them */
+	if (code == SBI_PMU_FW_SET_TIMER)
+		sbi_timer_event_fast_path(enable);
+	else if (code == SBI_PMU_FW_EMULATED_CSR)
+		sbi_timer_value_fast_path(enable);
+}
+
+static int pmu_ctr_validate(unsigned long cidx_base, unsigned long cidx_mask)
+{
+	if (!cidx_mask)
+		return SBI_EINVAL;
+	if (sbi_pmu_num_ctr() <= cidx_base ||
+	    sbi_pmu_num_ctr() - cidx_base <= __fls(cidx_mask))
+		return SBI_EINVAL;
+
+	return 0;
+}
+
+static void pmu_hw_ctr_write(u32 cidx, u64 val)
+{
+#if __riscv_xlen == 32
+	csr_write_num(CSR_MCYCLE + cidx, 0);
+	csr_write_num(CSR_MCYCLEH + cidx, val >> 32);
+#endif
+	csr_write_num(CSR_MCYCLE + cidx, val);
+}
+
+static int pmu_ctr_start_hw(struct sbi_pmu_hart_state *ps, u32 cidx,
+			    bool set_ival, u64 ival)
+{
+	if (ps->hw_started & BIT(cidx))
+		return SBI_EALREADY_STARTED;
+
+	if (set_ival)
+		pmu_hw_ctr_write(cidx, ival);
+
+	/*
+	 * Writing the selector again also clears the overflow bit so
+	 * that the next overflow raises a new interrupt.
+	 */
+	if (PMU_MHPM_CTR_BASE <= cidx)
+		csr_write_num(CSR_MHPMEVENT3 + cidx - PMU_MHPM_CTR_BASE,
+			      ps->mhpmevent_val[cidx]);
+	if (pmu_has_mcountinhibit())
+		csr_clear(CSR_MCOUNTINHIBIT, BIT(cidx));
+
+	ps->hw_started |= BIT(cidx);
+
+	return 0;
+}
+
+static int pmu_ctr_stop_hw(struct sbi_pmu_hart_state *ps, u32 cidx)
+{
+	if (!(ps->hw_started & BIT(cidx)))
+		return SBI_EALREADY_STOPPED;
+
+	/*
+	 * Without mcountinhibit the cycle and instret counters can't be
+	 * stopped so only mhpmcounterX really stop counting.
+	 */
+	if (pmu_has_mcountinhibit())
+		csr_set(CSR_MCOUNTINHIBIT, BIT(cidx));
+	else if (PMU_MHPM_CTR_BASE <= cidx)
+		csr_write_num(CSR_MHPMEVENT3 + cidx - PMU_MHPM_CTR_BASE, 0);
+
+	ps->hw_started &= ~BIT(cidx);
+
+	return 0;
+}
+
+static void pmu_ctr_reset_hw(struct sbi_pmu_hart_state *ps, u32 cidx)
+{
+	if (PMU_MHPM_CTR_BASE <= cidx) {
+		csr_write_num(CSR_MHPMEVENT3 + cidx - PMU_MHPM_CTR_BASE, 0);
+		ps->mhpmevent_val[cidx] = 0;
+	}
+	ps->active_events[cidx] = SBI_PMU_EVENT_IDX_INVALID;
+}
+
+static int pmu_ctr_start_fw(struct sbi_pmu_hart_state *ps, u32 cidx,
+			    bool set_ival, u64 ival)
+{
+	int rc;
+	u32 fidx = cidx - num_hw_ctrs;
+	u32 code = pmu_event_code(ps->active_events[cidx]);
+	u32 slot = pmu_fw_event_slot(code);
+
+	if (PMU_FW_EVENT_MAX <= slot)
+		return SBI_EINVAL;
+	if (ps->fw_started & BIT(fidx))
+		return SBI_EALREADY_STARTED;
+
+	/* The counter counts the samples taken by the sampling timer */
+	if (code == SBI_PMU_FW_PC_SAMPLE) {
+		rc = sbi_pmu_sample_start(ps->fw_event_data[fidx]);
+		if (rc)
+			return rc;
+	}
+
+	if (set_ival)
+		ps->fw_counters[fidx] = ival;
+
+	ps->fw_started |= BIT(fidx);
+	ps->fw_event_ctrs[slot] |= BIT(fidx);
+	pmu_fw_event_fast_path(code, FALSE);
+
+	return 0;
+}
+
+static int pmu_ctr_stop_fw(struct sbi_pmu_hart_state *ps, u32 cidx)
+{
+	u32 fidx = cidx - num_hw_ctrs;
+	u32 code = pmu_event_code(ps->active_events[cidx]);
+	u32 slot = pmu_fw_event_slot(code);
+
+	if (PMU_FW_EVENT_MAX <= slot)
+		return SBI_EINVAL;
+	if (!(ps->fw_started & BIT(fidx)))
+		return SBI_EALREADY_STOPPED;
+
+	ps->fw_started &= ~BIT(fidx);
+	ps->fw_event_ctrs[slot] &= ~BIT(fidx);
+	if (!ps->fw_event_ctrs[slot]) {
+		pmu_fw_event_fast_path(code, TRUE);
+		if (code == SBI_PMU_FW_PC_SAMPLE)
+			sbi_pmu_sample_stop();
+	}
+
+	return 0;
+}
+
+unsigned long sbi_pmu_num_ctr(void)
+{
+	return num_hw_ctrs + SBI_PMU_FW_CTR_MAX;
+}
+
+int sbi_pmu_ctr_get_info(u32 cidx, unsigned long *ctr_info)
+{
+	unsigned long width;
+
+	if (sbi_pmu_num_ctr() <= cidx)
+		return SBI_EINVAL;
+
+	if (num_hw_ctrs <= cidx) {
+		*ctr_info = SBI_PMU_CTR_INFO_TYPE_FW;
+		return 0;
+	}
+
+	width = (PMU_MHPM_CTR_BASE <= cidx) ? mhpm_ctr_width : 63;
+	*ctr_info = ((CSR_CYCLE + cidx) & SBI_PMU_CTR_INFO_CSR_MASK) |
+		    ((width & SBI_PMU_CTR_INFO_WIDTH_MASK) <<
+		     SBI_PMU_CTR_INFO_WIDTH_OFFSET);
+
+	return 0;
+}
+
+static int pmu_ctr_config_hw(struct sbi_pmu_hart_state *ps, u32 cidx,
+			     unsigned long flags, unsigned long event_idx,
+			     u64 val)
+{
+	if (PMU_MHPM_CTR_BASE <= cidx) {
+#if __riscv_xlen == 64
+		if (sbi_hart_has_feature(sbi_scratch_thishart_ptr(),
+					 SBI_HART_HAS_SSCOFPMF)) {
+			val &= ~MHPMEVENT_SSCOF_MASK;
+			if (flags & SBI_PMU_CFG_FLAG_SET_VUINH)
+				val |= MHPMEVENT_VUINH;
+			if (flags & SBI_PMU_CFG_FLAG_SET_VSINH)
+				val |= MHPMEVENT_VSINH;
+			if (flags & SBI_PMU_CFG_FLAG_SET_UINH)
+				val |= MHPMEVENT_UINH;
+			if (flags & SBI_PMU_CFG_FLAG_SET_SINH)
+				val |= MHPMEVENT_SINH;
+			if (flags & SBI_PMU_CFG_FLAG_SET_MINH)
+				val |= MHPMEVENT_MINH;
+		}
+#endif
+		ps->mhpmevent_val[cidx] = val;
+	}
+	ps->active_events[cidx] = event_idx;
+
+	return cidx;
+}
+
+static int pmu_ctr_find_hw(struct sbi_pmu_hart_state *ps,
+			   unsigned long cidx_base, unsigned long cidx_mask,
+			   unsigned long flags, unsigned long event_idx,
+			   u64 event_data)
+{
+	int rc;
+	u64 val = 0;
+	u32 i, cidx, fixed = SBI_PMU_HW_CTR_MAX;
+	u32 type = pmu_event_type(event_idx);
+	u32 code = pmu_event_code(event_idx);
+	const struct sbi_platform *plat = sbi_platform_thishart_ptr();
+
+	/* The cycle and instret counters can only count one event */
+	if (type == SBI_PMU_EVENT_TYPE_HW && code == SBI_PMU_HW_CPU_CYCLES)
+		fixed = PMU_CYCLE_CTR;
+	else if (type == SBI_PMU_EVENT_TYPE_HW &&
+		 code == SBI_PMU_HW_INSTRUCTIONS)
+		fixed = PMU_INSTRET_CTR;
+	else if (type == SBI_PMU_EVENT_TYPE_HW_RAW)
+		val = event_data;
+	else {
+		rc = sbi_platform_pmu_event_map(plat, event_idx,
+						event_data, &val);
+		if (rc)
+			return rc;
+	}
+
+	for_each_set_bit(i, &cidx_mask, BITS_PER_LONG) {
+		cidx = cidx_base + i;
+		if (num_hw_ctrs <= cidx)
+			break;
+		if (fixed < SBI_PMU_HW_CTR_MAX && cidx != fixed)
+			continue;
+		if (fixed == SBI_PMU_HW_CTR_MAX && cidx < PMU_MHPM_CTR_BASE)
+			continue;
+		if (ps->active_events[cidx] == SBI_PMU_EVENT_IDX_INVALID)
+			return pmu_ctr_config_hw(ps, cidx, flags,
+						 event_idx, val);
+	}
+
+	return SBI_ENOTSUPP;
+}
+
+static int pmu_ctr_find_fw(struct sbi_pmu_hart_state *ps,
+			   unsigned long cidx_base, unsigned long cidx_mask,
+			   unsigned long event_idx, u64 event_data)
+{
+	u32 i, cidx;
+	u32 code = pmu_event_code(event_idx);
+
+	if (PMU_FW_EVENT_MAX <= pmu_fw_event_slot(code))
+		return SBI_EINVAL;
+	if (code == SBI_PMU_FW_PC_SAMPLE &&
+	    sbi_pmu_sample_get_buffer(NULL, NULL))
+		return SBI_ENOTSUPP;
+
+	for_each_set_bit(i, &cidx_mask, BITS_PER_LONG) {
+		cidx = cidx_base + i;
+		if (cidx < num_hw_ctrs)
+			continue;
+		if (ps->active_events[cidx] == SBI_PMU_EVENT_IDX_INVALID) {
+			ps->active_events[cidx] = event_idx;
+			ps->fw_counters[cidx - num_hw_ctrs] = 0;
+			ps->fw_event_data[cidx - num_hw_ctrs] = event_data;
+			return cidx;
+		}
+	}
+
+	return SBI_ENOTSUPP;
+}
+
+int sbi_pmu_ctr_cfg_match(unsigned long cidx_base, unsigned long cidx_mask,
+			  unsigned long flags, unsigned long event_idx,
+			  u64 event_data)
+{
+	int rc, cidx;
+	struct sbi_pmu_hart_state *ps = pmu_thishart_state();
+
+	rc = pmu_ctr_validate(cidx_base, cidx_mask);
+	if (rc)
+		return rc;
+
+	if (flags & SBI_PMU_CFG_FLAG_SKIP_MATCH) {
+		/* Counter is already configured by a previous call */
+		cidx = cidx_base + __ffs(cidx_mask);
+		if (ps->active_events[cidx] == SBI_PMU_EVENT_IDX_INVALID)
+			return SBI_EINVAL;
+	} else {
+		switch (pmu_event_type(event_idx)) {
+		case SBI_PMU_EVENT_TYPE_HW:
+		case SBI_PMU_EVENT_TYPE_HW_CACHE:
+		case SBI_PMU_EVENT_TYPE_HW_RAW:
+			cidx = pmu_ctr_find_hw(ps, cidx_base, cidx_mask,
+					       flags, event_idx, event_data);
+			break;
+		case SBI_PMU_EVENT_TYPE_FW:
+			cidx = pmu_ctr_find_fw(ps, cidx_base, cidx_mask,
+					       event_idx, event_data);
+			break;
+		default:
+			return SBI_EINVAL;
+		};
+		if (cidx < 0)
+			return cidx;
+	}
+
+	if (cidx < num_hw_ctrs) {
+		if (flags & SBI_PMU_CFG_FLAG_CLEAR_VALUE)
+			pmu_hw_ctr_write(cidx, 0);
+		if (flags & SBI_PMU_CFG_FLAG_AUTO_START)
+			pmu_ctr_start_hw(ps, cidx, FALSE, 0);
+	} else {
+		if (flags & SBI_PMU_CFG_FLAG_CLEAR_VALUE)
+			ps->fw_counters[cidx - num_hw_ctrs] = 0;
+		if (flags & SBI_PMU_CFG_FLAG_AUTO_START)
+			pmu_ctr_start_fw(ps, cidx, FALSE, 0);
+	}
+
+	return cidx;
+}
+
+int sbi_pmu_ctr_start(unsigned long cidx_base, unsigned long cidx_mask,
+		      unsigned long flags, u64 ival)
+{
+	u32 i, cidx;
+	int rc, ret = 0;
+	bool set_ival = (flags & SBI_PMU_START_FLAG_SET_INIT_VALUE) ?
+			TRUE : FALSE;
+	struct sbi_pmu_hart_state *ps = pmu_thishart_state();
+
+	rc = pmu_ctr_validate(cidx_base, cidx_mask);
+	if (rc)
+		return rc;
+
+	for_each_set_bit(i, &cidx_mask, BITS_PER_LONG) {
+		cidx = cidx_base + i;
+		if (ps->active_events[cidx] == SBI_PMU_EVENT_IDX_INVALID)
+			return SBI_EINVAL;
+		if (cidx < num_hw_ctrs)
+			rc = pmu_ctr_start_hw(ps, cidx, set_ival, ival);
+		else
+			rc = pmu_ctr_start_fw(ps, cidx, set_ival, ival);
+		if (rc)
+			ret = rc;
+	}
+
+	return ret;
+}
+
+int sbi_pmu_ctr_stop(unsigned long cidx_base, unsigned long cidx_mask,
+		     unsigned long flags)
+{
+	u32 i, cidx;
+	int rc, ret = 0;
+	bool reset = (flags & SBI_PMU_STOP_FLAG_RESET) ? TRUE : FALSE;
+	struct sbi_pmu_hart_state *ps = pmu_thishart_state();
+
+	rc = pmu_ctr_validate(cidx_base, cidx_mask);
+	if (rc)
+		return rc;
+
+	for_each_set_bit(i, &cidx_mask, BITS_PER_LONG) {
+		cidx = cidx_base + i;
+		if (ps->active_events[cidx] == SBI_PMU_EVENT_IDX_INVALID)
+			return SBI_EINVAL;
+		if (cidx < num_hw_ctrs) {
+			rc = pmu_ctr_stop_hw(ps, cidx);
+			if (reset)
+				pmu_ctr_reset_hw(ps, cidx);
+		} else {
+			rc = pmu_ctr_stop_fw(ps, cidx);
+			if (reset)
+				ps->active_events[cidx] =
+						SBI_PMU_EVENT_IDX_INVALID;
+		}
+		if (rc)
+			ret = rc;
+	}
+
+	return ret;
+}
+
+int sbi_pmu_ctr_fw_read(u32 cidx, u64 *cval)
+{
+	struct sbi_pmu_hart_state *ps = pmu_thishart_state();
+
+	if (cidx < num_hw_ctrs || sbi_pmu_num_ctr() <= cidx ||
+	    ps->active_events[cidx] == SBI_PMU_EVENT_IDX_INVALID)
+		return SBI_EINVAL;
+
+	*cval = ps->fw_counters[cidx - num_hw_ctrs];
+
+	return 0;
+}
+
+void sbi_pmu_ctr_incr_fw(u32 fw_id)
+{
+	unsigned long ctrs;
+	struct sbi_pmu_hart_state *ps;
+	u32 slot = pmu_fw_event_slot(fw_id);
+
+	if (!pmu_hart_state_off || PMU_FW_EVENT_MAX <= slot)
+		return;
+
+	ps = pmu_thishart_state();
+	ctrs = ps->fw_event_ctrs[slot];
+	while (ctrs) {
+		ps->fw_counters[__ffs(ctrs)]++;
+		ctrs &= ctrs - 1;
+	}
+}
+
+void sbi_pmu_exit(struct sbi_scratch *scratch)
+{
+	u32 i;
+	struct sbi_pmu_hart_state *ps;
+
+	if (!pmu_hart_state_off)
+		return;
+
+	ps = sbi_scratch_offset_ptr(scratch, pmu_hart_state_off);
+	for (i = 0; i < num_hw_ctrs; i++) {
+		if (ps->hw_started & BIT(i))
+			pmu_ctr_stop_hw(ps, i);
+		pmu_ctr_reset_hw(ps, i);
+	}
+	for (i = num_hw_ctrs; i < sbi_pmu_num_ctr(); i++) {
+		if (ps->fw_started & BIT(i - num_hw_ctrs))
+			pmu_ctr_stop_fw(ps, i);
+		ps->active_events[i] = SBI_PMU_EVENT_IDX_INVALID;
+	}
+}
+
+int sbi_pmu_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	u32 i;
+	struct sbi_pmu_hart_state *ps;
+
+	if (cold_boot) {
+		pmu_hart_state_off = sbi_scratch_alloc_offset(sizeof(*ps),
+							      "PMU_HART");
+		if (!pmu_hart_state_off)
+			return SBI_ENOMEM;
+
+		num_hw_ctrs = PMU_MHPM_CTR_BASE + sbi_hart_mhpm_count(scratch);
+		if (SBI_PMU_HW_CTR_MAX < num_hw_ctrs)
+			num_hw_ctrs = SBI_PMU_HW_CTR_MAX;
+
+		/* Implemented counter bits read back as ones */
+		mhpm_ctr_width = 63;
+#if __riscv_xlen == 64
+		if (PMU_MHPM_CTR_BASE < num_hw_ctrs) {
+			csr_write(CSR_MHPMCOUNTER3, -1UL);
+			mhpm_ctr_width = __fls(csr_swap(CSR_MHPMCOUNTER3, 0));
+		}
+#endif
+	} else if (!pmu_hart_state_off) {
+		return SBI_ENOMEM;
+	}
+
+	ps = sbi_scratch_offset_ptr(scratch, pmu_hart_state_off);
+	sbi_memset(ps, 0, sizeof(*ps));
+	for (i = 0; i < SBI_PMU_CTR_MAX; i++)
+		ps->active_events[i] = SBI_PMU_EVENT_IDX_INVALID;
+
+	/* Keep mhpmcounterX stopped until they are configured */
+	for (i = PMU_MHPM_CTR_BASE; i < num_hw_ctrs; i++)
+		csr_write_num(CSR_MHPMEVENT3 + i - PMU_MHPM_CTR_BASE, 0);
+	if (pmu_has_mcountinhibit())
+		csr_write(CSR_MCOUNTINHIBIT, ~(BIT(PMU_CYCLE_CTR) |
+					       BIT(PMU_TIME_CTR) |
+					       BIT(PMU_INSTRET_CTR)));
+
+	return 0;
+}
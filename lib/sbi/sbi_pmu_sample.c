@@ -0,0 +1,202 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifdef SBI_PMU_SAMPLE
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_barrier.h>
+#include <sbi/riscv_encoding.h>
+#include <sbi/sbi_bitops.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_platform.h>
+#include <sbi/sbi_pmu.h>
+#include <sbi/sbi_pmu_sample.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_timer.h>
+
+/*
+ * The buffer is naturally aligned so that a single domain memory region
+ * (and PMP entry) can make it readable for S-mode inside the firmware.
+ */
+static u8 sample_buf[SBI_PMU_SAMPLE_SIZE] __aligned(SBI_PMU_SAMPLE_SIZE);
+static struct sbi_pmu_sample_header *sample_hdr;
+
+static struct sbi_pmu_sample_ring *pmu_sample_ring(u32 hartindex)
+{
+	if (!sample_hdr || sample_hdr->hart_count <= hartindex)
+		return NULL;
+
+	return (void *)sample_buf + sample_hdr->ring_offset +
+	       hartindex * sample_hdr->ring_size;
+}
+
+static u64 pmu_sample_cycle(void)
+{
+#if __riscv_xlen == 32
+	u32 hi, lo;
+
+	do {
+		hi = csr_read(CSR_MCYCLEH);
+		lo = csr_read(CSR_MCYCLE);
+	} while (hi != csr_read(CSR_MCYCLEH));
+
+	return ((u64)hi << 32) | lo;
+#else
+	return csr_read(CSR_MCYCLE);
+#endif
+}
+
+static bool pmu_sample_virt(void)
+{
+	if (!misa_extension('H'))
+		return FALSE;
+#if __riscv_xlen == 32
+	return (csr_read(CSR_MSTATUSH) & MSTATUSH_MPV) ? TRUE : FALSE;
+#else
+	return (csr_read(CSR_MSTATUS) & MSTATUS_MPV) ? TRUE : FALSE;
+#endif
+}
+
+/*
+ * Called from the M-mode timer interrupt so mepc and mstatus still
+ * describe the interrupted context.
+ */
+static void pmu_sample_event(struct sbi_scratch *scratch)
+{
+	u64 head;
+	u32 mode;
+	bool virt;
+	struct sbi_pmu_sample_record *rec;
+	struct sbi_pmu_sample_ring *ring =
+			pmu_sample_ring(sbi_current_hartindex());
+
+	if (!ring || !ring->period)
+		return;
+
+	/* Only S-mode and U-mode are profiled, not the firmware itself */
+	mode = EXTRACT_FIELD(csr_read(CSR_MSTATUS), MSTATUS_MPP);
+	if (mode == PRV_U || mode == PRV_S) {
+		virt = pmu_sample_virt();
+		head = ring->head;
+		rec = (struct sbi_pmu_sample_record *)(ring + 1) +
+		      (head & (sample_hdr->record_count - 1));
+		rec->cycle = pmu_sample_cycle();
+		rec->pc = csr_read(CSR_MEPC);
+		rec->satp = (virt) ? csr_read(CSR_VSATP) : csr_read(CSR_SATP);
+		rec->mode = mode | ((virt) ? SBI_PMU_SAMPLE_MODE_VIRT : 0);
+
+		/* Publish the record before advancing head */
+		smp_wmb();
+		ring->head = head + 1;
+
+		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_PC_SAMPLE);
+	}
+
+	sbi_timer_mevent_start(sbi_timer_value() + ring->period,
+			       pmu_sample_event);
+}
+
+int sbi_pmu_sample_get_buffer(unsigned long *addr, unsigned long *size)
+{
+	if (!sample_hdr)
+		return SBI_ENOTSUPP;
+
+	if (addr)
+		*addr = (unsigned long)sample_buf;
+	if (size)
+		*size = SBI_PMU_SAMPLE_SIZE;
+
+	return 0;
+}
+
+int sbi_pmu_sample_start(u64 period)
+{
+	int rc;
+	struct sbi_pmu_sample_ring *ring =
+			pmu_sample_ring(sbi_current_hartindex());
+
+	if (!ring)
+		return SBI_ENOTSUPP;
+
+	if (!period)
+		period = SBI_PMU_SAMPLE_PERIOD_DEFAULT;
+
+	rc = sbi_timer_mevent_start(sbi_timer_value() + period,
+				    pmu_sample_event);
+	if (rc)
+		return rc;
+	ring->period = period;
+
+	return 0;
+}
+
+void sbi_pmu_sample_stop(void)
+{
+	struct sbi_pmu_sample_ring *ring =
+			pmu_sample_ring(sbi_current_hartindex());
+
+	if (!ring)
+		return;
+
+	sbi_timer_mevent_stop(pmu_sample_event);
+	ring->period = 0;
+}
+
+int sbi_pmu_sample_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	int rc;
+	u32 i, hart_count, count;
+	unsigned long avail;
+	struct sbi_domain_memregion reg;
+	struct sbi_pmu_sample_header *hdr =
+			(struct sbi_pmu_sample_header *)sample_buf;
+	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
+
+	if (!cold_boot)
+		return 0;
+
+	hart_count = sbi_platform_hart_count(plat);
+	if (!hart_count)
+		return SBI_EINVAL;
+
+	/* Largest power of two number of records per HART which fits */
+	avail = (SBI_PMU_SAMPLE_SIZE - sizeof(*hdr)) / hart_count;
+	if (avail < sizeof(struct sbi_pmu_sample_ring))
+		return SBI_ENOSPC;
+	avail = (avail - sizeof(struct sbi_pmu_sample_ring)) /
+		sizeof(struct sbi_pmu_sample_record);
+	for (count = 1; count * 2 <= avail; count *= 2)
+		;
+	if (count < 2)
+		return SBI_ENOSPC;
+
+	hdr->magic = SBI_PMU_SAMPLE_MAGIC;
+	hdr->version = SBI_PMU_SAMPLE_VERSION;
+	hdr->hart_count = hart_count;
+	hdr->record_count = count;
+	hdr->record_size = sizeof(struct sbi_pmu_sample_record);
+	hdr->ring_offset = sizeof(*hdr);
+	hdr->ring_size = sizeof(struct sbi_pmu_sample_ring) +
+			 count * sizeof(struct sbi_pmu_sample_record);
+
+	/* S-mode may read the buffer but only M-mode writes it */
+	sbi_domain_memregion_init((unsigned long)sample_buf,
+				  SBI_PMU_SAMPLE_SIZE,
+				  SBI_DOMAIN_MEMREGION_READABLE, &reg);
+	rc = sbi_domain_root_add_memregion(&reg);
+	if (rc)
+		return rc;
+
+	sample_hdr = hdr;
+	for (i = 0; i < hart_count; i++)
+		pmu_sample_ring(i)->hartid = sbi_platform_hart_index2id(plat, i);
+
+	return 0;
+}
+
+#endif
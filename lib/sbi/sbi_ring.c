@@ -0,0 +1,177 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <sbi/riscv_barrier.h>
+#include <sbi/riscv_locks.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_ring.h>
+#include <sbi/sbi_string.h>
+
+int sbi_ring_init(struct sbi_ring *ring, void *mem, u32 entries,
+		  u32 entry_size)
+{
+	if (!ring || !mem || !entry_size || !entries ||
+	    (entries & (entries - 1)))
+		return SBI_EINVAL;
+
+	ring->mem = mem;
+	ring->entry_size = entry_size;
+	ring->mask = entries - 1;
+	ring->head = ring->tail = 0;
+	QSPIN_LOCK_INIT(ring->lock);
+
+	return 0;
+}
+
+void sbi_ring_reset(struct sbi_ring *ring)
+{
+	qspin_lock(&ring->lock);
+	ring->tail = ring->head;
+	qspin_unlock(&ring->lock);
+}
+
+void *sbi_ring_reserve(struct sbi_ring *ring)
+{
+	qspin_lock(&ring->lock);
+
+	if (ring->head - ring->tail == sbi_ring_size(ring)) {
+		qspin_unlock(&ring->lock);
+		return NULL;
+	}
+
+	return sbi_ring_entry(ring, ring->head);
+}
+
+void sbi_ring_commit(struct sbi_ring *ring)
+{
+	/* Lockless readers must not see the head before the entry */
+	smp_wmb();
+	ring->head++;
+	qspin_unlock(&ring->lock);
+}
+
+void sbi_ring_cancel(struct sbi_ring *ring)
+{
+	qspin_unlock(&ring->lock);
+}
+
+int sbi_ring_enqueue(struct sbi_ring *ring, const void *data)
+{
+	void *entry;
+
+	if (!ring || !data)
+		return SBI_EINVAL;
+
+	entry = sbi_ring_reserve(ring);
+	if (!entry)
+		return SBI_ENOSPC;
+
+	sbi_memcpy(entry, data, ring->entry_size);
+	sbi_ring_commit(ring);
+
+	return 0;
+}
+
+int sbi_ring_dequeue(struct sbi_ring *ring, void *data)
+{
+	if (!ring || !data)
+		return SBI_EINVAL;
+
+	return sbi_ring_dequeue_many(ring, data, 1) ? 0 : SBI_ENOENT;
+}
+
+/*
+ * Copy count entries starting at a free running index between the ring
+ * and a linear buffer. At most two copies are needed, up to the end of
+ * the ring memory and from its start.
+ */
+static void ring_copy(struct sbi_ring *ring, u32 idx, void *buf, u32 count,
+		      bool to_ring)
+{
+	u32 first = sbi_ring_size(ring) - (idx & ring->mask);
+	void *entry = sbi_ring_entry(ring, idx);
+
+	if (count < first)
+		first = count;
+
+	if (to_ring) {
+		sbi_memcpy(entry, buf, first * ring->entry_size);
+		sbi_memcpy(ring->mem, buf + first * ring->entry_size,
+			   (count - first) * ring->entry_size);
+	} else {
+		sbi_memcpy(buf, entry, first * ring->entry_size);
+		sbi_memcpy(buf + first * ring->entry_size, ring->mem,
+			   (count - first) * ring->entry_size);
+	}
+}
+
+u32 sbi_ring_enqueue_many(struct sbi_ring *ring, const void *data, u32 count)
+{
+	u32 space;
+
+	if (!ring || !data || !count)
+		return 0;
+
+	qspin_lock(&ring->lock);
+
+	space = sbi_ring_size(ring) - (ring->head - ring->tail);
+	if (space < count)
+		count = space;
+	if (count) {
+		ring_copy(ring, ring->head, (void *)data, count, TRUE);
+		smp_wmb();
+		ring->head += count;
+	}
+
+	qspin_unlock(&ring->lock);
+
+	return count;
+}
+
+u32 sbi_ring_dequeue_many(struct sbi_ring *ring, void *data, u32 count)
+{
+	u32 avail;
+
+	if (!ring || !data || !count || sbi_ring_is_empty(ring))
+		return 0;
+
+	qspin_lock(&ring->lock);
+
+	avail = ring->head - ring->tail;
+	if (avail < count)
+		count = avail;
+	if (count) {
+		ring_copy(ring, ring->tail, data, count, FALSE);
+		ring->tail += count;
+	}
+
+	qspin_unlock(&ring->lock);
+
+	return count;
+}
+
+int sbi_ring_update(struct sbi_ring *ring, void *in,
+		    int (*fptr)(void *in, void *data))
+{
+	u32 idx, head;
+	int ret = SBI_RING_UNCHANGED;
+
+	if (!ring || !in || sbi_ring_is_empty(ring))
+		return ret;
+
+	qspin_lock(&ring->lock);
+
+	head = ring->head;
+	for (idx = ring->tail; idx != head; idx++) {
+		ret = fptr(in, sbi_ring_entry(ring, idx));
+		if (ret == SBI_RING_SKIP || ret == SBI_RING_UPDATED)
+			break;
+	}
+
+	qspin_unlock(&ring->lock);
+
+	return ret;
+}
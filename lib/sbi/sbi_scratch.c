@@ -17,64 +17,215 @@
 u32 last_hartid_having_scratch = SBI_HARTMASK_MAX_BITS;
 struct sbi_scratch *hartid_to_scratch_table[SBI_HARTMASK_MAX_BITS] = { 0 };
 
+/* Maximum number of allocated and free chunks in the extra space */
+#define SCRATCH_CHUNK_MAX	64
+
+/*
+ * The extra space below extra_offset is fully covered by chunks sorted
+ * by offset. A free chunk has no owner and is never next to another
+ * free chunk or at the end, where it would be given back to extra_offset.
+ */
+struct scratch_chunk {
+	unsigned long offset;
+	unsigned long size;
+	const char *owner;
+};
+
 static spinlock_t extra_lock = SPIN_LOCK_INITIALIZER;
 static unsigned long extra_offset = SBI_SCRATCH_EXTRA_SPACE_OFFSET;
+/* Space given back to extra_offset stays dirty up to this offset */
+static unsigned long extra_high = SBI_SCRATCH_EXTRA_SPACE_OFFSET;
+static struct scratch_chunk scratch_chunks[SCRATCH_CHUNK_MAX];
+static u32 scratch_chunk_count;
 
 typedef struct sbi_scratch *(*hartid2scratch)(ulong hartid, ulong hartindex);
 
 int sbi_scratch_init(struct sbi_scratch *scratch)
 {
-	u32 i;
+	u32 i, hartid, last = SBI_HARTMASK_MAX_BITS;
+	struct sbi_scratch *rscratch;
 	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
 
-	for (i = 0; i < SBI_HARTMASK_MAX_BITS; i++) {
-		if (sbi_platform_hart_invalid(plat, i))
+	sbi_platform_hart_index_init(plat);
+
+	for (i = 0; i < sbi_platform_hart_count(plat); i++) {
+		hartid = sbi_platform_hart_index2id(plat, i);
+		if (SBI_HARTMASK_MAX_BITS <= hartid ||
+		    hartid_to_scratch_table[hartid])
+			continue;
+		rscratch = ((hartid2scratch)scratch->hartid_to_scratch)(hartid,
+									i);
+		hartid_to_scratch_table[hartid] = rscratch;
+		if (!rscratch)
 			continue;
-		hartid_to_scratch_table[i] =
-			((hartid2scratch)scratch->hartid_to_scratch)(i,
-					sbi_platform_hart_index(plat, i));
-		if (hartid_to_scratch_table[i])
-			last_hartid_having_scratch = i;
+		rscratch->hartid = hartid;
+		rscratch->hartindex = i;
+		/*
+		 * Clear the extra space of each HART in one pass so that
+		 * space handed out for the first time needn't be cleared
+		 * on every HART by each allocation.
+		 */
+		sbi_memset(sbi_scratch_offset_ptr(rscratch,
+					SBI_SCRATCH_EXTRA_SPACE_OFFSET), 0,
+			   SBI_SCRATCH_SIZE - SBI_SCRATCH_EXTRA_SPACE_OFFSET);
+		if (last == SBI_HARTMASK_MAX_BITS || last < hartid)
+			last = hartid;
 	}
+	last_hartid_having_scratch = last;
 
 	return 0;
 }
 
-unsigned long sbi_scratch_alloc_offset(unsigned long size, const char *owner)
+static int scratch_chunk_insert(u32 i, unsigned long offset,
+				unsigned long size, const char *owner)
+{
+	u32 j;
+
+	if (SCRATCH_CHUNK_MAX <= scratch_chunk_count)
+		return SBI_ENOSPC;
+
+	for (j = scratch_chunk_count; j > i; j--)
+		scratch_chunks[j] = scratch_chunks[j - 1];
+	scratch_chunks[i].offset = offset;
+	scratch_chunks[i].size = size;
+	scratch_chunks[i].owner = owner;
+	scratch_chunk_count++;
+
+	return 0;
+}
+
+static void scratch_chunk_remove(u32 i)
+{
+	scratch_chunk_count--;
+	for (; i < scratch_chunk_count; i++)
+		scratch_chunks[i] = scratch_chunks[i + 1];
+}
+
+/* Allocate from the best fitting free chunk, zero if none fits */
+static unsigned long scratch_chunk_alloc(unsigned long size,
+					 unsigned long align,
+					 const char *owner)
+{
+	u32 i, best = SCRATCH_CHUNK_MAX;
+	unsigned long start, end, best_waste = 0;
+	struct scratch_chunk *c;
+
+	for (i = 0; i < scratch_chunk_count; i++) {
+		c = &scratch_chunks[i];
+		if (c->owner)
+			continue;
+		start = (c->offset + align - 1) & ~(align - 1);
+		if (c->offset + c->size < start + size)
+			continue;
+		if (best == SCRATCH_CHUNK_MAX || c->size - size < best_waste) {
+			best = i;
+			best_waste = c->size - size;
+		}
+	}
+	if (best == SCRATCH_CHUNK_MAX)
+		return 0;
+
+	c = &scratch_chunks[best];
+	start = (c->offset + align - 1) & ~(align - 1);
+	end = c->offset + c->size;
+	if (SCRATCH_CHUNK_MAX <
+	    scratch_chunk_count + (start != c->offset) + (start + size != end))
+		return 0;
+
+	/* Split off the free space in front of and after the allocation */
+	if (start != c->offset) {
+		c->size = start - c->offset;
+		scratch_chunk_insert(++best, start, end - start, NULL);
+		c = &scratch_chunks[best];
+	}
+	if (start + size != end) {
+		c->size = size;
+		scratch_chunk_insert(best + 1, start + size,
+				     end - (start + size), NULL);
+	}
+	c->owner = owner;
+
+	return start;
+}
+
+/* Allocate at the end of the extra space, zero if there is no space */
+static unsigned long scratch_extra_alloc(unsigned long size,
+					 unsigned long align,
+					 const char *owner)
+{
+	unsigned long start = (extra_offset + align - 1) & ~(align - 1);
+
+	if (SBI_SCRATCH_SIZE < start || SBI_SCRATCH_SIZE - start < size)
+		return 0;
+
+	/* Padding is kept as a free chunk (or merged into the last one) */
+	if (start != extra_offset) {
+		if (scratch_chunk_count &&
+		    !scratch_chunks[scratch_chunk_count - 1].owner)
+			scratch_chunks[scratch_chunk_count - 1].size +=
+							start - extra_offset;
+		else if (scratch_chunk_insert(scratch_chunk_count, extra_offset,
+					      start - extra_offset, NULL))
+			return 0;
+	}
+
+	if (scratch_chunk_insert(scratch_chunk_count, start, size, owner)) {
+		/* Padding chunk (if any) is the last one and is dropped */
+		if (start != extra_offset) {
+			if (scratch_chunks[scratch_chunk_count - 1].offset ==
+			    extra_offset)
+				scratch_chunk_remove(scratch_chunk_count - 1);
+			else
+				scratch_chunks[scratch_chunk_count - 1].size -=
+							start - extra_offset;
+		}
+		return 0;
+	}
+	extra_offset = start + size;
+
+	return start;
+}
+
+unsigned long sbi_scratch_alloc_aligned_offset(unsigned long size,
+					       unsigned long align,
+					       const char *owner)
 {
 	u32 i;
 	void *ptr;
-	unsigned long ret = 0;
+	bool reused;
+	unsigned long ret;
 	struct sbi_scratch *rscratch;
 
-	/*
-	 * We have a simple brain-dead allocator which never expects
-	 * anything to be free-ed hence it keeps incrementing the
-	 * next allocation offset until it runs-out of space.
-	 *
-	 * In future, we will have more sophisticated allocator which
-	 * will allow us to re-claim free-ed space.
-	 */
-
-	if (!size)
+	if (!size || (align & (align - 1)))
 		return 0;
 
-	if (size & (__SIZEOF_POINTER__ - 1))
-		size = (size & ~(__SIZEOF_POINTER__ - 1)) + __SIZEOF_POINTER__;
+	if (align < __SIZEOF_POINTER__)
+		align = __SIZEOF_POINTER__;
+	if (size & (align - 1))
+		size = (size & ~(align - 1)) + align;
 
 	spin_lock(&extra_lock);
 
-	if (SBI_SCRATCH_SIZE < (extra_offset + size))
-		goto done;
-
-	ret = extra_offset;
-	extra_offset += size;
+	/* Reuse free-ed space before growing the used extra space */
+	ret = scratch_chunk_alloc(size, align, (owner) ? owner : "");
+	reused = (ret) ? TRUE : FALSE;
+	if (!ret) {
+		ret = scratch_extra_alloc(size, align, (owner) ? owner : "");
+		if (ret && ret < extra_high)
+			reused = TRUE;
+		if (extra_high < extra_offset)
+			extra_high = extra_offset;
+	}
 
-done:
 	spin_unlock(&extra_lock);
 
-	if (ret) {
-		for (i = 0; i < sbi_scratch_last_hartid(); i++) {
+	/*
+	 * Space never handed out before is still zero from sbi_scratch_init()
+	 * and everything else is cleared on all HARTs.
+	 */
+	if (ret && reused) {
+		for (i = 0; i <= sbi_scratch_last_hartid() &&
+			    i < SBI_HARTMASK_MAX_BITS; i++) {
 			rscratch = sbi_hartid_to_scratch(i);
 			if (!rscratch)
 				continue;
@@ -86,14 +237,49 @@ done:
 	return ret;
 }
 
+unsigned long sbi_scratch_alloc_offset(unsigned long size, const char *owner)
+{
+	return sbi_scratch_alloc_aligned_offset(size, __SIZEOF_POINTER__, owner);
+}
+
 void sbi_scratch_free_offset(unsigned long offset)
 {
+	u32 i;
+	struct scratch_chunk *c;
+
 	if ((offset < SBI_SCRATCH_EXTRA_SPACE_OFFSET) ||
 	    (SBI_SCRATCH_SIZE <= offset))
 		return;
 
-	/*
-	 * We don't actually free-up because it's a simple
-	 * brain-dead allocator.
-	 */
+	spin_lock(&extra_lock);
+
+	for (i = 0; i < scratch_chunk_count; i++) {
+		if (scratch_chunks[i].offset == offset)
+			break;
+	}
+	if (i == scratch_chunk_count || !scratch_chunks[i].owner)
+		goto done;
+
+	c = &scratch_chunks[i];
+	c->owner = NULL;
+
+	/* Merge with free neighbours */
+	if (i + 1 < scratch_chunk_count && !scratch_chunks[i + 1].owner) {
+		c->size += scratch_chunks[i + 1].size;
+		scratch_chunk_remove(i + 1);
+	}
+	if (i && !scratch_chunks[i - 1].owner) {
+		scratch_chunks[i - 1].size += c->size;
+		scratch_chunk_remove(i);
+		c = &scratch_chunks[--i];
+	}
+
+	/* Give back free space at the end */
+	if (i + 1 == scratch_chunk_count) {
+		extra_offset = c->offset;
+		scratch_chunk_remove(i);
+	}
+
+done:
+	spin_unlock(&extra_lock);
 }
@@ -0,0 +1,154 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifdef SBI_STEAL_TIME
+
+#include <sbi/riscv_barrier.h>
+#include <sbi/riscv_encoding.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_ecall.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_sta.h>
+#include <sbi/sbi_string.h>
+#include <sbi/sbi_timer.h>
+#include <sbi/sbi_trap.h>
+
+#define NSEC_PER_SEC		1000000000ULL
+
+struct sta_hart {
+	/** Steal-time record registered by supervisor (NULL if none) */
+	volatile struct sbi_sta_record *rec;
+	/** M-mode time not yet added to the record (ticks * NSEC_PER_SEC) */
+	u64 rem;
+};
+static unsigned long sta_offset;
+
+/* Timer frequency, zero if the platform does not know it */
+static unsigned long sta_freq;
+
+u64 sbi_sta_start(void)
+{
+	struct sta_hart *sh;
+
+	if (!sta_offset)
+		return 0;
+
+	sh = sbi_scratch_thishart_offset_ptr(sta_offset);
+	return (sh->rec) ? sbi_timer_value() : 0;
+}
+
+void sbi_sta_account(u64 start)
+{
+	u64 ns;
+	struct sta_hart *sh;
+	volatile struct sbi_sta_record *rec;
+
+	if (!start)
+		return;
+
+	/* The trap may have disabled the record */
+	sh = sbi_scratch_thishart_offset_ptr(sta_offset);
+	rec = sh->rec;
+	if (!rec)
+		return;
+
+	/* Sub-nanosecond remainders are carried to the next trap */
+	sh->rem += (sbi_timer_value() - start) * NSEC_PER_SEC;
+	ns = sh->rem / sta_freq;
+	sh->rem -= ns * sta_freq;
+	if (!ns)
+		return;
+
+	rec->sequence = rec->sequence + 1;
+	smp_wmb();
+	rec->steal = rec->steal + ns;
+	smp_wmb();
+	rec->sequence = rec->sequence + 1;
+}
+
+static int sta_set_shmem(unsigned long lo, unsigned long hi,
+			 unsigned long flags)
+{
+	struct sta_hart *sh = sbi_scratch_thishart_offset_ptr(sta_offset);
+
+	if (flags)
+		return SBI_EINVAL;
+
+	if (lo == -1UL && hi == -1UL) {
+		sh->rec = NULL;
+		return 0;
+	}
+
+	if (lo & (SBI_STA_SHMEM_SIZE - 1))
+		return SBI_EINVAL;
+	/* M-mode only writes the record with physical addresses below XLEN */
+	if (hi || !sbi_domain_check_addr_range(sbi_domain_thishart_ptr(), lo,
+					       SBI_STA_SHMEM_SIZE, PRV_S,
+					       SBI_DOMAIN_READ |
+					       SBI_DOMAIN_WRITE))
+		return SBI_EINVALID_ADDR;
+
+	sh->rec = NULL;
+	sbi_memset((void *)lo, 0, SBI_STA_SHMEM_SIZE);
+	sh->rem = 0;
+	sh->rec = (volatile struct sbi_sta_record *)lo;
+
+	return 0;
+}
+
+static int sbi_ecall_sta_probe(unsigned long extid, unsigned long *out_val)
+{
+	*out_val = (sta_freq) ? 1 : 0;
+	return 0;
+}
+
+static int sbi_ecall_sta_handler(unsigned long extid, unsigned long funcid,
+				 const struct sbi_trap_regs *regs,
+				 unsigned long *out_val,
+				 struct sbi_trap_info *out_trap)
+{
+	if (!sta_freq)
+		return SBI_ENOTSUPP;
+
+	switch (funcid) {
+	case SBI_EXT_STA_STEAL_TIME_SET_SHMEM:
+		return sta_set_shmem(regs->a0, regs->a1, regs->a2);
+	default:
+		return SBI_ENOTSUPP;
+	};
+}
+
+struct sbi_ecall_extension ecall_sta = {
+	.extid_start = SBI_EXT_STA,
+	.extid_end = SBI_EXT_STA,
+	.probe = sbi_ecall_sta_probe,
+	.handle = sbi_ecall_sta_handler,
+};
+
+int sbi_sta_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	struct sta_hart *sh;
+
+	if (cold_boot) {
+		sta_offset = sbi_scratch_alloc_offset(sizeof(*sh), "STA");
+		if (!sta_offset)
+			return SBI_ENOMEM;
+		sta_freq = sbi_timer_get_freq();
+	}
+
+	if (!sta_offset)
+		return 0;
+
+	/* A started HART registers its record again */
+	sh = sbi_scratch_offset_ptr(scratch, sta_offset);
+	sh->rec = NULL;
+
+	return 0;
+}
+
+#endif
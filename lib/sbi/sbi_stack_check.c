@@ -0,0 +1,127 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifdef SBI_STACK_CHECK
+
+#include <sbi/sbi_console.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_hartmask.h>
+#include <sbi/sbi_platform.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_stack_check.h>
+
+/* Stack size without scratch space, same for all HARTs */
+static unsigned long stack_check_size;
+
+/*
+ * The stack of a HART grows down from its scratch space and the guard
+ * is the lowest bytes of it. Beyond the guard is the scratch space of
+ * the next HART (or other firmware data).
+ */
+static unsigned long *stack_check_bottom(const struct sbi_scratch *scratch)
+{
+	return (unsigned long *)((unsigned long)scratch - stack_check_size);
+}
+
+static bool stack_check_guard_ok(const unsigned long *bottom)
+{
+	u32 i;
+
+	for (i = 0; i < SBI_STACK_CHECK_GUARD_SIZE / sizeof(*bottom); i++)
+		if (bottom[i] != SBI_STACK_CHECK_PATTERN)
+			return FALSE;
+
+	return TRUE;
+}
+
+void sbi_stack_check(void)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+
+	if (!stack_check_size ||
+	    stack_check_guard_ok(stack_check_bottom(scratch)))
+		return;
+
+	sbi_printf("%s: HART%d stack overflow\n", __func__, current_hartid());
+	sbi_hart_hang();
+}
+
+int sbi_stack_check_get(u32 hartid, unsigned long *out_used,
+			unsigned long *out_size)
+{
+	struct sbi_scratch *scratch;
+	const unsigned long *pos, *top;
+
+	if (!stack_check_size || SBI_HARTMASK_MAX_BITS <= hartid)
+		return SBI_EINVAL;
+	scratch = sbi_hartid_to_scratch(hartid);
+	if (!scratch)
+		return SBI_EINVAL;
+
+	/* HARTs which never booted (or overflowed) have no valid guard */
+	pos = stack_check_bottom(scratch);
+	if (!stack_check_guard_ok(pos))
+		return SBI_ENOENT;
+
+	/* Used stack ends at the lowest word not having the pattern */
+	top = (const unsigned long *)scratch;
+	while (pos < top && *pos == SBI_STACK_CHECK_PATTERN)
+		pos++;
+
+	if (out_used)
+		*out_used = (unsigned long)top - (unsigned long)pos;
+	if (out_size)
+		*out_size = stack_check_size - SBI_STACK_CHECK_GUARD_SIZE;
+
+	return 0;
+}
+
+void sbi_stack_check_dump(void)
+{
+	u32 i;
+	unsigned long used, size;
+
+	for (i = 0; i <= sbi_scratch_last_hartid() &&
+		    i < SBI_HARTMASK_MAX_BITS; i++) {
+		if (sbi_stack_check_get(i, &used, &size))
+			continue;
+		sbi_printf("HART%d stack: %lu of %lu bytes used\n", i, used,
+			   size);
+	}
+}
+
+int sbi_stack_check_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	unsigned long sp, *pos;
+	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
+
+	if (cold_boot) {
+		if (sbi_platform_hart_stack_size(plat) <
+		    (SBI_SCRATCH_SIZE + 2 * SBI_STACK_CHECK_GUARD_SIZE))
+			return SBI_EINVAL;
+		stack_check_size = sbi_platform_hart_stack_size(plat) -
+				   SBI_SCRATCH_SIZE;
+	} else if (!stack_check_size) {
+		return SBI_EINVAL;
+	}
+
+	/*
+	 * Stack memory below the current frame is free. It is only filled
+	 * once so that the high-water mark survives HSM stop and start.
+	 */
+	pos = stack_check_bottom(scratch);
+	if (stack_check_guard_ok(pos))
+		return 0;
+
+	__asm__ __volatile__("mv %0, sp" : "=r"(sp));
+	for (; (unsigned long)pos < sp; pos++)
+		*(volatile unsigned long *)pos = SBI_STACK_CHECK_PATTERN;
+
+	return 0;
+}
+
+#endif
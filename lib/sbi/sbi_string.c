@@ -8,18 +8,55 @@
  */
 
 /*
- * Simple libc functions. These are not optimized at all and might have some
- * bugs as well. Use any optimized routines from newlib or glibc if required.
+ * Simple libc functions. Only the ones used on hot paths (such as libfdt
+ * lookups and memory copies) are optimized. Use any optimized routines from
+ * newlib or glibc if required.
  */
 
 #include <sbi/sbi_string.h>
 
+/*
+ * Several functions below work a word at a time once the pointers are
+ * word aligned. Firmware is built with -mstrict-align and misaligned
+ * accesses may trap into the firmware itself, so word accesses are only
+ * used when all pointers involved have the same alignment. An aligned
+ * word never crosses a page or region boundary so the string functions
+ * may read the bytes after the terminating NUL of the same word.
+ */
+#define STRING_WORD_MASK	(sizeof(unsigned long) - 1)
+/* Below this size the alignment prologue does not pay off */
+#define STRING_WORD_MIN		(2 * sizeof(unsigned long))
+/* Words with every byte set to 0x01 and to 0x80 */
+#define STRING_ONES		(~0UL / 0xff)
+#define STRING_HIGHS		(STRING_ONES << 7)
+/* Non-zero if and only if any byte of the word is zero */
+#define STRING_HAS_ZERO(w)	(((w) - STRING_ONES) & ~(w) & STRING_HIGHS)
+
 /*
   Provides sbi_strcmp for the completeness of supporting string functions.
   it is not recommended to use sbi_strcmp() but use sbi_strncmp instead.
 */
 int sbi_strcmp(const char *a, const char *b)
 {
+	const unsigned long *wa, *wb;
+
+	if (!(((unsigned long)a ^ (unsigned long)b) & STRING_WORD_MASK)) {
+		for (; (unsigned long)a & STRING_WORD_MASK; a++, b++) {
+			if (*a != *b || *a == '\0')
+				return *a - *b;
+		}
+
+		/* Skip equal words without end of string */
+		wa = (const unsigned long *)a;
+		wb = (const unsigned long *)b;
+		while (*wa == *wb && !STRING_HAS_ZERO(*wa)) {
+			wa++;
+			wb++;
+		}
+		a = (const char *)wa;
+		b = (const char *)wb;
+	}
+
 	/* search first diff or end of string */
 	for (; *a == *b && *a != '\0'; a++, b++)
 		;
@@ -38,26 +75,43 @@ int sbi_strncmp(const char *a, const char *b, size_t count)
 
 size_t sbi_strlen(const char *str)
 {
-	unsigned long ret = 0;
+	const char *s = str;
+	const unsigned long *w;
 
-	while (*str != '\0') {
-		ret++;
-		str++;
+	for (; (unsigned long)s & STRING_WORD_MASK; s++) {
+		if (*s == '\0')
+			return s - str;
 	}
 
-	return ret;
+	for (w = (const unsigned long *)s; !STRING_HAS_ZERO(*w); w++)
+		;
+
+	for (s = (const char *)w; *s != '\0'; s++)
+		;
+
+	return s - str;
 }
 
 size_t sbi_strnlen(const char *str, size_t count)
 {
-	unsigned long ret = 0;
+	size_t ret = 0;
+	const unsigned long *w;
 
-	while (*str != '\0' && ret < count) {
-		ret++;
-		str++;
-		count--;
+	for (; ret < count && ((unsigned long)&str[ret] & STRING_WORD_MASK);
+	     ret++) {
+		if (str[ret] == '\0')
+			return ret;
+	}
+
+	w = (const unsigned long *)&str[ret];
+	while (count - ret >= sizeof(*w) && !STRING_HAS_ZERO(*w)) {
+		w++;
+		ret += sizeof(*w);
 	}
 
+	while (ret < count && str[ret] != '\0')
+		ret++;
+
 	return ret;
 }
 
@@ -106,9 +160,35 @@ char *sbi_strrchr(const char *s, int c)
 	else
 		return (char *)last;
 }
+
 void *sbi_memset(void *s, int c, size_t count)
 {
 	char *temp = s;
+	unsigned long w, *wtemp;
+
+	if (count >= STRING_WORD_MIN) {
+		while ((unsigned long)temp & STRING_WORD_MASK) {
+			*temp++ = c;
+			count--;
+		}
+
+		/* Replicate the byte into every byte of the word */
+		w = (unsigned char)c * STRING_ONES;
+		wtemp = (unsigned long *)temp;
+		while (count >= 4 * sizeof(w)) {
+			wtemp[0] = w;
+			wtemp[1] = w;
+			wtemp[2] = w;
+			wtemp[3] = w;
+			wtemp += 4;
+			count -= 4 * sizeof(w);
+		}
+		while (count >= sizeof(w)) {
+			*wtemp++ = w;
+			count -= sizeof(w);
+		}
+		temp = (char *)wtemp;
+	}
 
 	while (count > 0) {
 		count--;
@@ -118,42 +198,101 @@ void *sbi_memset(void *s, int c, size_t count)
 	return s;
 }
 
-void *sbi_memcpy(void *dest, const void *src, size_t count)
+static void string_copy_forward(char *dest, const char *src, size_t count)
 {
-	char *temp1	  = dest;
-	const char *temp2 = src;
+	unsigned long *wdest;
+	const unsigned long *wsrc;
+
+	if (count >= STRING_WORD_MIN &&
+	    !(((unsigned long)dest ^ (unsigned long)src) & STRING_WORD_MASK)) {
+		while ((unsigned long)dest & STRING_WORD_MASK) {
+			*dest++ = *src++;
+			count--;
+		}
+
+		wdest = (unsigned long *)dest;
+		wsrc = (const unsigned long *)src;
+		while (count >= 4 * sizeof(*wdest)) {
+			wdest[0] = wsrc[0];
+			wdest[1] = wsrc[1];
+			wdest[2] = wsrc[2];
+			wdest[3] = wsrc[3];
+			wdest += 4;
+			wsrc += 4;
+			count -= 4 * sizeof(*wdest);
+		}
+		while (count >= sizeof(*wdest)) {
+			*wdest++ = *wsrc++;
+			count -= sizeof(*wdest);
+		}
+		dest = (char *)wdest;
+		src = (const char *)wsrc;
+	}
 
 	while (count > 0) {
-		*temp1++ = *temp2++;
+		*dest++ = *src++;
 		count--;
 	}
-
-	return dest;
 }
 
-void *sbi_memmove(void *dest, const void *src, size_t count)
+/* Same as string_copy_forward() but starting from the end */
+static void string_copy_backward(char *dest, const char *src, size_t count)
 {
-	char *temp1	  = (char *)dest;
-	const char *temp2 = (char *)src;
+	unsigned long *wdest;
+	const unsigned long *wsrc;
 
-	if (src == dest)
-		return dest;
+	dest += count;
+	src += count;
 
-	if (dest < src) {
-		while (count > 0) {
-			*temp1++ = *temp2++;
+	if (count >= STRING_WORD_MIN &&
+	    !(((unsigned long)dest ^ (unsigned long)src) & STRING_WORD_MASK)) {
+		while ((unsigned long)dest & STRING_WORD_MASK) {
+			*--dest = *--src;
 			count--;
 		}
-	} else {
-		temp1 = dest + count - 1;
-		temp2 = src + count - 1;
 
-		while (count > 0) {
-			*temp1-- = *temp2--;
-			count--;
+		wdest = (unsigned long *)dest;
+		wsrc = (const unsigned long *)src;
+		while (count >= 4 * sizeof(*wdest)) {
+			wdest -= 4;
+			wsrc -= 4;
+			wdest[3] = wsrc[3];
+			wdest[2] = wsrc[2];
+			wdest[1] = wsrc[1];
+			wdest[0] = wsrc[0];
+			count -= 4 * sizeof(*wdest);
+		}
+		while (count >= sizeof(*wdest)) {
+			*--wdest = *--wsrc;
+			count -= sizeof(*wdest);
 		}
+		dest = (char *)wdest;
+		src = (const char *)wsrc;
 	}
 
+	while (count > 0) {
+		*--dest = *--src;
+		count--;
+	}
+}
+
+void *sbi_memcpy(void *dest, const void *src, size_t count)
+{
+	string_copy_forward(dest, src, count);
+
+	return dest;
+}
+
+void *sbi_memmove(void *dest, const void *src, size_t count)
+{
+	if (src == dest)
+		return dest;
+
+	if (dest < src)
+		string_copy_forward(dest, src, count);
+	else
+		string_copy_backward(dest, src, count);
+
 	return dest;
 }
 
@@ -161,6 +300,29 @@ int sbi_memcmp(const void *s1, const void *s2, size_t count)
 {
 	const char *temp1 = s1;
 	const char *temp2 = s2;
+	const unsigned long *w1, *w2;
+
+	if (count >= STRING_WORD_MIN &&
+	    !(((unsigned long)s1 ^ (unsigned long)s2) & STRING_WORD_MASK)) {
+		for (; (unsigned long)temp1 & STRING_WORD_MASK; count--) {
+			if (*temp1 != *temp2)
+				return *(unsigned char *)temp1 -
+				       *(unsigned char *)temp2;
+			temp1++;
+			temp2++;
+		}
+
+		/* The differing word, if any, is compared bytewise below */
+		w1 = (const unsigned long *)temp1;
+		w2 = (const unsigned long *)temp2;
+		while (count >= sizeof(*w1) && *w1 == *w2) {
+			w1++;
+			w2++;
+			count -= sizeof(*w1);
+		}
+		temp1 = (const char *)w1;
+		temp2 = (const char *)w2;
+	}
 
 	for (; count > 0 && (*temp1 == *temp2); count--) {
 		temp1++;
@@ -176,6 +338,26 @@ int sbi_memcmp(const void *s1, const void *s2, size_t count)
 void *sbi_memchr(const void *s, int c, size_t count)
 {
 	const unsigned char *temp = s;
+	const unsigned long *wtemp;
+	unsigned long w;
+
+	if (count >= STRING_WORD_MIN) {
+		for (; (unsigned long)temp & STRING_WORD_MASK; count--) {
+			if ((unsigned char)c == *temp)
+				return (void *)temp;
+			temp++;
+		}
+
+		/* Bytes equal to c become zero bytes */
+		w = (unsigned char)c * STRING_ONES;
+		wtemp = (const unsigned long *)temp;
+		while (count >= sizeof(*wtemp) &&
+		       !STRING_HAS_ZERO(*wtemp ^ w)) {
+			wtemp++;
+			count -= sizeof(*wtemp);
+		}
+		temp = (const unsigned char *)wtemp;
+	}
 
 	while (count > 0) {
 		if ((unsigned char)c == *temp++) {
@@ -186,3 +368,37 @@ void *sbi_memchr(const void *s, int c, size_t count)
 
 	return NULL;
 }
+
+/* Only bases 2 to 16 (or 0 for a C style prefix) and no sign or spaces */
+unsigned long sbi_strtoul(const char *s, char **endptr, int base)
+{
+	unsigned long ret = 0;
+	int digit;
+
+	if ((base == 0 || base == 16) && s[0] == '0' &&
+	    (s[1] == 'x' || s[1] == 'X')) {
+		s += 2;
+		base = 16;
+	} else if (base == 0) {
+		base = (s[0] == '0') ? 8 : 10;
+	}
+
+	for (; *s != '\0'; s++) {
+		if ('0' <= *s && *s <= '9')
+			digit = *s - '0';
+		else if ('a' <= *s && *s <= 'f')
+			digit = *s - 'a' + 10;
+		else if ('A' <= *s && *s <= 'F')
+			digit = *s - 'A' + 10;
+		else
+			break;
+		if (digit >= base)
+			break;
+		ret = ret * base + digit;
+	}
+
+	if (endptr)
+		*endptr = (char *)s;
+
+	return ret;
+}
@@ -9,14 +9,22 @@
  */
 
 #include <sbi/riscv_asm.h>
+#include <sbi/riscv_barrier.h>
 #include <sbi/sbi_bitops.h>
+#include <sbi/sbi_console.h>
 #include <sbi/sbi_domain.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
 #include <sbi/sbi_hart.h>
+#include <sbi/sbi_hartmask.h>
 #include <sbi/sbi_hsm.h>
 #include <sbi/sbi_platform.h>
+#include <sbi/sbi_stack_check.h>
 #include <sbi/sbi_system.h>
 #include <sbi/sbi_ipi.h>
 #include <sbi/sbi_init.h>
+#include <sbi/sbi_timer.h>
+#include <sbi/sbi_tlb.h>
 
 static const struct sbi_system_reset_device *reset_dev = NULL;
 
@@ -42,25 +50,46 @@ bool sbi_system_reset_supported(u32 reset_type, u32 reset_reason)
 	return FALSE;
 }
 
-void __noreturn sbi_system_reset(u32 reset_type, u32 reset_reason)
+static void sbi_system_halt_others(const struct sbi_domain *dom,
+				   u32 cur_hartid, bool wait)
 {
+	u32 i;
 	ulong hbase = 0, hmask;
-	u32 cur_hartid = current_hartid();
-	struct sbi_domain *dom = sbi_domain_thishart_ptr();
-	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
 
 	/* Send HALT IPI to every hart other than the current hart */
 	while (!sbi_hsm_hart_interruptible_mask(dom, hbase, &hmask)) {
-		if (hbase <= cur_hartid)
+		if (hbase <= cur_hartid && cur_hartid < hbase + BITS_PER_LONG)
 			hmask &= ~(1UL << (cur_hartid - hbase));
 		if (hmask)
 			sbi_ipi_send_halt(hmask, hbase);
+
+		/* Wait until the halted harts can be started again */
+		for (i = 0; wait && i < BITS_PER_LONG; i++) {
+			if (!(hmask & (1UL << i)))
+				continue;
+			while (sbi_hsm_hart_get_state(dom, hbase + i) !=
+			       SBI_HSM_STATE_STOPPED)
+				cpu_relax();
+		}
+
 		hbase += BITS_PER_LONG;
 	}
+}
+
+void __noreturn sbi_system_reset(u32 reset_type, u32 reset_reason)
+{
+	u32 cur_hartid = current_hartid();
+	struct sbi_domain *dom = sbi_domain_thishart_ptr();
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+
+	sbi_system_halt_others(dom, cur_hartid, FALSE);
 
 	/* Stop current HART */
 	sbi_hsm_hart_stop(scratch, FALSE);
 
+	sbi_stack_check_dump();
+	sbi_console_flush();
+
 	/* Platform specific reset if domain allowed system reset */
 	if (dom->system_reset_allowed &&
 	    reset_dev && reset_dev->system_reset)
@@ -69,3 +98,155 @@ void __noreturn sbi_system_reset(u32 reset_type, u32 reset_reason)
 	/* If platform specific reset did not work then do sbi_exit() */
 	sbi_exit(scratch);
 }
+
+int sbi_system_warm_restart(unsigned long next_addr, unsigned long next_arg1)
+{
+	int rc;
+	u32 cur_hartid = current_hartid();
+	struct sbi_domain *dom = sbi_domain_thishart_ptr();
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+
+	if (!dom->system_reset_allowed)
+		return SBI_EDENIED;
+	if (!sbi_domain_check_addr(dom, next_addr, dom->next_mode,
+				   SBI_DOMAIN_EXECUTE) ||
+	    !sbi_domain_check_addr(dom, next_arg1, dom->next_mode,
+				   SBI_DOMAIN_READ))
+		return SBI_EINVALID_ADDR;
+
+	/*
+	 * The other harts are left stopped so that the restarted booting
+	 * stage brings them up through HSM like after a cold boot.
+	 */
+	sbi_system_halt_others(dom, cur_hartid, TRUE);
+
+	/* Don't leave anything of the previous booting stage pending */
+	sbi_timer_event_start(-1ULL);
+	csr_clear(CSR_MIP, MIP_SSIP);
+
+	scratch->next_addr = next_addr;
+	scratch->next_arg1 = next_arg1;
+	rc = sbi_platform_warm_restart(sbi_platform_ptr(scratch));
+	if (rc) {
+		sbi_printf("%s: platform warm restart failed (error %d)\n",
+			   __func__, rc);
+		sbi_system_reset(SBI_SRST_RESET_TYPE_WARM_REBOOT,
+				 SBI_SRST_RESET_REASON_SYSFAIL);
+	}
+
+	sbi_console_flush();
+	sbi_hart_switch_mode(cur_hartid, next_arg1, next_addr,
+			     dom->next_mode, FALSE);
+}
+
+static const struct sbi_system_suspend_device *suspend_dev = NULL;
+static bool system_suspended;
+
+const struct sbi_system_suspend_device *sbi_system_suspend_get_device(void)
+{
+	return suspend_dev;
+}
+
+void sbi_system_suspend_set_device(const struct sbi_system_suspend_device *dev)
+{
+	if (!dev || suspend_dev)
+		return;
+
+	suspend_dev = dev;
+}
+
+bool sbi_system_suspend_supported(u32 sleep_type)
+{
+	if (suspend_dev && suspend_dev->system_suspend &&
+	    suspend_dev->system_suspend_check &&
+	    !suspend_dev->system_suspend_check(sleep_type))
+		return TRUE;
+
+	return FALSE;
+}
+
+int sbi_system_suspend(u32 sleep_type, unsigned long resume_addr,
+		       unsigned long opaque)
+{
+	int rc;
+	u32 i, cur_hartid = current_hartid();
+	const struct sbi_domain *dom = sbi_domain_thishart_ptr();
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	void (*jump_warmboot)(void) = (void (*)(void))scratch->warmboot_addr;
+	unsigned long prev_mode = (csr_read(CSR_MSTATUS) & MSTATUS_MPP) >>
+				  MSTATUS_MPP_SHIFT;
+
+	if (!dom->system_suspend_allowed)
+		return SBI_EDENIED;
+	if (prev_mode != PRV_S && prev_mode != PRV_U)
+		return SBI_EFAIL;
+	if (!suspend_dev || !suspend_dev->system_suspend ||
+	    !suspend_dev->system_suspend_check)
+		return SBI_ENOTSUPP;
+
+	rc = suspend_dev->system_suspend_check(sleep_type);
+	if (rc)
+		return rc;
+
+	if (!sbi_domain_check_addr(dom, resume_addr, prev_mode,
+				   SBI_DOMAIN_EXECUTE))
+		return SBI_EINVALID_ADDR;
+
+	/* The caller must be the last started hart of its domain */
+	sbi_hartmask_for_each_hart(i, &dom->assigned_harts) {
+		if (i != cur_hartid &&
+		    sbi_hsm_hart_get_state(dom, i) != SBI_HSM_STATE_STOPPED)
+			return SBI_EDENIED;
+	}
+
+	rc = sbi_hsm_hart_system_suspend(scratch, resume_addr, prev_mode,
+					 opaque);
+	if (rc)
+		return rc;
+
+	sbi_console_flush();
+
+	system_suspended = TRUE;
+	rc = suspend_dev->system_suspend(sleep_type, scratch->warmboot_addr);
+	if (rc) {
+		system_suspended = FALSE;
+		sbi_hsm_hart_system_suspend_abort(scratch);
+		return rc;
+	}
+
+	/* Resume in the warm boot path like a real system suspend would */
+	jump_warmboot();
+
+	return 0;
+}
+
+bool sbi_system_is_suspended(void)
+{
+	return system_suspended;
+}
+
+int sbi_system_resume(struct sbi_scratch *scratch)
+{
+	int rc;
+	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
+
+	/*
+	 * Everything else of the firmware is kept in RAM and the HART
+	 * itself is restored like after a non-retentive HART suspend.
+	 */
+	rc = sbi_platform_irqchip_init(plat, FALSE);
+	if (rc)
+		return rc;
+
+	rc = sbi_platform_ipi_init(plat, FALSE);
+	if (rc)
+		return rc;
+
+	rc = sbi_platform_timer_init(plat, FALSE);
+	if (rc)
+		return rc;
+
+	system_suspended = FALSE;
+
+	return 0;
+}
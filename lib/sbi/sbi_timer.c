@@ -8,16 +8,32 @@
  */
 
 #include <sbi/riscv_asm.h>
+#include <sbi/riscv_barrier.h>
 #include <sbi/riscv_encoding.h>
+#include <sbi/sbi_bitops.h>
+#include <sbi/sbi_console.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_ecall.h>
+#include <sbi/sbi_ecall_interface.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_hart.h>
+#include <sbi/sbi_hartmask.h>
 #include <sbi/sbi_platform.h>
+#include <sbi/sbi_pmu.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_timer.h>
+#include <sbi/sbi_trap.h>
+#include <sbi/sbi_trap_stats.h>
+
+#define SBI_TIMER_EVENT_NONE	((u64)-1)
 
 static unsigned long time_delta_off;
+unsigned long sbi_timer_events_off;
+bool sbi_timer_time_csr = FALSE;
 static u64 (*get_time_val)(void);
+static unsigned long timer_freq;
 static const struct sbi_timer_device *timer_dev = NULL;
+static bool timer_remote_events = FALSE;
 
 #if __riscv_xlen == 32
 static u64 get_ticks(void)
@@ -46,7 +62,7 @@ static u64 get_platform_ticks(void)
 	return timer_dev->timer_value();
 }
 
-u64 sbi_timer_value(void)
+u64 __sbi_timer_value(void)
 {
 	if (get_time_val)
 		return get_time_val();
@@ -55,8 +71,19 @@ u64 sbi_timer_value(void)
 
 u64 sbi_timer_virt_value(void)
 {
-	u64 *time_delta = sbi_scratch_offset_ptr(sbi_scratch_thishart_ptr(),
-						 time_delta_off);
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	u64 *time_delta = sbi_scratch_offset_ptr(scratch, time_delta_off);
+
+	/* The hypervisor writes a real htimedelta without trapping */
+	if (sbi_hart_has_feature(scratch, SBI_HART_HAS_HTIMEDELTA)) {
+#if __riscv_xlen == 32
+		return sbi_timer_value() +
+		       (((u64)csr_read(CSR_HTIMEDELTAH) << 32) |
+			csr_read(CSR_HTIMEDELTA));
+#else
+		return sbi_timer_value() + csr_read(CSR_HTIMEDELTA);
+#endif
+	}
 
 	return sbi_timer_value() + *time_delta;
 }
@@ -86,18 +113,419 @@ void sbi_timer_set_delta_upper(ulong delta_upper)
 	*time_delta |= ((u64)delta_upper << 32);
 }
 
-void sbi_timer_event_start(u64 next_event)
+static void sbi_timer_stimecmp_write(u64 next_event)
 {
-	if (timer_dev && timer_dev->timer_event_start)
+#if __riscv_xlen == 32
+	/* No spurious interrupt while the halves are written */
+	csr_write(CSR_STIMECMP, -1UL);
+	csr_write(CSR_STIMECMPH, (u32)(next_event >> 32));
+	csr_write(CSR_STIMECMP, (u32)next_event);
+#else
+	csr_write(CSR_STIMECMP, next_event);
+#endif
+}
+
+static void __hot sbi_timer_event_program(struct sbi_timer_events *tevents)
+{
+	u64 next_event = MIN(tevents->s_event, tevents->m_event);
+
+	if (!timer_remote_events) {
+		if (next_event == SBI_TIMER_EVENT_NONE) {
+			csr_clear(CSR_MIE, MIP_MTIP);
+			return;
+		}
+
+		if (timer_dev && timer_dev->timer_event_start)
+			timer_dev->timer_event_start(next_event);
+		csr_set(CSR_MIE, MIP_MTIP);
+		return;
+	}
+
+	/*
+	 * Other HARTs may program our time compare so it is only written
+	 * under lock and the M-mode timer interrupt stays enabled.
+	 */
+	spin_lock(&tevents->r_lock);
+
+	next_event = MIN(next_event, tevents->r_event);
+	if (next_event == SBI_TIMER_EVENT_NONE) {
+		if (timer_dev->timer_event_stop)
+			timer_dev->timer_event_stop();
+	} else {
 		timer_dev->timer_event_start(next_event);
+	}
+
+	/* The time compare must be written before other HARTs read it */
+	mb();
+	spin_unlock(&tevents->r_lock);
+}
+
+#if __riscv_xlen == 64
+static void timer_event_fast_path_init(struct sbi_scratch *scratch,
+				       struct sbi_timer_events *tevents)
+{
+	/*
+	 * The fast path programs the exact deadline and bypasses the
+	 * extension lookup of the domain.
+	 */
+	tevents->fast_timecmp = 0;
+	if (!tevents->fast_event_off && !tevents->slack &&
+	    sbi_ecall_domain_allowed(sbi_hartid_to_domain(scratch->hartid),
+				     SBI_EXT_TIME) &&
+	    !sbi_hart_has_feature(scratch, SBI_HART_HAS_SSTC) &&
+	    timer_dev && timer_dev->timer_event_fast_regs &&
+	    timer_dev->timer_event_fast_regs(&tevents->fast_timecmp,
+					     &tevents->fast_delta))
+		tevents->fast_timecmp = 0;
+}
+
+static void timer_value_fast_path_init(struct sbi_scratch *scratch,
+				       struct sbi_timer_events *tevents)
+{
+	tevents->fast_time = 0;
+	if (!sbi_hart_has_feature(scratch, SBI_HART_HAS_TIME) &&
+	    timer_dev && timer_dev->timer_value_fast_regs &&
+	    timer_dev->timer_value_fast_regs(&tevents->fast_time,
+					     &tevents->fast_delta))
+		tevents->fast_time = 0;
+}
+#endif
+
+void sbi_timer_value_fast_path(bool enable)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	struct sbi_timer_events *tevents =
+		sbi_scratch_offset_ptr(scratch, sbi_timer_events_off);
+
+#if __riscv_xlen == 64
+	if (enable) {
+		timer_value_fast_path_init(scratch, tevents);
+		return;
+	}
+#endif
+	tevents->fast_time = 0;
+}
+
+void sbi_timer_event_fast_path(bool enable)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	struct sbi_timer_events *tevents =
+		sbi_scratch_offset_ptr(scratch, sbi_timer_events_off);
+
+	tevents->fast_event_off = (enable) ? FALSE : TRUE;
+#if __riscv_xlen == 64
+	timer_event_fast_path_init(scratch, tevents);
+#else
+	tevents->fast_timecmp = 0;
+#endif
+}
+
+void sbi_timer_event_fast_path_update(void)
+{
+#if __riscv_xlen == 64
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+
+	timer_event_fast_path_init(scratch,
+			sbi_scratch_offset_ptr(scratch, sbi_timer_events_off));
+#endif
+}
+
+void sbi_timer_slack_set(struct sbi_scratch *scratch, unsigned long slack)
+{
+	struct sbi_timer_events *tevents =
+		sbi_scratch_offset_ptr(scratch, sbi_timer_events_off);
+
+	tevents->slack = slack;
+#if __riscv_xlen == 64
+	timer_event_fast_path_init(scratch, tevents);
+#endif
+}
+
+unsigned long sbi_timer_slack_get(struct sbi_scratch *scratch)
+{
+	struct sbi_timer_events *tevents =
+		sbi_scratch_offset_ptr(scratch, sbi_timer_events_off);
+
+	return tevents->slack;
+}
+
+/*
+ * Delay a supervisor timer event by at most the slack so that it fires
+ * with a wakeup the HART takes anyway (a pending firmware or remote
+ * timer event). Otherwise the event is rounded up on a power of two
+ * grid which all HARTs share, so the events of HARTs with similar
+ * slack fire at the same time and clusters can stay idle together.
+ */
+static u64 timer_event_coalesce(struct sbi_timer_events *tevents,
+				u64 next_event)
+{
+	u64 end, grid;
+
+	if (!tevents->slack || next_event == SBI_TIMER_EVENT_NONE)
+		return next_event;
+
+	end = next_event + tevents->slack;
+	if (end < next_event)
+		return next_event;
+
+	if (next_event <= tevents->m_event && tevents->m_event <= end)
+		return tevents->m_event;
+	if (next_event <= tevents->r_event && tevents->r_event <= end)
+		return tevents->r_event;
+
+	grid = 1ULL << __fls(tevents->slack);
+
+	return (next_event + grid - 1) & ~(grid - 1);
+}
+
+void __hot sbi_timer_event_start(u64 next_event)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	struct sbi_timer_events *tevents =
+		sbi_scratch_offset_ptr(scratch, sbi_timer_events_off);
+
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_SET_TIMER);
+
+	next_event = timer_event_coalesce(tevents, next_event);
+
+	/*
+	 * With Sstc the supervisor timer does not use the M-mode timer
+	 * at all and writing stimecmp also clears a pending STIP.
+	 */
+	if (sbi_hart_has_feature(scratch, SBI_HART_HAS_SSTC)) {
+		sbi_timer_stimecmp_write(next_event - sbi_timer_get_delta());
+		return;
+	}
+
+	tevents->s_event = next_event;
 	csr_clear(CSR_MIP, MIP_STIP);
-	csr_set(CSR_MIE, MIP_MTIP);
+
+	/* Without firmware event keep the timer armed like before */
+	if (tevents->m_event == SBI_TIMER_EVENT_NONE && !timer_remote_events) {
+		if (timer_dev && timer_dev->timer_event_start)
+			timer_dev->timer_event_start(next_event);
+		csr_set(CSR_MIE, MIP_MTIP);
+		return;
+	}
+
+	sbi_timer_event_program(tevents);
 }
 
-void sbi_timer_process(void)
+static int timer_mevent_find(struct sbi_timer_events *tevents,
+			     void (*fn)(struct sbi_scratch *scratch))
 {
-	csr_clear(CSR_MIE, MIP_MTIP);
-	csr_set(CSR_MIP, MIP_STIP);
+	u32 i;
+
+	for (i = 0; i < tevents->mevent_count; i++) {
+		if (tevents->mevents[i].fn == fn)
+			return i;
+	}
+
+	return -1;
+}
+
+static void timer_mevent_remove(struct sbi_timer_events *tevents, u32 pos)
+{
+	u32 i;
+
+	for (i = pos; i + 1 < tevents->mevent_count; i++) {
+		tevents->mevents[i].time = tevents->mevents[i + 1].time;
+		tevents->mevents[i].fn = tevents->mevents[i + 1].fn;
+	}
+	tevents->mevent_count--;
+
+	tevents->m_event = (tevents->mevent_count) ?
+			   tevents->mevents[0].time : SBI_TIMER_EVENT_NONE;
+}
+
+static void timer_mevent_insert(struct sbi_timer_events *tevents, u64 time,
+				void (*fn)(struct sbi_scratch *scratch))
+{
+	u32 i = tevents->mevent_count++;
+
+	/* Events with the same time expire in the order they were added */
+	for (; i && time < tevents->mevents[i - 1].time; i--) {
+		tevents->mevents[i].time = tevents->mevents[i - 1].time;
+		tevents->mevents[i].fn = tevents->mevents[i - 1].fn;
+	}
+	tevents->mevents[i].time = time;
+	tevents->mevents[i].fn = fn;
+
+	tevents->m_event = tevents->mevents[0].time;
+}
+
+int sbi_timer_mevent_start(u64 next_event,
+			   void (*fn)(struct sbi_scratch *scratch))
+{
+	int pos;
+	struct sbi_timer_events *tevents =
+		sbi_scratch_offset_ptr(sbi_scratch_thishart_ptr(),
+				       sbi_timer_events_off);
+
+	if (!fn || !get_time_val)
+		return SBI_ENOTSUPP;
+
+	pos = timer_mevent_find(tevents, fn);
+	if (pos >= 0)
+		timer_mevent_remove(tevents, pos);
+	else if (tevents->mevent_count == SBI_TIMER_MEVENT_MAX)
+		return SBI_ENOSPC;
+
+	timer_mevent_insert(tevents, next_event, fn);
+	sbi_timer_event_program(tevents);
+
+	return 0;
+}
+
+void sbi_timer_mevent_stop(void (*fn)(struct sbi_scratch *scratch))
+{
+	int pos;
+	struct sbi_timer_events *tevents =
+		sbi_scratch_offset_ptr(sbi_scratch_thishart_ptr(),
+				       sbi_timer_events_off);
+
+	pos = timer_mevent_find(tevents, fn);
+	if (pos < 0)
+		return;
+
+	timer_mevent_remove(tevents, pos);
+	sbi_timer_event_program(tevents);
+}
+
+int sbi_timer_remote_event_start(u32 hartid, u64 next_event)
+{
+	struct sbi_timer_events *tevents;
+	struct sbi_scratch *scratch = sbi_hartid_to_scratch(hartid);
+
+	if (!scratch || !sbi_timer_events_off)
+		return SBI_EINVAL;
+	if (!timer_remote_events)
+		return SBI_ENOTSUPP;
+
+	tevents = sbi_scratch_offset_ptr(scratch, sbi_timer_events_off);
+
+	spin_lock(&tevents->r_lock);
+
+	if (next_event < tevents->r_event)
+		tevents->r_event = next_event;
+
+	/*
+	 * The set_timer fast path of the target HART writes its time
+	 * compare without lock and then checks r_event, so r_event must
+	 * be visible before the time compare is read. Either the target
+	 * HART sees r_event and reprograms through the slow path or the
+	 * time compare read here is the one written by the fast path.
+	 */
+	mb();
+	if (next_event < timer_dev->timer_event_get(hartid))
+		timer_dev->timer_event_set(hartid, next_event);
+	mb();
+
+	spin_unlock(&tevents->r_lock);
+
+	return 0;
+}
+
+int sbi_timer_sync_get(u32 hartid, s64 *out_skew, u64 *out_error)
+{
+	if (SBI_HARTMASK_MAX_BITS <= hartid || !sbi_hartid_to_scratch(hartid))
+		return SBI_EINVAL;
+	if (!timer_dev || !timer_dev->timer_sync_get)
+		return SBI_ENOTSUPP;
+
+	return timer_dev->timer_sync_get(hartid, out_skew, out_error);
+}
+
+static int sbi_ecall_time_sync_handler(unsigned long extid,
+				       unsigned long funcid,
+				       const struct sbi_trap_regs *regs,
+				       unsigned long *out_val,
+				       struct sbi_trap_info *out_trap)
+{
+	int ret;
+	s64 skew;
+	u64 error;
+
+	if (funcid != SBI_EXT_TIME_SYNC_GET_SKEW &&
+	    funcid != SBI_EXT_TIME_SYNC_GET_ERROR)
+		return SBI_ENOTSUPP;
+
+	/* a1 selects the upper 32 bits on RV32 */
+	if (regs->a1 > ((__riscv_xlen == 32) ? 1 : 0))
+		return SBI_EINVAL;
+
+	ret = sbi_timer_sync_get(regs->a0, &skew, &error);
+	if (ret)
+		return ret;
+
+	if (funcid == SBI_EXT_TIME_SYNC_GET_SKEW)
+		error = skew;
+	*out_val = (unsigned long)(error >> (regs->a1 * 32));
+
+	return 0;
+}
+
+struct sbi_ecall_extension ecall_time_sync = {
+	.extid_start = SBI_EXT_TIME_SYNC,
+	.extid_end = SBI_EXT_TIME_SYNC,
+	.handle = sbi_ecall_time_sync_handler,
+};
+
+void __hot sbi_timer_process(void)
+{
+	bool s_due;
+	void (*fn)(struct sbi_scratch *scratch);
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	struct sbi_timer_events *tevents =
+			sbi_scratch_offset_ptr(scratch, sbi_timer_events_off);
+	u64 deadline, now = sbi_timer_value();
+
+	/* Delivery latency is measured against the earliest due event */
+	deadline = MIN(tevents->m_event, tevents->r_event);
+	if (!sbi_hart_has_feature(scratch, SBI_HART_HAS_SSTC))
+		deadline = MIN(deadline, tevents->s_event);
+	if (deadline != SBI_TIMER_EVENT_NONE)
+		sbi_trap_stats_latency(SBI_TRAP_STATS_LATENCY_TIMER,
+				       deadline, now);
+
+	/* Timer interrupts are a good time to write out buffered output */
+	sbi_console_poll();
+
+	/*
+	 * Without firmware event the timer interrupt is always for
+	 * supervisor so no need to compare with current time. With Sstc
+	 * it is never for supervisor.
+	 */
+	s_due = (tevents->m_event == SBI_TIMER_EVENT_NONE ||
+		 tevents->s_event <= now) ? TRUE : FALSE;
+	if (sbi_hart_has_feature(scratch, SBI_HART_HAS_SSTC))
+		s_due = FALSE;
+	if (s_due)
+		tevents->s_event = SBI_TIMER_EVENT_NONE;
+
+	/* Events of other HARTs only wake us up */
+	if (tevents->r_event != SBI_TIMER_EVENT_NONE) {
+		spin_lock(&tevents->r_lock);
+		if (tevents->r_event <= now)
+			tevents->r_event = SBI_TIMER_EVENT_NONE;
+		spin_unlock(&tevents->r_lock);
+	}
+
+	/*
+	 * Expired firmware events are dispatched in time order before
+	 * supervisor gets its interrupt. A callback may start events again
+	 * so each one is removed before it is called.
+	 */
+	while (tevents->mevent_count && tevents->mevents[0].time <= now) {
+		fn = tevents->mevents[0].fn;
+		timer_mevent_remove(tevents, 0);
+		fn(scratch);
+	}
+
+	if (s_due)
+		csr_set(CSR_MIP, MIP_STIP);
+
+	sbi_timer_event_program(tevents);
 }
 
 const struct sbi_timer_device *sbi_timer_get_device(void)
@@ -105,6 +533,16 @@ const struct sbi_timer_device *sbi_timer_get_device(void)
 	return timer_dev;
 }
 
+void sbi_timer_set_freq(unsigned long freq)
+{
+	timer_freq = freq;
+}
+
+unsigned long sbi_timer_get_freq(void)
+{
+	return timer_freq;
+}
+
 void sbi_timer_set_device(const struct sbi_timer_device *dev)
 {
 	if (!dev || timer_dev)
@@ -113,11 +551,16 @@ void sbi_timer_set_device(const struct sbi_timer_device *dev)
 	timer_dev = dev;
 	if (!get_time_val && timer_dev->timer_value)
 		get_time_val = get_platform_ticks;
+	if (timer_dev->timer_event_start &&
+	    timer_dev->timer_event_get && timer_dev->timer_event_set)
+		timer_remote_events = TRUE;
 }
 
 int sbi_timer_init(struct sbi_scratch *scratch, bool cold_boot)
 {
+	int rc;
 	u64 *time_delta;
+	struct sbi_timer_events *tevents;
 	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
 
 	if (cold_boot) {
@@ -126,17 +569,59 @@ int sbi_timer_init(struct sbi_scratch *scratch, bool cold_boot)
 		if (!time_delta_off)
 			return SBI_ENOMEM;
 
-		if (sbi_hart_has_feature(scratch, SBI_HART_HAS_TIME))
+		sbi_timer_events_off =
+			sbi_scratch_alloc_offset(sizeof(*tevents),
+						 "TIME_EVENTS");
+		if (!sbi_timer_events_off) {
+			sbi_scratch_free_offset(time_delta_off);
+			return SBI_ENOMEM;
+		}
+
+		if (sbi_hart_has_feature(scratch, SBI_HART_HAS_TIME)) {
 			get_time_val = get_ticks;
+			sbi_timer_time_csr = TRUE;
+		}
 	} else {
-		if (!time_delta_off)
+		if (!time_delta_off || !sbi_timer_events_off)
 			return SBI_ENOMEM;
 	}
 
 	time_delta = sbi_scratch_offset_ptr(scratch, time_delta_off);
 	*time_delta = 0;
 
-	return sbi_platform_timer_init(plat, cold_boot);
+	tevents = sbi_scratch_offset_ptr(scratch, sbi_timer_events_off);
+	tevents->s_event = SBI_TIMER_EVENT_NONE;
+	tevents->m_event = SBI_TIMER_EVENT_NONE;
+	tevents->r_event = SBI_TIMER_EVENT_NONE;
+	SPIN_LOCK_INIT(tevents->r_lock);
+	tevents->mevent_count = 0;
+	tevents->fast_timecmp = 0;
+	tevents->fast_time = 0;
+	tevents->fast_delta = 0;
+	tevents->fast_event_off = FALSE;
+
+	rc = sbi_platform_timer_init(plat, cold_boot);
+	if (rc)
+		return rc;
+
+	/* Supervisor timer is disarmed until supervisor programs it */
+	if (sbi_hart_has_feature(scratch, SBI_HART_HAS_SSTC))
+		sbi_timer_stimecmp_write(SBI_TIMER_EVENT_NONE);
+
+	/* Timer events of other HARTs need the interrupt enabled */
+	if (timer_remote_events)
+		csr_set(CSR_MIE, MIP_MTIP);
+
+	/*
+	 * The fast paths in the trap vector need 64-bit accesses to the
+	 * timer registers. Both fast paths use the same delta.
+	 */
+#if __riscv_xlen == 64
+	timer_event_fast_path_init(scratch, tevents);
+	timer_value_fast_path_init(scratch, tevents);
+#endif
+
+	return 0;
 }
 
 void sbi_timer_exit(struct sbi_scratch *scratch)
@@ -146,6 +631,8 @@ void sbi_timer_exit(struct sbi_scratch *scratch)
 
 	csr_clear(CSR_MIP, MIP_STIP);
 	csr_clear(CSR_MIE, MIP_MTIP);
+	if (sbi_hart_has_feature(scratch, SBI_HART_HAS_SSTC))
+		sbi_timer_stimecmp_write(SBI_TIMER_EVENT_NONE);
 
 	sbi_platform_timer_exit(sbi_platform_ptr(scratch));
 }
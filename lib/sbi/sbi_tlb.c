@@ -11,120 +11,534 @@
 #include <sbi/riscv_asm.h>
 #include <sbi/riscv_atomic.h>
 #include <sbi/riscv_barrier.h>
+#include <sbi/riscv_locks.h>
+#include <sbi/sbi_domain.h>
 #include <sbi/sbi_error.h>
-#include <sbi/sbi_fifo.h>
 #include <sbi/sbi_hart.h>
+#include <sbi/sbi_hartmask.h>
+#include <sbi/sbi_hsm.h>
 #include <sbi/sbi_ipi.h>
+#include <sbi/sbi_lock_stats.h>
+#include <sbi/sbi_math.h>
+#include <sbi/sbi_misaligned_ldst.h>
+#include <sbi/sbi_pmu.h>
 #include <sbi/sbi_scratch.h>
+#include <sbi/sbi_timer.h>
 #include <sbi/sbi_tlb.h>
+#include <sbi/sbi_trace.h>
 #include <sbi/sbi_hfence.h>
 #include <sbi/sbi_string.h>
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_platform.h>
+#include <sbi/sbi_ring.h>
+
+/*
+ * Lock-free mailbox used instead of the spinlocked sbi_ring when
+ * SBI_SCRATCH_TLB_MAILBOX option is set. Multiple source HARTs reserve
+ * slots by advancing the tail with cmpxchg whereas the target HART is
+ * the only consumer. Each slot carries a sequence number which tells
+ * whether the slot is free (seq == pos), filled (seq == pos + 1) or
+ * still owned by the previous lap of the ring.
+ *
+ * A slot only points to the request descriptor in the scratch space of
+ * the source HART so a request to many HARTs is written once and every
+ * target costs one word. The descriptor is released by decrementing the
+ * pending counter of the source HART after the local flush, so it can
+ * be reused once sbi_tlb_sync() has seen the counter drop to zero.
+ */
+struct sbi_tlb_mbox_slot {
+	unsigned long seq;
+	struct sbi_tlb_info *tinfo;
+};
+
+struct sbi_tlb_mbox {
+	/* Consumer index (only updated by the target HART) */
+	unsigned long head;
+	/* Producer index (updated by source HARTs) */
+	atomic_t tail;
+	struct sbi_tlb_mbox_slot slots[];
+};
+
+/*
+ * Completion state of a source HART. The pending counter is updated by
+ * all target HARTs of a remote TLB request so we keep it on a separate
+ * cache line.
+ */
+struct sbi_tlb_sync {
+	/* Number of queued requests not yet processed by remote HARTs */
+	atomic_t pending;
+	/* Generation of the current request */
+	unsigned long gen;
+	/* Generation of the last request processed by all remote HARTs */
+	unsigned long done_gen;
+	/* Source HARTs waiting for space in the tlb queue of this HART */
+	struct sbi_hartmask space_waiters;
+	/* Lazy tlb state of this HART (SBI_TLB_LAZY_xyz) */
+	atomic_t lazy;
+	/* Generation of the outstanding asynchronous request (0 if none) */
+	unsigned long async_gen;
+	/* S-mode completion word of asynchronous requests (0 if none) */
+	unsigned long async_addr;
+	/* Raise S-mode IPI when an asynchronous request completes */
+	bool async_ssip;
+	/* Request being sent is asynchronous so the sync callback is skipped */
+	bool async_req;
+};
+
+/*
+ * A suspended HART does not use its TLB so instead of waking it up with
+ * an IPI, remote flush requests only mark it dirty and the HART does a
+ * full local flush when it resumes.
+ */
+#define SBI_TLB_LAZY_NONE		0
+#define SBI_TLB_LAZY_CLEAN		1
+#define SBI_TLB_LAZY_DIRTY		2
+
+/*
+ * Requests of other source HARTs into which the current HART has
+ * merged its own request. The current HART waits for completion
+ * of these requests in addition to its own requests.
+ */
+#define SBI_TLB_MAX_DEPS		4
+
+/* Maximum number of requests dequeued and processed as one batch */
+#define SBI_TLB_DRAIN_MAX		8
+
+/*
+ * Calibration of the range flush limit compares the best of a few
+ * full flushes with the best of a few page by page flushes. The result
+ * ignores the cost of refilling the TLB after a full flush so it is a
+ * lower bound of the real crossover point.
+ */
+#define SBI_TLB_CALIBRATE_PAGES		16
+#define SBI_TLB_CALIBRATE_ROUNDS	4
+#define SBI_TLB_CALIBRATE_MAX_PAGES	512
+
+struct sbi_tlb_deps {
+	unsigned long count;
+	struct {
+		u32 hartid;
+		u32 gen;
+	} dep[SBI_TLB_MAX_DEPS];
+};
+
+/*
+ * Topology-aware delivery of requests. When the platform groups HARTs
+ * into clusters (sharing a last level cache), a request reaching several
+ * HARTs of a remote cluster is queued only on one of them, the leader,
+ * which forwards it to the other target HARTs of its cluster. The leader
+ * counts completion of the cluster in one of its forwarding slots and the
+ * last HART to complete signals the source HART once for the cluster. So
+ * a request costs the source HART one queue write and one completion per
+ * remote cluster instead of one per remote HART.
+ *
+ * The leader never waits: targets it can not reach (no free slot or a
+ * full queue) are handed back to the source HART through the retry mask
+ * and the source HART sends the request to them directly.
+ */
+#define SBI_TLB_MAX_CLUSTERS		BITS_PER_LONG
+#define SBI_TLB_FWD_SLOTS		4
+
+struct sbi_tlb_fwd_slot {
+	/* HARTs (including the leader) yet to complete the request */
+	atomic_t pending;
+	/* Copy of the request queued on the other HARTs of the cluster */
+	struct sbi_tlb_info tinfo;
+};
+
+struct sbi_tlb_fwd {
+	/* Current request of this HART is delivered through leaders */
+	bool active;
+	/* Target HARTs of remote clusters and the leader of each cluster */
+	struct sbi_hartmask_sparse targets;
+	struct sbi_hartmask_sparse leaders;
+	/* Target HARTs not reached by their leader */
+	struct sbi_hartmask retry;
+	/* Request descriptor queued on the leaders */
+	struct sbi_tlb_info desc;
+	/* Requests of other HARTs forwarded by this HART */
+	struct sbi_tlb_fwd_slot slots[SBI_TLB_FWD_SLOTS];
+};
 
 static unsigned long tlb_sync_off;
+static unsigned long tlb_deps_off;
+static unsigned long tlb_flush_ops_off;
 static unsigned long tlb_fifo_off;
 static unsigned long tlb_fifo_mem_off;
+static unsigned long tlb_mbox_off;
+static unsigned long tlb_desc_off;
+static unsigned long tlb_fifo_num_entries;
 static unsigned long tlb_range_flush_limit;
+static unsigned long tlb_limit_off;
+static unsigned long tlb_shmem_off;
+static unsigned long tlb_range_merge_gap;
+static bool tlb_use_mbox;
+static unsigned long tlb_fwd_off;
+static u8 tlb_hart_cluster[SBI_HARTMASK_MAX_BITS];
+static u32 tlb_event = SBI_IPI_EVENT_MAX;
+
+static inline struct sbi_tlb_sync *sbi_tlb_sync_ptr(struct sbi_scratch *scratch)
+{
+	return sbi_scratch_offset_ptr(scratch, tlb_sync_off);
+}
+
+static inline struct sbi_tlb_fwd *sbi_tlb_fwd_ptr(struct sbi_scratch *scratch)
+{
+	return sbi_scratch_offset_ptr(scratch, tlb_fwd_off);
+}
+
+static inline bool sbi_tlb_fwd_test(u32 h,
+				    const struct sbi_hartmask_sparse *m)
+{
+	return ((m->summary & BIT(BIT_WORD(h))) &&
+		(m->bits[BIT_WORD(h)] & BIT_MASK(h))) ? TRUE : FALSE;
+}
 
 static void sbi_tlb_flush_all(void)
 {
 	__asm__ __volatile("sfence.vma");
 }
 
-void sbi_tlb_local_hfence_vvma(struct sbi_tlb_info *tinfo)
+static void tlb_page_sfence_vma(unsigned long start, unsigned long size,
+				unsigned long stride)
+{
+	unsigned long i;
+
+	for (i = 0; i < size; i += stride) {
+		__asm__ __volatile__("sfence.vma %0"
+				     :
+				     : "r"(start + i)
+				     : "memory");
+	}
+}
+
+static void tlb_page_sfence_vma_asid(unsigned long start, unsigned long size,
+				     unsigned long stride, unsigned long asid)
+{
+	unsigned long i;
+
+	for (i = 0; i < size; i += stride) {
+		__asm__ __volatile__("sfence.vma %0, %1"
+				     :
+				     : "r"(start + i), "r"(asid)
+				     : "memory");
+	}
+}
+
+static void tlb_page_hfence_gvma(unsigned long start, unsigned long size,
+				 unsigned long stride)
+{
+	unsigned long i;
+
+	for (i = 0; i < size; i += stride) {
+		__sbi_hfence_gvma_gpa(start+i);
+	}
+}
+
+static void tlb_page_hfence_gvma_vmid(unsigned long start, unsigned long size,
+				      unsigned long stride, unsigned long vmid)
+{
+	unsigned long i;
+
+	for (i = 0; i < size; i += stride) {
+		__sbi_hfence_gvma_vmid_gpa(start + i, vmid);
+	}
+}
+
+static void tlb_page_hfence_vvma(unsigned long start, unsigned long size,
+				 unsigned long stride)
+{
+	unsigned long i;
+
+	for (i = 0; i < size; i += stride) {
+		__sbi_hfence_vvma_va(start+i);
+	}
+}
+
+static void tlb_page_hfence_vvma_asid(unsigned long start, unsigned long size,
+				      unsigned long stride, unsigned long asid)
+{
+	unsigned long i;
+
+	for (i = 0; i < size; i += stride) {
+		__sbi_hfence_vvma_asid_va(start + i, asid);
+	}
+}
+
+/* Default backend which issues one fence per page */
+static const struct sbi_tlb_flush_ops tlb_page_flush_ops = {
+	.name = "page",
+	.sfence_vma = tlb_page_sfence_vma,
+	.sfence_vma_asid = tlb_page_sfence_vma_asid,
+	.hfence_gvma = tlb_page_hfence_gvma,
+	.hfence_gvma_vmid = tlb_page_hfence_gvma_vmid,
+	.hfence_vvma = tlb_page_hfence_vvma,
+	.hfence_vvma_asid = tlb_page_hfence_vvma_asid,
+};
+
+/*
+ * Svinval backend which batches the invalidations of a range between
+ * one SFENCE.W.INVAL and one SFENCE.INVAL.IR instead of serializing
+ * every page.
+ */
+static void tlb_svinval_sfence_vma(unsigned long start, unsigned long size,
+				   unsigned long stride)
+{
+	unsigned long i;
+
+	__sbi_sfence_w_inval();
+	for (i = 0; i < size; i += stride)
+		__sbi_sinval_vma_va(start + i);
+	__sbi_sfence_inval_ir();
+}
+
+static void tlb_svinval_sfence_vma_asid(unsigned long start,
+					unsigned long size,
+					unsigned long stride,
+					unsigned long asid)
+{
+	unsigned long i;
+
+	__sbi_sfence_w_inval();
+	for (i = 0; i < size; i += stride)
+		__sbi_sinval_vma_asid_va(start + i, asid);
+	__sbi_sfence_inval_ir();
+}
+
+static void tlb_svinval_hfence_gvma(unsigned long start, unsigned long size,
+				    unsigned long stride)
+{
+	unsigned long i;
+
+	__sbi_sfence_w_inval();
+	for (i = 0; i < size; i += stride)
+		__sbi_hinval_gvma_gpa(start + i);
+	__sbi_sfence_inval_ir();
+}
+
+static void tlb_svinval_hfence_gvma_vmid(unsigned long start,
+					 unsigned long size,
+					 unsigned long stride,
+					 unsigned long vmid)
+{
+	unsigned long i;
+
+	__sbi_sfence_w_inval();
+	for (i = 0; i < size; i += stride)
+		__sbi_hinval_gvma_vmid_gpa(start + i, vmid);
+	__sbi_sfence_inval_ir();
+}
+
+static void tlb_svinval_hfence_vvma(unsigned long start, unsigned long size,
+				    unsigned long stride)
+{
+	unsigned long i;
+
+	__sbi_sfence_w_inval();
+	for (i = 0; i < size; i += stride)
+		__sbi_hinval_vvma_va(start + i);
+	__sbi_sfence_inval_ir();
+}
+
+static void tlb_svinval_hfence_vvma_asid(unsigned long start,
+					 unsigned long size,
+					 unsigned long stride,
+					 unsigned long asid)
+{
+	unsigned long i;
+
+	__sbi_sfence_w_inval();
+	for (i = 0; i < size; i += stride)
+		__sbi_hinval_vvma_asid_va(start + i, asid);
+	__sbi_sfence_inval_ir();
+}
+
+static bool tlb_svinval_probe(struct sbi_scratch *scratch)
+{
+	return sbi_hart_has_feature(scratch, SBI_HART_HAS_SVINVAL);
+}
+
+static const struct sbi_tlb_flush_ops tlb_svinval_flush_ops = {
+	.name = "svinval",
+	.probe = tlb_svinval_probe,
+	.sfence_vma = tlb_svinval_sfence_vma,
+	.sfence_vma_asid = tlb_svinval_sfence_vma_asid,
+	.hfence_gvma = tlb_svinval_hfence_gvma,
+	.hfence_gvma_vmid = tlb_svinval_hfence_gvma_vmid,
+	.hfence_vvma = tlb_svinval_hfence_vvma,
+	.hfence_vvma_asid = tlb_svinval_hfence_vvma_asid,
+};
+
+/* Backends registered by platform, probed before the generic ones */
+static const struct sbi_tlb_flush_ops *tlb_flush_ops_array[SBI_TLB_FLUSH_OPS_MAX];
+static unsigned long tlb_flush_ops_count;
+
+int sbi_tlb_register_flush_ops(const struct sbi_tlb_flush_ops *ops)
+{
+	if (!ops)
+		return SBI_EINVAL;
+	if (SBI_TLB_FLUSH_OPS_MAX <= tlb_flush_ops_count)
+		return SBI_ENOSPC;
+
+	tlb_flush_ops_array[tlb_flush_ops_count++] = ops;
+
+	return 0;
+}
+
+static const struct sbi_tlb_flush_ops *sbi_tlb_flush_ops_select(
+					struct sbi_scratch *scratch)
+{
+	unsigned long i;
+	const struct sbi_tlb_flush_ops *ops;
+
+	for (i = 0; i < tlb_flush_ops_count; i++) {
+		ops = tlb_flush_ops_array[i];
+		if (!ops->probe || ops->probe(scratch))
+			return ops;
+	}
+
+	if (tlb_svinval_flush_ops.probe(scratch))
+		return &tlb_svinval_flush_ops;
+
+	return &tlb_page_flush_ops;
+}
+
+const struct sbi_tlb_flush_ops *sbi_tlb_get_flush_ops(
+					struct sbi_scratch *scratch)
+{
+	const struct sbi_tlb_flush_ops **ops_ptr =
+			sbi_scratch_offset_ptr(scratch, tlb_flush_ops_off);
+
+	return *ops_ptr;
+}
+
+#define sbi_tlb_flush_range(__op, ...)					\
+do {									\
+	const struct sbi_tlb_flush_ops *__ops =				\
+			sbi_tlb_get_flush_ops(sbi_scratch_thishart_ptr());	\
+	if (__ops->__op)						\
+		__ops->__op(__VA_ARGS__);				\
+	else								\
+		tlb_page_flush_ops.__op(__VA_ARGS__);			\
+} while (0)
+
+/* Ranges beyond the calibrated limit of the current HART are flushed fully */
+static inline bool sbi_tlb_range_over_limit(struct sbi_tlb_info *tinfo)
+{
+	unsigned long *limit;
+
+	if (!tlb_limit_off)
+		return FALSE;
+
+	limit = sbi_scratch_thishart_offset_ptr(tlb_limit_off);
+	return (*limit < ((tinfo->size / tinfo->stride) << PAGE_SHIFT)) ?
+		TRUE : FALSE;
+}
+
+static inline unsigned long sbi_tlb_vmid_enter(unsigned long vmid)
+{
+	return csr_swap(CSR_HGATP,
+			(vmid << HGATP_VMID_SHIFT) & HGATP_VMID_MASK);
+}
+
+/* Note: must be called with the VMID of the entry selected in HGATP */
+static void __hot __sbi_tlb_hfence_vvma(struct sbi_tlb_info *tinfo)
 {
 	unsigned long start = tinfo->start;
 	unsigned long size  = tinfo->size;
-	unsigned long vmid  = tinfo->vmid;
-	unsigned long i, hgatp;
 
-	hgatp = csr_swap(CSR_HGATP,
-			 (vmid << HGATP_VMID_SHIFT) & HGATP_VMID_MASK);
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_HFENCE_VVMA_RECVD);
+	sbi_misaligned_insn_cache_flush();
 
 	if ((start == 0 && size == 0) || (size == SBI_TLB_FLUSH_ALL)) {
 		__sbi_hfence_vvma_all();
-		goto done;
+		return;
 	}
 
-	for (i = 0; i < size; i += PAGE_SIZE) {
-		__sbi_hfence_vvma_va(start+i);
-	}
+	sbi_tlb_flush_range(hfence_vvma, start, size, tinfo->stride);
+}
 
-done:
+void __hot sbi_tlb_local_hfence_vvma(struct sbi_tlb_info *tinfo)
+{
+	unsigned long hgatp = sbi_tlb_vmid_enter(tinfo->vmid);
+
+	__sbi_tlb_hfence_vvma(tinfo);
 	csr_write(CSR_HGATP, hgatp);
 }
 
-void sbi_tlb_local_hfence_gvma(struct sbi_tlb_info *tinfo)
+void __hot sbi_tlb_local_hfence_gvma(struct sbi_tlb_info *tinfo)
 {
 	unsigned long start = tinfo->start;
 	unsigned long size  = tinfo->size;
-	unsigned long i;
+
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_HFENCE_GVMA_RECVD);
+	sbi_misaligned_insn_cache_flush();
 
 	if ((start == 0 && size == 0) || (size == SBI_TLB_FLUSH_ALL)) {
 		__sbi_hfence_gvma_all();
 		return;
 	}
 
-	for (i = 0; i < size; i += PAGE_SIZE) {
-		__sbi_hfence_gvma_gpa(start+i);
-	}
+	sbi_tlb_flush_range(hfence_gvma, start, size, tinfo->stride);
 }
 
-void sbi_tlb_local_sfence_vma(struct sbi_tlb_info *tinfo)
+void __hot sbi_tlb_local_sfence_vma(struct sbi_tlb_info *tinfo)
 {
 	unsigned long start = tinfo->start;
 	unsigned long size  = tinfo->size;
-	unsigned long i;
 
-	if ((start == 0 && size == 0) || (size == SBI_TLB_FLUSH_ALL)) {
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_SFENCE_VMA_RECVD);
+	sbi_misaligned_insn_cache_flush();
+
+	if ((start == 0 && size == 0) || (size == SBI_TLB_FLUSH_ALL) ||
+	    sbi_tlb_range_over_limit(tinfo)) {
 		sbi_tlb_flush_all();
 		return;
 	}
 
-	for (i = 0; i < size; i += PAGE_SIZE) {
-		__asm__ __volatile__("sfence.vma %0"
-				     :
-				     : "r"(start + i)
-				     : "memory");
-	}
+	sbi_tlb_flush_range(sfence_vma, start, size, tinfo->stride);
 }
 
-void sbi_tlb_local_hfence_vvma_asid(struct sbi_tlb_info *tinfo)
+/* Note: must be called with the VMID of the entry selected in HGATP */
+static void __hot __sbi_tlb_hfence_vvma_asid(struct sbi_tlb_info *tinfo)
 {
 	unsigned long start = tinfo->start;
 	unsigned long size  = tinfo->size;
 	unsigned long asid  = tinfo->asid;
-	unsigned long vmid  = tinfo->vmid;
-	unsigned long i, hgatp;
 
-	hgatp = csr_swap(CSR_HGATP,
-			 (vmid << HGATP_VMID_SHIFT) & HGATP_VMID_MASK);
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_HFENCE_VVMA_ASID_RECVD);
+	sbi_misaligned_insn_cache_flush();
 
 	if (start == 0 && size == 0) {
 		__sbi_hfence_vvma_all();
-		goto done;
+		return;
 	}
 
 	if (size == SBI_TLB_FLUSH_ALL) {
 		__sbi_hfence_vvma_asid(asid);
-		goto done;
+		return;
 	}
 
-	for (i = 0; i < size; i += PAGE_SIZE) {
-		__sbi_hfence_vvma_asid_va(start + i, asid);
-	}
+	sbi_tlb_flush_range(hfence_vvma_asid, start, size,
+			    tinfo->stride, asid);
+}
 
-done:
+void __hot sbi_tlb_local_hfence_vvma_asid(struct sbi_tlb_info *tinfo)
+{
+	unsigned long hgatp = sbi_tlb_vmid_enter(tinfo->vmid);
+
+	__sbi_tlb_hfence_vvma_asid(tinfo);
 	csr_write(CSR_HGATP, hgatp);
 }
 
-void sbi_tlb_local_hfence_gvma_vmid(struct sbi_tlb_info *tinfo)
+void __hot sbi_tlb_local_hfence_gvma_vmid(struct sbi_tlb_info *tinfo)
 {
 	unsigned long start = tinfo->start;
 	unsigned long size  = tinfo->size;
 	unsigned long vmid  = tinfo->vmid;
-	unsigned long i;
+
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_HFENCE_GVMA_VMID_RECVD);
+	sbi_misaligned_insn_cache_flush();
 
 	if (start == 0 && size == 0) {
 		__sbi_hfence_gvma_all();
@@ -136,170 +550,794 @@ void sbi_tlb_local_hfence_gvma_vmid(struct sbi_tlb_info *tinfo)
 		return;
 	}
 
-	for (i = 0; i < size; i += PAGE_SIZE) {
-		__sbi_hfence_gvma_vmid_gpa(start + i, vmid);
-	}
+	sbi_tlb_flush_range(hfence_gvma_vmid, start, size,
+			    tinfo->stride, vmid);
 }
 
-void sbi_tlb_local_sfence_vma_asid(struct sbi_tlb_info *tinfo)
+void __hot sbi_tlb_local_sfence_vma_asid(struct sbi_tlb_info *tinfo)
 {
 	unsigned long start = tinfo->start;
 	unsigned long size  = tinfo->size;
 	unsigned long asid  = tinfo->asid;
+
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_SFENCE_VMA_ASID_RECVD);
+	sbi_misaligned_insn_cache_flush();
+
+	if (start == 0 && size == 0) {
+		sbi_tlb_flush_all();
+		return;
+	}
+
+	/* Flush entire MM context for a given ASID */
+	if (size == SBI_TLB_FLUSH_ALL || sbi_tlb_range_over_limit(tinfo)) {
+		__asm__ __volatile__("sfence.vma x0, %0"
+				     :
+				     : "r"(asid)
+				     : "memory");
+		return;
+	}
+
+	sbi_tlb_flush_range(sfence_vma_asid, start, size,
+			    tinfo->stride, asid);
+}
+
+void __hot sbi_tlb_local_fence_i(struct sbi_tlb_info *tinfo)
+{
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_FENCE_I_RECVD);
+	sbi_misaligned_insn_cache_flush();
+	__asm__ __volatile("fence.i");
+}
+
+static bool sbi_tlb_lazy_mark_dirty(struct sbi_scratch *remote_scratch)
+{
+	long old;
+	struct sbi_tlb_sync *rtlb_sync = sbi_tlb_sync_ptr(remote_scratch);
+
+	old = atomic_read(&rtlb_sync->lazy);
+	if (old == SBI_TLB_LAZY_CLEAN)
+		old = atomic_cmpxchg(&rtlb_sync->lazy, SBI_TLB_LAZY_CLEAN,
+				     SBI_TLB_LAZY_DIRTY);
+
+	return (old != SBI_TLB_LAZY_NONE) ? TRUE : FALSE;
+}
+
+void sbi_tlb_lazy_enter(struct sbi_scratch *scratch)
+{
+	struct sbi_tlb_sync *tlb_sync = sbi_tlb_sync_ptr(scratch);
+
+	atomic_write(&tlb_sync->lazy, SBI_TLB_LAZY_CLEAN);
+}
+
+void sbi_tlb_lazy_exit(struct sbi_scratch *scratch)
+{
+	struct sbi_tlb_sync *tlb_sync = sbi_tlb_sync_ptr(scratch);
+
+	/*
+	 * After the exchange all remote HARTs queue their requests again
+	 * so only the requests marked before it need the full flush.
+	 */
+	if (atomic_xchg(&tlb_sync->lazy, SBI_TLB_LAZY_NONE) !=
+	    SBI_TLB_LAZY_DIRTY)
+		return;
+
+	sbi_misaligned_insn_cache_flush();
+	sbi_tlb_flush_all();
+	if (misa_extension('H')) {
+		__sbi_hfence_gvma_all();
+		__sbi_hfence_vvma_all();
+	}
+	__asm__ __volatile("fence.i");
+}
+
+static inline bool __sbi_tlb_range_is_all(struct sbi_tlb_info *tinfo)
+{
+	return (tinfo->size == SBI_TLB_FLUSH_ALL) ? TRUE : FALSE;
+}
+
+static inline bool __sbi_tlb_range_is_global(struct sbi_tlb_info *tinfo)
+{
+	return (!tinfo->start && !tinfo->size) ? TRUE : FALSE;
+}
+
+static inline bool __sbi_tlb_same_context(struct sbi_tlb_info *curr,
+					  struct sbi_tlb_info *next)
+{
+	if (curr->local_fn != next->local_fn || curr->stride != next->stride)
+		return FALSE;
+
+	/* FENCE.I has no range so any two requests are duplicates */
+	if (next->local_fn == sbi_tlb_local_fence_i)
+		return TRUE;
+
+	if (next->local_fn == sbi_tlb_local_sfence_vma ||
+	    next->local_fn == sbi_tlb_local_hfence_gvma)
+		return TRUE;
+	if (next->local_fn == sbi_tlb_local_sfence_vma_asid)
+		return (curr->asid == next->asid) ? TRUE : FALSE;
+	if (next->local_fn == sbi_tlb_local_hfence_gvma_vmid ||
+	    next->local_fn == sbi_tlb_local_hfence_vvma)
+		return (curr->vmid == next->vmid) ? TRUE : FALSE;
+	if (next->local_fn == sbi_tlb_local_hfence_vvma_asid)
+		return (curr->asid == next->asid &&
+			curr->vmid == next->vmid) ? TRUE : FALSE;
+
+	return FALSE;
+}
+
+/* Check whether flushing curr also flushes everything flushed by next */
+static bool __sbi_tlb_covers(struct sbi_tlb_info *curr,
+			     struct sbi_tlb_info *next)
+{
+	if (!__sbi_tlb_same_context(curr, next))
+		return FALSE;
+
+	if (__sbi_tlb_range_is_global(curr))
+		return TRUE;
+	if (__sbi_tlb_range_is_global(next))
+		return FALSE;
+	if (__sbi_tlb_range_is_all(curr))
+		return TRUE;
+	if (__sbi_tlb_range_is_all(next))
+		return FALSE;
+
+	return (curr->start <= next->start &&
+		next->start + next->size <= curr->start + curr->size) ?
+		TRUE : FALSE;
+}
+
+static inline bool __sbi_tlb_is_vvma(struct sbi_tlb_info *tinfo)
+{
+	return (tinfo->local_fn == sbi_tlb_local_hfence_vvma ||
+		tinfo->local_fn == sbi_tlb_local_hfence_vvma_asid) ?
+		TRUE : FALSE;
+}
+
+static atomic_t *sbi_tlb_forward(struct sbi_tlb_info *tinfo);
+
+/*
+ * Signal completion of the outstanding asynchronous request of a source
+ * HART. This is called by the source HART itself and by the target HART
+ * which completes the last queued request so only the first caller finds
+ * the generation of the request.
+ */
+static void sbi_tlb_async_complete(struct sbi_scratch *scratch)
+{
+	unsigned long gen;
+	struct sbi_tlb_sync *tlb_sync = sbi_tlb_sync_ptr(scratch);
+
+	/* Pairs with the barrier of the source HART publishing async_gen */
+	smp_mb();
+	if (!tlb_sync->async_gen)
+		return;
+	gen = atomic_raw_xchg_ulong(&tlb_sync->async_gen, 0);
+	if (!gen)
+		return;
+
+	/* Other HARTs merged into the request wait for its generation */
+	__smp_store_release(&tlb_sync->done_gen, gen);
+	if (tlb_sync->async_addr)
+		__smp_store_release((unsigned long *)tlb_sync->async_addr, gen);
+	if (tlb_sync->async_ssip)
+		sbi_ipi_send_smode(1UL, scratch->hartid);
+}
+
+/*
+ * Process a batch of dequeued entries. An entry covered by another
+ * entry of the batch is not flushed, of equal entries only the first
+ * one is. Guest flushes of the same VMID are done under one switch
+ * of HGATP. Entries to be forwarded are forwarded first so that the
+ * other HARTs of the cluster flush in parallel.
+ */
+static void __hot sbi_tlb_entries_process(struct sbi_tlb_info **ents,
+					  u32 count)
+{
+	static const char stats_name[] = "tlb_entry_process";
+	u32 i, j, src_hartid;
+	unsigned long hgatp, vmid;
+	bool done[SBI_TLB_DRAIN_MAX];
+	atomic_t *cnt[SBI_TLB_DRAIN_MAX];
+	struct sbi_scratch *rscratch;
+	unsigned long stats_start = sbi_lock_stats_start();
+
+	for (i = 0; i < count; i++) {
+		if (ents[i]->flags & SBI_TLB_INFO_FORWARD)
+			cnt[i] = sbi_tlb_forward(ents[i]);
+		else
+			cnt[i] = ents[i]->done;
+	}
+
+	for (i = 0; i < count; i++) {
+		done[i] = FALSE;
+		for (j = 0; j < count && !done[i]; j++) {
+			if (j == i || !__sbi_tlb_covers(ents[j], ents[i]))
+				continue;
+			if (j < i || !__sbi_tlb_covers(ents[i], ents[j]))
+				done[i] = TRUE;
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		if (done[i])
+			continue;
+		if (!__sbi_tlb_is_vvma(ents[i])) {
+			ents[i]->local_fn(ents[i]);
+			continue;
+		}
+
+		vmid = ents[i]->vmid;
+		hgatp = sbi_tlb_vmid_enter(vmid);
+		for (j = i; j < count; j++) {
+			if (done[j] || !__sbi_tlb_is_vvma(ents[j]) ||
+			    ents[j]->vmid != vmid)
+				continue;
+			if (ents[j]->local_fn == sbi_tlb_local_hfence_vvma)
+				__sbi_tlb_hfence_vvma(ents[j]);
+			else
+				__sbi_tlb_hfence_vvma_asid(ents[j]);
+			done[j] = TRUE;
+		}
+		csr_write(CSR_HGATP, hgatp);
+	}
+
+	/* Accounted as contended so that the cost of the flush is summed */
+	sbi_lock_stats_account(stats_name, stats_name, TRUE, stats_start);
+
+	/*
+	 * Signal completion to the source HART of each entry, or to the
+	 * forwarding slot of a forwarded entry in which case the last HART
+	 * of the cluster signals the source HART. This also releases a
+	 * mailbox request descriptor so it is the last access.
+	 */
+	for (i = 0; i < count; i++) {
+		src_hartid = ents[i]->src_hartid;
+		if (cnt[i] && atomic_sub_return(cnt[i], 1))
+			continue;
+		rscratch = sbi_hartid_to_scratch(src_hartid);
+		if (rscratch && !atomic_sub_return_release(
+				&sbi_tlb_sync_ptr(rscratch)->pending, 1))
+			sbi_tlb_async_complete(rscratch);
+	}
+}
+
+static void sbi_tlb_mbox_init(struct sbi_tlb_mbox *mbox)
+{
 	unsigned long i;
 
-	if (start == 0 && size == 0) {
-		sbi_tlb_flush_all();
-		return;
-	}
+	mbox->head = 0;
+	ATOMIC_INIT(&mbox->tail, 0);
+	for (i = 0; i < tlb_fifo_num_entries; i++)
+		mbox->slots[i].seq = i;
+	smp_wmb();
+}
+
+static int sbi_tlb_mbox_enqueue(struct sbi_tlb_mbox *mbox,
+				struct sbi_tlb_info *tinfo)
+{
+	long pos, diff;
+	struct sbi_tlb_mbox_slot *slot;
+
+	pos = atomic_read(&mbox->tail);
+	while (1) {
+		slot = &mbox->slots[(unsigned long)pos %
+				    tlb_fifo_num_entries];
+		diff = (long)__smp_load_acquire(&slot->seq) - pos;
+		if (!diff) {
+			/* Slot is free so try to reserve it */
+			if (atomic_cmpxchg(&mbox->tail, pos, pos + 1) == pos)
+				break;
+		} else if (diff < 0) {
+			/* Slot still holds an entry from previous lap */
+			return SBI_ENOSPC;
+		}
+		pos = atomic_read(&mbox->tail);
+	}
+
+	slot->tinfo = tinfo;
+	__smp_store_release(&slot->seq, (unsigned long)pos + 1);
+
+	return 0;
+}
+
+static struct sbi_tlb_info *sbi_tlb_mbox_dequeue(struct sbi_tlb_mbox *mbox)
+{
+	struct sbi_tlb_info *tinfo;
+	unsigned long pos = mbox->head;
+	struct sbi_tlb_mbox_slot *slot =
+			&mbox->slots[pos % tlb_fifo_num_entries];
+
+	if (__smp_load_acquire(&slot->seq) != (pos + 1))
+		return NULL;
+
+	tinfo = slot->tinfo;
+	__smp_store_release(&slot->seq, pos + tlb_fifo_num_entries);
+	mbox->head = pos + 1;
+
+	return tinfo;
+}
+
+/*
+ * Queue a forwarded request on another HART of the cluster. The slot is
+ * accounted before the remote HART can see the entry. The leader holds
+ * its own count until it is done so the slot can't complete early.
+ */
+static int sbi_tlb_fwd_queue(u32 hartid, struct sbi_tlb_fwd_slot *slot)
+{
+	int rc;
+	struct sbi_scratch *rscratch = sbi_hartid_to_scratch(hartid);
+
+	if (!rscratch)
+		return SBI_EINVAL;
+
+	/* Defer the flush of a suspended HART to its resume */
+	if (sbi_tlb_lazy_mark_dirty(rscratch))
+		return 0;
+
+	atomic_add_return_relaxed(&slot->pending, 1);
+	if (tlb_use_mbox)
+		rc = sbi_tlb_mbox_enqueue(
+			sbi_scratch_offset_ptr(rscratch, tlb_mbox_off),
+			&slot->tinfo);
+	else
+		rc = sbi_ring_enqueue(
+			sbi_scratch_offset_ptr(rscratch, tlb_fifo_off),
+			&slot->tinfo);
+	if (rc < 0) {
+		atomic_sub_return_relaxed(&slot->pending, 1);
+		return rc;
+	}
+
+	return sbi_ipi_raise(hartid, tlb_event);
+}
+
+/*
+ * Forward a request queued on the current (leader) HART to the other
+ * target HARTs of its cluster. Returns the completion counter of the
+ * forwarding slot or NULL if the request completes directly on the
+ * source HART.
+ */
+static atomic_t *sbi_tlb_forward(struct sbi_tlb_info *tinfo)
+{
+	u32 i, w, h;
+	unsigned long bits;
+	struct sbi_tlb_fwd *sfwd, *fwd;
+	struct sbi_tlb_fwd_slot *slot = NULL;
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	struct sbi_scratch *src_scratch =
+			sbi_hartid_to_scratch(tinfo->src_hartid);
+	u8 cluster = tlb_hart_cluster[scratch->hartid];
+
+	if (!tlb_fwd_off || !src_scratch)
+		return NULL;
+	sfwd = sbi_tlb_fwd_ptr(src_scratch);
+	fwd = sbi_tlb_fwd_ptr(scratch);
+
+	/* Only the current HART takes slots so a free slot stays free */
+	for (i = 0; i < SBI_TLB_FWD_SLOTS; i++) {
+		if (!atomic_read(&fwd->slots[i].pending)) {
+			slot = &fwd->slots[i];
+			break;
+		}
+	}
+	if (slot) {
+		sbi_memcpy(&slot->tinfo, tinfo, sizeof(slot->tinfo));
+		slot->tinfo.flags = 0;
+		slot->tinfo.done = &slot->pending;
+		atomic_write(&slot->pending, 1);
+	}
+
+	/* Target HARTs are stable until the source HART sees completion */
+	sbi_hartmask_sparse_for_each_word(w, &sfwd->targets) {
+		bits = sfwd->targets.bits[w];
+		for_each_set_bit(i, &bits, BITS_PER_LONG) {
+			h = w * BITS_PER_LONG + i;
+			if (h == scratch->hartid || tlb_hart_cluster[h] != cluster)
+				continue;
+			if (!slot || sbi_tlb_fwd_queue(h, slot))
+				atomic_raw_set_bit(h, sfwd->retry.bits);
+		}
+	}
+
+	return (slot) ? &slot->pending : NULL;
+}
+
+/*
+ * Dequeue up to SBI_TLB_DRAIN_MAX requests of current HART. The FIFO
+ * lock is taken once and the entries are copied into the buffer whereas
+ * mailbox entries point to the request descriptor of the source HART.
+ */
+static u32 sbi_tlb_dequeue_many(struct sbi_scratch *scratch,
+				struct sbi_tlb_info *buf,
+				struct sbi_tlb_info **ents)
+{
+	u32 i, count;
+	struct sbi_tlb_mbox *mbox;
+
+	if (tlb_use_mbox) {
+		mbox = sbi_scratch_offset_ptr(scratch, tlb_mbox_off);
+		for (i = 0; i < SBI_TLB_DRAIN_MAX; i++) {
+			ents[i] = sbi_tlb_mbox_dequeue(mbox);
+			if (!ents[i])
+				break;
+		}
+		return i;
+	}
+
+	count = sbi_ring_dequeue_many(
+			sbi_scratch_offset_ptr(scratch, tlb_fifo_off),
+			buf, SBI_TLB_DRAIN_MAX);
+	for (i = 0; i < count; i++)
+		ents[i] = &buf[i];
+
+	return count;
+}
+
+static void sbi_tlb_space_notify(struct sbi_scratch *scratch);
+
+/* Process one batch of requests (used while waiting for remote HARTs) */
+static void sbi_tlb_process_batch(struct sbi_scratch *scratch)
+{
+	u32 count;
+	struct sbi_tlb_info buf[SBI_TLB_DRAIN_MAX];
+	struct sbi_tlb_info *ents[SBI_TLB_DRAIN_MAX];
+
+	count = sbi_tlb_dequeue_many(scratch, buf, ents);
+	if (count)
+		sbi_tlb_entries_process(ents, count);
+
+	sbi_tlb_space_notify(scratch);
+}
+
+static void __hot sbi_tlb_process(struct sbi_scratch *scratch)
+{
+	u32 count;
+	struct sbi_tlb_info buf[SBI_TLB_DRAIN_MAX];
+	struct sbi_tlb_info *ents[SBI_TLB_DRAIN_MAX];
+
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_TLB_PROCESS);
+
+	while ((count = sbi_tlb_dequeue_many(scratch, buf, ents)))
+		sbi_tlb_entries_process(ents, count);
+
+	sbi_tlb_space_notify(scratch);
+}
+
+/*
+ * Ring the "space available" doorbell of every source HART waiting
+ * for space in the tlb queue of current HART. This is done after every
+ * attempt to drain the queue, even when nothing was dequeued, so that
+ * a waiter which registered after the last drain is not left waiting.
+ */
+static void sbi_tlb_space_notify(struct sbi_scratch *scratch)
+{
+	u32 i, j;
+	unsigned long waiters;
+	struct sbi_tlb_sync *tlb_sync = sbi_tlb_sync_ptr(scratch);
+
+	for (i = 0; i < array_size(tlb_sync->space_waiters.bits); i++) {
+		if (!tlb_sync->space_waiters.bits[i])
+			continue;
+
+		waiters = atomic_raw_xchg_ulong(
+				&tlb_sync->space_waiters.bits[i], 0);
+		for (j = 0; waiters; j++, waiters >>= 1) {
+			if (waiters & 1UL)
+				sbi_ipi_raw_send(i * __riscv_xlen + j);
+		}
+	}
+}
+
+/*
+ * Wait for the remote HART to make space in its tlb queue. The current
+ * HART registers itself as waiter, kicks the remote HART to drain its
+ * queue and sleeps in WFI until the remote HART rings back. Requests
+ * queued for the current HART are processed after every wakeup so two
+ * HARTs shooting each other down make progress.
+ *
+ * The returning IPI is cleared before processing our own queue so the
+ * next WFI really sleeps. The caller must re-raise the IPI of current
+ * HART once it is done waiting so that IPI events of other types are
+ * not lost.
+ */
+static void sbi_tlb_space_wait(struct sbi_scratch *scratch,
+			       struct sbi_scratch *remote_scratch,
+			       u32 curr_hartid, u32 remote_hartid)
+{
+	struct sbi_tlb_sync *rtlb_sync = sbi_tlb_sync_ptr(remote_scratch);
+
+	atomic_raw_set_bit(curr_hartid, rtlb_sync->space_waiters.bits);
+
+	/*
+	 * The IPIs are triggered only after all remote HARTs are
+	 * updated so kick the remote HART to drain its queue.
+	 */
+	sbi_ipi_raw_send(remote_hartid);
 
-	/* Flush entire MM context for a given ASID */
-	if (size == SBI_TLB_FLUSH_ALL) {
-		__asm__ __volatile__("sfence.vma x0, %0"
-				     :
-				     : "r"(asid)
-				     : "memory");
-		return;
-	}
+	wfi();
 
-	for (i = 0; i < size; i += PAGE_SIZE) {
-		__asm__ __volatile__("sfence.vma %0, %1"
-				     :
-				     : "r"(start + i), "r"(asid)
-				     : "memory");
-	}
+	sbi_ipi_raw_clear(curr_hartid);
+	sbi_tlb_process(scratch);
 }
 
-void sbi_tlb_local_fence_i(struct sbi_tlb_info *tinfo)
+static inline bool __sbi_tlb_gen_done(unsigned long done_gen, u32 gen)
 {
-	__asm__ __volatile("fence.i");
+	return ((s32)((u32)done_gen - gen) >= 0) ? TRUE : FALSE;
 }
 
-static void sbi_tlb_entry_process(struct sbi_tlb_info *tinfo)
+static void __hot sbi_tlb_sync(struct sbi_scratch *scratch)
 {
-	u32 rhartid;
-	struct sbi_scratch *rscratch = NULL;
-	unsigned long *rtlb_sync = NULL;
+	static const char stats_name[] = "tlb_sync";
+	long pending;
+	bool waited = FALSE;
+	unsigned long i, val, backoff = 0;
+	unsigned long stats_start = sbi_lock_stats_start();
+	struct sbi_scratch *rscratch;
+	struct sbi_tlb_sync *rtlb_sync;
+	struct sbi_tlb_sync *tlb_sync = sbi_tlb_sync_ptr(scratch);
+	struct sbi_tlb_deps *tlb_deps =
+			sbi_scratch_offset_ptr(scratch, tlb_deps_off);
+
+	/*
+	 * The counter is incremented once for every request queued on a
+	 * remote HART and decremented by the remote HART after it is done
+	 * so we wait only once for all remote HARTs.
+	 */
+	while ((pending = atomic_read(&tlb_sync->pending)) > 0) {
+		waited = TRUE;
+		/*
+		 * While we are waiting for remote harts to complete,
+		 * consume fifo requests to avoid deadlock.
+		 */
+		sbi_tlb_process_batch(scratch);
+
+		/* Requests queued for us wake up the wait with an IPI */
+		spin_wait_ulong(
+			(volatile unsigned long *)&tlb_sync->pending.counter,
+			pending, &backoff);
+	}
 
-	tinfo->local_fn(tinfo);
+	/*
+	 * Publish completion of our own requests before waiting for the
+	 * requests we merged into so that two HARTs merged into each
+	 * others requests don't wait for each other.
+	 */
+	__smp_store_release(&tlb_sync->done_gen, tlb_sync->gen);
 
-	sbi_hartmask_for_each_hart(rhartid, &tinfo->smask) {
-		rscratch = sbi_hartid_to_scratch(rhartid);
+	for (i = 0; i < tlb_deps->count; i++) {
+		rscratch = sbi_hartid_to_scratch(tlb_deps->dep[i].hartid);
 		if (!rscratch)
 			continue;
-
-		rtlb_sync = sbi_scratch_offset_ptr(rscratch, tlb_sync_off);
-		while (atomic_raw_xchg_ulong(rtlb_sync, 1)) ;
+		rtlb_sync = sbi_tlb_sync_ptr(rscratch);
+		while (!__sbi_tlb_gen_done(
+				(val = __smp_load_acquire(&rtlb_sync->done_gen)),
+				tlb_deps->dep[i].gen)) {
+			waited = TRUE;
+			sbi_tlb_process_batch(scratch);
+			spin_wait_ulong(&rtlb_sync->done_gen, val, &backoff);
+		}
 	}
+	tlb_deps->count = 0;
+
+	sbi_lock_stats_account(stats_name, stats_name, waited, stats_start);
 }
 
-static void sbi_tlb_process_count(struct sbi_scratch *scratch, int count)
+static void __hot sbi_tlb_sync_event(struct sbi_scratch *scratch)
 {
-	struct sbi_tlb_info tinfo;
-	u32 deq_count = 0;
-	struct sbi_fifo *tlb_fifo =
-			sbi_scratch_offset_ptr(scratch, tlb_fifo_off);
-
-	while (!sbi_fifo_dequeue(tlb_fifo, &tinfo)) {
-		sbi_tlb_entry_process(&tinfo);
-		deq_count++;
-		if (deq_count > count)
-			break;
+	/* Completion of an asynchronous request is signalled instead */
+	if (!sbi_tlb_sync_ptr(scratch)->async_req)
+		sbi_tlb_sync(scratch);
+}
 
-	}
+/*
+ * Wait for the outstanding asynchronous request of the current HART
+ * before its request descriptors and generation are reused.
+ */
+static void sbi_tlb_async_wait(struct sbi_scratch *scratch)
+{
+	if (!sbi_tlb_sync_ptr(scratch)->async_gen)
+		return;
+
+	sbi_tlb_sync(scratch);
+	sbi_tlb_async_complete(scratch);
 }
 
-static void sbi_tlb_process(struct sbi_scratch *scratch)
+struct sbi_tlb_update_ctx {
+	/* New flush request */
+	struct sbi_tlb_info *next;
+	/* Total size of compatible flush requests already queued */
+	unsigned long queued;
+	/* Merge dependencies of the source HART */
+	struct sbi_tlb_deps *deps;
+};
+
+/* Number of bytes the range would cost if flushed one page at a time */
+static inline unsigned long __sbi_tlb_range_cost(struct sbi_tlb_info *tinfo)
 {
-	struct sbi_tlb_info tinfo;
-	struct sbi_fifo *tlb_fifo =
-			sbi_scratch_offset_ptr(scratch, tlb_fifo_off);
+	return (tinfo->size / tinfo->stride) << PAGE_SHIFT;
+}
 
-	while (!sbi_fifo_dequeue(tlb_fifo, &tinfo))
-		sbi_tlb_entry_process(&tinfo);
+static inline void __sbi_tlb_range_set_all(struct sbi_tlb_info *tinfo)
+{
+	tinfo->start = 0;
+	tinfo->size = SBI_TLB_FLUSH_ALL;
 }
 
-static void sbi_tlb_sync(struct sbi_scratch *scratch)
+static inline void __sbi_tlb_merge_source(struct sbi_tlb_update_ctx *ctx,
+					  struct sbi_tlb_info *curr)
 {
-	unsigned long *tlb_sync =
-			sbi_scratch_offset_ptr(scratch, tlb_sync_off);
+	struct sbi_tlb_deps *deps = ctx->deps;
 
-	while (!atomic_raw_xchg_ulong(tlb_sync, 0)) {
-		/*
-		 * While we are waiting for remote hart to set the sync,
-		 * consume fifo requests to avoid deadlock.
-		 */
-		sbi_tlb_process_count(scratch, 1);
-	}
+	/*
+	 * The remote HART will only signal completion to the source HART
+	 * of current entry so wait for the request of that source HART.
+	 */
+	if (curr->src_hartid == ctx->next->src_hartid)
+		return;
 
-	return;
+	deps->dep[deps->count].hartid = curr->src_hartid;
+	deps->dep[deps->count].gen = curr->src_gen;
+	deps->count++;
 }
 
-static inline int __sbi_tlb_range_check(struct sbi_tlb_info *curr,
-					struct sbi_tlb_info *next)
+static inline int __sbi_tlb_range_check(struct sbi_tlb_update_ctx *ctx,
+					struct sbi_tlb_info *curr)
 {
-	unsigned long curr_end;
-	unsigned long next_end;
-	int ret = SBI_FIFO_UNCHANGED;
+	struct sbi_tlb_info *next = ctx->next;
+	unsigned long curr_end, next_end, new_start, new_end;
 
 	if (!curr || !next)
-		return ret;
+		return SBI_RING_UNCHANGED;
+
+	/*
+	 * A zero start and size is a global flush whereas a flush-all size
+	 * flushes the whole address space selected by ASID/VMID so a global
+	 * flush covers everything else.
+	 */
+	if (__sbi_tlb_range_is_global(curr))
+		goto skip;
+	if (__sbi_tlb_range_is_global(next)) {
+		curr->start = 0;
+		curr->size = 0;
+		goto update;
+	}
+	if (__sbi_tlb_range_is_all(curr))
+		goto skip;
+	if (__sbi_tlb_range_is_all(next)) {
+		__sbi_tlb_range_set_all(curr);
+		goto update;
+	}
 
 	next_end = next->start + next->size;
 	curr_end = curr->start + curr->size;
-	if (next->start <= curr->start && next_end > curr_end) {
-		curr->start = next->start;
-		curr->size  = next->size;
-		sbi_hartmask_or(&curr->smask, &curr->smask, &next->smask);
-		ret = SBI_FIFO_UPDATED;
-	} else if (next->start >= curr->start && next_end <= curr_end) {
-		sbi_hartmask_or(&curr->smask, &curr->smask, &next->smask);
-		ret = SBI_FIFO_SKIP;
+
+	/*
+	 * Merge overlapping or adjacent ranges. Ranges separated by
+	 * a gap of at most tlb_range_merge_gap are merged as well.
+	 */
+	if (curr_end < next->start &&
+	    tlb_range_merge_gap < (next->start - curr_end))
+		goto unchanged;
+	if (next_end < curr->start &&
+	    tlb_range_merge_gap < (curr->start - next_end))
+		goto unchanged;
+
+	new_start = MIN(curr->start, next->start);
+	new_end = MAX(curr_end, next_end);
+	if (new_start == curr->start && new_end == curr_end)
+		goto skip;
+
+	curr->start = new_start;
+	curr->size = new_end - new_start;
+	if (tlb_range_flush_limit < __sbi_tlb_range_cost(curr))
+		__sbi_tlb_range_set_all(curr);
+
+update:
+	__sbi_tlb_merge_source(ctx, curr);
+	return SBI_RING_UPDATED;
+
+skip:
+	__sbi_tlb_merge_source(ctx, curr);
+	return SBI_RING_SKIP;
+
+unchanged:
+	/*
+	 * If the queued ranges along with the next range are too big
+	 * then upgrade current entry to flush all and skip next entry.
+	 */
+	ctx->queued += __sbi_tlb_range_cost(curr);
+	if (tlb_range_flush_limit < (ctx->queued + __sbi_tlb_range_cost(next))) {
+		__sbi_tlb_range_set_all(curr);
+		__sbi_tlb_merge_source(ctx, curr);
+		return SBI_RING_SKIP;
 	}
 
-	return ret;
+	return SBI_RING_UNCHANGED;
 }
 
 /**
  * Call back to decide if an inplace fifo update is required or next entry can
- * can be skipped. Here are the different cases that are being handled.
+ * can be skipped. The entries are only merged when both entries use the same
+ * local flush function and the same ASID/VMID. Here are the different cases
+ * that are being handled.
  *
+ * Case0:
+ *	if next flush request is a FENCE.I and a FENCE.I is already queued,
+ *	skip the next entry (FENCE.I requests are global so Case1 applies).
  * Case1:
  *	if next flush request range lies within one of the existing entry, skip
  *	the next entry.
  * Case2:
- *	if flush request range in current fifo entry lies within next flush
- *	request, update the current entry.
+ *	if next flush request range overlaps, is adjacent or is within the merge
+ *	gap of current fifo entry, update the current entry with the union of
+ *	both ranges.
+ * Case3:
+ *	if the union of ranges or the total of all queued ranges exceeds the TLB
+ *	range flush limit, upgrade the current entry to flush all.
  *
  * Note:
  *	We can not issue a fifo reset anymore if a complete vma flush is requested.
  *	This is because we are queueing FENCE.I requests as well now.
- *	To ease up the pressure in enqueue/fifo sync path, try to dequeue 1 element
- *	before continuing the while loop. This method is preferred over wfi/ipi because
- *	of MMIO cost involved in later method.
+ *	If the fifo is still full, wait in WFI until the remote HART rings the
+ *	"space available" doorbell of the source HART.
  */
 static int sbi_tlb_update_cb(void *in, void *data)
 {
+	struct sbi_tlb_update_ctx *ctx;
 	struct sbi_tlb_info *curr;
-	struct sbi_tlb_info *next;
-	int ret = SBI_FIFO_UNCHANGED;
 
 	if (!in || !data)
-		return ret;
+		return SBI_RING_UNCHANGED;
 
 	curr = (struct sbi_tlb_info *)data;
-	next = (struct sbi_tlb_info *)in;
+	ctx = (struct sbi_tlb_update_ctx *)in;
+
+	if (!__sbi_tlb_same_context(curr, ctx->next))
+		return SBI_RING_UNCHANGED;
+
+	/* Merging into request of another HART needs a free dependency */
+	if (curr->src_hartid != ctx->next->src_hartid &&
+	    SBI_TLB_MAX_DEPS <= ctx->deps->count)
+		return SBI_RING_UNCHANGED;
+
+	return __sbi_tlb_range_check(ctx, curr);
+}
 
-	if (next->local_fn == sbi_tlb_local_sfence_vma_asid &&
-	    curr->local_fn == sbi_tlb_local_sfence_vma_asid) {
-		if (next->asid == curr->asid)
-			ret = __sbi_tlb_range_check(curr, next);
-	} else if (next->local_fn == sbi_tlb_local_sfence_vma &&
-		   curr->local_fn == sbi_tlb_local_sfence_vma) {
-		ret = __sbi_tlb_range_check(curr, next);
+/* Hand the other target HARTs of the cluster of a leader back to us */
+static void sbi_tlb_fwd_retry_cluster(struct sbi_tlb_fwd *fwd, u32 leader)
+{
+	u32 i, w, h;
+	unsigned long bits;
+
+	sbi_hartmask_sparse_for_each_word(w, &fwd->targets) {
+		bits = fwd->targets.bits[w];
+		for_each_set_bit(i, &bits, BITS_PER_LONG) {
+			h = w * BITS_PER_LONG + i;
+			if (h != leader &&
+			    tlb_hart_cluster[h] == tlb_hart_cluster[leader])
+				atomic_raw_set_bit(h, fwd->retry.bits);
+		}
 	}
+}
 
-	return ret;
+/*
+ * Select the request descriptor to queue on a remote HART. Returns NULL
+ * when the remote HART is reached through the leader of its cluster.
+ */
+static struct sbi_tlb_info *sbi_tlb_fwd_select(struct sbi_scratch *scratch,
+					       u32 remote_hartid,
+					       struct sbi_tlb_info *tinfo)
+{
+	struct sbi_tlb_fwd *fwd;
+
+	if (!tlb_fwd_off)
+		return tinfo;
+
+	fwd = sbi_tlb_fwd_ptr(scratch);
+	if (!fwd->active || tlb_hart_cluster[remote_hartid] ==
+			    tlb_hart_cluster[scratch->hartid])
+		return tinfo;
+
+	return (sbi_tlb_fwd_test(remote_hartid, &fwd->leaders)) ?
+		&fwd->desc : NULL;
 }
 
 static int sbi_tlb_update(struct sbi_scratch *scratch,
@@ -307,19 +1345,17 @@ static int sbi_tlb_update(struct sbi_scratch *scratch,
 			  u32 remote_hartid, void *data)
 {
 	int ret;
-	struct sbi_fifo *tlb_fifo_r;
+	struct sbi_ring *tlb_fifo_r;
+	struct sbi_tlb_mbox *tlb_mbox_r;
 	struct sbi_tlb_info *tinfo = data;
-	u32 curr_hartid = current_hartid();
-
-	/*
-	 * If address range to flush is too big then simply
-	 * upgrade it to flush all because we can only flush
-	 * 4KB at a time.
-	 */
-	if (tinfo->size > tlb_range_flush_limit) {
-		tinfo->start = 0;
-		tinfo->size = SBI_TLB_FLUSH_ALL;
-	}
+	struct sbi_tlb_sync *tlb_sync = sbi_tlb_sync_ptr(scratch);
+	struct sbi_tlb_update_ctx ctx = {
+		.next = tinfo,
+		.queued = 0,
+		.deps = sbi_scratch_offset_ptr(scratch, tlb_deps_off),
+	};
+	u32 curr_hartid = scratch->hartid;
+	bool waited = FALSE;
 
 	/*
 	 * If the request is to queue a tlb flush entry for itself
@@ -330,100 +1366,648 @@ static int sbi_tlb_update(struct sbi_scratch *scratch,
 		return -1;
 	}
 
+	tinfo = sbi_tlb_fwd_select(scratch, remote_hartid, tinfo);
+	if (!tinfo)
+		return -1;
+
+	/* Defer the flush of a suspended HART to its resume */
+	if (sbi_tlb_lazy_mark_dirty(remote_scratch)) {
+		/* A suspended leader does not forward the request */
+		if (tinfo != data)
+			sbi_tlb_fwd_retry_cluster(sbi_tlb_fwd_ptr(scratch),
+						  remote_hartid);
+		return -1;
+	}
+
+	/*
+	 * Account the request before the remote HART can see it. Queueing
+	 * below is fully ordered so the increment itself can be relaxed.
+	 */
+	atomic_add_return_relaxed(&tlb_sync->pending, 1);
+
+	if (tlb_use_mbox) {
+		/*
+		 * Lock-free mailbox does not support in-place updates
+		 * so we always enqueue a new entry. The entry points to
+		 * the request descriptor set up by __sbi_tlb_request().
+		 */
+		tlb_mbox_r = sbi_scratch_offset_ptr(remote_scratch,
+						    tlb_mbox_off);
+		while (sbi_tlb_mbox_enqueue(tlb_mbox_r, tinfo) < 0) {
+			sbi_trace(SBI_TRACE_FIFO_FULL, remote_hartid, 0);
+			sbi_tlb_space_wait(scratch, remote_scratch,
+					   curr_hartid, remote_hartid);
+			waited = TRUE;
+		}
+		goto done;
+	}
+
 	tlb_fifo_r = sbi_scratch_offset_ptr(remote_scratch, tlb_fifo_off);
 
-	ret = sbi_fifo_inplace_update(tlb_fifo_r, data, sbi_tlb_update_cb);
-	if (ret != SBI_FIFO_UNCHANGED) {
+	/*
+	 * A request to forward must not be merged into another entry and
+	 * neither is an asynchronous request, its completion would depend
+	 * on the requests of other HARTs.
+	 */
+	ret = (tinfo == data && !tlb_sync->async_req) ?
+	      sbi_ring_update(tlb_fifo_r, &ctx, sbi_tlb_update_cb) :
+	      SBI_RING_UNCHANGED;
+	if (ret != SBI_RING_UNCHANGED) {
+		/* Request merged into existing entry so nothing to account */
+		atomic_sub_return_relaxed(&tlb_sync->pending, 1);
 		return 1;
 	}
 
-	while (sbi_fifo_enqueue(tlb_fifo_r, data) < 0) {
-		/**
-		 * For now, Busy loop until there is space in the fifo.
-		 * There may be case where target hart is also
-		 * enqueue in source hart's fifo. Both hart may busy
-		 * loop leading to a deadlock.
-		 * TODO: Introduce a wait/wakeup event mechanism to handle
-		 * this properly.
-		 */
-		sbi_tlb_process_count(scratch, 1);
-		sbi_dprintf("hart%d: hart%d tlb fifo full\n",
-			    curr_hartid, remote_hartid);
+	while (sbi_ring_enqueue(tlb_fifo_r, tinfo) < 0) {
+		sbi_trace(SBI_TRACE_FIFO_FULL, remote_hartid, 0);
+		sbi_tlb_space_wait(scratch, remote_scratch,
+				   curr_hartid, remote_hartid);
+		waited = TRUE;
 	}
 
+done:
+	/* Re-raise IPI of current HART which was cleared while waiting */
+	if (waited)
+		sbi_ipi_raw_send(curr_hartid);
+
 	return 0;
 }
 
 static struct sbi_ipi_event_ops tlb_ops = {
 	.name = "IPI_TLB",
+	.priority = SBI_IPI_EVENT_PRIO_NORMAL,
+	.deferred = TRUE,
 	.update = sbi_tlb_update,
-	.sync = sbi_tlb_sync,
+	.sync = sbi_tlb_sync_event,
 	.process = sbi_tlb_process,
 };
 
-static u32 tlb_event = SBI_IPI_EVENT_MAX;
+/*
+ * Collect the target HARTs of remote clusters, the first one of each
+ * cluster being its leader. Returns TRUE if any target HART is reached
+ * through a leader.
+ */
+static bool sbi_tlb_fwd_collect(struct sbi_scratch *scratch,
+				struct sbi_tlb_fwd *fwd, ulong hbase, ulong m,
+				unsigned long *seen)
+{
+	u8 cluster;
+	bool ret = FALSE;
+
+	for (; m; hbase++, m >>= 1) {
+		if (!(m & 1UL) || hbase == scratch->hartid ||
+		    SBI_HARTMASK_MAX_BITS <= hbase)
+			continue;
+		cluster = tlb_hart_cluster[hbase];
+		if (cluster == tlb_hart_cluster[scratch->hartid])
+			continue;
+
+		sbi_hartmask_sparse_set_hart(hbase, &fwd->targets);
+		if (*seen & BIT(cluster)) {
+			ret = TRUE;
+		} else {
+			*seen |= BIT(cluster);
+			sbi_hartmask_sparse_set_hart(hbase, &fwd->leaders);
+		}
+	}
+
+	return ret;
+}
+
+/* Set up delivery of the request through the leaders of remote clusters */
+static bool sbi_tlb_fwd_prepare(struct sbi_scratch *scratch,
+				ulong hmask, ulong hbase,
+				struct sbi_tlb_info *tinfo)
+{
+	ulong m;
+	bool ret = FALSE;
+	unsigned long seen = 0;
+	struct sbi_domain *dom = sbi_domain_thishart_ptr();
+	struct sbi_tlb_fwd *fwd = sbi_tlb_fwd_ptr(scratch);
+
+	SBI_HARTMASK_SPARSE_INIT(&fwd->targets);
+	SBI_HARTMASK_SPARSE_INIT(&fwd->leaders);
+
+	/* Same walk over the HARTs as sbi_ipi_send_many() */
+	if (hbase != -1UL) {
+		if (!sbi_hsm_hart_interruptible_mask(dom, hbase, &m))
+			ret = sbi_tlb_fwd_collect(scratch, fwd, hbase,
+						  m & hmask, &seen);
+	} else {
+		hbase = 0;
+		while (!sbi_hsm_hart_interruptible_mask(dom, hbase, &m)) {
+			if (sbi_tlb_fwd_collect(scratch, fwd, hbase, m, &seen))
+				ret = TRUE;
+			hbase += BITS_PER_LONG;
+		}
+	}
+	if (!ret)
+		return FALSE;
 
-int sbi_tlb_request(ulong hmask, ulong hbase, struct sbi_tlb_info *tinfo)
+	sbi_memcpy(&fwd->desc, tinfo, sizeof(fwd->desc));
+	fwd->desc.flags = SBI_TLB_INFO_FORWARD;
+	fwd->active = TRUE;
+
+	return TRUE;
+}
+
+/*
+ * Send the request directly to the target HARTs which their leader did
+ * not reach. The leaders are done so the retry mask is stable.
+ */
+static int sbi_tlb_fwd_finish(struct sbi_scratch *scratch,
+			      struct sbi_tlb_info *tinfo)
+{
+	int rc;
+	u32 w;
+	unsigned long m;
+	struct sbi_tlb_fwd *fwd = sbi_tlb_fwd_ptr(scratch);
+
+	fwd->active = FALSE;
+	smp_rmb();
+
+	for (w = 0; w < array_size(fwd->retry.bits); w++) {
+		if (!fwd->retry.bits[w])
+			continue;
+		m = atomic_raw_xchg_ulong(&fwd->retry.bits[w], 0);
+		rc = sbi_ipi_send_many(m, w * BITS_PER_LONG, tlb_event, tinfo);
+		if (rc)
+			return rc;
+	}
+
+	return 0;
+}
+
+static int __sbi_tlb_request(struct sbi_scratch *scratch,
+			     ulong hmask, ulong hbase,
+			     struct sbi_tlb_info *tinfo)
+{
+	int rc;
+	bool fwd = FALSE;
+	/* Only the current HART updates generation of its requests */
+	struct sbi_tlb_sync *tlb_sync = sbi_tlb_sync_ptr(scratch);
+	struct sbi_tlb_info *desc;
+
+	sbi_tlb_async_wait(scratch);
+
+	/*
+	 * If address range to flush is too big then simply
+	 * upgrade it to flush all because we can only flush
+	 * one page of the given stride at a time.
+	 */
+	if (!__sbi_tlb_range_is_all(tinfo) &&
+	    __sbi_tlb_range_cost(tinfo) > tlb_range_flush_limit) {
+		tinfo->start = 0;
+		tinfo->size = SBI_TLB_FLUSH_ALL;
+	}
+
+	/* Zero generation means no outstanding asynchronous request */
+	tlb_sync->gen++;
+	if (!tlb_sync->gen)
+		tlb_sync->gen++;
+	tinfo->src_gen = tlb_sync->gen;
+
+	/*
+	 * Mailbox entries share one descriptor. The previous request is
+	 * complete on all target HARTs (see sbi_tlb_sync()) so the
+	 * descriptor is free to be rewritten.
+	 */
+	if (tlb_use_mbox) {
+		desc = sbi_scratch_offset_ptr(scratch, tlb_desc_off);
+		sbi_memcpy(desc, tinfo, sizeof(*desc));
+		tinfo = desc;
+	}
+
+	if (tlb_fwd_off)
+		fwd = sbi_tlb_fwd_prepare(scratch, hmask, hbase, tinfo);
+
+	rc = sbi_ipi_send_many(hmask, hbase, tlb_event, tinfo);
+	if (fwd && !rc)
+		rc = sbi_tlb_fwd_finish(scratch, tinfo);
+	else if (fwd)
+		sbi_tlb_fwd_ptr(scratch)->active = FALSE;
+
+	return rc;
+}
+
+/*
+ * Combine next into curr if both flush the same context. Used to merge the
+ * requests of one call so that only one IPI is sent per target HART.
+ */
+static bool sbi_tlb_batch_merge(struct sbi_tlb_info *curr,
+				struct sbi_tlb_info *next)
+{
+	unsigned long new_start, new_end;
+
+	if (!__sbi_tlb_same_context(curr, next))
+		return FALSE;
+
+	if (__sbi_tlb_range_is_global(curr))
+		return TRUE;
+	if (__sbi_tlb_range_is_global(next)) {
+		curr->start = 0;
+		curr->size = 0;
+		return TRUE;
+	}
+	if (__sbi_tlb_range_is_all(curr))
+		return TRUE;
+	if (__sbi_tlb_range_is_all(next)) {
+		__sbi_tlb_range_set_all(curr);
+		return TRUE;
+	}
+
+	/* Combine into the smallest range covering both ranges */
+	new_start = MIN(curr->start, next->start);
+	new_end = MAX(curr->start + curr->size, next->start + next->size);
+	curr->start = new_start;
+	curr->size = new_end - new_start;
+	if (tlb_range_flush_limit < __sbi_tlb_range_cost(curr))
+		__sbi_tlb_range_set_all(curr);
+
+	return TRUE;
+}
+
+static u32 sbi_tlb_pmu_fw_event(struct sbi_tlb_info *tinfo)
+{
+	if (tinfo->local_fn == sbi_tlb_local_fence_i)
+		return SBI_PMU_FW_FENCE_I_SENT;
+	if (tinfo->local_fn == sbi_tlb_local_sfence_vma)
+		return SBI_PMU_FW_SFENCE_VMA_SENT;
+	if (tinfo->local_fn == sbi_tlb_local_sfence_vma_asid)
+		return SBI_PMU_FW_SFENCE_VMA_ASID_SENT;
+	if (tinfo->local_fn == sbi_tlb_local_hfence_gvma)
+		return SBI_PMU_FW_HFENCE_GVMA_SENT;
+	if (tinfo->local_fn == sbi_tlb_local_hfence_gvma_vmid)
+		return SBI_PMU_FW_HFENCE_GVMA_VMID_SENT;
+	if (tinfo->local_fn == sbi_tlb_local_hfence_vvma)
+		return SBI_PMU_FW_HFENCE_VVMA_SENT;
+	if (tinfo->local_fn == sbi_tlb_local_hfence_vvma_asid)
+		return SBI_PMU_FW_HFENCE_VVMA_ASID_SENT;
+
+	return SBI_PMU_FW_MAX;
+}
+
+int __hot sbi_tlb_request(ulong hmask, ulong hbase, struct sbi_tlb_info *tinfo)
 {
 	if (!tinfo->local_fn)
 		return SBI_EINVAL;
 
-	return sbi_ipi_send_many(hmask, hbase, tlb_event, tinfo);
+	sbi_pmu_ctr_incr_fw(sbi_tlb_pmu_fw_event(tinfo));
+
+	return __sbi_tlb_request(sbi_scratch_thishart_ptr(), hmask, hbase,
+				 tinfo);
+}
+
+int sbi_tlb_request_async(ulong hmask, ulong hbase,
+			  struct sbi_tlb_info *tinfo, unsigned long *seq)
+{
+	int ret;
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	struct sbi_tlb_sync *tlb_sync = sbi_tlb_sync_ptr(scratch);
+
+	if (!tinfo->local_fn)
+		return SBI_EINVAL;
+	if (!tlb_sync->async_addr && !tlb_sync->async_ssip)
+		return SBI_EDENIED;
+
+	sbi_pmu_ctr_incr_fw(sbi_tlb_pmu_fw_event(tinfo));
+
+	tlb_sync->async_req = TRUE;
+	ret = __sbi_tlb_request(scratch, hmask, hbase, tinfo);
+	tlb_sync->async_req = FALSE;
+	if (ret) {
+		/* Part of the request may be queued so complete it here */
+		sbi_tlb_sync(scratch);
+		return ret;
+	}
+
+	/*
+	 * Target HARTs may have completed the request before async_gen
+	 * is set in which case the current HART signals completion.
+	 */
+	*seq = tlb_sync->gen;
+	tlb_sync->async_gen = tlb_sync->gen;
+	smp_mb();
+	if (!atomic_read(&tlb_sync->pending))
+		sbi_tlb_async_complete(scratch);
+
+	return 0;
+}
+
+int sbi_tlb_async_set(unsigned long addr, bool ssip)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	struct sbi_tlb_sync *tlb_sync = sbi_tlb_sync_ptr(scratch);
+
+	/* Completion of the outstanding request goes to the old settings */
+	sbi_tlb_async_wait(scratch);
+
+	tlb_sync->async_addr = addr;
+	tlb_sync->async_ssip = ssip;
+
+	return 0;
+}
+
+int sbi_tlb_request_many(ulong hmask, ulong hbase,
+			 struct sbi_tlb_info *tinfo, u32 count)
+{
+	int ret;
+	u32 i, j, kept = 0;
+
+	/* Fences of different address spaces may complete in any order */
+	for (i = 0; i < count; i++) {
+		if (!tinfo[i].local_fn)
+			return SBI_EINVAL;
+		for (j = 0; j < kept; j++) {
+			if (sbi_tlb_batch_merge(&tinfo[j], &tinfo[i]))
+				break;
+		}
+		if (j == kept && kept != i)
+			sbi_memcpy(&tinfo[kept], &tinfo[i], sizeof(*tinfo));
+		if (j == kept)
+			kept++;
+	}
+
+	for (i = 0; i < kept; i++) {
+		ret = sbi_tlb_request(hmask, hbase, &tinfo[i]);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+struct sbi_tlb_shmem {
+	unsigned long addr;
+	unsigned long count;
+};
+
+int sbi_tlb_shmem_set(unsigned long addr, unsigned long count)
+{
+	struct sbi_tlb_shmem *shmem;
+
+	if (!tlb_shmem_off)
+		return SBI_ENOTSUPP;
+
+	shmem = sbi_scratch_thishart_offset_ptr(tlb_shmem_off);
+	shmem->addr = (count) ? addr : 0;
+	shmem->count = count;
+
+	return 0;
+}
+
+struct sbi_rfence_desc *sbi_tlb_shmem_get(unsigned long *count)
+{
+	struct sbi_tlb_shmem *shmem;
+
+	if (!tlb_shmem_off)
+		return NULL;
+
+	shmem = sbi_scratch_thishart_offset_ptr(tlb_shmem_off);
+	if (count)
+		*count = shmem->count;
+
+	return (struct sbi_rfence_desc *)shmem->addr;
+}
+
+/* Find the range size from which a full flush is faster on this HART */
+static unsigned long sbi_tlb_calibrate_limit(void)
+{
+	unsigned long i, t, t_all = -1UL, t_pages = -1UL, pages;
+
+	for (i = 0; i < SBI_TLB_CALIBRATE_ROUNDS; i++) {
+		t = csr_read(CSR_MCYCLE);
+		sbi_tlb_flush_all();
+		t = csr_read(CSR_MCYCLE) - t;
+		t_all = MIN(t_all, t);
+
+		t = csr_read(CSR_MCYCLE);
+		sbi_tlb_flush_range(sfence_vma, 0,
+				    SBI_TLB_CALIBRATE_PAGES << PAGE_SHIFT,
+				    PAGE_SIZE);
+		t = csr_read(CSR_MCYCLE) - t;
+		t_pages = MIN(t_pages, t);
+	}
+
+	/* The cycle counter is not counting */
+	if (!t_pages)
+		return SBI_PLATFORM_TLB_RANGE_FLUSH_LIMIT_DEFAULT;
+
+	pages = (t_all * SBI_TLB_CALIBRATE_PAGES) / t_pages;
+	if (!pages)
+		pages = 1;
+	if (SBI_TLB_CALIBRATE_MAX_PAGES < pages)
+		pages = SBI_TLB_CALIBRATE_MAX_PAGES;
+
+	return pages << PAGE_SHIFT;
+}
+
+/*
+ * Number the clusters of the platform. Requests are forwarded only when
+ * the topology of all HARTs is known and there are several clusters.
+ */
+static void sbi_tlb_topology_init(const struct sbi_platform *plat)
+{
+	u32 i, j, hartid, id, count = 0;
+	u32 ids[SBI_TLB_MAX_CLUSTERS];
+
+	for (i = 0; i < sbi_platform_hart_count(plat); i++) {
+		hartid = sbi_platform_hart_index2id(plat, i);
+		id = sbi_platform_tlb_cluster(plat, hartid);
+		if (SBI_HARTMASK_MAX_BITS <= hartid || id == -1U)
+			return;
+
+		for (j = 0; j < count && ids[j] != id; j++)
+			;
+		if (j == count) {
+			if (count == SBI_TLB_MAX_CLUSTERS)
+				return;
+			ids[count++] = id;
+		}
+		tlb_hart_cluster[hartid] = j;
+	}
+
+	/* Without it requests are sent to every target HART directly */
+	if (count > 1)
+		tlb_fwd_off = sbi_scratch_alloc_remote_offset(
+					sizeof(struct sbi_tlb_fwd),
+					"IPI_TLB_FWD");
 }
 
 int sbi_tlb_init(struct sbi_scratch *scratch, bool cold_boot)
 {
 	int ret;
+	u32 i;
+	u64 flush_limit;
+	unsigned long *tlb_limit;
 	void *tlb_mem;
-	unsigned long *tlb_sync;
-	struct sbi_fifo *tlb_q;
+	struct sbi_tlb_sync *tlb_sync;
+	struct sbi_tlb_deps *tlb_deps;
+	const struct sbi_tlb_flush_ops **tlb_flush_ops;
+	struct sbi_ring *tlb_q;
+	struct sbi_tlb_mbox *tlb_mbox;
+	struct sbi_tlb_fwd *tlb_fwd;
 	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
 
 	if (cold_boot) {
-		tlb_sync_off = sbi_scratch_alloc_offset(sizeof(*tlb_sync),
-							"IPI_TLB_SYNC");
+		tlb_use_mbox = (scratch->options & SBI_SCRATCH_TLB_MAILBOX) ?
+				TRUE : FALSE;
+		tlb_fifo_num_entries = sbi_platform_tlb_fifo_num_entries(plat);
+		if (!tlb_fifo_num_entries || (u16)-1 < tlb_fifo_num_entries)
+			tlb_fifo_num_entries =
+				SBI_PLATFORM_TLB_FIFO_NUM_ENTRIES_DEFAULT;
+		/* The FIFO ring indexes entries with a mask */
+		tlb_fifo_num_entries = 1UL << log2roundup(tlb_fifo_num_entries);
+		tlb_sync_off = sbi_scratch_alloc_remote_offset(
+						sizeof(*tlb_sync),
+						"IPI_TLB_SYNC");
 		if (!tlb_sync_off)
 			return SBI_ENOMEM;
-		tlb_fifo_off = sbi_scratch_alloc_offset(sizeof(*tlb_q),
-							"IPI_TLB_FIFO");
-		if (!tlb_fifo_off) {
+		tlb_deps_off = sbi_scratch_alloc_offset(sizeof(*tlb_deps),
+							"IPI_TLB_DEPS");
+		if (!tlb_deps_off) {
 			sbi_scratch_free_offset(tlb_sync_off);
 			return SBI_ENOMEM;
 		}
-		tlb_fifo_mem_off = sbi_scratch_alloc_offset(
-				SBI_TLB_FIFO_NUM_ENTRIES * SBI_TLB_INFO_SIZE,
-				"IPI_TLB_FIFO_MEM");
-		if (!tlb_fifo_mem_off) {
-			sbi_scratch_free_offset(tlb_fifo_off);
+		tlb_flush_ops_off = sbi_scratch_alloc_offset(
+						sizeof(*tlb_flush_ops),
+						"TLB_FLUSH_OPS");
+		if (!tlb_flush_ops_off) {
+			sbi_scratch_free_offset(tlb_deps_off);
 			sbi_scratch_free_offset(tlb_sync_off);
 			return SBI_ENOMEM;
 		}
+		if (tlb_use_mbox) {
+			tlb_mbox_off = sbi_scratch_alloc_remote_offset(
+				sizeof(*tlb_mbox) + tlb_fifo_num_entries *
+				sizeof(struct sbi_tlb_mbox_slot),
+				"IPI_TLB_MBOX");
+			if (!tlb_mbox_off) {
+				sbi_scratch_free_offset(tlb_flush_ops_off);
+				sbi_scratch_free_offset(tlb_deps_off);
+				sbi_scratch_free_offset(tlb_sync_off);
+				return SBI_ENOMEM;
+			}
+			tlb_desc_off = sbi_scratch_alloc_remote_offset(
+							SBI_TLB_INFO_SIZE,
+							"IPI_TLB_DESC");
+			if (!tlb_desc_off) {
+				sbi_scratch_free_offset(tlb_mbox_off);
+				sbi_scratch_free_offset(tlb_flush_ops_off);
+				sbi_scratch_free_offset(tlb_deps_off);
+				sbi_scratch_free_offset(tlb_sync_off);
+				return SBI_ENOMEM;
+			}
+		} else {
+			tlb_fifo_off = sbi_scratch_alloc_remote_offset(
+							sizeof(*tlb_q),
+							"IPI_TLB_FIFO");
+			if (!tlb_fifo_off) {
+				sbi_scratch_free_offset(tlb_flush_ops_off);
+				sbi_scratch_free_offset(tlb_deps_off);
+				sbi_scratch_free_offset(tlb_sync_off);
+				return SBI_ENOMEM;
+			}
+			tlb_fifo_mem_off = sbi_scratch_alloc_offset(
+				tlb_fifo_num_entries * SBI_TLB_INFO_SIZE,
+				"IPI_TLB_FIFO_MEM");
+			if (!tlb_fifo_mem_off) {
+				sbi_scratch_free_offset(tlb_fifo_off);
+				sbi_scratch_free_offset(tlb_flush_ops_off);
+				sbi_scratch_free_offset(tlb_deps_off);
+				sbi_scratch_free_offset(tlb_sync_off);
+				return SBI_ENOMEM;
+			}
+		}
 		ret = sbi_ipi_event_create(&tlb_ops);
 		if (ret < 0) {
-			sbi_scratch_free_offset(tlb_fifo_mem_off);
-			sbi_scratch_free_offset(tlb_fifo_off);
+			if (tlb_use_mbox) {
+				sbi_scratch_free_offset(tlb_desc_off);
+				sbi_scratch_free_offset(tlb_mbox_off);
+			} else {
+				sbi_scratch_free_offset(tlb_fifo_mem_off);
+				sbi_scratch_free_offset(tlb_fifo_off);
+			}
+			sbi_scratch_free_offset(tlb_flush_ops_off);
+			sbi_scratch_free_offset(tlb_deps_off);
 			sbi_scratch_free_offset(tlb_sync_off);
 			return ret;
 		}
 		tlb_event = ret;
-		tlb_range_flush_limit = sbi_platform_tlbr_flush_limit(plat);
+		flush_limit = sbi_platform_tlbr_flush_limit(plat);
+		if (flush_limit == SBI_PLATFORM_TLB_RANGE_FLUSH_LIMIT_CALIBRATE) {
+			/*
+			 * Each HART upgrades ranges beyond its own limit so
+			 * the source HARTs only upgrade beyond the largest
+			 * limit possible.
+			 */
+			tlb_limit_off = sbi_scratch_alloc_offset(
+						sizeof(*tlb_limit),
+						"IPI_TLB_LIMIT");
+			flush_limit = (tlb_limit_off) ?
+				(u64)SBI_TLB_CALIBRATE_MAX_PAGES << PAGE_SHIFT :
+				SBI_PLATFORM_TLB_RANGE_FLUSH_LIMIT_DEFAULT;
+		}
+		tlb_range_flush_limit = flush_limit;
+		/* Without it only the RFENCE_BATCH extension is missing */
+		tlb_shmem_off = sbi_scratch_alloc_offset(
+					sizeof(struct sbi_tlb_shmem),
+					"IPI_TLB_SHMEM");
+		tlb_range_merge_gap = sbi_platform_tlbr_merge_gap(plat);
+		sbi_tlb_topology_init(plat);
 	} else {
-		if (!tlb_sync_off ||
-		    !tlb_fifo_off ||
-		    !tlb_fifo_mem_off)
+		if (!tlb_sync_off || !tlb_deps_off || !tlb_flush_ops_off)
+			return SBI_ENOMEM;
+		if (tlb_use_mbox && (!tlb_mbox_off || !tlb_desc_off))
+			return SBI_ENOMEM;
+		if (!tlb_use_mbox && (!tlb_fifo_off || !tlb_fifo_mem_off))
 			return SBI_ENOMEM;
 		if (SBI_IPI_EVENT_MAX <= tlb_event)
 			return SBI_ENOSPC;
 	}
 
-	tlb_sync = sbi_scratch_offset_ptr(scratch, tlb_sync_off);
-	tlb_q = sbi_scratch_offset_ptr(scratch, tlb_fifo_off);
-	tlb_mem = sbi_scratch_offset_ptr(scratch, tlb_fifo_mem_off);
+	tlb_sync = sbi_tlb_sync_ptr(scratch);
+	ATOMIC_INIT(&tlb_sync->pending, 0);
+	tlb_sync->gen = 0;
+	tlb_sync->done_gen = 0;
+	sbi_hartmask_clear_all(&tlb_sync->space_waiters);
+	ATOMIC_INIT(&tlb_sync->lazy, SBI_TLB_LAZY_NONE);
+	tlb_sync->async_gen = 0;
+	tlb_sync->async_addr = 0;
+	tlb_sync->async_ssip = FALSE;
+	tlb_sync->async_req = FALSE;
+
+	tlb_deps = sbi_scratch_offset_ptr(scratch, tlb_deps_off);
+	tlb_deps->count = 0;
+
+	tlb_flush_ops = sbi_scratch_offset_ptr(scratch, tlb_flush_ops_off);
+	*tlb_flush_ops = sbi_tlb_flush_ops_select(scratch);
+
+	if (tlb_limit_off) {
+		tlb_limit = sbi_scratch_offset_ptr(scratch, tlb_limit_off);
+		*tlb_limit = sbi_tlb_calibrate_limit();
+	}
+
+	/* A started HART has no RFENCE_BATCH shared memory */
+	sbi_tlb_shmem_set(0, 0);
 
-	*tlb_sync = 0;
+	if (tlb_fwd_off) {
+		tlb_fwd = sbi_tlb_fwd_ptr(scratch);
+		tlb_fwd->active = FALSE;
+		sbi_hartmask_clear_all(&tlb_fwd->retry);
+		for (i = 0; i < SBI_TLB_FWD_SLOTS; i++)
+			ATOMIC_INIT(&tlb_fwd->slots[i].pending, 0);
+	}
 
-	sbi_fifo_init(tlb_q, tlb_mem,
-		      SBI_TLB_FIFO_NUM_ENTRIES, SBI_TLB_INFO_SIZE);
+	if (tlb_use_mbox) {
+		tlb_mbox = sbi_scratch_offset_ptr(scratch, tlb_mbox_off);
+		sbi_tlb_mbox_init(tlb_mbox);
+	} else {
+		tlb_q = sbi_scratch_offset_ptr(scratch, tlb_fifo_off);
+		tlb_mem = sbi_scratch_offset_ptr(scratch, tlb_fifo_mem_off);
+		sbi_ring_init(tlb_q, tlb_mem,
+			      tlb_fifo_num_entries, SBI_TLB_INFO_SIZE);
+	}
 
 	return 0;
 }
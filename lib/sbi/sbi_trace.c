@@ -0,0 +1,161 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifdef SBI_TRACE
+
+#include <sbi/riscv_barrier.h>
+#include <sbi/sbi_console.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_ecall.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_platform.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_timer.h>
+#include <sbi/sbi_trace.h>
+#include <sbi/sbi_trap.h>
+
+unsigned long sbi_trace_mask;
+
+/*
+ * The buffer is naturally aligned so that a single domain memory region
+ * (and PMP entry) can make it readable for S-mode inside the firmware.
+ */
+static u8 trace_buf[SBI_TRACE_SIZE] __aligned(SBI_TRACE_SIZE);
+static struct sbi_trace_header *trace_hdr;
+
+static struct sbi_trace_ring *sbi_trace_ring(u32 hartindex)
+{
+	return (void *)trace_buf + trace_hdr->ring_offset +
+	       hartindex * trace_hdr->ring_size;
+}
+
+void __sbi_trace(u32 event, unsigned long arg0, unsigned long arg1)
+{
+	u64 head;
+	struct sbi_trace_ring *ring;
+	struct sbi_trace_record *rec;
+	u32 hartindex = sbi_current_hartindex();
+
+	if (!trace_hdr || trace_hdr->hart_count <= hartindex)
+		return;
+
+	ring = sbi_trace_ring(hartindex);
+	head = ring->head;
+	rec = (struct sbi_trace_record *)(ring + 1) +
+	      (head & (trace_hdr->record_count - 1));
+	rec->time = sbi_timer_value();
+	rec->event = event;
+	rec->arg0 = arg0;
+	rec->arg1 = arg1;
+
+	/* Publish the record before advancing head */
+	smp_wmb();
+	ring->head = head + 1;
+}
+
+int sbi_trace_get_buffer(unsigned long *addr, unsigned long *size)
+{
+	if (!trace_hdr)
+		return SBI_ENOTSUPP;
+
+	if (addr)
+		*addr = (unsigned long)trace_buf;
+	if (size)
+		*size = SBI_TRACE_SIZE;
+
+	return 0;
+}
+
+static int sbi_ecall_trace_probe(unsigned long extid, unsigned long *out_val)
+{
+	*out_val = (trace_hdr) ? 1 : 0;
+	return 0;
+}
+
+static int sbi_ecall_trace_handler(unsigned long extid, unsigned long funcid,
+				   const struct sbi_trap_regs *regs,
+				   unsigned long *out_val,
+				   struct sbi_trap_info *out_trap)
+{
+	int ret = 0;
+
+	if (!trace_hdr)
+		return SBI_ENOTSUPP;
+
+	switch (funcid) {
+	case SBI_EXT_TRACE_GET_BUFFER:
+		ret = sbi_trace_get_buffer(out_val, NULL);
+		break;
+	case SBI_EXT_TRACE_SET_MASK:
+		*out_val = sbi_trace_mask;
+		sbi_trace_mask = regs->a0 & ((1UL << SBI_TRACE_EVENT_MAX) - 1);
+		break;
+	default:
+		ret = SBI_ENOTSUPP;
+	};
+
+	return ret;
+}
+
+struct sbi_ecall_extension ecall_trace = {
+	.extid_start = SBI_EXT_TRACE,
+	.extid_end = SBI_EXT_TRACE,
+	.probe = sbi_ecall_trace_probe,
+	.handle = sbi_ecall_trace_handler,
+};
+
+int sbi_trace_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	int rc;
+	u32 i, hart_count, count;
+	unsigned long avail;
+	struct sbi_domain_memregion reg;
+	struct sbi_trace_header *hdr = (struct sbi_trace_header *)trace_buf;
+	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
+
+	if (!cold_boot)
+		return 0;
+
+	hart_count = sbi_platform_hart_count(plat);
+	if (!hart_count)
+		return SBI_EINVAL;
+
+	/* Largest power of two number of records per HART which fits */
+	avail = (SBI_TRACE_SIZE - sizeof(*hdr)) / hart_count;
+	if (avail < sizeof(struct sbi_trace_ring))
+		return SBI_ENOSPC;
+	avail = (avail - sizeof(struct sbi_trace_ring)) /
+		sizeof(struct sbi_trace_record);
+	for (count = 1; count * 2 <= avail; count *= 2)
+		;
+	if (count < 2)
+		return SBI_ENOSPC;
+
+	hdr->magic = SBI_TRACE_MAGIC;
+	hdr->version = SBI_TRACE_VERSION;
+	hdr->hart_count = hart_count;
+	hdr->record_count = count;
+	hdr->record_size = sizeof(struct sbi_trace_record);
+	hdr->ring_offset = sizeof(*hdr);
+	hdr->ring_size = sizeof(struct sbi_trace_ring) +
+			 count * sizeof(struct sbi_trace_record);
+
+	/* S-mode may read the buffer but only M-mode writes it */
+	sbi_domain_memregion_init((unsigned long)trace_buf, SBI_TRACE_SIZE,
+				  SBI_DOMAIN_MEMREGION_READABLE, &reg);
+	rc = sbi_domain_root_add_memregion(&reg);
+	if (rc)
+		return rc;
+
+	trace_hdr = hdr;
+	for (i = 0; i < hart_count; i++)
+		sbi_trace_ring(i)->hartid = sbi_platform_hart_index2id(plat, i);
+
+	return 0;
+}
+
+#endif
@@ -16,9 +16,15 @@
 #include <sbi/sbi_illegal_insn.h>
 #include <sbi/sbi_ipi.h>
 #include <sbi/sbi_misaligned_ldst.h>
+#include <sbi/sbi_pmp_swap.h>
+#include <sbi/sbi_pmu.h>
 #include <sbi/sbi_scratch.h>
+#include <sbi/sbi_stack_check.h>
+#include <sbi/sbi_sta.h>
 #include <sbi/sbi_timer.h>
 #include <sbi/sbi_trap.h>
+#include <sbi/sbi_trace.h>
+#include <sbi/sbi_trap_stats.h>
 
 static void __noreturn sbi_trap_error(const char *msg, int rc,
 				      ulong mcause, ulong mtval, ulong mtval2,
@@ -29,7 +35,7 @@ static void __noreturn sbi_trap_error(const char *msg, int rc,
 	sbi_printf("%s: hart%d: %s (error %d)\n", __func__, hartid, msg, rc);
 	sbi_printf("%s: hart%d: mcause=0x%" PRILX " mtval=0x%" PRILX "\n",
 		   __func__, hartid, mcause, mtval);
-	if (misa_extension('H')) {
+	if (sbi_hart_has_feature(sbi_scratch_thishart_ptr(), SBI_HART_HAS_H)) {
 		sbi_printf("%s: hart%d: mtval2=0x%" PRILX
 			   " mtinst=0x%" PRILX "\n",
 			   __func__, hartid, mtval2, mtinst);
@@ -80,8 +86,8 @@ static void __noreturn sbi_trap_error(const char *msg, int rc,
  *
  * @return 0 on success and negative error code on failure
  */
-int sbi_trap_redirect(struct sbi_trap_regs *regs,
-		      struct sbi_trap_info *trap)
+int __hot sbi_trap_redirect(struct sbi_trap_regs *regs,
+			    struct sbi_trap_info *trap)
 {
 	ulong hstatus, vsstatus, prev_mode;
 #if __riscv_xlen == 32
@@ -97,8 +103,12 @@ int sbi_trap_redirect(struct sbi_trap_regs *regs,
 	if (prev_mode != PRV_S && prev_mode != PRV_U)
 		return SBI_ENOTSUPP;
 
-	/* For certain exceptions from VS/VU-mode we redirect to VS-mode */
-	if (misa_extension('H') && prev_virt) {
+	/*
+	 * For certain exceptions from VS/VU-mode we redirect to VS-mode.
+	 * MPV is only set on HARTs with H extension so there is no need
+	 * to check misa here and below.
+	 */
+	if (prev_virt) {
 		switch (trap->cause) {
 		case CAUSE_FETCH_PAGE_FAULT:
 		case CAUSE_LOAD_PAGE_FAULT:
@@ -120,7 +130,7 @@ int sbi_trap_redirect(struct sbi_trap_regs *regs,
 #endif
 
 	/* Update HSTATUS for VS/VU-mode to HS-mode transition */
-	if (misa_extension('H') && prev_virt && !next_virt) {
+	if (prev_virt && !next_virt) {
 		/* Update HSTATUS SPVP and SPV bits */
 		hstatus = csr_read(CSR_HSTATUS);
 		hstatus &= ~HSTATUS_SPVP;
@@ -194,6 +204,168 @@ int sbi_trap_redirect(struct sbi_trap_regs *regs,
 	return 0;
 }
 
+static void __hot sbi_trap_info_read(ulong mcause, ulong *mtval, ulong *mtval2,
+				     ulong *mtinst)
+{
+	*mtval = csr_read(CSR_MTVAL);
+
+	/* Illegal instructions only need the instruction bits */
+	if (mcause == CAUSE_ILLEGAL_INSTRUCTION ||
+	    !sbi_hart_has_feature(sbi_scratch_thishart_ptr(), SBI_HART_HAS_H))
+		return;
+
+	*mtval2 = csr_read(CSR_MTVAL2);
+	*mtinst = csr_read(CSR_MTINST);
+}
+
+#define TRAP_CAUSE_IRQ		(1UL << (__riscv_xlen - 1))
+
+/*
+ * Exception codes fit in 12 bits. Some interrupt controllers (such as the
+ * Nuclei ECLIC) keep interrupt state in the bits above so only the code
+ * and the interrupt bit of mcause are used.
+ */
+#define TRAP_CAUSE_MASK		(TRAP_CAUSE_IRQ | 0xfffUL)
+
+static int __hot trap_timer_irq(struct sbi_trap_regs *regs,
+				struct sbi_trap_info *trap)
+{
+	sbi_timer_process();
+	return 0;
+}
+
+static int __hot trap_soft_irq(struct sbi_trap_regs *regs,
+			       struct sbi_trap_info *trap)
+{
+	sbi_ipi_process();
+	return 0;
+}
+
+static int __hot trap_illegal_insn(struct sbi_trap_regs *regs,
+				   struct sbi_trap_info *trap)
+{
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_ILLEGAL_INSN);
+	return sbi_illegal_insn_handler(trap->tval, regs);
+}
+
+#ifndef SBI_EMULATE_MISALIGNED_DISABLED
+static int __hot trap_misaligned_load(struct sbi_trap_regs *regs,
+				      struct sbi_trap_info *trap)
+{
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_MISALIGNED_LOAD);
+	return sbi_misaligned_load_handler(trap->tval, trap->tval2,
+					   trap->tinst, regs);
+}
+
+static int __hot trap_misaligned_store(struct sbi_trap_regs *regs,
+				       struct sbi_trap_info *trap)
+{
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_MISALIGNED_STORE);
+	return sbi_misaligned_store_handler(trap->tval, trap->tval2,
+					    trap->tinst, regs);
+}
+#endif
+
+static int __hot trap_ecall(struct sbi_trap_regs *regs,
+			    struct sbi_trap_info *trap)
+{
+	return sbi_ecall_handler(regs);
+}
+
+static int trap_access_fault(struct sbi_trap_regs *regs,
+			     struct sbi_trap_info *trap)
+{
+	if (trap->cause == CAUSE_LOAD_ACCESS)
+		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_ACCESS_LOAD);
+	else if (trap->cause == CAUSE_STORE_ACCESS)
+		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_ACCESS_STORE);
+
+	/* Retry after swapping in the region or redirect */
+	if (!sbi_pmp_swap_handler(regs, trap))
+		return 0;
+
+	return sbi_trap_redirect(regs, trap);
+}
+
+/*
+ * Handlers indexed by mcause. Interrupts without a handler are fatal
+ * and exceptions without a handler are redirected to S or U mode.
+ */
+static sbi_trap_handler_t trap_irq_handlers[SBI_TRAP_MAX_CAUSE] = {
+	[IRQ_M_SOFT] = trap_soft_irq,
+	[IRQ_M_TIMER] = trap_timer_irq,
+};
+
+/*
+ * Exceptions without handler which the trap vector redirects to S-mode
+ * by itself when they come from S-mode or U-mode outside of a guest.
+ * Page faults trap into M-mode on platforms which cannot delegate them
+ * and are among the most frequent traps, so they skip the trap frame
+ * and sbi_trap_handler(). Trap statistics and tracing would miss them,
+ * builds with either take the C path for all causes.
+ */
+#if defined(SBI_TRAP_STATS) || defined(SBI_TRACE)
+#define TRAP_FAST_REDIRECT		0UL
+#else
+#define TRAP_FAST_REDIRECT		((1UL << CAUSE_FETCH_PAGE_FAULT) | \
+					 (1UL << CAUSE_LOAD_PAGE_FAULT) | \
+					 (1UL << CAUSE_STORE_PAGE_FAULT))
+#endif
+
+unsigned long sbi_trap_fast_redirect = TRAP_FAST_REDIRECT;
+
+static sbi_trap_handler_t trap_exc_handlers[SBI_TRAP_MAX_CAUSE] = {
+	[CAUSE_ILLEGAL_INSTRUCTION] = trap_illegal_insn,
+#ifndef SBI_EMULATE_MISALIGNED_DISABLED
+	[CAUSE_MISALIGNED_LOAD] = trap_misaligned_load,
+	[CAUSE_MISALIGNED_STORE] = trap_misaligned_store,
+#endif
+	[CAUSE_SUPERVISOR_ECALL] = trap_ecall,
+	[CAUSE_MACHINE_ECALL] = trap_ecall,
+	[CAUSE_FETCH_ACCESS] = trap_access_fault,
+	[CAUSE_LOAD_ACCESS] = trap_access_fault,
+	[CAUSE_STORE_ACCESS] = trap_access_fault,
+};
+
+static const char *const trap_exc_msgs[SBI_TRAP_MAX_CAUSE] = {
+	[CAUSE_ILLEGAL_INSTRUCTION] = "illegal instruction handler failed",
+	[CAUSE_MISALIGNED_LOAD] = "misaligned load handler failed",
+	[CAUSE_MISALIGNED_STORE] = "misaligned store handler failed",
+	[CAUSE_SUPERVISOR_ECALL] = "ecall handler failed",
+	[CAUSE_MACHINE_ECALL] = "ecall handler failed",
+};
+
+static struct sbi_trap_regs *__hot trap_irq_dispatch(ulong irq,
+						     struct sbi_trap_regs *regs,
+						     ulong stats_start,
+						     u64 sta_start)
+{
+	int rc;
+	const char *msg = "interrupt handler failed";
+	sbi_trap_handler_t handler;
+	struct sbi_trap_info trap;
+
+	sbi_trace(SBI_TRACE_TRAP_ENTRY, irq | TRAP_CAUSE_IRQ, regs->mepc);
+	handler = (irq < SBI_TRAP_MAX_CAUSE) ? trap_irq_handlers[irq] : NULL;
+	if (handler) {
+		trap.epc = regs->mepc;
+		trap.cause = irq | TRAP_CAUSE_IRQ;
+		trap.tval = trap.tval2 = trap.tinst = 0;
+		rc = handler(regs, &trap);
+	} else {
+		msg = "unhandled external interrupt";
+		rc = SBI_ENOTSUPP;
+	}
+
+	if (rc)
+		sbi_trap_error(msg, rc, irq | TRAP_CAUSE_IRQ, 0, 0, 0, regs);
+	sbi_stack_check();
+	sbi_trap_stats_cause(irq | TRAP_CAUSE_IRQ, stats_start);
+	sbi_trace(SBI_TRACE_TRAP_EXIT, irq | TRAP_CAUSE_IRQ, regs->mepc);
+	sbi_sta_account(sta_start);
+	return regs;
+}
+
 /**
  * Handle trap/interrupt
  *
@@ -208,72 +380,110 @@ int sbi_trap_redirect(struct sbi_trap_regs *regs,
  * 6. Stack pointer (SP) is setup for current HART
  * 7. Interrupts are disabled in MSTATUS CSR
  *
+ * For interrupts and ecalls the firmware may only save the caller
+ * saved registers, so GP, TP and S0 to S11 in the register state are
+ * only valid (and restored) for other exceptions.
+ *
  * @param regs pointer to register state
  */
-struct sbi_trap_regs *sbi_trap_handler(struct sbi_trap_regs *regs)
+struct sbi_trap_regs *__hot sbi_trap_handler(struct sbi_trap_regs *regs)
 {
-	int rc = SBI_ENOTSUPP;
-	const char *msg = "trap handler failed";
-	ulong mcause = csr_read(CSR_MCAUSE);
-	ulong mtval = csr_read(CSR_MTVAL), mtval2 = 0, mtinst = 0;
+	int rc;
+	sbi_trap_handler_t handler;
+	ulong mcause = csr_read(CSR_MCAUSE) & TRAP_CAUSE_MASK;
+	ulong stats_start = sbi_trap_stats_start();
+	u64 sta_start = sbi_sta_start();
 	struct sbi_trap_info trap;
 
-	if (misa_extension('H')) {
-		mtval2 = csr_read(CSR_MTVAL2);
-		mtinst = csr_read(CSR_MTINST);
-	}
+	if (mcause & TRAP_CAUSE_IRQ)
+		return trap_irq_dispatch(mcause & ~TRAP_CAUSE_IRQ, regs,
+					 stats_start, sta_start);
 
-	if (mcause & (1UL << (__riscv_xlen - 1))) {
-		mcause &= ~(1UL << (__riscv_xlen - 1));
-		switch (mcause) {
-		case IRQ_M_TIMER:
-			sbi_timer_process();
-			break;
-		case IRQ_M_SOFT:
-			sbi_ipi_process();
-			break;
-		default:
-			msg = "unhandled external interrupt";
-			goto trap_error;
-		};
-		return regs;
-	}
+	sbi_trace(SBI_TRACE_TRAP_ENTRY, mcause, regs->mepc);
 
-	switch (mcause) {
-	case CAUSE_ILLEGAL_INSTRUCTION:
-		rc  = sbi_illegal_insn_handler(mtval, regs);
-		msg = "illegal instruction handler failed";
-		break;
-	case CAUSE_MISALIGNED_LOAD:
-		rc = sbi_misaligned_load_handler(mtval, mtval2, mtinst, regs);
-		msg = "misaligned load handler failed";
-		break;
-	case CAUSE_MISALIGNED_STORE:
-		rc  = sbi_misaligned_store_handler(mtval, mtval2, mtinst, regs);
-		msg = "misaligned store handler failed";
-		break;
-	case CAUSE_SUPERVISOR_ECALL:
-	case CAUSE_MACHINE_ECALL:
-		rc  = sbi_ecall_handler(regs);
-		msg = "ecall handler failed";
-		break;
-	default:
-		/* If the trap came from S or U mode, redirect it there */
-		trap.epc = regs->mepc;
-		trap.cause = mcause;
-		trap.tval = mtval;
-		trap.tval2 = mtval2;
-		trap.tinst = mtinst;
+	/*
+	 * Trap information CSRs are only read by the paths which consume
+	 * them. Ecalls don't, so their error dump shows zero.
+	 */
+	trap.epc = regs->mepc;
+	trap.cause = mcause;
+	trap.tval = trap.tval2 = trap.tinst = 0;
+	if (mcause != CAUSE_SUPERVISOR_ECALL && mcause != CAUSE_MACHINE_ECALL)
+		sbi_trap_info_read(mcause, &trap.tval, &trap.tval2,
+				   &trap.tinst);
+
+	/* If nobody handles the trap and it came from S or U mode, redirect */
+	handler = (mcause < SBI_TRAP_MAX_CAUSE) ? trap_exc_handlers[mcause] :
+						  NULL;
+	if (handler)
+		rc = handler(regs, &trap);
+	else
 		rc = sbi_trap_redirect(regs, &trap);
-		break;
-	};
 
-trap_error:
 	if (rc)
-		sbi_trap_error(msg, rc, mcause, mtval, mtval2, mtinst, regs);
+		sbi_trap_error((mcause < SBI_TRAP_MAX_CAUSE &&
+				trap_exc_msgs[mcause]) ?
+			       trap_exc_msgs[mcause] : "trap handler failed",
+			       rc, mcause, trap.tval, trap.tval2, trap.tinst,
+			       regs);
+	sbi_stack_check();
+	sbi_trap_stats_cause(mcause, stats_start);
+	sbi_trace(SBI_TRACE_TRAP_EXIT, mcause, regs->mepc);
+	sbi_sta_account(sta_start);
 	return regs;
 }
 
+/**
+ * Handle M-mode software interrupt
+ *
+ * This function is called by firmware using vectored trap mode so
+ * that IPIs do not need decoding of 'mcause' CSR. The expectations
+ * are the same as sbi_trap_handler().
+ *
+ * @param regs pointer to register state
+ */
+struct sbi_trap_regs *__hot sbi_trap_msoft_handler(struct sbi_trap_regs *regs)
+{
+	return trap_irq_dispatch(IRQ_M_SOFT, regs, sbi_trap_stats_start(),
+				 sbi_sta_start());
+}
+
+/**
+ * Handle M-mode timer interrupt
+ *
+ * Same as sbi_trap_msoft_handler() for timer interrupts.
+ *
+ * @param regs pointer to register state
+ */
+struct sbi_trap_regs *__hot sbi_trap_mtimer_handler(struct sbi_trap_regs *regs)
+{
+	return trap_irq_dispatch(IRQ_M_TIMER, regs, sbi_trap_stats_start(),
+				 sbi_sta_start());
+}
+
+int sbi_trap_set_handler(ulong mcause, sbi_trap_handler_t handler)
+{
+	ulong cause = mcause & ~TRAP_CAUSE_IRQ;
+
+	if (SBI_TRAP_MAX_CAUSE <= cause)
+		return SBI_EINVAL;
+
+	if (mcause & TRAP_CAUSE_IRQ) {
+		trap_irq_handlers[cause] = handler;
+		return 0;
+	}
+
+	trap_exc_handlers[cause] = handler;
+
+	/* The trap vector must never bypass a handler */
+	if (handler)
+		sbi_trap_fast_redirect &= ~(1UL << cause);
+	else
+		sbi_trap_fast_redirect |= TRAP_FAST_REDIRECT & (1UL << cause);
+
+	return 0;
+}
+
 typedef void (*trap_exit_t)(const struct sbi_trap_regs *regs);
 
 /**
@@ -285,7 +495,7 @@ typedef void (*trap_exit_t)(const struct sbi_trap_regs *regs);
  *
  * @param regs pointer to register state
  */
-void __noreturn sbi_trap_exit(const struct sbi_trap_regs *regs)
+void __noreturn __hot sbi_trap_exit(const struct sbi_trap_regs *regs)
 {
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
 
@@ -0,0 +1,463 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifdef SBI_TRAP_STATS
+
+#include <sbi/riscv_asm.h>
+#include <sbi/sbi_bitops.h>
+#include <sbi/sbi_console.h>
+#include <sbi/sbi_ecall.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hartmask.h>
+#include <sbi/sbi_ipi.h>
+#include <sbi/sbi_pmp_swap.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
+#include <sbi/sbi_trap.h>
+#include <sbi/sbi_trap_stats.h>
+
+struct sbi_trap_stats_entry {
+	unsigned long count;
+	u64 cycles;
+};
+
+struct sbi_trap_stats_hist {
+	u32 bucket[SBI_TRAP_STATS_HIST_BUCKETS];
+};
+
+struct sbi_trap_stats_ecall {
+	unsigned long extid;
+	unsigned long funcid;
+	struct sbi_trap_stats_entry entry;
+	struct sbi_trap_stats_hist hist;
+};
+
+struct sbi_trap_stats_csr {
+	unsigned long csr_num;
+	struct sbi_trap_stats_entry entry;
+};
+
+/*
+ * Per-HART trap statistics. These live in the scratch space of each
+ * HART so that accounting never touches cachelines of other HARTs.
+ * Ecalls and CSRs which don't fit in the tables are accounted in the
+ * catch-all "other" entries.
+ */
+struct sbi_trap_stats {
+	struct sbi_trap_stats_entry exception[SBI_TRAP_STATS_EXCEPTION_MAX];
+	struct sbi_trap_stats_entry interrupt[SBI_TRAP_STATS_INTERRUPT_MAX];
+	struct sbi_trap_stats_hist interrupt_hist[SBI_TRAP_STATS_INTERRUPT_MAX];
+	struct sbi_trap_stats_entry other_cause;
+	struct sbi_trap_stats_ecall ecall[SBI_TRAP_STATS_ECALL_MAX];
+	struct sbi_trap_stats_entry other_ecall;
+	struct sbi_trap_stats_csr csr[SBI_TRAP_STATS_CSR_MAX];
+	struct sbi_trap_stats_entry other_csr;
+	struct sbi_trap_stats_entry latency[SBI_TRAP_STATS_LATENCY_MAX];
+	struct sbi_trap_stats_hist latency_hist[SBI_TRAP_STATS_LATENCY_MAX];
+	unsigned long ecall_count;
+	unsigned long csr_count;
+};
+
+static unsigned long trap_stats_off;
+
+static struct sbi_trap_stats *sbi_trap_stats_thishart(void)
+{
+	if (!trap_stats_off)
+		return NULL;
+
+	return sbi_scratch_thishart_offset_ptr(trap_stats_off);
+}
+
+static struct sbi_trap_stats *sbi_trap_stats_hart(u32 hartid)
+{
+	struct sbi_scratch *scratch;
+
+	if (!trap_stats_off || SBI_HARTMASK_MAX_BITS <= hartid)
+		return NULL;
+	scratch = sbi_hartid_to_scratch(hartid);
+	if (!scratch)
+		return NULL;
+
+	return sbi_scratch_offset_ptr(scratch, trap_stats_off);
+}
+
+static void sbi_trap_stats_add(struct sbi_trap_stats_entry *entry,
+			       struct sbi_trap_stats_hist *hist,
+			       unsigned long value, unsigned int shift)
+{
+	unsigned long b;
+
+	entry->count++;
+	entry->cycles += value;
+
+	if (!hist)
+		return;
+	value >>= shift;
+	b = (value) ? __fls(value) + 1 : 0;
+	if (SBI_TRAP_STATS_HIST_BUCKETS <= b)
+		b = SBI_TRAP_STATS_HIST_BUCKETS - 1;
+	hist->bucket[b]++;
+}
+
+static void sbi_trap_stats_account(struct sbi_trap_stats_entry *entry,
+				   struct sbi_trap_stats_hist *hist,
+				   unsigned long start)
+{
+	sbi_trap_stats_add(entry, hist, csr_read(CSR_MCYCLE) - start,
+			   SBI_TRAP_STATS_HIST_SHIFT);
+}
+
+void sbi_trap_stats_cause(unsigned long mcause, unsigned long start)
+{
+	struct sbi_trap_stats *ts = sbi_trap_stats_thishart();
+	unsigned long cause = mcause & ~(1UL << (__riscv_xlen - 1));
+
+	if (!ts)
+		return;
+
+	if (mcause & (1UL << (__riscv_xlen - 1))) {
+		if (cause < SBI_TRAP_STATS_INTERRUPT_MAX)
+			sbi_trap_stats_account(&ts->interrupt[cause],
+					       &ts->interrupt_hist[cause], start);
+		else
+			sbi_trap_stats_account(&ts->other_cause, NULL, start);
+	} else {
+		if (cause < SBI_TRAP_STATS_EXCEPTION_MAX)
+			sbi_trap_stats_account(&ts->exception[cause], NULL,
+					       start);
+		else
+			sbi_trap_stats_account(&ts->other_cause, NULL, start);
+	}
+}
+
+void sbi_trap_stats_ecall(unsigned long extid, unsigned long funcid,
+			  unsigned long start)
+{
+	unsigned long i;
+	struct sbi_trap_stats_ecall *e;
+	struct sbi_trap_stats *ts = sbi_trap_stats_thishart();
+
+	if (!ts)
+		return;
+
+	for (i = 0; i < ts->ecall_count; i++) {
+		e = &ts->ecall[i];
+		if (e->extid == extid && e->funcid == funcid) {
+			sbi_trap_stats_account(&e->entry, &e->hist, start);
+			return;
+		}
+	}
+
+	if (ts->ecall_count < SBI_TRAP_STATS_ECALL_MAX) {
+		e = &ts->ecall[ts->ecall_count++];
+		e->extid = extid;
+		e->funcid = funcid;
+		sbi_trap_stats_account(&e->entry, &e->hist, start);
+		return;
+	}
+
+	sbi_trap_stats_account(&ts->other_ecall, NULL, start);
+}
+
+void sbi_trap_stats_csr(unsigned long csr_num, unsigned long start)
+{
+	unsigned long i;
+	struct sbi_trap_stats_csr *c;
+	struct sbi_trap_stats *ts = sbi_trap_stats_thishart();
+
+	if (!ts)
+		return;
+
+	for (i = 0; i < ts->csr_count; i++) {
+		c = &ts->csr[i];
+		if (c->csr_num == csr_num) {
+			sbi_trap_stats_account(&c->entry, NULL, start);
+			return;
+		}
+	}
+
+	if (ts->csr_count < SBI_TRAP_STATS_CSR_MAX) {
+		c = &ts->csr[ts->csr_count++];
+		c->csr_num = csr_num;
+		sbi_trap_stats_account(&c->entry, NULL, start);
+		return;
+	}
+
+	sbi_trap_stats_account(&ts->other_csr, NULL, start);
+}
+
+void sbi_trap_stats_latency(unsigned long id, u64 expected, u64 now)
+{
+	u64 delta;
+	struct sbi_trap_stats *ts = sbi_trap_stats_thishart();
+
+	if (!ts || SBI_TRAP_STATS_LATENCY_MAX <= id || now < expected)
+		return;
+
+	delta = now - expected;
+	sbi_trap_stats_add(&ts->latency[id], &ts->latency_hist[id],
+			   (delta < -1UL) ? delta : -1UL,
+			   SBI_TRAP_STATS_LATENCY_HIST_SHIFT);
+}
+
+static const struct sbi_trap_stats_entry *sbi_trap_stats_find(
+				const struct sbi_trap_stats *ts,
+				unsigned long class, unsigned long id,
+				unsigned long subid)
+{
+	unsigned long i;
+
+	switch (class) {
+	case SBI_TRAP_STATS_CLASS_EXCEPTION:
+		if (id < SBI_TRAP_STATS_EXCEPTION_MAX)
+			return &ts->exception[id];
+		break;
+	case SBI_TRAP_STATS_CLASS_INTERRUPT:
+		if (id < SBI_TRAP_STATS_INTERRUPT_MAX)
+			return &ts->interrupt[id];
+		break;
+	case SBI_TRAP_STATS_CLASS_ECALL:
+		for (i = 0; i < ts->ecall_count; i++) {
+			if (ts->ecall[i].extid == id &&
+			    ts->ecall[i].funcid == subid)
+				return &ts->ecall[i].entry;
+		}
+		break;
+	case SBI_TRAP_STATS_CLASS_CSR:
+		for (i = 0; i < ts->csr_count; i++) {
+			if (ts->csr[i].csr_num == id)
+				return &ts->csr[i].entry;
+		}
+		break;
+	case SBI_TRAP_STATS_CLASS_LATENCY:
+		if (id < SBI_TRAP_STATS_LATENCY_MAX)
+			return &ts->latency[id];
+		break;
+	default:
+		return NULL;
+	};
+
+	return NULL;
+}
+
+int sbi_trap_stats_get(u32 hartid, unsigned long class, unsigned long id,
+		       unsigned long subid, unsigned long *out_count,
+		       u64 *out_cycles)
+{
+	const struct sbi_trap_stats_entry *entry;
+	const struct sbi_trap_stats *ts = sbi_trap_stats_hart(hartid);
+
+	if (!ts)
+		return SBI_EINVAL;
+	if (SBI_TRAP_STATS_CLASS_LATENCY < class)
+		return SBI_EINVAL;
+
+	entry = sbi_trap_stats_find(ts, class, id, subid);
+	if (out_count)
+		*out_count = (entry) ? entry->count : 0;
+	if (out_cycles)
+		*out_cycles = (entry) ? entry->cycles : 0;
+
+	return 0;
+}
+
+static const struct sbi_trap_stats_hist *sbi_trap_stats_find_hist(
+				const struct sbi_trap_stats *ts,
+				unsigned long class, unsigned long id,
+				unsigned long subid)
+{
+	unsigned long i;
+
+	switch (class) {
+	case SBI_TRAP_STATS_CLASS_INTERRUPT:
+		if (id < SBI_TRAP_STATS_INTERRUPT_MAX)
+			return &ts->interrupt_hist[id];
+		break;
+	case SBI_TRAP_STATS_CLASS_ECALL:
+		for (i = 0; i < ts->ecall_count; i++) {
+			if (ts->ecall[i].extid == id &&
+			    ts->ecall[i].funcid == subid)
+				return &ts->ecall[i].hist;
+		}
+		break;
+	case SBI_TRAP_STATS_CLASS_LATENCY:
+		if (id < SBI_TRAP_STATS_LATENCY_MAX)
+			return &ts->latency_hist[id];
+		break;
+	default:
+		return NULL;
+	};
+
+	return NULL;
+}
+
+int sbi_trap_stats_get_hist(u32 hartid, unsigned long class,
+			    unsigned long id, unsigned long subid,
+			    unsigned long bucket, unsigned long *out_count)
+{
+	const struct sbi_trap_stats_hist *hist;
+	const struct sbi_trap_stats *ts = sbi_trap_stats_hart(hartid);
+
+	if (!ts)
+		return SBI_EINVAL;
+	if (class != SBI_TRAP_STATS_CLASS_INTERRUPT &&
+	    class != SBI_TRAP_STATS_CLASS_ECALL &&
+	    class != SBI_TRAP_STATS_CLASS_LATENCY)
+		return SBI_EINVAL;
+	if (SBI_TRAP_STATS_HIST_BUCKETS <= bucket)
+		return SBI_EINVAL;
+
+	hist = sbi_trap_stats_find_hist(ts, class, id, subid);
+	if (out_count)
+		*out_count = (hist) ? hist->bucket[bucket] : 0;
+
+	return 0;
+}
+
+void sbi_trap_stats_reset(void)
+{
+	u32 i;
+	struct sbi_trap_stats *ts;
+
+	for (i = 0; i <= sbi_scratch_last_hartid(); i++) {
+		ts = sbi_trap_stats_hart(i);
+		if (ts)
+			sbi_memset(ts, 0, sizeof(*ts));
+	}
+}
+
+static void sbi_trap_stats_print(u32 hartid, const char *what,
+				 unsigned long id, unsigned long subid,
+				 const struct sbi_trap_stats_entry *entry)
+{
+	if (!entry->count)
+		return;
+
+	sbi_printf("HART%u: %-9s 0x%08lx 0x%08lx count %lu cycles %llu\n",
+		   hartid, what, id, subid, entry->count,
+		   (unsigned long long)entry->cycles);
+}
+
+static void sbi_trap_stats_print_hist(const struct sbi_trap_stats_entry *entry,
+				      const struct sbi_trap_stats_hist *hist,
+				      const char *unit, unsigned int shift)
+{
+	u32 i;
+
+	if (!entry->count)
+		return;
+
+	sbi_printf("      %s <2^%u:", unit, shift);
+	for (i = 0; i < SBI_TRAP_STATS_HIST_BUCKETS; i++)
+		sbi_printf(" %u", hist->bucket[i]);
+	sbi_printf(" :>=2^%u\n", shift + SBI_TRAP_STATS_HIST_BUCKETS - 2);
+}
+
+void sbi_trap_stats_dump(void)
+{
+	u32 i, j;
+	struct sbi_trap_stats *ts;
+
+	for (i = 0; i <= sbi_scratch_last_hartid(); i++) {
+		ts = sbi_trap_stats_hart(i);
+		if (!ts)
+			continue;
+
+		for (j = 0; j < SBI_TRAP_STATS_EXCEPTION_MAX; j++)
+			sbi_trap_stats_print(i, "exception", j, 0,
+					     &ts->exception[j]);
+		for (j = 0; j < SBI_TRAP_STATS_INTERRUPT_MAX; j++) {
+			sbi_trap_stats_print(i, "interrupt", j, 0,
+					     &ts->interrupt[j]);
+			sbi_trap_stats_print_hist(&ts->interrupt[j],
+						  &ts->interrupt_hist[j],
+						  "cycles",
+						  SBI_TRAP_STATS_HIST_SHIFT);
+		}
+		sbi_trap_stats_print(i, "cause", -1UL, 0, &ts->other_cause);
+		for (j = 0; j < ts->ecall_count; j++) {
+			sbi_trap_stats_print(i, "ecall", ts->ecall[j].extid,
+					     ts->ecall[j].funcid,
+					     &ts->ecall[j].entry);
+			sbi_trap_stats_print_hist(&ts->ecall[j].entry,
+						  &ts->ecall[j].hist, "cycles",
+						  SBI_TRAP_STATS_HIST_SHIFT);
+		}
+		sbi_trap_stats_print(i, "ecall", -1UL, -1UL, &ts->other_ecall);
+		for (j = 0; j < ts->csr_count; j++)
+			sbi_trap_stats_print(i, "csr", ts->csr[j].csr_num, 0,
+					     &ts->csr[j].entry);
+		sbi_trap_stats_print(i, "csr", -1UL, 0, &ts->other_csr);
+		for (j = 0; j < SBI_TRAP_STATS_LATENCY_MAX; j++) {
+			sbi_trap_stats_print(i, "latency", j, 0,
+					     &ts->latency[j]);
+			sbi_trap_stats_print_hist(&ts->latency[j],
+					&ts->latency_hist[j], "ticks",
+					SBI_TRAP_STATS_LATENCY_HIST_SHIFT);
+		}
+	}
+
+	sbi_pmp_swap_dump();
+	sbi_ipi_rate_dump();
+}
+
+static int sbi_ecall_trap_stats_handler(unsigned long extid,
+					unsigned long funcid,
+					const struct sbi_trap_regs *regs,
+					unsigned long *out_val,
+					struct sbi_trap_info *out_trap)
+{
+	int ret = 0;
+	u64 cycles;
+
+	switch (funcid) {
+	case SBI_EXT_TRAP_STATS_DUMP:
+		sbi_trap_stats_dump();
+		break;
+	case SBI_EXT_TRAP_STATS_RESET:
+		sbi_trap_stats_reset();
+		break;
+	case SBI_EXT_TRAP_STATS_GET_COUNT:
+		ret = sbi_trap_stats_get(regs->a0, regs->a1, regs->a2,
+					 regs->a3, out_val, NULL);
+		break;
+	case SBI_EXT_TRAP_STATS_GET_CYCLES:
+		ret = sbi_trap_stats_get(regs->a0, regs->a1, regs->a2,
+					 regs->a3, NULL, &cycles);
+		*out_val = (unsigned long)cycles;
+		break;
+	case SBI_EXT_TRAP_STATS_GET_HIST:
+		ret = sbi_trap_stats_get_hist(regs->a0, regs->a1, regs->a2,
+					      regs->a3, regs->a4, out_val);
+		break;
+	default:
+		ret = SBI_ENOTSUPP;
+	};
+
+	return ret;
+}
+
+struct sbi_ecall_extension ecall_trap_stats = {
+	.extid_start = SBI_EXT_TRAP_STATS,
+	.extid_end = SBI_EXT_TRAP_STATS,
+	.handle = sbi_ecall_trap_stats_handler,
+};
+
+int sbi_trap_stats_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	if (!cold_boot)
+		return 0;
+
+	trap_stats_off = sbi_scratch_alloc_offset(sizeof(struct sbi_trap_stats),
+						  "TRAP_STATS");
+	if (!trap_stats_off)
+		return SBI_ENOMEM;
+
+	return 0;
+}
+
+#endif
@@ -7,6 +7,7 @@
  *   Anup Patel <anup.patel@wdc.com>
  */
 
+#include <sbi/riscv_asm.h>
 #include <sbi/riscv_encoding.h>
 #include <sbi/sbi_bitops.h>
 #include <sbi/sbi_hart.h>
@@ -114,6 +115,282 @@ void sbi_store_u64(u64 *addr, u64 val,
 }
 #endif
 
+/**
+ * The expected trap handler leaves a non-zero value in a4 so it is used
+ * to skip the remaining accesses once one of them has trapped. Nothing
+ * else may be accessed while MPRV is set and a trap also changes MPP.
+ */
+u64 sbi_load_misaligned(ulong addr, ulong len, struct sbi_trap_info *trap)
+{
+	register ulong tinfo asm("a3");
+	register ulong ttmp asm("a4") = 0;
+	register ulong mstatus = 0;
+	register ulong mtvec = sbi_hart_expected_trap_addr();
+	ulong w0 = 0, w1 = 0, w2 = 0;
+	ulong off = addr & (sizeof(ulong) - 1);
+	ulong base = addr - off;
+	ulong nmore = (off + len - 1) / sizeof(ulong);
+	u64 ret;
+
+	trap->cause = 0;
+
+	asm volatile(
+	    "add %[tinfo], %[taddr], zero\n"
+	    "csrrw %[mtvec], " STR(CSR_MTVEC) ", %[mtvec]\n"
+	    "csrrs %[mstatus], " STR(CSR_MSTATUS) ", %[mprv]\n"
+	    ".option push\n"
+	    ".option norvc\n"
+	    REG_L " %[w0], 0(%[base])\n"
+	    "beqz %[nmore], 2f\n"
+	    "bnez %[ttmp], 2f\n"
+	    REG_L " %[w1], %[sz](%[base])\n"
+	    "addi %[nmore], %[nmore], -1\n"
+	    "beqz %[nmore], 2f\n"
+	    "bnez %[ttmp], 2f\n"
+	    REG_L " %[w2], %[sz2](%[base])\n"
+	    ".option pop\n"
+	    "2: csrw " STR(CSR_MSTATUS) ", %[mstatus]\n"
+	    "csrw " STR(CSR_MTVEC) ", %[mtvec]"
+	    : [mstatus] "+&r"(mstatus), [mtvec] "+&r"(mtvec),
+	      [tinfo] "+&r"(tinfo), [ttmp] "+&r"(ttmp),
+	      [nmore] "+&r"(nmore), [w0] "+&r"(w0), [w1] "+&r"(w1),
+	      [w2] "+&r"(w2)
+	    : [mprv] "r"(MSTATUS_MPRV), [taddr] "r"((ulong)trap),
+	      [base] "r"(base), [sz] "i"(sizeof(ulong)),
+	      [sz2] "i"(2 * sizeof(ulong))
+	    : "memory");
+
+	if (trap->cause) {
+		/* Report the first byte of the access if the first word faulted */
+		if (trap->tval < addr)
+			trap->tval = addr;
+		return 0;
+	}
+
+#if __riscv_xlen == 64
+	ret = w0 >> (8 * off);
+	if (off)
+		ret |= w1 << (64 - 8 * off);
+#else
+	ret = ((u64)w1 << 32 | w0) >> (8 * off);
+	if (off)
+		ret |= (u64)w2 << (64 - 8 * off);
+#endif
+
+	return (len < sizeof(u64)) ? ret & ((1ULL << (8 * len)) - 1) : ret;
+}
+
+/*
+ * Store one naturally aligned chunk of a misaligned store. The chunk
+ * size is taken from the low two bits of plan (1 = byte, 2 = half,
+ * 3 = word and 0 = no more chunks).
+ */
+#define MISALIGNED_STORE_CHUNK(__d)				\
+	"andi %[tmp], %[plan], 3\n"				\
+	"beqz %[tmp], 9f\n"					\
+	"addi %[tmp], %[tmp], -2\n"				\
+	"bltz %[tmp], 1f\n"					\
+	"beqz %[tmp], 2f\n"					\
+	"sw %[" #__d "], 0(%[ptr])\n"				\
+	"addi %[ptr], %[ptr], 4\n"				\
+	"j 3f\n"						\
+	"1: sb %[" #__d "], 0(%[ptr])\n"			\
+	"addi %[ptr], %[ptr], 1\n"				\
+	"j 3f\n"						\
+	"2: sh %[" #__d "], 0(%[ptr])\n"			\
+	"addi %[ptr], %[ptr], 2\n"				\
+	"3: bnez %[ttmp], 9f\n"				\
+	"srli %[plan], %[plan], 2\n"
+
+/**
+ * A misaligned store is split into at most four naturally aligned
+ * stores instead of a read-modify-write of the aligned words so that
+ * concurrent updates of the neighbouring bytes are never lost.
+ */
+void sbi_store_misaligned(ulong addr, ulong len, u64 val,
+			  struct sbi_trap_info *trap)
+{
+	register ulong tinfo asm("a3");
+	register ulong ttmp asm("a4") = 0;
+	register ulong mstatus = 0;
+	register ulong mtvec = sbi_hart_expected_trap_addr();
+	ulong d[4] = { 0 }, plan = 0, tmp = 0, ptr = addr;
+	ulong i, pos, sz;
+
+	trap->cause = 0;
+
+	for (i = 0, pos = 0; pos < len && i < array_size(d); i++) {
+		if (((addr + pos) & 1) || len - pos < 2)
+			sz = 1;
+		else if (((addr + pos) & 2) || len - pos < 4)
+			sz = 2;
+		else
+			sz = 4;
+		d[i] = val >> (8 * pos);
+		plan |= ((sz == 4) ? 3UL : sz) << (2 * i);
+		pos += sz;
+	}
+
+	asm volatile(
+	    "add %[tinfo], %[taddr], zero\n"
+	    "csrrw %[mtvec], " STR(CSR_MTVEC) ", %[mtvec]\n"
+	    "csrrs %[mstatus], " STR(CSR_MSTATUS) ", %[mprv]\n"
+	    ".option push\n"
+	    ".option norvc\n"
+	    MISALIGNED_STORE_CHUNK(d0)
+	    MISALIGNED_STORE_CHUNK(d1)
+	    MISALIGNED_STORE_CHUNK(d2)
+	    MISALIGNED_STORE_CHUNK(d3)
+	    ".option pop\n"
+	    "9: csrw " STR(CSR_MSTATUS) ", %[mstatus]\n"
+	    "csrw " STR(CSR_MTVEC) ", %[mtvec]"
+	    : [mstatus] "+&r"(mstatus), [mtvec] "+&r"(mtvec),
+	      [tinfo] "+&r"(tinfo), [ttmp] "+&r"(ttmp),
+	      [plan] "+&r"(plan), [ptr] "+&r"(ptr), [tmp] "+&r"(tmp)
+	    : [mprv] "r"(MSTATUS_MPRV), [taddr] "r"((ulong)trap),
+	      [d0] "r"(d[0]), [d1] "r"(d[1]), [d2] "r"(d[2]),
+	      [d3] "r"(d[3])
+	    : "memory");
+}
+
+#undef MISALIGNED_STORE_CHUNK
+
+#define UNPRIV_MPRV_SET		"csrs " STR(CSR_MSTATUS) ", %[mprv]\n"
+#define UNPRIV_MPRV_CLEAR	"csrc " STR(CSR_MSTATUS) ", %[mprv]\n"
+
+/**
+ * Copy count elements of size __sz with the expected trap handler
+ * installed once. MPRV is only set around the access of the lower
+ * privilege side (the __lpre/__lpost or __spre/__spost pair) because
+ * the M-mode buffer must not be accessed through MPRV. A trap changes
+ * MPP to M-mode so the loop stops right after the faulting access.
+ */
+#define DEFINE_UNPRIVILEGED_COPY_FUNCTION(name, ld, st, __sz, __lpre,        \
+					  __lpost, __spre, __spost)           \
+	static void name(ulong dst, ulong src, ulong count,                   \
+			 struct sbi_trap_info *trap)                          \
+	{                                                                     \
+		register ulong tinfo asm("a3");                               \
+		register ulong ttmp asm("a4") = 0;                            \
+		register ulong mstatus = 0;                                   \
+		register ulong mtvec = sbi_hart_expected_trap_addr();         \
+		ulong tmp = 0;                                                \
+		asm volatile(                                                 \
+			"add %[tinfo], %[taddr], zero\n"                      \
+			"csrrw %[mtvec], " STR(CSR_MTVEC) ", %[mtvec]\n"      \
+			"csrr %[mstatus], " STR(CSR_MSTATUS) "\n"             \
+			".option push\n"                                      \
+			".option norvc\n"                                     \
+			"1: beqz %[count], 2f\n"                              \
+			__lpre                                                \
+			#ld " %[tmp], 0(%[src])\n"                            \
+			__lpost                                               \
+			"bnez %[ttmp], 2f\n"                                  \
+			__spre                                                \
+			#st " %[tmp], 0(%[dst])\n"                            \
+			__spost                                               \
+			"bnez %[ttmp], 2f\n"                                  \
+			"addi %[src], %[src], %[sz]\n"                        \
+			"addi %[dst], %[dst], %[sz]\n"                        \
+			"addi %[count], %[count], -1\n"                       \
+			"j 1b\n"                                              \
+			".option pop\n"                                       \
+			"2: csrw " STR(CSR_MSTATUS) ", %[mstatus]\n"          \
+			"csrw " STR(CSR_MTVEC) ", %[mtvec]"                   \
+		    : [mstatus] "+&r"(mstatus), [mtvec] "+&r"(mtvec),         \
+		      [tinfo] "+&r"(tinfo), [ttmp] "+&r"(ttmp),               \
+		      [tmp] "+&r"(tmp), [src] "+&r"(src), [dst] "+&r"(dst),   \
+		      [count] "+&r"(count)                                    \
+		    : [mprv] "r"(MSTATUS_MPRV), [taddr] "r"((ulong)trap),     \
+		      [sz] "i"(__sz)                                          \
+		    : "memory");                                              \
+	}
+
+#if __riscv_xlen == 64
+#define UNPRIV_WORD_LOAD	ld
+#define UNPRIV_WORD_STORE	sd
+#else
+#define UNPRIV_WORD_LOAD	lw
+#define UNPRIV_WORD_STORE	sw
+#endif
+
+#define __DEFINE_UNPRIVILEGED_COPY_FUNCTION(name, ld, st, ...)               \
+	DEFINE_UNPRIVILEGED_COPY_FUNCTION(name, ld, st, __VA_ARGS__)
+
+DEFINE_UNPRIVILEGED_COPY_FUNCTION(copy_from_lower_bytes, lbu, sb, 1,
+				  UNPRIV_MPRV_SET, UNPRIV_MPRV_CLEAR, "", "")
+DEFINE_UNPRIVILEGED_COPY_FUNCTION(copy_to_lower_bytes, lbu, sb, 1,
+				  "", "", UNPRIV_MPRV_SET, UNPRIV_MPRV_CLEAR)
+__DEFINE_UNPRIVILEGED_COPY_FUNCTION(copy_from_lower_words, UNPRIV_WORD_LOAD,
+				    UNPRIV_WORD_STORE, sizeof(ulong),
+				    UNPRIV_MPRV_SET, UNPRIV_MPRV_CLEAR, "", "")
+__DEFINE_UNPRIVILEGED_COPY_FUNCTION(copy_to_lower_words, UNPRIV_WORD_LOAD,
+				    UNPRIV_WORD_STORE, sizeof(ulong),
+				    "", "", UNPRIV_MPRV_SET, UNPRIV_MPRV_CLEAR)
+
+#undef __DEFINE_UNPRIVILEGED_COPY_FUNCTION
+#undef UNPRIV_WORD_STORE
+#undef UNPRIV_WORD_LOAD
+#undef UNPRIV_MPRV_CLEAR
+#undef UNPRIV_MPRV_SET
+
+typedef void (*unpriv_copy_fn)(ulong dst, ulong src, ulong count,
+			       struct sbi_trap_info *trap);
+
+/*
+ * Copy the unaligned head and tail byte-wise and everything in between
+ * word-wise when dst and src have the same alignment within a word.
+ */
+static void unpriv_copy(ulong dst, ulong src, ulong len,
+			unpriv_copy_fn copy_bytes, unpriv_copy_fn copy_words,
+			struct sbi_trap_info *trap)
+{
+	ulong head, words;
+
+	trap->cause = 0;
+
+	if (len && !((dst ^ src) & (sizeof(ulong) - 1))) {
+		head = -src & (sizeof(ulong) - 1);
+		if (head > len)
+			head = len;
+		if (head) {
+			copy_bytes(dst, src, head, trap);
+			if (trap->cause)
+				return;
+			dst += head;
+			src += head;
+			len -= head;
+		}
+
+		words = len / sizeof(ulong);
+		if (words) {
+			copy_words(dst, src, words, trap);
+			if (trap->cause)
+				return;
+			dst += words * sizeof(ulong);
+			src += words * sizeof(ulong);
+			len -= words * sizeof(ulong);
+		}
+	}
+
+	if (len)
+		copy_bytes(dst, src, len, trap);
+}
+
+void sbi_copy_from_lower(void *dst, const void *src, ulong len,
+			 struct sbi_trap_info *trap)
+{
+	unpriv_copy((ulong)dst, (ulong)src, len, copy_from_lower_bytes,
+		    copy_from_lower_words, trap);
+}
+
+void sbi_copy_to_lower(void *dst, const void *src, ulong len,
+		       struct sbi_trap_info *trap)
+{
+	unpriv_copy((ulong)dst, (ulong)src, len, copy_to_lower_bytes,
+		    copy_to_lower_words, trap);
+}
+
 ulong sbi_get_insn(ulong mepc, struct sbi_trap_info *trap)
 {
 	register ulong tinfo asm("a3");
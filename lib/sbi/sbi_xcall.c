@@ -0,0 +1,182 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <sbi/riscv_atomic.h>
+#include <sbi/riscv_barrier.h>
+#include <sbi/riscv_locks.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_ipi.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_xcall.h>
+
+/** Cross-call queued in the IPI payload ring of a target HART */
+struct sbi_xcall_entry {
+	sbi_xcall_fn_t fn;
+	void *arg;
+	struct sbi_xcall_done *done;
+};
+
+/** Cross-call being sent by a HART */
+struct sbi_xcall_req {
+	struct sbi_xcall_entry entry;
+	/** Wait for the target HARTs in the sync callback */
+	bool wait;
+};
+
+static u32 xcall_event = SBI_IPI_EVENT_MAX;
+static unsigned long xcall_req_off;
+
+static int xcall_update(struct sbi_scratch *scratch,
+			struct sbi_scratch *remote_scratch,
+			u32 remote_hartid, void *data)
+{
+	struct sbi_xcall_req *req = data;
+	struct sbi_xcall_entry *e;
+
+	/*
+	 * The queue of the remote HART is drained by its IPI handler.
+	 * It may be waiting for us in a request of its own so handle
+	 * our IPIs meanwhile to avoid deadlock.
+	 */
+	while (!(e = sbi_ipi_payload_reserve(remote_scratch, xcall_event)))
+		sbi_ipi_process();
+
+	*e = req->entry;
+	atomic_add_return_relaxed(&req->entry.done->pending, 1);
+	sbi_ipi_payload_commit(e);
+
+	return 0;
+}
+
+static void xcall_sync(struct sbi_scratch *scratch)
+{
+	struct sbi_xcall_req **reqp =
+			sbi_scratch_offset_ptr(scratch, xcall_req_off);
+
+	if (*reqp && (*reqp)->wait)
+		sbi_xcall_wait((*reqp)->entry.done);
+}
+
+static void xcall_process(struct sbi_scratch *scratch)
+{
+	struct sbi_xcall_entry *e, entry;
+
+	while ((e = sbi_ipi_payload_peek(scratch, xcall_event))) {
+		/* The slot is free again before fn may queue cross-calls */
+		entry = *e;
+		sbi_ipi_payload_release(scratch, xcall_event);
+
+		entry.fn(scratch, entry.arg);
+		atomic_sub_return_release(&entry.done->pending, 1);
+	}
+}
+
+static struct sbi_ipi_event_ops xcall_ops = {
+	.name = "IPI_XCALL",
+	.priority = SBI_IPI_EVENT_PRIO_NORMAL,
+	.payload_size = sizeof(struct sbi_xcall_entry),
+	.payload_count = SBI_XCALL_QUEUE_SIZE,
+	.update = xcall_update,
+	.sync = xcall_sync,
+	.process = xcall_process,
+};
+
+static int xcall_send(ulong hmask, ulong hbase, sbi_xcall_fn_t fn,
+		      void *arg, struct sbi_xcall_done *done, bool wait)
+{
+	int rc;
+	struct sbi_xcall_req req, **reqp, *prev;
+
+	if (!fn || !done)
+		return SBI_EINVAL;
+	if (SBI_IPI_EVENT_MAX <= xcall_event)
+		return SBI_ENOTSUPP;
+
+	req.entry.fn = fn;
+	req.entry.arg = arg;
+	req.entry.done = done;
+	req.wait = wait;
+
+	/* A function run by this HART meanwhile may send its own */
+	reqp = sbi_scratch_thishart_offset_ptr(xcall_req_off);
+	prev = *reqp;
+	*reqp = &req;
+	rc = sbi_ipi_send_many(hmask, hbase, xcall_event, &req);
+	*reqp = prev;
+
+	return rc;
+}
+
+int sbi_xcall_run(ulong hmask, ulong hbase, sbi_xcall_fn_t fn, void *arg)
+{
+	struct sbi_xcall_done done;
+
+	ATOMIC_INIT(&done.pending, 0);
+
+	return xcall_send(hmask, hbase, fn, arg, &done, TRUE);
+}
+
+int sbi_xcall_run_async(ulong hmask, ulong hbase, sbi_xcall_fn_t fn,
+			void *arg, struct sbi_xcall_done *done)
+{
+	if (done)
+		ATOMIC_INIT(&done->pending, 0);
+
+	return xcall_send(hmask, hbase, fn, arg, done, FALSE);
+}
+
+bool sbi_xcall_is_done(struct sbi_xcall_done *done)
+{
+	if (atomic_read(&done->pending) > 0)
+		return FALSE;
+
+	/* Pairs with the release of the target HARTs */
+	smp_rmb();
+	return TRUE;
+}
+
+void sbi_xcall_wait(struct sbi_xcall_done *done)
+{
+	long pending;
+	unsigned long backoff = 0;
+
+	while ((pending = atomic_read(&done->pending)) > 0) {
+		/* The target HARTs may be waiting for us in their own call */
+		sbi_ipi_process();
+		spin_wait_ulong(
+			(volatile unsigned long *)&done->pending.counter,
+			pending, &backoff);
+	}
+
+	smp_rmb();
+}
+
+int sbi_xcall_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	int ret;
+	struct sbi_xcall_req **reqp;
+
+	if (cold_boot) {
+		xcall_req_off = sbi_scratch_alloc_offset(sizeof(*reqp),
+							 "IPI_XCALL_REQ");
+		if (!xcall_req_off)
+			return SBI_ENOMEM;
+
+		ret = sbi_ipi_event_create(&xcall_ops);
+		if (ret < 0) {
+			sbi_scratch_free_offset(xcall_req_off);
+			return ret;
+		}
+		xcall_event = ret;
+	} else if (!xcall_req_off || SBI_IPI_EVENT_MAX <= xcall_event) {
+		return SBI_ENOSPC;
+	}
+
+	reqp = sbi_scratch_offset_ptr(scratch, xcall_req_off);
+	*reqp = NULL;
+
+	return 0;
+}
@@ -0,0 +1,91 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <libfdt.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_string.h>
+#include <sbi_utils/cache/fdt_sifive_ccache.h>
+#include <sbi_utils/cache/sifive_ccache.h>
+#include <sbi_utils/fdt/fdt_domain.h>
+#include <sbi_utils/fdt/fdt_helper.h>
+
+/* The D-cache of HART0 follows the way mask of the DMA master */
+static const struct fdt_match sifive_ccache_match[] = {
+	{ .compatible = "sifive,fu540-c000-ccache", .data = (void *)1 },
+	{ .compatible = "sifive,fu740-c000-ccache", .data = (void *)1 },
+	{ },
+};
+
+static int fdt_ccache_way_mask(void *fdt, int nodeoff, u32 *way_mask)
+{
+	int len;
+	const fdt32_t *val;
+
+	val = fdt_getprop(fdt, nodeoff, "sifive,ccache-way-mask", &len);
+	if (!val || len < sizeof(fdt32_t))
+		return SBI_ENOENT;
+
+	*way_mask = fdt32_to_cpu(*val);
+
+	return 0;
+}
+
+/* Partition the ways between domains which ask for it */
+static int fdt_ccache_domain_fixup(void *fdt, int domain_offset, void *opaque)
+{
+	u32 i, hartid, way_mask;
+	struct sbi_domain *dom;
+	const char *name;
+
+	if (fdt_ccache_way_mask(fdt, domain_offset, &way_mask))
+		return 0;
+
+	name = fdt_get_name(fdt, domain_offset, NULL);
+	sbi_domain_for_each(i, dom) {
+		if (sbi_strcmp(dom->name, name))
+			continue;
+
+		sbi_hartmask_for_each_hart(hartid, &dom->assigned_harts)
+			sifive_ccache_set_hart_way_mask(hartid, way_mask);
+		break;
+	}
+
+	return 0;
+}
+
+int fdt_sifive_ccache_init(void *fdt)
+{
+	int rc, nodeoff;
+	u32 i, count;
+	unsigned long size;
+	const struct fdt_cpu *cpus;
+	const struct fdt_match *match;
+	struct sifive_ccache_data ccache = { 0 };
+
+	nodeoff = fdt_find_match(fdt, -1, sifive_ccache_match, &match);
+	if (nodeoff < 0)
+		return nodeoff;
+
+	rc = fdt_get_node_addr_size(fdt, nodeoff, &ccache.addr, &size);
+	if (rc)
+		return rc;
+
+	fdt_ccache_way_mask(fdt, nodeoff, &ccache.way_mask);
+	ccache.hart_master_base = (unsigned long)match->data;
+
+	rc = sifive_ccache_init(&ccache);
+	if (rc)
+		return rc;
+
+	/* HARTs may allocate in all usable ways unless partitioned below */
+	if (!fdt_parse_cpus(fdt, &cpus, &count)) {
+		for (i = 0; i < count; i++)
+			sifive_ccache_set_hart_way_mask(cpus[i].hartid, -1U);
+	}
+
+	return fdt_iterate_each_domain(fdt, NULL, fdt_ccache_domain_fixup);
+}
@@ -0,0 +1,9 @@
+#
+# SPDX-License-Identifier: BSD-2-Clause
+#
+# Copyright (c) 2021 Western Digital Corporation or its affiliates.
+#
+
+libsbiutils-objs-y += cache/zicbom.o
+libsbiutils-objs-y += cache/sifive_ccache.o
+libsbiutils-objs-y += cache/fdt_sifive_ccache.o
@@ -0,0 +1,128 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <sbi/riscv_barrier.h>
+#include <sbi/riscv_io.h>
+#include <sbi/sbi_bitops.h>
+#include <sbi/sbi_cache.h>
+#include <sbi/sbi_error.h>
+#include <sbi_utils/cache/sifive_ccache.h>
+
+/* clang-format off */
+
+#define CCACHE_CONFIG			0x000
+#define CCACHE_CONFIG_WAYS(__v)		(((__v) >> 8) & 0xff)
+#define CCACHE_CONFIG_BLOCK_SHIFT(__v)	(((__v) >> 24) & 0xff)
+#define CCACHE_WAY_ENABLE		0x008
+#define CCACHE_DIR_ECC_FIX_COUNT	0x108
+#define CCACHE_DIR_ECC_FAIL_COUNT	0x128
+#define CCACHE_DATA_ECC_FIX_COUNT	0x148
+#define CCACHE_DATA_ECC_FAIL_COUNT	0x168
+#define CCACHE_FLUSH64			0x200
+#define CCACHE_FLUSH32			0x240
+#define CCACHE_WAY_MASK(__master)	(0x800 + (__master) * 8)
+
+/* Every HART has a D-cache and an I-cache master */
+#define CCACHE_HART_MASTERS		2
+
+/* clang-format on */
+
+static void *ccache_base;
+static u32 ccache_way_mask, ccache_hart_master_base;
+
+static void ccache_block_op(u32 op, unsigned long addr)
+{
+	/*
+	 * The controller only flushes, which also does for clean and
+	 * invalidate as dirty data reaches memory before it is dropped.
+	 */
+#if __riscv_xlen == 32
+	writel(addr >> 4, ccache_base + CCACHE_FLUSH32);
+#else
+	writeq(addr, ccache_base + CCACHE_FLUSH64);
+#endif
+}
+
+static struct sbi_cache_device ccache_cache = {
+	.name = "sifive_ccache",
+	.local = FALSE,
+	.cache_block_op = ccache_block_op,
+};
+
+int sifive_ccache_set_hart_way_mask(u32 hartid, u32 way_mask)
+{
+	u32 i, master;
+
+	if (!ccache_base)
+		return SBI_ENODEV;
+
+	way_mask &= ccache_way_mask;
+	if (!way_mask)
+		return SBI_EINVAL;
+
+	master = ccache_hart_master_base + hartid * CCACHE_HART_MASTERS;
+	for (i = 0; i < CCACHE_HART_MASTERS; i++)
+		writel(way_mask, ccache_base + CCACHE_WAY_MASK(master + i));
+
+	return 0;
+}
+
+int sifive_ccache_get_ecc(struct sifive_ccache_ecc *ecc)
+{
+	if (!ccache_base)
+		return SBI_ENODEV;
+	if (!ecc)
+		return SBI_EINVAL;
+
+	ecc->dir_fix_count = readl(ccache_base + CCACHE_DIR_ECC_FIX_COUNT);
+	ecc->dir_fail_count = readl(ccache_base + CCACHE_DIR_ECC_FAIL_COUNT);
+	ecc->data_fix_count = readl(ccache_base + CCACHE_DATA_ECC_FIX_COUNT);
+	ecc->data_fail_count = readl(ccache_base + CCACHE_DATA_ECC_FAIL_COUNT);
+
+	return 0;
+}
+
+int sifive_ccache_init(struct sifive_ccache_data *ccache)
+{
+	u32 i, config, ways, mask, top;
+
+	if (!ccache || !ccache->addr)
+		return SBI_EINVAL;
+
+	config = readl((void *)ccache->addr + CCACHE_CONFIG);
+	ways = CCACHE_CONFIG_WAYS(config);
+	if (!ways || 32 < ways)
+		return SBI_ENODEV;
+
+	mask = (ways == 32) ? -1U : (1U << ways) - 1;
+	if (ccache->way_mask)
+		mask &= ccache->way_mask;
+	if (!mask)
+		return SBI_EINVAL;
+
+	/*
+	 * Ways are enabled from way 0 up to the written index and stay
+	 * enabled until reset. A way enabled as cache is no longer part
+	 * of the scratchpad so this must not run from the scratchpad.
+	 */
+	top = __fls(mask);
+	if (readl((void *)ccache->addr + CCACHE_WAY_ENABLE) < top)
+		writel(top, (void *)ccache->addr + CCACHE_WAY_ENABLE);
+	mb();
+
+	/* Masters other than HARTs (e.g. DMA) allocate in all usable ways */
+	for (i = 0; i < ccache->hart_master_base; i++)
+		writel(mask, (void *)ccache->addr + CCACHE_WAY_MASK(i));
+
+	ccache_base = (void *)ccache->addr;
+	ccache_way_mask = mask;
+	ccache_hart_master_base = ccache->hart_master_base;
+
+	ccache_cache.block_size = 1UL << CCACHE_CONFIG_BLOCK_SHIFT(config);
+	sbi_cache_set_device(&ccache_cache);
+
+	return 0;
+}
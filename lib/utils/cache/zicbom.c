@@ -0,0 +1,49 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <sbi/sbi_cache.h>
+#include <sbi/sbi_error.h>
+#include <sbi_utils/cache/zicbom.h>
+
+/* CBO.INVAL, CBO.CLEAN and CBO.FLUSH only differ in their imm12 */
+#define ZICBOM_CBO(__imm, __addr)				\
+	__asm__ __volatile__(".insn i 0x0f, 2, x0, %0, " #__imm	\
+			     : : "r"(__addr) : "memory")
+
+static void zicbom_cache_block_op(u32 op, unsigned long addr)
+{
+	switch (op) {
+	case SBI_CACHE_OP_CLEAN:
+		ZICBOM_CBO(1, addr);
+		break;
+	case SBI_CACHE_OP_INVAL:
+		ZICBOM_CBO(0, addr);
+		break;
+	case SBI_CACHE_OP_FLUSH:
+		ZICBOM_CBO(2, addr);
+		break;
+	default:
+		break;
+	};
+}
+
+/* Zicbom operations reach all coherent caches so no broadcast needed */
+static struct sbi_cache_device zicbom_cache = {
+	.name = "zicbom",
+	.local = FALSE,
+	.cache_block_op = zicbom_cache_block_op,
+};
+
+int zicbom_cache_init(unsigned long block_size)
+{
+	if (!block_size || (block_size & (block_size - 1)))
+		return SBI_EINVAL;
+
+	zicbom_cache.block_size = block_size;
+	sbi_cache_set_device(&zicbom_cache);
+
+	return 0;
+}
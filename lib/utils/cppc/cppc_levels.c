@@ -0,0 +1,150 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/sbi_cppc.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_timer.h>
+#include <sbi_utils/cppc/cppc_levels.h>
+
+static const struct cppc_levels *cppc_levels;
+
+/* Last desired performance of each HART, zero until S-mode sets it */
+static unsigned long cppc_desired_off;
+
+static u64 cppc_levels_cycles(void)
+{
+#if __riscv_xlen == 32
+	u32 lo, hi, tmp;
+
+	do {
+		hi = csr_read(CSR_MCYCLEH);
+		lo = csr_read(CSR_MCYCLE);
+		tmp = csr_read(CSR_MCYCLEH);
+	} while (hi != tmp);
+
+	return ((u64)hi << 32) | lo;
+#else
+	return csr_read(CSR_MCYCLE);
+#endif
+}
+
+static int cppc_levels_probe(unsigned long reg)
+{
+	switch (reg) {
+	case SBI_CPPC_HIGHEST_PERF:
+	case SBI_CPPC_NOMINAL_PERF:
+	case SBI_CPPC_LOW_NON_LINEAR_PERF:
+	case SBI_CPPC_LOWEST_PERF:
+	case SBI_CPPC_DESIRED_PERF:
+	case SBI_CPPC_REFERENCE_PERF:
+		return 32;
+	case SBI_CPPC_REFERENCE_CTR:
+	case SBI_CPPC_DELIVERED_CTR:
+		return 64;
+	case SBI_CPPC_TRANSITION_LATENCY:
+		return (cppc_levels->transition_latency) ? 32 : 0;
+	default:
+		return 0;
+	}
+}
+
+static int cppc_levels_read(unsigned long reg, u64 *val)
+{
+	u32 *desired;
+
+	switch (reg) {
+	case SBI_CPPC_HIGHEST_PERF:
+		*val = cppc_levels->perf[cppc_levels->count - 1];
+		break;
+	case SBI_CPPC_NOMINAL_PERF:
+		*val = cppc_levels->perf[cppc_levels->nominal];
+		break;
+	case SBI_CPPC_LOW_NON_LINEAR_PERF:
+	case SBI_CPPC_LOWEST_PERF:
+		*val = cppc_levels->perf[0];
+		break;
+	case SBI_CPPC_DESIRED_PERF:
+		desired = sbi_scratch_thishart_offset_ptr(cppc_desired_off);
+		*val = (*desired) ? *desired :
+		       cppc_levels->perf[cppc_levels->nominal];
+		break;
+	case SBI_CPPC_REFERENCE_PERF:
+		*val = cppc_levels->reference_perf;
+		break;
+	case SBI_CPPC_REFERENCE_CTR:
+		*val = sbi_timer_value();
+		break;
+	case SBI_CPPC_DELIVERED_CTR:
+		*val = cppc_levels_cycles();
+		break;
+	case SBI_CPPC_TRANSITION_LATENCY:
+		*val = cppc_levels->transition_latency;
+		break;
+	default:
+		return SBI_ENOTSUPP;
+	}
+
+	return 0;
+}
+
+static int cppc_levels_write(unsigned long reg, u64 val)
+{
+	int rc;
+	u32 level;
+
+	if (reg != SBI_CPPC_DESIRED_PERF)
+		return SBI_ENOTSUPP;
+	if (!val || (u32)-1 < val)
+		return SBI_EINVAL;
+
+	/* Lowest level delivering at least the desired performance */
+	for (level = 0; level < cppc_levels->count - 1; level++) {
+		if (val <= cppc_levels->perf[level])
+			break;
+	}
+
+	rc = cppc_levels->set_level(current_hartid(), level);
+	if (rc)
+		return rc;
+
+	*(u32 *)sbi_scratch_thishart_offset_ptr(cppc_desired_off) = val;
+
+	return 0;
+}
+
+static struct sbi_cppc_device cppc_levels_dev = {
+	.name = "cppc-levels",
+	.cppc_probe = cppc_levels_probe,
+	.cppc_read = cppc_levels_read,
+	.cppc_write = cppc_levels_write,
+};
+
+int cppc_levels_init(const struct cppc_levels *levels)
+{
+	u32 i;
+
+	if (!levels || !levels->perf || !levels->count ||
+	    levels->count <= levels->nominal || !levels->set_level ||
+	    !levels->perf[0])
+		return SBI_EINVAL;
+	for (i = 1; i < levels->count; i++) {
+		if (levels->perf[i] <= levels->perf[i - 1])
+			return SBI_EINVAL;
+	}
+
+	cppc_desired_off = sbi_scratch_alloc_offset(sizeof(u32),
+						    "CPPC_DESIRED");
+	if (!cppc_desired_off)
+		return SBI_ENOMEM;
+
+	cppc_levels = levels;
+	sbi_cppc_set_device(&cppc_levels_dev);
+
+	return 0;
+}
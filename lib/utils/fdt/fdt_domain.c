@@ -10,11 +10,15 @@
 
 #include <libfdt.h>
 #include <sbi/sbi_domain.h>
+#include <sbi/sbi_ecall.h>
+#include <sbi/sbi_ecall_interface.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_hartmask.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi_utils/fdt/fdt_domain.h>
+#include <sbi_utils/fdt/fdt_fixup.h>
 #include <sbi_utils/fdt/fdt_helper.h>
+#include <sbi_utils/fdt/fdt_index.h>
 
 int fdt_iterate_each_domain(void *fdt, void *opaque,
 			    int (*fn)(void *fdt, int domain_offset,
@@ -68,7 +72,7 @@ int fdt_iterate_each_memregion(void *fdt, int domain_offset, void *opaque,
 
 	rcount = (u32)len / (sizeof(u32) * 2);
 	for (i = 0; i < rcount; i++) {
-		region_offset = fdt_node_offset_by_phandle(fdt,
+		region_offset = fdt_index_offset_by_phandle(fdt,
 						fdt32_to_cpu(regions[2 * i]));
 		if (region_offset < 0)
 			return region_offset;
@@ -137,7 +141,7 @@ static int __fixup_disable_devices(void *fdt, int doff, int roff,
 	len = len / sizeof(u32);
 
 	for (i = 0; i < len; i++) {
-		coff = fdt_node_offset_by_phandle(fdt,
+		coff = fdt_index_offset_by_phandle(fdt,
 					fdt32_to_cpu(devices[i]));
 		if (coff < 0)
 			return coff;
@@ -186,19 +190,15 @@ void fdt_domain_fixup(void *fdt)
 	if (!dcount)
 		goto skip_device_disable;
 
-	/* Expand FDT based on device DT nodes to be disabled */
-	err = fdt_open_into(fdt, fdt, fdt_totalsize(fdt) + dcount * 32);
+	/*
+	 * Expand FDT based on device DT nodes to be disabled. This only
+	 * moves the blob when fdt_fixups_expand() did not reserve enough
+	 * and node offsets stay valid either way.
+	 */
+	err = fdt_fixup_reserve(fdt, dcount * 32);
 	if (err < 0)
 		return;
 
-	/* Again find current domain DT node */
-	doffset = -1;
-	fdo.name = dom->name;
-	fdo.doffset = &doffset;
-	fdt_iterate_each_domain(fdt, &fdo, __fixup_find_domain_offset);
-	if (doffset < 0)
-		goto skip_device_disable;
-
 	/* Disable device DT nodes for current domain */
 	fdt_iterate_each_memregion(fdt, doffset, NULL,
 				   __fixup_disable_devices);
@@ -215,14 +215,33 @@ skip_device_disable:
 	fdt_nop_node(fdt, poffset);
 }
 
+#ifndef FDT_DOMAIN_MAX_COUNT
 #define FDT_DOMAIN_MAX_COUNT		8
+#endif
+#ifndef FDT_DOMAIN_REGION_MAX_COUNT
 #define FDT_DOMAIN_REGION_MAX_COUNT	16
+#endif
+
+/*
+ * Regions of all domains are taken from one pool so that a domain can
+ * have more than FDT_DOMAIN_REGION_MAX_COUNT regions when others have
+ * less. Each domain's list ends with a zeroed entry.
+ */
+#define FDT_DOMAIN_REGION_POOL_COUNT	\
+	(FDT_DOMAIN_MAX_COUNT * (FDT_DOMAIN_REGION_MAX_COUNT + 1))
 
 static u32 fdt_domains_count;
 static struct sbi_domain fdt_domains[FDT_DOMAIN_MAX_COUNT];
 static struct sbi_hartmask fdt_masks[FDT_DOMAIN_MAX_COUNT];
-static struct sbi_domain_memregion
-	fdt_regions[FDT_DOMAIN_MAX_COUNT][FDT_DOMAIN_REGION_MAX_COUNT + 1];
+static u32 fdt_regions_used;
+static struct sbi_domain_memregion fdt_regions[FDT_DOMAIN_REGION_POOL_COUNT];
+
+/*
+ * Domain DT node offset (or negative error) of each HART having a CPU
+ * DT node, looked up once instead of walking /cpus for every domain.
+ */
+static struct sbi_hartmask fdt_domain_cpus;
+static int fdt_domain_hart_offset[SBI_HARTMASK_MAX_BITS];
 
 static int __fdt_parse_region(void *fdt, int domain_offset,
 			      int region_offset, u32 region_access,
@@ -235,10 +254,10 @@ static int __fdt_parse_region(void *fdt, int domain_offset,
 	u32 *region_count = opaque;
 	struct sbi_domain_memregion *region;
 
-	/* Find next region of the domain */
-	if (FDT_DOMAIN_REGION_MAX_COUNT <= *region_count)
+	/* Find next region of the domain (keeping room for the end) */
+	if (FDT_DOMAIN_REGION_POOL_COUNT <= fdt_regions_used + *region_count + 1)
 		return SBI_EINVAL;
-	region = &fdt_regions[fdt_domains_count][*region_count];
+	region = &fdt_regions[fdt_regions_used + *region_count];
 
 	/* Read "base" DT property */
 	val = fdt_getprop(fdt, region_offset, "base", &len);
@@ -277,14 +296,14 @@ static int __fdt_parse_domain(void *fdt, int domain_offset, void *opaque)
 	struct sbi_hartmask assign_mask;
 	int *cold_domain_offset = opaque;
 	struct sbi_domain_memregion *reg, *regions;
-	int i, err, len, cpus_offset, cpu_offset, doffset;
+	int i, err, len;
 
 	/* Sanity check on maximum domains we can handle */
 	if (FDT_DOMAIN_MAX_COUNT <= fdt_domains_count)
 		return SBI_EINVAL;
 	dom = &fdt_domains[fdt_domains_count];
 	mask = &fdt_masks[fdt_domains_count];
-	regions = &fdt_regions[fdt_domains_count][0];
+	regions = &fdt_regions[fdt_regions_used];
 
 	/* Read DT node name */
 	sbi_strncpy(dom->name, fdt_get_name(fdt, domain_offset, NULL),
@@ -298,12 +317,8 @@ static int __fdt_parse_domain(void *fdt, int domain_offset, void *opaque)
 	len = len / sizeof(u32);
 	if (val && len) {
 		for (i = 0; i < len; i++) {
-			cpu_offset = fdt_node_offset_by_phandle(fdt,
-							fdt32_to_cpu(val[i]));
-			if (cpu_offset < 0)
-				return cpu_offset;
-
-			err = fdt_parse_hart_id(fdt, cpu_offset, &val32);
+			err = fdt_parse_hart_id_by_phandle(fdt,
+						fdt32_to_cpu(val[i]), &val32);
 			if (err)
 				return err;
 
@@ -313,8 +328,6 @@ static int __fdt_parse_domain(void *fdt, int domain_offset, void *opaque)
 
 	/* Setup memregions from DT */
 	val32 = 0;
-	sbi_memset(regions, 0,
-		   sizeof(*regions) * (FDT_DOMAIN_REGION_MAX_COUNT + 1));
 	dom->regions = regions;
 	err = fdt_iterate_each_memregion(fdt, domain_offset, &val32,
 					 __fdt_parse_region);
@@ -335,19 +348,18 @@ static int __fdt_parse_domain(void *fdt, int domain_offset, void *opaque)
 		    (reg->flags & SBI_DOMAIN_MEMREGION_WRITEABLE) ||
 		    (reg->flags & SBI_DOMAIN_MEMREGION_EXECUTABLE))
 			continue;
-		if (FDT_DOMAIN_REGION_MAX_COUNT <= val32)
+		if (FDT_DOMAIN_REGION_POOL_COUNT <= fdt_regions_used + val32 + 1)
 			return SBI_EINVAL;
 		sbi_memcpy(&regions[val32++], reg, sizeof(*reg));
 	}
+	sbi_memset(&regions[val32], 0, sizeof(*regions));
+	fdt_regions_used += val32 + 1;
 
 	/* Read "boot-hart" DT property */
 	val32 = -1U;
 	val = fdt_getprop(fdt, domain_offset, "boot-hart", &len);
 	if (val && len >= 4) {
-		cpu_offset = fdt_node_offset_by_phandle(fdt,
-							 fdt32_to_cpu(*val));
-		if (cpu_offset >= 0)
-			fdt_parse_hart_id(fdt, cpu_offset, &val32);
+		fdt_parse_hart_id_by_phandle(fdt, fdt32_to_cpu(*val), &val32);
 	} else {
 		if (domain_offset == *cold_domain_offset)
 			val32 = current_hartid();
@@ -398,30 +410,62 @@ static int __fdt_parse_domain(void *fdt, int domain_offset, void *opaque)
 	else
 		dom->system_reset_allowed = FALSE;
 
-	/* Find /cpus DT node */
-	cpus_offset = fdt_path_offset(fdt, "/cpus");
-	if (cpus_offset < 0)
-		return cpus_offset;
+	/* Read "system-suspend-allowed" DT property */
+	if (fdt_get_property(fdt, domain_offset,
+			     "system-suspend-allowed", NULL))
+		dom->system_suspend_allowed = TRUE;
+	else
+		dom->system_suspend_allowed = FALSE;
 
-	/* HART to domain assignment mask based on CPU DT nodes */
-	sbi_hartmask_clear_all(&assign_mask);
-	fdt_for_each_subnode(cpu_offset, fdt, cpus_offset) {
-		err = fdt_parse_hart_id(fdt, cpu_offset, &val32);
-		if (err)
-			continue;
+	/* Read "context-entry-allowed" DT property */
+	if (fdt_get_property(fdt, domain_offset,
+			     "context-entry-allowed", NULL))
+		dom->context_entry_allowed = TRUE;
+	else
+		dom->context_entry_allowed = FALSE;
 
-		if (SBI_HARTMASK_MAX_BITS <= val32)
-			continue;
+	/* Read "pmp-swap" DT property */
+	if (fdt_get_property(fdt, domain_offset, "pmp-swap", NULL))
+		dom->pmp_swap = TRUE;
+	else
+		dom->pmp_swap = FALSE;
+
+	/* Read "ipi-rate-interval" and "ipi-rate-burst" DT properties */
+	dom->ipi_rate_interval = 0;
+	val = fdt_getprop(fdt, domain_offset, "ipi-rate-interval", &len);
+	if (val && len >= 4)
+		dom->ipi_rate_interval = fdt32_to_cpu(*val);
+	dom->ipi_rate_burst = 1;
+	val = fdt_getprop(fdt, domain_offset, "ipi-rate-burst", &len);
+	if (val && len >= 4 && fdt32_to_cpu(*val))
+		dom->ipi_rate_burst = fdt32_to_cpu(*val);
 
-		val = fdt_getprop(fdt, cpu_offset, "opensbi-domain", &len);
-		if (!val || len < 4)
-			return SBI_EINVAL;
+	/*
+	 * Read "ecall-extensions" DT property. The base extension is
+	 * always allowed and the extensions not built in are ignored.
+	 */
+	dom->ecall_exts_count = 0;
+	val = fdt_getprop(fdt, domain_offset, "ecall-extensions", &len);
+	if (val) {
+		err = sbi_ecall_domain_allow(dom, SBI_EXT_BASE);
+		if (err)
+			return err;
+		len = len / sizeof(u32);
+		for (i = 0; i < len; i++) {
+			err = sbi_ecall_domain_allow(dom,
+						     fdt32_to_cpu(val[i]));
+			if (err && err != SBI_ENOENT)
+				return err;
+		}
+	}
 
-		doffset = fdt_node_offset_by_phandle(fdt, fdt32_to_cpu(*val));
-		if (doffset < 0)
-			return doffset;
+	/* HART to domain assignment mask based on CPU DT nodes */
+	sbi_hartmask_clear_all(&assign_mask);
+	sbi_hartmask_for_each_hart(val32, &fdt_domain_cpus) {
+		if (fdt_domain_hart_offset[val32] < 0)
+			return fdt_domain_hart_offset[val32];
 
-		if (doffset == domain_offset)
+		if (fdt_domain_hart_offset[val32] == domain_offset)
 			sbi_hartmask_set_hart(val32, &assign_mask);
 	}
 
@@ -448,23 +492,30 @@ int fdt_domains_populate(void *fdt)
 	if (cpus_offset < 0)
 		return cpus_offset;
 
-	/* Find coldboot HART domain DT node offset */
+	/* Find domain DT node offset of each HART and the coldboot HART */
 	cold_domain_offset = -1;
 	cold_hartid = current_hartid();
+	sbi_hartmask_clear_all(&fdt_domain_cpus);
 	fdt_for_each_subnode(cpu_offset, fdt, cpus_offset) {
 		err = fdt_parse_hart_id(fdt, cpu_offset, &hartid);
-		if (err)
+		if (err || SBI_HARTMASK_MAX_BITS <= hartid)
 			continue;
 
-		if (hartid != cold_hartid)
+		/* The first CPU DT node of a HART counts */
+		if (sbi_hartmask_test_hart(hartid, &fdt_domain_cpus))
 			continue;
+		sbi_hartmask_set_hart(hartid, &fdt_domain_cpus);
 
 		val = fdt_getprop(fdt, cpu_offset, "opensbi-domain", &len);
 		if (val && len >= 4)
-			cold_domain_offset = fdt_node_offset_by_phandle(fdt,
-							   fdt32_to_cpu(*val));
-
-		break;
+			fdt_domain_hart_offset[hartid] =
+				fdt_index_offset_by_phandle(fdt,
+							fdt32_to_cpu(*val));
+		else
+			fdt_domain_hart_offset[hartid] = SBI_EINVAL;
+
+		if (hartid == cold_hartid)
+			cold_domain_offset = fdt_domain_hart_offset[hartid];
 	}
 
 	/* Iterate over each domain in FDT and populate details */
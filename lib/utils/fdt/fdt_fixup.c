@@ -11,27 +11,165 @@
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_domain.h>
 #include <sbi/sbi_math.h>
+#include <sbi/sbi_measure.h>
 #include <sbi/sbi_hart.h>
+#include <sbi/sbi_pmu_sample.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_string.h>
+#include <sbi/sbi_trace.h>
 #include <sbi_utils/fdt/fdt_fixup.h>
 #include <sbi_utils/fdt/fdt_helper.h>
+#include <sbi_utils/fdt/fdt_index.h>
+
+/* Space estimates of the fix-ups done by fdt_fixups_expand() callers */
+#define FDT_CPU_FIXUP_SPACE		128
+#define FDT_PLIC_FIXUP_SPACE		0
+#define FDT_RESV_MEMORY_FIXUP_SPACE	1024
+#define FDT_DOMAIN_FIXUP_SPACE		256
+
+/* Maximum number of M-mode only ranges merged into reserved memory nodes */
+#define FDT_RESV_MEMORY_RANGES_MAX	16
+
+struct fdt_resv_range {
+	unsigned long addr;
+	unsigned long end;
+};
+
+int fdt_fixup_reserve(void *fdt, int space)
+{
+	int used;
+
+	/*
+	 * Free space of a blob in libfdt's read-write layout is after the
+	 * strings block. Only rewrite the blob when that is not enough,
+	 * because fdt_open_into() moves the whole blob.
+	 */
+	if (fdt_check_header(fdt))
+		return -FDT_ERR_BADMAGIC;
+	used = fdt_off_dt_strings(fdt) + fdt_size_dt_strings(fdt);
+	if (fdt_version(fdt) >= 17 &&
+	    fdt_off_mem_rsvmap(fdt) < fdt_off_dt_struct(fdt) &&
+	    (fdt_off_dt_struct(fdt) + fdt_size_dt_struct(fdt)) <=
+	    fdt_off_dt_strings(fdt) &&
+	    used <= fdt_totalsize(fdt) && space <= fdt_totalsize(fdt) - used)
+		return 0;
+
+	fdt_index_invalidate();
+	return fdt_open_into(fdt, fdt, fdt_totalsize(fdt) + space);
+}
+
+int fdt_overlays_apply(void *fdt, void *overlays)
+{
+	int err, size;
+	char *fdto = overlays;
+	bool trusted = fdt_trusted();
+
+	/* The overlays are not covered by fdt_trust() of the DTB */
+	fdt_untrust();
+	err = 0;
+	while (!err && fdt_magic(fdto) == FDT_MAGIC) {
+		err = fdt_check_header(fdto);
+		if (err)
+			break;
+
+		/* An overlay can't grow the blob by more than its own size */
+		size = fdt_totalsize(fdto);
+		err = fdt_fixup_reserve(fdt, size);
+		if (err)
+			break;
+
+		fdt_index_invalidate();
+		err = fdt_overlay_apply(fdt, fdto);
+		if (err)
+			break;
+
+		fdto += (size + 7) & ~7;
+	}
+
+	/* Check the result once instead of every later access */
+	if (!err && trusted)
+		fdt_trust(fdt, FALSE);
+
+	return err;
+}
+
+int fdt_fixups_expand(void *fdt)
+{
+	int cpus_offset, cpu_offset, space;
+
+	space = FDT_PLIC_FIXUP_SPACE + FDT_RESV_MEMORY_FIXUP_SPACE +
+		FDT_DOMAIN_FIXUP_SPACE;
+	cpus_offset = fdt_path_offset(fdt, "/cpus");
+	if (cpus_offset >= 0)
+		fdt_for_each_subnode(cpu_offset, fdt, cpus_offset)
+			space += FDT_CPU_FIXUP_SPACE;
+
+	return fdt_fixup_reserve(fdt, space);
+}
+
+static struct sbi_scratch *fdt_cpu_detected_scratch(u32 hartid)
+{
+	struct sbi_scratch *scratch = sbi_hartid_to_scratch(hartid);
+
+	return (scratch && sbi_hart_features_detected(scratch)) ?
+		scratch : NULL;
+}
+
+/*
+ * HARTs which have not been started yet take the probed features of a
+ * HART of the same class, that is with the same compatible strings.
+ */
+static struct sbi_scratch *fdt_cpu_class_scratch(void *fdt, int cpus_offset,
+						 int cpu_offset, u32 hartid)
+{
+	struct sbi_scratch *scratch;
+	const char *compat, *other;
+	int len, olen, offset;
+	u32 ohartid;
+
+	scratch = fdt_cpu_detected_scratch(hartid);
+	if (scratch)
+		return scratch;
+
+	compat = fdt_getprop(fdt, cpu_offset, "compatible", &len);
+	if (!compat || len <= 0)
+		return NULL;
+
+	fdt_for_each_subnode(offset, fdt, cpus_offset) {
+		other = fdt_getprop(fdt, offset, "compatible", &olen);
+		if (!other || olen != len || sbi_memcmp(other, compat, len) ||
+		    fdt_parse_hart_id(fdt, offset, &ohartid))
+			continue;
+
+		scratch = fdt_cpu_detected_scratch(ohartid);
+		if (scratch)
+			return scratch;
+	}
+
+	return NULL;
+}
 
 void fdt_cpu_fixup(void *fdt)
 {
 	struct sbi_domain *dom = sbi_domain_thishart_ptr();
 	int err, cpu_offset, cpus_offset, len;
-	const char *mmu_type;
+	struct sbi_scratch *scratch;
+	const char *mmu_type, *perf;
+	unsigned long block_size;
 	u32 hartid;
 
-	err = fdt_open_into(fdt, fdt, fdt_totalsize(fdt) + 32);
-	if (err < 0)
-		return;
-
 	cpus_offset = fdt_path_offset(fdt, "/cpus");
 	if (cpus_offset < 0)
 		return;
 
+	/* Node offsets stay valid when the blob is expanded */
+	len = 0;
+	fdt_for_each_subnode(cpu_offset, fdt, cpus_offset)
+		len++;
+	err = fdt_fixup_reserve(fdt, len * FDT_CPU_FIXUP_SPACE);
+	if (err < 0)
+		return;
+
 	fdt_for_each_subnode(cpu_offset, fdt, cpus_offset) {
 		err = fdt_parse_hart_id(fdt, cpu_offset, &hartid);
 		if (err)
@@ -47,21 +185,47 @@ void fdt_cpu_fixup(void *fdt)
 		if (!sbi_domain_is_assigned_hart(dom, hartid) ||
 		    !mmu_type || !len)
 			fdt_setprop_string(fdt, cpu_offset, "status", "");
+
+		scratch = fdt_cpu_class_scratch(fdt, cpus_offset,
+						cpu_offset, hartid);
+		if (!scratch)
+			continue;
+
+		/* Let S-mode pick misaligned access strategies upfront */
+		perf = sbi_hart_misaligned_perf2string(
+					sbi_hart_misaligned_perf(scratch));
+		if (perf)
+			fdt_setprop_string(fdt, cpu_offset,
+				"riscv,misaligned-access-performance", perf);
+
+		/* S-mode needs the block size to use CBO.ZERO at all */
+		block_size = sbi_hart_cboz_block_size(scratch);
+		if (block_size &&
+		    !fdt_getprop(fdt, cpu_offset, "riscv,cboz-block-size", NULL))
+			fdt_setprop_u32(fdt, cpu_offset,
+					"riscv,cboz-block-size", block_size);
 	}
 }
 
+static const struct fdt_match plic_fixup_match[] = {
+	{ .compatible = "sifive,plic-1.0.0" },
+	{ .compatible = "riscv,plic0" },
+	{ },
+};
+
 void fdt_plic_fixup(void *fdt)
 {
 	u32 *cells;
 	int i, cells_count;
 	int plic_off;
 
-	plic_off = fdt_node_offset_by_compatible(fdt, 0, "sifive,plic-1.0.0");
-	if (plic_off < 0) {
-		plic_off = fdt_node_offset_by_compatible(fdt, 0, "riscv,plic0");
+	/* Look for both compatible strings in one walk of the tree */
+	plic_off = 0;
+	do {
+		plic_off = fdt_next_node(fdt, plic_off, NULL);
 		if (plic_off < 0)
 			return;
-	}
+	} while (!fdt_match_node(fdt, plic_off, plic_fixup_match));
 
 	cells = (u32 *)fdt_getprop(fdt, plic_off,
 				   "interrupts-extended", &cells_count);
@@ -78,9 +242,9 @@ void fdt_plic_fixup(void *fdt)
 	}
 }
 
-static int fdt_resv_memory_update_node(void *fdt, unsigned long addr,
-				       unsigned long size, int index,
-				       int parent, bool no_map)
+static int fdt_resv_memory_update_node(void *fdt, const char *prefix,
+				       unsigned long addr, unsigned long size,
+				       int index, int parent, bool no_map)
 {
 	int na = fdt_address_cells(fdt, 0);
 	int ns = fdt_size_cells(fdt, 0);
@@ -98,11 +262,11 @@ static int fdt_resv_memory_update_node(void *fdt, unsigned long addr,
 
 	if (na > 1 && addr_high)
 		sbi_snprintf(name, sizeof(name),
-			     "mmode_resv%d@%x,%x", index,
+			     "%s%d@%x,%x", prefix, index,
 			     addr_high, addr_low);
 	else
 		sbi_snprintf(name, sizeof(name),
-			     "mmode_resv%d@%x", index,
+			     "%s%d@%x", prefix, index,
 			     addr_low);
 
 	subnode = fdt_add_subnode(fdt, parent, name);
@@ -134,7 +298,83 @@ static int fdt_resv_memory_update_node(void *fdt, unsigned long addr,
 	if (err < 0)
 		return err;
 
-	return 0;
+	return subnode;
+}
+
+static bool fdt_resv_memory_is_hole(const struct sbi_domain_memregion *reg,
+				    unsigned long addr, unsigned long end)
+{
+	unsigned long rwx = SBI_DOMAIN_MEMREGION_READABLE |
+			    SBI_DOMAIN_MEMREGION_WRITEABLE |
+			    SBI_DOMAIN_MEMREGION_EXECUTABLE;
+
+	if ((reg->flags & SBI_DOMAIN_MEMREGION_MMIO) ||
+	    (reg->flags & rwx) != rwx ||
+	    __riscv_xlen <= reg->order)
+		return FALSE;
+
+	return (addr <= reg->base && reg->base + BIT(reg->order) <= end) ?
+		TRUE : FALSE;
+}
+
+/*
+ * Find the lowest region at or above addr inside [addr, end) which has been
+ * given to S-mode entirely. The cold boot only part of the firmware is only
+ * added to the root domain right before the next booting stage starts so
+ * it is passed separately as init_reg.
+ */
+static const struct sbi_domain_memregion *fdt_resv_memory_next_hole(
+				const struct sbi_domain *dom,
+				const struct sbi_domain_memregion *init_reg,
+				unsigned long addr, unsigned long end)
+{
+	const struct sbi_domain_memregion *reg, *ret = NULL;
+
+	sbi_domain_for_each_memregion(dom, reg) {
+		if (!fdt_resv_memory_is_hole(reg, addr, end))
+			continue;
+		if (!ret || reg->base < ret->base)
+			ret = reg;
+	}
+	if (init_reg && fdt_resv_memory_is_hole(init_reg, addr, end) &&
+	    (!ret || init_reg->base < ret->base))
+		ret = init_reg;
+
+	return ret;
+}
+
+/*
+ * Add [addr, end) to the address ordered ranges, merging it with the
+ * ranges it overlaps or touches. Returns the new number of ranges or
+ * a negative value when the range does not fit.
+ */
+static int fdt_resv_range_add(struct fdt_resv_range *ranges, int count,
+			      unsigned long addr, unsigned long end)
+{
+	int i, j;
+
+	for (i = 0; i < count && ranges[i].end < addr; i++)
+		;
+
+	if (i < count && ranges[i].addr <= end) {
+		if (addr < ranges[i].addr)
+			ranges[i].addr = addr;
+		for (j = i + 1; j < count && ranges[j].addr <= end; j++)
+			end = (end < ranges[j].end) ? ranges[j].end : end;
+		if (ranges[i].end < end)
+			ranges[i].end = end;
+		sbi_memmove(&ranges[i + 1], &ranges[j],
+			    (count - j) * sizeof(*ranges));
+		return count - (j - i - 1);
+	}
+
+	if (count == FDT_RESV_MEMORY_RANGES_MAX)
+		return -1;
+	sbi_memmove(&ranges[i + 1], &ranges[i], (count - i) * sizeof(*ranges));
+	ranges[i].addr = addr;
+	ranges[i].end = end;
+
+	return count + 1;
 }
 
 /**
@@ -154,11 +394,16 @@ static int fdt_resv_memory_update_node(void *fdt, unsigned long addr,
  */
 int fdt_reserved_memory_fixup(void *fdt)
 {
-	struct sbi_domain_memregion *reg;
+	struct sbi_domain_memregion *reg, init_reg;
+	const struct sbi_domain_memregion *hole;
 	struct sbi_domain *dom = sbi_domain_thishart_ptr();
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
-	unsigned long addr, size;
-	int err, parent, i;
+	bool init_valid = (sbi_domain_fw_init_region(scratch, &init_reg)) ?
+			  FALSE : TRUE;
+	unsigned long addr, end, size;
+	struct fdt_resv_range ranges[FDT_RESV_MEMORY_RANGES_MAX];
+	int err, parent, i, j, count = 0, rc;
+	bool no_map = (sbi_hart_pmp_count(scratch)) ? false : true;
 	int na = fdt_address_cells(fdt, 0);
 	int ns = fdt_size_cells(fdt, 0);
 
@@ -169,7 +414,7 @@ int fdt_reserved_memory_fixup(void *fdt)
 	 * Each PMP memory region entry occupies 64 bytes.
 	 * With 16 PMP memory regions we need 64 * 16 = 1024 bytes.
 	 */
-	err = fdt_open_into(fdt, fdt, fdt_totalsize(fdt) + 1024);
+	err = fdt_fixup_reserve(fdt, FDT_RESV_MEMORY_FIXUP_SPACE);
 	if (err < 0)
 		return err;
 
@@ -208,7 +453,9 @@ int fdt_reserved_memory_fixup(void *fdt)
 	 * Some additional memory spaces may be protected by domain memory
 	 * regions.
 	 *
-	 * With above assumption, we create child nodes directly.
+	 * With above assumption, we create child nodes directly. Adjacent
+	 * ranges (such as the firmware region and the stacks placed after
+	 * it) are merged so S-mode sees as few reserved ranges as possible.
 	 */
 
 	i = 0;
@@ -223,11 +470,69 @@ int fdt_reserved_memory_fixup(void *fdt)
 		if (reg->flags & SBI_DOMAIN_MEMREGION_EXECUTABLE)
 			continue;
 
+		/* Leave out the parts which have been given to S-mode */
 		addr = reg->base;
-		size = 1UL << reg->order;
-		fdt_resv_memory_update_node(fdt, addr, size, i, parent,
-			(sbi_hart_pmp_count(scratch)) ? false : true);
-		i++;
+		end = addr + (1UL << reg->order);
+		while (addr < end) {
+			hole = fdt_resv_memory_next_hole(dom,
+					(init_valid) ? &init_reg : NULL,
+					addr, end);
+			size = ((hole) ? hole->base : end) - addr;
+			rc = -1;
+			if (size)
+				rc = fdt_resv_range_add(ranges, count,
+							addr, addr + size);
+			if (0 <= rc) {
+				count = rc;
+			} else if (size) {
+				fdt_resv_memory_update_node(fdt, "mmode_resv",
+					addr, size, i, parent, no_map);
+				i++;
+			}
+			if (!hole)
+				break;
+			addr = hole->base + BIT(hole->order);
+		}
+	}
+
+	for (j = 0; j < count; j++, i++)
+		fdt_resv_memory_update_node(fdt, "mmode_resv", ranges[j].addr,
+				ranges[j].end - ranges[j].addr, i, parent, no_map);
+
+	/* The trace buffer is readable (and mappable) by S-mode */
+	if (!sbi_trace_get_buffer(&addr, &size)) {
+		err = fdt_resv_memory_update_node(fdt, "opensbi_trace", addr,
+						  size, 0, parent, false);
+		if (err < 0)
+			return err;
+		err = fdt_setprop_string(fdt, err, "compatible",
+					 "opensbi,trace-buffer");
+		if (err < 0)
+			return err;
+	}
+
+	/* So is the measured boot event log */
+	if (!sbi_measure_get_log(&addr, &size)) {
+		err = fdt_resv_memory_update_node(fdt, "opensbi_measure", addr,
+						  size, 0, parent, false);
+		if (err < 0)
+			return err;
+		err = fdt_setprop_string(fdt, err, "compatible",
+					 "opensbi,measurement-log");
+		if (err < 0)
+			return err;
+	}
+
+	/* And the PMU sample buffer */
+	if (!sbi_pmu_sample_get_buffer(&addr, &size)) {
+		err = fdt_resv_memory_update_node(fdt, "opensbi_pmu_sample",
+						  addr, size, 0, parent, false);
+		if (err < 0)
+			return err;
+		err = fdt_setprop_string(fdt, err, "compatible",
+					 "opensbi,pmu-sample-buffer");
+		if (err < 0)
+			return err;
 	}
 
 	return 0;
@@ -9,10 +9,16 @@
 #include <libfdt.h>
 #include <sbi/riscv_asm.h>
 #include <sbi/sbi_console.h>
+#include <sbi/sbi_hart.h>
 #include <sbi/sbi_hartmask.h>
+#include <sbi/sbi_math.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
 #include <sbi_utils/fdt/fdt_helper.h>
+#include <sbi_utils/fdt/fdt_index.h>
+#include <sbi_utils/irqchip/aplic.h>
+#include <sbi_utils/irqchip/imsic.h>
 #include <sbi_utils/irqchip/plic.h>
 #include <sbi_utils/sys/clint.h>
 
@@ -58,7 +64,7 @@ int fdt_find_match(void *fdt, int startoff,
 		return SBI_ENODEV;
 
 	while (match_table->compatible) {
-		nodeoff = fdt_node_offset_by_compatible(fdt, startoff,
+		nodeoff = fdt_index_offset_by_compatible(fdt, startoff,
 						match_table->compatible);
 		if (nodeoff >= 0) {
 			if (out_match)
@@ -109,8 +115,8 @@ static int fdt_translate_address(void *fdt, uint64_t reg, int parent,
 	return 0;
 }
 
-int fdt_get_node_addr_size(void *fdt, int node, unsigned long *addr,
-			   unsigned long *size)
+int fdt_get_node_addr_size_by_index(void *fdt, int node, int index,
+				    unsigned long *addr, unsigned long *size)
 {
 	int parent, len, i, rc;
 	int cell_addr, cell_size;
@@ -128,9 +134,16 @@ int fdt_get_node_addr_size(void *fdt, int node, unsigned long *addr,
 	if (cell_size < 0)
 		return SBI_ENODEV;
 
+	if (index < 0)
+		return SBI_EINVAL;
+
 	prop_addr = fdt_getprop(fdt, node, "reg", &len);
 	if (!prop_addr)
 		return SBI_ENODEV;
+	if ((index + 1) * (cell_addr + cell_size) * sizeof(fdt32_t) > len)
+		return SBI_EINVAL;
+
+	prop_addr = prop_addr + ((cell_addr + cell_size) * index);
 	prop_size = prop_addr + cell_addr;
 
 	if (addr) {
@@ -157,6 +170,12 @@ int fdt_get_node_addr_size(void *fdt, int node, unsigned long *addr,
 	return 0;
 }
 
+int fdt_get_node_addr_size(void *fdt, int node, unsigned long *addr,
+			   unsigned long *size)
+{
+	return fdt_get_node_addr_size_by_index(fdt, node, 0, addr, size);
+}
+
 int fdt_parse_hart_id(void *fdt, int cpu_offset, u32 *hartid)
 {
 	int len;
@@ -185,10 +204,252 @@ int fdt_parse_hart_id(void *fdt, int cpu_offset, u32 *hartid)
 	return 0;
 }
 
-int fdt_parse_max_hart_id(void *fdt, u32 *max_hartid)
+/* ISA extensions which map to SBI_HART_HAS_xyz features */
+static const struct {
+	const char *name;
+	unsigned long feature;
+} fdt_isa_exts[] = {
+	{ "sscofpmf",	SBI_HART_HAS_SSCOFPMF },
+	{ "sstc",	SBI_HART_HAS_SSTC },
+	{ "svinval",	SBI_HART_HAS_SVINVAL },
+	{ "svpbmt",	SBI_HART_HAS_SVPBMT },
+	{ "zacas",	SBI_HART_HAS_ZACAS },
+	{ "zawrs",	SBI_HART_HAS_ZAWRS },
+	{ "zicbom",	SBI_HART_HAS_ZICBOM },
+	{ "zicboz",	SBI_HART_HAS_ZICBOZ },
+};
+
+#define FDT_ISA_EXTS_MASK	(SBI_HART_HAS_SSCOFPMF | SBI_HART_HAS_SSTC | \
+				 SBI_HART_HAS_SVINVAL | SBI_HART_HAS_ZACAS | \
+				 SBI_HART_HAS_ZAWRS | SBI_HART_HAS_ZICBOM | \
+				 SBI_HART_HAS_ZICBOZ | SBI_HART_HAS_SVPBMT)
+
+static unsigned long fdt_isa_ext_feature(const char *name, size_t len)
+{
+	int i;
+
+	for (i = 0; i < array_size(fdt_isa_exts); i++) {
+		if (sbi_strlen(fdt_isa_exts[i].name) == len &&
+		    !sbi_strncmp(fdt_isa_exts[i].name, name, len))
+			return fdt_isa_exts[i].feature;
+	}
+
+	return 0;
+}
+
+/*
+ * Parse the riscv,isa-extensions string list or, for older device trees,
+ * the multi-letter extensions of the riscv,isa string.
+ */
+static bool fdt_parse_isa_features(void *fdt, int cpu_offset,
+				   unsigned long *features)
+{
+	int len, n;
+	const char *isa, *end;
+
+	*features = 0;
+
+	isa = fdt_getprop(fdt, cpu_offset, "riscv,isa-extensions", &len);
+	if (isa && len > 0) {
+		for (end = isa + len; isa < end; isa += n + 1) {
+			n = sbi_strnlen(isa, end - isa);
+			*features |= fdt_isa_ext_feature(isa, n);
+		}
+		return TRUE;
+	}
+
+	isa = fdt_getprop(fdt, cpu_offset, "riscv,isa", &len);
+	if (!isa || len < 5 || sbi_strncmp(isa, "rv", 2))
+		return FALSE;
+
+	end = isa + sbi_strnlen(isa, len);
+	isa += 4;
+	while (isa < end) {
+		/* Single-letter extensions end at '_', 's', 'x' or 'z' */
+		if (*isa != '_' && *isa != 's' && *isa != 'x' && *isa != 'z') {
+			isa++;
+			continue;
+		}
+		if (*isa == '_')
+			isa++;
+		for (n = 0; isa + n < end && isa[n] != '_'; n++)
+			;
+		*features |= fdt_isa_ext_feature(isa, n);
+		isa += n;
+	}
+
+	return TRUE;
+}
+
+/*
+ * CPU DT nodes parsed by fdt_parse_cpus(). The cache is keyed by the
+ * blob sizes and not its address because the firmware copies the FDT
+ * after fw_platform_init() and the parsed values don't depend on node
+ * offsets. It is reparsed when the blob changed size.
+ */
+static u32 fdt_cpus_count;
+static bool fdt_cpus_valid;
+static u32 fdt_cpus_struct_size, fdt_cpus_strings_size;
+static struct fdt_cpu fdt_cpus[SBI_HARTMASK_MAX_BITS];
+
+int fdt_parse_cpus(void *fdt, const struct fdt_cpu **out_cpus, u32 *out_count)
 {
 	u32 hartid;
-	int err, cpu_offset, cpus_offset;
+	const fdt32_t *val;
+	struct fdt_cpu *cpu;
+	int err, len, cpus_offset, cpu_offset, child;
+
+	if (!fdt)
+		return SBI_EINVAL;
+
+	if (!fdt_cpus_valid ||
+	    fdt_cpus_struct_size != fdt_size_dt_struct(fdt) ||
+	    fdt_cpus_strings_size != fdt_size_dt_strings(fdt)) {
+		fdt_cpus_valid = FALSE;
+		fdt_cpus_count = 0;
+
+		cpus_offset = fdt_path_offset(fdt, "/cpus");
+		if (cpus_offset < 0)
+			return cpus_offset;
+
+		fdt_for_each_subnode(cpu_offset, fdt, cpus_offset) {
+			/* HART ids beyond the HART mask are unusable */
+			err = fdt_parse_hart_id(fdt, cpu_offset, &hartid);
+			if (err || SBI_HARTMASK_MAX_BITS <= hartid)
+				continue;
+
+			if (fdt_cpus_count == array_size(fdt_cpus))
+				return SBI_ENOSPC;
+
+			cpu = &fdt_cpus[fdt_cpus_count++];
+			cpu->hartid = hartid;
+			cpu->phandle = fdt_get_phandle(fdt, cpu_offset);
+			cpu->mmu = (fdt_getprop(fdt, cpu_offset, "mmu-type",
+						&len) && len) ? TRUE : FALSE;
+			if (fdt_parse_numa_node_id(fdt, cpu_offset,
+						   &cpu->numa_node))
+				cpu->numa_node = -1U;
+			if (fdt_parse_cpu_cluster(fdt, cpu_offset,
+						  &cpu->cluster))
+				cpu->cluster = -1U;
+
+			val = fdt_getprop(fdt, cpu_offset, "riscv,pmp-regions",
+					  &len);
+			cpu->pmp_count = (val && len >= 4) ?
+					 fdt32_to_cpu(*val) : -1U;
+			cpu->isa_valid = fdt_parse_isa_features(fdt, cpu_offset,
+							&cpu->isa_features);
+
+			cpu->intc_phandle = 0;
+			fdt_for_each_subnode(child, fdt, cpu_offset) {
+				if (!fdt_getprop(fdt, child,
+						 "interrupt-controller", NULL))
+					continue;
+				cpu->intc_phandle = fdt_get_phandle(fdt, child);
+				break;
+			}
+		}
+
+		fdt_cpus_struct_size = fdt_size_dt_struct(fdt);
+		fdt_cpus_strings_size = fdt_size_dt_strings(fdt);
+		fdt_cpus_valid = TRUE;
+	}
+
+	if (out_cpus)
+		*out_cpus = fdt_cpus;
+	if (out_count)
+		*out_count = fdt_cpus_count;
+
+	return 0;
+}
+
+int fdt_parse_hart_desc(void *fdt, u32 hartid, struct sbi_hart_desc *desc)
+{
+	int err;
+	u32 i, count;
+	const struct fdt_cpu *cpus;
+
+	if (!desc)
+		return SBI_EINVAL;
+
+	err = fdt_parse_cpus(fdt, &cpus, &count);
+	if (err)
+		return err;
+
+	for (i = 0; i < count; i++) {
+		if (cpus[i].hartid != hartid)
+			continue;
+
+		if (cpus[i].pmp_count != -1U) {
+			desc->valid |= SBI_HART_DESC_PMP_COUNT;
+			desc->pmp_count = cpus[i].pmp_count;
+		}
+		if (cpus[i].isa_valid) {
+			desc->features = cpus[i].isa_features;
+			desc->features_known = FDT_ISA_EXTS_MASK;
+		}
+		return 0;
+	}
+
+	return SBI_ENOENT;
+}
+
+int fdt_parse_hart_id_by_phandle(void *fdt, u32 phandle, u32 *hartid)
+{
+	u32 i, count;
+	int cpu_offset;
+	const struct fdt_cpu *cpus;
+
+	if (fdt_parse_cpus(fdt, &cpus, &count)) {
+		cpu_offset = fdt_index_offset_by_phandle(fdt, phandle);
+		if (cpu_offset < 0)
+			return cpu_offset;
+		return fdt_parse_hart_id(fdt, cpu_offset, hartid);
+	}
+
+	for (i = 0; i < count; i++) {
+		if (phandle && cpus[i].phandle == phandle) {
+			if (hartid)
+				*hartid = cpus[i].hartid;
+			return 0;
+		}
+	}
+
+	return SBI_ENOENT;
+}
+
+int fdt_parse_hart_id_by_intc(void *fdt, u32 intc_phandle, u32 *hartid)
+{
+	u32 i, count;
+	int cpu_offset;
+	const struct fdt_cpu *cpus;
+
+	if (fdt_parse_cpus(fdt, &cpus, &count)) {
+		cpu_offset = fdt_index_offset_by_phandle(fdt, intc_phandle);
+		if (cpu_offset < 0)
+			return cpu_offset;
+		cpu_offset = fdt_parent_offset(fdt, cpu_offset);
+		if (cpu_offset < 0)
+			return cpu_offset;
+		return fdt_parse_hart_id(fdt, cpu_offset, hartid);
+	}
+
+	for (i = 0; i < count; i++) {
+		if (intc_phandle && cpus[i].intc_phandle == intc_phandle) {
+			if (hartid)
+				*hartid = cpus[i].hartid;
+			return 0;
+		}
+	}
+
+	return SBI_ENOENT;
+}
+
+int fdt_parse_max_hart_id(void *fdt, u32 *max_hartid)
+{
+	u32 i, count;
+	int err;
+	const struct fdt_cpu *cpus;
 
 	if (!fdt)
 		return SBI_EINVAL;
@@ -197,22 +458,232 @@ int fdt_parse_max_hart_id(void *fdt, u32 *max_hartid)
 
 	*max_hartid = 0;
 
+	err = fdt_parse_cpus(fdt, &cpus, &count);
+	if (err)
+		return err;
+
+	for (i = 0; i < count; i++) {
+		if (cpus[i].hartid > *max_hartid)
+			*max_hartid = cpus[i].hartid;
+	}
+
+	return 0;
+}
+
+int fdt_parse_timebase_frequency(void *fdt, unsigned long *freq)
+{
+	u64 tbfreq;
+	const fdt32_t *val;
+	int len, cpus_offset;
+
+	if (!fdt || !freq)
+		return SBI_EINVAL;
+
 	cpus_offset = fdt_path_offset(fdt, "/cpus");
 	if (cpus_offset < 0)
 		return cpus_offset;
 
+	val = fdt_getprop(fdt, cpus_offset, "timebase-frequency", &len);
+	if (!val || len < sizeof(fdt32_t))
+		return SBI_ENOENT;
+
+	/* The frequency may be given with one or two cells */
+	tbfreq = fdt32_to_cpu(val[0]);
+	if (len >= 2 * sizeof(fdt32_t))
+		tbfreq = (tbfreq << 32) | fdt32_to_cpu(val[1]);
+	*freq = tbfreq;
+
+	return 0;
+}
+
+int fdt_parse_cbom_block_size(void *fdt, unsigned long *size)
+{
+	const fdt32_t *val;
+	int len, cpus_offset, cpu_offset;
+
+	if (!fdt || !size)
+		return SBI_EINVAL;
+
+	cpus_offset = fdt_path_offset(fdt, "/cpus");
+	if (cpus_offset < 0)
+		return cpus_offset;
+
+	/* All HARTs are assumed to have the same cache block size */
 	fdt_for_each_subnode(cpu_offset, fdt, cpus_offset) {
-		err = fdt_parse_hart_id(fdt, cpu_offset, &hartid);
-		if (err)
+		val = fdt_getprop(fdt, cpu_offset, "riscv,cbom-block-size",
+				  &len);
+		if (val && len >= sizeof(fdt32_t)) {
+			*size = fdt32_to_cpu(*val);
+			return 0;
+		}
+	}
+
+	return SBI_ENOENT;
+}
+
+int fdt_parse_numa_node_id(void *fdt, int nodeoff, u32 *node_id)
+{
+	int len;
+	const fdt32_t *val;
+
+	if (!fdt || nodeoff < 0)
+		return SBI_EINVAL;
+
+	val = fdt_getprop(fdt, nodeoff, "numa-node-id", &len);
+	if (!val || len < sizeof(fdt32_t))
+		return SBI_ENOENT;
+
+	if (node_id)
+		*node_id = fdt32_to_cpu(*val);
+
+	return 0;
+}
+
+/* Maximum length of the next-level-cache chain of a CPU */
+#define FDT_CACHE_LEVELS_MAX		8
+
+/*
+ * The cluster of a CPU is the cpu-map cluster node holding the core (or
+ * thread) node which references the CPU. Without a cpu-map, CPUs sharing
+ * their last level cache form a cluster. The id is the offset of the
+ * cluster or cache node so it is only meaningful until the FDT changes.
+ */
+int fdt_parse_cpu_cluster(void *fdt, int cpu_offset, u32 *cluster)
+{
+	int i, len, map, node, parent;
+	const fdt32_t *val;
+	fdt32_t phandle;
+	const char *name;
+
+	if (!fdt || cpu_offset < 0 || !cluster)
+		return SBI_EINVAL;
+
+	phandle = cpu_to_fdt32(fdt_get_phandle(fdt, cpu_offset));
+	map = fdt_path_offset(fdt, "/cpus/cpu-map");
+	node = (phandle && map >= 0) ?
+		fdt_node_offset_by_prop_value(fdt, map, "cpu", &phandle,
+					      sizeof(phandle)) : -1;
+	for (; node >= 0; node = fdt_node_offset_by_prop_value(fdt, node,
+						"cpu", &phandle, sizeof(phandle))) {
+		/* Only nodes inside the cpu-map count */
+		for (i = fdt_parent_offset(fdt, node); i > map;
+		     i = fdt_parent_offset(fdt, i))
+			;
+		if (i != map)
+			break;
+
+		name = fdt_get_name(fdt, node, NULL);
+		if (name && !sbi_strncmp(name, "thread", 6))
+			node = fdt_parent_offset(fdt, node);
+		parent = fdt_parent_offset(fdt, node);
+		if (parent < 0 || parent == map)
+			break;
+
+		*cluster = parent;
+		return 0;
+	}
+
+	node = cpu_offset;
+	for (i = 0; i < FDT_CACHE_LEVELS_MAX; i++) {
+		val = fdt_getprop(fdt, node, "next-level-cache", &len);
+		if (!val || len < sizeof(fdt32_t))
+			break;
+		parent = fdt_node_offset_by_phandle(fdt, fdt32_to_cpu(*val));
+		if (parent < 0)
+			break;
+		node = parent;
+	}
+	if (node == cpu_offset)
+		return SBI_ENOENT;
+
+	*cluster = node;
+	return 0;
+}
+
+int fdt_parse_numa_memory(void *fdt, u32 node_id, unsigned long *addr,
+			  unsigned long *size)
+{
+	u32 nid;
+	int i, err, nodeoff = -1;
+	unsigned long raddr, rsize, best_addr = 0, best_size = 0;
+
+	if (!fdt || !addr || !size)
+		return SBI_EINVAL;
+
+	/* Pick the highest memory range of the NUMA node */
+	while (1) {
+		nodeoff = fdt_node_offset_by_prop_value(fdt, nodeoff,
+					"device_type", "memory",
+					sizeof("memory"));
+		if (nodeoff < 0)
+			break;
+
+		err = fdt_parse_numa_node_id(fdt, nodeoff, &nid);
+		if (err || nid != node_id)
 			continue;
 
-		if (hartid > *max_hartid)
-			*max_hartid = hartid;
+		for (i = 0; ; i++) {
+			err = fdt_get_node_addr_size_by_index(fdt, nodeoff, i,
+							      &raddr, &rsize);
+			if (err)
+				break;
+			if (rsize && best_addr + best_size <= raddr) {
+				best_addr = raddr;
+				best_size = rsize;
+			}
+		}
 	}
 
+	if (!best_size)
+		return SBI_ENOENT;
+
+	*addr = best_addr;
+	*size = best_size;
+
 	return 0;
 }
 
+int fdt_check_free_memory(void *fdt, unsigned long addr, unsigned long size)
+{
+	int i, err, nodeoff = -1;
+	u64 rsv_addr, rsv_size;
+	unsigned long raddr, rsize, end = addr + size;
+	unsigned long fdt_start = (unsigned long)fdt;
+
+	if (!fdt || !size || end < addr || fdt_check_header(fdt))
+		return SBI_EINVAL;
+
+	/* The FDT and the memory it reserves must stay intact */
+	if (addr < fdt_start + fdt_totalsize(fdt) && fdt_start < end)
+		return SBI_EINVALID_ADDR;
+	for (i = 0; i < fdt_num_mem_rsv(fdt); i++) {
+		if (fdt_get_mem_rsv(fdt, i, &rsv_addr, &rsv_size))
+			break;
+		if (addr < rsv_addr + rsv_size && rsv_addr < end)
+			return SBI_EINVALID_ADDR;
+	}
+
+	/* The range has to be inside one memory range */
+	while (1) {
+		nodeoff = fdt_node_offset_by_prop_value(fdt, nodeoff,
+					"device_type", "memory",
+					sizeof("memory"));
+		if (nodeoff < 0)
+			break;
+
+		for (i = 0; ; i++) {
+			err = fdt_get_node_addr_size_by_index(fdt, nodeoff, i,
+							      &raddr, &rsize);
+			if (err)
+				break;
+			if (raddr <= addr && end - raddr <= rsize)
+				return 0;
+		}
+	}
+
+	return SBI_ENOMEM;
+}
+
 int fdt_parse_shakti_uart_node(void *fdt, int nodeoffset,
 			       struct platform_uart_data *uart)
 {
@@ -339,7 +810,7 @@ int fdt_parse_uart8250(void *fdt, struct platform_uart_data *uart,
 	if (!compatible || !uart || !fdt)
 		return SBI_ENODEV;
 
-	nodeoffset = fdt_node_offset_by_compatible(fdt, -1, compatible);
+	nodeoffset = fdt_index_offset_by_compatible(fdt, -1, compatible);
 	if (nodeoffset < 0)
 		return nodeoffset;
 
@@ -374,19 +845,231 @@ int fdt_parse_plic(void *fdt, struct plic_data *plic, const char *compat)
 	if (!compat || !plic || !fdt)
 		return SBI_ENODEV;
 
-	nodeoffset = fdt_node_offset_by_compatible(fdt, -1, compat);
+	nodeoffset = fdt_index_offset_by_compatible(fdt, -1, compat);
 	if (nodeoffset < 0)
 		return nodeoffset;
 
 	return fdt_parse_plic_node(fdt, nodeoffset, plic);
 }
 
+static u32 fdt_getprop_u32(void *fdt, int nodeoff, const char *name,
+			   u32 default_val)
+{
+	int len;
+	const fdt32_t *val = fdt_getprop(fdt, nodeoff, name, &len);
+
+	if (!val || len < sizeof(fdt32_t))
+		return default_val;
+
+	return fdt32_to_cpu(*val);
+}
+
+int fdt_parse_imsic_node(void *fdt, int nodeoff, struct imsic_data *imsic)
+{
+	const fdt32_t *val;
+	struct imsic_regs *regs;
+	unsigned long reg_addr, reg_size;
+	int i, rc, len, nr_parent_irqs;
+
+	if (nodeoff < 0 || !imsic || !fdt)
+		return SBI_ENODEV;
+
+	imsic->targets_mmode = FALSE;
+	val = fdt_getprop(fdt, nodeoff, "interrupts-extended", &len);
+	if (!val || len < 2 * sizeof(fdt32_t))
+		return SBI_EINVAL;
+	len = len / sizeof(fdt32_t);
+	nr_parent_irqs = len / 2;
+	for (i = 0; i < len; i += 2) {
+		if (fdt32_to_cpu(val[i + 1]) == IRQ_M_EXT) {
+			imsic->targets_mmode = TRUE;
+			break;
+		}
+	}
+
+	imsic->guest_index_bits = fdt_getprop_u32(fdt, nodeoff,
+					"riscv,guest-index-bits", 0);
+	imsic->hart_index_bits = fdt_getprop_u32(fdt, nodeoff,
+					"riscv,hart-index-bits",
+					log2roundup(nr_parent_irqs));
+	imsic->group_index_bits = fdt_getprop_u32(fdt, nodeoff,
+					"riscv,group-index-bits", 0);
+	imsic->group_index_shift = fdt_getprop_u32(fdt, nodeoff,
+					"riscv,group-index-shift",
+					2 * IMSIC_MMIO_PAGE_SHIFT);
+	imsic->num_ids = fdt_getprop_u32(fdt, nodeoff, "riscv,num-ids", 0);
+	if (!imsic->num_ids)
+		return SBI_EINVAL;
+
+	for (i = 0; i < IMSIC_MAX_REGS; i++) {
+		regs = &imsic->regs[i];
+		regs->addr = 0;
+		regs->size = 0;
+	}
+
+	for (i = 0; i < IMSIC_MAX_REGS; i++) {
+		rc = fdt_get_node_addr_size_by_index(fdt, nodeoff, i,
+						     &reg_addr, &reg_size);
+		if (rc < 0 || !reg_addr || !reg_size)
+			break;
+		imsic->regs[i].addr = reg_addr;
+		imsic->regs[i].size = reg_size;
+	}
+
+	return (i) ? 0 : SBI_EINVAL;
+}
+
+bool fdt_check_imsic_mlevel(void *fdt)
+{
+	int noff = -1;
+	struct imsic_data imsic;
+
+	if (!fdt)
+		return FALSE;
+
+	while ((noff = fdt_index_offset_by_compatible(fdt, noff,
+						"riscv,imsics")) >= 0) {
+		if (!fdt_parse_imsic_node(fdt, noff, &imsic) &&
+		    imsic.targets_mmode)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static void fdt_aplic_msicfg(struct imsic_data *imsic,
+			     struct aplic_msicfg_data *msicfg)
+{
+	msicfg->lhxs = imsic->guest_index_bits;
+	msicfg->lhxw = imsic->hart_index_bits;
+	msicfg->hhxw = imsic->group_index_bits;
+	msicfg->hhxs = imsic->group_index_shift - 2 * IMSIC_MMIO_PAGE_SHIFT;
+	msicfg->base_addr = imsic->regs[0].addr;
+}
+
+/* Parse the IMSIC pointed by "msi-parent" of an APLIC node */
+static int fdt_parse_aplic_msi_parent(void *fdt, int nodeoff,
+				      struct imsic_data *imsic)
+{
+	int len, noff;
+	const fdt32_t *val;
+
+	val = fdt_getprop(fdt, nodeoff, "msi-parent", &len);
+	if (!val || len < sizeof(fdt32_t))
+		return SBI_ENOENT;
+
+	noff = fdt_index_offset_by_phandle(fdt, fdt32_to_cpu(*val));
+	if (noff < 0)
+		return noff;
+
+	return fdt_parse_imsic_node(fdt, noff, imsic);
+}
+
+int fdt_parse_aplic_node(void *fdt, int nodeoff, struct aplic_data *aplic)
+{
+	const fdt32_t *val, *del;
+	struct imsic_data imsic;
+	int i, j, d, dcnt, len, noff, rc;
+	unsigned long reg_addr, reg_size;
+	struct aplic_delegate_data *deleg;
+
+	if (nodeoff < 0 || !aplic || !fdt)
+		return SBI_ENODEV;
+
+	rc = fdt_get_node_addr_size(fdt, nodeoff, &reg_addr, &reg_size);
+	if (rc < 0 || !reg_addr || !reg_size)
+		return SBI_ENODEV;
+	aplic->addr = reg_addr;
+	aplic->size = reg_size;
+
+	aplic->num_source = fdt_getprop_u32(fdt, nodeoff,
+					    "riscv,num-sources", 0);
+
+	/* Direct mode: one IDC per parent interrupt */
+	aplic->num_idc = 0;
+	aplic->targets_mmode = FALSE;
+	val = fdt_getprop(fdt, nodeoff, "interrupts-extended", &len);
+	if (val && len >= 2 * sizeof(fdt32_t)) {
+		len = len / sizeof(fdt32_t);
+		for (i = 0; i < len; i += 2) {
+			if (fdt32_to_cpu(val[i + 1]) == IRQ_M_EXT) {
+				aplic->targets_mmode = TRUE;
+				break;
+			}
+		}
+		aplic->num_idc = len / 2;
+	}
+
+	/* MSI mode: MSIs are written to the interrupt files of an IMSIC */
+	aplic->has_msicfg_mmode = FALSE;
+	aplic->has_msicfg_smode = FALSE;
+	if (!fdt_parse_aplic_msi_parent(fdt, nodeoff, &imsic)) {
+		if (imsic.targets_mmode) {
+			aplic->targets_mmode = TRUE;
+			aplic->has_msicfg_mmode = TRUE;
+			fdt_aplic_msicfg(&imsic, &aplic->msicfg_mmode);
+		} else {
+			aplic->has_msicfg_smode = TRUE;
+			fdt_aplic_msicfg(&imsic, &aplic->msicfg_smode);
+		}
+	}
+
+	for (i = 0; i < APLIC_MAX_DELEGATE; i++) {
+		deleg = &aplic->delegate[i];
+		deleg->first_irq = 0;
+		deleg->last_irq = 0;
+		deleg->child_index = 0;
+	}
+
+	val = fdt_getprop(fdt, nodeoff, "riscv,children", &len);
+	if (!val || len < sizeof(fdt32_t))
+		return 0;
+	len = len / sizeof(fdt32_t);
+
+	/* The S-level MSI config of the root comes from its children */
+	for (i = 0; i < len && !aplic->has_msicfg_smode; i++) {
+		if (!aplic->targets_mmode)
+			break;
+		noff = fdt_index_offset_by_phandle(fdt, fdt32_to_cpu(val[i]));
+		if (noff >= 0 &&
+		    !fdt_parse_aplic_msi_parent(fdt, noff, &imsic) &&
+		    !imsic.targets_mmode) {
+			aplic->has_msicfg_smode = TRUE;
+			fdt_aplic_msicfg(&imsic, &aplic->msicfg_smode);
+		}
+	}
+
+	/* Triplets of <child phandle, first irq, last irq> */
+	del = fdt_getprop(fdt, nodeoff, "riscv,delegate", &dcnt);
+	if (!del)
+		del = fdt_getprop(fdt, nodeoff, "riscv,delegation", &dcnt);
+	if (!del || dcnt < 3 * sizeof(fdt32_t))
+		return 0;
+	dcnt = dcnt / sizeof(fdt32_t);
+
+	for (j = 0, d = 0; j + 2 < dcnt && d < APLIC_MAX_DELEGATE; j += 3) {
+		for (i = 0; i < len; i++) {
+			if (fdt32_to_cpu(del[j]) == fdt32_to_cpu(val[i]))
+				break;
+		}
+		if (i == len)
+			continue;
+
+		deleg = &aplic->delegate[d++];
+		deleg->first_irq = fdt32_to_cpu(del[j + 1]);
+		deleg->last_irq = fdt32_to_cpu(del[j + 2]);
+		deleg->child_index = i;
+	}
+
+	return 0;
+}
+
 int fdt_parse_clint_node(void *fdt, int nodeoffset, bool for_timer,
 			 struct clint_data *clint)
 {
 	const fdt32_t *val;
 	unsigned long reg_addr, reg_size;
-	int i, rc, count, cpu_offset, cpu_intc_offset;
+	int i, rc, count;
 	u32 phandle, hwirq, hartid, first_hartid, last_hartid;
 	u32 match_hwirq = (for_timer) ? IRQ_M_TIMER : IRQ_M_SOFT;
 
@@ -410,22 +1093,15 @@ int fdt_parse_clint_node(void *fdt, int nodeoffset, bool for_timer,
 		phandle = fdt32_to_cpu(val[i]);
 		hwirq = fdt32_to_cpu(val[i + 1]);
 
-		cpu_intc_offset = fdt_node_offset_by_phandle(fdt, phandle);
-		if (cpu_intc_offset < 0)
-			continue;
-
-		cpu_offset = fdt_parent_offset(fdt, cpu_intc_offset);
-		if (cpu_intc_offset < 0)
-			continue;
-
-		rc = fdt_parse_hart_id(fdt, cpu_offset, &hartid);
+		rc = fdt_parse_hart_id_by_intc(fdt, phandle, &hartid);
 		if (rc)
 			continue;
 
 		if (SBI_HARTMASK_MAX_BITS <= hartid)
 			continue;
 
-		if (match_hwirq == hwirq) {
+		if (match_hwirq == hwirq ||
+		    (!for_timer && hwirq == IRQ_S_SOFT)) {
 			if (hartid < first_hartid)
 				first_hartid = hartid;
 			if (hartid > last_hartid)
@@ -449,12 +1125,85 @@ int fdt_parse_clint_node(void *fdt, int nodeoffset, bool for_timer,
 	return 0;
 }
 
+int fdt_parse_aclint_node(void *fdt, int nodeoffset, bool for_timer,
+			  unsigned long *out_addr1, unsigned long *out_size1,
+			  unsigned long *out_addr2, unsigned long *out_size2,
+			  u32 *out_first_hartid, u32 *out_hart_count)
+{
+	const fdt32_t *val;
+	int i, rc, count;
+	u32 phandle, hwirq, hartid, first_hartid, last_hartid, hart_count;
+	u32 match_hwirq = (for_timer) ? IRQ_M_TIMER : IRQ_M_SOFT;
+
+	if (nodeoffset < 0 || !fdt ||
+	    !out_addr1 || !out_size1 ||
+	    !out_first_hartid || !out_hart_count)
+		return SBI_EINVAL;
+
+	rc = fdt_get_node_addr_size(fdt, nodeoffset, out_addr1, out_size1);
+	if (rc < 0 || !*out_addr1 || !*out_size1)
+		return SBI_ENODEV;
+
+	/* Second register region is optional */
+	if (out_addr2 && out_size2) {
+		*out_addr2 = 0;
+		*out_size2 = 0;
+		rc = fdt_get_node_addr_size_by_index(fdt, nodeoffset, 1,
+						     out_addr2, out_size2);
+		if (rc) {
+			*out_addr2 = 0;
+			*out_size2 = 0;
+		}
+	}
+
+	*out_first_hartid = 0;
+	*out_hart_count = 0;
+
+	val = fdt_getprop(fdt, nodeoffset, "interrupts-extended", &count);
+	if (!val || count < sizeof(fdt32_t))
+		return SBI_EINVAL;
+	count = count / sizeof(fdt32_t);
+
+	first_hartid = -1U;
+	last_hartid = 0;
+	hart_count = 0;
+	for (i = 0; i < (count - 1); i += 2) {
+		phandle = fdt32_to_cpu(val[i]);
+		hwirq = fdt32_to_cpu(val[i + 1]);
+
+		rc = fdt_parse_hart_id_by_intc(fdt, phandle, &hartid);
+		if (rc)
+			continue;
+
+		if (SBI_HARTMASK_MAX_BITS <= hartid)
+			continue;
+
+		if (match_hwirq == hwirq ||
+		    (!for_timer && hwirq == IRQ_S_SOFT)) {
+			if (hartid < first_hartid)
+				first_hartid = hartid;
+			if (hartid > last_hartid)
+				last_hartid = hartid;
+			hart_count++;
+		}
+	}
+
+	if ((last_hartid < first_hartid) || first_hartid == -1U)
+		return SBI_ENODEV;
+
+	*out_first_hartid = first_hartid;
+	count = last_hartid - first_hartid + 1;
+	*out_hart_count = (hart_count < count) ? count : hart_count;
+
+	return 0;
+}
+
 int fdt_parse_compat_addr(void *fdt, unsigned long *addr,
 			  const char *compatible)
 {
 	int nodeoffset, rc;
 
-	nodeoffset = fdt_node_offset_by_compatible(fdt, -1, compatible);
+	nodeoffset = fdt_index_offset_by_compatible(fdt, -1, compatible);
 	if (nodeoffset < 0)
 		return nodeoffset;
 
@@ -464,3 +1213,39 @@ int fdt_parse_compat_addr(void *fdt, unsigned long *addr,
 
 	return 0;
 }
+
+int fdt_assume_mask;
+
+int fdt_trust(void *fdt, bool checked)
+{
+	int err;
+	unsigned long rsv_end;
+
+	fdt_assume_mask = 0;
+	err = (checked) ? fdt_check_header(fdt) :
+			  fdt_check_full(fdt, fdt_totalsize(fdt));
+	if (err)
+		return err;
+
+	/* The layout checks of the read-write functions are skipped too */
+	rsv_end = fdt_off_mem_rsvmap(fdt) +
+		  (fdt_num_mem_rsv(fdt) + 1) * sizeof(struct fdt_reserve_entry);
+	if (fdt_version(fdt) < 17 || (fdt_off_mem_rsvmap(fdt) & 7) ||
+	    fdt_off_dt_struct(fdt) < rsv_end ||
+	    fdt_off_dt_strings(fdt) <
+	    fdt_off_dt_struct(fdt) + fdt_size_dt_struct(fdt))
+		return -FDT_ERR_BADLAYOUT;
+
+	fdt_assume_mask = FDT_ASSUME_VALID_DTB;
+	return 0;
+}
+
+void fdt_untrust(void)
+{
+	fdt_assume_mask = 0;
+}
+
+bool fdt_trusted(void)
+{
+	return (fdt_assume_mask) ? TRUE : FALSE;
+}
@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: BSD-2-Clause
+/*
+ * fdt_idle_states.c - Flat Device Tree idle state helper routines
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <libfdt.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hsm.h>
+#include <sbi/sbi_string.h>
+#include <sbi_utils/fdt/fdt_idle_states.h>
+
+static u32 fdt_idle_state_u32(void *fdt, int noff, const char *name)
+{
+	int len;
+	const fdt32_t *val;
+
+	val = fdt_getprop(fdt, noff, name, &len);
+	if (!val || len < sizeof(fdt32_t))
+		return 0;
+
+	return fdt32_to_cpu(*val);
+}
+
+int fdt_idle_states_populate(void *fdt)
+{
+	int rc, len, poff, noff;
+	const fdt32_t *val;
+	const char *name;
+	struct sbi_hsm_suspend_state state;
+
+	if (!fdt)
+		return SBI_EINVAL;
+
+	poff = fdt_path_offset(fdt, "/cpus/idle-states");
+	if (poff < 0)
+		return 0;
+
+	fdt_for_each_subnode(noff, fdt, poff) {
+		if (fdt_node_check_compatible(fdt, noff, "riscv,idle-state"))
+			continue;
+
+		val = fdt_getprop(fdt, noff, "riscv,sbi-suspend-param", &len);
+		if (!val || len < sizeof(fdt32_t))
+			continue;
+
+		sbi_memset(&state, 0, sizeof(state));
+		name = fdt_getprop(fdt, noff, "idle-state-name", &len);
+		if (!name)
+			name = fdt_get_name(fdt, noff, NULL);
+		if (name)
+			sbi_strncpy(state.name, name, sizeof(state.name) - 1);
+		state.suspend_type = fdt32_to_cpu(*val);
+		state.entry_latency_us =
+			fdt_idle_state_u32(fdt, noff, "entry-latency-us");
+		state.exit_latency_us =
+			fdt_idle_state_u32(fdt, noff, "exit-latency-us");
+		state.min_residency_us =
+			fdt_idle_state_u32(fdt, noff, "min-residency-us");
+
+		rc = sbi_hsm_add_suspend_state(&state);
+		if (rc == SBI_EINVAL || rc == SBI_EALREADY)
+			continue;
+		if (rc)
+			return rc;
+	}
+
+	return 0;
+}
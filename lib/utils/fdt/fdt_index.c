@@ -0,0 +1,173 @@
+// SPDX-License-Identifier: BSD-2-Clause
+/*
+ * fdt_index.c - Flat Device Tree lookup index
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <libfdt.h>
+#include <sbi/sbi_error.h>
+#include <sbi_utils/fdt/fdt_index.h>
+
+#define FDT_INDEX_MAX_COMPAT		512
+#define FDT_INDEX_MAX_PHANDLE		512
+
+struct fdt_index_compat {
+	/* Node offset */
+	u32 offset;
+	/* Offset of the "compatible" string list from the blob start */
+	u32 data;
+	u32 len;
+};
+
+struct fdt_index_phandle {
+	u32 phandle;
+	u32 offset;
+};
+
+static const void *index_fdt;
+static u32 index_struct_size;
+
+/*
+ * Compatible entries are sorted by node offset and phandle entries by
+ * phandle. When an array is full the nodes after its last entry (or
+ * the phandles left out) are looked up with libfdt as before.
+ */
+static u32 index_compat_count;
+static bool index_compat_full;
+static struct fdt_index_compat index_compat[FDT_INDEX_MAX_COMPAT];
+
+static u32 index_phandle_count;
+static bool index_phandle_full;
+static struct fdt_index_phandle index_phandle[FDT_INDEX_MAX_PHANDLE];
+
+static bool fdt_index_valid(const void *fdt)
+{
+	return index_fdt && fdt == index_fdt &&
+	       fdt_size_dt_struct(fdt) == index_struct_size;
+}
+
+static void fdt_index_add_phandle(u32 phandle, int noff)
+{
+	u32 i;
+
+	if (index_phandle_count == FDT_INDEX_MAX_PHANDLE) {
+		index_phandle_full = TRUE;
+		return;
+	}
+
+	/* dtc assigns phandles in tree order so this rarely moves entries */
+	i = index_phandle_count++;
+	while (i && index_phandle[i - 1].phandle > phandle) {
+		index_phandle[i] = index_phandle[i - 1];
+		i--;
+	}
+	index_phandle[i].phandle = phandle;
+	index_phandle[i].offset = noff;
+}
+
+int fdt_index_init(void *fdt)
+{
+	int noff, len;
+	u32 phandle;
+	const char *compat;
+
+	fdt_index_invalidate();
+	if (!fdt || fdt_check_header(fdt))
+		return SBI_EINVAL;
+
+	for (noff = fdt_next_node(fdt, -1, NULL); noff >= 0;
+	     noff = fdt_next_node(fdt, noff, NULL)) {
+		compat = fdt_getprop(fdt, noff, "compatible", &len);
+		if (compat && len > 0 && !index_compat_full) {
+			if (index_compat_count < FDT_INDEX_MAX_COMPAT) {
+				index_compat[index_compat_count].offset = noff;
+				index_compat[index_compat_count].data =
+						compat - (const char *)fdt;
+				index_compat[index_compat_count].len = len;
+				index_compat_count++;
+			} else {
+				index_compat_full = TRUE;
+			}
+		}
+
+		phandle = fdt_get_phandle(fdt, noff);
+		if (phandle && phandle != (u32)-1)
+			fdt_index_add_phandle(phandle, noff);
+	}
+
+	index_struct_size = fdt_size_dt_struct(fdt);
+	index_fdt = fdt;
+
+	return 0;
+}
+
+void fdt_index_invalidate(void)
+{
+	index_fdt = NULL;
+	index_compat_count = 0;
+	index_compat_full = FALSE;
+	index_phandle_count = 0;
+	index_phandle_full = FALSE;
+}
+
+int fdt_index_offset_by_compatible(void *fdt, int startoff,
+				   const char *compatible)
+{
+	u32 lo, hi, mid;
+	const struct fdt_index_compat *ic;
+
+	if (!fdt_index_valid(fdt))
+		return fdt_node_offset_by_compatible(fdt, startoff, compatible);
+
+	/* Find the first entry after startoff */
+	lo = 0;
+	hi = index_compat_count;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if ((int)index_compat[mid].offset <= startoff)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (; lo < index_compat_count; lo++) {
+		ic = &index_compat[lo];
+		if (fdt_stringlist_contains((const char *)fdt + ic->data,
+					    ic->len, compatible))
+			return ic->offset;
+	}
+
+	if (!index_compat_full)
+		return -FDT_ERR_NOTFOUND;
+
+	ic = &index_compat[index_compat_count - 1];
+	if ((int)ic->offset > startoff)
+		startoff = ic->offset;
+	return fdt_node_offset_by_compatible(fdt, startoff, compatible);
+}
+
+int fdt_index_offset_by_phandle(void *fdt, u32 phandle)
+{
+	u32 lo, hi, mid;
+
+	if (!fdt_index_valid(fdt) || !phandle || phandle == (u32)-1)
+		return fdt_node_offset_by_phandle(fdt, phandle);
+
+	lo = 0;
+	hi = index_phandle_count;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (index_phandle[mid].phandle == phandle)
+			return index_phandle[mid].offset;
+		if (index_phandle[mid].phandle < phandle)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (!index_phandle_full)
+		return -FDT_ERR_NOTFOUND;
+
+	return fdt_node_offset_by_phandle(fdt, phandle);
+}
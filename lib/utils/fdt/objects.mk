@@ -7,3 +7,5 @@
 libsbiutils-objs-y += fdt/fdt_domain.o
 libsbiutils-objs-y += fdt/fdt_helper.o
 libsbiutils-objs-y += fdt/fdt_fixup.o
+libsbiutils-objs-y += fdt/fdt_idle_states.o
+libsbiutils-objs-y += fdt/fdt_index.o
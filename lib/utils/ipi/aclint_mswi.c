@@ -0,0 +1,115 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_io.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hartmask.h>
+#include <sbi/sbi_ipi.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi_utils/ipi/aclint_mswi.h>
+
+/* Per-HART pointer to the MSWI of the HART */
+static unsigned long mswi_ptr_offset;
+
+static struct aclint_mswi_data *mswi_hartid2data(u32 hartid)
+{
+	struct sbi_scratch *scratch;
+
+	if (!mswi_ptr_offset || SBI_HARTMASK_MAX_BITS <= hartid)
+		return NULL;
+	scratch = sbi_hartid_to_scratch(hartid);
+	if (!scratch)
+		return NULL;
+
+	return *(struct aclint_mswi_data **)sbi_scratch_offset_ptr(scratch,
+							mswi_ptr_offset);
+}
+
+static void mswi_ipi_send(u32 target_hart)
+{
+	u32 *msip;
+	struct aclint_mswi_data *mswi;
+
+	mswi = mswi_hartid2data(target_hart);
+	if (!mswi)
+		return;
+
+	/* Set ACLINT IPI */
+	msip = (void *)mswi->addr;
+	writel(1, &msip[target_hart - mswi->first_hartid]);
+}
+
+static void mswi_ipi_clear(u32 target_hart)
+{
+	u32 *msip;
+	struct aclint_mswi_data *mswi;
+
+	mswi = mswi_hartid2data(target_hart);
+	if (!mswi)
+		return;
+
+	/* Clear ACLINT IPI */
+	msip = (void *)mswi->addr;
+	writel(0, &msip[target_hart - mswi->first_hartid]);
+}
+
+static struct sbi_ipi_device aclint_mswi = {
+	.name = "aclint-mswi",
+	.ipi_send = mswi_ipi_send,
+	.ipi_clear = mswi_ipi_clear
+};
+
+int aclint_mswi_warm_init(void)
+{
+	/* Clear IPI for current HART */
+	mswi_ipi_clear(current_hartid());
+
+	return 0;
+}
+
+int aclint_mswi_cold_init(struct aclint_mswi_data *mswi)
+{
+	u32 i;
+	int rc;
+	struct sbi_scratch *scratch;
+	struct sbi_domain_memregion reg;
+
+	/* Sanity checks */
+	if (!mswi || (mswi->addr & (ACLINT_MSWI_ALIGN - 1)) ||
+	    (mswi->size < (mswi->hart_count * sizeof(u32))) ||
+	    (!mswi->hart_count || mswi->hart_count > ACLINT_MSWI_MAX_HARTS))
+		return SBI_EINVAL;
+
+	/* Update MSWI pointer of the HARTs */
+	if (!mswi_ptr_offset) {
+		mswi_ptr_offset = sbi_scratch_alloc_offset(sizeof(mswi),
+							   "ACLINT_MSWI");
+		if (!mswi_ptr_offset)
+			return SBI_ENOMEM;
+	}
+	for (i = 0; i < mswi->hart_count; i++) {
+		if (SBI_HARTMASK_MAX_BITS <= (mswi->first_hartid + i))
+			break;
+		scratch = sbi_hartid_to_scratch(mswi->first_hartid + i);
+		if (!scratch)
+			continue;
+		*(struct aclint_mswi_data **)sbi_scratch_offset_ptr(scratch,
+						mswi_ptr_offset) = mswi;
+	}
+
+	/* Add MSWI region to the root domain */
+	sbi_domain_memregion_init(mswi->addr, mswi->size,
+				  SBI_DOMAIN_MEMREGION_MMIO, &reg);
+	rc = sbi_domain_root_add_memregion(&reg);
+	if (rc)
+		return rc;
+
+	sbi_ipi_set_device(&aclint_mswi);
+
+	return 0;
+}
@@ -0,0 +1,91 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <sbi/riscv_io.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hartmask.h>
+#include <sbi/sbi_ipi.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi_utils/ipi/aclint_sswi.h>
+
+/* Per-HART pointer to the SSWI of the HART */
+static unsigned long sswi_ptr_offset;
+
+static struct aclint_sswi_data *sswi_hartid2data(u32 hartid)
+{
+	struct sbi_scratch *scratch;
+
+	if (!sswi_ptr_offset || SBI_HARTMASK_MAX_BITS <= hartid)
+		return NULL;
+	scratch = sbi_hartid_to_scratch(hartid);
+	if (!scratch)
+		return NULL;
+
+	return *(struct aclint_sswi_data **)sbi_scratch_offset_ptr(scratch,
+							sswi_ptr_offset);
+}
+
+static void sswi_ipi_send(u32 target_hart)
+{
+	u32 *setssip;
+	struct aclint_sswi_data *sswi;
+
+	sswi = sswi_hartid2data(target_hart);
+	if (!sswi)
+		return;
+
+	/* Set ACLINT supervisor software interrupt */
+	setssip = (void *)sswi->addr;
+	writel(1, &setssip[target_hart - sswi->first_hartid]);
+}
+
+static struct sbi_ipi_device aclint_sswi = {
+	.name = "aclint-sswi",
+	.ipi_send = sswi_ipi_send,
+};
+
+int aclint_sswi_cold_init(struct aclint_sswi_data *sswi)
+{
+	u32 i;
+	int rc;
+	struct sbi_scratch *scratch;
+	struct sbi_domain_memregion reg;
+
+	/* Sanity checks */
+	if (!sswi || (sswi->addr & (ACLINT_SSWI_ALIGN - 1)) ||
+	    (sswi->size < (sswi->hart_count * sizeof(u32))) ||
+	    (!sswi->hart_count || sswi->hart_count > ACLINT_SSWI_MAX_HARTS))
+		return SBI_EINVAL;
+
+	/* Update SSWI pointer of the HARTs */
+	if (!sswi_ptr_offset) {
+		sswi_ptr_offset = sbi_scratch_alloc_offset(sizeof(sswi),
+							   "ACLINT_SSWI");
+		if (!sswi_ptr_offset)
+			return SBI_ENOMEM;
+	}
+	for (i = 0; i < sswi->hart_count; i++) {
+		if (SBI_HARTMASK_MAX_BITS <= (sswi->first_hartid + i))
+			break;
+		scratch = sbi_hartid_to_scratch(sswi->first_hartid + i);
+		if (!scratch)
+			continue;
+		*(struct aclint_sswi_data **)sbi_scratch_offset_ptr(scratch,
+						sswi_ptr_offset) = sswi;
+	}
+
+	/* Add SSWI region to the root domain */
+	sbi_domain_memregion_init(sswi->addr, sswi->size,
+				  SBI_DOMAIN_MEMREGION_MMIO, &reg);
+	rc = sbi_domain_root_add_memregion(&reg);
+	if (rc)
+		return rc;
+
+	sbi_ipi_set_smode_device(&aclint_sswi);
+
+	return 0;
+}
@@ -11,10 +11,28 @@
 #include <sbi_utils/fdt/fdt_helper.h>
 #include <sbi_utils/ipi/fdt_ipi.h>
 
+extern struct fdt_ipi fdt_ipi_mswi;
 extern struct fdt_ipi fdt_ipi_clint;
+extern struct fdt_ipi fdt_ipi_sswi;
 
 static struct fdt_ipi *ipi_drivers[] = {
-	&fdt_ipi_clint
+#ifndef FDT_IPI_MSWI_DISABLED
+	&fdt_ipi_mswi,
+#endif
+#ifndef FDT_IPI_CLINT_DISABLED
+	&fdt_ipi_clint,
+#endif
+};
+
+/*
+ * Supervisor software interrupt drivers are probed in addition to the
+ * M-mode IPI driver selected from ipi_drivers[] and must not have any
+ * warm_init() or exit() callbacks.
+ */
+static struct fdt_ipi *ipi_smode_drivers[] = {
+#ifndef FDT_IPI_SSWI_DISABLED
+	&fdt_ipi_sswi,
+#endif
 };
 
 static struct fdt_ipi dummy = {
@@ -64,6 +82,20 @@ static int fdt_ipi_cold_init(void)
 			break;
 	}
 
+	for (pos = 0; pos < array_size(ipi_smode_drivers); pos++) {
+		drv = ipi_smode_drivers[pos];
+
+		noff = -1;
+		while ((noff = fdt_find_match(fdt, noff,
+					drv->match_table, &match)) >= 0) {
+			if (drv->cold_init) {
+				rc = drv->cold_init(fdt, noff, match);
+				if (rc)
+					return rc;
+			}
+		}
+	}
+
 	return 0;
 }
 
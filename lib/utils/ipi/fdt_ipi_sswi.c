@@ -0,0 +1,46 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <sbi/sbi_error.h>
+#include <sbi_utils/fdt/fdt_helper.h>
+#include <sbi_utils/ipi/fdt_ipi.h>
+#include <sbi_utils/ipi/aclint_sswi.h>
+
+#define SSWI_MAX_NR			16
+
+static unsigned long sswi_count = 0;
+static struct aclint_sswi_data sswi[SSWI_MAX_NR];
+
+static int ipi_sswi_cold_init(void *fdt, int nodeoff,
+			      const struct fdt_match *match)
+{
+	int rc;
+	struct aclint_sswi_data *ss;
+
+	if (SSWI_MAX_NR <= sswi_count)
+		return SBI_ENOSPC;
+	ss = &sswi[sswi_count++];
+
+	rc = fdt_parse_aclint_node(fdt, nodeoff, FALSE,
+				   &ss->addr, &ss->size, NULL, NULL,
+				   &ss->first_hartid, &ss->hart_count);
+	if (rc)
+		return rc;
+
+	return aclint_sswi_cold_init(ss);
+}
+
+static const struct fdt_match ipi_sswi_match[] = {
+	{ .compatible = "riscv,aclint-sswi" },
+	{ },
+};
+
+struct fdt_ipi fdt_ipi_sswi = {
+	.match_table = ipi_sswi_match,
+	.cold_init = ipi_sswi_cold_init,
+	.warm_init = NULL,
+	.exit = NULL,
+};
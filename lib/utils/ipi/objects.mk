@@ -8,4 +8,8 @@
 #
 
 libsbiutils-objs-y += ipi/fdt_ipi.o
-libsbiutils-objs-y += ipi/fdt_ipi_clint.o
+libsbiutils-objs-$(FDT_IPI_CLINT) += ipi/fdt_ipi_clint.o
+libsbiutils-objs-y += ipi/aclint_mswi.o
+libsbiutils-objs-$(FDT_IPI_MSWI) += ipi/fdt_ipi_mswi.o
+libsbiutils-objs-y += ipi/aclint_sswi.o
+libsbiutils-objs-$(FDT_IPI_SSWI) += ipi/fdt_ipi_sswi.o
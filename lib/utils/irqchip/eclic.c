@@ -0,0 +1,135 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_encoding.h>
+#include <sbi/riscv_io.h>
+#include <sbi/sbi_error.h>
+#include <sbi_utils/irqchip/eclic.h>
+
+/* clang-format off */
+
+#define ECLIC_CFG			0x0
+#define ECLIC_CFG_NLBITS_SHIFT		1
+#define ECLIC_INFO			0x4
+#define ECLIC_INFO_NUM_IRQ_MASK		0x1fff
+#define ECLIC_MTH			0xb
+#define ECLIC_INT_BASE			0x1000
+#define ECLIC_INT_STRIDE		0x4
+#define ECLIC_INT_IP			0x0
+#define ECLIC_INT_IE			0x1
+#define ECLIC_INT_ATTR			0x2
+#define ECLIC_INT_ATTR_SHV		0x1
+#define ECLIC_INT_CTL			0x3
+
+#define ECLIC_CSR_MTVT			0x307
+#define ECLIC_MTVEC_MODE		0x3
+
+/* Vector table size, the table is aligned to its size */
+#define ECLIC_VECTOR_MAX		128
+
+/* clang-format on */
+
+static unsigned long eclic_vector[ECLIC_VECTOR_MAX]
+	__aligned(ECLIC_VECTOR_MAX * sizeof(unsigned long));
+
+static volatile u8 *eclic_int_reg(struct eclic_data *ecl, u32 irq, u32 reg)
+{
+	return (volatile u8 *)(ecl->addr + ECLIC_INT_BASE +
+			       irq * ECLIC_INT_STRIDE + reg);
+}
+
+int eclic_set_irq(struct eclic_data *ecl, u32 irq, u32 level,
+		  bool vectored, bool enable)
+{
+	u8 attr, ctl;
+
+	if (!ecl || ecl->num_irq <= irq || (1U << ecl->nlbits) <= level)
+		return SBI_EINVAL;
+
+	/* Level is in the upper bits, the unused priority bits read as 1 */
+	ctl = (ecl->nlbits) ? (level << (8 - ecl->nlbits)) |
+			      (0xff >> ecl->nlbits) : 0xff;
+	attr = readb(eclic_int_reg(ecl, irq, ECLIC_INT_ATTR));
+	if (vectored)
+		attr |= ECLIC_INT_ATTR_SHV;
+	else
+		attr &= ~ECLIC_INT_ATTR_SHV;
+
+	writeb(0, eclic_int_reg(ecl, irq, ECLIC_INT_IE));
+	writeb(attr, eclic_int_reg(ecl, irq, ECLIC_INT_ATTR));
+	writeb(ctl, eclic_int_reg(ecl, irq, ECLIC_INT_CTL));
+	if (enable)
+		writeb(1, eclic_int_reg(ecl, irq, ECLIC_INT_IE));
+
+	return 0;
+}
+
+int eclic_warm_irqchip_init(struct eclic_data *ecl)
+{
+	int rc;
+	unsigned long mtvec, base;
+
+	if (!ecl || !ecl->num_irq)
+		return SBI_ENODEV;
+
+	/*
+	 * The entries of the CLINT mode vector table are jumps to the
+	 * trap handlers so the ECLIC vectors point to them and the table
+	 * base, whose first entry jumps to the common trap handler, takes
+	 * the exceptions and the other interrupts.
+	 */
+	mtvec = csr_read(CSR_MTVEC);
+	if ((mtvec & ECLIC_MTVEC_MODE) != MTVEC_MODE_VECTORED)
+		return SBI_ENODEV;
+	base = mtvec & ~ECLIC_MTVEC_MODE;
+
+	rc = eclic_set_irq(ecl, IRQ_M_SOFT, ECLIC_LEVEL_MSOFT, TRUE, TRUE);
+	if (rc)
+		return rc;
+	rc = eclic_set_irq(ecl, IRQ_M_TIMER, ECLIC_LEVEL_MTIMER, TRUE, TRUE);
+	if (rc)
+		return rc;
+
+	csr_write(ECLIC_CSR_MTVT, (unsigned long)eclic_vector);
+	csr_write(CSR_MTVEC, base | ECLIC_MTVEC_MODE);
+	if ((csr_read(CSR_MTVEC) & ECLIC_MTVEC_MODE) != ECLIC_MTVEC_MODE) {
+		csr_write(CSR_MTVEC, mtvec);
+		return SBI_ENODEV;
+	}
+
+	return 0;
+}
+
+int eclic_cold_irqchip_init(struct eclic_data *ecl)
+{
+	u32 i, num_irq;
+	unsigned long mtvec = csr_read(CSR_MTVEC) & ~ECLIC_MTVEC_MODE;
+
+	if (!ecl || 8 < ecl->nlbits)
+		return SBI_EINVAL;
+
+	num_irq = readl((void *)ecl->addr + ECLIC_INFO) &
+		  ECLIC_INFO_NUM_IRQ_MASK;
+	if (!num_irq || ECLIC_VECTOR_MAX < num_irq)
+		return SBI_ENODEV;
+
+	/* Entries beyond the CLINT mode table use the common handler */
+	for (i = 0; i < ECLIC_VECTOR_MAX; i++)
+		eclic_vector[i] = mtvec + ((i < __riscv_xlen) ? i * 4 : 0);
+
+	/* Disable all interrupts, OpenSBI enables its own ones per HART */
+	for (i = 0; i < num_irq; i++) {
+		writeb(0, eclic_int_reg(ecl, i, ECLIC_INT_IE));
+		writeb(0, eclic_int_reg(ecl, i, ECLIC_INT_IP));
+	}
+	writeb(ecl->nlbits << ECLIC_CFG_NLBITS_SHIFT,
+	       (void *)ecl->addr + ECLIC_CFG);
+	writeb(0, (void *)ecl->addr + ECLIC_MTH);
+	ecl->num_irq = num_irq;
+
+	return 0;
+}
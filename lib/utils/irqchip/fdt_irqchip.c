@@ -7,33 +7,64 @@
  *   Anup Patel <anup.patel@wdc.com>
  */
 
+#include <libfdt.h>
+#include <sbi/sbi_error.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi_utils/fdt/fdt_helper.h>
 #include <sbi_utils/irqchip/fdt_irqchip.h>
 
+extern struct fdt_irqchip fdt_irqchip_imsic;
+extern struct fdt_irqchip fdt_irqchip_aplic;
 extern struct fdt_irqchip fdt_irqchip_plic;
 
+/*
+ * All drivers with matching nodes are used since an AIA system is made
+ * of IMSICs and APLICs. IMSICs come first so that their IPI device is
+ * registered before any other.
+ */
 static struct fdt_irqchip *irqchip_drivers[] = {
-	&fdt_irqchip_plic
+#ifndef FDT_IRQCHIP_IMSIC_DISABLED
+	&fdt_irqchip_imsic,
+#endif
+#ifndef FDT_IRQCHIP_APLIC_DISABLED
+	&fdt_irqchip_aplic,
+#endif
+#ifndef FDT_IRQCHIP_PLIC_DISABLED
+	&fdt_irqchip_plic,
+#endif
 };
 
-static struct fdt_irqchip *current_driver = NULL;
+static struct fdt_irqchip *current_drivers[array_size(irqchip_drivers)];
+static int current_drivers_count;
 
 void fdt_irqchip_exit(void)
 {
-	if (current_driver && current_driver->exit)
-		current_driver->exit();
+	int i;
+
+	for (i = 0; i < current_drivers_count; i++) {
+		if (current_drivers[i]->exit)
+			current_drivers[i]->exit();
+	}
 }
 
 static int fdt_irqchip_warm_init(void)
 {
-	if (current_driver && current_driver->warm_init)
-		return current_driver->warm_init();
+	int i, rc;
+
+	for (i = 0; i < current_drivers_count; i++) {
+		if (!current_drivers[i]->warm_init)
+			continue;
+		rc = current_drivers[i]->warm_init();
+		if (rc)
+			return rc;
+	}
+
 	return 0;
 }
 
 static int fdt_irqchip_cold_init(void)
 {
+	bool drv_added;
 	int pos, noff, rc;
 	struct fdt_irqchip *drv;
 	const struct fdt_match *match;
@@ -43,6 +74,7 @@ static int fdt_irqchip_cold_init(void)
 		drv = irqchip_drivers[pos];
 
 		noff = -1;
+		drv_added = FALSE;
 		while ((noff = fdt_find_match(fdt, noff,
 					drv->match_table, &match)) >= 0) {
 			if (drv->cold_init) {
@@ -50,16 +82,57 @@ static int fdt_irqchip_cold_init(void)
 				if (rc)
 					return rc;
 			}
-			current_driver = drv;
+			if (!drv_added) {
+				current_drivers[current_drivers_count++] = drv;
+				drv_added = TRUE;
+			}
 		}
-
-		if (current_driver)
-			break;
 	}
 
 	return 0;
 }
 
+int fdt_irqchip_mmode_irq_set(void *fdt, int nodeoff, void (*fn)(void))
+{
+	int i, len, off;
+	const fdt32_t *val;
+	u32 phandle, hwirq;
+
+	val = fdt_getprop(fdt, nodeoff, "interrupts-extended", &len);
+	if (val && len >= 2 * sizeof(fdt32_t)) {
+		phandle = fdt32_to_cpu(val[0]);
+		hwirq = fdt32_to_cpu(val[1]);
+	} else {
+		val = fdt_getprop(fdt, nodeoff, "interrupts", &len);
+		if (!val || len < sizeof(fdt32_t))
+			return SBI_ENODEV;
+		hwirq = fdt32_to_cpu(val[0]);
+
+		/* The interrupt parent may be set by any ancestor */
+		for (off = nodeoff; off >= 0; off = fdt_parent_offset(fdt, off)) {
+			val = fdt_getprop(fdt, off, "interrupt-parent", &len);
+			if (val && len >= sizeof(fdt32_t))
+				break;
+		}
+		if (off < 0)
+			return SBI_ENODEV;
+		phandle = fdt32_to_cpu(val[0]);
+	}
+
+	off = fdt_node_offset_by_phandle(fdt, phandle);
+	if (off < 0)
+		return SBI_ENODEV;
+
+	for (i = 0; i < current_drivers_count; i++) {
+		if (!current_drivers[i]->mmode_irq_set ||
+		    !fdt_match_node(fdt, off, current_drivers[i]->match_table))
+			continue;
+		return current_drivers[i]->mmode_irq_set(fdt, off, hwirq, fn);
+	}
+
+	return SBI_ENODEV;
+}
+
 int fdt_irqchip_init(bool cold_boot)
 {
 	int rc;
@@ -9,13 +9,17 @@
 
 #include <libfdt.h>
 #include <sbi/riscv_asm.h>
+#include <sbi/riscv_encoding.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_hartmask.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_trap.h>
 #include <sbi_utils/fdt/fdt_helper.h>
 #include <sbi_utils/irqchip/fdt_irqchip.h>
 #include <sbi_utils/irqchip/plic.h>
 
 #define PLIC_MAX_NR			16
+#define PLIC_MMODE_IRQ_MAX		4
 
 static unsigned long plic_count = 0;
 static struct plic_data plic[PLIC_MAX_NR];
@@ -23,13 +27,119 @@ static struct plic_data plic[PLIC_MAX_NR];
 static struct plic_data *plic_hartid2data[SBI_HARTMASK_MAX_BITS];
 static int plic_hartid2context[SBI_HARTMASK_MAX_BITS][2];
 
+/* HARTs whose contexts were reset by the cold boot HART */
+static struct sbi_hartmask plic_reset_harts;
+
+/* Sources handled in M-mode by the HART which set them up */
+struct plic_mmode_irq {
+	struct plic_data *pd;
+	u32 hwirq;
+	u32 hartid;
+	void (*fn)(void);
+};
+static struct plic_mmode_irq plic_mmode_irqs[PLIC_MMODE_IRQ_MAX];
+static u32 plic_mmode_irq_count;
+
+static void irqchip_plic_mmode_irq_enable(const struct plic_mmode_irq *mi)
+{
+	int cntx = plic_hartid2context[mi->hartid][0];
+
+	plic_enable_irq(mi->pd, cntx, mi->hwirq, TRUE);
+	plic_set_thresh(mi->pd, cntx, 0);
+}
+
+static int irqchip_plic_mmode_irqfn(struct sbi_trap_regs *regs,
+				    struct sbi_trap_info *trap)
+{
+	u32 i, hwirq, hartid = current_hartid();
+	struct plic_data *pd = plic_hartid2data[hartid];
+	int cntx = plic_hartid2context[hartid][0];
+
+	if (!pd || cntx < 0)
+		return SBI_ENODEV;
+
+	while ((hwirq = plic_claim(pd, cntx))) {
+		for (i = 0; i < plic_mmode_irq_count; i++) {
+			if (plic_mmode_irqs[i].pd == pd &&
+			    plic_mmode_irqs[i].hwirq == hwirq) {
+				plic_mmode_irqs[i].fn();
+				break;
+			}
+		}
+		plic_complete(pd, cntx, hwirq);
+	}
+
+	return 0;
+}
+
+static int irqchip_plic_mmode_irq_set(void *fdt, int nodeoff, u32 hwirq,
+				      void (*fn)(void))
+{
+	int rc;
+	u32 i, hartid = current_hartid();
+	struct plic_data tpd, *pd = NULL;
+	struct plic_mmode_irq *mi;
+
+	rc = fdt_parse_plic_node(fdt, nodeoff, &tpd);
+	if (rc)
+		return rc;
+	for (i = 0; i < plic_count; i++) {
+		if (plic[i].addr == tpd.addr)
+			pd = &plic[i];
+	}
+
+	if (!pd || plic_hartid2data[hartid] != pd ||
+	    plic_hartid2context[hartid][0] < 0 ||
+	    !hwirq || pd->num_src < hwirq)
+		return SBI_ENODEV;
+	if (PLIC_MMODE_IRQ_MAX <= plic_mmode_irq_count)
+		return SBI_ENOSPC;
+
+	rc = sbi_trap_set_handler(MCAUSE_IRQ_MASK | IRQ_M_EXT,
+				  irqchip_plic_mmode_irqfn);
+	if (rc)
+		return rc;
+
+	mi = &plic_mmode_irqs[plic_mmode_irq_count++];
+	mi->pd = pd;
+	mi->hwirq = hwirq;
+	mi->hartid = hartid;
+	mi->fn = fn;
+
+	plic_set_priority(pd, hwirq, 1);
+	irqchip_plic_mmode_irq_enable(mi);
+	csr_set(CSR_MIE, MIP_MEIP);
+
+	return 0;
+}
+
 static int irqchip_plic_warm_init(void)
 {
-	u32 hartid = current_hartid();
+	int rc = 0;
+	u32 i, hartid = current_hartid();
+	bool mmode = FALSE;
+
+	/* Only the first warm init after cold boot can be skipped */
+	if (sbi_hartmask_test_hart(hartid, &plic_reset_harts))
+		sbi_hartmask_clear_hart(hartid, &plic_reset_harts);
+	else
+		rc = plic_warm_irqchip_init(plic_hartid2data[hartid],
+					    plic_hartid2context[hartid][0],
+					    plic_hartid2context[hartid][1]);
+	if (rc)
+		return rc;
+
+	/* Sources handled in M-mode by this HART survive its restart */
+	for (i = 0; i < plic_mmode_irq_count; i++) {
+		if (plic_mmode_irqs[i].hartid != hartid)
+			continue;
+		irqchip_plic_mmode_irq_enable(&plic_mmode_irqs[i]);
+		mmode = TRUE;
+	}
+	if (mmode)
+		csr_set(CSR_MIE, MIP_MEIP);
 
-	return plic_warm_irqchip_init(plic_hartid2data[hartid],
-				      plic_hartid2context[hartid][0],
-				      plic_hartid2context[hartid][1]);
+	return 0;
 }
 
 static int irqchip_plic_update_hartid_table(void *fdt, int nodeoff,
@@ -37,7 +147,7 @@ static int irqchip_plic_update_hartid_table(void *fdt, int nodeoff,
 {
 	const fdt32_t *val;
 	u32 phandle, hwirq, hartid;
-	int i, err, count, cpu_offset, cpu_intc_offset;
+	int i, err, count;
 
 	val = fdt_getprop(fdt, nodeoff, "interrupts-extended", &count);
 	if (!val || count < sizeof(fdt32_t))
@@ -48,15 +158,7 @@ static int irqchip_plic_update_hartid_table(void *fdt, int nodeoff,
 		phandle = fdt32_to_cpu(val[i]);
 		hwirq = fdt32_to_cpu(val[i + 1]);
 
-		cpu_intc_offset = fdt_node_offset_by_phandle(fdt, phandle);
-		if (cpu_intc_offset < 0)
-			continue;
-
-		cpu_offset = fdt_parent_offset(fdt, cpu_intc_offset);
-		if (cpu_intc_offset < 0)
-			continue;
-
-		err = fdt_parse_hart_id(fdt, cpu_offset, &hartid);
+		err = fdt_parse_hart_id_by_intc(fdt, phandle, &hartid);
 		if (err)
 			continue;
 
@@ -96,6 +198,7 @@ static int irqchip_plic_cold_init(void *fdt, int nodeoff,
 		return rc;
 
 	if (plic_count == 1) {
+		sbi_hartmask_clear_all(&plic_reset_harts);
 		for (i = 0; i < SBI_HARTMASK_MAX_BITS; i++) {
 			plic_hartid2data[i] = NULL;
 			plic_hartid2context[i][0] = -1;
@@ -103,7 +206,23 @@ static int irqchip_plic_cold_init(void *fdt, int nodeoff,
 		}
 	}
 
-	return irqchip_plic_update_hartid_table(fdt, nodeoff, pd);
+	rc = irqchip_plic_update_hartid_table(fdt, nodeoff, pd);
+	if (rc)
+		return rc;
+
+	/* Reset the contexts of all HARTs of this PLIC in one sweep */
+	for (i = 0; i <= sbi_scratch_last_hartid() &&
+		    i < SBI_HARTMASK_MAX_BITS; i++) {
+		if (plic_hartid2data[i] != pd)
+			continue;
+
+		rc = plic_reset_contexts(pd, plic_hartid2context[i], 2);
+		if (rc)
+			return rc;
+		sbi_hartmask_set_hart(i, &plic_reset_harts);
+	}
+
+	return 0;
 }
 
 static const struct fdt_match irqchip_plic_match[] = {
@@ -117,4 +236,5 @@ struct fdt_irqchip fdt_irqchip_plic = {
 	.cold_init = irqchip_plic_cold_init,
 	.warm_init = irqchip_plic_warm_init,
 	.exit = NULL,
+	.mmode_irq_set = irqchip_plic_mmode_irq_set,
 };
@@ -0,0 +1,255 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_io.h>
+#include <sbi/riscv_encoding.h>
+#include <sbi/sbi_bitops.h>
+#include <sbi/sbi_console.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hartmask.h>
+#include <sbi/sbi_ipi.h>
+#include <sbi/sbi_trap.h>
+#include <sbi_utils/irqchip/imsic.h>
+
+/* clang-format off */
+
+#define IMSIC_MMIO_SETIPNUM_LE		0x000
+
+#define IMSIC_MIN_ID			63
+#define IMSIC_MAX_ID			2047
+
+#define IMSIC_EIDELIVERY		0x70
+#define IMSIC_EITHRESHOLD		0x72
+#define IMSIC_EIP0			0x80
+#define IMSIC_EIE0			0xc0
+#define IMSIC_EIPx_BITS			32
+
+#define IMSIC_TOPEI_ID_SHIFT		16
+
+#define IMSIC_IPI_ID			1
+
+/* clang-format on */
+
+static struct imsic_data *imsic_hartid2data[SBI_HARTMASK_MAX_BITS];
+static unsigned long imsic_hartid2addr[SBI_HARTMASK_MAX_BITS];
+
+/* Address of the interrupt file at given index or 0 if there is none */
+static unsigned long imsic_file_addr(struct imsic_data *imsic, int file)
+{
+	u32 i;
+	unsigned long reloff;
+
+	reloff = (unsigned long)file * IMSIC_MMIO_PAGE_SZ;
+	reloff <<= imsic->guest_index_bits;
+	for (i = 0; i < IMSIC_MAX_REGS && imsic->regs[i].size; i++) {
+		if (reloff < imsic->regs[i].size)
+			return imsic->regs[i].addr + reloff;
+		reloff -= imsic->regs[i].size;
+	}
+
+	return 0;
+}
+
+int imsic_map_hartid_to_data(u32 hartid, struct imsic_data *imsic, int file)
+{
+	unsigned long addr;
+
+	if (!imsic || !imsic->targets_mmode ||
+	    (SBI_HARTMASK_MAX_BITS <= hartid) || (file < 0))
+		return SBI_EINVAL;
+
+	addr = imsic_file_addr(imsic, file);
+	if (!addr)
+		return SBI_EINVAL;
+
+	imsic_hartid2data[hartid] = imsic;
+	imsic_hartid2addr[hartid] = addr;
+
+	return 0;
+}
+
+struct imsic_data *imsic_get_data(u32 hartid)
+{
+	if (SBI_HARTMASK_MAX_BITS <= hartid)
+		return NULL;
+	return imsic_hartid2data[hartid];
+}
+
+static void imsic_local_eix_update(unsigned long base_id,
+				   unsigned long num_id, bool pend, bool val)
+{
+	unsigned long i, isel, ireg;
+	unsigned long id = base_id, last_id = base_id + num_id;
+
+	while (id < last_id) {
+		isel = id / __riscv_xlen;
+		isel *= __riscv_xlen / IMSIC_EIPx_BITS;
+		isel += (pend) ? IMSIC_EIP0 : IMSIC_EIE0;
+
+		ireg = 0;
+		for (i = id & (__riscv_xlen - 1);
+		     (id < last_id) && (i < __riscv_xlen); i++) {
+			ireg |= BIT(i);
+			id++;
+		}
+
+		csr_write(CSR_MISELECT, isel);
+		if (val)
+			csr_set(CSR_MIREG, ireg);
+		else
+			csr_clear(CSR_MIREG, ireg);
+	}
+}
+
+static void imsic_ipi_send(u32 target_hart)
+{
+	if (SBI_HARTMASK_MAX_BITS <= target_hart ||
+	    !imsic_hartid2addr[target_hart])
+		return;
+
+	writel(IMSIC_IPI_ID,
+	       (void *)imsic_hartid2addr[target_hart] + IMSIC_MMIO_SETIPNUM_LE);
+}
+
+static void imsic_ipi_clear(u32 target_hart)
+{
+	/* Only the pending bit of current HART can be cleared */
+	if (target_hart != current_hartid())
+		return;
+
+	imsic_local_eix_update(IMSIC_IPI_ID, 1, TRUE, FALSE);
+}
+
+static struct sbi_ipi_device imsic_ipi_device = {
+	.name		= "aia-imsic",
+	.ipi_send	= imsic_ipi_send,
+	.ipi_clear	= imsic_ipi_clear
+};
+
+static int imsic_external_irqfn(struct sbi_trap_regs *regs,
+				struct sbi_trap_info *trap)
+{
+	ulong mirq;
+
+	/* Claim (and clear) the highest priority pending identity */
+	while ((mirq = csr_swap(CSR_MTOPEI, 0))) {
+		mirq = mirq >> IMSIC_TOPEI_ID_SHIFT;
+
+		switch (mirq) {
+		case IMSIC_IPI_ID:
+			sbi_ipi_process();
+			break;
+		default:
+			sbi_printf("%s: unhandled IRQ%d\n",
+				   __func__, (u32)mirq);
+			break;
+		}
+	}
+
+	return 0;
+}
+
+void imsic_local_irqchip_init(void)
+{
+	/* Deliver all enabled identities of the M-level interrupt file */
+	csr_write(CSR_MISELECT, IMSIC_EITHRESHOLD);
+	csr_write(CSR_MIREG, 0);
+	csr_write(CSR_MISELECT, IMSIC_EIDELIVERY);
+	csr_write(CSR_MIREG, 1);
+
+	/* Enable IPIs */
+	imsic_local_eix_update(IMSIC_IPI_ID, 1, FALSE, TRUE);
+}
+
+int imsic_warm_irqchip_init(void)
+{
+	struct imsic_data *imsic = imsic_get_data(current_hartid());
+
+	if (!imsic)
+		return SBI_EINVAL;
+
+	/*
+	 * Disable and clear all identities except the IPI which may
+	 * already be pending for the HART being started.
+	 */
+	imsic_local_eix_update(IMSIC_IPI_ID + 1, imsic->num_ids - 1,
+			       FALSE, FALSE);
+	imsic_local_eix_update(IMSIC_IPI_ID + 1, imsic->num_ids - 1,
+			       TRUE, FALSE);
+
+	imsic_local_irqchip_init();
+
+	/* Enable M-level external interrupts for IPIs */
+	csr_set(CSR_MIE, MIP_MEIP);
+
+	return 0;
+}
+
+int imsic_data_check(struct imsic_data *imsic)
+{
+	u32 tmp;
+
+	if (!imsic || !imsic->regs[0].size)
+		return SBI_EINVAL;
+
+	if ((imsic->num_ids < IMSIC_MIN_ID) ||
+	    (IMSIC_MAX_ID < imsic->num_ids) ||
+	    ((imsic->num_ids & IMSIC_MIN_ID) != IMSIC_MIN_ID))
+		return SBI_EINVAL;
+
+	tmp = __riscv_xlen - IMSIC_MMIO_PAGE_SHIFT;
+	if (tmp < imsic->guest_index_bits)
+		return SBI_EINVAL;
+
+	tmp -= imsic->guest_index_bits;
+	if (tmp < imsic->hart_index_bits)
+		return SBI_EINVAL;
+
+	tmp = imsic->guest_index_bits + imsic->hart_index_bits +
+	      IMSIC_MMIO_PAGE_SHIFT;
+	if ((imsic->group_index_shift < tmp) ||
+	    (__riscv_xlen < (imsic->group_index_shift +
+			     imsic->group_index_bits)))
+		return SBI_EINVAL;
+
+	return 0;
+}
+
+int imsic_cold_irqchip_init(struct imsic_data *imsic)
+{
+	u32 i;
+	int rc;
+	struct sbi_domain_memregion reg;
+
+	rc = imsic_data_check(imsic);
+	if (rc)
+		return rc;
+
+	/* S-level interrupt files are left to the next booting stage */
+	if (!imsic->targets_mmode)
+		return 0;
+
+	rc = sbi_trap_set_handler(MCAUSE_IRQ_MASK | IRQ_M_EXT,
+				  imsic_external_irqfn);
+	if (rc)
+		return rc;
+
+	/* Add M-level interrupt files to the root domain */
+	for (i = 0; i < IMSIC_MAX_REGS && imsic->regs[i].size; i++) {
+		sbi_domain_memregion_init(imsic->regs[i].addr,
+					  imsic->regs[i].size,
+					  SBI_DOMAIN_MEMREGION_MMIO, &reg);
+		rc = sbi_domain_root_add_memregion(&reg);
+		if (rc)
+			return rc;
+	}
+
+	sbi_ipi_set_device(&imsic_ipi_device);
+
+	return 0;
+}
@@ -8,5 +8,10 @@
 #
 
 libsbiutils-objs-y += irqchip/fdt_irqchip.o
-libsbiutils-objs-y += irqchip/fdt_irqchip_plic.o
+libsbiutils-objs-$(FDT_IRQCHIP_APLIC) += irqchip/fdt_irqchip_aplic.o
+libsbiutils-objs-$(FDT_IRQCHIP_IMSIC) += irqchip/fdt_irqchip_imsic.o
+libsbiutils-objs-$(FDT_IRQCHIP_PLIC) += irqchip/fdt_irqchip_plic.o
+libsbiutils-objs-y += irqchip/aplic.o
+libsbiutils-objs-y += irqchip/eclic.o
+libsbiutils-objs-y += irqchip/imsic.o
 libsbiutils-objs-y += irqchip/plic.o
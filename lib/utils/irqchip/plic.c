@@ -7,6 +7,7 @@
  *   Anup Patel <anup.patel@wdc.com>
  */
 
+#include <sbi/riscv_barrier.h>
 #include <sbi/riscv_io.h>
 #include <sbi/riscv_encoding.h>
 #include <sbi/sbi_console.h>
@@ -20,12 +21,25 @@
 #define PLIC_ENABLE_STRIDE 0x80
 #define PLIC_CONTEXT_BASE 0x200000
 #define PLIC_CONTEXT_STRIDE 0x1000
+#define PLIC_CONTEXT_CLAIM 0x4
 
-static void plic_set_priority(struct plic_data *plic, u32 source, u32 val)
+/*
+ * Context reset is only made of writes to the PLIC, so the writes are
+ * relaxed and ordered with a single barrier by the callers.
+ */
+static void plic_context_reset(struct plic_data *plic, int cntx_id)
 {
-	volatile void *plic_priority = (void *)plic->addr +
-			PLIC_PRIORITY_BASE + 4 * source;
-	writel(val, plic_priority);
+	size_t i, ie_words = plic->num_src / 32 + 1;
+	volatile void *plic_ie = (void *)plic->addr +
+			PLIC_ENABLE_BASE + PLIC_ENABLE_STRIDE * cntx_id;
+
+	/* By default, disable all IRQs of the context */
+	for (i = 0; i < ie_words; i++)
+		writel_relaxed(0, plic_ie + i * 4);
+
+	/* By default, disable the context threshold */
+	writel_relaxed(0x7, (void *)plic->addr +
+		       PLIC_CONTEXT_BASE + PLIC_CONTEXT_STRIDE * cntx_id);
 }
 
 void plic_set_thresh(struct plic_data *plic, u32 cntxid, u32 val)
@@ -52,49 +66,89 @@ void plic_set_ie(struct plic_data *plic, u32 cntxid, u32 word_index, u32 val)
 	writel(val, plic_ie + word_index * 4);
 }
 
-int plic_warm_irqchip_init(struct plic_data *plic,
-			   int m_cntx_id, int s_cntx_id)
+void plic_set_priority(struct plic_data *plic, u32 irq, u32 val)
+{
+	if (!plic || !irq || plic->num_src < irq)
+		return;
+
+	writel(val, (void *)plic->addr + PLIC_PRIORITY_BASE + 4 * irq);
+}
+
+void plic_enable_irq(struct plic_data *plic, u32 cntxid, u32 irq,
+		     bool enable)
 {
-	size_t i, ie_words;
+	u32 val;
+	volatile void *plic_ie;
+
+	if (!plic || !irq || plic->num_src < irq)
+		return;
 
+	plic_ie = (void *)plic->addr + PLIC_ENABLE_BASE +
+		  PLIC_ENABLE_STRIDE * cntxid + (irq / 32) * 4;
+	val = readl(plic_ie);
+	if (enable)
+		val |= 1U << (irq % 32);
+	else
+		val &= ~(1U << (irq % 32));
+	writel(val, plic_ie);
+}
+
+u32 plic_claim(struct plic_data *plic, u32 cntxid)
+{
 	if (!plic)
-		return SBI_EINVAL;
+		return 0;
 
-	ie_words = plic->num_src / 32 + 1;
+	return readl((void *)plic->addr + PLIC_CONTEXT_BASE +
+		     PLIC_CONTEXT_STRIDE * cntxid + PLIC_CONTEXT_CLAIM);
+}
 
-	/* By default, disable all IRQs for M-mode of target HART */
-	if (m_cntx_id > -1) {
-		for (i = 0; i < ie_words; i++)
-			plic_set_ie(plic, m_cntx_id, i, 0);
-	}
+void plic_complete(struct plic_data *plic, u32 cntxid, u32 irq)
+{
+	if (!plic)
+		return;
 
-	/* By default, disable all IRQs for S-mode of target HART */
-	if (s_cntx_id > -1) {
-		for (i = 0; i < ie_words; i++)
-			plic_set_ie(plic, s_cntx_id, i, 0);
-	}
+	writel(irq, (void *)plic->addr + PLIC_CONTEXT_BASE +
+	       PLIC_CONTEXT_STRIDE * cntxid + PLIC_CONTEXT_CLAIM);
+}
 
-	/* By default, disable M-mode threshold */
-	if (m_cntx_id > -1)
-		plic_set_thresh(plic, m_cntx_id, 0x7);
+int plic_reset_contexts(struct plic_data *plic, const int *cntx_ids,
+			u32 count)
+{
+	u32 i;
 
-	/* By default, disable S-mode threshold */
-	if (s_cntx_id > -1)
-		plic_set_thresh(plic, s_cntx_id, 0x7);
+	if (!plic || (count && !cntx_ids))
+		return SBI_EINVAL;
+
+	wmb();
+	for (i = 0; i < count; i++) {
+		if (cntx_ids[i] > -1)
+			plic_context_reset(plic, cntx_ids[i]);
+	}
 
 	return 0;
 }
 
+int plic_warm_irqchip_init(struct plic_data *plic,
+			   int m_cntx_id, int s_cntx_id)
+{
+	int cntx_ids[2] = { m_cntx_id, s_cntx_id };
+
+	return plic_reset_contexts(plic, cntx_ids, array_size(cntx_ids));
+}
+
 int plic_cold_irqchip_init(struct plic_data *plic)
 {
 	int i;
+	volatile void *plic_priority;
 
 	if (!plic)
 		return SBI_EINVAL;
 
 	/* Configure default priorities of all IRQs */
+	wmb();
+	plic_priority = (void *)plic->addr + PLIC_PRIORITY_BASE;
 	for (i = 1; i <= plic->num_src; i++)
-		plic_set_priority(plic, i, 0);
+		writel_relaxed(0, plic_priority + 4 * i);
 
 	return 0;
 }
@@ -35,6 +35,16 @@
 #define strncmp		sbi_strncmp
 #define strlen		sbi_strlen
 #define strnlen		sbi_strnlen
+#define strtoul		sbi_strtoul
+
+/*
+ * OpenSBI enables the ASSUME_VALID_DTB fast paths of libfdt at runtime
+ * once the DTB has been checked in full (see fdt_trust()). All other
+ * assumptions stay disabled at build time.
+ */
+#define FDT_ASSUME_VALID_DTB	0x1
+extern int fdt_assume_mask;
+#define FDT_ASSUME_MASK		(fdt_assume_mask & FDT_ASSUME_VALID_DTB)
 
 typedef uint16_t FDT_BITWISE fdt16_t;
 typedef uint32_t FDT_BITWISE fdt32_t;
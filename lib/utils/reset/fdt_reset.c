@@ -16,9 +16,15 @@ extern struct fdt_reset fdt_reset_htif;
 extern struct fdt_reset fdt_reset_thead;
 
 static struct fdt_reset *reset_drivers[] = {
+#ifndef FDT_RESET_SIFIVE_DISABLED
 	&fdt_reset_sifive,
+#endif
+#ifndef FDT_RESET_HTIF_DISABLED
 	&fdt_reset_htif,
+#endif
+#ifndef FDT_RESET_THEAD_DISABLED
 	&fdt_reset_thead,
+#endif
 };
 
 static struct fdt_reset *current_driver = NULL;
@@ -8,7 +8,7 @@
 #
 
 libsbiutils-objs-y += reset/fdt_reset.o
-libsbiutils-objs-y += reset/fdt_reset_htif.o
-libsbiutils-objs-y += reset/fdt_reset_sifive.o
-libsbiutils-objs-y += reset/fdt_reset_thead.o
-libsbiutils-objs-y += reset/fdt_reset_thead_asm.o
+libsbiutils-objs-$(FDT_RESET_HTIF) += reset/fdt_reset_htif.o
+libsbiutils-objs-$(FDT_RESET_SIFIVE) += reset/fdt_reset_sifive.o
+libsbiutils-objs-$(FDT_RESET_THEAD) += reset/fdt_reset_thead.o
+libsbiutils-objs-$(FDT_RESET_THEAD) += reset/fdt_reset_thead_asm.o
@@ -18,10 +18,18 @@ extern struct fdt_serial fdt_serial_htif;
 extern struct fdt_serial fdt_serial_shakti;
 
 static struct fdt_serial *serial_drivers[] = {
+#ifndef FDT_SERIAL_UART8250_DISABLED
 	&fdt_serial_uart8250,
+#endif
+#ifndef FDT_SERIAL_SIFIVE_DISABLED
 	&fdt_serial_sifive,
+#endif
+#ifndef FDT_SERIAL_HTIF_DISABLED
 	&fdt_serial_htif,
+#endif
+#ifndef FDT_SERIAL_SHAKTI_DISABLED
 	&fdt_serial_shakti,
+#endif
 };
 
 static struct fdt_serial dummy = {
@@ -30,6 +38,7 @@ static struct fdt_serial dummy = {
 };
 
 static struct fdt_serial *current_driver = &dummy;
+static int current_nodeoff = -1;
 
 int fdt_serial_init(void)
 {
@@ -61,6 +70,7 @@ int fdt_serial_init(void)
 				return rc;
 		}
 		current_driver = drv;
+		current_nodeoff = noff;
 		break;
 	}
 
@@ -82,9 +92,27 @@ int fdt_serial_init(void)
 				return rc;
 		}
 		current_driver = drv;
+		current_nodeoff = noff;
 		break;
 	}
 
 done:
 	return 0;
 }
+
+int fdt_serial_irq_init(void)
+{
+	int coff;
+	void *fdt = sbi_scratch_thishart_arg1_ptr();
+
+	if (!current_driver->irq_init || current_nodeoff < 0)
+		return 0;
+
+	/* The input would be stolen from S-mode drivers of the same UART */
+	coff = fdt_path_offset(fdt, "/chosen");
+	if (coff < 0 ||
+	    !fdt_get_property(fdt, coff, "opensbi,console-rx-irq", NULL))
+		return 0;
+
+	return current_driver->irq_init(fdt, current_nodeoff);
+}
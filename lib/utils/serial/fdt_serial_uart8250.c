@@ -7,7 +7,9 @@
  *   Anup Patel <anup.patel@wdc.com>
  */
 
+#include <sbi/sbi_error.h>
 #include <sbi_utils/fdt/fdt_helper.h>
+#include <sbi_utils/irqchip/fdt_irqchip.h>
 #include <sbi_utils/serial/fdt_serial.h>
 #include <sbi_utils/serial/uart8250.h>
 
@@ -25,6 +27,19 @@ static int serial_uart8250_init(void *fdt, int nodeoff,
 			     uart.reg_shift, uart.reg_io_width);
 }
 
+static int serial_uart8250_irq_init(void *fdt, int nodeoff)
+{
+	int rc;
+
+	rc = fdt_irqchip_mmode_irq_set(fdt, nodeoff, uart8250_rx_irq);
+	if (rc)
+		return (rc == SBI_ENODEV) ? 0 : rc;
+
+	uart8250_rx_irq_enable();
+
+	return 0;
+}
+
 static const struct fdt_match serial_uart8250_match[] = {
 	{ .compatible = "ns16550" },
 	{ .compatible = "ns16550a" },
@@ -34,4 +49,5 @@ static const struct fdt_match serial_uart8250_match[] = {
 struct fdt_serial fdt_serial_uart8250 = {
 	.match_table = serial_uart8250_match,
 	.init = serial_uart8250_init,
+	.irq_init = serial_uart8250_irq_init,
 };
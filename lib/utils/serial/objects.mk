@@ -8,10 +8,10 @@
 #
 
 libsbiutils-objs-y += serial/fdt_serial.o
-libsbiutils-objs-y += serial/fdt_serial_htif.o
-libsbiutils-objs-y += serial/fdt_serial_shakti.o
-libsbiutils-objs-y += serial/fdt_serial_sifive.o
-libsbiutils-objs-y += serial/fdt_serial_uart8250.o
+libsbiutils-objs-$(FDT_SERIAL_HTIF) += serial/fdt_serial_htif.o
+libsbiutils-objs-$(FDT_SERIAL_SHAKTI) += serial/fdt_serial_shakti.o
+libsbiutils-objs-$(FDT_SERIAL_SIFIVE) += serial/fdt_serial_sifive.o
+libsbiutils-objs-$(FDT_SERIAL_UART8250) += serial/fdt_serial_uart8250.o
 libsbiutils-objs-y += serial/shakti-uart.o
 libsbiutils-objs-y += serial/sifive-uart.o
 libsbiutils-objs-y += serial/uart8250.o
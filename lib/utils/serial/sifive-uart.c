@@ -74,6 +74,28 @@ static void sifive_uart_putc(char ch)
 	set_reg(UART_REG_TXFIFO, ch);
 }
 
+static unsigned long sifive_uart_puts(const char *str, unsigned long len)
+{
+	unsigned long i = 0;
+
+	/* Wait only for the first character, then fill the FIFO */
+	while (i < len) {
+		if (get_reg(UART_REG_TXFIFO) & UART_TXFIFO_FULL) {
+			if (i)
+				break;
+			continue;
+		}
+		set_reg(UART_REG_TXFIFO, str[i++]);
+	}
+
+	return i;
+}
+
+static bool sifive_uart_putc_ready(void)
+{
+	return (get_reg(UART_REG_TXFIFO) & UART_TXFIFO_FULL) ? FALSE : TRUE;
+}
+
 static int sifive_uart_getc(void)
 {
 	u32 ret = get_reg(UART_REG_RXFIFO);
@@ -85,6 +107,8 @@ static int sifive_uart_getc(void)
 static struct sbi_console_device sifive_console = {
 	.name = "sifive_uart",
 	.console_putc = sifive_uart_putc,
+	.console_puts = sifive_uart_puts,
+	.console_putc_ready = sifive_uart_putc_ready,
 	.console_getc = sifive_uart_getc
 };
 
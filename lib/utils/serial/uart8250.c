@@ -7,7 +7,9 @@
  *   Anup Patel <anup.patel@wdc.com>
  */
 
+#include <sbi/riscv_barrier.h>
 #include <sbi/riscv_io.h>
+#include <sbi/riscv_locks.h>
 #include <sbi/sbi_console.h>
 #include <sbi_utils/serial/uart8250.h>
 
@@ -37,6 +39,15 @@
 #define UART_LSR_DR		0x01	/* Receiver data ready */
 #define UART_LSR_BRK_ERROR_BITS	0x1E	/* BI, FE, PE, OE bits */
 
+#define UART_IIR_FIFO		0xC0	/* FIFOs enabled and working */
+
+#define UART_IER_RDI		0x01	/* Received data interrupt */
+
+#define UART8250_FIFO_DEPTH	16
+
+/* Size of the ring filled by the receive interrupt (power of two) */
+#define UART8250_RX_RING_SIZE	256
+
 /* clang-format on */
 
 static volatile void *uart8250_base;
@@ -44,6 +55,18 @@ static u32 uart8250_in_freq;
 static u32 uart8250_baudrate;
 static u32 uart8250_reg_width;
 static u32 uart8250_reg_shift;
+static u32 uart8250_fifo_depth = 1;
+
+/*
+ * With the receive interrupt the received characters are moved to a
+ * ring by the interrupt and by uart8250_getc() under uart8250_rx_lock,
+ * so HARTs reading the console don't race with the interrupt.
+ */
+static bool uart8250_rx_irq_enabled;
+static spinlock_t uart8250_rx_lock = SPIN_LOCK_INITIALIZER;
+static u32 uart8250_rx_head;
+static u32 uart8250_rx_tail;
+static u8 uart8250_rx_ring[UART8250_RX_RING_SIZE];
 
 static u32 get_reg(u32 num)
 {
@@ -77,16 +100,80 @@ static void uart8250_putc(char ch)
 	set_reg(UART_THR_OFFSET, ch);
 }
 
+static unsigned long uart8250_puts(const char *str, unsigned long len)
+{
+	unsigned long i;
+
+	/* The transmit FIFO is empty when the holding register is */
+	while ((get_reg(UART_LSR_OFFSET) & UART_LSR_THRE) == 0)
+		;
+
+	if (uart8250_fifo_depth < len)
+		len = uart8250_fifo_depth;
+	for (i = 0; i < len; i++)
+		set_reg(UART_THR_OFFSET, str[i]);
+
+	return len;
+}
+
+static bool uart8250_putc_ready(void)
+{
+	return (get_reg(UART_LSR_OFFSET) & UART_LSR_THRE) ? TRUE : FALSE;
+}
+
+/* Move received characters to the ring, dropping them when it is full */
+static void uart8250_rx_fill(void)
+{
+	u32 ch;
+
+	while (get_reg(UART_LSR_OFFSET) & UART_LSR_DR) {
+		ch = get_reg(UART_RBR_OFFSET);
+		if (uart8250_rx_head - uart8250_rx_tail < UART8250_RX_RING_SIZE)
+			uart8250_rx_ring[uart8250_rx_head++ &
+					 (UART8250_RX_RING_SIZE - 1)] = ch;
+	}
+}
+
+void uart8250_rx_irq(void)
+{
+	spin_lock(&uart8250_rx_lock);
+	uart8250_rx_fill();
+	spin_unlock(&uart8250_rx_lock);
+}
+
+void uart8250_rx_irq_enable(void)
+{
+	uart8250_rx_irq_enabled = TRUE;
+	smp_wmb();
+	set_reg(UART_IER_OFFSET, UART_IER_RDI);
+}
+
 static int uart8250_getc(void)
 {
-	if (get_reg(UART_LSR_OFFSET) & UART_LSR_DR)
-		return get_reg(UART_RBR_OFFSET);
-	return -1;
+	int ret = -1;
+
+	if (!uart8250_rx_irq_enabled) {
+		if (get_reg(UART_LSR_OFFSET) & UART_LSR_DR)
+			return get_reg(UART_RBR_OFFSET);
+		return -1;
+	}
+
+	/* Also pick up what the HART taking the interrupt did not yet */
+	spin_lock(&uart8250_rx_lock);
+	uart8250_rx_fill();
+	if (uart8250_rx_head != uart8250_rx_tail)
+		ret = uart8250_rx_ring[uart8250_rx_tail++ &
+				       (UART8250_RX_RING_SIZE - 1)];
+	spin_unlock(&uart8250_rx_lock);
+
+	return ret;
 }
 
 static struct sbi_console_device uart8250_console = {
 	.name = "uart8250",
 	.console_putc = uart8250_putc,
+	.console_puts = uart8250_puts,
+	.console_putc_ready = uart8250_putc_ready,
 	.console_getc = uart8250_getc
 };
 
@@ -119,6 +206,9 @@ int uart8250_init(unsigned long base, u32 in_freq, u32 baudrate, u32 reg_shift,
 	set_reg(UART_LCR_OFFSET, 0x03);
 	/* Enable FIFO */
 	set_reg(UART_FCR_OFFSET, 0x01);
+	/* Only a 16550A (or later) has a working FIFO */
+	uart8250_fifo_depth = ((get_reg(UART_IIR_OFFSET) & UART_IIR_FIFO) ==
+			       UART_IIR_FIFO) ? UART8250_FIFO_DEPTH : 1;
 	/* No modem control DTR RTS */
 	set_reg(UART_MCR_OFFSET, 0x00);
 	/* Clear line status */
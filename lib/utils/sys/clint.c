@@ -14,6 +14,8 @@
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_hartmask.h>
 #include <sbi/sbi_ipi.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
 #include <sbi/sbi_timer.h>
 #include <sbi_utils/sys/clint.h>
 
@@ -26,34 +28,76 @@
 #define CLINT_TIME_VAL_OFF	0xbff8
 #define CLINT_TIME_VAL_SIZE	0x4000
 
-static struct clint_data *clint_ipi_hartid2data[SBI_HARTMASK_MAX_BITS];
+#define CLINT_TIME_SYNC_SAMPLES	16
+
+/*
+ * Per-HART CLINT register pointers cached in the HART scratch space
+ * so that the IPI and timer hot paths don't need to look-up the
+ * CLINT instance and compute the HART offset on every access.
+ */
+struct clint_hart_regs {
+	u32 *ipi;
+	u64 *time_cmp;
+	struct clint_data *timer;
+};
+
+static unsigned long clint_hart_regs_offset;
+
+static struct clint_hart_regs *clint_hart_regs(u32 hartid)
+{
+	struct sbi_scratch *scratch;
+
+	if (!clint_hart_regs_offset || SBI_HARTMASK_MAX_BITS <= hartid)
+		return NULL;
+	scratch = sbi_hartid_to_scratch(hartid);
+	if (!scratch)
+		return NULL;
+
+	return sbi_scratch_offset_ptr(scratch, clint_hart_regs_offset);
+}
+
+static int clint_hart_regs_init(void)
+{
+	u32 i;
+	struct clint_hart_regs *regs;
+
+	if (clint_hart_regs_offset)
+		return 0;
+
+	clint_hart_regs_offset = sbi_scratch_alloc_offset(sizeof(*regs),
+							  "CLINT_HART_REGS");
+	if (!clint_hart_regs_offset)
+		return SBI_ENOMEM;
+
+	for (i = 0; i <= sbi_scratch_last_hartid(); i++) {
+		regs = clint_hart_regs(i);
+		if (regs)
+			sbi_memset(regs, 0, sizeof(*regs));
+	}
+
+	return 0;
+}
 
 static void clint_ipi_send(u32 target_hart)
 {
-	struct clint_data *clint;
+	struct clint_hart_regs *regs = clint_hart_regs(target_hart);
 
-	if (SBI_HARTMASK_MAX_BITS <= target_hart)
-		return;
-	clint = clint_ipi_hartid2data[target_hart];
-	if (!clint)
+	if (!regs || !regs->ipi)
 		return;
 
 	/* Set CLINT IPI */
-	writel(1, &clint->ipi[target_hart - clint->first_hartid]);
+	writel(1, regs->ipi);
 }
 
 static void clint_ipi_clear(u32 target_hart)
 {
-	struct clint_data *clint;
+	struct clint_hart_regs *regs = clint_hart_regs(target_hart);
 
-	if (SBI_HARTMASK_MAX_BITS <= target_hart)
-		return;
-	clint = clint_ipi_hartid2data[target_hart];
-	if (!clint)
+	if (!regs || !regs->ipi)
 		return;
 
 	/* Clear CLINT IPI */
-	writel(0, &clint->ipi[target_hart - clint->first_hartid]);
+	writel(0, regs->ipi);
 }
 
 static struct sbi_ipi_device clint_ipi = {
@@ -74,17 +118,25 @@ int clint_cold_ipi_init(struct clint_data *clint)
 {
 	u32 i;
 	int rc;
+	struct clint_hart_regs *regs;
 	struct sbi_domain_memregion reg;
 
 	if (!clint)
 		return SBI_EINVAL;
 
+	rc = clint_hart_regs_init();
+	if (rc)
+		return rc;
+
 	/* Initialize private data */
 	clint->ipi = (void *)clint->addr;
 
-	/* Update IPI hartid table */
-	for (i = 0; i < clint->hart_count; i++)
-		clint_ipi_hartid2data[clint->first_hartid + i] = clint;
+	/* Cache IPI register pointer of each HART */
+	for (i = 0; i < clint->hart_count; i++) {
+		regs = clint_hart_regs(clint->first_hartid + i);
+		if (regs)
+			regs->ipi = &clint->ipi[i];
+	}
 
 	/* Add CLINT ipi region to the root domain */
 	sbi_domain_memregion_init(clint->addr + CLINT_IPI_OFF,
@@ -99,8 +151,6 @@ int clint_cold_ipi_init(struct clint_data *clint)
 	return 0;
 }
 
-static struct clint_data *clint_timer_hartid2data[SBI_HARTMASK_MAX_BITS];
-
 #if __riscv_xlen != 32
 static u64 clint_time_rd64(volatile u64 *addr)
 {
@@ -117,10 +167,15 @@ static u64 clint_time_rd32(volatile u64 *addr)
 {
 	u32 lo, hi;
 
+	/*
+	 * A carry into the high word between the two reads would leave
+	 * the low word close to zero, so the high word only needs to be
+	 * read again when the top bit of the low word is clear.
+	 */
 	do {
 		hi = readl_relaxed((u32 *)addr + 1);
 		lo = readl_relaxed((u32 *)addr);
-	} while (hi != readl_relaxed((u32 *)addr + 1));
+	} while (!(lo & 0x80000000U) && hi != readl_relaxed((u32 *)addr + 1));
 
 	return ((u64)hi << 32) | (u64)lo;
 }
@@ -129,13 +184,22 @@ static void clint_time_wr32(u64 value, volatile u64 *addr)
 {
 	u32 mask = -1U;
 
+	/*
+	 * Park the high word at all-ones while the low word changes so
+	 * that no intermediate value is below both the old and the new
+	 * compare value and raises a spurious timer interrupt.
+	 */
+	writel_relaxed(mask, (void *)(addr) + 0x04);
 	writel_relaxed(value & mask, (void *)(addr));
-	writel_relaxed(value >> 32, (void *)(addr) + 0x04);
+	if ((value >> 32) != mask)
+		writel_relaxed(value >> 32, (void *)(addr) + 0x04);
 }
 
 static u64 clint_timer_value(void)
 {
-	struct clint_data *clint = clint_timer_hartid2data[current_hartid()];
+	struct clint_hart_regs *regs =
+			sbi_scratch_thishart_offset_ptr(clint_hart_regs_offset);
+	struct clint_data *clint = regs->timer;
 
 	/* Read CLINT Time Value */
 	return clint->time_rd(clint->time_val) + clint->time_delta;
@@ -143,40 +207,166 @@ static u64 clint_timer_value(void)
 
 static void clint_timer_event_stop(void)
 {
-	u32 target_hart = current_hartid();
-	struct clint_data *clint = clint_timer_hartid2data[target_hart];
+	struct clint_hart_regs *regs =
+			sbi_scratch_thishart_offset_ptr(clint_hart_regs_offset);
 
 	/* Clear CLINT Time Compare */
-	clint->time_wr(-1ULL,
-			&clint->time_cmp[target_hart - clint->first_hartid]);
+	regs->timer->time_wr(-1ULL, regs->time_cmp);
 }
 
 static void clint_timer_event_start(u64 next_event)
 {
-	u32 target_hart = current_hartid();
-	struct clint_data *clint = clint_timer_hartid2data[target_hart];
+	struct clint_hart_regs *regs =
+			sbi_scratch_thishart_offset_ptr(clint_hart_regs_offset);
+	struct clint_data *clint = regs->timer;
 
 	/* Program CLINT Time Compare */
-	clint->time_wr(next_event - clint->time_delta,
-		       &clint->time_cmp[target_hart - clint->first_hartid]);
+	clint->time_wr(next_event - clint->time_delta, regs->time_cmp);
+}
+
+static u64 clint_timer_event_get(u32 hartid)
+{
+	u64 time_cmp;
+	struct clint_hart_regs *regs = clint_hart_regs(hartid);
+
+	if (!regs || !regs->timer)
+		return -1ULL;
+
+	/* Read CLINT Time Compare of a (possibly remote) HART */
+	time_cmp = regs->timer->time_rd(regs->time_cmp);
+	if (time_cmp == -1ULL)
+		return -1ULL;
+
+	return time_cmp + regs->timer->time_delta;
+}
+
+static void clint_timer_event_set(u32 hartid, u64 next_event)
+{
+	struct clint_hart_regs *regs = clint_hart_regs(hartid);
+
+	if (!regs || !regs->timer)
+		return;
+
+	/* Program CLINT Time Compare of a (possibly remote) HART */
+	regs->timer->time_wr(next_event - regs->timer->time_delta,
+			     regs->time_cmp);
+}
+
+static int clint_timer_event_fast_regs(unsigned long *timecmp_addr,
+				       unsigned long *delta_addr)
+{
+#if __riscv_xlen != 32
+	struct clint_hart_regs *regs =
+			sbi_scratch_thishart_offset_ptr(clint_hart_regs_offset);
+
+	if (regs->timer->time_wr != clint_time_wr64)
+		return SBI_ENOTSUPP;
+
+	*timecmp_addr = (unsigned long)regs->time_cmp;
+	*delta_addr = (unsigned long)&regs->timer->time_delta;
+
+	return 0;
+#else
+	return SBI_ENOTSUPP;
+#endif
+}
+
+static int clint_timer_value_fast_regs(unsigned long *time_addr,
+				       unsigned long *delta_addr)
+{
+#if __riscv_xlen != 32
+	struct clint_hart_regs *regs =
+			sbi_scratch_thishart_offset_ptr(clint_hart_regs_offset);
+
+	if (regs->timer->time_rd != clint_time_rd64)
+		return SBI_ENOTSUPP;
+
+	*time_addr = (unsigned long)regs->timer->time_val;
+	*delta_addr = (unsigned long)&regs->timer->time_delta;
+
+	return 0;
+#else
+	return SBI_ENOTSUPP;
+#endif
+}
+
+static int clint_timer_sync_get(u32 hartid, s64 *out_skew, u64 *out_error)
+{
+	struct clint_hart_regs *regs = clint_hart_regs(hartid);
+
+	if (!regs || !regs->timer)
+		return SBI_EINVAL;
+
+	*out_skew = regs->timer->time_skew;
+	*out_error = regs->timer->time_sync_error;
+
+	return 0;
 }
 
 static struct sbi_timer_device clint_timer = {
 	.name = "clint",
 	.timer_value = clint_timer_value,
 	.timer_event_start = clint_timer_event_start,
-	.timer_event_stop = clint_timer_event_stop
+	.timer_event_stop = clint_timer_event_stop,
+	.timer_event_get = clint_timer_event_get,
+	.timer_event_set = clint_timer_event_set,
+	.timer_sync_get = clint_timer_sync_get,
+	.timer_event_fast_regs = clint_timer_event_fast_regs,
+	.timer_value_fast_regs = clint_timer_value_fast_regs
 };
 
+/*
+ * Synchronize time of a CLINT with its reference CLINT
+ *
+ * Each sample reads our time before and after the reference time and
+ * the sample with the shortest round trip gives the best estimate of
+ * the offset, off by at most half of that round trip. The first sync
+ * sets the delta and later re-syncs only move time forward so that it
+ * stays monotonic. The remaining offset is reported as skew.
+ */
+static void clint_time_sync(struct clint_data *clint)
+{
+	u32 i;
+	u64 v1, v2, mv, rtt, delta = 0, best_rtt = -1ULL;
+	struct clint_data *reference = clint->time_delta_reference;
+
+	for (i = 0; i < CLINT_TIME_SYNC_SAMPLES; i++) {
+		v1 = clint->time_rd(clint->time_val);
+		mv = reference->time_rd(reference->time_val);
+		v2 = clint->time_rd(clint->time_val);
+		rtt = v2 - v1;
+		if (rtt < best_rtt) {
+			best_rtt = rtt;
+			delta = mv - (v1 + rtt / 2);
+		}
+	}
+
+	if (!clint->time_sync_error || (s64)(delta - clint->time_delta) > 0)
+		clint->time_delta = delta;
+	clint->time_skew = (s64)(delta - clint->time_delta);
+	clint->time_sync_error = best_rtt / 2 + 1;
+}
+
+static void clint_time_sync_event(struct sbi_scratch *scratch)
+{
+	struct clint_hart_regs *regs =
+			sbi_scratch_offset_ptr(scratch, clint_hart_regs_offset);
+	struct clint_data *clint = regs->timer;
+
+	clint_time_sync(clint);
+	sbi_timer_mevent_start(sbi_timer_value() + clint->time_sync_period,
+			       clint_time_sync_event);
+}
+
 int clint_warm_timer_init(void)
 {
-	u64 v1, v2, mv;
-	u32 target_hart = current_hartid();
-	struct clint_data *reference;
-	struct clint_data *clint = clint_timer_hartid2data[target_hart];
+	u32 hartid = current_hartid();
+	struct clint_data *clint;
+	struct clint_hart_regs *regs = clint_hart_regs(hartid);
 
-	if (!clint)
+	if (!regs || !regs->timer)
 		return SBI_ENODEV;
+	clint = regs->timer;
 
 	/*
 	 * Compute delta if reference available
@@ -184,21 +374,22 @@ int clint_warm_timer_init(void)
 	 * We deliberately compute time_delta in warm init so that time_delta
 	 * is computed on a HART which is going to use given CLINT. We use
 	 * atomic flag timer_delta_computed to ensure that only one HART does
-	 * time_delta computation.
+	 * time_delta computation. The same HART does periodic re-sync.
 	 */
 	if (clint->time_delta_reference) {
-		reference = clint->time_delta_reference;
 		if (!atomic_raw_xchg_ulong(&clint->time_delta_computed, 1)) {
-			v1 = clint->time_rd(clint->time_val);
-			mv = reference->time_rd(reference->time_val);
-			v2 = clint->time_rd(clint->time_val);
-			clint->time_delta = mv - ((v1 / 2) + (v2 / 2));
+			clint->time_sync_hartid = hartid;
+			clint_time_sync(clint);
 		}
+		if (clint->time_sync_hartid == hartid &&
+		    clint->time_sync_period)
+			sbi_timer_mevent_start(sbi_timer_value() +
+					       clint->time_sync_period,
+					       clint_time_sync_event);
 	}
 
 	/* Clear CLINT Time Compare */
-	clint->time_wr(-1ULL,
-		       &clint->time_cmp[target_hart - clint->first_hartid]);
+	clint->time_wr(-1ULL, regs->time_cmp);
 
 	return 0;
 }
@@ -208,15 +399,23 @@ int clint_cold_timer_init(struct clint_data *clint,
 {
 	u32 i;
 	int rc;
+	struct clint_hart_regs *regs;
 	struct sbi_domain_memregion reg;
 
 	if (!clint)
 		return SBI_EINVAL;
 
+	rc = clint_hart_regs_init();
+	if (rc)
+		return rc;
+
 	/* Initialize private data */
 	clint->time_delta_reference = reference;
 	clint->time_delta_computed = 0;
+	clint->time_sync_hartid = -1U;
 	clint->time_delta = 0;
+	clint->time_skew = 0;
+	clint->time_sync_error = 0;
 	clint->time_val = (u64 *)((void *)clint->addr + CLINT_TIME_VAL_OFF);
 	clint->time_cmp = (u64 *)((void *)clint->addr + CLINT_TIME_CMP_OFF);
 	clint->time_rd = clint_time_rd32;
@@ -230,9 +429,14 @@ int clint_cold_timer_init(struct clint_data *clint,
 	}
 #endif
 
-	/* Update timer hartid table */
-	for (i = 0; i < clint->hart_count; i++)
-		clint_timer_hartid2data[clint->first_hartid + i] = clint;
+	/* Cache timer compare register pointer of each HART */
+	for (i = 0; i < clint->hart_count; i++) {
+		regs = clint_hart_regs(clint->first_hartid + i);
+		if (!regs)
+			continue;
+		regs->time_cmp = &clint->time_cmp[i];
+		regs->timer = clint;
+	}
 
 	/* Add CLINT mtime region to the root domain */
 	sbi_domain_memregion_init(clint->addr + CLINT_TIME_VAL_OFF,
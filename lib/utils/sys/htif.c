@@ -5,6 +5,7 @@
  * (Regents).  All Rights Reserved.
  */
 
+#include <sbi/riscv_barrier.h>
 #include <sbi/riscv_locks.h>
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_system.h>
@@ -45,10 +46,22 @@
 
 #define PK_SYS_write 64
 
+/* Size of the buffer written with one syscall proxy request */
+#define HTIF_PUTS_MAX		256
+
 volatile uint64_t tohost __attribute__((section(".htif")));
 volatile uint64_t fromhost __attribute__((section(".htif")));
 static int htif_console_buf;
-static spinlock_t htif_lock = SPIN_LOCK_INITIALIZER;
+static qspinlock_t htif_lock = QSPIN_LOCK_INITIALIZER;
+
+/*
+ * Syscall proxy request in flight. The host acknowledges it through
+ * fromhost and the request memory and buffer are only reused after
+ * that so that we don't have to wait for the host on every write.
+ */
+static volatile uint64_t htif_sys_mem[8] __aligned(64);
+static char htif_sys_buf[HTIF_PUTS_MAX] __aligned(64);
+static volatile bool htif_sys_pending;
 
 static void __check_fromhost()
 {
@@ -57,7 +70,13 @@ static void __check_fromhost()
 		return;
 	fromhost = 0;
 
-	/* this should be from the console */
+	/* syscall proxy requests are acknowledged by the system device */
+	if (FROMHOST_DEV(fh) == HTIF_DEV_SYSTEM) {
+		htif_sys_pending = FALSE;
+		return;
+	}
+
+	/* otherwise this should be from the console */
 	if (FROMHOST_DEV(fh) != HTIF_DEV_CONSOLE)
 		__builtin_trap();
 	switch (FROMHOST_CMD(fh)) {
@@ -78,44 +97,54 @@ static void __set_tohost(uint64_t dev, uint64_t cmd, uint64_t data)
 	tohost = TOHOST_CMD(dev, cmd, data);
 }
 
-#if __riscv_xlen == 32
-static void do_tohost_fromhost(uint64_t dev, uint64_t cmd, uint64_t data)
+static void __wait_sys(void)
 {
-	spin_lock(&htif_lock);
+	while (htif_sys_pending)
+		__check_fromhost();
+}
 
-	__set_tohost(HTIF_DEV_SYSTEM, cmd, data);
+static unsigned long htif_puts(const char *str, unsigned long len)
+{
+	unsigned long i;
 
-	while (1) {
-		uint64_t fh = fromhost;
-		if (fh) {
-			if (FROMHOST_DEV(fh) == HTIF_DEV_SYSTEM &&
-			    FROMHOST_CMD(fh) == cmd) {
-				fromhost = 0;
-				break;
-			}
-			__check_fromhost();
-		}
-	}
+	if (HTIF_PUTS_MAX < len)
+		len = HTIF_PUTS_MAX;
+
+	qspin_lock(&htif_lock);
+
+	/* Only the previous request has to be done, not this one */
+	__wait_sys();
+	for (i = 0; i < len; i++)
+		htif_sys_buf[i] = str[i];
+	htif_sys_mem[0] = PK_SYS_write;
+	htif_sys_mem[1] = HTIF_DEV_CONSOLE;
+	htif_sys_mem[2] = (uint64_t)(uintptr_t)htif_sys_buf;
+	htif_sys_mem[3] = len;
+	htif_sys_pending = TRUE;
 
-	spin_unlock(&htif_lock);
+	/* The host reads the request from memory */
+	mb();
+	__set_tohost(HTIF_DEV_SYSTEM, 0, (uint64_t)(uintptr_t)htif_sys_mem);
+
+	qspin_unlock(&htif_lock);
+
+	return len;
 }
 
+#if __riscv_xlen == 32
 static void htif_putc(char ch)
 {
 	/* HTIF devices are not supported on RV32, so do a proxy write call */
-	volatile uint64_t magic_mem[8];
-	magic_mem[0] = PK_SYS_write;
-	magic_mem[1] = HTIF_DEV_CONSOLE;
-	magic_mem[2] = (uint64_t)(uintptr_t)&ch;
-	magic_mem[3] = HTIF_CONSOLE_CMD_PUTC;
-	do_tohost_fromhost(HTIF_DEV_SYSTEM, 0, (uint64_t)(uintptr_t)magic_mem);
+	htif_puts(&ch, 1);
 }
 #else
 static void htif_putc(char ch)
 {
-	spin_lock(&htif_lock);
+	qspin_lock(&htif_lock);
+	/* Keep the order with a syscall proxy write still in flight */
+	__wait_sys();
 	__set_tohost(HTIF_DEV_CONSOLE, HTIF_CONSOLE_CMD_PUTC, ch);
-	spin_unlock(&htif_lock);
+	qspin_unlock(&htif_lock);
 }
 #endif
 
@@ -128,7 +157,7 @@ static int htif_getc(void)
 	return -1;
 #endif
 
-	spin_lock(&htif_lock);
+	qspin_lock(&htif_lock);
 
 	__check_fromhost();
 	ch = htif_console_buf;
@@ -137,7 +166,7 @@ static int htif_getc(void)
 		__set_tohost(HTIF_DEV_CONSOLE, HTIF_CONSOLE_CMD_GETC, 0);
 	}
 
-	spin_unlock(&htif_lock);
+	qspin_unlock(&htif_lock);
 
 	return ch - 1;
 }
@@ -145,6 +174,7 @@ static int htif_getc(void)
 static struct sbi_console_device htif_console = {
 	.name = "htif",
 	.console_putc = htif_putc,
+	.console_puts = htif_puts,
 	.console_getc = htif_getc
 };
 
@@ -162,6 +192,9 @@ static int htif_system_reset_check(u32 type, u32 reason)
 
 static void htif_system_reset(u32 type, u32 reason)
 {
+	/* Let the host print the last console output */
+	__wait_sys();
+
 	while (1) {
 		fromhost = 0;
 		tohost = 1;
@@ -0,0 +1,317 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_atomic.h>
+#include <sbi/riscv_io.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hartmask.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_timer.h>
+#include <sbi_utils/timer/aclint_mtimer.h>
+
+/* Per-HART pointer to the MTIMER of the HART */
+static unsigned long mtimer_ptr_offset;
+
+#define mtimer_thishart_data()					\
+	(*(struct aclint_mtimer_data **)			\
+	 sbi_scratch_thishart_offset_ptr(mtimer_ptr_offset))
+
+static struct aclint_mtimer_data *mtimer_hartid2data(u32 hartid)
+{
+	struct sbi_scratch *scratch;
+
+	if (!mtimer_ptr_offset || SBI_HARTMASK_MAX_BITS <= hartid)
+		return NULL;
+	scratch = sbi_hartid_to_scratch(hartid);
+	if (!scratch)
+		return NULL;
+
+	return *(struct aclint_mtimer_data **)sbi_scratch_offset_ptr(scratch,
+							mtimer_ptr_offset);
+}
+
+#if __riscv_xlen != 32
+static u64 mtimer_time_rd64(volatile u64 *addr)
+{
+	return readq_relaxed(addr);
+}
+
+static void mtimer_time_wr64(u64 value, volatile u64 *addr)
+{
+	writeq_relaxed(value, addr);
+}
+#endif
+
+static u64 mtimer_time_rd32(volatile u64 *addr)
+{
+	u32 lo, hi;
+
+	/*
+	 * A carry into the high word between the two reads would leave
+	 * the low word close to zero, so the high word only needs to be
+	 * read again when the top bit of the low word is clear.
+	 */
+	do {
+		hi = readl_relaxed((u32 *)addr + 1);
+		lo = readl_relaxed((u32 *)addr);
+	} while (!(lo & 0x80000000U) && hi != readl_relaxed((u32 *)addr + 1));
+
+	return ((u64)hi << 32) | (u64)lo;
+}
+
+static void mtimer_time_wr32(u64 value, volatile u64 *addr)
+{
+	u32 mask = -1U;
+
+	/*
+	 * Park the high word at all-ones while the low word changes so
+	 * that no intermediate value is below both the old and the new
+	 * compare value and raises a spurious timer interrupt.
+	 */
+	writel_relaxed(mask, (void *)(addr) + 0x04);
+	writel_relaxed(value & mask, (void *)(addr));
+	if ((value >> 32) != mask)
+		writel_relaxed(value >> 32, (void *)(addr) + 0x04);
+}
+
+static u64 mtimer_value(void)
+{
+	struct aclint_mtimer_data *mt = mtimer_thishart_data();
+	u64 *time_val = (void *)mt->mtime_addr;
+
+	/* Read MTIMER Time Value */
+	return mt->time_rd(time_val) + mt->time_delta;
+}
+
+static void mtimer_event_stop(void)
+{
+	u32 target_hart = sbi_current_hartid();
+	struct aclint_mtimer_data *mt = mtimer_thishart_data();
+	u64 *time_cmp = (void *)mt->mtimecmp_addr;
+
+	/* Clear MTIMER Time Compare */
+	mt->time_wr(-1ULL, &time_cmp[target_hart - mt->first_hartid]);
+}
+
+static void mtimer_event_start(u64 next_event)
+{
+	u32 target_hart = sbi_current_hartid();
+	struct aclint_mtimer_data *mt = mtimer_thishart_data();
+	u64 *time_cmp = (void *)mt->mtimecmp_addr;
+
+	/* Program MTIMER Time Compare */
+	mt->time_wr(next_event - mt->time_delta,
+		    &time_cmp[target_hart - mt->first_hartid]);
+}
+
+static u64 mtimer_event_get(u32 hartid)
+{
+	u64 *time_cmp, val;
+	struct aclint_mtimer_data *mt;
+
+	mt = mtimer_hartid2data(hartid);
+	if (!mt)
+		return -1ULL;
+	time_cmp = (void *)mt->mtimecmp_addr;
+
+	/* Read MTIMER Time Compare of a (possibly remote) HART */
+	val = mt->time_rd(&time_cmp[hartid - mt->first_hartid]);
+	if (val == -1ULL)
+		return -1ULL;
+
+	return val + mt->time_delta;
+}
+
+static void mtimer_event_set(u32 hartid, u64 next_event)
+{
+	u64 *time_cmp;
+	struct aclint_mtimer_data *mt;
+
+	mt = mtimer_hartid2data(hartid);
+	if (!mt)
+		return;
+	time_cmp = (void *)mt->mtimecmp_addr;
+
+	/* Program MTIMER Time Compare of a (possibly remote) HART */
+	mt->time_wr(next_event - mt->time_delta,
+		    &time_cmp[hartid - mt->first_hartid]);
+}
+
+static int mtimer_event_fast_regs(unsigned long *timecmp_addr,
+				  unsigned long *delta_addr)
+{
+#if __riscv_xlen != 32
+	u32 target_hart = sbi_current_hartid();
+	struct aclint_mtimer_data *mt = mtimer_thishart_data();
+	u64 *time_cmp = (void *)mt->mtimecmp_addr;
+
+	if (mt->time_wr != mtimer_time_wr64)
+		return SBI_ENOTSUPP;
+
+	*timecmp_addr = (unsigned long)&time_cmp[target_hart -
+						 mt->first_hartid];
+	*delta_addr = (unsigned long)&mt->time_delta;
+
+	return 0;
+#else
+	return SBI_ENOTSUPP;
+#endif
+}
+
+static int mtimer_value_fast_regs(unsigned long *time_addr,
+				  unsigned long *delta_addr)
+{
+#if __riscv_xlen != 32
+	struct aclint_mtimer_data *mt = mtimer_thishart_data();
+
+	if (mt->time_rd != mtimer_time_rd64)
+		return SBI_ENOTSUPP;
+
+	*time_addr = mt->mtime_addr;
+	*delta_addr = (unsigned long)&mt->time_delta;
+
+	return 0;
+#else
+	return SBI_ENOTSUPP;
+#endif
+}
+
+static struct sbi_timer_device mtimer = {
+	.name = "aclint-mtimer",
+	.timer_value = mtimer_value,
+	.timer_event_start = mtimer_event_start,
+	.timer_event_stop = mtimer_event_stop,
+	.timer_event_get = mtimer_event_get,
+	.timer_event_set = mtimer_event_set,
+	.timer_event_fast_regs = mtimer_event_fast_regs,
+	.timer_value_fast_regs = mtimer_value_fast_regs
+};
+
+int aclint_mtimer_warm_init(void)
+{
+	u64 v1, v2, mv;
+	u32 target_hart = current_hartid();
+	struct aclint_mtimer_data *reference;
+	u64 *mt_time_val, *mt_time_cmp, *ref_time_val;
+	struct aclint_mtimer_data *mt = mtimer_hartid2data(target_hart);
+
+	if (!mt)
+		return SBI_ENODEV;
+
+	/*
+	 * Compute delta if reference available
+	 *
+	 * We deliberately compute time_delta in warm init so that time_delta
+	 * is computed on a HART which is going to use given MTIMER. We use
+	 * atomic flag timer_delta_computed to ensure that only one HART does
+	 * time_delta computation. A shared time register needs no delta.
+	 */
+	if (mt->time_delta_reference && !mt->has_shared_mtime) {
+		reference = mt->time_delta_reference;
+		mt_time_val = (void *)mt->mtime_addr;
+		ref_time_val = (void *)reference->mtime_addr;
+		if (!atomic_raw_xchg_ulong(&mt->time_delta_computed, 1)) {
+			v1 = mt->time_rd(mt_time_val);
+			mv = reference->time_rd(ref_time_val);
+			v2 = mt->time_rd(mt_time_val);
+			mt->time_delta = mv - ((v1 / 2) + (v2 / 2));
+		}
+	}
+
+	/* Clear Time Compare */
+	mt_time_cmp = (void *)mt->mtimecmp_addr;
+	mt->time_wr(-1ULL, &mt_time_cmp[target_hart - mt->first_hartid]);
+
+	return 0;
+}
+
+int aclint_mtimer_cold_init(struct aclint_mtimer_data *mt,
+			    struct aclint_mtimer_data *reference)
+{
+	u32 i;
+	int rc;
+	struct sbi_scratch *scratch;
+	struct sbi_domain_memregion reg;
+
+	/* Sanity checks */
+	if (!mt || (mt->mtimecmp_addr & (ACLINT_MTIMER_ALIGN - 1)) ||
+	    (mt->mtimecmp_size < (mt->hart_count * ACLINT_DEFAULT_MTIME_SIZE)) ||
+	    (!mt->hart_count || mt->hart_count > ACLINT_MTIMER_MAX_HARTS))
+		return SBI_EINVAL;
+
+	/*
+	 * An MTIMER without own time register uses the time register of
+	 * the reference MTIMER. Same for an MTIMER which points to the
+	 * time register of the reference MTIMER.
+	 */
+	mt->has_shared_mtime = FALSE;
+	if (!mt->mtime_addr) {
+		if (!reference)
+			return SBI_EINVAL;
+		mt->mtime_addr = reference->mtime_addr;
+		mt->mtime_size = reference->mtime_size;
+		mt->has_shared_mtime = TRUE;
+	} else if (reference && reference->mtime_addr == mt->mtime_addr) {
+		mt->has_shared_mtime = TRUE;
+	}
+	if ((mt->mtime_addr & (ACLINT_MTIMER_ALIGN - 1)) ||
+	    (mt->mtime_size < ACLINT_DEFAULT_MTIME_SIZE))
+		return SBI_EINVAL;
+
+	/* Initialize private data */
+	mt->time_delta_reference = reference;
+	mt->time_delta_computed = 0;
+	mt->time_delta = 0;
+	mt->time_rd = mtimer_time_rd32;
+	mt->time_wr = mtimer_time_wr32;
+
+	/* Override read/write accessors for 64bit MMIO */
+#if __riscv_xlen != 32
+	if (mt->has_64bit_mmio) {
+		mt->time_rd = mtimer_time_rd64;
+		mt->time_wr = mtimer_time_wr64;
+	}
+#endif
+
+	/* Update MTIMER pointer of the HARTs */
+	if (!mtimer_ptr_offset) {
+		mtimer_ptr_offset = sbi_scratch_alloc_offset(sizeof(mt),
+							     "ACLINT_MTIMER");
+		if (!mtimer_ptr_offset)
+			return SBI_ENOMEM;
+	}
+	for (i = 0; i < mt->hart_count; i++) {
+		if (SBI_HARTMASK_MAX_BITS <= (mt->first_hartid + i))
+			break;
+		scratch = sbi_hartid_to_scratch(mt->first_hartid + i);
+		if (!scratch)
+			continue;
+		*(struct aclint_mtimer_data **)sbi_scratch_offset_ptr(scratch,
+						mtimer_ptr_offset) = mt;
+	}
+
+	/* Add MTIMER time register to the root domain once */
+	if (!mt->has_shared_mtime) {
+		sbi_domain_memregion_init(mt->mtime_addr, mt->mtime_size,
+					  SBI_DOMAIN_MEMREGION_MMIO, &reg);
+		rc = sbi_domain_root_add_memregion(&reg);
+		if (rc)
+			return rc;
+	}
+
+	/* Add MTIMER timecmp registers to the root domain */
+	sbi_domain_memregion_init(mt->mtimecmp_addr, mt->mtimecmp_size,
+				  SBI_DOMAIN_MEMREGION_MMIO, &reg);
+	rc = sbi_domain_root_add_memregion(&reg);
+	if (rc)
+		return rc;
+
+	sbi_timer_set_device(&mtimer);
+
+	return 0;
+}
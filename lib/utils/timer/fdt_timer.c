@@ -8,13 +8,20 @@
  */
 
 #include <sbi/sbi_scratch.h>
+#include <sbi/sbi_timer.h>
 #include <sbi_utils/fdt/fdt_helper.h>
 #include <sbi_utils/timer/fdt_timer.h>
 
+extern struct fdt_timer fdt_timer_mtimer;
 extern struct fdt_timer fdt_timer_clint;
 
 static struct fdt_timer *timer_drivers[] = {
-	&fdt_timer_clint
+#ifndef FDT_TIMER_MTIMER_DISABLED
+	&fdt_timer_mtimer,
+#endif
+#ifndef FDT_TIMER_CLINT_DISABLED
+	&fdt_timer_clint,
+#endif
 };
 
 static struct fdt_timer dummy = {
@@ -42,10 +49,15 @@ static int fdt_timer_warm_init(void)
 static int fdt_timer_cold_init(void)
 {
 	int pos, noff, rc;
+	unsigned long freq;
 	struct fdt_timer *drv;
 	const struct fdt_match *match;
 	void *fdt = sbi_scratch_thishart_arg1_ptr();
 
+	/* The platform may know a calibrated frequency already */
+	if (!sbi_timer_get_freq() && !fdt_parse_timebase_frequency(fdt, &freq))
+		sbi_timer_set_freq(freq);
+
 	for (pos = 0; pos < array_size(timer_drivers); pos++) {
 		drv = timer_drivers[pos];
 
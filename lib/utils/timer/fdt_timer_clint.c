@@ -21,6 +21,7 @@ static int timer_clint_cold_init(void *fdt, int nodeoff,
 				  const struct fdt_match *match)
 {
 	int rc;
+	unsigned long freq;
 	struct clint_data *ct, *ctmaster = NULL;
 
 	if (CLINT_TIMER_MAX_NR <= clint_timer_count)
@@ -33,6 +34,11 @@ static int timer_clint_cold_init(void *fdt, int nodeoff,
 	if (rc)
 		return rc;
 
+	/* Re-sync time with the first CLINT once per second */
+	ct->time_sync_period = 0;
+	if (ctmaster && !fdt_parse_timebase_frequency(fdt, &freq))
+		ct->time_sync_period = freq;
+
 	return clint_cold_timer_init(ct, ctmaster);
 }
 
@@ -0,0 +1,71 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <libfdt.h>
+#include <sbi/sbi_error.h>
+#include <sbi_utils/fdt/fdt_helper.h>
+#include <sbi_utils/timer/fdt_timer.h>
+#include <sbi_utils/timer/aclint_mtimer.h>
+
+#define MTIMER_MAX_NR			16
+
+static unsigned long mtimer_count = 0;
+static struct aclint_mtimer_data mtimer[MTIMER_MAX_NR];
+
+static int timer_mtimer_cold_init(void *fdt, int nodeoff,
+				  const struct fdt_match *match)
+{
+	int rc, len;
+	unsigned long addr[2], size[2];
+	struct aclint_mtimer_data *mt, *mtmaster = NULL;
+
+	if (MTIMER_MAX_NR <= mtimer_count)
+		return SBI_ENOSPC;
+	mt = &mtimer[mtimer_count++];
+	if (1 < mtimer_count)
+		mtmaster = &mtimer[0];
+
+	rc = fdt_parse_aclint_node(fdt, nodeoff, TRUE,
+				   &addr[0], &size[0], &addr[1], &size[1],
+				   &mt->first_hartid, &mt->hart_count);
+	if (rc)
+		return rc;
+
+	/*
+	 * The first register region is the time register followed by
+	 * the timecmp registers. A node with only the timecmp registers
+	 * shares the time register of the first MTIMER.
+	 */
+	if (addr[1] && size[1]) {
+		mt->mtime_addr = addr[0];
+		mt->mtime_size = size[0];
+		mt->mtimecmp_addr = addr[1];
+		mt->mtimecmp_size = size[1];
+	} else {
+		mt->mtime_addr = 0;
+		mt->mtime_size = 0;
+		mt->mtimecmp_addr = addr[0];
+		mt->mtimecmp_size = size[0];
+	}
+
+	mt->has_64bit_mmio = TRUE;
+	if (fdt_getprop(fdt, nodeoff, "mtimer,no-64bit-mmio", &len))
+		mt->has_64bit_mmio = FALSE;
+
+	return aclint_mtimer_cold_init(mt, mtmaster);
+}
+
+static const struct fdt_match timer_mtimer_match[] = {
+	{ .compatible = "riscv,aclint-mtimer" },
+	{ },
+};
+
+struct fdt_timer fdt_timer_mtimer = {
+	.match_table = timer_mtimer_match,
+	.cold_init = timer_mtimer_cold_init,
+	.warm_init = aclint_mtimer_warm_init,
+	.exit = NULL,
+};
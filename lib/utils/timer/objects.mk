@@ -8,4 +8,6 @@
 #
 
 libsbiutils-objs-y += timer/fdt_timer.o
-libsbiutils-objs-y += timer/fdt_timer_clint.o
+libsbiutils-objs-$(FDT_TIMER_CLINT) += timer/fdt_timer_clint.o
+libsbiutils-objs-y += timer/aclint_mtimer.o
+libsbiutils-objs-$(FDT_TIMER_MTIMER) += timer/fdt_timer_mtimer.o
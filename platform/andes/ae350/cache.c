@@ -7,10 +7,16 @@
  *   Nylon Chen <nylon7@andestech.com>
  */
 
+#include <libfdt.h>
 #include <sbi/riscv_asm.h>
 #include <sbi/riscv_io.h>
+#include <sbi/riscv_locks.h>
+#include <sbi/sbi_cache.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_ipi.h>
 #include <sbi/sbi_types.h>
 #include "platform.h"
+#include "cache.h"
 
 uintptr_t mcall_set_mcache_ctl(unsigned long input)
 {
@@ -87,3 +93,147 @@ uintptr_t mcall_write_around(unsigned long enable)
 	}
 	return 0;
 }
+
+static void ae350_cache_block_op(u32 op, unsigned long addr)
+{
+	unsigned long cmd;
+
+	switch (op) {
+	case SBI_CACHE_OP_CLEAN:
+		cmd = V5_UCCTL_L1D_VA_WB;
+		break;
+	case SBI_CACHE_OP_INVAL:
+		cmd = V5_UCCTL_L1D_VA_INVAL;
+		break;
+	case SBI_CACHE_OP_FLUSH:
+		cmd = V5_UCCTL_L1D_VA_WBINVAL;
+		break;
+	default:
+		return;
+	};
+
+	/* Translation is off in M-mode so the address is physical */
+	csr_write(CSR_MCCTLBEGINADDR, addr);
+	csr_write(CSR_MCCTLCOMMAND, cmd);
+}
+
+static void ae350_cache_all_op(u32 op)
+{
+	csr_write(CSR_MCCTLCOMMAND, (op == SBI_CACHE_OP_CLEAN) ?
+		  V5_UCCTL_L1D_WB_ALL : V5_UCCTL_L1D_WBINVAL_ALL);
+}
+
+/* CCTL operations only reach the L1 data cache of current HART */
+static struct sbi_cache_device ae350_cache = {
+	.name = "ae350_cctl",
+	.local = TRUE,
+	.cache_block_op = ae350_cache_block_op,
+	.cache_all_op = ae350_cache_all_op,
+	.all_threshold = 32 * 1024,
+};
+
+int ae350_cache_init(void)
+{
+	unsigned long dsz;
+
+	/* Data cache line size is 2^(DSZ + 2) bytes (DSZ == 0: no cache) */
+	dsz = (csr_read(CSR_MDCMCFG) & V5_MDCM_CFG_DSZ_MASK) >>
+	      V5_MDCM_CFG_DSZ_OFFSET;
+	if (!dsz)
+		return 0;
+
+	ae350_cache.block_size = 1UL << (dsz + 2);
+	sbi_cache_set_device(&ae350_cache);
+
+	return 0;
+}
+
+static const char *const ae350_ctl_props[AE350_CTL_MAX] = {
+	[AE350_CTL_MCACHE] = "andestech,mcache-ctl",
+	[AE350_CTL_MMISC] = "andestech,mmisc-ctl",
+};
+
+static spinlock_t ae350_ctl_lock = SPIN_LOCK_INITIALIZER;
+static unsigned long ae350_ctl_valid;
+static unsigned long ae350_ctl_val[AE350_CTL_MAX];
+static u32 ae350_ctl_event = SBI_IPI_EVENT_MAX;
+
+static void ae350_ctl_apply(void)
+{
+	if (ae350_ctl_valid & (1UL << AE350_CTL_MCACHE))
+		mcall_set_mcache_ctl(ae350_ctl_val[AE350_CTL_MCACHE]);
+	if (ae350_ctl_valid & (1UL << AE350_CTL_MMISC))
+		mcall_set_mmisc_ctl(ae350_ctl_val[AE350_CTL_MMISC]);
+}
+
+static int ae350_ctl_update(struct sbi_scratch *scratch,
+			    struct sbi_scratch *remote_scratch,
+			    u32 remote_hartid, void *data)
+{
+	/* Current HART has already applied the settings */
+	if (remote_hartid == current_hartid())
+		return SBI_EALREADY;
+
+	return 0;
+}
+
+static void ae350_ctl_process(struct sbi_scratch *scratch)
+{
+	ae350_ctl_apply();
+}
+
+static struct sbi_ipi_event_ops ae350_ctl_ops = {
+	.name = "IPI_AE350_CTL",
+	.priority = SBI_IPI_EVENT_PRIO_LOW,
+	.update = ae350_ctl_update,
+	.process = ae350_ctl_process,
+};
+
+/*
+ * Update a setting on all HARTs of the domain. HARTs started later pick
+ * it up in their warm init, so there is no race with HART hotplug.
+ */
+int ae350_ctl_set_all(u32 ctl, unsigned long input)
+{
+	if (AE350_CTL_MAX <= ctl)
+		return SBI_EINVAL;
+	if (SBI_IPI_EVENT_MAX <= ae350_ctl_event)
+		return SBI_ENOTSUPP;
+
+	spin_lock(&ae350_ctl_lock);
+	ae350_ctl_val[ctl] = input;
+	ae350_ctl_valid |= 1UL << ctl;
+	ae350_ctl_apply();
+	spin_unlock(&ae350_ctl_lock);
+
+	return sbi_ipi_send_many(0, -1UL, ae350_ctl_event, NULL);
+}
+
+int ae350_ctl_init(void *fdt, bool cold_boot)
+{
+	int i, len, rc, cpus_offset;
+	const fdt32_t *val;
+
+	if (cold_boot) {
+		rc = sbi_ipi_event_create(&ae350_ctl_ops);
+		if (rc < 0)
+			return rc;
+		ae350_ctl_event = rc;
+
+		cpus_offset = (fdt) ? fdt_path_offset(fdt, "/cpus") : -1;
+		for (i = 0; cpus_offset >= 0 && i < AE350_CTL_MAX; i++) {
+			val = fdt_getprop(fdt, cpus_offset, ae350_ctl_props[i],
+					  &len);
+			if (!val || len < sizeof(fdt32_t))
+				continue;
+			ae350_ctl_val[i] = fdt32_to_cpu(*val);
+			ae350_ctl_valid |= 1UL << i;
+		}
+	}
+
+	spin_lock(&ae350_ctl_lock);
+	ae350_ctl_apply();
+	spin_unlock(&ae350_ctl_lock);
+
+	return 0;
+}
@@ -15,3 +15,14 @@ uintptr_t mcall_l1_cache_i_prefetch_op(unsigned long enable);
 uintptr_t mcall_l1_cache_d_prefetch_op(unsigned long enable);
 uintptr_t mcall_non_blocking_load_store(unsigned long enable);
 uintptr_t mcall_write_around(unsigned long enable);
+int ae350_cache_init(void);
+
+/* Settings applied to every HART, either from the FDT or set at runtime */
+enum ae350_ctl {
+	AE350_CTL_MCACHE = 0,
+	AE350_CTL_MMISC,
+	AE350_CTL_MAX,
+};
+
+int ae350_ctl_set_all(u32 ctl, unsigned long input);
+int ae350_ctl_init(void *fdt, bool cold_boot);
@@ -31,7 +31,8 @@ static struct plic_data plic = {
 /* Platform final initialization. */
 static int ae350_final_init(bool cold_boot)
 {
-	void *fdt;
+	void *fdt = sbi_scratch_thishart_arg1_ptr();
+	int rc;
 
 	/* enable L1 cache */
 	uintptr_t mcache_ctl_val = csr_read(CSR_MCACHECTL);
@@ -52,10 +53,16 @@ static int ae350_final_init(bool cold_boot)
 		l2c_ctl_val |= V5_L2C_CTL_ENABLE_MASK;
 	*l2c_ctl_base = l2c_ctl_val;
 
+	/* Cache, prefetch and branch prediction settings from the FDT */
+	rc = ae350_ctl_init(fdt, cold_boot);
+	if (rc)
+		return rc;
+
 	if (!cold_boot)
 		return 0;
 
-	fdt = sbi_scratch_thishart_arg1_ptr();
+	ae350_cache_init();
+
 	fdt_fixups(fdt);
 
 	return 0;
@@ -89,6 +96,7 @@ static int ae350_irqchip_init(bool cold_boot)
 static struct sbi_ipi_device plicsw_ipi = {
 	.name = "ae350_plicsw",
 	.ipi_send = plicsw_ipi_send,
+	.ipi_send_mask = plicsw_ipi_send_mask,
 	.ipi_clear = plicsw_ipi_clear
 };
 
@@ -161,6 +169,12 @@ static int ae350_vendor_ext_provider(long extid, long funcid,
 	case SBI_EXT_ANDES_WRITE_AROUND:
 		ret = mcall_write_around(regs->a0);
 		break;
+	case SBI_EXT_ANDES_SET_MCACHE_CTL_ALL:
+		ret = ae350_ctl_set_all(AE350_CTL_MCACHE, regs->a0);
+		break;
+	case SBI_EXT_ANDES_SET_MMISC_CTL_ALL:
+		ret = ae350_ctl_set_all(AE350_CTL_MMISC, regs->a0);
+		break;
 	default:
 		sbi_printf("Unsupported vendor sbi call : %ld\n", funcid);
 		asm volatile("ebreak");
@@ -190,5 +204,6 @@ const struct sbi_platform platform = {
 	.features = SBI_PLATFORM_DEFAULT_FEATURES,
 	.hart_count = AE350_HART_COUNT,
 	.hart_stack_size = SBI_PLATFORM_DEFAULT_HART_STACK_SIZE,
+	.heap_size = SBI_PLATFORM_DEFAULT_HEAP_SIZE(AE350_HART_COUNT),
 	.platform_ops_addr = (unsigned long)&platform_ops
 };
@@ -11,8 +11,8 @@
 #include <sbi/riscv_asm.h>
 #include <sbi/riscv_io.h>
 #include <sbi/sbi_types.h>
-#include "plicsw.h"
 #include "platform.h"
+#include "plicsw.h"
 
 static u32 plicsw_ipi_hart_count;
 static struct plicsw plicsw_dev[AE350_HART_COUNT];
@@ -36,37 +36,34 @@ static inline void plicsw_complete(void)
 static inline u32 plicsw_get_pending(u32 source_hart, u32 target_hart)
 {
 	return readl(plicsw_dev[source_hart].plicsw_pending)
-	       & (PLICSW_HART_MASK >> target_hart);
+	       & plicsw_dev[source_hart].ipi_bits[target_hart];
 }
 
 static inline void plic_sw_pending(u32 target_hart)
 {
-	/*
-	 * The pending array registers are w1s type.
-	 * IPI pending array mapping as following:
-	 *
-	 * Pending array start address: base + 0x1000
-	 * -------------------------------------
-	 * | hart 3 | hart 2 | hart 1 | hart 0 |
-	 * -------------------------------------
-	 * Each hart X can send IPI to another hart by setting the
-	 * corresponding bit in hart X own region(see the below).
-	 *
-	 * In each hart region:
-	 * -----------------------------------------------
-	 * | bit 7 | bit 6 | bit 5 | bit 4 | ... | bit 0 |
-	 * -----------------------------------------------
-	 * The bit 7 is used to send IPI to hart 0
-	 * The bit 6 is used to send IPI to hart 1
-	 * The bit 5 is used to send IPI to hart 2
-	 * The bit 4 is used to send IPI to hart 3
-	 */
 	u32 source_hart = current_hartid();
-	u32 target_offset = (PLICSW_PENDING_PER_HART - 1) - target_hart;
-	u32 per_hart_offset = PLICSW_PENDING_PER_HART * source_hart;
-	u32 val = 1 << target_offset << per_hart_offset;
 
-	writel(val, plicsw_dev[source_hart].plicsw_pending);
+	writel(plicsw_dev[source_hart].ipi_bits[target_hart],
+	       plicsw_dev[source_hart].plicsw_pending);
+}
+
+void plicsw_ipi_send_mask(ulong hmask, ulong hbase)
+{
+	ulong i;
+	u32 val = 0;
+	struct plicsw *dev = &plicsw_dev[current_hartid()];
+
+	/* Set pending bits of all target HARTs with single write */
+	for (i = hbase; hmask; i++, hmask >>= 1) {
+		if (!(hmask & 1UL))
+			continue;
+		if (plicsw_ipi_hart_count <= i)
+			break;
+		val |= dev->ipi_bits[i];
+	}
+
+	if (val)
+		writel(val, dev->plicsw_pending);
 }
 
 void plicsw_ipi_send(u32 target_hart)
@@ -103,6 +100,34 @@ int plicsw_warm_ipi_init(void)
 	return 0;
 }
 
+static u32 plicsw_ipi_bit(u32 source_hart, u32 target_hart)
+{
+	/*
+	 * The pending array registers are w1s type.
+	 * IPI pending array mapping as following:
+	 *
+	 * Pending array start address: base + 0x1000
+	 * -------------------------------------
+	 * | hart 3 | hart 2 | hart 1 | hart 0 |
+	 * -------------------------------------
+	 * Each hart X can send IPI to another hart by setting the
+	 * corresponding bit in hart X own region(see the below).
+	 *
+	 * In each hart region:
+	 * -----------------------------------------------
+	 * | bit 7 | bit 6 | bit 5 | bit 4 | ... | bit 0 |
+	 * -----------------------------------------------
+	 * The bit 7 is used to send IPI to hart 0
+	 * The bit 6 is used to send IPI to hart 1
+	 * The bit 5 is used to send IPI to hart 2
+	 * The bit 4 is used to send IPI to hart 3
+	 */
+	u32 target_offset = (PLICSW_PENDING_PER_HART - 1) - target_hart;
+	u32 per_hart_offset = PLICSW_PENDING_PER_HART * (source_hart % 4);
+
+	return 1 << target_offset << per_hart_offset;
+}
+
 int plicsw_cold_ipi_init(unsigned long base, u32 hart_count)
 {
 	/* Setup source priority */
@@ -126,6 +151,9 @@ int plicsw_cold_ipi_init(unsigned long base, u32 hart_count)
 
 	for (u32 hartid = 0; hartid < AE350_HART_COUNT; hartid++) {
 		plicsw_dev[hartid].source_id = 0;
+		for (u32 target = 0; target < AE350_HART_COUNT; target++)
+			plicsw_dev[hartid].ipi_bits[target] =
+				plicsw_ipi_bit(hartid, target);
 		plicsw_dev[hartid].plicsw_pending =
 			(void *)base
 			+ PLICSW_PENDING_BASE
@@ -27,6 +27,8 @@
 
 struct plicsw {
 	u32 source_id;
+	/* Pending bit of this source HART for each target HART */
+	u32 ipi_bits[AE350_HART_COUNT];
 
 	volatile uint32_t *plicsw_pending;
 	volatile uint32_t *plicsw_enable;
@@ -35,6 +37,8 @@ struct plicsw {
 
 void plicsw_ipi_send(u32 target_hart);
 
+void plicsw_ipi_send_mask(ulong hmask, ulong hbase);
+
 void plicsw_ipi_sync(u32 target_hart);
 
 void plicsw_ipi_clear(u32 target_hart);
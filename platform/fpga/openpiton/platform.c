@@ -3,12 +3,15 @@
  * Copyright (c) 2020 Western Digital Corporation or its affiliates.
  */
 
+#include <libfdt.h>
 #include <sbi/riscv_asm.h>
 #include <sbi/riscv_encoding.h>
 #include <sbi/riscv_io.h>
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_const.h>
+#include <sbi/sbi_error.h>
 #include <sbi/sbi_hart.h>
+#include <sbi/sbi_hartmask.h>
 #include <sbi/sbi_platform.h>
 #include <sbi_utils/fdt/fdt_helper.h>
 #include <sbi_utils/fdt/fdt_fixup.h>
@@ -25,6 +28,7 @@
 #define OPENPITON_DEFAULT_PLIC_NUM_SOURCES	2
 #define OPENPITON_DEFAULT_HART_COUNT		3
 #define OPENPITON_DEFAULT_CLINT_ADDR		0xfff1020000
+#define OPENPITON_CLINT_MAX_NR			32
 
 static struct platform_uart_data uart = {
 	OPENPITON_DEFAULT_UART_ADDR,
@@ -36,13 +40,110 @@ static struct plic_data plic = {
 	.num_src = OPENPITON_DEFAULT_PLIC_NUM_SOURCES,
 };
 
-static struct clint_data clint = {
-	.addr = OPENPITON_DEFAULT_CLINT_ADDR,
-	.first_hartid = 0,
-	.hart_count = OPENPITON_DEFAULT_HART_COUNT,
-	.has_64bit_mmio = TRUE,
+/*
+ * Larger builds have one CLINT per group of tiles. Each HART then uses the
+ * CLINT of its own group (the first CLINT being the time reference) so no
+ * IPI or timer access crosses the whole NoC to a single CLINT.
+ */
+static u32 clint_count = 1;
+static struct clint_data clint[OPENPITON_CLINT_MAX_NR] = {
+	{
+		.addr = OPENPITON_DEFAULT_CLINT_ADDR,
+		.first_hartid = 0,
+		.hart_count = OPENPITON_DEFAULT_HART_COUNT,
+		.has_64bit_mmio = TRUE,
+	},
 };
 
+static u32 openpiton_hart_index2id[SBI_HARTMASK_MAX_BITS];
+static int openpiton_hart_context[SBI_HARTMASK_MAX_BITS][2];
+
+extern struct sbi_platform platform;
+
+/*
+ * The HARTs are taken from the FDT so one firmware image boots every
+ * tile count (up to SBI_HARTMASK_MAX_BITS, which can be raised at build
+ * time). Without a usable FDT the default HART count is kept.
+ */
+unsigned long fw_platform_init(unsigned long arg0, unsigned long arg1,
+				unsigned long arg2, unsigned long arg3,
+				unsigned long arg4)
+{
+	u32 i, count;
+	const struct fdt_cpu *cpus;
+
+	if (fdt_parse_cpus((void *)arg1, &cpus, &count) || !count)
+		return arg1;
+
+	for (i = 0; i < count; i++)
+		openpiton_hart_index2id[i] = cpus[i].hartid;
+	platform.hart_count = count;
+	platform.hart_index2id = openpiton_hart_index2id;
+
+	return arg1;
+}
+
+/* Get the PLIC contexts of the HARTs from the FDT */
+static void openpiton_plic_contexts_init(void *fdt)
+{
+	const fdt32_t *val;
+	u32 phandle, hwirq, hartid;
+	int i, nodeoff, count;
+
+	for (i = 0; i < SBI_HARTMASK_MAX_BITS; i++) {
+		openpiton_hart_context[i][0] = 2 * i;
+		openpiton_hart_context[i][1] = 2 * i + 1;
+	}
+
+	nodeoff = fdt_node_offset_by_compatible(fdt, -1, "riscv,plic0");
+	if (nodeoff < 0)
+		return;
+	val = fdt_getprop(fdt, nodeoff, "interrupts-extended", &count);
+	if (!val || count < sizeof(fdt32_t))
+		return;
+	count = count / sizeof(fdt32_t);
+
+	for (i = 0; i < SBI_HARTMASK_MAX_BITS; i++) {
+		openpiton_hart_context[i][0] = -1;
+		openpiton_hart_context[i][1] = -1;
+	}
+	for (i = 0; i + 1 < count; i += 2) {
+		phandle = fdt32_to_cpu(val[i]);
+		hwirq = fdt32_to_cpu(val[i + 1]);
+		if (fdt_parse_hart_id_by_intc(fdt, phandle, &hartid) ||
+		    SBI_HARTMASK_MAX_BITS <= hartid)
+			continue;
+		if (hwirq == IRQ_M_EXT)
+			openpiton_hart_context[hartid][0] = i / 2;
+		else if (hwirq == IRQ_S_EXT)
+			openpiton_hart_context[hartid][1] = i / 2;
+	}
+}
+
+/* Get all CLINTs from the FDT, the default CLINT covers all HARTs */
+static void openpiton_clint_init(void *fdt)
+{
+	int nodeoff;
+	u32 count = 0;
+
+	for (nodeoff = fdt_node_offset_by_compatible(fdt, -1, "riscv,clint0");
+	     nodeoff >= 0 && count < OPENPITON_CLINT_MAX_NR;
+	     nodeoff = fdt_node_offset_by_compatible(fdt, nodeoff,
+						     "riscv,clint0")) {
+		if (!fdt_parse_clint_node(fdt, nodeoff, FALSE, &clint[count]))
+			count++;
+	}
+
+	if (count) {
+		clint_count = count;
+	} else {
+		clint[0].addr = OPENPITON_DEFAULT_CLINT_ADDR;
+		clint[0].first_hartid = 0;
+		clint[0].hart_count = platform.hart_count;
+		clint[0].has_64bit_mmio = TRUE;
+	}
+}
+
 /*
  * OpenPiton platform early initialization.
  */
@@ -51,7 +152,6 @@ static int openpiton_early_init(bool cold_boot)
 	void *fdt;
 	struct platform_uart_data uart_data;
 	struct plic_data plic_data;
-	unsigned long clint_addr;
 	int rc;
 
 	if (!cold_boot)
@@ -66,9 +166,8 @@ static int openpiton_early_init(bool cold_boot)
 	if (!rc)
 		plic = plic_data;
 
-	rc = fdt_parse_compat_addr(fdt, &clint_addr, "riscv,clint0");
-	if (!rc)
-		clint.addr = clint_addr;
+	openpiton_plic_contexts_init(fdt);
+	openpiton_clint_init(fdt);
 
 	return 0;
 }
@@ -138,7 +237,12 @@ static int openpiton_irqchip_init(bool cold_boot)
 		if (ret)
 			return ret;
 	}
-	return plic_openpiton_warm_irqchip_init(2 * hartid, 2 * hartid + 1);
+	if (SBI_HARTMASK_MAX_BITS <= hartid)
+		return SBI_EINVAL;
+
+	return plic_openpiton_warm_irqchip_init(
+				openpiton_hart_context[hartid][0],
+				openpiton_hart_context[hartid][1]);
 }
 
 /*
@@ -146,12 +250,15 @@ static int openpiton_irqchip_init(bool cold_boot)
  */
 static int openpiton_ipi_init(bool cold_boot)
 {
+	u32 i;
 	int ret;
 
 	if (cold_boot) {
-		ret = clint_cold_ipi_init(&clint);
-		if (ret)
-			return ret;
+		for (i = 0; i < clint_count; i++) {
+			ret = clint_cold_ipi_init(&clint[i]);
+			if (ret)
+				return ret;
+		}
 	}
 
 	return clint_warm_ipi_init();
@@ -162,17 +269,41 @@ static int openpiton_ipi_init(bool cold_boot)
  */
 static int openpiton_timer_init(bool cold_boot)
 {
+	u32 i;
 	int ret;
 
 	if (cold_boot) {
-		ret = clint_cold_timer_init(&clint, NULL);
-		if (ret)
-			return ret;
+		for (i = 0; i < clint_count; i++) {
+			ret = clint_cold_timer_init(&clint[i],
+						    (i) ? &clint[0] : NULL);
+			if (ret)
+				return ret;
+		}
 	}
 
 	return clint_warm_timer_init();
 }
 
+/*
+ * Tiles grouped into clusters by the FDT cpu-map get remote fences
+ * through one HART per cluster instead of one by one.
+ */
+static u32 openpiton_tlb_cluster(u32 hartid)
+{
+	u32 i, count;
+	const struct fdt_cpu *cpus;
+
+	if (fdt_parse_cpus(sbi_scratch_thishart_arg1_ptr(), &cpus, &count))
+		return -1U;
+
+	for (i = 0; i < count; i++) {
+		if (cpus[i].hartid == hartid)
+			return cpus[i].cluster;
+	}
+
+	return -1U;
+}
+
 /*
  * Platform descriptor.
  */
@@ -183,14 +314,16 @@ const struct sbi_platform_operations platform_ops = {
 	.irqchip_init = openpiton_irqchip_init,
 	.ipi_init = openpiton_ipi_init,
 	.timer_init = openpiton_timer_init,
+	.get_tlb_cluster = openpiton_tlb_cluster,
 };
 
-const struct sbi_platform platform = {
+struct sbi_platform platform = {
 	.opensbi_version = OPENSBI_VERSION,
 	.platform_version = SBI_PLATFORM_VERSION(0x0, 0x01),
 	.name = "OPENPITON RISC-V",
 	.features = SBI_PLATFORM_DEFAULT_FEATURES,
 	.hart_count = OPENPITON_DEFAULT_HART_COUNT,
 	.hart_stack_size = SBI_PLATFORM_DEFAULT_HART_STACK_SIZE,
+	.heap_size = SBI_PLATFORM_DEFAULT_HEAP_SIZE(OPENPITON_DEFAULT_HART_COUNT),
 	.platform_ops_addr = (unsigned long)&platform_ops
 };
@@ -0,0 +1,53 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#ifndef __GENERIC_PLATCFG_H__
+#define __GENERIC_PLATCFG_H__
+
+#include <sbi/sbi_hartmask.h>
+#include <sbi/sbi_types.h>
+
+/**
+ * Platform facts of the generic platform which are known at build time
+ *
+ * An instance named generic_platcfg is generated from a DTB by
+ * scripts/dtb2platcfg.sh when building with GENERIC_PLATCFG_DTB. The
+ * devices it describes are set up directly instead of being probed from
+ * the FDT; devices with a zero address are still probed from the FDT.
+ */
+struct generic_platcfg {
+	/** Number of HARTs and their HART ids (by platform HART index) */
+	u32 hart_count;
+	u32 hart_ids[SBI_HARTMASK_MAX_BITS];
+	/** CLINT used for IPIs and timer */
+	unsigned long clint_addr;
+	u32 clint_first_hartid;
+	u32 clint_hart_count;
+	bool clint_has_64bit_mmio;
+	/** PLIC and its M-mode and S-mode contexts (by platform HART index) */
+	unsigned long plic_addr;
+	u32 plic_num_src;
+	s16 plic_m_cntx[SBI_HARTMASK_MAX_BITS];
+	s16 plic_s_cntx[SBI_HARTMASK_MAX_BITS];
+	/** UART8250 used as console */
+	unsigned long uart_addr;
+	u32 uart_freq;
+	u32 uart_baud;
+	u32 uart_reg_shift;
+	u32 uart_reg_width;
+};
+
+extern const struct generic_platcfg generic_platcfg;
+
+int generic_platcfg_console_init(void);
+
+int generic_platcfg_irqchip_init(bool cold_boot);
+
+int generic_platcfg_ipi_init(bool cold_boot);
+
+int generic_platcfg_timer_init(bool cold_boot);
+
+#endif
@@ -9,3 +9,14 @@
 
 platform-objs-y += platform.o
 platform-objs-y += sifive_fu540.o
+platform-objs-y += thead_c9xx.o
+
+ifdef GENERIC_PLATCFG_DTB
+platform-objs-y += platcfg.o
+platform-objs-y += platcfg_blob.o
+platform-genflags-y += -DGENERIC_PLATCFG
+endif
+
+ifeq ($(GENERIC_FDT_TRUST),y)
+platform-genflags-y += -DGENERIC_FDT_TRUST
+endif
@@ -0,0 +1,95 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <generic_platcfg.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi_utils/ipi/fdt_ipi.h>
+#include <sbi_utils/irqchip/fdt_irqchip.h>
+#include <sbi_utils/irqchip/plic.h>
+#include <sbi_utils/serial/fdt_serial.h>
+#include <sbi_utils/serial/uart8250.h>
+#include <sbi_utils/sys/clint.h>
+#include <sbi_utils/timer/fdt_timer.h>
+
+static struct plic_data platcfg_plic;
+static struct clint_data platcfg_clint;
+
+int generic_platcfg_console_init(void)
+{
+	const struct generic_platcfg *pc = &generic_platcfg;
+
+	if (!pc->uart_addr)
+		return fdt_serial_init();
+
+	return uart8250_init(pc->uart_addr, pc->uart_freq, pc->uart_baud,
+			     pc->uart_reg_shift, pc->uart_reg_width);
+}
+
+int generic_platcfg_irqchip_init(bool cold_boot)
+{
+	const struct generic_platcfg *pc = &generic_platcfg;
+	u32 hartindex = sbi_current_hartindex();
+	int rc;
+
+	if (!pc->plic_addr)
+		return fdt_irqchip_init(cold_boot);
+
+	if (cold_boot) {
+		platcfg_plic.addr = pc->plic_addr;
+		platcfg_plic.num_src = pc->plic_num_src;
+		rc = plic_cold_irqchip_init(&platcfg_plic);
+		if (rc)
+			return rc;
+	}
+
+	return plic_warm_irqchip_init(&platcfg_plic,
+				      pc->plic_m_cntx[hartindex],
+				      pc->plic_s_cntx[hartindex]);
+}
+
+static void platcfg_clint_init(void)
+{
+	const struct generic_platcfg *pc = &generic_platcfg;
+
+	platcfg_clint.addr = pc->clint_addr;
+	platcfg_clint.first_hartid = pc->clint_first_hartid;
+	platcfg_clint.hart_count = pc->clint_hart_count;
+	platcfg_clint.has_64bit_mmio = pc->clint_has_64bit_mmio;
+}
+
+int generic_platcfg_ipi_init(bool cold_boot)
+{
+	int rc;
+
+	if (!generic_platcfg.clint_addr)
+		return fdt_ipi_init(cold_boot);
+
+	if (cold_boot) {
+		platcfg_clint_init();
+		rc = clint_cold_ipi_init(&platcfg_clint);
+		if (rc)
+			return rc;
+	}
+
+	return clint_warm_ipi_init();
+}
+
+int generic_platcfg_timer_init(bool cold_boot)
+{
+	int rc;
+
+	if (!generic_platcfg.clint_addr)
+		return fdt_timer_init(cold_boot);
+
+	if (cold_boot) {
+		platcfg_clint_init();
+		rc = clint_cold_timer_init(&platcfg_clint, NULL);
+		if (rc)
+			return rc;
+	}
+
+	return clint_warm_timer_init();
+}
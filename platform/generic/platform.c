@@ -8,24 +8,37 @@
  */
 
 #include <libfdt.h>
+#include <generic_platcfg.h>
 #include <platform_override.h>
+#include <sbi/fw_dynamic.h>
 #include <sbi/riscv_asm.h>
+#include <sbi/sbi_console.h>
+#include <sbi/sbi_hart.h>
 #include <sbi/sbi_hartmask.h>
+#include <sbi/sbi_math.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_string.h>
+#include <sbi/sbi_timer.h>
+#include <sbi_utils/cache/fdt_sifive_ccache.h>
+#include <sbi_utils/cache/zicbom.h>
 #include <sbi_utils/fdt/fdt_domain.h>
 #include <sbi_utils/fdt/fdt_fixup.h>
 #include <sbi_utils/fdt/fdt_helper.h>
+#include <sbi_utils/fdt/fdt_idle_states.h>
+#include <sbi_utils/fdt/fdt_index.h>
 #include <sbi_utils/irqchip/fdt_irqchip.h>
+#include <sbi_utils/irqchip/imsic.h>
 #include <sbi_utils/serial/fdt_serial.h>
 #include <sbi_utils/timer/fdt_timer.h>
 #include <sbi_utils/ipi/fdt_ipi.h>
 #include <sbi_utils/reset/fdt_reset.h>
 
 extern const struct platform_override sifive_fu540;
+extern const struct platform_override thead_c9xx;
 
 static const struct platform_override *special_platforms[] = {
 	&sifive_fu540,
+	&thead_c9xx,
 };
 
 static const struct platform_override *generic_plat = NULL;
@@ -53,7 +66,113 @@ static void fw_platform_lookup_special(void *fdt, int root_offset)
 }
 
 extern struct sbi_platform platform;
+static bool generic_has_mlevel_imsic = FALSE;
 static u32 generic_hart_index2id[SBI_HARTMASK_MAX_BITS] = { 0 };
+static u32 generic_hart_node[SBI_HARTMASK_MAX_BITS] = { 0 };
+static unsigned long generic_hart_stack_end[SBI_HARTMASK_MAX_BITS] = { 0 };
+
+/*
+ * Place the stacks (and scratch spaces) of HARTs on other NUMA nodes
+ * than the boot HART at the top of the memory of their own node. The
+ * stacks of a node form one naturally aligned block so that they can
+ * be protected with a single PMP entry.
+ */
+static void fw_platform_numa_stacks_init(void *fdt, u32 boot_node)
+{
+	u32 i, j, k, node;
+	unsigned long addr, size, block, base;
+	unsigned long stack_size = platform.hart_stack_size;
+	bool used = FALSE;
+
+	/* Each stack has to be naturally aligned */
+	if (stack_size & (stack_size - 1))
+		return;
+
+	for (i = 0; i < platform.hart_count; i++) {
+		node = generic_hart_node[i];
+		if (node == boot_node || generic_hart_stack_end[i])
+			continue;
+
+		/* Number of HARTs on the node, the lowest index goes first */
+		for (j = i, k = 0; j < platform.hart_count; j++)
+			if (generic_hart_node[j] == node)
+				k++;
+
+		if (fdt_parse_numa_memory(fdt, node, &addr, &size))
+			continue;
+		block = 1UL << log2roundup(k * stack_size);
+		if (size < block)
+			continue;
+		base = (addr + size - block) & ~(block - 1);
+		if (base < addr)
+			continue;
+
+		for (j = i, k = 0; j < platform.hart_count; j++) {
+			if (generic_hart_node[j] != node)
+				continue;
+			generic_hart_stack_end[j] = base + (++k) * stack_size;
+		}
+		used = TRUE;
+	}
+
+	if (used)
+		platform.hart_stack_end = generic_hart_stack_end;
+}
+
+extern char _fw_start[], _fw_end[];
+
+/* Provided by the firmware, only FW_DYNAMIC passes boot hints */
+extern unsigned long fw_boot_hints(void);
+static const struct fw_dynamic_boot_hints *generic_boot_hints;
+
+static bool generic_boot_hint(unsigned long flag)
+{
+	return (generic_boot_hints && (generic_boot_hints->flags & flag)) ?
+		TRUE : FALSE;
+}
+
+static u32 fw_platform_chosen_u32(void *fdt, const char *name, u32 def)
+{
+	int len, chosen_offset;
+	const fdt32_t *val;
+
+	chosen_offset = fdt_path_offset(fdt, "/chosen");
+	if (chosen_offset < 0)
+		return def;
+
+	val = fdt_getprop(fdt, chosen_offset, name, &len);
+	if (!val || len < sizeof(*val))
+		return def;
+
+	return fdt32_to_cpu(*val);
+}
+
+/*
+ * Size of the firmware heap, the firmware lays out its region with it
+ * right after fw_platform_init() returns. With an alignment asked for,
+ * the heap grows up to the next aligned address so that the firmware
+ * region ends on a huge page boundary (the FDT must not be in the way).
+ */
+static u32 fw_platform_heap_size(void *fdt)
+{
+	unsigned long end, aligned, fdt_addr = (unsigned long)fdt;
+	u32 align = fw_platform_chosen_u32(fdt, "opensbi,fw-region-align", 0);
+	u32 size = fw_platform_chosen_u32(fdt, "opensbi,heap-size",
+			SBI_PLATFORM_DEFAULT_HEAP_SIZE(platform.hart_count));
+
+	if (!align || (align & (align - 1)) ||
+	    ((unsigned long)_fw_start & (align - 1)))
+		return size;
+
+	end = (unsigned long)_fw_end +
+	      platform.hart_count * platform.hart_stack_size + size;
+	aligned = ROUNDUP(end, align);
+	if (aligned < end || (u32)-1 - size < aligned - end ||
+	    (end < fdt_addr + fdt_totalsize(fdt) && fdt_addr < aligned))
+		return size;
+
+	return size + (aligned - end);
+}
 
 /*
  * The fw_platform_init() function is called very early on the boot HART
@@ -74,8 +193,17 @@ unsigned long fw_platform_init(unsigned long arg0, unsigned long arg1,
 {
 	const char *model;
 	void *fdt = (void *)arg1;
-	u32 hartid, hart_count = 0;
-	int rc, root_offset, cpus_offset, cpu_offset, len;
+	u32 i, cpus_count, hartid, node, boot_node = -1U, hart_count = 0;
+	const struct fdt_cpu *cpus;
+	bool numa = TRUE;
+	int rc, root_offset, len;
+
+	generic_boot_hints = (void *)fw_boot_hints();
+
+#ifdef GENERIC_FDT_TRUST
+	/* Check the FDT once, it is still parsed the slow way on failure */
+	fdt_trust(fdt, generic_boot_hint(FW_DYNAMIC_BOOT_HINT_FDT_VALID));
+#endif
 
 	root_offset = fdt_path_offset(fdt, "/");
 	if (root_offset < 0)
@@ -90,22 +218,59 @@ unsigned long fw_platform_init(unsigned long arg0, unsigned long arg1,
 	if (generic_plat && generic_plat->features)
 		platform.features = generic_plat->features(generic_plat_match);
 
-	cpus_offset = fdt_path_offset(fdt, "/cpus");
-	if (cpus_offset < 0)
-		goto fail;
+	/* Other HARTs are still held in the firmware at this point */
+	generic_has_mlevel_imsic = fdt_check_imsic_mlevel(fdt);
 
-	fdt_for_each_subnode(cpu_offset, fdt, cpus_offset) {
-		rc = fdt_parse_hart_id(fdt, cpu_offset, &hartid);
-		if (rc)
-			continue;
+#ifdef GENERIC_PLATCFG
+	/* HARTs are known at build time */
+	for (i = 0; i < generic_platcfg.hart_count; i++)
+		generic_hart_index2id[i] = generic_platcfg.hart_ids[i];
+	platform.hart_count = generic_platcfg.hart_count;
+	platform.heap_size = fw_platform_heap_size(fdt);
 
-		if (SBI_HARTMASK_MAX_BITS <= hartid)
-			continue;
+	return arg1;
+#endif
+
+	/*
+	 * HARTs listed by the previous booting stage, ids which don't fit
+	 * in a hartmask are ignored like those of the DT CPU nodes
+	 */
+	if (generic_boot_hints && generic_boot_hints->hart_count &&
+	    generic_boot_hints->hart_count <= SBI_HARTMASK_MAX_BITS) {
+		for (i = 0; i < generic_boot_hints->hart_count; i++) {
+			hartid = ((const u32 *)generic_boot_hints->hart_ids)[i];
+			if (SBI_HARTMASK_MAX_BITS <= hartid)
+				continue;
+			generic_hart_index2id[hart_count++] = hartid;
+		}
+	}
+	if (hart_count) {
+		platform.hart_count = hart_count;
+		platform.heap_size = fw_platform_heap_size(fdt);
+		return arg1;
+	}
+
+	rc = fdt_parse_cpus(fdt, &cpus, &cpus_count);
+	if (rc)
+		goto fail;
+
+	for (i = 0; i < cpus_count; i++) {
+		hartid = cpus[i].hartid;
+		node = cpus[i].numa_node;
+		if (node == -1U)
+			numa = FALSE;
+		else if (hartid == arg0)
+			boot_node = node;
 
+		generic_hart_node[hart_count] = node;
 		generic_hart_index2id[hart_count++] = hartid;
 	}
 
 	platform.hart_count = hart_count;
+	platform.heap_size = fw_platform_heap_size(fdt);
+
+	if (numa && boot_node != -1U)
+		fw_platform_numa_stacks_init(fdt, boot_node);
 
 	/* Return original FDT pointer */
 	return arg1;
@@ -115,8 +280,16 @@ fail:
 		wfi();
 }
 
+static int generic_nascent_init(void)
+{
+	if (generic_has_mlevel_imsic)
+		imsic_local_irqchip_init();
+	return 0;
+}
+
 static int generic_early_init(bool cold_boot)
 {
+	void *fdt;
 	int rc;
 
 	if (generic_plat && generic_plat->early_init) {
@@ -128,13 +301,61 @@ static int generic_early_init(bool cold_boot)
 	if (!cold_boot)
 		return 0;
 
+	fdt = sbi_scratch_thishart_arg1_ptr();
+
+	/* Used by the timer drivers instead of the DT value */
+	if (generic_boot_hints && generic_boot_hints->timebase_freq)
+		sbi_timer_set_freq(generic_boot_hints->timebase_freq);
+
+	/* Overlays describe the hardware so apply them before probing */
+	if (sbi_scratch_thishart_ptr()->fdt_overlay) {
+		rc = fdt_overlays_apply(fdt,
+				(void *)sbi_scratch_thishart_ptr()->fdt_overlay);
+		if (rc)
+			return rc;
+	}
+
+	/*
+	 * Driver probing looks up nodes through the index. Without it
+	 * lookups just scan the device tree so ignore failures.
+	 */
+	fdt_index_init(fdt);
+
+	rc = fdt_idle_states_populate(fdt);
+	if (rc)
+		return rc;
+
+	/*
+	 * The FDT belongs to the next booting stage once it is started so
+	 * reset drivers can't be probed on first use, and some of them
+	 * (such as T-HEAD) also program the HARTs used by warm boot.
+	 */
 	return fdt_reset_init();
 }
 
+static int generic_fdt_fixups(void *fdt)
+{
+	/* The fix-ups modify the device tree in place */
+	fdt_index_invalidate();
+	fdt_fixups_expand(fdt);
+	fdt_cpu_fixup(fdt);
+	if (generic_boot_hint(FW_DYNAMIC_BOOT_HINT_FDT_PLIC_FIXED))
+		fdt_reserved_memory_fixup(fdt);
+	else
+		fdt_fixups(fdt);
+	fdt_domain_fixup(fdt);
+
+	if (generic_plat && generic_plat->fdt_fixup)
+		return generic_plat->fdt_fixup(fdt, generic_plat_match);
+
+	return 0;
+}
+
 static int generic_final_init(bool cold_boot)
 {
 	void *fdt;
 	int rc;
+	unsigned long cbom_block_size;
 
 	if (generic_plat && generic_plat->final_init) {
 		rc = generic_plat->final_init(cold_boot, generic_plat_match);
@@ -147,17 +368,36 @@ static int generic_final_init(bool cold_boot)
 
 	fdt = sbi_scratch_thishart_arg1_ptr();
 
-	fdt_cpu_fixup(fdt);
-	fdt_fixups(fdt);
-	fdt_domain_fixup(fdt);
+	/* Enable all (or the configured) ways of a SiFive L2 cache */
+	fdt_sifive_ccache_init(fdt);
 
-	if (generic_plat && generic_plat->fdt_fixup) {
-		rc = generic_plat->fdt_fixup(fdt, generic_plat_match);
-		if (rc)
-			return rc;
-	}
+	/* Use Zicbom for cache maintenance unless the platform has its own */
+	if (!fdt_parse_cbom_block_size(fdt, &cbom_block_size))
+		zicbom_cache_init(cbom_block_size);
 
-	return 0;
+	/* Console input is not lost while nobody polls it */
+	rc = fdt_serial_irq_init();
+	if (rc)
+		sbi_printf("%s: console irq init failed (error %d)\n",
+			   __func__, rc);
+
+	rc = generic_fdt_fixups(fdt);
+
+	/* The next booting stage owns the FDT from now on */
+	fdt_untrust();
+
+	return rc;
+}
+
+static int generic_warm_restart(void)
+{
+	void *fdt = sbi_scratch_thishart_arg1_ptr();
+
+	/* The new FDT comes from the previous next booting stage */
+	if (fdt_check_header(fdt))
+		return SBI_EINVAL;
+
+	return generic_fdt_fixups(fdt);
 }
 
 static void generic_early_exit(void)
@@ -177,26 +417,131 @@ static int generic_domains_init(void)
 	return fdt_domains_populate(sbi_scratch_thishart_arg1_ptr());
 }
 
+static u32 generic_chosen_u32(const char *name, u32 default_val)
+{
+	int len, chosen_offset;
+	const fdt32_t *val;
+	void *fdt = sbi_scratch_thishart_arg1_ptr();
+
+	chosen_offset = fdt_path_offset(fdt, "/chosen");
+	if (chosen_offset < 0)
+		return default_val;
+
+	val = fdt_getprop(fdt, chosen_offset, name, &len);
+	if (!val || len < sizeof(*val))
+		return default_val;
+
+	return fdt32_to_cpu(*val);
+}
+
+static bool generic_chosen_has(const char *name)
+{
+	int chosen_offset;
+	void *fdt = sbi_scratch_thishart_arg1_ptr();
+
+	chosen_offset = fdt_path_offset(fdt, "/chosen");
+	if (chosen_offset < 0)
+		return FALSE;
+
+	return fdt_getprop(fdt, chosen_offset, name, NULL) ? TRUE : FALSE;
+}
+
 static u64 generic_tlbr_flush_limit(void)
 {
+	if (generic_chosen_has("opensbi,tlb-flush-limit"))
+		return generic_chosen_u32("opensbi,tlb-flush-limit",
+				SBI_PLATFORM_TLB_RANGE_FLUSH_LIMIT_DEFAULT);
 	if (generic_plat && generic_plat->tlbr_flush_limit)
 		return generic_plat->tlbr_flush_limit(generic_plat_match);
+	if (generic_chosen_has("opensbi,tlb-flush-calibrate"))
+		return SBI_PLATFORM_TLB_RANGE_FLUSH_LIMIT_CALIBRATE;
 	return SBI_PLATFORM_TLB_RANGE_FLUSH_LIMIT_DEFAULT;
 }
 
+static u64 generic_tlbr_merge_gap(void)
+{
+	if (generic_plat && generic_plat->tlbr_merge_gap)
+		return generic_plat->tlbr_merge_gap(generic_plat_match);
+	return SBI_PLATFORM_TLB_RANGE_MERGE_GAP_DEFAULT;
+}
+
+static u32 generic_tlb_fifo_num_entries(void)
+{
+	return generic_chosen_u32("opensbi,tlb-fifo-entries",
+				  SBI_PLATFORM_TLB_FIFO_NUM_ENTRIES_DEFAULT);
+}
+
+static u32 generic_tlb_cluster(u32 hartid)
+{
+	u32 i, count;
+	const struct fdt_cpu *cpus;
+
+	if (fdt_parse_cpus(sbi_scratch_thishart_arg1_ptr(), &cpus, &count))
+		return -1U;
+
+	for (i = 0; i < count; i++) {
+		if (cpus[i].hartid == hartid)
+			return cpus[i].cluster;
+	}
+
+	return -1U;
+}
+
+static int generic_hart_desc(u32 hartid, struct sbi_hart_desc *desc)
+{
+	int rc;
+
+	rc = fdt_parse_hart_desc(sbi_scratch_thishart_arg1_ptr(),
+				 hartid, desc);
+	if (!generic_boot_hints)
+		return rc;
+	if (rc)
+		sbi_memset(desc, 0, sizeof(*desc));
+
+	if (generic_boot_hint(FW_DYNAMIC_BOOT_HINT_PMP_COUNT)) {
+		desc->valid |= SBI_HART_DESC_PMP_COUNT;
+		desc->pmp_count = generic_boot_hints->pmp_count;
+	}
+	if (generic_boot_hint(FW_DYNAMIC_BOOT_HINT_MHPM_COUNT)) {
+		desc->valid |= SBI_HART_DESC_MHPM_COUNT;
+		desc->mhpm_count = generic_boot_hints->mhpm_count;
+	}
+
+	return 0;
+}
+
 const struct sbi_platform_operations platform_ops = {
+	.nascent_init		= generic_nascent_init,
 	.early_init		= generic_early_init,
 	.final_init		= generic_final_init,
 	.early_exit		= generic_early_exit,
 	.final_exit		= generic_final_exit,
+	.warm_restart		= generic_warm_restart,
+	.hart_desc		= generic_hart_desc,
 	.domains_init		= generic_domains_init,
+#ifdef GENERIC_PLATCFG
+	.console_init		= generic_platcfg_console_init,
+	.irqchip_init		= generic_platcfg_irqchip_init,
+#else
 	.console_init		= fdt_serial_init,
 	.irqchip_init		= fdt_irqchip_init,
+#endif
 	.irqchip_exit		= fdt_irqchip_exit,
+#ifdef GENERIC_PLATCFG
+	.ipi_init		= generic_platcfg_ipi_init,
+#else
 	.ipi_init		= fdt_ipi_init,
+#endif
 	.ipi_exit		= fdt_ipi_exit,
 	.get_tlbr_flush_limit	= generic_tlbr_flush_limit,
+	.get_tlbr_merge_gap	= generic_tlbr_merge_gap,
+	.get_tlb_fifo_num_entries = generic_tlb_fifo_num_entries,
+	.get_tlb_cluster	= generic_tlb_cluster,
+#ifdef GENERIC_PLATCFG
+	.timer_init		= generic_platcfg_timer_init,
+#else
 	.timer_init		= fdt_timer_init,
+#endif
 	.timer_exit		= fdt_timer_exit,
 };
 
@@ -208,5 +553,6 @@ struct sbi_platform platform = {
 	.hart_count		= SBI_HARTMASK_MAX_BITS,
 	.hart_index2id		= generic_hart_index2id,
 	.hart_stack_size	= SBI_PLATFORM_DEFAULT_HART_STACK_SIZE,
+	.heap_size		= SBI_PLATFORM_DEFAULT_HEAP_SIZE(0),
 	.platform_ops_addr	= (unsigned long)&platform_ops
 };
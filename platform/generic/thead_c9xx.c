@@ -0,0 +1,97 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021 Western Digital Corporation or its affiliates.
+ */
+
+#include <libfdt.h>
+#include <platform_override.h>
+#include <sbi/riscv_asm.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi_utils/fdt/fdt_helper.h>
+
+/* clang-format off */
+
+#define THEAD_CSR_MXSTATUS		0x7c0
+#define THEAD_CSR_MHCR			0x7c1
+#define THEAD_CSR_MHINT			0x7c5
+
+/* clang-format on */
+
+/*
+ * Performance controls which may be tuned per SKU through DT properties
+ * of the /cpus node. They are applied the same way on every HART.
+ */
+enum thead_csr_config {
+	THEAD_CSR_CONFIG_MXSTATUS = 0,
+	THEAD_CSR_CONFIG_MHCR,
+	THEAD_CSR_CONFIG_MHINT,
+	THEAD_CSR_CONFIG_MAX,
+};
+
+static const char *const thead_csr_config_props[THEAD_CSR_CONFIG_MAX] = {
+	[THEAD_CSR_CONFIG_MXSTATUS] = "thead,mxstatus",
+	[THEAD_CSR_CONFIG_MHCR] = "thead,mhcr",
+	[THEAD_CSR_CONFIG_MHINT] = "thead,mhint",
+};
+
+static unsigned long thead_csr_config_valid;
+static unsigned long thead_csr_config_val[THEAD_CSR_CONFIG_MAX];
+
+static void thead_csr_config_parse(void *fdt)
+{
+	int i, len, cpus_offset;
+	const fdt32_t *val;
+
+	cpus_offset = fdt_path_offset(fdt, "/cpus");
+	if (cpus_offset < 0)
+		return;
+
+	for (i = 0; i < THEAD_CSR_CONFIG_MAX; i++) {
+		val = fdt_getprop(fdt, cpus_offset,
+				  thead_csr_config_props[i], &len);
+		if (!val || len < sizeof(fdt32_t))
+			continue;
+
+		/* One cell or, for 64 bit values, two cells */
+		thead_csr_config_val[i] = fdt32_to_cpu(val[0]);
+		if (len >= 2 * sizeof(fdt32_t))
+			thead_csr_config_val[i] =
+				((u64)fdt32_to_cpu(val[0]) << 32) |
+				fdt32_to_cpu(val[1]);
+		thead_csr_config_valid |= 1UL << i;
+	}
+}
+
+static void thead_csr_config_apply(void)
+{
+	if (thead_csr_config_valid & (1UL << THEAD_CSR_CONFIG_MXSTATUS))
+		csr_write(THEAD_CSR_MXSTATUS,
+			  thead_csr_config_val[THEAD_CSR_CONFIG_MXSTATUS]);
+	if (thead_csr_config_valid & (1UL << THEAD_CSR_CONFIG_MHCR))
+		csr_write(THEAD_CSR_MHCR,
+			  thead_csr_config_val[THEAD_CSR_CONFIG_MHCR]);
+	if (thead_csr_config_valid & (1UL << THEAD_CSR_CONFIG_MHINT))
+		csr_write(THEAD_CSR_MHINT,
+			  thead_csr_config_val[THEAD_CSR_CONFIG_MHINT]);
+}
+
+static int thead_c9xx_early_init(bool cold_boot, const struct fdt_match *match)
+{
+	if (cold_boot)
+		thead_csr_config_parse(sbi_scratch_thishart_arg1_ptr());
+
+	thead_csr_config_apply();
+
+	return 0;
+}
+
+static const struct fdt_match thead_c9xx_match[] = {
+	{ .compatible = "thead,reset-sample" },
+	{ },
+};
+
+const struct platform_override thead_c9xx = {
+	.match_table = thead_c9xx_match,
+	.early_init = thead_c9xx_early_init,
+};
@@ -13,6 +13,9 @@ platform-cflags-y =
 platform-asflags-y =
 platform-ldflags-y =
 
+# Platform and platform operations are constant
+PLATFORM_STATIC=y
+
 # Blobs to build
 FW_TEXT_START=0x80000000
 FW_PAYLOAD=y
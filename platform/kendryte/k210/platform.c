@@ -7,10 +7,12 @@
  *   Damien Le Moal <damien.lemoal@wdc.com>
  */
 
+#include <libfdt.h>
 #include <sbi/riscv_asm.h>
 #include <sbi/riscv_encoding.h>
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_const.h>
+#include <sbi/sbi_error.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_system.h>
 #include <sbi_utils/fdt/fdt_fixup.h>
@@ -40,7 +42,10 @@ static struct clint_data clint = {
 	.has_64bit_mmio = TRUE,
 };
 
-static u32 k210_get_clk_freq(void)
+/* CPU clock frequency computed from the PLL registers (0 = not yet) */
+static u32 k210_clk_freq;
+
+static u32 k210_read_clk_freq(void)
 {
 	u32 clksel0, pll0;
 	u64 pll0_freq, clkr0, clkf0, clkod0, div;
@@ -69,6 +74,35 @@ static u32 k210_get_clk_freq(void)
 	return pll0_freq / div;
 }
 
+static u32 k210_get_clk_freq(void)
+{
+	if (!k210_clk_freq)
+		k210_clk_freq = k210_read_clk_freq();
+
+	return k210_clk_freq;
+}
+
+static void k210_clk_fixup(void *fdt)
+{
+	int cpus_offset, cpu_offset;
+	u32 freq = k210_get_clk_freq();
+
+	if (fdt_fixup_reserve(fdt, 32))
+		return;
+
+	cpus_offset = fdt_path_offset(fdt, "/cpus");
+	if (cpus_offset < 0)
+		return;
+
+	fdt_setprop_u32(fdt, cpus_offset, "timebase-frequency",
+			freq / K210_CLINT_CLK_DIV);
+	fdt_for_each_subnode(cpu_offset, fdt, cpus_offset) {
+		if (fdt_getprop(fdt, cpu_offset, "clock-frequency", NULL))
+			fdt_setprop_inplace_u32(fdt, cpu_offset,
+						"clock-frequency", freq);
+	}
+}
+
 static int k210_system_reset_check(u32 type, u32 reason)
 {
 	return 1;
@@ -110,6 +144,7 @@ static int k210_final_init(bool cold_boot)
 
 	fdt_cpu_fixup(fdt);
 	fdt_fixups(fdt);
+	k210_clk_fixup(fdt);
 
 	return 0;
 }
@@ -160,6 +195,34 @@ static int k210_timer_init(bool cold_boot)
 	return clint_warm_timer_init();
 }
 
+/*
+ * The supervisor changes the PLL and clock selector through the SYSCTL
+ * itself, and then asks us to pick up the new CPU clock. The UART
+ * divisor is reprogrammed and the new timebase frequency is returned.
+ * CLINT time changes rate with the CPU clock, so the supervisor has to
+ * rescale its clocksource and reprogram its timer event.
+ */
+static int k210_vendor_ext_check(long extid)
+{
+	return (extid == K210_SBI_EXT_ID) ? 1 : 0;
+}
+
+static int k210_vendor_ext_provider(long extid, long funcid,
+				    const struct sbi_trap_regs *regs,
+				    unsigned long *out_value,
+				    struct sbi_trap_info *out_trap)
+{
+	if (extid != K210_SBI_EXT_ID || funcid != K210_SBI_EXT_CLK_UPDATE)
+		return SBI_ENOTSUPP;
+
+	k210_clk_freq = k210_read_clk_freq();
+	sifive_uart_init(K210_UART_BASE_ADDR, k210_clk_freq,
+			 K210_UART_BAUDRATE);
+	*out_value = k210_clk_freq / K210_CLINT_CLK_DIV;
+
+	return 0;
+}
+
 const struct sbi_platform_operations platform_ops = {
 	.early_init	= k210_early_init,
 
@@ -172,6 +235,9 @@ const struct sbi_platform_operations platform_ops = {
 	.ipi_init  = k210_ipi_init,
 
 	.timer_init	   = k210_timer_init,
+
+	.vendor_ext_check = k210_vendor_ext_check,
+	.vendor_ext_provider = k210_vendor_ext_provider,
 };
 
 const struct sbi_platform platform = {
@@ -181,5 +247,6 @@ const struct sbi_platform platform = {
 	.features		= 0,
 	.hart_count		= K210_HART_COUNT,
 	.hart_stack_size	= SBI_PLATFORM_DEFAULT_HART_STACK_SIZE,
+	.heap_size		= SBI_PLATFORM_DEFAULT_HEAP_SIZE(K210_HART_COUNT),
 	.platform_ops_addr	= (unsigned long)&platform_ops
 };
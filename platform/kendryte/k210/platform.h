@@ -16,6 +16,8 @@
 #define K210_UART_BAUDRATE	115200
 
 #define K210_CLK0_FREQ		26000000UL
+/* CLINT time runs at the CPU clock divided by this */
+#define K210_CLINT_CLK_DIV	50
 #define K210_PLIC_NUM_SOURCES	65
 
 /* Registers base address */
@@ -32,6 +34,10 @@
 /* Register bit masks */
 #define K210_RESET_MASK		0x01
 
+/* Vendor SBI extension */
+#define K210_SBI_EXT_ID		0x09000000
+#define K210_SBI_EXT_CLK_UPDATE	0x0
+
 static inline u32 k210_read_sysreg(u32 reg)
 {
 	return readl((volatile void *)(K210_SYSCTL_BASE_ADDR + reg));
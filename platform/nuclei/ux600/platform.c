@@ -17,6 +17,7 @@
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_system.h>
 #include <sbi_utils/fdt/fdt_fixup.h>
+#include <sbi_utils/irqchip/eclic.h>
 #include <sbi_utils/irqchip/plic.h>
 #include <sbi_utils/serial/sifive-uart.h>
 #include <sbi_utils/sys/clint.h>
@@ -37,6 +38,9 @@
 #define UX600_PLIC_NUM_SOURCES		0x35
 #define UX600_PLIC_NUM_PRIORITIES	7
 
+#define UX600_ECLIC_ADDR		0xC000000
+#define UX600_ECLIC_NLBITS		2
+
 #define UX600_UART0_ADDR		0x10013000
 #define UX600_UART1_ADDR		0x10023000
 
@@ -67,6 +71,13 @@ static struct clint_data clint = {
 	.hart_count = UX600_HART_COUNT,
 	.has_64bit_mmio = TRUE,
 };
+
+static struct eclic_data eclic = {
+	.addr = UX600_ECLIC_ADDR,
+	.nlbits = UX600_ECLIC_NLBITS,
+};
+static bool ux600_has_eclic;
+
 static u32 measure_cpu_freq(u32 n)
 {
 	u32 start_mtime, delta_mtime;
@@ -177,8 +188,20 @@ static int ux600_irqchip_init(bool cold_boot)
 		rc = plic_cold_irqchip_init(&plic);
 		if (rc)
 			return rc;
+		ux600_has_eclic = (eclic_cold_irqchip_init(&eclic)) ?
+				  FALSE : TRUE;
 	}
 
+	/*
+	 * The M-mode software and timer interrupts go through the ECLIC
+	 * with hardware vectoring, IPIs at a higher level than the timer.
+	 * The nested preemption of the ECLIC is not used because the M-mode
+	 * interrupt handlers are not reentrant. The CLINT mode vector table
+	 * stays in use if the ECLIC mode can't be entered.
+	 */
+	if (ux600_has_eclic)
+		eclic_warm_irqchip_init(&eclic);
+
 	return plic_warm_irqchip_init(&plic, (hartid) ? (2 * hartid - 1) : 0,
 				      (hartid) ? (2 * hartid) : -1);
 }
@@ -225,5 +248,6 @@ const struct sbi_platform platform = {
 	.features		= SBI_PLATFORM_DEFAULT_FEATURES,
 	.hart_count		= UX600_HART_COUNT,
 	.hart_stack_size	= SBI_PLATFORM_DEFAULT_HART_STACK_SIZE,
+	.heap_size		= SBI_PLATFORM_DEFAULT_HEAP_SIZE(UX600_HART_COUNT),
 	.platform_ops_addr	= (unsigned long)&platform_ops
 };
@@ -13,6 +13,9 @@ platform-cflags-y =
 platform-asflags-y =
 platform-ldflags-y =
 
+# Platform and platform operations are constant
+PLATFORM_STATIC=y
+
 # Command for platform specific "make run"
 platform-runcmd = qemu-system-riscv$(PLATFORM_RISCV_XLEN) -M sifive_u -m 256M \
   -nographic -bios $(build_dir)/platform/sifive/fu540/firmware/fw_payload.elf
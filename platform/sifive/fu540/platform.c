@@ -14,6 +14,8 @@
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_const.h>
 #include <sbi/sbi_platform.h>
+#include <sbi_utils/cache/fdt_sifive_ccache.h>
+#include <sbi_utils/cache/sifive_ccache.h>
 #include <sbi_utils/fdt/fdt_fixup.h>
 #include <sbi_utils/irqchip/plic.h>
 #include <sbi_utils/serial/sifive-uart.h>
@@ -27,6 +29,9 @@
 
 #define FU540_CLINT_ADDR			0x2000000
 
+#define FU540_CCACHE_ADDR			0x2010000
+#define FU540_CCACHE_HART_MASTER_BASE		1
+
 #define FU540_PLIC_ADDR				0xc000000
 #define FU540_PLIC_NUM_SOURCES			0x35
 #define FU540_PLIC_NUM_PRIORITIES		7
@@ -51,6 +56,11 @@ static struct plic_data plic = {
 	.num_src = FU540_PLIC_NUM_SOURCES,
 };
 
+static struct sifive_ccache_data ccache = {
+	.addr = FU540_CCACHE_ADDR,
+	.hart_master_base = FU540_CCACHE_HART_MASTER_BASE,
+};
+
 static struct clint_data clint = {
 	.addr = FU540_CLINT_ADDR,
 	.first_hartid = 0,
@@ -80,6 +90,14 @@ static int fu540_final_init(bool cold_boot)
 		return 0;
 
 	fdt = sbi_scratch_thishart_arg1_ptr();
+
+	/*
+	 * Only one L2 way is enabled at reset. Prefer the way mask and
+	 * domain partitions from the FDT but enable all ways without it.
+	 */
+	if (fdt_sifive_ccache_init(fdt))
+		sifive_ccache_init(&ccache);
+
 	fu540_modify_dt(fdt);
 
 	return 0;
@@ -171,5 +189,6 @@ const struct sbi_platform platform = {
 	.hart_count		= (FU540_HART_COUNT - 1),
 	.hart_index2id		= fu540_hart_index2id,
 	.hart_stack_size	= SBI_PLATFORM_DEFAULT_HART_STACK_SIZE,
+	.heap_size		= SBI_PLATFORM_DEFAULT_HEAP_SIZE(FU540_HART_COUNT - 1),
 	.platform_ops_addr	= (unsigned long)&platform_ops
 };
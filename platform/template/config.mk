@@ -31,6 +31,24 @@ platform-ldflags-y =
 # PLATFORM_RISCV_ISA = rv64imafdc
 # PLATFORM_RISCV_CODE_MODEL = medany
 
+#
+# Per-HART scratch space size (4KB by default). This is carved out of
+# the HART stack so hart_stack_size of the platform must stay larger.
+#
+# PLATFORM_SCRATCH_SIZE = 0x2000
+
+#
+# Per-HART stack size including the scratch space (8KB by default). The
+# stack usage can be measured with SBI_STACK_CHECK=y before shrinking it.
+#
+# PLATFORM_HART_STACK_SIZE = 0x1800
+
+#
+# Maximum HART id + 1 handled by OpenSBI (1024 by default). Tables indexed
+# by HART id scale with this so small platforms can lower it.
+#
+# PLATFORM_HARTMASK_MAX_BITS = 64
+
 # Firmware load address configuration. This is mandatory.
 FW_TEXT_START=0x80000000
 
@@ -0,0 +1,250 @@
+#!/bin/bash
+
+function usage()
+{
+	echo "Usage:"
+	echo " $0 [options]"
+	echo "Options:"
+	echo "     -h                   Display help or usage"
+	echo "     -i <input_file_path> Input DTB file path"
+	echo "     -f <fdtget_path>     fdtget tool to use (default: fdtget)"
+	exit 1;
+}
+
+# Command line options
+INPUT_PATH=""
+FDTGET="fdtget"
+
+while getopts "hi:f:" o; do
+	case "${o}" in
+	h)
+		usage
+		;;
+	i)
+		INPUT_PATH=${OPTARG}
+		;;
+	f)
+		FDTGET=${OPTARG}
+		;;
+	*)
+		usage
+		;;
+	esac
+done
+shift $((OPTIND-1))
+
+if [ -z "${INPUT_PATH}" ]; then
+	echo "Must specify input file path"
+	usage
+fi
+
+if [ ! -f "${INPUT_PATH}" ]; then
+	echo "The input path should be a file"
+	usage
+fi
+
+if ! command -v ${FDTGET} > /dev/null; then
+	echo "The ${FDTGET} tool (part of dtc) is required"
+	exit 1
+fi
+
+# Same limit as SBI_HARTMASK_MAX_BITS
+HART_MAX=128
+
+# Run fdtget with option $1 on node $2
+function get()
+{
+	${FDTGET} $1 "${INPUT_PATH}" "$2" 2> /dev/null
+}
+
+# Get property $2 of node $1 with type $3 (and default $4)
+function prop()
+{
+	if [ -n "$4" ]; then
+		${FDTGET} -t $3 -d "$4" "${INPUT_PATH}" "$1" "$2" 2> /dev/null
+	else
+		${FDTGET} -t $3 "${INPUT_PATH}" "$1" "$2" 2> /dev/null
+	fi
+}
+
+# Print all node paths below (and including) node $1
+function nodes()
+{
+	local n
+
+	echo "$1"
+	for n in $(get -l "$1"); do
+		if [ "$1" = "/" ]; then
+			nodes "/${n}"
+		else
+			nodes "$1/${n}"
+		fi
+	done
+}
+
+# Check whether node $1 is compatible to any of the remaining arguments
+function compatible()
+{
+	local c m node=$1
+
+	shift
+	for c in $(prop "${node}" compatible s); do
+		for m in "$@"; do
+			if [ "${c}" = "${m}" ]; then
+				return 0
+			fi
+		done
+	done
+
+	return 1
+}
+
+# Print first address of "reg" property of node $1
+function reg_addr()
+{
+	local cells parent=${1%/*}
+
+	if [ -z "${parent}" ]; then
+		parent="/"
+	fi
+	cells=($(prop "$1" reg u))
+	if [ "$(prop "${parent}" "#address-cells" u 2)" = "1" ]; then
+		printf "0x%x" ${cells[0]:-0}
+	else
+		printf "0x%x" $(( (${cells[0]:-0} << 32) | ${cells[1]:-0} ))
+	fi
+}
+
+# HARTs
+declare -A INTC_HARTID INTC_INDEX
+HART_IDS=()
+for n in $(get -l /cpus); do
+	node="/cpus/${n}"
+	if [ "$(prop "${node}" device_type s)" != "cpu" ]; then
+		continue
+	fi
+	cells=($(prop "${node}" reg u))
+	hartid=${cells[1]:-${cells[0]}}
+	if [ -z "${hartid}" ] || [ ${hartid} -ge ${HART_MAX} ]; then
+		continue
+	fi
+	phandle=$(prop "${node}/interrupt-controller" phandle u)
+	if [ -n "${phandle}" ]; then
+		INTC_HARTID[${phandle}]=${hartid}
+		INTC_INDEX[${phandle}]=${#HART_IDS[@]}
+	fi
+	HART_IDS+=(${hartid})
+done
+
+if [ ${#HART_IDS[@]} -eq 0 ]; then
+	echo "No CPU DT nodes found in ${INPUT_PATH}" >&2
+	exit 1
+fi
+
+# Console from "stdout-path" or the first UART8250
+STDOUT=$(prop /chosen stdout-path s)
+STDOUT=${STDOUT%%:*}
+if [ -n "${STDOUT}" ] && [ "${STDOUT:0:1}" != "/" ]; then
+	STDOUT=$(prop /aliases "${STDOUT}" s)
+fi
+
+CLINT=""
+PLIC=""
+UART=""
+for node in $(nodes /); do
+	if [ -z "${CLINT}" ] &&
+	   compatible "${node}" riscv,clint0 sifive,clint0; then
+		CLINT=${node}
+	elif [ -z "${PLIC}" ] &&
+	     compatible "${node}" riscv,plic0 sifive,plic-1.0.0; then
+		PLIC=${node}
+	elif compatible "${node}" ns16550 ns16550a; then
+		if [ -z "${UART}" ] || [ "${node}" = "${STDOUT}" ]; then
+			UART=${node}
+		fi
+	fi
+done
+if [ -n "${STDOUT}" ] && [ "${UART}" != "${STDOUT}" ]; then
+	UART=""
+fi
+
+echo "/* Generated by dtb2platcfg.sh from $(basename ${INPUT_PATH}), do not edit */"
+echo ""
+echo "#include <generic_platcfg.h>"
+echo ""
+echo "const struct generic_platcfg generic_platcfg = {"
+echo "	.hart_count = ${#HART_IDS[@]},"
+echo "	.hart_ids = { $(echo ${HART_IDS[@]} | sed 's/ /, /g') },"
+
+if [ -n "${CLINT}" ]; then
+	cells=($(prop "${CLINT}" interrupts-extended u))
+	first=-1
+	last=-1
+	count=0
+	for ((i = 0; i + 1 < ${#cells[@]}; i += 2)); do
+		hartid=${INTC_HARTID[${cells[i]}]}
+		# M-mode software interrupt
+		if [ -z "${hartid}" ] || [ ${cells[i + 1]} -ne 3 ]; then
+			continue
+		fi
+		if [ ${first} -lt 0 ] || [ ${hartid} -lt ${first} ]; then
+			first=${hartid}
+		fi
+		if [ ${hartid} -gt ${last} ]; then
+			last=${hartid}
+		fi
+		count=$((count + 1))
+	done
+	if [ ${first} -ge 0 ]; then
+		if [ ${count} -lt $((last - first + 1)) ]; then
+			count=$((last - first + 1))
+		fi
+		mmio64=TRUE
+		if get -p "${CLINT}" | grep -qx "clint,has-no-64bit-mmio"; then
+			mmio64=FALSE
+		fi
+		echo "	.clint_addr = $(reg_addr "${CLINT}"),"
+		echo "	.clint_first_hartid = ${first},"
+		echo "	.clint_hart_count = ${count},"
+		echo "	.clint_has_64bit_mmio = ${mmio64},"
+	fi
+fi
+
+if [ -n "${PLIC}" ]; then
+	cells=($(prop "${PLIC}" interrupts-extended u))
+	mcntx=()
+	scntx=()
+	for ((i = 0; i < ${#HART_IDS[@]}; i++)); do
+		mcntx[i]=-1
+		scntx[i]=-1
+	done
+	for ((i = 0; i + 1 < ${#cells[@]}; i += 2)); do
+		index=${INTC_INDEX[${cells[i]}]}
+		if [ -z "${index}" ]; then
+			continue
+		fi
+		# M-mode and S-mode external interrupts
+		case ${cells[i + 1]} in
+		11)
+			mcntx[index]=$((i / 2))
+			;;
+		9)
+			scntx[index]=$((i / 2))
+			;;
+		esac
+	done
+	echo "	.plic_addr = $(reg_addr "${PLIC}"),"
+	echo "	.plic_num_src = $(prop "${PLIC}" riscv,ndev u 0),"
+	echo "	.plic_m_cntx = { $(echo ${mcntx[@]} | sed 's/ /, /g') },"
+	echo "	.plic_s_cntx = { $(echo ${scntx[@]} | sed 's/ /, /g') },"
+fi
+
+if [ -n "${UART}" ]; then
+	echo "	.uart_addr = $(reg_addr "${UART}"),"
+	echo "	.uart_freq = $(prop "${UART}" clock-frequency u 0),"
+	echo "	.uart_baud = $(prop "${UART}" current-speed u 115200),"
+	echo "	.uart_reg_shift = $(prop "${UART}" reg-shift u 0),"
+	echo "	.uart_reg_width = $(prop "${UART}" reg-io-width u 1),"
+fi
+
+echo "};"